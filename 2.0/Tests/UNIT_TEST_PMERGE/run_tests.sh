@@ -0,0 +1,52 @@
+#!/bin/bash
+
+set -exo pipefail
+
+$1/plink2 $2 $3 --dummy 200 600 0.05 dosage-freq=0.2 --out tmp_data
+# Put the variants on two nonstandard contigs, with ctgY before ctgX.
+cp tmp_data.pgen tmp_contigs.pgen
+cp tmp_data.psam tmp_contigs.psam
+awk 'BEGIN {OFS="\t"} NR == 1 {print; next} {$1 = (NR <= 301)? "ctgY" : "ctgX"; print}' tmp_data.pvar > tmp_contigs.pvar
+$1/plink2 $2 $3 --pfile tmp_contigs --allow-extra-chr --export vcf vcf-dosage=DS --out orig
+grep -v '^##' orig.vcf > orig.vcf.headerless
+
+# alternating variants
+awk 'NR > 1 && NR % 2 == 0 {print $3}' tmp_contigs.pvar > ids_even.txt
+awk 'NR > 1 && NR % 2 == 1 {print $3}' tmp_contigs.pvar > ids_odd.txt
+$1/plink2 $2 $3 --pfile tmp_contigs --allow-extra-chr --extract ids_even.txt --make-pgen --out part_even
+$1/plink2 $2 $3 --pfile tmp_contigs --allow-extra-chr --extract ids_odd.txt --make-pgen --out part_odd
+printf "part_odd\npart_even\n" > merge_list.txt
+$1/plink2 $2 $3 --allow-extra-chr --pmerge-list merge_list.txt --out merged
+$1/plink2 $2 $3 --pfile merged --allow-extra-chr --export vcf vcf-dosage=DS --out merged
+grep -v '^##' merged.vcf > merged.vcf.headerless
+diff -q orig.vcf.headerless merged.vcf.headerless
+
+# The first fileset only contains ctgX, so contig order must come from the
+# second fileset.
+awk 'NR > 1 && NR % 2 == 0 && $1 == "ctgX" {print $3}' tmp_contigs.pvar > ids_x.txt
+$1/plink2 $2 $3 --pfile tmp_contigs --allow-extra-chr --extract ids_x.txt --make-pgen --out part_x
+$1/plink2 $2 $3 --pfile tmp_contigs --allow-extra-chr --exclude ids_x.txt --make-pgen --out part_y
+printf "part_x\npart_y\n" > merge_list2.txt
+$1/plink2 $2 $3 --allow-extra-chr --pmerge-list merge_list2.txt --out merged2
+$1/plink2 $2 $3 --pfile merged2 --allow-extra-chr --export vcf vcf-dosage=DS --out merged2
+grep -v '^##' merged2.vcf > merged2.vcf.headerless
+diff -q orig.vcf.headerless merged2.vcf.headerless
+
+# Overlapping variant sets must be rejected.
+printf "part_even\ntmp_contigs\n" > merge_list3.txt
+if $1/plink2 $2 $3 --allow-extra-chr --pmerge-list merge_list3.txt --out merged3; then
+    exit 1
+fi
+
+# Disjoint sample sets: merged samples should follow fileset order.
+awk 'NR > 1 && NR % 3 == 0 {print $1}' tmp_data.psam > ids_third.txt
+$1/plink2 $2 $3 --pfile tmp_data --keep ids_third.txt --make-pgen --out part_s1
+$1/plink2 $2 $3 --pfile tmp_data --remove ids_third.txt --make-pgen --out part_s2
+printf "part_s1\npart_s2\n" > merge_list4.txt
+$1/plink2 $2 $3 --pmerge-list merge_list4.txt --out merged4
+$1/plink2 $2 $3 --pfile merged4 --export vcf vcf-dosage=DS --out merged4
+cat ids_third.txt > sample_order.txt
+awk 'NR > 1 && NR % 3 != 0 {print $1}' tmp_data.psam >> sample_order.txt
+$1/plink2 $2 $3 --pfile tmp_data --indiv-sort file sample_order.txt --make-pgen --out sorted4
+$1/plink2 $2 $3 --pfile sorted4 --export vcf vcf-dosage=DS --out sorted4
+diff -q <(grep -v '^##' sorted4.vcf) <(grep -v '^##' merged4.vcf)
@@ -38,6 +38,11 @@ cd UNIT_TEST_PHASED_VCF
 cd ..
 echo "UNIT_TEST_PHASED_VCF passed."
 
+cd UNIT_TEST_PMERGE
+./run_tests.sh $d $2 $3 > UNIT_TEST_PMERGE.log
+cd ..
+echo "UNIT_TEST_PMERGE passed."
+
 cd UNIT_TEST_SAMPLE_SUBSET
 ./run_tests.sh $d $2 $3 > UNIT_TEST_SAMPLE_SUBSET.log
 cd ..
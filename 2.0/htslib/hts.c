@@ -376,6 +376,28 @@ int hts_idx_push(hts_idx_t *idx, int tid, int beg, int end, uint64_t offset, int
     }
 }
 
+int hts_idx_set_meta(hts_idx_t *idx, uint32_t l_meta, uint8_t *meta,
+                      int is_copy)
+{
+    uint8_t *new_meta = meta;
+    if (is_copy) {
+        size_t l = l_meta;
+        if (l > SIZE_MAX - 1) {
+            errno = ENOMEM;
+            return -1;
+        }
+        new_meta = malloc(l + 1);
+        if (!new_meta) return -1;
+        memcpy(new_meta, meta, l);
+        // Prevent possible strlen past the end in tbx_index_load2
+        new_meta[l] = '\0';
+    }
+    if (idx->meta) free(idx->meta);
+    idx->l_meta = l_meta;
+    idx->meta = new_meta;
+    return 0;
+}
+
 void hts_idx_destroy(hts_idx_t *idx)
 {
     khint_t k;
@@ -78,6 +78,18 @@ typedef struct {
     int hts_idx_push(hts_idx_t *idx, int tid, int beg, int end, uint64_t offset, int is_mapped);
     void hts_idx_finish(hts_idx_t *idx, uint64_t final_offset);
 
+/// Set extra index metadata
+/** @param idx      The index
+    @param l_meta   Length of data
+    @param meta     Pointer to the data
+    @param is_copy  If not zero, a copy of the data is taken
+    @return 0 on success; -1 on failure (out of memory).
+
+    For tabix indexes, @p meta contains the tabix configuration followed by
+    the concatenated, NUL-terminated sequence names.
+*/
+int hts_idx_set_meta(hts_idx_t *idx, uint32_t l_meta, uint8_t *meta, int is_copy);
+
 /// Save an index to a file
 /** @param idx  Index to be written
     @param fn   Input BAM/BCF/etc filename, to which .bai/.csi/etc will be added
@@ -6404,6 +6404,17 @@ PglErr PgrGetRaw(uint32_t vidx, PgenGlobalFlags read_gflags, PgenReader* pgrp, u
 }
 
 
+PglErr PgrGetRawVrec(uint32_t vidx, PgenReader* pgrp, const unsigned char** vrec_ptr, uint32_t* vrec_len_ptr) {
+  const unsigned char* fread_end;
+  if (InitReadPtrs(vidx, pgrp, vrec_ptr, &fread_end)) {
+    return kPglRetReadFail;
+  }
+  *vrec_len_ptr = fread_end - (*vrec_ptr);
+  // fp_vidx has advanced without the LD base being loaded, so
+  // LdLoadNecessary() can no longer trust it
+  PgrClearLdCache(pgrp);
+  return kPglRetSuccess;
+}
 // tried to have more custom code, turned out to not be worth it
 PglErr ReadMissingness(const uintptr_t* __restrict sample_include, const uint32_t* __restrict sample_include_cumulative_popcounts, uint32_t sample_ct, uint32_t vidx, PgenReader* pgrp, const unsigned char** fread_pp, const unsigned char** fread_endp, uintptr_t* __restrict missingness, uintptr_t* __restrict hets, uintptr_t* __restrict genovec_buf) {
   const unsigned char* fread_ptr;
@@ -8234,7 +8245,7 @@ uint32_t PwcAppendBiallelicGenovecMain(const uintptr_t* __restrict genovec, uint
     // er, need to use a relative offset in the multithreaded case, absolute
     // position isn't known
     pwcp->vblock_fpos[vidx / kPglVblockSize] = pwcp->vblock_fpos_offset + S_CAST(uintptr_t, pwcp->fwrite_bufp - pwcp->fwrite_buf);
-  } else if (difflist_len > sample_ctd64) {
+  } else if ((difflist_len > sample_ctd64) && (pwcp->ldbase_common_geno != kPglLdbaseUnknown)) {
     // do not use LD compression if there are at least this many differences.
     // tune this threshold in the future.
     const uint32_t ld_diff_threshold = difflist_viable? (difflist_len - sample_ctd64) : max_difflist_len;
@@ -8494,7 +8505,7 @@ uint32_t PwcAppendBiallelicDifflistLimitedMain(const uintptr_t* __restrict rareg
   uint32_t* ldbase_genocounts = pwcp->ldbase_genocounts;
   if (!(vidx % kPglVblockSize)) {
     pwcp->vblock_fpos[vidx / kPglVblockSize] = pwcp->vblock_fpos_offset + S_CAST(uintptr_t, pwcp->fwrite_bufp - pwcp->fwrite_buf);
-  } else if (difflist_len > sample_ctd64) {
+  } else if ((difflist_len > sample_ctd64) && (pwcp->ldbase_common_geno != kPglLdbaseUnknown)) {
     const uint32_t ld_diff_threshold = difflist_viable? (difflist_len - sample_ctd64) : max_difflist_len;
     // number of changes between current genovec and LD reference is bounded
     // below by sum(genocounts[x] - ldbase_genocounts[x]) / 2
@@ -8603,6 +8614,42 @@ PglErr SpgwAppendBiallelicDifflistLimited(const uintptr_t* __restrict raregeno,
 }
 
 
+void PwcAppendRawVrec(const unsigned char* vrec, uint32_t vrec_len, uint32_t vrtype, PgenWriterCommon* pwcp) {
+  const uint32_t vidx = pwcp->vidx;
+  if (!(vidx % kPglVblockSize)) {
+    pwcp->vblock_fpos[vidx / kPglVblockSize] = pwcp->vblock_fpos_offset + S_CAST(uintptr_t, pwcp->fwrite_bufp - pwcp->fwrite_buf);
+  }
+  if (!VrtypeLdCompressed(vrtype)) {
+    // we don't have this record's genotypes, so the next variant passed
+    // through PwcAppendBiallelicGenovecMain() can't be LD-compressed
+    pwcp->ldbase_common_geno = kPglLdbaseUnknown;
+  }
+  pwcp->fwrite_bufp = memcpyua(pwcp->fwrite_bufp, vrec, vrec_len);
+  const uintptr_t vrec_len_byte_ct = pwcp->vrec_len_byte_ct;
+  pwcp->vidx += 1;
+  SubU32Store(vrec_len, vrec_len_byte_ct, &(pwcp->vrec_len_buf[vidx * vrec_len_byte_ct]));
+  if (!pwcp->phase_dosage_gflags) {
+    pwcp->vrtype_buf[vidx / kBitsPerWordD4] |= S_CAST(uintptr_t, vrtype) << (4 * (vidx % kBitsPerWordD4));
+  } else {
+    R_CAST(unsigned char*, pwcp->vrtype_buf)[vidx] = vrtype;
+  }
+}
+
+PglErr SpgwAppendRawVrec(const unsigned char* vrec, uint32_t vrec_len, uint32_t vrtype, STPgenWriter* spgwp) {
+  // flush write buffer if necessary
+  if (spgwp->pwc.fwrite_bufp >= &(spgwp->pwc.fwrite_buf[kPglFwriteBlockSize])) {
+    const uintptr_t cur_byte_ct = spgwp->pwc.fwrite_bufp - spgwp->pwc.fwrite_buf;
+    if (fwrite_checked(spgwp->pwc.fwrite_buf, cur_byte_ct, spgwp->pgen_outfile)) {
+      return kPglRetWriteFail;
+    }
+    spgwp->pwc.vblock_fpos_offset += cur_byte_ct;
+    spgwp->pwc.fwrite_bufp = spgwp->pwc.fwrite_buf;
+  }
+  PwcAppendRawVrec(vrec, vrec_len, vrtype, &(spgwp->pwc));
+  return kPglRetSuccess;
+}
+
+
 PglErr SpgwAppendMultiallelicCounts(__attribute__((unused)) const uintptr_t** __restrict alt_countvecs) {
   // todo
   return kPglRetNotYetSupported;
@@ -890,6 +890,10 @@ PglErr PgfiInitPhase1(const char* fname, uint32_t raw_variant_ct, uint32_t raw_s
 PglErr PgfiInitPhase2(PgenHeaderCtrl header_ctrl, uint32_t allele_cts_already_loaded, uint32_t nonref_flags_already_loaded, uint32_t use_blockload, uint32_t vblock_idx_start, uint32_t vidx_end, uint32_t* max_vrec_width_ptr, PgenFileInfo* pgfip, unsigned char* pgfi_alloc, uintptr_t* pgr_alloc_cacheline_ct_ptr, char* errstr_buf);
 
 
+// Returns index of the non-LD-compressed variant that cur_vidx's record is
+// LD-compressed against.
+uint32_t GetLdbaseVidx(const unsigned char* vrtypes, uint32_t cur_vidx);
+
 uint64_t PgfiMultireadGetCachelineReq(const uintptr_t* variant_include, const PgenFileInfo* pgfip, uint32_t variant_ct, uint32_t block_size);
 
 // variant_include can be nullptr; in that case, we simply load all the
@@ -1038,6 +1042,10 @@ PglErr PgrGetDp(const uintptr_t* __restrict sample_include, const uint32_t* __re
 // (still needs multiallelic and dosage-phase extensions)
 PglErr PgrGetRaw(uint32_t vidx, PgenGlobalFlags read_gflags, PgenReader* pgrp, uintptr_t** loadbuf_iter_ptr, unsigned char* loaded_vrtype_ptr);
 
+// Points *vrec_ptr at the undecoded on-disk record, which remains valid until
+// the next read.  Clears the LD cache.
+PglErr PgrGetRawVrec(uint32_t vidx, PgenReader* pgrp, const unsigned char** vrec_ptr, uint32_t* vrec_len_ptr);
+
 PglErr PgrValidate(PgenReader* pgrp, char* errstr_buf);
 
 // missingness bit is set iff hardcall is not present (even if dosage info *is*
@@ -1095,7 +1103,9 @@ struct PgenWriterCommonStruct {
   unsigned char* fwrite_buf;
   unsigned char* fwrite_bufp;
 
-  uint32_t ldbase_common_geno;  // UINT32_MAX if ldbase_genovec present
+  // UINT32_MAX if ldbase_genovec present, kPglLdbaseUnknown after a raw
+  // record copy
+  uint32_t ldbase_common_geno;
   uint32_t ldbase_difflist_len;
 
   // I'll cache this for now
@@ -1108,6 +1118,10 @@ typedef struct PgenWriterCommonStruct PgenWriterCommon;
 
 CONSTU31(kPglFwriteBlockSize, 131072);
 
+// ldbase_common_geno value which prevents the next variant from being
+// LD-compressed.
+CONSTU31(kPglLdbaseUnknown, 4);
+
 // Given packed arrays of unphased biallelic genotypes in uncompressed plink2
 // binary format (00 = hom ref, 01 = het ref/alt1, 10 = hom alt1, 11 =
 // missing), {Single,Multi}threaded_pgen_writer performs difflist (sparse
@@ -1204,6 +1218,15 @@ void PwcAppendBiallelicGenovecDphase16(const uintptr_t* __restrict genovec, cons
 
 PglErr SpgwAppendBiallelicGenovecDphase16(const uintptr_t* __restrict genovec, const uintptr_t* __restrict phasepresent, const uintptr_t* __restrict phaseinfo, const uintptr_t* __restrict dosage_present, const uintptr_t* dphase_present, const uint16_t* dosage_main, const int16_t* dphase_delta, uint32_t dosage_ct, uint32_t dphase_ct, STPgenWriter* spgwp);
 
+// Appends a record copied verbatim from another .pgen with the same sample
+// set.  vrec_len must not exceed max_vrec_len.  If vrtype is LD-compressed,
+// the caller is responsible for ensuring that the previous non-LD-compressed
+// record in the current variant block is the same one it was compressed
+// against.
+void PwcAppendRawVrec(const unsigned char* vrec, uint32_t vrec_len, uint32_t vrtype, PgenWriterCommon* pwcp);
+
+PglErr SpgwAppendRawVrec(const unsigned char* vrec, uint32_t vrec_len, uint32_t vrtype, STPgenWriter* spgwp);
+
 // Backfills header info, then closes the file.
 PglErr SpgwFinish(STPgenWriter* spgwp);
 
@@ -22,6 +22,7 @@
 #include "plink2_import.h"
 #include "plink2_ld.h"
 #include "plink2_matrix_calc.h"
+#include "plink2_merge.h"
 #include "plink2_misc.h"
 #include "plink2_psam.h"
 #include "plink2_pvar.h"
@@ -109,7 +110,8 @@ FLAGSET_DEF_START()
   kfXloadOxLegend = (1 << 6),
   kfXloadPlink1Dosage = (1 << 7),
   kfXloadMap = (1 << 8),
-  kfXloadGenDummy = (1 << 9)
+  kfXloadGenDummy = (1 << 9),
+  kfXloadPmergeList = (1 << 10)
 FLAGSET_DEF_END(Xload);
 
 
@@ -155,7 +157,8 @@ FLAGSET64_DEF_START()
   kfCommand1Score = (1 << 15),
   kfCommand1WriteCovar = (1 << 16),
   kfCommand1WriteSamples = (1 << 17),
-  kfCommand1Ld = (1 << 18)
+  kfCommand1Ld = (1 << 18),
+  kfCommand1PcaProject = (1 << 19)
 FLAGSET64_DEF_END(Command1Flags);
 
 // this is a hybrid, only kfSortFileSid is actually a flag
@@ -203,6 +206,7 @@ typedef struct Plink2CmdlineStruct {
   double king_cutoff;
   double king_table_filter;
   double king_table_subset_thresh;
+  double sparse_cutoff;
   FreqRptFlags freq_rpt_flags;
   MissingRptFlags missing_rpt_flags;
   GenoCountsFlags geno_counts_flags;
@@ -210,6 +214,7 @@ typedef struct Plink2CmdlineStruct {
   GlmInfo glm_info;
   AdjustInfo adjust_info;
   ScoreInfo score_info;
+  BgenDirectInfo bgen_direct_info;
   APerm aperm;
   CmpExpr keep_if_expr;
   CmpExpr remove_if_expr;
@@ -251,6 +256,7 @@ typedef struct Plink2CmdlineStruct {
   uint32_t max_thread_ct;
   uint32_t parallel_idx;
   uint32_t parallel_tot;
+  uint32_t checkpoint_interval;
   uint32_t exportf_bits;
   uint32_t mwithin_val;
   uint32_t min_bp_space;
@@ -299,6 +305,8 @@ typedef struct Plink2CmdlineStruct {
   char* loop_cats_phenoname;
   char* ref_from_fa_fname;
   char* king_table_subset_fname;
+  char* pca_project_var_wts_fname;
+  char* pca_project_eigval_fname;
   char* require_info_flattened;
   char* require_no_info_flattened;
   char* keep_fcol_fname;
@@ -310,12 +318,12 @@ typedef struct Plink2CmdlineStruct {
 } Plink2Cmdline;
 
 uint32_t SingleVariantLoaderIsNeeded(const char* king_cutoff_fprefix, Command1Flags command_flags1, MakePlink2Flags make_plink2_flags) {
-  return (command_flags1 & (kfCommand1Exportf | kfCommand1MakeKing | kfCommand1GenoCounts | kfCommand1LdPrune | kfCommand1Validate | kfCommand1Pca | kfCommand1MakeRel | kfCommand1Glm | kfCommand1Score | kfCommand1Ld)) || ((command_flags1 & kfCommand1MakePlink2) && (make_plink2_flags & kfMakePgen)) || ((command_flags1 & kfCommand1KingCutoff) && (!king_cutoff_fprefix));
+  return (command_flags1 & (kfCommand1Exportf | kfCommand1MakeKing | kfCommand1GenoCounts | kfCommand1LdPrune | kfCommand1Validate | kfCommand1Pca | kfCommand1MakeRel | kfCommand1Glm | kfCommand1Score | kfCommand1Ld | kfCommand1PcaProject)) || ((command_flags1 & kfCommand1MakePlink2) && (make_plink2_flags & kfMakePgen)) || ((command_flags1 & kfCommand1KingCutoff) && (!king_cutoff_fprefix));
 }
 
 
 uint32_t DecentAlleleFreqsAreNeeded(Command1Flags command_flags1, ScoreFlags score_flags) {
-  return (command_flags1 & (kfCommand1Pca | kfCommand1MakeRel)) || ((command_flags1 & kfCommand1Score) && ((!(score_flags & kfScoreNoMeanimpute)) || (score_flags & (kfScoreCenter | kfScoreVarianceStandardize))));
+  return (command_flags1 & (kfCommand1Pca | kfCommand1MakeRel | kfCommand1PcaProject)) || ((command_flags1 & kfCommand1Score) && ((!(score_flags & kfScoreNoMeanimpute)) || (score_flags & (kfScoreCenter | kfScoreVarianceStandardize))));
 }
 
 uint32_t MajAllelesAreNeeded(Command1Flags command_flags1, GlmFlags glm_flags) {
@@ -378,8 +386,7 @@ uint32_t FounderRawGenoCtsAreNeeded(Command1Flags command_flags1, MiscFlags misc
 }
 
 uint32_t InfoReloadIsNeeded(Command1Flags command_flags1, PvarPsamFlags pvar_psam_flags, ExportfFlags exportf_flags) {
-  // add kfExportfBcf later
-  return ((command_flags1 & kfCommand1MakePlink2) && (pvar_psam_flags & kfPvarColXinfo)) || ((command_flags1 & kfCommand1Exportf) && (exportf_flags & kfExportfVcf));
+  return ((command_flags1 & kfCommand1MakePlink2) && (pvar_psam_flags & kfPvarColXinfo)) || ((command_flags1 & kfCommand1Exportf) && (exportf_flags & (kfExportfBcf | kfExportfVcf)));
 }
 
 uint32_t GrmKeepIsNeeded(Command1Flags command_flags1, PcaFlags pca_flags) {
@@ -530,8 +537,11 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
   PglErr reterr = kPglRetSuccess;
   PgenFileInfo pgfi;
   PgenReader simple_pgr;
+  BgenReader bgen_direct_r;
+  BgenReader* bgen_direct_rp = nullptr;
   PreinitPgfi(&pgfi);
   PreinitPgr(&simple_pgr);
+  PreinitBgenReader(&bgen_direct_r);
   {
     // this predicate will need to exclude --merge-list special case later
     uint32_t pvar_renamed = 0;
@@ -665,6 +675,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
     uintptr_t* pvar_filter_present = nullptr;
     uintptr_t* pvar_filter_npass = nullptr;
     const char* const* pvar_filter_storage = nullptr;
+    const char* const* pvar_info_strs = nullptr;
     uintptr_t* nonref_flags = nullptr;
     InfoFlags info_flags = kfInfo0;
     uint32_t max_allele_slen = 0;
@@ -674,7 +685,8 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
     ChrIdx* chr_idxs = nullptr;  // split-chromosome case only
     if (pvarname[0]) {
       char** pvar_filter_storage_mutable = nullptr;
-      reterr = LoadPvar(pvarname, pcp->var_filter_exceptions_flattened, pcp->varid_template, pcp->missing_varid_match, pcp->require_info_flattened, pcp->require_no_info_flattened, pcp->extract_if_info_expr, pcp->exclude_if_info_expr, pcp->misc_flags, pcp->pvar_psam_flags, pcp->exportf_flags, pcp->var_min_qual, pcp->splitpar_bound1, pcp->splitpar_bound2, pcp->new_variant_id_max_allele_slen, (pcp->filter_flags / kfFilterSnpsOnly) & 3, !(pcp->dependency_flags & kfFilterNoSplitChr), pcp->max_thread_ct, cip, &max_variant_id_slen, &info_reload_slen, &vpos_sortstatus, &xheader, &variant_include, &variant_bps, &variant_ids_mutable, &variant_allele_idxs, K_CAST(const char***, &allele_storage_mutable), &pvar_qual_present, &pvar_quals, &pvar_filter_present, &pvar_filter_npass, &pvar_filter_storage_mutable, &nonref_flags, &variant_cms, &chr_idxs, &raw_variant_ct, &variant_ct, &max_allele_slen, &xheader_blen, &info_flags, &max_filter_slen);
+      char** pvar_info_strs_mutable = nullptr;
+      reterr = LoadPvar(pvarname, pcp->var_filter_exceptions_flattened, pcp->varid_template, pcp->missing_varid_match, pcp->require_info_flattened, pcp->require_no_info_flattened, pcp->extract_if_info_expr, pcp->exclude_if_info_expr, pcp->misc_flags, pcp->pvar_psam_flags, pcp->exportf_flags, pcp->var_min_qual, pcp->splitpar_bound1, pcp->splitpar_bound2, pcp->new_variant_id_max_allele_slen, (pcp->filter_flags / kfFilterSnpsOnly) & 3, !(pcp->dependency_flags & kfFilterNoSplitChr), pcp->max_thread_ct, cip, &max_variant_id_slen, &info_reload_slen, &vpos_sortstatus, &xheader, &variant_include, &variant_bps, &variant_ids_mutable, &variant_allele_idxs, K_CAST(const char***, &allele_storage_mutable), &pvar_qual_present, &pvar_quals, &pvar_filter_present, &pvar_filter_npass, &pvar_filter_storage_mutable, &nonref_flags, &variant_cms, &chr_idxs, &pvar_info_strs_mutable, &raw_variant_ct, &variant_ct, &max_allele_slen, &xheader_blen, &info_flags, &max_filter_slen);
       if (reterr) {
         goto Plink2Core_ret_1;
       }
@@ -689,6 +701,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
         }
       }
       pvar_filter_storage = TO_CONSTCPCONSTP(pvar_filter_storage_mutable);
+      pvar_info_strs = TO_CONSTCPCONSTP(pvar_info_strs_mutable);
       if (variant_ct == raw_variant_ct) {
         logprintfww("%u variant%s loaded from %s.\n", variant_ct, (variant_ct == 1)? "" : "s", pvarname);
       } else {
@@ -759,7 +772,19 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
 
     const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
     uintptr_t pgr_alloc_cacheline_ct = 0;
-    if (pgenname[0]) {
+    if (pgenname[0] && (pcp->misc_flags & kfMiscBgenDirect)) {
+      // --bgen 'direct': pgenname still points to the .bgen.
+      pgfi.raw_variant_ct = raw_variant_ct;
+      pgfi.raw_sample_ct = raw_sample_ct;
+      pgfi.max_alt_allele_ct = 1;
+      pgfi.allele_idx_offsets = variant_allele_idxs;
+      reterr = BgenReaderInit(pgenname, &(pcp->bgen_direct_info), raw_variant_ct, raw_sample_ct, &bgen_direct_r, &pgfi.gflags);
+      if (reterr) {
+        goto Plink2Core_ret_1;
+      }
+      pgfi.nonref_flags = nonref_flags;
+      bgen_direct_rp = &bgen_direct_r;
+    } else if (pgenname[0]) {
       PgenHeaderCtrl header_ctrl;
       uintptr_t cur_alloc_cacheline_ct;
       while (1) {
@@ -1067,6 +1092,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
     uint32_t* sample_missing_dosage_cts = nullptr;
     uint32_t* sample_missing_hc_cts = nullptr;
     uint32_t* sample_hethap_cts = nullptr;
+    uint32_t sample_missing_cts_deferred = 0;
     uintptr_t max_covar_name_blen = 0;
     if (psamname[0]) {
       // xid_mode may vary between these operations in a single run, and
@@ -1157,7 +1183,15 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
       }
 
       const uint32_t smaj_missing_geno_report_requested = (pcp->command_flags1 & kfCommand1MissingReport) && (!(pcp->missing_rpt_flags & kfMissingRptVariantOnly));
+      // When --mind doesn't need them up front, sample missingness counts are
+      // filled in by the main LoadAlleleAndGenoCounts() pass instead, saving
+      // a full read of the .pgen.
+      sample_missing_cts_deferred = smaj_missing_geno_report_requested && (pcp->mind_thresh == 1.0) && (!variant_allele_idxs);
       if ((pcp->mind_thresh < 1.0) || smaj_missing_geno_report_requested) {
+        if (bgen_direct_rp) {
+          logerrputs("Error: --mind is not supported in --bgen 'direct' mode.\n");
+          goto Plink2Core_ret_INVALID_CMDLINE;
+        }
         if (bigstack_alloc_u32(raw_sample_ct, &sample_missing_hc_cts) ||
             bigstack_alloc_u32(raw_sample_ct, &sample_hethap_cts)) {
           goto Plink2Core_ret_NOMEM;
@@ -1171,8 +1205,8 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
             sample_missing_dosage_cts = sample_missing_hc_cts;
           }
         }
-        // could avoid this call and make LoadAlleleAndGenoCounts() do
-        // double duty with --missing?
+      }
+      if ((pcp->mind_thresh < 1.0) || (smaj_missing_geno_report_requested && (!sample_missing_cts_deferred))) {
         reterr = LoadSampleMissingCts(sex_male, variant_include, cip, raw_variant_ct, variant_ct, raw_sample_ct, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, sample_missing_hc_cts, (pgfi.gflags & kfPgenGlobalDosagePresent)? sample_missing_dosage_cts : nullptr, sample_hethap_cts);
         if (reterr) {
           goto Plink2Core_ret_1;
@@ -1606,7 +1640,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
             }
           }
         }
-        if (allele_dosages || founder_allele_dosages || variant_missing_hc_cts || variant_missing_dosage_cts || variant_hethap_cts || raw_geno_cts || founder_raw_geno_cts || mach_r2_vals) {
+        if (allele_dosages || founder_allele_dosages || variant_missing_hc_cts || variant_missing_dosage_cts || variant_hethap_cts || raw_geno_cts || founder_raw_geno_cts || mach_r2_vals || sample_missing_cts_deferred) {
           // note that --geno depends on different handling of X/Y than --maf.
 
           // possible todo: "free" these arrays early in some cases
@@ -1619,7 +1653,17 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
           // hardcall-missing-count slot... and it's NOT fine to pass in
           // nullptrs for both missing-count arrays...
           const uint32_t dosageless_file = !(pgfi.gflags & kfPgenGlobalDosagePresent);
-          reterr = LoadAlleleAndGenoCounts(sample_include, founder_info, sex_nm, sex_male, variant_include, cip, variant_allele_idxs, raw_sample_ct, sample_ct, founder_ct, male_ct, nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, allele_dosages, founder_allele_dosages, ((!variant_missing_hc_cts) && dosageless_file)? variant_missing_dosage_cts : variant_missing_hc_cts, dosageless_file? nullptr : variant_missing_dosage_cts, variant_hethap_cts, raw_geno_cts, founder_raw_geno_cts, x_male_geno_cts, founder_x_male_geno_cts, x_nosex_geno_cts, founder_x_nosex_geno_cts, mach_r2_vals);
+          if (bgen_direct_rp) {
+            if (variant_missing_hc_cts || variant_missing_dosage_cts || variant_hethap_cts || raw_geno_cts || founder_raw_geno_cts || mach_r2_vals) {
+              logerrputs("Error: --bgen 'direct' mode currently only supports allele-frequency-based\nvariant filters (--maf, --max-maf, --mac, --max-mac).\n");
+              goto Plink2Core_ret_INVALID_CMDLINE;
+            }
+            reterr = BgenLoadAlleleDosages(sample_include, founder_info, sex_male, variant_include, cip, variant_allele_idxs, variant_ct, pcp->max_thread_ct, bgen_direct_rp, allele_dosages, founder_allele_dosages);
+          } else if (pcp->misc_flags & kfMiscFreqCache) {
+            reterr = LoadAlleleAndGenoCountsCached(pgenname, sample_include, founder_info, sex_nm, sex_male, variant_include, cip, variant_allele_idxs, raw_sample_ct, sample_ct, founder_ct, male_ct, nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, x_start, x_len, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, allele_dosages, founder_allele_dosages, ((!variant_missing_hc_cts) && dosageless_file)? variant_missing_dosage_cts : variant_missing_hc_cts, dosageless_file? nullptr : variant_missing_dosage_cts, variant_hethap_cts, raw_geno_cts, founder_raw_geno_cts, x_male_geno_cts, founder_x_male_geno_cts, x_nosex_geno_cts, founder_x_nosex_geno_cts, mach_r2_vals, sample_missing_cts_deferred? sample_missing_hc_cts : nullptr, (sample_missing_cts_deferred && (!dosageless_file))? sample_missing_dosage_cts : nullptr, sample_missing_cts_deferred? sample_hethap_cts : nullptr);
+          } else {
+            reterr = LoadAlleleAndGenoCounts(sample_include, founder_info, sex_nm, sex_male, variant_include, cip, variant_allele_idxs, raw_sample_ct, sample_ct, founder_ct, male_ct, nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, allele_dosages, founder_allele_dosages, ((!variant_missing_hc_cts) && dosageless_file)? variant_missing_dosage_cts : variant_missing_hc_cts, dosageless_file? nullptr : variant_missing_dosage_cts, variant_hethap_cts, raw_geno_cts, founder_raw_geno_cts, x_male_geno_cts, founder_x_male_geno_cts, x_nosex_geno_cts, founder_x_nosex_geno_cts, mach_r2_vals, sample_missing_cts_deferred? sample_missing_hc_cts : nullptr, (sample_missing_cts_deferred && (!dosageless_file))? sample_missing_dosage_cts : nullptr, sample_missing_cts_deferred? sample_hethap_cts : nullptr);
+          }
           if (reterr) {
             goto Plink2Core_ret_1;
           }
@@ -1776,7 +1820,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
             if (king_cutoff_fprefix) {
               reterr = KingCutoffBatch(&pii.sii, raw_sample_ct, pcp->king_cutoff, sample_include, king_cutoff_fprefix, &sample_ct);
             } else {
-              reterr = CalcKing(&pii.sii, variant_include, cip, raw_sample_ct, raw_variant_ct, variant_ct, pcp->king_cutoff, pcp->king_table_filter, pcp->king_flags, pcp->parallel_idx, pcp->parallel_tot, pcp->max_thread_ct, &simple_pgr, sample_include, &sample_ct, outname, outname_end);
+              reterr = CalcKing(&pii.sii, variant_include, cip, raw_sample_ct, raw_variant_ct, variant_ct, pcp->king_cutoff, pcp->king_table_filter, (pcp->sparse_cutoff == -DBL_MAX)? kKingSparseCutoffDefault : pcp->sparse_cutoff, pcp->king_flags, pcp->parallel_idx, pcp->parallel_tot, pcp->checkpoint_interval, pcp->max_thread_ct, &simple_pgr, sample_include, &sample_ct, outname, outname_end);
             }
             if (reterr) {
               goto Plink2Core_ret_1;
@@ -1803,7 +1847,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
         }
       }
       if ((pcp->command_flags1 & kfCommand1MakeRel) || keep_grm) {
-        reterr = CalcGrm(sample_include, &pii.sii, variant_include, cip, variant_allele_idxs, maj_alleles, allele_freqs, raw_sample_ct, sample_ct, raw_variant_ct, variant_ct, pcp->grm_flags, pcp->parallel_idx, pcp->parallel_tot, pcp->max_thread_ct, &simple_pgr, outname, outname_end, keep_grm? (&grm) : nullptr);
+        reterr = CalcGrm(sample_include, &pii.sii, variant_include, cip, variant_allele_idxs, maj_alleles, allele_freqs, raw_sample_ct, sample_ct, raw_variant_ct, variant_ct, (pcp->sparse_cutoff == -DBL_MAX)? kGrmSparseCutoffDefault : pcp->sparse_cutoff, pcp->grm_flags, pcp->parallel_idx, pcp->parallel_tot, pcp->checkpoint_interval, pcp->max_thread_ct, &simple_pgr, outname, outname_end, keep_grm? (&grm) : nullptr);
         if (reterr) {
           goto Plink2Core_ret_1;
         }
@@ -1888,6 +1932,15 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
         }
       }
 #endif
+      if (pcp->command_flags1 & kfCommand1PcaProject) {
+        if (!pcp->read_freq_fname) {
+          logerrputs("Warning: --pca-project was used without --read-freq, so genotypes are\nstandardized with allele frequencies from the current samples instead of the\nreference panel.  Projections will be off unless the two frequency spectra are\nvery similar.\n");
+        }
+        reterr = PcaProject(sample_include, &pii.sii, variant_include, variant_ids, variant_allele_idxs, allele_storage, allele_freqs, pcp->pca_project_var_wts_fname, pcp->pca_project_eigval_fname, raw_sample_ct, sample_ct, raw_variant_ct, variant_ct, max_variant_id_slen, pcp->max_thread_ct, &simple_pgr, outname, outname_end);
+        if (reterr) {
+          goto Plink2Core_ret_1;
+        }
+      }
 
       if (pcp->command_flags1 & kfCommand1WriteSnplist) {
         reterr = WriteSnplist(variant_include, variant_ids, variant_ct, (pcp->misc_flags / kfMiscWriteSnplistZs) & 1, pcp->max_thread_ct, outname, outname_end);
@@ -1987,7 +2040,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
               logerrputs("Error: --ref-from-fa requires a sorted .pvar/.bim.  Retry this command after\nusing --make-pgen/--make-bed + --sort-vars to sort your data.\n");
               goto Plink2Core_ret_INCONSISTENT_INPUT;
             }
-            reterr = RefFromFa(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, pcp->ref_from_fa_fname, max_allele_slen, (pcp->misc_flags / kfMiscRefFromFaForce) & 1, refalt1_select, nonref_flags);
+            reterr = RefFromFa(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, pcp->ref_from_fa_fname, max_allele_slen, (pcp->misc_flags / kfMiscRefFromFaForce) & 1, pcp->max_thread_ct, refalt1_select, nonref_flags);
             if (reterr) {
               goto Plink2Core_ret_1;
             }
@@ -2099,12 +2152,12 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
         if (pcp->command_flags1 & kfCommand1MakePlink2) {
           // todo: unsorted case (--update-chr, etc.)
           if (pcp->sort_vars_flags != kfSort0) {
-            reterr = MakePlink2Vsort(xheader, sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, new_sample_idx_to_old, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, variant_cms, chr_idxs, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, pcp->hard_call_thresh, pcp->dosage_erase_thresh, make_plink2_flags, (pcp->sort_vars_flags == kfSortNatural), pcp->pvar_psam_flags, &simple_pgr, outname, outname_end);
+            reterr = MakePlink2Vsort(xheader, sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, new_sample_idx_to_old, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, pvar_info_strs, variant_cms, chr_idxs, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, pcp->hard_call_thresh, pcp->dosage_erase_thresh, make_plink2_flags, (pcp->sort_vars_flags == kfSortNatural), pcp->pvar_psam_flags, pgr_alloc_cacheline_ct, &pgfi, &simple_pgr, outname, outname_end);
           } else {
             if (vpos_sortstatus & kfUnsortedVarBp) {
               logerrputs("Warning: Variants are not sorted by position.  Consider rerunning with the\n--sort-vars flag added to remedy this.\n");
             }
-            reterr = MakePlink2NoVsort(xheader, sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, new_sample_idx_to_old, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, variant_cms, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, pcp->hard_call_thresh, pcp->dosage_erase_thresh, make_plink2_flags, pcp->pvar_psam_flags, pgr_alloc_cacheline_ct, &pgfi, &simple_pgr, outname, outname_end);
+            reterr = MakePlink2NoVsort(xheader, sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, new_sample_idx_to_old, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, pvar_info_strs, variant_cms, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, pcp->hard_call_thresh, pcp->dosage_erase_thresh, make_plink2_flags, pcp->pvar_psam_flags, pgr_alloc_cacheline_ct, &pgfi, &simple_pgr, outname, outname_end);
           }
           if (reterr) {
             goto Plink2Core_ret_1;
@@ -2113,7 +2166,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
         }
 
         if (pcp->command_flags1 & kfCommand1Exportf) {
-          reterr = Exportf(sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, variant_cms, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, make_plink2_flags, pcp->exportf_flags, pcp->exportf_id_paste, pcp->exportf_id_delim, pcp->exportf_bits, pgr_alloc_cacheline_ct, xheader, &pgfi, &simple_pgr, outname, outname_end);
+          reterr = Exportf(sample_include, &pii, sex_nm, sex_male, pheno_cols, pheno_names, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, info_reload_slen? pvarname : nullptr, pvar_info_strs, variant_cms, xheader_blen, info_flags, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, pcp->max_thread_ct, make_plink2_flags, pcp->exportf_flags, pcp->exportf_id_paste, pcp->exportf_id_delim, pcp->exportf_bits, pgr_alloc_cacheline_ct, xheader, &pgfi, &simple_pgr, outname, outname_end);
           if (reterr) {
             goto Plink2Core_ret_1;
           }
@@ -2151,7 +2204,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
       }
 
       if (pcp->command_flags1 & kfCommand1Score) {
-        reterr = ScoreReport(sample_include, &pii.sii, sex_male, pheno_cols, pheno_names, variant_include, cip, variant_ids, variant_allele_idxs, allele_storage, allele_freqs, &(pcp->score_info), raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_variant_id_slen, pcp->xchr_model, pcp->max_thread_ct, &simple_pgr, outname, outname_end);
+        reterr = ScoreReport(sample_include, &pii.sii, sex_male, pheno_cols, pheno_names, variant_include, cip, variant_ids, variant_allele_idxs, allele_storage, allele_freqs, &(pcp->score_info), raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, raw_variant_ct, variant_ct, max_variant_id_slen, pcp->xchr_model, pcp->max_thread_ct, &simple_pgr, bgen_direct_rp, outname, outname_end);
         if (reterr) {
           goto Plink2Core_ret_1;
         }
@@ -2159,7 +2212,7 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
       // eventually check for nonzero pheno_ct here?
 
       if (pcp->command_flags1 & kfCommand1Glm) {
-        reterr = GlmMain(sample_include, &pii.sii, sex_nm, sex_male, pheno_cols, pheno_names, covar_cols, covar_names, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, maj_alleles, allele_storage, &(pcp->glm_info), &(pcp->adjust_info), &(pcp->aperm), pcp->glm_local_covar_fname, pcp->glm_local_pvar_fname, pcp->glm_local_psam_fname, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, covar_ct, max_covar_name_blen, raw_variant_ct, variant_ct, max_variant_id_slen, max_allele_slen, pcp->xchr_model, pcp->ci_size, pcp->vif_thresh, pcp->pfilter, pcp->output_min_p, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, &simple_pgr, outname, outname_end);
+        reterr = GlmMain(sample_include, &pii.sii, sex_nm, sex_male, pheno_cols, pheno_names, covar_cols, covar_names, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, maj_alleles, allele_storage, &(pcp->glm_info), &(pcp->adjust_info), &(pcp->aperm), pcp->glm_local_covar_fname, pcp->glm_local_pvar_fname, pcp->glm_local_psam_fname, raw_sample_ct, sample_ct, pheno_ct, max_pheno_name_blen, covar_ct, max_covar_name_blen, raw_variant_ct, variant_ct, max_variant_id_slen, max_allele_slen, pcp->xchr_model, pcp->ci_size, pcp->vif_thresh, pcp->pfilter, pcp->output_min_p, pcp->max_thread_ct, pgr_alloc_cacheline_ct, &pgfi, &simple_pgr, bgen_direct_rp, outname, outname_end);
         if (reterr) {
           goto Plink2Core_ret_1;
         }
@@ -2196,6 +2249,9 @@ PglErr Plink2Core(const Plink2Cmdline* pcp, MakePlink2Flags make_plink2_flags, c
   CleanupPhenoCols(pheno_ct, pheno_cols);
   free_cond(covar_names);
   free_cond(pheno_names);
+  if (CleanupBgenReader(&bgen_direct_r) && (!reterr)) {
+    reterr = kPglRetReadFail;
+  }
   if (CleanupPgr(&simple_pgr) && (!reterr)) {
     reterr = kPglRetReadFail;
   }
@@ -2422,7 +2478,9 @@ void GetExportfTargets(const char* const* argvk, uint32_t param_ct, ExportfFlags
       }
       break;
     case 'b':
-      if (!strcmp(cur_modif2, "eagle")) {
+      if (!strcmp(cur_modif2, "cf")) {
+        cur_format = kfExportfBcf;
+      } else if (!strcmp(cur_modif2, "eagle")) {
         cur_format = kfExportfBeagle;
       } else if (!strcmp(cur_modif2, "eagle-nomap")) {
         cur_format = kfExportfBeagleNomap;
@@ -2664,6 +2722,8 @@ int main(int argc, char** argv) {
   pc.loop_cats_phenoname = nullptr;
   pc.ref_from_fa_fname = nullptr;
   pc.king_table_subset_fname = nullptr;
+  pc.pca_project_var_wts_fname = nullptr;
+  pc.pca_project_eigval_fname = nullptr;
   pc.require_info_flattened = nullptr;
   pc.require_no_info_flattened = nullptr;
   pc.keep_fcol_fname = nullptr;
@@ -2672,6 +2732,8 @@ int main(int argc, char** argv) {
   pc.ref_allele_flag = nullptr;
   pc.alt1_allele_flag = nullptr;
   pc.update_name_flag = nullptr;
+  pc.bgen_direct_info.idxname[0] = '\0';
+  pc.bgen_direct_info.idx_generated = 0;
   InitRangeList(&pc.snps_range_list);
   InitRangeList(&pc.exclude_snps_range_list);
   InitRangeList(&pc.pheno_range_list);
@@ -2938,6 +3000,7 @@ int main(int argc, char** argv) {
     pc.king_flags = kfKing0;
     pc.king_cutoff = -1;
     pc.king_table_filter = -DBL_MAX;
+    pc.sparse_cutoff = -DBL_MAX;
     pc.freq_rpt_flags = kfAlleleFreq0;
     pc.missing_rpt_flags = kfMissingRpt0;
     pc.geno_counts_flags = kfGenoCounts0;
@@ -2986,6 +3049,7 @@ int main(int argc, char** argv) {
     pc.xchr_model = 2;
     pc.parallel_idx = 0;
     pc.parallel_tot = 1;
+    pc.checkpoint_interval = 0;
     pc.exportf_bits = 0;
     pc.mwithin_val = 1;
     pc.min_bp_space = 0;
@@ -3436,12 +3500,15 @@ int main(int argc, char** argv) {
           if (load_params || xload) {
             goto main_ret_INVALID_CMDLINE_INPUT_CONFLICT;
           }
-          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 3)) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 4)) {
             goto main_ret_INVALID_CMDLINE_2A;
           }
           for (uint32_t param_idx = 2; param_idx <= param_ct; ++param_idx) {
             const char* cur_modif = argvk[arg_idx + param_idx];
-            if (!strcmp(cur_modif, "snpid-chr")) {
+            if (!strcmp(cur_modif, "direct")) {
+              oxford_import_flags |= kfOxfordImportBgenDirect;
+              pc.misc_flags |= kfMiscBgenDirect;
+            } else if (!strcmp(cur_modif, "snpid-chr")) {
               oxford_import_flags |= kfOxfordImportBgenSnpIdChr;
             } else if (!strcmp(cur_modif, "ref-first")) {
               oxford_import_flags |= kfOxfordImportRefFirst;
@@ -3714,6 +3781,19 @@ int main(int argc, char** argv) {
           }
           pc.pheno_transform_flags |= kfPhenoTransformVstdCovar;
           pc.dependency_flags |= kfFilterPsamReq;
+        } else if (strequal_k_unsafe(flagname_p2, "heckpoint")) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 0, 1)) {
+            goto main_ret_INVALID_CMDLINE_2A;
+          }
+          // interval is specified in minutes, stored in seconds
+          uint32_t checkpoint_minutes = 60;
+          if (param_ct) {
+            if (ScanPosintCapped(argvk[arg_idx + 1], 0x7fffffff / 60, &checkpoint_minutes)) {
+              snprintf(g_logbuf, kLogbufSize, "Error: Invalid --checkpoint interval '%s'.\n", argvk[arg_idx + 1]);
+              goto main_ret_INVALID_CMDLINE_WWA;
+            }
+          }
+          pc.checkpoint_interval = checkpoint_minutes * 60;
         } else {
           goto main_ret_INVALID_CMDLINE_UNRECOGNIZED;
         }
@@ -3971,9 +4051,8 @@ int main(int argc, char** argv) {
             const char* cur_modif = argvk[arg_idx + param_idx];
             const uint32_t cur_modif_slen = strlen(cur_modif);
             if (StrStartsWith(cur_modif, "id-paste=", cur_modif_slen)) {
-              if (!(pc.exportf_flags & (kfExportfVcf | kfExportfBgen12 | kfExportfBgen13))) {
-                // todo: bcf
-                logerrputs("Error: The 'id-paste' modifier only applies to --export's vcf, bgen-1.2, and\nbgen-1.3 output formats.\n");
+              if (!(pc.exportf_flags & (kfExportfBcf | kfExportfVcf | kfExportfBgen12 | kfExportfBgen13))) {
+                logerrputs("Error: The 'id-paste' modifier only applies to --export's bcf, vcf, bgen-1.2,\nand bgen-1.3 output formats.\n");
                 goto main_ret_INVALID_CMDLINE_A;
               }
               if (pc.exportf_id_paste) {
@@ -3985,8 +4064,8 @@ int main(int argc, char** argv) {
                 goto main_ret_1;
               }
             } else if (StrStartsWith(cur_modif, "id-delim=", cur_modif_slen)) {
-              if (!(pc.exportf_flags & (kfExportfVcf | kfExportfBgen12 | kfExportfBgen13))) {
-                logerrputs("Error: The 'id-delim' modifier only applies to --export's vcf, bgen-1.2, and\nbgen-1.3 output formats.\n");
+              if (!(pc.exportf_flags & (kfExportfBcf | kfExportfVcf | kfExportfBgen12 | kfExportfBgen13))) {
+                logerrputs("Error: The 'id-delim' modifier only applies to --export's bcf, vcf, bgen-1.2,\nand bgen-1.3 output formats.\n");
                 goto main_ret_INVALID_CMDLINE_A;
               }
               if (pc.exportf_id_delim) {
@@ -4003,8 +4082,8 @@ int main(int argc, char** argv) {
                 goto main_ret_INVALID_CMDLINE;
               }
             } else if (StrStartsWith(cur_modif, "vcf-dosage=", cur_modif_slen)) {
-              if (!(pc.exportf_flags & kfExportfVcf)) {
-                logerrputs("Error: The 'vcf-dosage' modifier only applies to --export's vcf output format.\n");
+              if (!(pc.exportf_flags & (kfExportfBcf | kfExportfVcf))) {
+                logerrputs("Error: The 'vcf-dosage' modifier only applies to --export's bcf and vcf output\nformats.\n");
                 goto main_ret_INVALID_CMDLINE_A;
               }
               if (pc.exportf_flags & (kfExportfVcfDosageGp | kfExportfVcfDosageDs | kfExportfVcfDosageHds)) {
@@ -4026,6 +4105,24 @@ int main(int argc, char** argv) {
                 snprintf(g_logbuf, kLogbufSize, "Error: Invalid --export vcf-dosage= parameter '%s'.\n", vcf_dosage_start);
                 goto main_ret_INVALID_CMDLINE_WWA;
               }
+            } else if (StrStartsWith(cur_modif, "vcf-index=", cur_modif_slen)) {
+              if (!(pc.exportf_flags & kfExportfVcf)) {
+                logerrputs("Error: The 'vcf-index' modifier only applies to --export's vcf output format.\n");
+                goto main_ret_INVALID_CMDLINE_A;
+              }
+              if (pc.exportf_flags & (kfExportfVcfIndexTbi | kfExportfVcfIndexCsi)) {
+                logerrputs("Error: Multiple --export vcf-index= modifiers.\n");
+                goto main_ret_INVALID_CMDLINE;
+              }
+              const char* vcf_index_start = &(cur_modif[strlen("vcf-index=")]);
+              if (!strcmp(vcf_index_start, "tbi")) {
+                pc.exportf_flags |= kfExportfVcfIndexTbi;
+              } else if (!strcmp(vcf_index_start, "csi")) {
+                pc.exportf_flags |= kfExportfVcfIndexCsi;
+              } else {
+                snprintf(g_logbuf, kLogbufSize, "Error: Invalid --export vcf-index= parameter '%s'.\n", vcf_index_start);
+                goto main_ret_INVALID_CMDLINE_WWA;
+              }
             } else if (StrStartsWith(cur_modif, "bits=", cur_modif_slen)) {
               if (!(pc.exportf_flags & (kfExportfBgen12 | kfExportfBgen13))) {
                 logerrputs("Error: The 'bits' modifier only applies to --export's bgen-1.2 and bgen-1.3\noutput formats.\n");
@@ -4040,6 +4137,12 @@ int main(int argc, char** argv) {
                 snprintf(g_logbuf, kLogbufSize, "Error: Invalid --export bits= parameter '%s'.\n", bits_start);
                 goto main_ret_INVALID_CMDLINE_WWA;
               }
+            } else if (strequal_k(cur_modif, "bgen-index", cur_modif_slen)) {
+              if (!(pc.exportf_flags & (kfExportfBgen12 | kfExportfBgen13))) {
+                logerrputs("Error: The 'bgen-index' modifier only applies to --export's bgen-1.2 and\nbgen-1.3 output formats.\n");
+                goto main_ret_INVALID_CMDLINE_A;
+              }
+              pc.exportf_flags |= kfExportfBgenIndex;
             } else if (strequal_k(cur_modif, "include-alt", cur_modif_slen)) {
               if (!(pc.exportf_flags & (kfExportfA | kfExportfAD))) {
                 logerrputs("Error: The 'include-alt' modifier only applies to --export's A and AD output\nformats.\n");
@@ -4057,8 +4160,8 @@ int main(int argc, char** argv) {
                 snprintf(g_logbuf, kLogbufSize, "Error: The '%s' modifier does not apply to --export's A and AD output formats.\n", cur_modif);
                 goto main_ret_INVALID_CMDLINE_2A;
               }
-              if (pc.exportf_flags & kfExportfVcf) {
-                logerrputs("Error: '01'/'12' cannot be used with --export's vcf output format.\n");
+              if (pc.exportf_flags & (kfExportfBcf | kfExportfVcf)) {
+                logerrputs("Error: '01'/'12' cannot be used with --export's bcf or vcf output formats.\n");
                 goto main_ret_INVALID_CMDLINE_A;
               }
               if (cur_modif[0] == '0') {
@@ -4092,7 +4195,11 @@ int main(int argc, char** argv) {
               goto main_ret_INVALID_CMDLINE_WWA;
             }
           }
-          if (pc.exportf_flags & (kfExportfVcf | kfExportfBgen12 | kfExportfBgen13)) {
+          if ((pc.exportf_flags & (kfExportfVcfIndexTbi | kfExportfVcfIndexCsi)) && (!(pc.exportf_flags & kfExportfBgz))) {
+            logerrputs("Error: --export vcf-index= requires the 'bgz' modifier.\n");
+            goto main_ret_INVALID_CMDLINE_A;
+          }
+          if (pc.exportf_flags & (kfExportfBcf | kfExportfVcf | kfExportfBgen12 | kfExportfBgen13)) {
             if (!pc.exportf_id_paste) {
               pc.exportf_id_paste = kfIdpasteDefault;
             }
@@ -4218,6 +4325,9 @@ int main(int argc, char** argv) {
           }
           pc.command_flags1 |= kfCommand1AlleleFreq;
           pc.dependency_flags |= kfFilterAllReq;
+        } else if (strequal_k_unsafe(flagname_p2, "req-cache")) {
+          pc.misc_flags |= kfMiscFreqCache;
+          goto main_param_zero;
         } else if (strequal_k_unsafe(flagname_p2, "rom")) {
           if (chr_info.is_include_stack) {
             logerrputs("Error: --from/--to cannot be used with --autosome{-par} or --{not-}chr.\n");
@@ -5700,6 +5810,12 @@ int main(int argc, char** argv) {
                 goto main_ret_INVALID_CMDLINE_A;
               }
               pc.king_flags |= kfKingMatrixBin4;
+            } else if (!strcmp(cur_modif, "sparse")) {
+              if (pc.king_flags & kfKingMatrixEncodemask) {
+                logerrputs("Error: Multiple --make-king encoding modifiers.\n");
+                goto main_ret_INVALID_CMDLINE_A;
+              }
+              pc.king_flags |= kfKingMatrixSparse;
             } else if (!strcmp(cur_modif, "square")) {
               if (pc.king_flags & kfKingMatrixShapemask) {
                 logerrputs("Error: Multiple --make-king shape modifiers.\n");
@@ -5726,6 +5842,10 @@ int main(int argc, char** argv) {
               goto main_ret_INVALID_CMDLINE_WWA;
             }
           }
+          if ((pc.king_flags & kfKingMatrixSparse) && (pc.king_flags & (kfKingMatrixSq | kfKingMatrixSq0))) {
+            logerrputs("Error: --make-king 'sparse' modifier cannot be used with 'square' or 'square0'.\n");
+            goto main_ret_INVALID_CMDLINE_A;
+          }
           if (!(pc.king_flags & kfKingMatrixShapemask)) {
             if (pc.king_flags & (kfKingMatrixBin | kfKingMatrixBin4)) {
               pc.king_flags |= kfKingMatrixSq;
@@ -5993,7 +6113,7 @@ int main(int argc, char** argv) {
             goto main_ret_1;
           }
         } else if (strequal_k_unsafe(flagname_p2, "erge-par")) {
-          if (pc.exportf_flags & kfExportfVcf) {
+          if (pc.exportf_flags & (kfExportfBcf | kfExportfVcf)) {
             logerrputs("Warning: --merge-par should not be used with VCF export.  (The VCF export\nroutine automatically converts PAR1/PAR2 chromosome codes to X, while using\nthe PAR boundaries to get male ploidy right; --merge-par causes VCF export to\nget male ploidy wrong.)\n");
           }
           pc.misc_flags |= kfMiscMergePar;
@@ -6004,7 +6124,7 @@ int main(int argc, char** argv) {
             logerrputs("Error: --merge-par cannot be used with --merge-x.\n");
             goto main_ret_INVALID_CMDLINE_A;
           }
-          if (pc.exportf_flags & kfExportfVcf) {
+          if (pc.exportf_flags & (kfExportfBcf | kfExportfVcf)) {
             logerrputs("Warning: --merge-x should not be used in the same run as VCF export; this\ncauses some ploidies to be wrong.  Instead, use --merge-x + --sort-vars +\n--make-{b}pgen in one run, and follow up with --split-par + --export vcf.\n");
           }
           pc.misc_flags |= kfMiscMergeX;
@@ -6237,6 +6357,12 @@ int main(int argc, char** argv) {
                 goto main_ret_INVALID_CMDLINE_A;
               }
               pc.grm_flags |= kfGrmMatrixBin4;
+            } else if (!strcmp(cur_modif, "sparse")) {
+              if (pc.grm_flags & kfGrmMatrixEncodemask) {
+                logerrputs("Error: Multiple --make-rel encoding modifiers.\n");
+                goto main_ret_INVALID_CMDLINE_A;
+              }
+              pc.grm_flags |= kfGrmMatrixSparse;
             } else if (!strcmp(cur_modif, "square")) {
               if (pc.grm_flags & kfGrmMatrixShapemask) {
                 logerrputs("Error: Multiple --make-rel shape modifiers.\n");
@@ -6260,6 +6386,10 @@ int main(int argc, char** argv) {
               goto main_ret_INVALID_CMDLINE_WWA;
             }
           }
+          if ((pc.grm_flags & kfGrmMatrixSparse) && (pc.grm_flags & (kfGrmMatrixSq | kfGrmMatrixSq0))) {
+            logerrputs("Error: --make-rel 'sparse' modifier cannot be used with 'square' or 'square0'.\n");
+            goto main_ret_INVALID_CMDLINE_A;
+          }
           if (!(pc.grm_flags & kfGrmMatrixShapemask)) {
             if (pc.grm_flags & (kfGrmMatrixBin | kfGrmMatrixBin4)) {
               pc.grm_flags |= kfGrmMatrixSq;
@@ -6587,6 +6717,24 @@ int main(int argc, char** argv) {
             goto main_ret_OPEN_FAIL;
           }
           memcpy(pvarname, fname, slen + 1);
+        } else if (strequal_k_unsafe(flagname_p2, "var-cache")) {
+          pc.misc_flags |= kfMiscPvarCache;
+          goto main_param_zero;
+        } else if (strequal_k_unsafe(flagname_p2, "merge-list")) {
+          if (load_params || xload) {
+            goto main_ret_INVALID_CMDLINE_INPUT_CONFLICT;
+          }
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 1)) {
+            goto main_ret_INVALID_CMDLINE_2A;
+          }
+          const char* fname = argvk[arg_idx + 1];
+          const uint32_t slen = strlen(fname);
+          if (slen > (kPglFnamesize - 2)) {
+            logerrputs("Error: --pmerge-list filename too long.\n");
+            goto main_ret_OPEN_FAIL;
+          }
+          memcpy(pgenname, fname, slen + 1);
+          xload = kfXloadPmergeList;
         } else if (strequal_k_unsafe(flagname_p2, "heno")) {
           if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 1)) {
             goto main_ret_INVALID_CMDLINE_2A;
@@ -6774,6 +6922,40 @@ int main(int argc, char** argv) {
           }
           pc.command_flags1 |= kfCommand1Pca;
           pc.dependency_flags |= kfFilterAllReq;
+        } else if (strequal_k_unsafe(flagname_p2, "ca-project")) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 2)) {
+            goto main_ret_INVALID_CMDLINE_2A;
+          }
+          const char* var_wts_fname = argvk[arg_idx + 1];
+          reterr = AllocFname(var_wts_fname, flagname_p, 0, &pc.pca_project_var_wts_fname);
+          if (reterr) {
+            goto main_ret_1;
+          }
+          if (param_ct == 2) {
+            reterr = AllocFname(argvk[arg_idx + 2], flagname_p, 0, &pc.pca_project_eigval_fname);
+          } else {
+            // {prefix}.eigenvec.var[.zst] -> {prefix}.eigenval
+            const uint32_t var_wts_fname_slen = strlen(var_wts_fname);
+            uint32_t prefix_slen = var_wts_fname_slen;
+            if (StrEndsWith(var_wts_fname, ".zst", prefix_slen)) {
+              prefix_slen -= 4;
+            }
+            if ((prefix_slen < strlen(".eigenvec.var")) || (!StrEndsWith(var_wts_fname, ".eigenvec.var", prefix_slen))) {
+              logerrputs("Error: --pca-project can only infer the .eigenval filename when the variant\nweight filename ends in '.eigenvec.var' or '.eigenvec.var.zst'.\n");
+              goto main_ret_INVALID_CMDLINE_A;
+            }
+            prefix_slen -= strlen(".eigenvec.var");
+            if (pgl_malloc(prefix_slen + strlen(".eigenval") + 1, &pc.pca_project_eigval_fname)) {
+              goto main_ret_NOMEM;
+            }
+            memcpy(pc.pca_project_eigval_fname, var_wts_fname, prefix_slen);
+            strcpy(&(pc.pca_project_eigval_fname[prefix_slen]), ".eigenval");
+          }
+          if (reterr) {
+            goto main_ret_1;
+          }
+          pc.command_flags1 |= kfCommand1PcaProject;
+          pc.dependency_flags |= kfFilterAllReq;
         } else if (strequal_k_unsafe(flagname_p2, "heno-quantile-normalize")) {
           if (param_ct) {
             reterr = AllocAndFlatten(&(argvk[arg_idx + 1]), param_ct, 0x7fffffff, &pc.quantnorm_flattened);
@@ -7002,6 +7184,15 @@ int main(int argc, char** argv) {
               goto main_ret_INVALID_CMDLINE_WWA;
             }
           }
+        } else if (strequal_k_unsafe(flagname_p2, "parse-cutoff")) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 1)) {
+            goto main_ret_INVALID_CMDLINE_2A;
+          }
+          const char* cur_modif = argvk[arg_idx + 1];
+          if (!ScanadvDouble(cur_modif, &pc.sparse_cutoff)) {
+            snprintf(g_logbuf, kLogbufSize, "Error: Invalid --sparse-cutoff parameter '%s'.\n", cur_modif);
+            goto main_ret_INVALID_CMDLINE_WWA;
+          }
         } else if (strequal_k_unsafe(flagname_p2, "plit-par")) {
           if (pc.misc_flags & (kfMiscMergePar | kfMiscMergeX)) {
             logerrputs("Error: --split-par cannot be used with --merge-par/--merge-x.\n");
@@ -7168,7 +7359,7 @@ int main(int argc, char** argv) {
           }
           pc.filter_flags |= kfFilterPvarReq | kfFilterSnpsOnly;
         } else if (strequal_k_unsafe(flagname_p2, "core")) {
-          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 11)) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 12)) {
             goto main_ret_INVALID_CMDLINE_2A;
           }
           reterr = AllocFname(argvk[arg_idx + 1], flagname_p, 0, &pc.score_info.input_fname);
@@ -7205,6 +7396,10 @@ int main(int argc, char** argv) {
               pc.score_info.flags |= kfScoreListVariants;
             } else if (strequal_k(cur_modif, "list-variants-zs", cur_modif_slen)) {
               pc.score_info.flags |= kfScoreListVariants | kfScoreListVariantsZs;
+            } else if (strequal_k(cur_modif, "bin", cur_modif_slen)) {
+              pc.score_info.flags |= kfScoreBin;
+            } else if (strequal_k(cur_modif, "bin4", cur_modif_slen)) {
+              pc.score_info.flags |= kfScoreBin4;
             } else if (StrStartsWith(cur_modif, "cols=", cur_modif_slen)) {
               if (pc.score_info.flags & kfScoreColAll) {
                 logerrputs("Error: Multiple --score cols= modifiers.\n");
@@ -7235,6 +7430,10 @@ int main(int argc, char** argv) {
             logerrputs("Error: --score 'header' and 'header-read' modifiers cannot be used together.\n");
             goto main_ret_INVALID_CMDLINE_A;
           }
+          if ((pc.score_info.flags & (kfScoreBin | kfScoreBin4)) == (kfScoreBin | kfScoreBin4)) {
+            logerrputs("Error: --score 'bin' and 'bin4' modifiers cannot be used together.\n");
+            goto main_ret_INVALID_CMDLINE_A;
+          }
           uint32_t model_flags_u = S_CAST(uint32_t, pc.score_info.flags & (kfScoreDominant | kfScoreRecessive | kfScoreCenter | kfScoreVarianceStandardize));
           if (model_flags_u & (model_flags_u - 1)) {
             logerrputs("Error: --score 'dominant', 'recessive', 'center', and 'variance-standardize'\nmodifiers are mutually exclusive.\n");
@@ -7320,23 +7519,32 @@ int main(int argc, char** argv) {
             logerrputs("Error: --sort-vars must be used with --make-{b}pgen/--make-bed or dataset\nmerging.\n");
             goto main_ret_INVALID_CMDLINE_A;
           }
-          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 0, 1)) {
+          if (EnforceParamCtRange(argvk[arg_idx], param_ct, 0, 2)) {
             goto main_ret_INVALID_CMDLINE_2A;
           }
-          if (param_ct) {
-            const char* sort_vars_mode_str = argvk[arg_idx + 1];
-            const char first_char_upcase_match = sort_vars_mode_str[0] & 0xdf;
-            const uint32_t is_short_name = (sort_vars_mode_str[1] == '\0');
-            if ((is_short_name && (first_char_upcase_match == 'N')) || (!strcmp(sort_vars_mode_str, "natural"))) {
+          pc.sort_vars_flags = kfSortNatural;
+          uint32_t mode_seen = 0;
+          for (uint32_t param_idx = 1; param_idx <= param_ct; ++param_idx) {
+            const char* cur_modif = argvk[arg_idx + param_idx];
+            if (!strcmp(cur_modif, "external")) {
+              make_plink2_flags |= kfMakePlink2SortVarsExternal;
+              continue;
+            }
+            if (mode_seen) {
+              logerrputs("Error: Multiple --sort-vars modes.\n");
+              goto main_ret_INVALID_CMDLINE_A;
+            }
+            mode_seen = 1;
+            const char first_char_upcase_match = cur_modif[0] & 0xdf;
+            const uint32_t is_short_name = (cur_modif[1] == '\0');
+            if ((is_short_name && (first_char_upcase_match == 'N')) || (!strcmp(cur_modif, "natural"))) {
               pc.sort_vars_flags = kfSortNatural;
-            } else if ((is_short_name && (first_char_upcase_match == 'A')) || (!strcmp(sort_vars_mode_str, "ascii"))) {
+            } else if ((is_short_name && (first_char_upcase_match == 'A')) || (!strcmp(cur_modif, "ascii"))) {
               pc.sort_vars_flags = kfSortAscii;
             } else {
-              snprintf(g_logbuf, kLogbufSize, "Error: '%s' is not a valid mode for --sort-vars.\n", sort_vars_mode_str);
+              snprintf(g_logbuf, kLogbufSize, "Error: '%s' is not a valid mode for --sort-vars.\n", cur_modif);
               goto main_ret_INVALID_CMDLINE_WWA;
             }
-          } else {
-            pc.sort_vars_flags = kfSortNatural;
           }
         } else if (strequal_k_unsafe(flagname_p2, "trict-sid0")) {
           pc.misc_flags |= kfMiscStrictSid0;
@@ -7617,9 +7825,8 @@ int main(int argc, char** argv) {
           logerrputs("Error: --vcf-min-gp is no longer supported.  Use --import-dosage-certainty\ninstead.\n");
           goto main_ret_INVALID_CMDLINE_A;
         } else if (strequal_k_unsafe(flagname_p2, "cf-min-gq") || strequal_k_unsafe(flagname_p2, "cf-min-dp")) {
-          if (!(xload & kfXloadVcf)) {
-            // todo: support BCF too
-            logerrprintf("Error: --%s must be used with --vcf.\n", flagname_p);
+          if (!(xload & (kfXloadVcf | kfXloadBcf))) {
+            logerrprintf("Error: --%s must be used with --vcf/--bcf.\n", flagname_p);
             goto main_ret_INVALID_CMDLINE;
           }
           if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 1)) {
@@ -7658,8 +7865,8 @@ int main(int argc, char** argv) {
             goto main_ret_INVALID_CMDLINE;
           }
         } else if (strequal_k_unsafe(flagname_p2, "cf-half-call")) {
-          if (!(xload & kfXloadVcf)) {
-            logerrputs("Error: --vcf-half-call must be used with --vcf.\n");
+          if (!(xload & (kfXloadVcf | kfXloadBcf))) {
+            logerrputs("Error: --vcf-half-call must be used with --vcf/--bcf.\n");
             goto main_ret_INVALID_CMDLINE;
           }
           if (EnforceParamCtRange(argvk[arg_idx], param_ct, 1, 1)) {
@@ -7894,7 +8101,7 @@ int main(int argc, char** argv) {
     }
 
     pc.dependency_flags |= pc.filter_flags;
-    const uint32_t skip_main = (!pc.command_flags1) && (!(xload & (kfXloadVcf | kfXloadBcf | kfXloadOxBgen | kfXloadOxHaps | kfXloadOxSample | kfXloadPlink1Dosage | kfXloadGenDummy)));
+    const uint32_t skip_main = (!pc.command_flags1) && (!(xload & (kfXloadVcf | kfXloadBcf | kfXloadOxBgen | kfXloadOxHaps | kfXloadOxSample | kfXloadPlink1Dosage | kfXloadGenDummy | kfXloadPmergeList)));
     const uint32_t batch_job = (adjust_file_info.fname != nullptr);
     if (skip_main && (!batch_job)) {
       // add command_flags2 when needed
@@ -7928,6 +8135,18 @@ int main(int argc, char** argv) {
       logerrputs("Error: Flags which alter REF/ALT1 allele settings (--maj-ref, --ref-allele,\n--alt1-allele, --ref-from-fa) must be used with\n--make-bed/--make-{b}pgen/--export and no other commands.\n");
       goto main_ret_INVALID_CMDLINE;
     }
+    if (pc.checkpoint_interval && ((!(pc.command_flags1 & (kfCommand1MakeKing | kfCommand1KingCutoff | kfCommand1MakeRel | kfCommand1Pca))) || pc.king_table_subset_fname)) {
+      logerrputs("Error: --checkpoint must be used with --make-king, --make-king-table,\n--king-cutoff, --make-rel, --make-grm-list, --make-grm-bin, or --pca.\n");
+      goto main_ret_INVALID_CMDLINE_A;
+    }
+    if (pc.checkpoint_interval && (pc.pca_flags & kfPcaApprox) && (!(pc.command_flags1 & (kfCommand1MakeKing | kfCommand1KingCutoff | kfCommand1MakeRel)))) {
+      logerrputs("Error: --checkpoint cannot be used with --pca approx.\n");
+      goto main_ret_INVALID_CMDLINE_A;
+    }
+    if ((pc.sparse_cutoff != -DBL_MAX) && (!(pc.king_flags & kfKingMatrixSparse)) && (!(pc.grm_flags & kfGrmMatrixSparse))) {
+      logerrputs("Error: --sparse-cutoff must be used with --make-king or --make-rel 'sparse'\nmodifier.\n");
+      goto main_ret_INVALID_CMDLINE_A;
+    }
     if (pc.keep_cat_phenoname && (!pc.keep_cat_names_flattened) && (!pc.keep_cats_fname)) {
       logerrputs("Error: --keep-cat-pheno must be used with --keep-cats and/or --keep-cat-names.\n");
     }
@@ -8056,6 +8275,12 @@ int main(int argc, char** argv) {
       }
       if (xload) {
         char* convname_end = outname_end;
+        if (pc.misc_flags & kfMiscBgenDirect) {
+          if (pc.command_flags1 & (~(kfCommand1Glm | kfCommand1Score | kfCommand1AlleleFreq | kfCommand1WriteSnplist | kfCommand1WriteSamples))) {
+            logerrputs("Error: --bgen 'direct' mode currently only supports --glm, --score, --freq,\n--write-snplist, and --write-samples.\n");
+            goto main_ret_INVALID_CMDLINE_A;
+          }
+        }
         if (pc.command_flags1) {
           if (import_flags & kfImportKeepAutoconv) {
             if (pc.misc_flags & kfMiscAffection01) {
@@ -8096,19 +8321,21 @@ int main(int argc, char** argv) {
           } else {
             reterr = VcfToPgen(pgenname, (load_params & kfLoadParamsPsam)? psamname : nullptr, const_fid, vcf_dosage_import_field, pc.misc_flags, import_flags, no_samples_ok, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, id_delim, idspace_to, vcf_min_gq, vcf_min_dp, vcf_half_call, pc.fam_cols, pc.max_thread_ct, outname, convname_end, &chr_info, &pgen_generated, &psam_generated);
           }
-        } else if (xload & kfXloadVcf) {
-          logerrputs("Error: --bcf is not implemented yet.\n");
-          reterr = kPglRetNotYetSupported;
+        } else if (xload & kfXloadBcf) {
+          const uint32_t no_samples_ok = !(pc.dependency_flags & (kfFilterAllReq | kfFilterPsamReq));
+          reterr = BcfToPgen(pgenname, (load_params & kfLoadParamsPsam)? psamname : nullptr, const_fid, vcf_dosage_import_field, pc.misc_flags, import_flags, no_samples_ok, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, id_delim, idspace_to, vcf_min_gq, vcf_min_dp, vcf_half_call, pc.fam_cols, pc.max_thread_ct, outname, convname_end, &chr_info, &pgen_generated, &psam_generated);
         } else if (xload & kfXloadOxGen) {
           reterr = OxGenToPgen(pgenname, psamname, import_single_chr_str, ox_missing_code, pc.misc_flags, import_flags, oxford_import_flags, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, pc.max_thread_ct, outname, convname_end, &chr_info);
         } else if (xload & kfXloadOxBgen) {
-          reterr = OxBgenToPgen(pgenname, psamname, const_fid, import_single_chr_str, ox_missing_code, pc.misc_flags, import_flags, oxford_import_flags, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, id_delim, idspace_to, pc.max_thread_ct, outname, convname_end, &chr_info);
+          reterr = OxBgenToPgen(pgenname, psamname, const_fid, import_single_chr_str, ox_missing_code, pc.misc_flags, import_flags, oxford_import_flags, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, id_delim, idspace_to, pc.max_thread_ct, outname, convname_end, &chr_info, &pc.bgen_direct_info);
         } else if (xload & kfXloadOxHaps) {
           reterr = OxHapslegendToPgen(pgenname, pvarname, psamname, import_single_chr_str, ox_missing_code, pc.misc_flags, import_flags, oxford_import_flags, outname, convname_end, &chr_info);
         } else if (xload & kfXloadPlink1Dosage) {
           reterr = Plink1DosageToPgen(pgenname, psamname, (xload & kfXloadMap)? pvarname : nullptr, import_single_chr_str, &plink1_dosage_info, pc.misc_flags, import_flags, pc.fam_cols, pc.missing_pheno, pc.hard_call_thresh, pc.dosage_erase_thresh, import_dosage_certainty, pc.max_thread_ct, outname, convname_end, &chr_info);
         } else if (xload & kfXloadGenDummy) {
           reterr = GenerateDummy(&gendummy_info, pc.misc_flags, import_flags, pc.hard_call_thresh, pc.dosage_erase_thresh, pc.max_thread_ct, outname, convname_end, &chr_info);
+        } else if (xload & kfXloadPmergeList) {
+          reterr = PmergeListToPgen(pgenname, pc.misc_flags, pc.max_thread_ct, outname, convname_end, &chr_info);
         }
         if (reterr || (!pc.command_flags1)) {
           goto main_ret_1;
@@ -8117,6 +8344,15 @@ int main(int argc, char** argv) {
         // todo: we have to skip this when merging is involved
         pc.hard_call_thresh = UINT32_MAX;
 
+        if (pc.misc_flags & kfMiscBgenDirect) {
+          // genotypes stay in the .bgen
+          pgen_generated = 0;
+          if (pc.bgen_direct_info.idx_generated && (!(import_flags & kfImportKeepAutoconv))) {
+            if (PushLlStr(pc.bgen_direct_info.idxname, &file_delete_list)) {
+              goto main_ret_NOMEM;
+            }
+          }
+        }
         if (pgen_generated) {
           snprintf(memcpya(pgenname, outname, convname_slen), kMaxOutfnameExtBlen - 10, ".pgen");
         }
@@ -8247,6 +8483,8 @@ int main(int argc, char** argv) {
   free_cond(pc.require_no_info_flattened);
   free_cond(pc.require_info_flattened);
   free_cond(pc.king_table_subset_fname);
+  free_cond(pc.pca_project_var_wts_fname);
+  free_cond(pc.pca_project_eigval_fname);
   free_cond(pc.ref_from_fa_fname);
   free_cond(pc.loop_cats_phenoname);
   free_cond(pc.covar_quantnorm_flattened);
@@ -62,6 +62,50 @@ typedef struct AdjAssocResultStruct {
 #endif
 } AdjAssocResult;
 
+// Sorts in decreasing -ln(p) order.  Large arrays are radix-sorted (with ties
+// kept in their original order) when there's enough workspace.
+static PglErr SortAdjAssocResults(uint32_t valid_variant_ct, uint32_t max_thread_ct, AdjAssocResult* sortbuf) {
+  if (valid_variant_ct >= 65536) {
+    unsigned char* bigstack_end_mark = g_bigstack_end;
+    uint64_t* sort_keys;
+    uint32_t* sort_idxs;
+    AdjAssocResult* sorted_results = nullptr;
+    if ((!bigstack_end_alloc_u64(valid_variant_ct, &sort_keys)) &&
+        (!bigstack_end_alloc_u32(valid_variant_ct, &sort_idxs))) {
+      sorted_results = S_CAST(AdjAssocResult*, bigstack_end_alloc(valid_variant_ct * sizeof(AdjAssocResult)));
+    }
+    if (sorted_results) {
+      for (uint32_t vidx = 0; vidx < valid_variant_ct; ++vidx) {
+        // -ln(p) values are nonnegative, so their bit patterns are in the same
+        // order; invert for decreasing order.  (+0.0 avoids -0.0.)
+        const double cur_negln_pval = sortbuf[vidx].negln_pval + 0.0;
+        uint64_t cur_bits;
+        memcpy(&cur_bits, &cur_negln_pval, sizeof(double));
+        sort_keys[vidx] = ~cur_bits;
+        sort_idxs[vidx] = vidx;
+      }
+      const PglErr reterr = RadixSortU64Mt(valid_variant_ct, max_thread_ct, sort_keys, sort_idxs);
+      if (reterr != kPglRetNomem) {
+        if (!reterr) {
+          for (uint32_t vidx = 0; vidx < valid_variant_ct; ++vidx) {
+            sorted_results[vidx] = sortbuf[sort_idxs[vidx]];
+          }
+          memcpy(sortbuf, sorted_results, valid_variant_ct * sizeof(AdjAssocResult));
+        }
+        BigstackEndReset(bigstack_end_mark);
+        return reterr;
+      }
+    }
+    BigstackEndReset(bigstack_end_mark);
+  }
+#ifdef __cplusplus
+  std::sort(sortbuf, &(sortbuf[valid_variant_ct]));
+#else
+  qsort(sortbuf, valid_variant_ct, sizeof(AdjAssocResult), double_cmp_decr);
+#endif
+  return kPglRetSuccess;
+}
+
 static inline void adjust_print(const char* output_min_p_str, double pval, double output_min_p, uint32_t output_min_p_slen, uint32_t is_log10, char** bufpp) {
   **bufpp = '\t';
   *bufpp += 1;
@@ -258,11 +302,10 @@ PglErr Multcomp(const uintptr_t* variant_include, const ChrInfo* cip, const char
       goto Multcomp_ret_NOMEM;
     }
 
-#ifdef __cplusplus
-    std::sort(sortbuf, &(sortbuf[valid_variant_ct]));
-#else
-    qsort(sortbuf, valid_variant_ct, sizeof(AdjAssocResult), double_cmp_decr);
-#endif
+    reterr = SortAdjAssocResults(valid_variant_ct, max_thread_ct, sortbuf);
+    if (reterr) {
+      goto Multcomp_ret_1;
+    }
 
     double lambda_recip = 1.0;
     if (!skip_gc) {
@@ -2750,6 +2750,31 @@ static uint32_t g_id_htable_size = 0;
 static uint32_t g_calc_thread_ct = 0;
 static uint32_t g_item_uidx_starts[16];
 
+// Hash table slot range [g_htable_fill_starts[tidx],
+// g_htable_fill_starts[tidx + 1]) is initialized, and (in the parallel-fill
+// case) filled, by thread tidx.
+static uint32_t g_htable_fill_starts[17];
+
+// Parallel-fill only.  Items are bucketed by filling thread, preserving item
+// order within each bucket, so that duplicate IDs are resolved the same way
+// as in the serial loop.
+static uint32_t* g_bucketed_item_uidxs = nullptr;
+static uint32_t* g_bucketed_item_hashes = nullptr;
+// [hashing thread][filling thread] item counts, converted to write offsets
+// between the hashing and scatter steps
+static uint32_t g_fill_bucket_cts[16][16];
+static uint32_t g_fill_bucket_starts[17];
+
+HEADER_INLINE uint32_t GetHtableFillTidx(uint32_t hashval, uint32_t id_htable_size, uint32_t calc_thread_ct) {
+  // fill range boundaries are rounded down to a cacheline boundary, so this
+  // estimate is never too large
+  uint32_t tidx = (S_CAST(uint64_t, hashval) * calc_thread_ct) / id_htable_size;
+  while (hashval >= g_htable_fill_starts[tidx + 1]) {
+    ++tidx;
+  }
+  return tidx;
+}
+
 THREAD_FUNC_DECL CalcIdHashThread(void* arg) {
   const uintptr_t tidx = R_CAST(uintptr_t, arg);
   const uintptr_t* subset_mask = g_subset_mask;
@@ -2757,23 +2782,190 @@ THREAD_FUNC_DECL CalcIdHashThread(void* arg) {
   uint32_t* item_id_hashes = g_item_id_hashes;
   const uint32_t id_htable_size = g_id_htable_size;
   const uint32_t calc_thread_ct = g_calc_thread_ct;
-  const uint32_t fill_start = RoundDownPow2((id_htable_size * S_CAST(uint64_t, tidx)) / calc_thread_ct, kInt32PerCacheline);
-  uint32_t fill_end;
-  if (tidx + 1 < calc_thread_ct) {
-    fill_end = RoundDownPow2((id_htable_size * (S_CAST(uint64_t, tidx) + 1)) / calc_thread_ct, kInt32PerCacheline);
-  } else {
-    fill_end = id_htable_size;
-  }
+  const uint32_t fill_start = g_htable_fill_starts[tidx];
+  const uint32_t fill_end = g_htable_fill_starts[tidx + 1];
   SetAllU32Arr(fill_end - fill_start, &(g_id_htable[fill_start]));
 
   const uint32_t item_ct = g_item_ct;
   const uint32_t item_idx_end = (item_ct * (S_CAST(uint64_t, tidx) + 1)) / calc_thread_ct;
   uint32_t item_uidx = g_item_uidx_starts[tidx];
+  uint32_t* fill_bucket_cts = g_bucketed_item_uidxs? g_fill_bucket_cts[tidx] : nullptr;
+  if (fill_bucket_cts) {
+    ZeroU32Arr(calc_thread_ct, fill_bucket_cts);
+  }
   for (uint32_t item_idx = (item_ct * S_CAST(uint64_t, tidx)) / calc_thread_ct; item_idx < item_idx_end; ++item_idx, ++item_uidx) {
     MovU32To1Bit(subset_mask, &item_uidx);
     const char* sptr = item_ids[item_uidx];
     const uint32_t slen = strlen(sptr);
-    item_id_hashes[item_idx] = Hashceil(sptr, slen, id_htable_size);
+    const uint32_t hashval = Hashceil(sptr, slen, id_htable_size);
+    item_id_hashes[item_idx] = hashval;
+    if (fill_bucket_cts) {
+      fill_bucket_cts[GetHtableFillTidx(hashval, id_htable_size, calc_thread_ct)] += 1;
+    }
+  }
+  THREAD_RETURN;
+}
+
+THREAD_FUNC_DECL ScatterIdHashThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uintptr_t* subset_mask = g_subset_mask;
+  const uint32_t* item_id_hashes = g_item_id_hashes;
+  uint32_t* bucketed_item_uidxs = g_bucketed_item_uidxs;
+  uint32_t* bucketed_item_hashes = g_bucketed_item_hashes;
+  uint32_t* write_offsets = g_fill_bucket_cts[tidx];
+  const uint32_t id_htable_size = g_id_htable_size;
+  const uint32_t calc_thread_ct = g_calc_thread_ct;
+  const uint32_t item_ct = g_item_ct;
+  const uint32_t item_idx_end = (item_ct * (S_CAST(uint64_t, tidx) + 1)) / calc_thread_ct;
+  uint32_t item_uidx = g_item_uidx_starts[tidx];
+  for (uint32_t item_idx = (item_ct * S_CAST(uint64_t, tidx)) / calc_thread_ct; item_idx < item_idx_end; ++item_idx, ++item_uidx) {
+    MovU32To1Bit(subset_mask, &item_uidx);
+    const uint32_t hashval = item_id_hashes[item_idx];
+    const uint32_t write_idx = write_offsets[GetHtableFillTidx(hashval, id_htable_size, calc_thread_ct)]++;
+    bucketed_item_uidxs[write_idx] = item_uidx;
+    bucketed_item_hashes[write_idx] = hashval;
+  }
+  THREAD_RETURN;
+}
+
+// Inserts item_uidx into id_htable, or sets the duplicate flag on the
+// existing entry if its ID is already present.  If wrap is false, this gives
+// up and returns 1 when probing reaches fill_end; otherwise probing wraps
+// around at fill_end (which must then equal the table size).
+HEADER_INLINE BoolErr IdHtableAddOrFlag(const char* const* item_ids, uint32_t item_uidx, uint32_t hashval, uint32_t fill_end, uint32_t wrap, uint32_t* id_htable) {
+  uint32_t cur_htable_entry = id_htable[hashval];
+  if (cur_htable_entry == UINT32_MAX) {
+    id_htable[hashval] = item_uidx;
+    return 0;
+  }
+  const char* sptr = item_ids[item_uidx];
+  while (1) {
+    // could also use memcmp, guaranteed to be safe due to where variant IDs
+    // are allocated
+    if (!strcmp(sptr, item_ids[cur_htable_entry & 0x7fffffff])) {
+      if (!(cur_htable_entry >> 31)) {
+        id_htable[hashval] |= 0x80000000U;
+      }
+      return 0;
+    }
+    if (++hashval == fill_end) {
+      if (!wrap) {
+        return 1;
+      }
+      hashval = 0;
+    }
+    cur_htable_entry = id_htable[hashval];
+    if (cur_htable_entry == UINT32_MAX) {
+      id_htable[hashval] = item_uidx;
+      return 0;
+    }
+  }
+}
+
+// store_all_dups version: inserts item_uidx into id_htable if its ID is new,
+// otherwise adds it to the ID's linked list in htable_dup_base.  Linked list
+// entries are (item_uidx, previous entry index) pairs, with UINT32_MAX
+// marking the list end; this needs to be synced with
+// ExtractExcludeFlagNorange().
+static BoolErr IdHtableAddToDupList(const char* const* item_ids, uint32_t item_uidx, uint32_t hashval, uint32_t id_htable_size, uint32_t max_extra_alloc_m4, uint32_t* htable_dup_base, uint32_t* extra_alloc_ptr, uint32_t* id_htable) {
+  uint32_t cur_htable_entry = id_htable[hashval];
+  if (cur_htable_entry == UINT32_MAX) {
+    id_htable[hashval] = item_uidx;
+    return 0;
+  }
+  const char* sptr = item_ids[item_uidx];
+  while (1) {
+    const uint32_t cur_dup = cur_htable_entry >> 31;
+    uint32_t prev_llidx;
+    uint32_t prev_uidx;
+    if (cur_dup) {
+      prev_llidx = cur_htable_entry * 2;
+      prev_uidx = htable_dup_base[prev_llidx];
+    } else {
+      prev_uidx = cur_htable_entry;
+    }
+    if (!strcmp(sptr, item_ids[prev_uidx])) {
+      uint32_t extra_alloc = *extra_alloc_ptr;
+      if (extra_alloc > max_extra_alloc_m4) {
+        return 1;
+      }
+      // point to linked list entry instead
+      if (!cur_dup) {
+        htable_dup_base[extra_alloc] = cur_htable_entry;
+        htable_dup_base[extra_alloc + 1] = UINT32_MAX;  // list end
+        prev_llidx = extra_alloc;
+        extra_alloc += 2;
+      }
+      htable_dup_base[extra_alloc] = item_uidx;
+      htable_dup_base[extra_alloc + 1] = prev_llidx;
+      id_htable[hashval] = 0x80000000U | (extra_alloc >> 1);
+      *extra_alloc_ptr = extra_alloc + 2;
+      return 0;  // bugfix
+    }
+    if (++hashval == id_htable_size) {
+      hashval = 0;
+    }
+    cur_htable_entry = id_htable[hashval];
+    if (cur_htable_entry == UINT32_MAX) {
+      id_htable[hashval] = item_uidx;
+      return 0;
+    }
+  }
+}
+
+// Parallel-fill counterpart of IdHtableAddToDupList(): returns 1 without
+// modifying id_htable if the ID is already present (linked list entries are
+// allocated serially afterward), or if probing reaches fill_end.
+HEADER_INLINE uint32_t IdHtableAddIfNew(const char* const* item_ids, uint32_t item_uidx, uint32_t hashval, uint32_t fill_end, uint32_t* id_htable) {
+  uint32_t cur_htable_entry = id_htable[hashval];
+  if (cur_htable_entry == UINT32_MAX) {
+    id_htable[hashval] = item_uidx;
+    return 0;
+  }
+  const char* sptr = item_ids[item_uidx];
+  while (1) {
+    // linked lists don't exist yet, so the top bit is never set here
+    if (!strcmp(sptr, item_ids[cur_htable_entry])) {
+      return 1;
+    }
+    if (++hashval == fill_end) {
+      return 1;
+    }
+    cur_htable_entry = id_htable[hashval];
+    if (cur_htable_entry == UINT32_MAX) {
+      id_htable[hashval] = item_uidx;
+      return 0;
+    }
+  }
+}
+
+static uint32_t g_store_all_dups = 0;
+
+THREAD_FUNC_DECL FillIdHtableThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const char* const* item_ids = g_item_ids;
+  uint32_t* bucketed_item_uidxs = g_bucketed_item_uidxs;
+  const uint32_t* bucketed_item_hashes = g_bucketed_item_hashes;
+  uint32_t* id_htable = g_id_htable;
+  const uint32_t fill_end = g_htable_fill_starts[tidx + 1];
+  const uint32_t bucket_start = g_fill_bucket_starts[tidx];
+  const uint32_t bucket_end = g_fill_bucket_starts[tidx + 1];
+  // Items which can't be handled here (probe sequence would cross into the
+  // next thread's range, or store_all_dups and the ID is a duplicate) are
+  // deferred to the serial cleanup pass, using the top bit (never set in a
+  // valid item_uidx) as the marker.
+  if (!g_store_all_dups) {
+    for (uint32_t bucket_idx = bucket_start; bucket_idx < bucket_end; ++bucket_idx) {
+      if (IdHtableAddOrFlag(item_ids, bucketed_item_uidxs[bucket_idx], bucketed_item_hashes[bucket_idx], fill_end, 0, id_htable)) {
+        bucketed_item_uidxs[bucket_idx] |= 0x80000000U;
+      }
+    }
+  } else {
+    for (uint32_t bucket_idx = bucket_start; bucket_idx < bucket_end; ++bucket_idx) {
+      if (IdHtableAddIfNew(item_ids, bucketed_item_uidxs[bucket_idx], bucketed_item_hashes[bucket_idx], fill_end, id_htable)) {
+        bucketed_item_uidxs[bucket_idx] |= 0x80000000U;
+      }
+    }
   }
   THREAD_RETURN;
 }
@@ -2805,6 +2997,22 @@ PglErr PopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_
     if (bigstack_end_alloc_u32(item_ct, &g_item_id_hashes)) {
       goto PopulateIdHtableMt_ret_NOMEM;
     }
+    g_bucketed_item_uidxs = nullptr;
+    g_bucketed_item_hashes = nullptr;
+    if (thread_ct > 1) {
+      // Fill the hash table in parallel when there's room for the bucketed
+      // copies (without eating into the duplicate-tracking allocation);
+      // otherwise fall back to the serial loops below.
+      unsigned char* bigstack_end_mark2 = g_bigstack_end;
+      if (bigstack_end_alloc_u32(item_ct, &g_bucketed_item_uidxs) ||
+          bigstack_end_alloc_u32(item_ct, &g_bucketed_item_hashes) ||
+          (store_all_dups && (bigstack_left() < item_ct * 2 * sizeof(int32_t) + 4 * sizeof(int32_t)))) {
+        BigstackEndReset(bigstack_end_mark2);
+        g_bucketed_item_uidxs = nullptr;
+        g_bucketed_item_hashes = nullptr;
+      }
+    }
+    g_store_all_dups = store_all_dups;
     g_subset_mask = subset_mask;
     g_item_ids = item_ids;
     g_id_htable = id_htable;
@@ -2812,6 +3020,10 @@ PglErr PopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_
     g_id_htable_size = id_htable_size;
     g_calc_thread_ct = thread_ct;
     pthread_t threads[16];
+    for (uint32_t tidx = 0; tidx < thread_ct; ++tidx) {
+      g_htable_fill_starts[tidx] = RoundDownPow2((id_htable_size * S_CAST(uint64_t, tidx)) / thread_ct, kInt32PerCacheline);
+    }
+    g_htable_fill_starts[thread_ct] = id_htable_size;
     {
       uint32_t item_uidx = AdvTo1Bit(subset_mask, 0);
       uint32_t item_idx = 0;
@@ -2828,43 +3040,11 @@ PglErr PopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_
     }
     CalcIdHashThread(R_CAST(void*, 0));
     JoinThreads(thread_ct, threads);
-    // could also partial-sort and actually fill the hash table in a
-    // multithreaded manner, but I'll postpone that for now since it's tricky
-    // to make that work with duplicate ID handling, and it also is a
-    // substantially smaller bottleneck than hash value computation.
-    uint32_t item_uidx = 0;
-    if (!store_all_dups) {
-      for (uint32_t item_idx = 0; item_idx < item_ct; ++item_uidx, ++item_idx) {
-        MovU32To1Bit(subset_mask, &item_uidx);
-        uint32_t hashval = g_item_id_hashes[item_idx];
-        uint32_t cur_htable_entry = id_htable[hashval];
-        if (cur_htable_entry == UINT32_MAX) {
-          id_htable[hashval] = item_uidx;
-        } else {
-          const char* sptr = item_ids[item_uidx];
-          while (1) {
-            // could also use memcmp, guaranteed to be safe due to where
-            // variant IDs are allocated
-            if (!strcmp(sptr, item_ids[cur_htable_entry & 0x7fffffff])) {
-              if (!(cur_htable_entry >> 31)) {
-                id_htable[hashval] |= 0x80000000U;
-              }
-              break;
-            }
-            if (++hashval == id_htable_size) {
-              hashval = 0;
-            }
-            cur_htable_entry = id_htable[hashval];
-            if (cur_htable_entry == UINT32_MAX) {
-              id_htable[hashval] = item_uidx;
-              break;
-            }
-          }
-        }
-      }
-    } else {
+    uint32_t max_extra_alloc_m4 = 0;
+    uint32_t* htable_dup_base = nullptr;
+    uint32_t extra_alloc = 0;
+    if (store_all_dups) {
       const uintptr_t cur_bigstack_left = bigstack_left();
-      uint32_t max_extra_alloc_m4;
 #ifdef __LP64__
       if (cur_bigstack_left >= 0x400000000LLU) {
         // this can never be hit
@@ -2878,61 +3058,67 @@ PglErr PopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_
 #ifdef __LP64__
       }
 #endif
-      uint32_t extra_alloc = 0;
-      uint32_t prev_llidx = 0;
-      // needs to be synced with ExtractExcludeFlagNorange()
-      // multithread this?
-      uint32_t* htable_dup_base = R_CAST(uint32_t*, g_bigstack_base);
-      for (uint32_t item_idx = 0; item_idx < item_ct; ++item_uidx, ++item_idx) {
-        MovU32To1Bit(subset_mask, &item_uidx);
-        uint32_t hashval = g_item_id_hashes[item_idx];
-        uint32_t cur_htable_entry = id_htable[hashval];
-        if (cur_htable_entry == UINT32_MAX) {
-          id_htable[hashval] = item_uidx;
-        } else {
-          const char* sptr = item_ids[item_uidx];
-          while (1) {
-            const uint32_t cur_dup = cur_htable_entry >> 31;
-            uint32_t prev_uidx;
-            if (cur_dup) {
-              prev_llidx = cur_htable_entry * 2;
-              prev_uidx = htable_dup_base[prev_llidx];
-            } else {
-              prev_uidx = cur_htable_entry;
-            }
-            if (!strcmp(sptr, item_ids[prev_uidx])) {
-              if (extra_alloc > max_extra_alloc_m4) {
-                goto PopulateIdHtableMt_ret_NOMEM;
-              }
-              // point to linked list entry instead
-              if (!cur_dup) {
-                htable_dup_base[extra_alloc] = cur_htable_entry;
-                htable_dup_base[extra_alloc + 1] = UINT32_MAX;  // list end
-                prev_llidx = extra_alloc;
-                extra_alloc += 2;
-              }
-              htable_dup_base[extra_alloc] = item_uidx;
-              htable_dup_base[extra_alloc + 1] = prev_llidx;
-              id_htable[hashval] = 0x80000000U | (extra_alloc >> 1);
-              extra_alloc += 2;
-              break;  // bugfix
-            }
-            if (++hashval == id_htable_size) {
-              hashval = 0;
-            }
-            cur_htable_entry = id_htable[hashval];
-            if (cur_htable_entry == UINT32_MAX) {
-              id_htable[hashval] = item_uidx;
-              break;
-            }
+      htable_dup_base = R_CAST(uint32_t*, g_bigstack_base);
+    }
+    if (g_bucketed_item_uidxs) {
+      // Partial-sort items by the thread responsible for their home slot's
+      // range, then have each thread fill its own range.  Items in the same
+      // bucket stay in their original order, so duplicate IDs are resolved
+      // exactly as in the serial loops.
+      uint32_t write_offset = 0;
+      for (uint32_t fill_tidx = 0; fill_tidx < thread_ct; ++fill_tidx) {
+        g_fill_bucket_starts[fill_tidx] = write_offset;
+        for (uint32_t hash_tidx = 0; hash_tidx < thread_ct; ++hash_tidx) {
+          const uint32_t cur_ct = g_fill_bucket_cts[hash_tidx][fill_tidx];
+          g_fill_bucket_cts[hash_tidx][fill_tidx] = write_offset;
+          write_offset += cur_ct;
+        }
+      }
+      g_fill_bucket_starts[thread_ct] = write_offset;
+      if (SpawnThreads(ScatterIdHashThread, thread_ct, threads)) {
+        goto PopulateIdHtableMt_ret_THREAD_CREATE_FAIL;
+      }
+      ScatterIdHashThread(R_CAST(void*, 0));
+      JoinThreads(thread_ct, threads);
+      if (SpawnThreads(FillIdHtableThread, thread_ct, threads)) {
+        goto PopulateIdHtableMt_ret_THREAD_CREATE_FAIL;
+      }
+      FillIdHtableThread(R_CAST(void*, 0));
+      JoinThreads(thread_ct, threads);
+      // Deferred items.  Duplicates of a deferred item are always deferred
+      // too, and are still visited in order.
+      for (uint32_t bucket_idx = 0; bucket_idx < item_ct; ++bucket_idx) {
+        const uint32_t bucketed_item_uidx = g_bucketed_item_uidxs[bucket_idx];
+        if (bucketed_item_uidx & 0x80000000U) {
+          const uint32_t item_uidx = bucketed_item_uidx & 0x7fffffff;
+          const uint32_t hashval = g_bucketed_item_hashes[bucket_idx];
+          if (!store_all_dups) {
+            IdHtableAddOrFlag(item_ids, item_uidx, hashval, id_htable_size, 1, id_htable);
+          } else if (IdHtableAddToDupList(item_ids, item_uidx, hashval, id_htable_size, max_extra_alloc_m4, htable_dup_base, &extra_alloc, id_htable)) {
+            goto PopulateIdHtableMt_ret_NOMEM;
           }
         }
       }
-      if (extra_alloc) {
-        // bugfix: forgot to align this
-        bigstack_alloc_raw_rd(extra_alloc * sizeof(int32_t));
+    } else {
+      uint32_t item_uidx = 0;
+      if (!store_all_dups) {
+        for (uint32_t item_idx = 0; item_idx < item_ct; ++item_uidx, ++item_idx) {
+          MovU32To1Bit(subset_mask, &item_uidx);
+          IdHtableAddOrFlag(item_ids, item_uidx, g_item_id_hashes[item_idx], id_htable_size, 1, id_htable);
+        }
+      } else {
+        for (uint32_t item_idx = 0; item_idx < item_ct; ++item_uidx, ++item_idx) {
+          MovU32To1Bit(subset_mask, &item_uidx);
+          if (IdHtableAddToDupList(item_ids, item_uidx, g_item_id_hashes[item_idx], id_htable_size, max_extra_alloc_m4, htable_dup_base, &extra_alloc, id_htable)) {
+            goto PopulateIdHtableMt_ret_NOMEM;
+          }
+        }
       }
     }
+    if (extra_alloc) {
+      // bugfix: forgot to align this
+      bigstack_alloc_raw_rd(extra_alloc * sizeof(int32_t));
+    }
   }
   while (0) {
   PopulateIdHtableMt_ret_NOMEM:
@@ -2977,6 +3163,197 @@ PglErr AllocAndPopulateIdHtableMt(const uintptr_t* subset_mask, const char* cons
 }
 
 
+// Multithreaded LSD radix sort state.  In each pass, thread tidx handles
+// source keys [RadixSortChunkStart(tidx), RadixSortChunkStart(tidx + 1)).
+static const uint64_t* g_radix_src_keys = nullptr;
+static const uint32_t* g_radix_src_payloads = nullptr;
+static uint64_t* g_radix_dst_keys = nullptr;
+static uint32_t* g_radix_dst_payloads = nullptr;
+// [tidx][byte_idx][digit] counts, converted to write offsets before each
+// scatter step
+static uintptr_t* g_radix_cts = nullptr;
+static uintptr_t g_radix_ct = 0;
+static uint32_t g_radix_thread_ct = 0;
+static uint32_t g_radix_byte_idx = 0;
+
+CONSTU31(kRadixSortDigitCt, 256);
+
+HEADER_INLINE uintptr_t RadixSortChunkStart(uintptr_t tidx) {
+  return (S_CAST(uint64_t, g_radix_ct) * tidx) / g_radix_thread_ct;
+}
+
+// Initial pass: counts all eight bytes at once, so that bytes which are
+// identical across all keys can be skipped.
+THREAD_FUNC_DECL RadixSortU64CountAllThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint64_t* src_keys = g_radix_src_keys;
+  const uintptr_t key_idx_end = RadixSortChunkStart(tidx + 1);
+  uintptr_t* cts = &(g_radix_cts[tidx * 8 * kRadixSortDigitCt]);
+  ZeroWArr(8 * kRadixSortDigitCt, cts);
+  for (uintptr_t key_idx = RadixSortChunkStart(tidx); key_idx != key_idx_end; ++key_idx) {
+    uint64_t cur_key = src_keys[key_idx];
+    for (uint32_t byte_idx = 0; byte_idx != 8; ++byte_idx) {
+      cts[byte_idx * kRadixSortDigitCt + (cur_key & 255)] += 1;
+      cur_key >>= 8;
+    }
+  }
+  THREAD_RETURN;
+}
+
+THREAD_FUNC_DECL RadixSortU64CountThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint64_t* src_keys = g_radix_src_keys;
+  const uint32_t byte_idx = g_radix_byte_idx;
+  const uint32_t shift = byte_idx * CHAR_BIT;
+  const uintptr_t key_idx_end = RadixSortChunkStart(tidx + 1);
+  uintptr_t* cts = &(g_radix_cts[(tidx * 8 + byte_idx) * kRadixSortDigitCt]);
+  ZeroWArr(kRadixSortDigitCt, cts);
+  for (uintptr_t key_idx = RadixSortChunkStart(tidx); key_idx != key_idx_end; ++key_idx) {
+    cts[(src_keys[key_idx] >> shift) & 255] += 1;
+  }
+  THREAD_RETURN;
+}
+
+THREAD_FUNC_DECL RadixSortU64ScatterThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint64_t* src_keys = g_radix_src_keys;
+  const uint32_t* src_payloads = g_radix_src_payloads;
+  uint64_t* dst_keys = g_radix_dst_keys;
+  uint32_t* dst_payloads = g_radix_dst_payloads;
+  const uint32_t byte_idx = g_radix_byte_idx;
+  const uint32_t shift = byte_idx * CHAR_BIT;
+  const uintptr_t key_idx_end = RadixSortChunkStart(tidx + 1);
+  uintptr_t* write_offsets = &(g_radix_cts[(tidx * 8 + byte_idx) * kRadixSortDigitCt]);
+  uintptr_t key_idx = RadixSortChunkStart(tidx);
+  if (!src_payloads) {
+    for (; key_idx != key_idx_end; ++key_idx) {
+      const uint64_t cur_key = src_keys[key_idx];
+      dst_keys[write_offsets[(cur_key >> shift) & 255]++] = cur_key;
+    }
+  } else {
+    for (; key_idx != key_idx_end; ++key_idx) {
+      const uint64_t cur_key = src_keys[key_idx];
+      const uintptr_t write_idx = write_offsets[(cur_key >> shift) & 255]++;
+      dst_keys[write_idx] = cur_key;
+      dst_payloads[write_idx] = src_payloads[key_idx];
+    }
+  }
+  THREAD_RETURN;
+}
+
+PglErr RadixSortU64Mt(uintptr_t ct, uint32_t max_thread_ct, uint64_t* keys, uint32_t* payloads) {
+  if (ct < 2) {
+    return kPglRetSuccess;
+  }
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  PglErr reterr = kPglRetSuccess;
+  {
+    // memory-bound, so there's little point in going past 16 threads
+    uint32_t thread_ct = MINV(max_thread_ct, 16);
+    if (thread_ct > ct / 65536) {
+      thread_ct = ct / 65536;
+      if (!thread_ct) {
+        thread_ct = 1;
+      }
+    }
+    uint64_t* keys_tmp;
+    uint32_t* payloads_tmp = nullptr;
+    if (bigstack_end_alloc_u64(ct, &keys_tmp) ||
+        bigstack_end_alloc_w(thread_ct * 8 * kRadixSortDigitCt, &g_radix_cts) ||
+        (payloads && bigstack_end_alloc_u32(ct, &payloads_tmp))) {
+      goto RadixSortU64Mt_ret_NOMEM;
+    }
+    g_radix_ct = ct;
+    g_radix_thread_ct = thread_ct;
+    g_radix_src_keys = keys;
+    g_radix_src_payloads = payloads;
+    g_radix_dst_keys = keys_tmp;
+    g_radix_dst_payloads = payloads_tmp;
+    pthread_t threads[16];
+    if (SpawnThreads(RadixSortU64CountAllThread, thread_ct, threads)) {
+      goto RadixSortU64Mt_ret_THREAD_CREATE_FAIL;
+    }
+    RadixSortU64CountAllThread(R_CAST(void*, 0));
+    JoinThreads(thread_ct, threads);
+    const uint64_t first_key = keys[0];
+    uint32_t pass_ct = 0;
+    for (uint32_t byte_idx = 0; byte_idx != 8; ++byte_idx) {
+      const uintptr_t first_digit = (first_key >> (byte_idx * CHAR_BIT)) & 255;
+      uintptr_t first_digit_ct = 0;
+      for (uint32_t tidx = 0; tidx != thread_ct; ++tidx) {
+        first_digit_ct += g_radix_cts[(tidx * 8 + byte_idx) * kRadixSortDigitCt + first_digit];
+      }
+      if (first_digit_ct == ct) {
+        continue;
+      }
+      g_radix_byte_idx = byte_idx;
+      if (pass_ct) {
+        // keys have moved since the initial count
+        if (SpawnThreads(RadixSortU64CountThread, thread_ct, threads)) {
+          goto RadixSortU64Mt_ret_THREAD_CREATE_FAIL;
+        }
+        RadixSortU64CountThread(R_CAST(void*, 0));
+        JoinThreads(thread_ct, threads);
+      }
+      // stable: within each digit, earlier chunks are written first
+      uintptr_t write_offset = 0;
+      for (uint32_t digit = 0; digit != kRadixSortDigitCt; ++digit) {
+        for (uint32_t tidx = 0; tidx != thread_ct; ++tidx) {
+          uintptr_t* cur_ct_ptr = &(g_radix_cts[(tidx * 8 + byte_idx) * kRadixSortDigitCt + digit]);
+          const uintptr_t cur_ct = *cur_ct_ptr;
+          *cur_ct_ptr = write_offset;
+          write_offset += cur_ct;
+        }
+      }
+      if (SpawnThreads(RadixSortU64ScatterThread, thread_ct, threads)) {
+        goto RadixSortU64Mt_ret_THREAD_CREATE_FAIL;
+      }
+      RadixSortU64ScatterThread(R_CAST(void*, 0));
+      JoinThreads(thread_ct, threads);
+      uint64_t* new_src_keys = g_radix_dst_keys;
+      g_radix_dst_keys = K_CAST(uint64_t*, g_radix_src_keys);
+      g_radix_src_keys = new_src_keys;
+      uint32_t* new_src_payloads = g_radix_dst_payloads;
+      g_radix_dst_payloads = K_CAST(uint32_t*, g_radix_src_payloads);
+      g_radix_src_payloads = new_src_payloads;
+      ++pass_ct;
+    }
+    if (pass_ct & 1) {
+      memcpy(keys, keys_tmp, ct * sizeof(int64_t));
+      if (payloads) {
+        memcpy(payloads, payloads_tmp, ct * sizeof(int32_t));
+      }
+    }
+  }
+  while (0) {
+  RadixSortU64Mt_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  RadixSortU64Mt_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  }
+  BigstackEndReset(bigstack_end_mark);
+  return reterr;
+}
+
+
+PglErr SortU64Mt(uintptr_t ct, uint32_t max_thread_ct, uint64_t* keys) {
+  if (ct >= 65536) {
+    const PglErr reterr = RadixSortU64Mt(ct, max_thread_ct, keys, nullptr);
+    if (reterr != kPglRetNomem) {
+      return reterr;
+    }
+  }
+#ifdef __cplusplus
+  std::sort(keys, &(keys[ct]));
+#else
+  qsort(keys, ct, sizeof(int64_t), uint64cmp);
+#endif
+  return kPglRetSuccess;
+}
+
+
 uint32_t Edit1Match(const char* s1, const char* s2, uint32_t len1, uint32_t len2) {
   // permit one difference of the following forms:
   // - inserted/deleted character
@@ -1604,11 +1604,26 @@ HEADER_INLINE void CleanupThreads3z(ThreadsState* tsp, uint32_t* cur_block_sizep
 }
 
 
+// Both hashing and (when 8 bytes/item of scratch space are available at the
+// bigstack end) table filling are multithreaded once item_ct >= 131072.  The
+// resulting table contents are independent of thread count, except for slot
+// placement.
 PglErr PopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_ids, uintptr_t item_ct, uint32_t store_all_dups, uint32_t id_htable_size, uint32_t thread_ct, uint32_t* id_htable);
 
 // pass in htable_dup_base_ptr == nullptr if not storing all duplicate IDs
 PglErr AllocAndPopulateIdHtableMt(const uintptr_t* subset_mask, const char* const* item_ids, uintptr_t item_ct, uint32_t max_thread_ct, uint32_t** id_htable_ptr, uint32_t** htable_dup_base_ptr, uint32_t* id_htable_size_ptr);
 
+// Stable LSD radix sort (8 bits per pass) of 64-bit unsigned keys;
+// multithreaded once ct >= 131072.  If payloads is non-null, it's permuted
+// along with keys.  Passes over bytes which are identical across all keys are
+// skipped, so e.g. (bp << 32) | variant_uidx keys usually need only 5-6
+// passes.  Requires 8 (+4 with payloads) bytes/key at the bigstack end.
+PglErr RadixSortU64Mt(uintptr_t ct, uint32_t max_thread_ct, uint64_t* keys, uint32_t* payloads);
+
+// Uses RadixSortU64Mt() when ct >= 65536 and there's enough workspace, and a
+// comparison sort otherwise.  Can only fail with kPglRetThreadCreateFail.
+PglErr SortU64Mt(uintptr_t ct, uint32_t max_thread_ct, uint64_t* keys);
+
 
 typedef struct HelpCtrlStruct {
   uint32_t iters_left;
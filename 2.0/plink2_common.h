@@ -121,7 +121,10 @@ FLAGSET64_DEF_START()
   kfMiscBiallelicOnlyStrict = (1LLU << 36),
   kfMiscBiallelicOnlyList = (1LLU << 37),
   kfMiscStrictSid0 = (1LLU << 38),
-  kfMiscAllowBadFreqs = (1LLU << 39)
+  kfMiscAllowBadFreqs = (1LLU << 39),
+  kfMiscBgenDirect = (1LLU << 40),
+  kfMiscPvarCache = (1LLU << 41),
+  kfMiscFreqCache = (1LLU << 42)
 FLAGSET64_DEF_END(MiscFlags);
 
 FLAGSET64_DEF_START()
@@ -134,38 +137,42 @@ FLAGSET64_DEF_START()
   kfExportfA = (1 << 5),
   kfExportfATranspose = (1 << 6),
   kfExportfAD = (1 << 7),
-  kfExportfBeagle = (1 << 8),
-  kfExportfBeagleNomap = (1 << 9),
-  kfExportfBgen11 = (1 << 10),
-  kfExportfBgen12 = (1 << 11),
-  kfExportfBgen13 = (1 << 12),
-  kfExportfBimbam = (1 << 13),
-  kfExportfBimbam1chr = (1 << 14),
-  kfExportfFastphase = (1 << 15),
-  kfExportfFastphase1chr = (1 << 16),
-  kfExportfHaps = (1 << 17),
-  kfExportfHapsLegend = (1 << 18),
-  kfExportfHv = (1 << 19),
-  kfExportfHv1chr = (1 << 20),
-  kfExportfIndMajorBed = (1 << 21),
-  kfExportfLgen = (1 << 22),
-  kfExportfLgenRef = (1 << 23),
-  kfExportfList = (1 << 24),
-  kfExportfRlist = (1 << 25),
-  kfExportfOxGen = (1 << 26),
-  kfExportfPed = (1 << 27),
-  kfExportfCompound = (1 << 28),
-  kfExportfStructure = (1 << 29),
-  kfExportfTranspose = (1 << 30),
-  kfExportfVcf = (1U << 31),
+  kfExportfBcf = (1 << 8),
+  kfExportfBeagle = (1 << 9),
+  kfExportfBeagleNomap = (1 << 10),
+  kfExportfBgen11 = (1 << 11),
+  kfExportfBgen12 = (1 << 12),
+  kfExportfBgen13 = (1 << 13),
+  kfExportfBimbam = (1 << 14),
+  kfExportfBimbam1chr = (1 << 15),
+  kfExportfFastphase = (1 << 16),
+  kfExportfFastphase1chr = (1 << 17),
+  kfExportfHaps = (1 << 18),
+  kfExportfHapsLegend = (1 << 19),
+  kfExportfHv = (1 << 20),
+  kfExportfHv1chr = (1 << 21),
+  kfExportfIndMajorBed = (1 << 22),
+  kfExportfLgen = (1 << 23),
+  kfExportfLgenRef = (1 << 24),
+  kfExportfList = (1 << 25),
+  kfExportfRlist = (1 << 26),
+  kfExportfOxGen = (1 << 27),
+  kfExportfPed = (1 << 28),
+  kfExportfCompound = (1 << 29),
+  kfExportfStructure = (1 << 30),
+  kfExportfTranspose = (1LLU << 31),
+  kfExportfVcf = (1LLU << 32),
   kfExportfTypemask = (2LLU * kfExportfVcf) - kfExportf23,
-  kfExportfIncludeAlt = (1LLU << 32),
-  kfExportfBgz = (1LLU << 33),
-  kfExportfVcfDosageGp = (1LLU << 34),
-  kfExportfVcfDosageDs = (1LLU << 35),
-  kfExportfVcfDosageHds = (1LLU << 36),
-  kfExportfVcfDosageForce = (1LLU << 37),
-  kfExportfOmitNonmaleY = (1LLU << 38)
+  kfExportfIncludeAlt = (1LLU << 33),
+  kfExportfBgz = (1LLU << 34),
+  kfExportfVcfDosageGp = (1LLU << 35),
+  kfExportfVcfDosageDs = (1LLU << 36),
+  kfExportfVcfDosageHds = (1LLU << 37),
+  kfExportfVcfDosageForce = (1LLU << 38),
+  kfExportfOmitNonmaleY = (1LLU << 39),
+  kfExportfVcfIndexTbi = (1LLU << 40),
+  kfExportfVcfIndexCsi = (1LLU << 41),
+  kfExportfBgenIndex = (1LLU << 42)
 FLAGSET64_DEF_END(ExportfFlags);
 
 FLAGSET_DEF_START()
@@ -187,6 +194,22 @@ FLAGSET_DEF_START()
   kfInfoPrNonrefDefault = (1 << 3),
 FLAGSET_DEF_END(InfoFlags);
 
+// BCF2 typed-value type codes (low 4 bits of a type descriptor byte; the high
+// 4 bits are the value count, with 15 indicating that the actual count follows
+// as a typed integer).
+ENUM_U31_DEF_START()
+  kBcfTypeNull = 0,
+  kBcfTypeInt8 = 1,
+  kBcfTypeInt16 = 2,
+  kBcfTypeInt32 = 3,
+  kBcfTypeFloat = 5,
+  kBcfTypeChar = 7
+ENUM_U31_DEF_END(BcfType);
+
+// BCF2 float missing-value and end-of-vector bit patterns
+CONSTU31(kBcfFloatMissingBits, 0x7f800001);
+CONSTU31(kBcfFloatVectorEndBits, 0x7f800002);
+
 typedef struct SampleIdInfoStruct {
   char* sample_ids;
   char* sids;
@@ -19,6 +19,9 @@
 #include "plink2_data.h"
 #include "plink2_pvar.h"
 
+#include <sys/stat.h>  // stat()
+#include <unistd.h>  // unlink()
+
 #ifdef __cplusplus
 namespace plink2 {
 #endif
@@ -162,7 +165,11 @@ void PvarInfoWrite(uint32_t info_pr_flag_present, uint32_t is_pr, char* info_tok
   uint32_t info_token_slen = info_token_end - info_token;
   char* info_token_pr = nullptr;
   if (info_pr_flag_present) {
+    // PrInInfoToken() may null-terminate the token; restore the delimiter so
+    // a reload stream's line ending isn't clobbered.
+    const char info_token_delim = *info_token_end;
     info_token_pr = PrInInfoToken(info_token_slen, info_token);
+    *info_token_end = info_token_delim;
   }
   char* write_iter = *write_iter_ptr;
   if (is_pr || (!info_token_pr))  {
@@ -243,7 +250,7 @@ void AppendChrsetLine(const ChrInfo* cip, char** write_iter_ptr) {
   AppendBinaryEoln(write_iter_ptr);
 }
 
-PglErr WritePvar(const char* outname, const char* xheader, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* qual_present, const float* quals, const uintptr_t* filter_present, const uintptr_t* filter_npass, const char* const* filter_storage, const uintptr_t* nonref_flags, const char* pvar_info_reload, const double* variant_cms, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t nonref_flags_storage, uint32_t max_filter_slen, uint32_t info_reload_slen, PvarPsamFlags pvar_psam_flags, uint32_t thread_ct) {
+PglErr WritePvar(const char* outname, const char* xheader, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* qual_present, const float* quals, const uintptr_t* filter_present, const uintptr_t* filter_npass, const char* const* filter_storage, const uintptr_t* nonref_flags, const char* pvar_info_reload, const char* const* pvar_info_strs, const double* variant_cms, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t nonref_flags_storage, uint32_t max_filter_slen, uint32_t info_reload_slen, PvarPsamFlags pvar_psam_flags, uint32_t thread_ct) {
   // allele_dosages must be nullptr unless we're trimming alt alleles
   unsigned char* bigstack_mark = g_bigstack_base;
   char* cswritep = nullptr;
@@ -303,7 +310,7 @@ PglErr WritePvar(const char* outname, const char* xheader, const uintptr_t* vari
     }
     // bugfix (30 Jul 2017): may be necessary to reload INFO when no ## lines
     // are in the header
-    if (pvar_info_reload) {
+    if (pvar_info_reload && (!pvar_info_strs)) {
       reterr = PvarInfoOpenAndReloadHeader(pvar_info_reload, 1 + (thread_ct > 1), &pvar_reload_rls, &pvar_info_line_iter, &info_col_idx);
       if (reterr) {
         goto WritePvar_ret_1;
@@ -454,7 +461,9 @@ PglErr WritePvar(const char* outname, const char* xheader, const uintptr_t* vari
       if (write_info) {
         *cswritep++ = '\t';
         const uint32_t is_pr = all_nonref || (nonref_flags && IsSet(nonref_flags, variant_uidx));
-        if (pvar_info_line_iter) {
+        if (pvar_info_strs) {
+          PvarInfoWrite(info_pr_flag_present, is_pr, K_CAST(char*, pvar_info_strs[variant_uidx]), &cswritep);
+        } else if (pvar_info_line_iter) {
           reterr = PvarInfoReloadAndWrite(info_pr_flag_present, info_col_idx, variant_uidx, is_pr, &pvar_reload_rls, &pvar_info_line_iter, &cswritep, &rls_variant_uidx);
           if (reterr) {
             goto WritePvar_ret_1;
@@ -1249,6 +1258,14 @@ static uint32_t* g_x_nosex_geno_cts = nullptr;
 static uint32_t* g_founder_x_nosex_geno_cts = nullptr;
 static double* g_mach_r2_vals = nullptr;
 
+// per-thread sample missingness accumulators, same layout as
+// LoadSampleMissingCtsThread()'s; indexed by position in g_sample_include
+static uintptr_t** g_sample_missing_hc_acc1 = nullptr;
+static uintptr_t** g_sample_missing_dosage_acc1 = nullptr;
+static uintptr_t** g_sample_hethap_acc1 = nullptr;
+// unsubsetted scratch space, only needed when subsetting
+static uintptr_t** g_sample_raw_bufs = nullptr;
+
 static unsigned char* g_writebufs[2] = {nullptr, nullptr};
 
 static const uintptr_t* g_variant_include = nullptr;
@@ -1330,6 +1347,55 @@ THREAD_FUNC_DECL LoadAlleleAndGenoCountsThread(void* arg) {
     const uint32_t x_chr_fo_idx = cip->chr_idx_to_foidx[x_code];
     x_start = cip->chr_fo_vidx_start[x_chr_fo_idx];
   }
+  // Sample missingness accumulation piggybacks on the first subset's pass, so
+  // --missing doesn't need a separate LoadSampleMissingCts() read.
+  const uint32_t raw_sample_ctaw = BitCtToAlignedWordCt(raw_sample_ct);
+  const uint32_t is_diploid_x = !IsSet(cip->haploid_mask, 0);
+  const uint32_t acc1_vec_ct = BitCtToVecCt(g_sample_ct);
+  const uint32_t acc4_vec_ct = acc1_vec_ct * 4;
+  const uint32_t acc8_vec_ct = acc1_vec_ct * 8;
+  uintptr_t* missing_hc_acc1 = nullptr;
+  uintptr_t* missing_hc_acc4 = nullptr;
+  uintptr_t* missing_hc_acc8 = nullptr;
+  uintptr_t* missing_hc_acc32 = nullptr;
+  uintptr_t* missing_dosage_acc1 = nullptr;
+  uintptr_t* missing_dosage_acc4 = nullptr;
+  uintptr_t* missing_dosage_acc8 = nullptr;
+  uintptr_t* missing_dosage_acc32 = nullptr;
+  uintptr_t* hethap_acc1 = nullptr;
+  uintptr_t* hethap_acc4 = nullptr;
+  uintptr_t* hethap_acc8 = nullptr;
+  uintptr_t* hethap_acc32 = nullptr;
+  uintptr_t* raw_bufs = nullptr;
+  // GetRefNonrefGenotypeCountsAndDosage16s() never keeps a subsetted LD cache
+  // when dosages are present
+  const uint32_t unsubsetted_ldcache = (g_sample_ct != raw_sample_ct) && (pgrp->fi.gflags & (kfPgenGlobalDosagePresent | kfPgenGlobalDosagePhasePresent));
+  if (g_sample_missing_hc_acc1) {
+    missing_hc_acc1 = g_sample_missing_hc_acc1[tidx];
+    missing_hc_acc4 = &(missing_hc_acc1[acc1_vec_ct * kWordsPerVec]);
+    missing_hc_acc8 = &(missing_hc_acc4[acc4_vec_ct * kWordsPerVec]);
+    missing_hc_acc32 = &(missing_hc_acc8[acc8_vec_ct * kWordsPerVec]);
+    ZeroWArr(acc1_vec_ct * kWordsPerVec * 45, missing_hc_acc1);
+    if (g_sample_missing_dosage_acc1) {
+      missing_dosage_acc1 = g_sample_missing_dosage_acc1[tidx];
+      missing_dosage_acc4 = &(missing_dosage_acc1[acc1_vec_ct * kWordsPerVec]);
+      missing_dosage_acc8 = &(missing_dosage_acc4[acc4_vec_ct * kWordsPerVec]);
+      missing_dosage_acc32 = &(missing_dosage_acc8[acc8_vec_ct * kWordsPerVec]);
+      ZeroWArr(acc1_vec_ct * kWordsPerVec * 45, missing_dosage_acc1);
+    }
+    hethap_acc1 = g_sample_hethap_acc1[tidx];
+    hethap_acc4 = &(hethap_acc1[acc1_vec_ct * kWordsPerVec]);
+    hethap_acc8 = &(hethap_acc4[acc4_vec_ct * kWordsPerVec]);
+    hethap_acc32 = &(hethap_acc8[acc8_vec_ct * kWordsPerVec]);
+    ZeroWArr(acc1_vec_ct * kWordsPerVec * 45, hethap_acc1);
+    if (g_sample_raw_bufs) {
+      raw_bufs = g_sample_raw_bufs[tidx];
+    }
+  }
+  uint32_t all_ct_rem15 = 15;
+  uint32_t all_ct_rem255d15 = 17;
+  uint32_t hap_ct_rem15 = 15;
+  uint32_t hap_ct_rem255d15 = 17;
   while (1) {
     const uint32_t is_last_block = g_is_last_thread_block;
     const uintptr_t cur_block_write_ct = g_cur_block_write_ct;
@@ -1533,6 +1599,104 @@ THREAD_FUNC_DECL LoadAlleleAndGenoCountsThread(void* arg) {
           }
           variant_missing_dosage_cts[variant_uidx] = missing_dosage_ct;
         }
+        if (missing_hc_acc1 && (!subset_idx)) {
+          // same chrX/chrY conventions as LoadSampleMissingCtsThread()
+          uintptr_t* cur_hets = (is_x_or_y || is_nonxy_haploid)? hethap_acc1 : nullptr;
+          // when raw_bufs is non-null, bits are first computed for all
+          // samples and then subsetted
+          uintptr_t* missing_hc_raw = missing_hc_acc1;
+          uintptr_t* missing_dosage_raw = missing_dosage_acc1;
+          uintptr_t* hets_raw = cur_hets;
+          if (raw_bufs) {
+            missing_hc_raw = raw_bufs;
+            if (cur_hets) {
+              hets_raw = &(raw_bufs[raw_sample_ctaw]);
+            }
+            if (missing_dosage_acc1) {
+              missing_dosage_raw = &(raw_bufs[2 * raw_sample_ctaw]);
+            }
+          }
+          if (!is_x_or_y) {
+            // Record is still in the loaded block.  The LD cache must be
+            // accessed with the same subsetting convention as
+            // PgrGetDWithCounts() above.
+            if (unsubsetted_ldcache) {
+              reterr = PgrGetMissingnessPD(nullptr, nullptr, raw_sample_ct, variant_uidx, pgrp, missing_hc_raw, missing_dosage_raw, hets_raw, genovec);
+            } else {
+              reterr = PgrGetMissingnessPD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, missing_hc_acc1, missing_dosage_acc1, cur_hets, genovec);
+            }
+            if (reterr) {
+              g_error_ret = reterr;
+              break;
+            }
+          } else if (is_y) {
+            // counts above were restricted to males, while hethaps are
+            // tracked for everyone, so the LD cache can't be shared
+            PgrClearLdCache(pgrp);
+            reterr = PgrGetMissingnessPD(nullptr, nullptr, raw_sample_ct, variant_uidx, pgrp, missing_hc_raw, missing_dosage_raw, hets_raw, genovec);
+            PgrClearLdCache(pgrp);
+            if (reterr) {
+              g_error_ret = reterr;
+              break;
+            }
+            BitvecAnd(sex_male, raw_sample_ctaw, missing_hc_raw);
+            if (missing_dosage_raw) {
+              BitvecAnd(sex_male, raw_sample_ctaw, missing_dosage_raw);
+            }
+          } else {
+            // chrX: reuse the unsubsetted genovec loaded above
+            ZeroTrailingQuaters(raw_sample_ct, genovec);
+            GenovecToMissingnessUnsafe(genovec, raw_sample_ct, missing_hc_raw);
+            if (missing_dosage_raw) {
+              memcpy(missing_dosage_raw, missing_hc_raw, raw_sample_ctl * sizeof(intptr_t));
+              if (dosage_ct) {
+                BitvecAndNot(dosage_present, raw_sample_ctaw, missing_dosage_raw);
+              }
+            }
+            PgrDetectGenovecHetsUnsafe(genovec, QuaterCtToWordCt(raw_sample_ct), hets_raw);
+            if (is_diploid_x) {
+              BitvecAnd(sex_male, raw_sample_ctaw, hets_raw);
+            }
+          }
+          if (raw_bufs && (is_x_or_y || unsubsetted_ldcache)) {
+            CopyBitarrSubset(missing_hc_raw, sample_include, sample_ct, missing_hc_acc1);
+            if (missing_dosage_acc1) {
+              CopyBitarrSubset(missing_dosage_raw, sample_include, sample_ct, missing_dosage_acc1);
+            }
+            if (cur_hets) {
+              CopyBitarrSubset(hets_raw, sample_include, sample_ct, cur_hets);
+            }
+          }
+          VcountIncr1To4(missing_hc_acc1, acc1_vec_ct, missing_hc_acc4);
+          if (missing_dosage_acc1) {
+            VcountIncr1To4(missing_dosage_acc1, acc1_vec_ct, missing_dosage_acc4);
+          }
+          if (!(--all_ct_rem15)) {
+            Vcount0Incr4To8(acc4_vec_ct, missing_hc_acc4, missing_hc_acc8);
+            if (missing_dosage_acc1) {
+              Vcount0Incr4To8(acc4_vec_ct, missing_dosage_acc4, missing_dosage_acc8);
+            }
+            all_ct_rem15 = 15;
+            if (!(--all_ct_rem255d15)) {
+              Vcount0Incr8To32(acc8_vec_ct, missing_hc_acc8, missing_hc_acc32);
+              if (missing_dosage_acc1) {
+                Vcount0Incr8To32(acc8_vec_ct, missing_dosage_acc8, missing_dosage_acc32);
+              }
+              all_ct_rem255d15 = 17;
+            }
+          }
+          if (cur_hets) {
+            VcountIncr1To4(cur_hets, acc1_vec_ct, hethap_acc4);
+            if (!(--hap_ct_rem15)) {
+              Vcount0Incr4To8(acc4_vec_ct, hethap_acc4, hethap_acc8);
+              hap_ct_rem15 = 15;
+              if (!(--hap_ct_rem255d15)) {
+                Vcount0Incr8To32(acc8_vec_ct, hethap_acc8, hethap_acc32);
+                hap_ct_rem255d15 = 17;
+              }
+            }
+          }
+        }
       }
       if ((++subset_idx == subset_ct) || reterr) {
         break;
@@ -1559,17 +1723,35 @@ THREAD_FUNC_DECL LoadAlleleAndGenoCountsThread(void* arg) {
       PgrClearLdCache(pgrp);
     }
     if (is_last_block) {
+      if (missing_hc_acc1) {
+        VcountIncr4To8(missing_hc_acc4, acc4_vec_ct, missing_hc_acc8);
+        VcountIncr8To32(missing_hc_acc8, acc8_vec_ct, missing_hc_acc32);
+        if (missing_dosage_acc1) {
+          VcountIncr4To8(missing_dosage_acc4, acc4_vec_ct, missing_dosage_acc8);
+          VcountIncr8To32(missing_dosage_acc8, acc8_vec_ct, missing_dosage_acc32);
+        }
+        VcountIncr4To8(hethap_acc4, acc4_vec_ct, hethap_acc8);
+        VcountIncr8To32(hethap_acc8, acc8_vec_ct, hethap_acc32);
+      }
       THREAD_RETURN;
     }
     THREAD_BLOCK_FINISH(tidx);
   }
 }
 
-PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t* founder_info, const uintptr_t* sex_nm, const uintptr_t* sex_male, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t founder_ct, uint32_t male_ct, uint32_t nosex_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t first_hap_uidx, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, uint64_t* allele_dosages, uint64_t* founder_allele_dosages, uint32_t* variant_missing_hc_cts, uint32_t* variant_missing_dosage_cts, uint32_t* variant_hethap_cts, uint32_t* raw_geno_cts, uint32_t* founder_raw_geno_cts, uint32_t* x_male_geno_cts, uint32_t* founder_x_male_geno_cts, uint32_t* x_nosex_geno_cts, uint32_t* founder_x_nosex_geno_cts, double* mach_r2_vals) {
+PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t* founder_info, const uintptr_t* sex_nm, const uintptr_t* sex_male, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t founder_ct, uint32_t male_ct, uint32_t nosex_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t first_hap_uidx, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, uint64_t* allele_dosages, uint64_t* founder_allele_dosages, uint32_t* variant_missing_hc_cts, uint32_t* variant_missing_dosage_cts, uint32_t* variant_hethap_cts, uint32_t* raw_geno_cts, uint32_t* founder_raw_geno_cts, uint32_t* x_male_geno_cts, uint32_t* founder_x_male_geno_cts, uint32_t* x_nosex_geno_cts, uint32_t* founder_x_nosex_geno_cts, double* mach_r2_vals, uint32_t* sample_missing_hc_cts, uint32_t* sample_missing_dosage_cts, uint32_t* sample_hethap_cts) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   PglErr reterr = kPglRetSuccess;
   {
+    if (sample_missing_hc_cts) {
+      // only entries for sample_include samples are filled in below
+      ZeroU32Arr(raw_sample_ct, sample_missing_hc_cts);
+      if (sample_missing_dosage_cts) {
+        ZeroU32Arr(raw_sample_ct, sample_missing_dosage_cts);
+      }
+      ZeroU32Arr(raw_sample_ct, sample_hethap_cts);
+    }
     if (!variant_ct) {
       goto LoadAlleleAndGenoCounts_ret_1;
     }
@@ -1588,7 +1770,7 @@ PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t*
     // 4. both required, and founder_ct == sample_ct.  caller is expected to
     //    make founder_allele_dosages and allele_dosages point to the same
     //    memory, ditto for founder_raw_geno_cts/raw_geno_cts.
-    const uint32_t only_founder_cts_required = (!allele_dosages) && (!raw_geno_cts) && (!variant_missing_hc_cts) && (!variant_missing_dosage_cts);
+    const uint32_t only_founder_cts_required = (!allele_dosages) && (!raw_geno_cts) && (!variant_missing_hc_cts) && (!variant_missing_dosage_cts) && (!sample_missing_hc_cts);
     const uint32_t two_subsets_required = (founder_ct != sample_ct) && (!only_founder_cts_required) && (founder_allele_dosages || founder_raw_geno_cts);
     g_cip = cip;
     g_sample_include = only_founder_cts_required? founder_info : sample_include;
@@ -1741,7 +1923,7 @@ PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t*
     BigstackEndReset(bigstack_end_mark);  // free nosex_buf
 
     uint32_t unused_chr_code;
-    const uint32_t x_dosages_needed = (allele_dosages || founder_allele_dosages || variant_missing_dosage_cts) && XymtExists(cip, kChrOffsetX, &unused_chr_code) && (pgfip->gflags & kfPgenGlobalDosagePresent);
+    const uint32_t x_dosages_needed = (allele_dosages || founder_allele_dosages || variant_missing_dosage_cts || sample_missing_dosage_cts) && XymtExists(cip, kChrOffsetX, &unused_chr_code) && (pgfip->gflags & kfPgenGlobalDosagePresent);
     if (!x_dosages_needed) {
       // defensive
       g_dosage_presents = nullptr;
@@ -1750,20 +1932,60 @@ PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t*
 
     // todo: check when this saturates
     uint32_t calc_thread_ct = (max_thread_ct > 2)? (max_thread_ct - 1) : max_thread_ct;
+    const uint32_t sample_acc1_vec_ct = BitCtToVecCt(g_sample_ct);
+    const uintptr_t sample_acc1_alloc_cacheline_ct = DivUp(sample_acc1_vec_ct * (45 * k1LU * kBytesPerVec), kCacheline);
+    const uintptr_t raw_bufs_alloc_cacheline_ct = DivUp(3 * raw_sample_ctv * kBytesPerVec, kCacheline);
+    uintptr_t thread_alloc_cacheline_ct = 0;
+    g_sample_missing_hc_acc1 = nullptr;
+    g_sample_missing_dosage_acc1 = nullptr;
+    g_sample_hethap_acc1 = nullptr;
+    g_sample_raw_bufs = nullptr;
+    if (sample_missing_hc_cts) {
+      if (bigstack_alloc_wp(calc_thread_ct, &g_sample_missing_hc_acc1) ||
+          bigstack_alloc_wp(calc_thread_ct, &g_sample_hethap_acc1)) {
+        goto LoadAlleleAndGenoCounts_ret_NOMEM;
+      }
+      thread_alloc_cacheline_ct = 2 * sample_acc1_alloc_cacheline_ct;
+      if (sample_missing_dosage_cts) {
+        if (bigstack_alloc_wp(calc_thread_ct, &g_sample_missing_dosage_acc1)) {
+          goto LoadAlleleAndGenoCounts_ret_NOMEM;
+        }
+        thread_alloc_cacheline_ct += sample_acc1_alloc_cacheline_ct;
+      }
+      if (g_sample_ct != raw_sample_ct) {
+        if (bigstack_alloc_wp(calc_thread_ct, &g_sample_raw_bufs)) {
+          goto LoadAlleleAndGenoCounts_ret_NOMEM;
+        }
+        thread_alloc_cacheline_ct += raw_bufs_alloc_cacheline_ct;
+      }
+    }
     unsigned char* main_loadbufs[2];
     pthread_t* threads;
     uint32_t read_block_size;
     // todo: check if raw_sample_ct should be replaced with sample_ct here
-    if (PgenMtLoadInit(variant_include, raw_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, 0, 0, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, x_dosages_needed? (&g_dosage_presents) : nullptr, x_dosages_needed? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
+    if (PgenMtLoadInit(variant_include, raw_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, thread_alloc_cacheline_ct, 0, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, x_dosages_needed? (&g_dosage_presents) : nullptr, x_dosages_needed? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
       goto LoadAlleleAndGenoCounts_ret_NOMEM;
     }
+    if (sample_missing_hc_cts) {
+      const uintptr_t sample_acc1_alloc = sample_acc1_alloc_cacheline_ct * kCacheline;
+      for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+        g_sample_missing_hc_acc1[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(sample_acc1_alloc));
+        if (g_sample_missing_dosage_acc1) {
+          g_sample_missing_dosage_acc1[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(sample_acc1_alloc));
+        }
+        g_sample_hethap_acc1[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(sample_acc1_alloc));
+        if (g_sample_raw_bufs) {
+          g_sample_raw_bufs[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(raw_bufs_alloc_cacheline_ct * kCacheline));
+        }
+      }
+    }
 
     g_variant_include = variant_include;
     g_variant_allele_idxs = variant_allele_idxs;
     g_calc_thread_ct = calc_thread_ct;
     g_error_ret = kPglRetSuccess;
 
-    logputs("Calculating allele frequencies... ");
+    logputs(sample_missing_hc_cts? "Calculating allele frequencies and sample missingness rates... " : "Calculating allele frequencies... ");
     fputs("0%", stdout);
     fflush(stdout);
     uint32_t pct = 0;
@@ -1849,6 +2071,42 @@ PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t*
       // pointers
       pgfip->block_base = main_loadbufs[parity];
     }
+    if (sample_missing_hc_cts) {
+      const uint32_t sample_ctv = sample_acc1_vec_ct * kBitsPerVec;
+      const uintptr_t acc32_offset = sample_acc1_vec_ct * (13 * k1LU * kWordsPerVec);
+      uint32_t* scrambled_missing_hc_cts = R_CAST(uint32_t*, &(g_sample_missing_hc_acc1[0][acc32_offset]));
+      uint32_t* scrambled_missing_dosage_cts = nullptr;
+      if (g_sample_missing_dosage_acc1) {
+        scrambled_missing_dosage_cts = R_CAST(uint32_t*, &(g_sample_missing_dosage_acc1[0][acc32_offset]));
+      }
+      uint32_t* scrambled_hethap_cts = R_CAST(uint32_t*, &(g_sample_hethap_acc1[0][acc32_offset]));
+      for (uint32_t tidx = 1; tidx < calc_thread_ct; ++tidx) {
+        const uint32_t* thread_scrambled_missing_hc_cts = R_CAST(uint32_t*, &(g_sample_missing_hc_acc1[tidx][acc32_offset]));
+        for (uint32_t uii = 0; uii < sample_ctv; ++uii) {
+          scrambled_missing_hc_cts[uii] += thread_scrambled_missing_hc_cts[uii];
+        }
+        if (scrambled_missing_dosage_cts) {
+          const uint32_t* thread_scrambled_missing_dosage_cts = R_CAST(uint32_t*, &(g_sample_missing_dosage_acc1[tidx][acc32_offset]));
+          for (uint32_t uii = 0; uii < sample_ctv; ++uii) {
+            scrambled_missing_dosage_cts[uii] += thread_scrambled_missing_dosage_cts[uii];
+          }
+        }
+        const uint32_t* thread_scrambled_hethap_cts = R_CAST(uint32_t*, &(g_sample_hethap_acc1[tidx][acc32_offset]));
+        for (uint32_t uii = 0; uii < sample_ctv; ++uii) {
+          scrambled_hethap_cts[uii] += thread_scrambled_hethap_cts[uii];
+        }
+      }
+      uint32_t sample_uidx = 0;
+      for (uint32_t sample_idx = 0; sample_idx < g_sample_ct; ++sample_idx, ++sample_uidx) {
+        MovU32To1Bit(g_sample_include, &sample_uidx);
+        const uint32_t scrambled_idx = VcountScramble1(sample_idx);
+        sample_missing_hc_cts[sample_uidx] = scrambled_missing_hc_cts[scrambled_idx];
+        if (sample_missing_dosage_cts) {
+          sample_missing_dosage_cts[sample_uidx] = scrambled_missing_dosage_cts[scrambled_idx];
+        }
+        sample_hethap_cts[sample_uidx] = scrambled_hethap_cts[scrambled_idx];
+      }
+    }
     if (pct > 10) {
       putc_unlocked('\b', stdout);
     }
@@ -1872,6 +2130,545 @@ PglErr LoadAlleleAndGenoCounts(const uintptr_t* sample_include, const uintptr_t*
   return reterr;
 }
 
+// --freq-cache companion file, named [.pgen filename].afc.  Layout:
+//   AfcHeader
+//   uint32_t chr_file_order[chr_ct], chr_fo_vidx_start[chr_ct + 1]
+//   haploid_mask (kChrMaskWords words)
+//   then section_ct sections, each consisting of
+//     sample_include, sex_male, sex_nm bitarrays (raw_sample_ctl words each)
+//     variant_include bitarray (raw_variant_ctl words)
+//     uint64_t allele_dosages[2 * raw_variant_ct]
+//     uint32_t geno_cts[3 * raw_variant_ct]
+//     uint32_t x_male_geno_cts[3 * x_len], x_nosex_geno_cts[3 * x_len]
+// Each section holds LoadAlleleAndGenoCounts() results for one sample subset
+// (all remaining samples, or remaining founders).  All of these counts are
+// sums of per-sample contributions, so a section also covers every subset of
+// its samples: the removed samples' counts are computed and subtracted.  When
+// new sections are added, the largest existing sample set is kept.
+typedef struct AfcHeaderStruct {
+  unsigned char magic[8];
+  uint64_t pgen_fsize;
+  int64_t pgen_mtime;
+  uint32_t raw_sample_ct;
+  uint32_t raw_variant_ct;
+  uint32_t chr_ct;
+  uint32_t x_start;
+  uint32_t x_len;
+  uint32_t section_ct;
+  uint32_t word_byte_ct;
+  uint32_t reserved;
+} AfcHeader;
+
+static_assert(sizeof(AfcHeader) == 56, "AfcHeader must not have padding.");
+static const unsigned char kAfcMagic[8] = {'p', 'l', 'a', 'f', 'c', 1, 0, 0};
+CONSTU31(kAfcMaxSectionCt, 2);
+
+typedef struct AfcTargetStruct {
+  // sex_male and sex_nm are masked by sample_include
+  const uintptr_t* sample_include;
+  const uintptr_t* variant_include;
+  uintptr_t* sex_male;
+  uintptr_t* sex_nm;
+  uint32_t sample_ct;
+  uint32_t nosex_ct;
+  uint64_t* allele_dosages;
+  uint32_t* geno_cts;
+  uint32_t* x_male_geno_cts;
+  uint32_t* x_nosex_geno_cts;
+} AfcTarget;
+
+// Failure is not fatal; the counts are just recomputed next time.
+static void WriteAfc(const char* afcname, const ChrInfo* cip, const AfcTarget* const* sections, AfcHeader* afchp) {
+  FILE* outfile = nullptr;
+  char tmpname[kPglFnamesize];
+  strcpy(strcpya(tmpname, afcname), ".tmp");
+  {
+    const uintptr_t raw_sample_ctl = BitCtToWordCt(afchp->raw_sample_ct);
+    const uintptr_t raw_variant_ct = afchp->raw_variant_ct;
+    const uintptr_t x_len = afchp->x_len;
+    const uint32_t chr_ct = afchp->chr_ct;
+    outfile = fopen(tmpname, FOPEN_WB);
+    if ((!outfile) ||
+        fwrite_checked(afchp, sizeof(AfcHeader), outfile) ||
+        fwrite_checked(cip->chr_file_order, chr_ct * sizeof(int32_t), outfile) ||
+        fwrite_checked(cip->chr_fo_vidx_start, (chr_ct + 1) * sizeof(int32_t), outfile) ||
+        fwrite_checked(cip->haploid_mask, kChrMaskWords * sizeof(intptr_t), outfile)) {
+      goto WriteAfc_ret_FAIL;
+    }
+    for (uint32_t section_idx = 0; section_idx != afchp->section_ct; ++section_idx) {
+      const AfcTarget* cur_target = sections[section_idx];
+      if (fwrite_checked(cur_target->sample_include, raw_sample_ctl * sizeof(intptr_t), outfile) ||
+          fwrite_checked(cur_target->sex_male, raw_sample_ctl * sizeof(intptr_t), outfile) ||
+          fwrite_checked(cur_target->sex_nm, raw_sample_ctl * sizeof(intptr_t), outfile) ||
+          fwrite_checked(cur_target->variant_include, BitCtToWordCt(raw_variant_ct) * sizeof(intptr_t), outfile) ||
+          fwrite_checked(cur_target->allele_dosages, 2 * raw_variant_ct * sizeof(int64_t), outfile) ||
+          fwrite_checked(cur_target->geno_cts, 3 * raw_variant_ct * sizeof(int32_t), outfile) ||
+          fwrite_checked(cur_target->x_male_geno_cts, 3 * x_len * sizeof(int32_t), outfile) ||
+          fwrite_checked(cur_target->x_nosex_geno_cts, 3 * x_len * sizeof(int32_t), outfile)) {
+        goto WriteAfc_ret_FAIL;
+      }
+    }
+    if (fclose_null(&outfile)) {
+      goto WriteAfc_ret_FAIL;
+    }
+    remove(afcname);
+    if (rename(tmpname, afcname)) {
+      goto WriteAfc_ret_FAIL;
+    }
+    logprintfww("--freq-cache: %s written.\n", afcname);
+  }
+  while (0) {
+  WriteAfc_ret_FAIL:
+    fclose_cond(outfile);
+    remove(tmpname);
+    logerrprintfww("Warning: Failed to write --freq-cache file %s.\n", afcname);
+    break;
+  }
+}
+
+static inline uint32_t AfcBitarrIsSubset(const uintptr_t* subset, const uintptr_t* superset, uint32_t word_ct) {
+  for (uint32_t widx = 0; widx != word_ct; ++widx) {
+    if (subset[widx] & (~superset[widx])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static inline uint32_t AfcMaskedBitarrsAreEqual(const uintptr_t* bitarr1, const uintptr_t* bitarr2, const uintptr_t* mask, uint32_t word_ct) {
+  for (uint32_t widx = 0; widx != word_ct; ++widx) {
+    if ((bitarr1[widx] ^ bitarr2[widx]) & mask[widx]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+PglErr LoadAlleleAndGenoCountsCached(const char* pgenname, const uintptr_t* sample_include, const uintptr_t* founder_info, const uintptr_t* sex_nm, const uintptr_t* sex_male, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t founder_ct, uint32_t male_ct, uint32_t nosex_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t first_hap_uidx, uint32_t x_start, uint32_t x_len, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, uint64_t* allele_dosages, uint64_t* founder_allele_dosages, uint32_t* variant_missing_hc_cts, uint32_t* variant_missing_dosage_cts, uint32_t* variant_hethap_cts, uint32_t* raw_geno_cts, uint32_t* founder_raw_geno_cts, uint32_t* x_male_geno_cts, uint32_t* founder_x_male_geno_cts, uint32_t* x_nosex_geno_cts, uint32_t* founder_x_nosex_geno_cts, double* mach_r2_vals, uint32_t* sample_missing_hc_cts, uint32_t* sample_missing_dosage_cts, uint32_t* sample_hethap_cts) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  FILE* afcfile = nullptr;
+  char afcname[kPglFnamesize];
+  PglErr reterr = kPglRetSuccess;
+  {
+    // Target 0 covers all samples, target 1 covers founders.  The founder
+    // target is folded into target 0 when the two sample sets coincide.
+    uint32_t all_needed = allele_dosages || raw_geno_cts || x_male_geno_cts || x_nosex_geno_cts;
+    const uint32_t founders_needed = founder_allele_dosages || founder_raw_geno_cts || founder_x_male_geno_cts || founder_x_nosex_geno_cts;
+    const uint32_t founders_separate = founders_needed && (founder_ct != sample_ct);
+    if (founders_needed && (!founders_separate)) {
+      all_needed = 1;
+    }
+    const uint32_t pgenname_slen = strlen(pgenname);
+    struct stat pgen_stat;
+    if ((!sample_ct) || (founders_separate && (!founder_ct)) || (!(all_needed || founders_needed)) || variant_allele_idxs || (pgenname_slen + 9 > kPglFnamesize) || stat(pgenname, &pgen_stat)) {
+      reterr = LoadAlleleAndGenoCounts(sample_include, founder_info, sex_nm, sex_male, variant_include, cip, variant_allele_idxs, raw_sample_ct, sample_ct, founder_ct, male_ct, nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, max_thread_ct, pgr_alloc_cacheline_ct, pgfip, allele_dosages, founder_allele_dosages, variant_missing_hc_cts, variant_missing_dosage_cts, variant_hethap_cts, raw_geno_cts, founder_raw_geno_cts, x_male_geno_cts, founder_x_male_geno_cts, x_nosex_geno_cts, founder_x_nosex_geno_cts, mach_r2_vals, sample_missing_hc_cts, sample_missing_dosage_cts, sample_hethap_cts);
+      goto LoadAlleleAndGenoCountsCached_ret_1;
+    }
+    strcpy(memcpya(afcname, pgenname, pgenname_slen), ".afc");
+    const uint32_t raw_sample_ctl = BitCtToWordCt(raw_sample_ct);
+    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
+    const uint32_t chr_ct = cip->chr_ct;
+
+    AfcTarget targets[kAfcMaxSectionCt];
+    uint32_t target_ct = 0;
+    if (all_needed) {
+      AfcTarget* cur_target = &(targets[target_ct++]);
+      cur_target->sample_include = sample_include;
+      cur_target->variant_include = variant_include;
+      cur_target->sample_ct = sample_ct;
+      cur_target->allele_dosages = allele_dosages;
+      cur_target->geno_cts = raw_geno_cts;
+      cur_target->x_male_geno_cts = x_male_geno_cts;
+      cur_target->x_nosex_geno_cts = x_nosex_geno_cts;
+      if (!founders_separate) {
+        if (!cur_target->allele_dosages) {
+          cur_target->allele_dosages = founder_allele_dosages;
+        }
+        if (!cur_target->geno_cts) {
+          cur_target->geno_cts = founder_raw_geno_cts;
+        }
+        if (!cur_target->x_male_geno_cts) {
+          cur_target->x_male_geno_cts = founder_x_male_geno_cts;
+        }
+        if (!cur_target->x_nosex_geno_cts) {
+          cur_target->x_nosex_geno_cts = founder_x_nosex_geno_cts;
+        }
+      }
+    }
+    if (founders_separate) {
+      AfcTarget* cur_target = &(targets[target_ct++]);
+      cur_target->sample_include = founder_info;
+      cur_target->variant_include = variant_include;
+      cur_target->sample_ct = founder_ct;
+      cur_target->allele_dosages = founder_allele_dosages;
+      cur_target->geno_cts = founder_raw_geno_cts;
+      cur_target->x_male_geno_cts = founder_x_male_geno_cts;
+      cur_target->x_nosex_geno_cts = founder_x_nosex_geno_cts;
+    }
+    // the cache always stores all four arrays
+    for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+      AfcTarget* cur_target = &(targets[target_idx]);
+      if (bigstack_alloc_w(raw_sample_ctl, &(cur_target->sex_male)) ||
+          bigstack_alloc_w(raw_sample_ctl, &(cur_target->sex_nm)) ||
+          ((!cur_target->allele_dosages) && bigstack_alloc_u64((2 * k1LU) * raw_variant_ct, &(cur_target->allele_dosages))) ||
+          ((!cur_target->geno_cts) && bigstack_alloc_u32((3 * k1LU) * raw_variant_ct, &(cur_target->geno_cts)))) {
+        goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+      }
+      if (x_len) {
+        if (((!cur_target->x_male_geno_cts) && bigstack_alloc_u32((3 * k1LU) * x_len, &(cur_target->x_male_geno_cts))) ||
+            ((!cur_target->x_nosex_geno_cts) && bigstack_alloc_u32((3 * k1LU) * x_len, &(cur_target->x_nosex_geno_cts)))) {
+          goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+        }
+      }
+      const uintptr_t* cur_sample_include = cur_target->sample_include;
+      for (uint32_t widx = 0; widx != raw_sample_ctl; ++widx) {
+        cur_target->sex_male[widx] = sex_male[widx] & cur_sample_include[widx];
+        cur_target->sex_nm[widx] = sex_nm[widx] & cur_sample_include[widx];
+      }
+      cur_target->nosex_ct = cur_target->sample_ct - PopcountWords(cur_target->sex_nm, raw_sample_ctl);
+    }
+
+    // Lookup is only attempted when everything requested is cacheable.
+    uint32_t target_hit_sections[kAfcMaxSectionCt];
+    uint32_t target_removed_cts[kAfcMaxSectionCt];
+    uint64_t section_offsets[kAfcMaxSectionCt];
+    uintptr_t* section_sample_includes[kAfcMaxSectionCt];
+    uintptr_t* section_sex_males[kAfcMaxSectionCt];
+    uintptr_t* section_sex_nms[kAfcMaxSectionCt];
+    uintptr_t* section_variant_includes[kAfcMaxSectionCt];
+    uint32_t section_sample_cts[kAfcMaxSectionCt];
+    // only set once the whole file has been validated
+    uint32_t old_section_ct = 0;
+    for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+      target_hit_sections[target_idx] = UINT32_MAX;
+      target_removed_cts[target_idx] = 0;
+    }
+    const uint32_t cacheable_only = (!variant_missing_hc_cts) && (!variant_missing_dosage_cts) && (!variant_hethap_cts) && (!mach_r2_vals) && (!sample_missing_hc_cts);
+    if (cacheable_only) {
+      afcfile = fopen(afcname, FOPEN_RB);
+    }
+    if (afcfile) {
+      AfcHeader afch;
+      if ((!fread_unlocked(&afch, sizeof(AfcHeader), 1, afcfile)) || memcmp(afch.magic, kAfcMagic, 8) || (afch.word_byte_ct != kBytesPerWord) || (afch.section_ct > kAfcMaxSectionCt)) {
+        logerrprintfww("Warning: %s is not a valid --freq-cache file; rebuilding it.\n", afcname);
+        goto LoadAlleleAndGenoCountsCached_compute;
+      }
+      if ((afch.pgen_fsize != S_CAST(uint64_t, pgen_stat.st_size)) || (afch.pgen_mtime != S_CAST(int64_t, pgen_stat.st_mtime)) || (afch.raw_sample_ct != raw_sample_ct) || (afch.raw_variant_ct != raw_variant_ct) || (afch.chr_ct != chr_ct) || (afch.x_start != x_start) || (afch.x_len != x_len)) {
+        logprintfww("--freq-cache: %s is out of date; rebuilding it.\n", afcname);
+        goto LoadAlleleAndGenoCountsCached_compute;
+      }
+      uint32_t* chr_file_order;
+      uint32_t* chr_fo_vidx_start;
+      uintptr_t* haploid_mask;
+      if (bigstack_alloc_u32(chr_ct, &chr_file_order) ||
+          bigstack_alloc_u32(chr_ct + 1, &chr_fo_vidx_start) ||
+          bigstack_alloc_w(kChrMaskWords, &haploid_mask)) {
+        goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+      }
+      if (fread_checked(chr_file_order, chr_ct * sizeof(int32_t), afcfile) ||
+          fread_checked(chr_fo_vidx_start, (chr_ct + 1) * sizeof(int32_t), afcfile) ||
+          fread_checked(haploid_mask, kChrMaskWords * sizeof(intptr_t), afcfile)) {
+        goto LoadAlleleAndGenoCountsCached_ret_READ_FAIL;
+      }
+      if (memcmp(chr_file_order, cip->chr_file_order, chr_ct * sizeof(int32_t)) || memcmp(chr_fo_vidx_start, cip->chr_fo_vidx_start, (chr_ct + 1) * sizeof(int32_t)) || memcmp(haploid_mask, cip->haploid_mask, kChrMaskWords * sizeof(intptr_t))) {
+        logprintfww("--freq-cache: %s was built with a different chromosome set; rebuilding it.\n", afcname);
+        goto LoadAlleleAndGenoCountsCached_compute;
+      }
+      const uint64_t section_data_size = (2 * k1LU) * raw_variant_ct * sizeof(int64_t) + (3 * k1LU) * (raw_variant_ct + 2 * x_len) * sizeof(int32_t);
+      for (uint32_t section_idx = 0; section_idx != afch.section_ct; ++section_idx) {
+        if (bigstack_alloc_w(raw_sample_ctl, &(section_sample_includes[section_idx])) ||
+            bigstack_alloc_w(raw_sample_ctl, &(section_sex_males[section_idx])) ||
+            bigstack_alloc_w(raw_sample_ctl, &(section_sex_nms[section_idx])) ||
+            bigstack_alloc_w(raw_variant_ctl, &(section_variant_includes[section_idx]))) {
+          goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+        }
+        uintptr_t* section_sample_include = section_sample_includes[section_idx];
+        uintptr_t* section_sex_male = section_sex_males[section_idx];
+        uintptr_t* section_sex_nm = section_sex_nms[section_idx];
+        uintptr_t* section_variant_include = section_variant_includes[section_idx];
+        if (fread_checked(section_sample_include, raw_sample_ctl * sizeof(intptr_t), afcfile) ||
+            fread_checked(section_sex_male, raw_sample_ctl * sizeof(intptr_t), afcfile) ||
+            fread_checked(section_sex_nm, raw_sample_ctl * sizeof(intptr_t), afcfile) ||
+            fread_checked(section_variant_include, raw_variant_ctl * sizeof(intptr_t), afcfile)) {
+          goto LoadAlleleAndGenoCountsCached_ret_READ_FAIL;
+        }
+        section_offsets[section_idx] = ftello(afcfile);
+        if (fseeko(afcfile, section_data_size, SEEK_CUR)) {
+          goto LoadAlleleAndGenoCountsCached_ret_READ_FAIL;
+        }
+        const uint32_t section_sample_ct = PopcountWords(section_sample_include, raw_sample_ctl);
+        section_sample_cts[section_idx] = section_sample_ct;
+        if (!AfcBitarrIsSubset(variant_include, section_variant_include, raw_variant_ctl)) {
+          continue;
+        }
+        for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+          const AfcTarget* cur_target = &(targets[target_idx]);
+          // Removing more than half of the samples is no cheaper than a fresh
+          // scan.  Sex must agree on the retained samples.
+          const uint32_t removed_ct = section_sample_ct - cur_target->sample_ct;
+          if ((section_sample_ct < cur_target->sample_ct) || (removed_ct > cur_target->sample_ct) || (!AfcBitarrIsSubset(cur_target->sample_include, section_sample_include, raw_sample_ctl)) || (!AfcMaskedBitarrsAreEqual(section_sex_male, cur_target->sex_male, cur_target->sample_include, raw_sample_ctl)) || (!AfcMaskedBitarrsAreEqual(section_sex_nm, cur_target->sex_nm, cur_target->sample_include, raw_sample_ctl))) {
+            continue;
+          }
+          if ((target_hit_sections[target_idx] == UINT32_MAX) || (removed_ct < target_removed_cts[target_idx])) {
+            target_hit_sections[target_idx] = section_idx;
+            target_removed_cts[target_idx] = removed_ct;
+          }
+        }
+      }
+      old_section_ct = afch.section_ct;
+    }
+  LoadAlleleAndGenoCountsCached_compute:
+    {
+      uint32_t all_hit = 1;
+      for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+        if (target_hit_sections[target_idx] == UINT32_MAX) {
+          all_hit = 0;
+          break;
+        }
+      }
+      if (!all_hit) {
+        // One pass for every target not served by the cache, plus whatever
+        // uncacheable counts were requested.  LoadAlleleAndGenoCounts()
+        // leaves the nosex arrays alone when there are no nosex samples.
+        AfcTarget* miss_targets[kAfcMaxSectionCt];
+        uint32_t* miss_x_nosex_geno_cts[kAfcMaxSectionCt];
+        miss_targets[0] = (all_needed && (target_hit_sections[0] == UINT32_MAX))? (&(targets[0])) : nullptr;
+        miss_targets[1] = (founders_separate && (target_hit_sections[target_ct - 1] == UINT32_MAX))? (&(targets[target_ct - 1])) : nullptr;
+        for (uint32_t uii = 0; uii != 2; ++uii) {
+          AfcTarget* cur_target = miss_targets[uii];
+          miss_x_nosex_geno_cts[uii] = nullptr;
+          if (cur_target) {
+            if (cur_target->nosex_ct) {
+              miss_x_nosex_geno_cts[uii] = cur_target->x_nosex_geno_cts;
+            } else if (x_len) {
+              ZeroU32Arr((3 * k1LU) * x_len, cur_target->x_nosex_geno_cts);
+            }
+          }
+        }
+        const AfcTarget* all_target = miss_targets[0];
+        const AfcTarget* founders_target = miss_targets[1];
+        reterr = LoadAlleleAndGenoCounts(sample_include, founder_info, sex_nm, sex_male, variant_include, cip, variant_allele_idxs, raw_sample_ct, sample_ct, founder_ct, male_ct, nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, max_thread_ct, pgr_alloc_cacheline_ct, pgfip, all_target? all_target->allele_dosages : nullptr, founders_target? founders_target->allele_dosages : nullptr, variant_missing_hc_cts, variant_missing_dosage_cts, variant_hethap_cts, all_target? all_target->geno_cts : nullptr, founders_target? founders_target->geno_cts : nullptr, all_target? all_target->x_male_geno_cts : nullptr, founders_target? founders_target->x_male_geno_cts : nullptr, miss_x_nosex_geno_cts[0], miss_x_nosex_geno_cts[1], mach_r2_vals, sample_missing_hc_cts, sample_missing_dosage_cts, sample_hethap_cts);
+        if (reterr) {
+          goto LoadAlleleAndGenoCountsCached_ret_1;
+        }
+      }
+      for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+        const uint32_t section_idx = target_hit_sections[target_idx];
+        if (section_idx == UINT32_MAX) {
+          continue;
+        }
+        AfcTarget* cur_target = &(targets[target_idx]);
+        if (fseeko(afcfile, section_offsets[section_idx], SEEK_SET) ||
+            fread_checked(cur_target->allele_dosages, (2 * k1LU) * raw_variant_ct * sizeof(int64_t), afcfile) ||
+            fread_checked(cur_target->geno_cts, (3 * k1LU) * raw_variant_ct * sizeof(int32_t), afcfile) ||
+            fread_checked(cur_target->x_male_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t), afcfile) ||
+            fread_checked(cur_target->x_nosex_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t), afcfile)) {
+          goto LoadAlleleAndGenoCountsCached_ret_READ_FAIL;
+        }
+        const uint32_t removed_ct = target_removed_cts[target_idx];
+        if (!removed_ct) {
+          logprintfww("--freq-cache: Allele/genotype counts for %u sample%s loaded from %s.\n", cur_target->sample_ct, (cur_target->sample_ct == 1)? "" : "s", afcname);
+          continue;
+        }
+        unsigned char* bigstack_mark2 = g_bigstack_base;
+        uintptr_t* removed_sample_include;
+        uintptr_t* removed_sex_male;
+        uintptr_t* removed_sex_nm;
+        uint64_t* removed_allele_dosages;
+        uint32_t* removed_geno_cts;
+        if (bigstack_alloc_w(raw_sample_ctl, &removed_sample_include) ||
+            bigstack_alloc_w(raw_sample_ctl, &removed_sex_male) ||
+            bigstack_alloc_w(raw_sample_ctl, &removed_sex_nm) ||
+            bigstack_alloc_u64((2 * k1LU) * raw_variant_ct, &removed_allele_dosages) ||
+            bigstack_alloc_u32((3 * k1LU) * raw_variant_ct, &removed_geno_cts)) {
+          goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+        }
+        const uintptr_t* section_sample_include = section_sample_includes[section_idx];
+        const uintptr_t* section_sex_male = section_sex_males[section_idx];
+        const uintptr_t* section_sex_nm = section_sex_nms[section_idx];
+        for (uint32_t widx = 0; widx != raw_sample_ctl; ++widx) {
+          const uintptr_t removed_word = section_sample_include[widx] & (~cur_target->sample_include[widx]);
+          removed_sample_include[widx] = removed_word;
+          removed_sex_male[widx] = section_sex_male[widx] & removed_word;
+          removed_sex_nm[widx] = section_sex_nm[widx] & removed_word;
+        }
+        const uint32_t removed_male_ct = PopcountWords(removed_sex_male, raw_sample_ctl);
+        const uint32_t removed_nosex_ct = removed_ct - PopcountWords(removed_sex_nm, raw_sample_ctl);
+        uint32_t* removed_x_male_geno_cts = nullptr;
+        uint32_t* removed_x_nosex_geno_cts = nullptr;
+        if (x_len) {
+          if (bigstack_alloc_u32((3 * k1LU) * x_len, &removed_x_male_geno_cts) ||
+              (removed_nosex_ct && bigstack_alloc_u32((3 * k1LU) * x_len, &removed_x_nosex_geno_cts))) {
+            goto LoadAlleleAndGenoCountsCached_ret_NOMEM;
+          }
+        }
+        logprintfww("--freq-cache: Subtracting %u removed sample%s from the counts in %s.\n", removed_ct, (removed_ct == 1)? "" : "s", afcname);
+        reterr = LoadAlleleAndGenoCounts(removed_sample_include, removed_sample_include, removed_sex_nm, removed_sex_male, variant_include, cip, nullptr, raw_sample_ct, removed_ct, removed_ct, removed_male_ct, removed_nosex_ct, raw_variant_ct, variant_ct, first_hap_uidx, max_thread_ct, pgr_alloc_cacheline_ct, pgfip, removed_allele_dosages, nullptr, nullptr, nullptr, nullptr, removed_geno_cts, nullptr, removed_x_male_geno_cts, nullptr, removed_x_nosex_geno_cts, nullptr, nullptr, nullptr, nullptr, nullptr);
+        if (reterr) {
+          goto LoadAlleleAndGenoCountsCached_ret_1;
+        }
+        uint64_t* cur_allele_dosages = cur_target->allele_dosages;
+        uint32_t* cur_geno_cts = cur_target->geno_cts;
+        uint32_t* cur_x_male_geno_cts = cur_target->x_male_geno_cts;
+        uint32_t* cur_x_nosex_geno_cts = cur_target->x_nosex_geno_cts;
+        uint32_t variant_uidx = 0;
+        for (uint32_t variant_idx = 0; variant_idx != variant_ct; ++variant_idx, ++variant_uidx) {
+          MovU32To1Bit(variant_include, &variant_uidx);
+          cur_allele_dosages[2 * variant_uidx] -= removed_allele_dosages[2 * variant_uidx];
+          cur_allele_dosages[2 * variant_uidx + 1] -= removed_allele_dosages[2 * variant_uidx + 1];
+          for (uint32_t uii = 0; uii != 3; ++uii) {
+            cur_geno_cts[3 * variant_uidx + uii] -= removed_geno_cts[3 * variant_uidx + uii];
+          }
+          const uint32_t x_offset = variant_uidx - x_start;
+          if (x_offset < x_len) {
+            for (uint32_t uii = 0; uii != 3; ++uii) {
+              cur_x_male_geno_cts[3 * x_offset + uii] -= removed_x_male_geno_cts[3 * x_offset + uii];
+            }
+            if (removed_nosex_ct) {
+              for (uint32_t uii = 0; uii != 3; ++uii) {
+                cur_x_nosex_geno_cts[3 * x_offset + uii] -= removed_x_nosex_geno_cts[3 * x_offset + uii];
+              }
+            }
+          }
+        }
+        BigstackReset(bigstack_mark2);
+      }
+      if (founders_needed && (!founders_separate)) {
+        // mirror into any separately-allocated founder arrays
+        const AfcTarget* all_target = &(targets[0]);
+        if (founder_allele_dosages && (founder_allele_dosages != all_target->allele_dosages)) {
+          memcpy(founder_allele_dosages, all_target->allele_dosages, (2 * k1LU) * raw_variant_ct * sizeof(int64_t));
+        }
+        if (founder_raw_geno_cts && (founder_raw_geno_cts != all_target->geno_cts)) {
+          memcpy(founder_raw_geno_cts, all_target->geno_cts, (3 * k1LU) * raw_variant_ct * sizeof(int32_t));
+        }
+        if (founder_x_male_geno_cts && (founder_x_male_geno_cts != all_target->x_male_geno_cts)) {
+          memcpy(founder_x_male_geno_cts, all_target->x_male_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t));
+        }
+        if (founder_x_nosex_geno_cts && (founder_x_nosex_geno_cts != all_target->x_nosex_geno_cts)) {
+          memcpy(founder_x_nosex_geno_cts, all_target->x_nosex_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t));
+        }
+      }
+      if (!all_hit) {
+        // Only sections computed from scratch are new.  Existing sections are
+        // carried over while there's room, starting with the largest sample
+        // set, so that a superset isn't replaced by one of its subsets.
+        const AfcTarget* new_sections[kAfcMaxSectionCt];
+        uint32_t new_section_ct = 0;
+        for (uint32_t target_idx = 0; target_idx != target_ct; ++target_idx) {
+          if (target_hit_sections[target_idx] == UINT32_MAX) {
+            new_sections[new_section_ct++] = &(targets[target_idx]);
+          }
+        }
+        uint32_t old_keep_order[kAfcMaxSectionCt];
+        uint32_t old_keep_ct = 0;
+        for (uint32_t section_idx = 0; section_idx != old_section_ct; ++section_idx) {
+          uint32_t superseded = 0;
+          for (uint32_t uii = 0; uii != new_section_ct; ++uii) {
+            if (!memcmp(section_sample_includes[section_idx], new_sections[uii]->sample_include, raw_sample_ctl * sizeof(intptr_t))) {
+              superseded = 1;
+              break;
+            }
+          }
+          if (superseded) {
+            continue;
+          }
+          // insertion sort, decreasing sample count
+          uint32_t insert_pos = old_keep_ct;
+          for (; insert_pos; --insert_pos) {
+            if (section_sample_cts[old_keep_order[insert_pos - 1]] >= section_sample_cts[section_idx]) {
+              break;
+            }
+            old_keep_order[insert_pos] = old_keep_order[insert_pos - 1];
+          }
+          old_keep_order[insert_pos] = section_idx;
+          ++old_keep_ct;
+        }
+        uint32_t largest_new_sample_ct = 0;
+        for (uint32_t uii = 0; uii != new_section_ct; ++uii) {
+          if (new_sections[uii]->sample_ct > largest_new_sample_ct) {
+            largest_new_sample_ct = new_sections[uii]->sample_ct;
+          }
+        }
+        const AfcTarget* sections[kAfcMaxSectionCt];
+        uint32_t section_ct = 0;
+        uint32_t old_keep_idx = 0;
+        if (old_keep_ct && (section_sample_cts[old_keep_order[0]] > largest_new_sample_ct)) {
+          // reserve a slot for the largest sample set
+          ++old_keep_idx;
+          ++section_ct;
+        }
+        for (uint32_t uii = 0; (uii != new_section_ct) && (section_ct != kAfcMaxSectionCt); ++uii) {
+          sections[section_ct++] = new_sections[uii];
+        }
+        const uint32_t old_write_ct = old_keep_idx + MINV(old_keep_ct - old_keep_idx, kAfcMaxSectionCt - section_ct);
+        section_ct += old_write_ct - old_keep_idx;
+        // load carried-over sections; if that isn't possible, leave the file
+        // alone
+        AfcTarget old_targets[kAfcMaxSectionCt];
+        uint32_t keep_old_ok = 1;
+        for (uint32_t uii = 0; uii != old_write_ct; ++uii) {
+          const uint32_t section_idx = old_keep_order[uii];
+          AfcTarget* old_target = &(old_targets[uii]);
+          old_target->sample_include = section_sample_includes[section_idx];
+          old_target->variant_include = section_variant_includes[section_idx];
+          old_target->sex_male = section_sex_males[section_idx];
+          old_target->sex_nm = section_sex_nms[section_idx];
+          old_target->x_male_geno_cts = nullptr;
+          old_target->x_nosex_geno_cts = nullptr;
+          if (bigstack_alloc_u64((2 * k1LU) * raw_variant_ct, &(old_target->allele_dosages)) ||
+              bigstack_alloc_u32((3 * k1LU) * raw_variant_ct, &(old_target->geno_cts)) ||
+              (x_len && (bigstack_alloc_u32((3 * k1LU) * x_len, &(old_target->x_male_geno_cts)) ||
+                         bigstack_alloc_u32((3 * k1LU) * x_len, &(old_target->x_nosex_geno_cts)))) ||
+              fseeko(afcfile, section_offsets[section_idx], SEEK_SET) ||
+              fread_checked(old_target->allele_dosages, (2 * k1LU) * raw_variant_ct * sizeof(int64_t), afcfile) ||
+              fread_checked(old_target->geno_cts, (3 * k1LU) * raw_variant_ct * sizeof(int32_t), afcfile) ||
+              fread_checked(old_target->x_male_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t), afcfile) ||
+              fread_checked(old_target->x_nosex_geno_cts, (3 * k1LU) * x_len * sizeof(int32_t), afcfile)) {
+            keep_old_ok = 0;
+            break;
+          }
+        }
+        if (keep_old_ok) {
+          if (old_keep_idx) {
+            sections[0] = &(old_targets[0]);
+          }
+          for (uint32_t uii = old_keep_idx; uii != old_write_ct; ++uii) {
+            sections[section_ct - old_write_ct + uii] = &(old_targets[uii]);
+          }
+          fclose_cond(afcfile);
+          afcfile = nullptr;
+          AfcHeader afch;
+          memcpy(afch.magic, kAfcMagic, 8);
+          afch.pgen_fsize = pgen_stat.st_size;
+          afch.pgen_mtime = pgen_stat.st_mtime;
+          afch.raw_sample_ct = raw_sample_ct;
+          afch.raw_variant_ct = raw_variant_ct;
+          afch.chr_ct = chr_ct;
+          afch.x_start = x_start;
+          afch.x_len = x_len;
+          afch.section_ct = section_ct;
+          afch.word_byte_ct = kBytesPerWord;
+          afch.reserved = 0;
+          WriteAfc(afcname, cip, sections, &afch);
+        }
+      }
+    }
+  }
+  while (0) {
+  LoadAlleleAndGenoCountsCached_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  LoadAlleleAndGenoCountsCached_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  }
+ LoadAlleleAndGenoCountsCached_ret_1:
+  fclose_cond(afcfile);
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
 void ApplyHardCallThresh(const uintptr_t* dosage_present, const Dosage* dosage_main, uint32_t dosage_ct, uint32_t hard_call_halfdist, uintptr_t* genovec) {
   uint32_t sample_uidx = 0;
   for (uint32_t dosage_idx = 0; dosage_idx < dosage_ct; ++dosage_idx, ++sample_uidx) {
@@ -2587,6 +3384,519 @@ PgenGlobalFlags GflagsVfilter(const uintptr_t* variant_include, const unsigned c
   return read_phase_dosage_gflags;
 }
 
+// Raw record passthrough is possible when --make-pgen doesn't touch the
+// sample set, allele order, or any genotype/phase/dosage values.
+static uint32_t PgenPassthroughOk(const uintptr_t* variant_include, const uintptr_t* variant_allele_idxs, const AltAlleleCt* refalt1_select, const uint32_t* new_sample_idx_to_old, const PgenFileInfo* pgfip, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t variant_ct, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, MakePlink2Flags make_plink2_flags) {
+  if (new_sample_idx_to_old || (sample_ct != raw_sample_ct) || variant_allele_idxs || g_plink2_write_flags || (pgfip->const_vrtype != UINT32_MAX)) {
+    return 0;
+  }
+  if (make_plink2_flags & (kfMakePgenErasePhase | kfMakePgenEraseDosage)) {
+    return 0;
+  }
+  if ((pgfip->gflags & kfPgenGlobalDosagePresent) && ((hard_call_thresh != UINT32_MAX) || dosage_erase_thresh)) {
+    return 0;
+  }
+  if (refalt1_select) {
+    uint32_t variant_uidx = 0;
+    for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
+      MovU32To1Bit(variant_include, &variant_uidx);
+      if (refalt1_select[2 * variant_uidx] == 1) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Appends input record read_vidx to *spgwp as output record write_vidx.  The
+// raw record is copied unless it's LD-compressed against anything other than
+// the last non-LD-compressed record copied to the current output variant
+// block; in that case, it's decoded and recompressed.
+// ldbase_key_offset is added to input record indexes before they're compared
+// against *last_nonld_key_ptr, so that records from several readers can be
+// interleaved.
+static PglErr CopyOrRecompressVrec(uint32_t read_vidx, uint32_t write_vidx, uint32_t ldbase_key_offset, uint32_t sample_ct, uint32_t max_vrec_len, PgenReader* pgrp, uint32_t* last_nonld_key_ptr, uintptr_t* genovec, uintptr_t* phasepresent, uintptr_t* phaseinfo, uintptr_t* dosage_present, Dosage* dosage_main, uintptr_t* dphase_present, SDosage* dphase_delta, STPgenWriter* spgwp) {
+  const unsigned char* vrtypes = pgrp->fi.vrtypes;
+  const uint32_t vrtype = vrtypes[read_vidx];
+  const uint32_t is_ld = VrtypeLdCompressed(vrtype);
+  if ((!is_ld) || ((write_vidx % kPglVblockSize) && (GetLdbaseVidx(vrtypes, read_vidx) + ldbase_key_offset == *last_nonld_key_ptr))) {
+    const unsigned char* vrec;
+    uint32_t vrec_len;
+    if (PgrGetRawVrec(read_vidx, pgrp, &vrec, &vrec_len)) {
+      return kPglRetReadFail;
+    }
+    // shouldn't fail with a .pgen written by plink2, but play it safe
+    if (vrec_len <= max_vrec_len) {
+      if (SpgwAppendRawVrec(vrec, vrec_len, vrtype, spgwp)) {
+        return kPglRetWriteFail;
+      }
+      if (!is_ld) {
+        *last_nonld_key_ptr = read_vidx + ldbase_key_offset;
+      }
+      return kPglRetSuccess;
+    }
+  }
+  uint32_t phasepresent_ct;
+  uint32_t dosage_ct;
+  uint32_t dphase_ct;
+  PglErr reterr = PgrGetDp(nullptr, nullptr, sample_ct, read_vidx, pgrp, genovec, phasepresent, phaseinfo, &phasepresent_ct, dosage_present, dosage_main, &dosage_ct, dphase_present, dphase_delta, &dphase_ct);
+  if (reterr) {
+    return reterr;
+  }
+  ZeroTrailingQuaters(sample_ct, genovec);
+  if ((!phasepresent_ct) && (!dphase_ct)) {
+    reterr = SpgwAppendBiallelicGenovecDosage16(genovec, dosage_present, dosage_main, dosage_ct, spgwp);
+  } else {
+    reterr = SpgwAppendBiallelicGenovecDphase16(genovec, phasepresent, phaseinfo, dosage_present, dphase_present, dosage_main, dphase_delta, dosage_ct, dphase_ct, spgwp);
+  }
+  if (reterr) {
+    return kPglRetWriteFail;
+  }
+  *last_nonld_key_ptr = UINT32_MAX;
+  return kPglRetSuccess;
+}
+
+// Single-threaded, since this is I/O-bound.  Records are copied verbatim,
+// except for LD-compressed records whose base variant was filtered out or
+// ends up in an earlier output variant block; those are decoded and
+// recompressed.
+static PglErr MakePgenPassthrough(const uintptr_t* variant_include, uint32_t raw_variant_ct, uint32_t variant_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  STPgenWriter spgw;
+  PglErr reterr = kPglRetSuccess;
+  PreinitSpgw(&spgw);
+  {
+    const uint32_t sample_ct = pgfip->raw_sample_ct;
+    PgenGlobalFlags phase_dosage_gflags = pgfip->gflags & (kfPgenGlobalHardcallPhasePresent | kfPgenGlobalDosagePresent | kfPgenGlobalDosagePhasePresent);
+    if (phase_dosage_gflags && (variant_ct < raw_variant_ct)) {
+      phase_dosage_gflags &= GflagsVfilter(variant_include, pgfip->vrtypes, raw_variant_ct, pgfip->gflags);
+    }
+    uint32_t nonref_flags_storage = 3;
+    if (!pgfip->nonref_flags) {
+      nonref_flags_storage = (pgfip->gflags & kfPgenGlobalAllNonref)? 2 : 1;
+    }
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pgen");
+    uintptr_t spgw_alloc_cacheline_ct;
+    uint32_t max_vrec_len;
+    reterr = SpgwInitPhase1(outname, nullptr, pgfip->nonref_flags, variant_ct, sample_ct, phase_dosage_gflags, nonref_flags_storage, &spgw, &spgw_alloc_cacheline_ct, &max_vrec_len);
+    if (reterr) {
+      goto MakePgenPassthrough_ret_1;
+    }
+    unsigned char* spgw_alloc;
+    if (bigstack_alloc_uc(spgw_alloc_cacheline_ct * kCacheline, &spgw_alloc)) {
+      goto MakePgenPassthrough_ret_NOMEM;
+    }
+    SpgwInitPhase2(max_vrec_len, &spgw, spgw_alloc);
+    const uint32_t sample_ctv = BitCtToVecCt(sample_ct);
+    uintptr_t* genovec;
+    uintptr_t* phasepresent;
+    uintptr_t* phaseinfo;
+    uintptr_t* dosage_present;
+    uintptr_t* dphase_present;
+    Dosage* dosage_main;
+    SDosage* dphase_delta;
+    if (bigstack_alloc_w(QuaterCtToVecCt(sample_ct) * kWordsPerVec, &genovec) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phasepresent) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phaseinfo) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dosage_present) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dphase_present) ||
+        bigstack_alloc_dosage(sample_ct, &dosage_main) ||
+        bigstack_alloc_dphase(sample_ct, &dphase_delta)) {
+      goto MakePgenPassthrough_ret_NOMEM;
+    }
+    logprintfww5("Writing %s ... ", outname);
+    fputs("0%", stdout);
+    fflush(stdout);
+    // input index of the last non-LD-compressed record written verbatim to
+    // the current output variant block, or UINT32_MAX if a recompressed
+    // record has been written since then
+    uint32_t last_nonld_write_uidx = UINT32_MAX;
+    uint32_t pct = 0;
+    uint32_t next_print_variant_idx = variant_ct / 100;
+    uint32_t variant_uidx = 0;
+    PgrClearLdCache(simple_pgrp);
+    for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
+      MovU32To1Bit(variant_include, &variant_uidx);
+      reterr = CopyOrRecompressVrec(variant_uidx, variant_idx, 0, sample_ct, max_vrec_len, simple_pgrp, &last_nonld_write_uidx, genovec, phasepresent, phaseinfo, dosage_present, dosage_main, dphase_present, dphase_delta, &spgw);
+      if (reterr) {
+        if (reterr == kPglRetMalformedInput) {
+          logputs("\n");
+          logerrputs("Error: Malformed .pgen file.\n");
+        }
+        goto MakePgenPassthrough_ret_1;
+      }
+      if (variant_idx >= next_print_variant_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (variant_idx * 100LLU) / variant_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+      }
+    }
+    reterr = SpgwFinish(&spgw);
+    if (reterr) {
+      goto MakePgenPassthrough_ret_1;
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+  }
+  while (0) {
+  MakePgenPassthrough_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  }
+ MakePgenPassthrough_ret_1:
+  if (SpgwCleanup(&spgw) && (!reterr)) {
+    reterr = kPglRetWriteFail;
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
+// Splits the included variants into runs of consecutive input records which
+// can be loaded into a single loadbuf_size-byte buffer.  Returns the number of
+// runs, or 0 if some record (plus its LD base) doesn't fit.
+// run_uidx_starts[] and run_variant_idx_starts[] are only filled when
+// non-null; they need room for (return value + 1) entries.
+static uint32_t PartitionVsortRuns(const uintptr_t* variant_include, const PgenFileInfo* pgfip, uint32_t variant_ct, uint64_t loadbuf_size, uint32_t* run_uidx_starts, uint32_t* run_variant_idx_starts) {
+  const unsigned char* vrtypes = pgfip->vrtypes;
+  const uint64_t* var_fpos = pgfip->var_fpos;
+  uint32_t run_ct = 0;
+  uint32_t variant_uidx = 0;
+  uint32_t variant_idx = 0;
+  while (variant_idx < variant_ct) {
+    MovU32To1Bit(variant_include, &variant_uidx);
+    const uint32_t read_uidx_start = VrtypeLdCompressed(vrtypes[variant_uidx])? GetLdbaseVidx(vrtypes, variant_uidx) : variant_uidx;
+    const uint64_t run_fpos_start = var_fpos[read_uidx_start];
+    if (var_fpos[variant_uidx + 1] - run_fpos_start > loadbuf_size) {
+      return 0;
+    }
+    if (run_uidx_starts) {
+      run_uidx_starts[run_ct] = variant_uidx;
+      run_variant_idx_starts[run_ct] = variant_idx;
+    }
+    ++run_ct;
+    while (1) {
+      ++variant_idx;
+      if (variant_idx == variant_ct) {
+        break;
+      }
+      ++variant_uidx;
+      MovU32To1Bit(variant_include, &variant_uidx);
+      if (var_fpos[variant_uidx + 1] - run_fpos_start > loadbuf_size) {
+        break;
+      }
+    }
+  }
+  if (run_uidx_starts) {
+    run_uidx_starts[run_ct] = variant_uidx + 1;
+    run_variant_idx_starts[run_ct] = variant_ct;
+  }
+  return run_ct;
+}
+
+static void VsortRunFname(uint32_t run_idx, char* outname_end) {
+  snprintf(outname_end, kMaxOutfnameExtBlen, ".vsort-run%u-temporary", run_idx);
+}
+
+// --sort-vars external: out-of-core alternative to MakePgenRobust() for the
+// raw-record-passthrough case.  The input .pgen is read front-to-back in
+// chunks which fill most of the remaining workspace; each chunk's records are
+// written, in output order, to a temporary sorted-run .pgen next to the
+// output prefix.  A k-way merge over sequential readers of the run files then
+// produces the final .pgen.  All .pgen I/O is sequential, at the cost of
+// writing and reading everything twice.
+static PglErr MakePgenExternalSort(const uintptr_t* variant_include, const uint32_t* new_variant_idx_to_old, uint32_t raw_variant_ct, uint32_t variant_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  PgenFileInfo* run_pgfis = nullptr;
+  PgenReader* run_pgrs = nullptr;
+  uint32_t run_reader_ct = 0;
+  uint32_t run_file_ct = 0;
+  PgenReader block_pgr;
+  STPgenWriter spgw;
+  STPgenWriter run_spgw;
+  PglErr reterr = kPglRetSuccess;
+  PreinitPgr(&block_pgr);
+  PreinitSpgw(&spgw);
+  PreinitSpgw(&run_spgw);
+  {
+    const uint32_t sample_ct = pgfip->raw_sample_ct;
+    PgenGlobalFlags phase_dosage_gflags = pgfip->gflags & (kfPgenGlobalHardcallPhasePresent | kfPgenGlobalDosagePresent | kfPgenGlobalDosagePhasePresent);
+    if (phase_dosage_gflags && (variant_ct < raw_variant_ct)) {
+      phase_dosage_gflags &= GflagsVfilter(variant_include, pgfip->vrtypes, raw_variant_ct, pgfip->gflags);
+    }
+    uintptr_t* write_nonref_flags = nullptr;
+    uint32_t nonref_flags_storage = (pgfip->gflags & kfPgenGlobalAllNonref)? 2 : 1;
+    if (pgfip->nonref_flags) {
+      const uint32_t variant_ctl = BitCtToWordCt(variant_ct);
+      if (bigstack_calloc_w(variant_ctl, &write_nonref_flags)) {
+        goto MakePgenExternalSort_ret_NOMEM;
+      }
+      for (uint32_t variant_idx = 0; variant_idx != variant_ct; ++variant_idx) {
+        if (IsSet(pgfip->nonref_flags, new_variant_idx_to_old[variant_idx])) {
+          SetBit(variant_idx, write_nonref_flags);
+        }
+      }
+      if (AllWordsAreZero(write_nonref_flags, variant_ctl)) {
+        nonref_flags_storage = 1;
+      } else if (AllBitsAreOne(write_nonref_flags, variant_ct)) {
+        nonref_flags_storage = 2;
+      } else {
+        nonref_flags_storage = 3;
+      }
+    }
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pgen");
+    uintptr_t spgw_alloc_cacheline_ct;
+    uint32_t max_vrec_len;
+    reterr = SpgwInitPhase1(outname, nullptr, write_nonref_flags, variant_ct, sample_ct, phase_dosage_gflags, nonref_flags_storage, &spgw, &spgw_alloc_cacheline_ct, &max_vrec_len);
+    if (reterr) {
+      goto MakePgenExternalSort_ret_1;
+    }
+    // run writers never need more workspace than the final writer
+    unsigned char* spgw_alloc;
+    unsigned char* run_spgw_alloc;
+    if (bigstack_alloc_uc(spgw_alloc_cacheline_ct * kCacheline, &spgw_alloc) ||
+        bigstack_alloc_uc(spgw_alloc_cacheline_ct * kCacheline, &run_spgw_alloc)) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+    SpgwInitPhase2(max_vrec_len, &spgw, spgw_alloc);
+    const uint32_t sample_ctv = BitCtToVecCt(sample_ct);
+    uintptr_t* genovec;
+    uintptr_t* phasepresent;
+    uintptr_t* phaseinfo;
+    uintptr_t* dosage_present;
+    uintptr_t* dphase_present;
+    Dosage* dosage_main;
+    SDosage* dphase_delta;
+    uint32_t* run_sorted_uidxs;
+    if (bigstack_alloc_w(QuaterCtToVecCt(sample_ct) * kWordsPerVec, &genovec) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phasepresent) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phaseinfo) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dosage_present) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dphase_present) ||
+        bigstack_alloc_dosage(sample_ct, &dosage_main) ||
+        bigstack_alloc_dphase(sample_ct, &dphase_delta) ||
+        bigstack_alloc_u32(variant_ct, &run_sorted_uidxs)) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+
+    // Give half of the remaining workspace to the load buffer; the merge
+    // phase needs a comparable amount for its per-run readers.
+    uint64_t loadbuf_size = RoundDownPow2U64(bigstack_left() / 2, kCacheline);
+#ifndef __LP64__
+    if (loadbuf_size > kMaxBytesPerIO) {
+      loadbuf_size = kMaxBytesPerIO;
+    }
+#endif
+    const uint32_t run_ct = PartitionVsortRuns(variant_include, pgfip, variant_ct, loadbuf_size, nullptr, nullptr);
+    if (!run_ct) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+    uint32_t* run_uidx_starts;
+    uint32_t* run_variant_idx_starts;
+    uint32_t* run_fill_cts;
+    if (bigstack_alloc_u32(run_ct + 1, &run_uidx_starts) ||
+        bigstack_alloc_u32(run_ct + 1, &run_variant_idx_starts) ||
+        bigstack_calloc_u32(run_ct, &run_fill_cts)) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+    PartitionVsortRuns(variant_include, pgfip, variant_ct, loadbuf_size, run_uidx_starts, run_variant_idx_starts);
+    // counting sort by run, preserving output order within each run
+    for (uint32_t variant_idx = 0; variant_idx != variant_ct; ++variant_idx) {
+      const uint32_t variant_uidx = new_variant_idx_to_old[variant_idx];
+      const uint32_t run_idx = CountSortedSmallerU32(run_uidx_starts, run_ct, variant_uidx + 1) - 1;
+      run_sorted_uidxs[run_variant_idx_starts[run_idx] + run_fill_cts[run_idx]] = variant_uidx;
+      run_fill_cts[run_idx] += 1;
+    }
+
+    unsigned char* phase1_mark = g_bigstack_base;
+    unsigned char* block_pgr_alloc;
+    unsigned char* loadbuf;
+    if (bigstack_alloc_uc(pgr_alloc_cacheline_ct * kCacheline, &block_pgr_alloc) ||
+        bigstack_alloc_uc(loadbuf_size, &loadbuf)) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+    pgfip->block_base = loadbuf;
+    reterr = PgrInit(nullptr, 0, pgfip, &block_pgr, block_pgr_alloc);
+    if (reterr) {
+      goto MakePgenExternalSort_ret_1;
+    }
+    logprintf("--sort-vars external: Writing %u sorted run%s ... ", run_ct, (run_ct == 1)? "" : "s");
+    fputs("0%", stdout);
+    fflush(stdout);
+    uint32_t pct = 0;
+    uint32_t next_print_run_idx = run_ct / 100;
+    for (uint32_t run_idx = 0; run_idx != run_ct; ++run_idx) {
+      const uint32_t run_variant_idx_start = run_variant_idx_starts[run_idx];
+      const uint32_t run_variant_ct = run_variant_idx_starts[run_idx + 1] - run_variant_idx_start;
+      reterr = PgfiMultiread(variant_include, run_uidx_starts[run_idx], run_uidx_starts[run_idx + 1], run_variant_ct, pgfip);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_1;
+      }
+      block_pgr.fi.block_base = pgfip->block_base;
+      block_pgr.fi.block_offset = pgfip->block_offset;
+      PgrClearLdCache(&block_pgr);
+      VsortRunFname(run_idx, outname_end);
+      uintptr_t run_spgw_alloc_cacheline_ct;
+      uint32_t run_max_vrec_len;
+      reterr = SpgwInitPhase1(outname, nullptr, nullptr, run_variant_ct, sample_ct, phase_dosage_gflags, 1, &run_spgw, &run_spgw_alloc_cacheline_ct, &run_max_vrec_len);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_1;
+      }
+      ++run_file_ct;
+      SpgwInitPhase2(run_max_vrec_len, &run_spgw, run_spgw_alloc);
+      const uint32_t* cur_run_sorted_uidxs = &(run_sorted_uidxs[run_variant_idx_start]);
+      uint32_t last_nonld_key = UINT32_MAX;
+      for (uint32_t run_variant_idx = 0; run_variant_idx != run_variant_ct; ++run_variant_idx) {
+        reterr = CopyOrRecompressVrec(cur_run_sorted_uidxs[run_variant_idx], run_variant_idx, 0, sample_ct, run_max_vrec_len, &block_pgr, &last_nonld_key, genovec, phasepresent, phaseinfo, dosage_present, dosage_main, dphase_present, dphase_delta, &run_spgw);
+        if (reterr) {
+          goto MakePgenExternalSort_ret_PGR_FAIL;
+        }
+      }
+      reterr = SpgwFinish(&run_spgw);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_1;
+      }
+      if (run_idx >= next_print_run_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (run_idx * 100LLU) / run_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_run_idx = (pct * S_CAST(uint64_t, run_ct)) / 100;
+      }
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+    pgfip->block_base = nullptr;
+    BigstackReset(phase1_mark);
+
+    // Records are consumed front-to-back from each run file, so per-variant
+    // fread() readers keep the merge sequential.
+    run_pgfis = S_CAST(PgenFileInfo*, bigstack_alloc(run_ct * sizeof(PgenFileInfo)));
+    run_pgrs = S_CAST(PgenReader*, bigstack_alloc(run_ct * sizeof(PgenReader)));
+    if ((!run_pgfis) || (!run_pgrs)) {
+      goto MakePgenExternalSort_ret_NOMEM;
+    }
+    for (uint32_t run_idx = 0; run_idx != run_ct; ++run_idx) {
+      PreinitPgfi(&(run_pgfis[run_idx]));
+      PreinitPgr(&(run_pgrs[run_idx]));
+    }
+    run_reader_ct = run_ct;
+    for (uint32_t run_idx = 0; run_idx != run_ct; ++run_idx) {
+      const uint32_t run_variant_ct = run_variant_idx_starts[run_idx + 1] - run_variant_idx_starts[run_idx];
+      VsortRunFname(run_idx, outname_end);
+      PgenFileInfo* run_pgfip = &(run_pgfis[run_idx]);
+      PgenHeaderCtrl header_ctrl;
+      uintptr_t cur_alloc_cacheline_ct;
+      reterr = PgfiInitPhase1(outname, run_variant_ct, sample_ct, 0, &header_ctrl, run_pgfip, &cur_alloc_cacheline_ct, g_logbuf);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_PGFI_INIT_FAIL;
+      }
+      unsigned char* pgfi_alloc;
+      if (bigstack_alloc_uc(cur_alloc_cacheline_ct * kCacheline, &pgfi_alloc)) {
+        goto MakePgenExternalSort_ret_NOMEM;
+      }
+      uint32_t max_vrec_width;
+      uintptr_t run_pgr_alloc_cacheline_ct;
+      reterr = PgfiInitPhase2(header_ctrl, 0, 0, 0, 0, run_variant_ct, &max_vrec_width, run_pgfip, pgfi_alloc, &run_pgr_alloc_cacheline_ct, g_logbuf);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_PGFI_INIT_FAIL;
+      }
+      unsigned char* run_pgr_alloc;
+      if (bigstack_alloc_uc(run_pgr_alloc_cacheline_ct * kCacheline, &run_pgr_alloc)) {
+        goto MakePgenExternalSort_ret_NOMEM;
+      }
+      reterr = PgrInit(outname, max_vrec_width, run_pgfip, &(run_pgrs[run_idx]), run_pgr_alloc);
+      if (reterr) {
+        if (reterr == kPglRetOpenFail) {
+          logerrprintf(kErrprintfFopen, outname);
+        }
+        goto MakePgenExternalSort_ret_1;
+      }
+      PgrClearLdCache(&(run_pgrs[run_idx]));
+    }
+    ZeroU32Arr(run_ct, run_fill_cts);
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pgen");
+    logprintfww5("Merging sorted runs into %s ... ", outname);
+    fputs("0%", stdout);
+    fflush(stdout);
+    uint32_t last_nonld_key = UINT32_MAX;
+    pct = 0;
+    uint32_t next_print_variant_idx = variant_ct / 100;
+    for (uint32_t variant_idx = 0; variant_idx != variant_ct; ++variant_idx) {
+      const uint32_t run_idx = CountSortedSmallerU32(run_uidx_starts, run_ct, new_variant_idx_to_old[variant_idx] + 1) - 1;
+      const uint32_t run_variant_idx = run_fill_cts[run_idx];
+      run_fill_cts[run_idx] += 1;
+      reterr = CopyOrRecompressVrec(run_variant_idx, variant_idx, run_variant_idx_starts[run_idx], sample_ct, max_vrec_len, &(run_pgrs[run_idx]), &last_nonld_key, genovec, phasepresent, phaseinfo, dosage_present, dosage_main, dphase_present, dphase_delta, &spgw);
+      if (reterr) {
+        goto MakePgenExternalSort_ret_PGR_FAIL;
+      }
+      if (variant_idx >= next_print_variant_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (variant_idx * 100LLU) / variant_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+      }
+    }
+    reterr = SpgwFinish(&spgw);
+    if (reterr) {
+      goto MakePgenExternalSort_ret_1;
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+  }
+  while (0) {
+  MakePgenExternalSort_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  MakePgenExternalSort_ret_PGFI_INIT_FAIL:
+    if (reterr != kPglRetReadFail) {
+      WordWrapB(0);
+      logerrputsb();
+    }
+    break;
+  MakePgenExternalSort_ret_PGR_FAIL:
+    if (reterr == kPglRetMalformedInput) {
+      logputs("\n");
+      logerrputs("Error: Malformed .pgen file.\n");
+    }
+    break;
+  }
+ MakePgenExternalSort_ret_1:
+  pgfip->block_base = nullptr;
+  CleanupPgr(&block_pgr);
+  if (SpgwCleanup(&spgw) && (!reterr)) {
+    reterr = kPglRetWriteFail;
+  }
+  SpgwCleanup(&run_spgw);
+  for (uint32_t run_idx = 0; run_idx != run_reader_ct; ++run_idx) {
+    CleanupPgr(&(run_pgrs[run_idx]));
+    CleanupPgfi(&(run_pgfis[run_idx]));
+  }
+  for (uint32_t run_idx = 0; run_idx != run_file_ct; ++run_idx) {
+    VsortRunFname(run_idx, outname_end);
+    unlink(outname);
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
 // Single-output-thread implementation.  Allows variants to be unsorted.
 // (Note that MakePlink2NoVsort() requires enough memory for 64k * 2
 // variants per output thread, due to LD compression.  This is faster in the
@@ -2986,7 +4296,7 @@ PglErr MakePgenRobust(const uintptr_t* sample_include, const uint32_t* new_sampl
   return reterr;
 }
 
-PglErr MakePlink2NoVsort(const char* xheader, const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uint32_t* new_sample_idx_to_old, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const double* variant_cms, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, MakePlink2Flags make_plink2_flags, PvarPsamFlags pvar_psam_flags, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+PglErr MakePlink2NoVsort(const char* xheader, const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uint32_t* new_sample_idx_to_old, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const char* const* pvar_info_strs, const double* variant_cms, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, MakePlink2Flags make_plink2_flags, PvarPsamFlags pvar_psam_flags, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   ThreadsState ts;
   InitThreads3z(&ts);
@@ -3241,6 +4551,11 @@ PglErr MakePlink2NoVsort(const char* xheader, const uintptr_t* sample_include, c
       fputs("\b\b", stdout);
       logprintf("done.\n");
       BigstackReset(bigstack_mark);
+    } else if (make_pgen && PgenPassthroughOk(variant_include, variant_allele_idxs, refalt1_select, new_sample_idx_to_old, pgfip, raw_sample_ct, sample_ct, variant_ct, hard_call_thresh, dosage_erase_thresh, make_plink2_flags)) {
+      reterr = MakePgenPassthrough(variant_include, raw_variant_ct, variant_ct, pgfip, simple_pgrp, outname, outname_end);
+      if (reterr) {
+        goto MakePlink2NoVsort_ret_1;
+      }
     } else if (make_pgen) {
       assert(variant_ct);
       assert(sample_ct);
@@ -3677,7 +4992,7 @@ PglErr MakePlink2NoVsort(const char* xheader, const uintptr_t* sample_include, c
       if (!pgfip->nonref_flags) {
         nonref_flags_storage = (pgfip->gflags & kfPgenGlobalAllNonref)? 2 : 1;
       }
-      reterr = WritePvar(outname, xheader, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, trim_alts? allele_dosages : nullptr, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, pgfip->nonref_flags, pvar_info_reload, variant_cms, raw_variant_ct, variant_ct, max_allele_slen, xheader_blen, info_flags, nonref_flags_storage, max_filter_slen, info_reload_slen, pvar_psam_flags, max_thread_ct);
+      reterr = WritePvar(outname, xheader, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, trim_alts? allele_dosages : nullptr, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, pgfip->nonref_flags, pvar_info_reload, pvar_info_strs, variant_cms, raw_variant_ct, variant_ct, max_allele_slen, xheader_blen, info_flags, nonref_flags_storage, max_filter_slen, info_reload_slen, pvar_psam_flags, max_thread_ct);
       if (reterr) {
         goto MakePlink2NoVsort_ret_1;
       }
@@ -4092,7 +5407,7 @@ PglErr WritePvarResortedInterval(const ChrInfo* write_cip, const uint32_t* varia
 // allocation of buffers, and generating the header line occurs directly in
 // this function, while loading the next pvar_info_strs batch and writing the
 // next .pvar line batch are one level down.
-PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr_t* variant_include, const ChrInfo* write_cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* qual_present, const float* quals, const uintptr_t* filter_present, const uintptr_t* filter_npass, const char* const* filter_storage, const uintptr_t* nonref_flags, const char* pvar_info_reload, const double* variant_cms, const uint32_t* new_variant_idx_to_old, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t nonref_flags_storage, uint32_t max_filter_slen, uint32_t info_reload_slen, PvarPsamFlags pvar_psam_flags, uint32_t thread_ct) {
+PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr_t* variant_include, const ChrInfo* write_cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* qual_present, const float* quals, const uintptr_t* filter_present, const uintptr_t* filter_npass, const char* const* filter_storage, const uintptr_t* nonref_flags, const char* pvar_info_reload, const char* const* pvar_info_strs, const double* variant_cms, const uint32_t* new_variant_idx_to_old, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t nonref_flags_storage, uint32_t max_filter_slen, uint32_t info_reload_slen, PvarPsamFlags pvar_psam_flags, uint32_t thread_ct) {
   unsigned char* bigstack_mark = g_bigstack_base;
   char* cswritep = nullptr;
   PglErr reterr = kPglRetSuccess;
@@ -4210,10 +5525,18 @@ PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr
     AppendBinaryEoln(&cswritep);
 
     uint32_t* old_variant_uidx_to_new = nullptr;
-    char** pvar_info_strs = nullptr;
+    char** batch_info_strs = nullptr;
     uint32_t batch_size = variant_ct;
     uint32_t batch_ct = 1;
-    if (pvar_info_reload) {
+    if (pvar_info_strs) {
+      // INFO already in memory; just permute the pointers.
+      if (bigstack_alloc_cp(variant_ct, &batch_info_strs)) {
+        goto WritePvarResorted_ret_NOMEM;
+      }
+      for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx) {
+        batch_info_strs[variant_idx] = K_CAST(char*, pvar_info_strs[new_variant_idx_to_old[variant_idx]]);
+      }
+    } else if (pvar_info_reload) {
       if (bigstack_alloc_u32(raw_variant_ct, &old_variant_uidx_to_new)) {
         goto WritePvarResorted_ret_NOMEM;
       }
@@ -4236,7 +5559,7 @@ PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr
         batch_size = bytes_left / single_variant_byte_ct;
         batch_ct = 1 + (variant_ct - 1) / batch_size;
       }
-      pvar_info_strs = S_CAST(char**, bigstack_alloc_raw_rd(batch_size * sizeof(intptr_t)));
+      batch_info_strs = S_CAST(char**, bigstack_alloc_raw_rd(batch_size * sizeof(intptr_t)));
     }
 
     uint32_t variant_idx_start = 0;
@@ -4245,13 +5568,13 @@ PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr
     uint32_t chr_buf_blen = 0;
     for (uint32_t batch_idx = 0; batch_idx < batch_ct; ++batch_idx) {
       uint32_t variant_idx_end = MINV(variant_idx_start + batch_size, variant_ct);
-      if (pvar_info_reload) {
-        reterr = PvarInfoReloadInterval(old_variant_uidx_to_new, variant_idx_start, variant_idx_end, raw_variant_ct, &pvar_reload_rls, pvar_info_strs);
+      if (pvar_info_reload && (!pvar_info_strs)) {
+        reterr = PvarInfoReloadInterval(old_variant_uidx_to_new, variant_idx_start, variant_idx_end, raw_variant_ct, &pvar_reload_rls, batch_info_strs);
         if (reterr) {
           goto WritePvarResorted_ret_1;
         }
       }
-      reterr = WritePvarResortedInterval(write_cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, qual_present, quals, filter_present, filter_npass, filter_storage, nonref_flags, variant_cms, new_variant_idx_to_old, variant_idx_start, variant_idx_end, info_pr_flag_present, write_qual, write_filter, write_info, all_nonref, write_cm, pvar_info_strs, &css, &cswritep, &chr_fo_idx, &chr_end, &chr_buf_blen, chr_buf, allele_include);
+      reterr = WritePvarResortedInterval(write_cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, allele_dosages, refalt1_select, qual_present, quals, filter_present, filter_npass, filter_storage, nonref_flags, variant_cms, new_variant_idx_to_old, variant_idx_start, variant_idx_end, info_pr_flag_present, write_qual, write_filter, write_info, all_nonref, write_cm, batch_info_strs, &css, &cswritep, &chr_fo_idx, &chr_end, &chr_buf_blen, chr_buf, allele_include);
       if (reterr) {
         goto WritePvarResorted_ret_1;
       }
@@ -4280,7 +5603,7 @@ PglErr WritePvarResorted(const char* outname, const char* xheader, const uintptr
   return reterr;
 }
 
-PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uint32_t* new_sample_idx_to_old, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const double* variant_cms, const ChrIdx* chr_idxs, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, MakePlink2Flags make_plink2_flags, uint32_t use_nsort, PvarPsamFlags pvar_psam_flags, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uint32_t* new_sample_idx_to_old, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint64_t* allele_dosages, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const char* const* pvar_info_strs, const double* variant_cms, const ChrIdx* chr_idxs, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, MakePlink2Flags make_plink2_flags, uint32_t use_nsort, PvarPsamFlags pvar_psam_flags, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   PglErr reterr = kPglRetSuccess;
@@ -4394,7 +5717,7 @@ PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, con
             chr_end = cip->chr_fo_vidx_start[old_chr_fo_idx + 1];
           } while (variant_uidx >= chr_end);
           chr_idx = cip->chr_file_order[old_chr_fo_idx];
-          write_vidx = write_chr_info.chr_idx_to_foidx[chr_idx];
+          write_vidx = write_chr_info.chr_fo_vidx_start[write_chr_info.chr_idx_to_foidx[chr_idx]];
         }
         pos_vidx_sort_buf[write_vidx] = (S_CAST(uint64_t, variant_bps[variant_uidx]) << 32) | variant_uidx;
       }
@@ -4411,12 +5734,10 @@ PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, con
       const uint64_t post_entry = pos_vidx_sort_buf[vidx_end];
       pos_vidx_sort_buf[vidx_end] = ~0LLU;  // simplify end-of-chromosome logic
       uint64_t* pos_vidx_sort_chr = &(pos_vidx_sort_buf[vidx_start]);
-
-#ifdef __cplusplus
-      std::sort(pos_vidx_sort_chr, &(pos_vidx_sort_chr[chr_size]));
-#else
-      qsort(pos_vidx_sort_chr, chr_size, sizeof(int64_t), uint64cmp);
-#endif
+      reterr = SortU64Mt(chr_size, max_thread_ct, pos_vidx_sort_chr);
+      if (reterr) {
+        goto MakePlink2Vsort_ret_1;
+      }
       uint32_t prev_pos = pos_vidx_sort_chr[0] >> 32;
       uint32_t prev_variant_uidx = S_CAST(uint32_t, pos_vidx_sort_chr[0]);
       uint32_t prev_cidx = 0;
@@ -4483,7 +5804,7 @@ PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, con
       if (!simple_pgrp->fi.nonref_flags) {
         nonref_flags_storage = (simple_pgrp->fi.gflags & kfPgenGlobalAllNonref)? 2 : 1;
       }
-      reterr = WritePvarResorted(outname, xheader, variant_include, &write_chr_info, variant_bps, variant_ids, variant_allele_idxs, allele_storage, trim_alts? allele_dosages : nullptr, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, simple_pgrp->fi.nonref_flags, pvar_info_reload, variant_cms, new_variant_idx_to_old, raw_variant_ct, variant_ct, max_allele_slen, xheader_blen, info_flags, nonref_flags_storage, max_filter_slen, info_reload_slen, pvar_psam_flags, max_thread_ct);
+      reterr = WritePvarResorted(outname, xheader, variant_include, &write_chr_info, variant_bps, variant_ids, variant_allele_idxs, allele_storage, trim_alts? allele_dosages : nullptr, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, simple_pgrp->fi.nonref_flags, pvar_info_reload, pvar_info_strs, variant_cms, new_variant_idx_to_old, raw_variant_ct, variant_ct, max_allele_slen, xheader_blen, info_flags, nonref_flags_storage, max_filter_slen, info_reload_slen, pvar_psam_flags, max_thread_ct);
       if (reterr) {
         goto MakePlink2Vsort_ret_1;
       }
@@ -4542,8 +5863,19 @@ PglErr MakePlink2Vsort(const char* xheader, const uintptr_t* sample_include, con
       if (make_plink2_flags & kfMakePlink2SetMixedMtMissing) {
         g_plink2_write_flags |= kfPlink2WriteSetMixedMtMissing;
       }
-      g_cip = &write_chr_info;
-      reterr = MakePgenRobust(sample_include, new_sample_idx_to_old, variant_include, variant_allele_idxs, refalt1_select, new_variant_idx_to_old, raw_sample_ct, sample_ct, raw_variant_ct, variant_ct, hard_call_thresh, dosage_erase_thresh, make_plink2_flags, simple_pgrp, outname, outname_end);
+      uint32_t external_sort = 0;
+      if (make_plink2_flags & kfMakePlink2SortVarsExternal) {
+        external_sort = ((make_plink2_flags & (kfMakeBed | kfMakePgen | (kfMakePgenFormatBase * 3))) == kfMakePgen) && PgenPassthroughOk(variant_include, variant_allele_idxs, refalt1_select, new_sample_idx_to_old, pgfip, raw_sample_ct, sample_ct, variant_ct, hard_call_thresh, dosage_erase_thresh, make_plink2_flags);
+        if (!external_sort) {
+          logerrputs("Warning: --sort-vars 'external' currently requires regular .pgen output with\nunchanged samples, alleles, and genotype/phase/dosage values; sorting in\nmemory instead.\n");
+        }
+      }
+      if (external_sort) {
+        reterr = MakePgenExternalSort(variant_include, new_variant_idx_to_old, raw_variant_ct, variant_ct, pgr_alloc_cacheline_ct, pgfip, outname, outname_end);
+      } else {
+        g_cip = &write_chr_info;
+        reterr = MakePgenRobust(sample_include, new_sample_idx_to_old, variant_include, variant_allele_idxs, refalt1_select, new_variant_idx_to_old, raw_sample_ct, sample_ct, raw_variant_ct, variant_ct, hard_call_thresh, dosage_erase_thresh, make_plink2_flags, simple_pgrp, outname, outname_end);
+      }
       if (reterr) {
         goto MakePlink2Vsort_ret_1;
       }
@@ -4670,6 +6002,100 @@ PglErr SampleSortFileMap(const uintptr_t* sample_include, const SampleIdInfo* si
   return reterr;
 }
 
+static const unsigned char kBgenIdxMagic[8] = {'p', 'l', 'b', 'g', 'i', 'd', 'x', 1};
+
+PglErr WriteBgenIdx(const char* idxname, const uint64_t* variant_fposes, uint32_t variant_ct) {
+  FILE* idxfile = nullptr;
+  PglErr reterr = kPglRetSuccess;
+  {
+    if (fopen_checked(idxname, FOPEN_WB, &idxfile)) {
+      goto WriteBgenIdx_ret_OPEN_FAIL;
+    }
+    unsigned char idx_header[16];
+    memcpy(idx_header, kBgenIdxMagic, 8);
+    memcpy(&(idx_header[8]), &variant_ct, 4);
+    memset(&(idx_header[12]), 0, 4);
+    if (fwrite_checked(idx_header, 16, idxfile) ||
+        fwrite_checked(variant_fposes, (variant_ct + k1LU) * sizeof(int64_t), idxfile) ||
+        fclose_null(&idxfile)) {
+      goto WriteBgenIdx_ret_WRITE_FAIL;
+    }
+  }
+  while (0) {
+  WriteBgenIdx_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  WriteBgenIdx_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  }
+  fclose_cond(idxfile);
+  return reterr;
+}
+
+PglErr LoadBgenIdx(const char* idxname, uint32_t variant_ct, uint64_t bgen_fsize, uint64_t** variant_fposes_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  FILE* idxfile = nullptr;
+  PglErr reterr = kPglRetSuccess;
+  {
+    idxfile = fopen(idxname, FOPEN_RB);
+    if (!idxfile) {
+      goto LoadBgenIdx_ret_OPEN_FAIL;
+    }
+    unsigned char idx_header[16];
+    if (!fread_unlocked(idx_header, 16, 1, idxfile)) {
+      goto LoadBgenIdx_ret_MALFORMED_INPUT;
+    }
+    if (memcmp(idx_header, kBgenIdxMagic, 8)) {
+      goto LoadBgenIdx_ret_MALFORMED_INPUT;
+    }
+    uint32_t idx_variant_ct;
+    memcpy(&idx_variant_ct, &(idx_header[8]), 4);
+    if (idx_variant_ct != variant_ct) {
+      goto LoadBgenIdx_ret_INCONSISTENT_INPUT;
+    }
+    uint64_t* variant_fposes;
+    if (bigstack_alloc_u64(variant_ct + 1, &variant_fposes)) {
+      goto LoadBgenIdx_ret_NOMEM;
+    }
+    if (!fread_unlocked(variant_fposes, (variant_ct + k1LU) * sizeof(int64_t), 1, idxfile)) {
+      goto LoadBgenIdx_ret_MALFORMED_INPUT;
+    }
+    if (variant_fposes[variant_ct] != bgen_fsize) {
+      goto LoadBgenIdx_ret_INCONSISTENT_INPUT;
+    }
+    // the bgen header occupies at least the first 24 bytes
+    uint64_t prev_fpos = 23;
+    for (uint32_t variant_idx = 0; variant_idx <= variant_ct; ++variant_idx) {
+      const uint64_t cur_fpos = variant_fposes[variant_idx];
+      if (cur_fpos <= prev_fpos) {
+        goto LoadBgenIdx_ret_MALFORMED_INPUT;
+      }
+      prev_fpos = cur_fpos;
+    }
+    *variant_fposes_ptr = variant_fposes;
+  }
+  while (0) {
+  LoadBgenIdx_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  LoadBgenIdx_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  LoadBgenIdx_ret_MALFORMED_INPUT:
+    reterr = kPglRetMalformedInput;
+    break;
+  LoadBgenIdx_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+  fclose_cond(idxfile);
+  if (reterr) {
+    BigstackReset(bigstack_mark);
+  }
+  return reterr;
+}
+
 #ifdef __cplusplus
 }  // namespace plink2
 #endif
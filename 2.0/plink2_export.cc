@@ -18,9 +18,11 @@
 #include "plink2_export.h"
 
 #include "htslib/htslib/bgzf.h"
+#include "htslib/htslib/hts.h"
 #include "libdeflate/libdeflate.h"
 
 #include <time.h>
+#include <unistd.h>  // unlink()
 
 #ifdef __cplusplus
 namespace plink2 {
@@ -44,7 +46,7 @@ static unsigned char* g_writebufs[2] = {nullptr, nullptr};
 static const uintptr_t* g_variant_include = nullptr;
 static const ChrInfo* g_cip = nullptr;
 static const uintptr_t* g_sample_include = nullptr;
-static uint32_t* g_sample_include_cumulative_popcounts = nullptr;
+static const uint32_t* g_sample_include_cumulative_popcounts = nullptr;
 static const uintptr_t* g_variant_allele_idxs = nullptr;
 static const AltAlleleCt* g_refalt1_select = nullptr;
 
@@ -425,9 +427,154 @@ THREAD_FUNC_DECL TransposeToPlink1SmajWriteThread(void* arg) {
   }
 }
 
+// Appends src_entry_ct quaters from src (trailing entries in the last word
+// must be zero) to dst, starting at entry dst_entry_offset.  Entries in dst at
+// or past dst_entry_offset must be zero, and one word past the last touched
+// word may be overwritten.
+static void AppendQuaterarrUnsafe(const uintptr_t* __restrict src, uint32_t src_entry_ct, uint32_t dst_entry_offset, uintptr_t* __restrict dst) {
+  uintptr_t* dst_iter = &(dst[dst_entry_offset / kBitsPerWordD2]);
+  const uint32_t src_word_ct = QuaterCtToWordCt(src_entry_ct);
+  const uint32_t lshift = 2 * (dst_entry_offset % kBitsPerWordD2);
+  if (!lshift) {
+    memcpy(dst_iter, src, src_word_ct * sizeof(intptr_t));
+    return;
+  }
+  const uint32_t rshift = kBitsPerWord - lshift;
+  for (uint32_t widx = 0; widx < src_word_ct; ++widx) {
+    const uintptr_t cur_word = src[widx];
+    *dst_iter |= cur_word << lshift;
+    *(++dst_iter) = cur_word >> rshift;
+  }
+}
+
+// Reads variant_include[] (all samples in sample_include[]) until either
+// capacity_variant_ct would be exceeded by the next read block or all
+// variants have been read, decoding into g_vmaj_readbuf.
+// *read_block_idx_ptr / *next_block_write_ct_ptr describe the next unread
+// nonempty block on entry and exit.
+static PglErr TransposeToSmajLoadChunk(const uintptr_t* variant_include, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t read_block_size, uint32_t capacity_variant_ct, uint32_t calc_thread_ct, unsigned char** main_loadbufs, pthread_t* threads, PgenFileInfo* pgfip, uint32_t* parity_ptr, uint32_t* read_block_idx_ptr, uint32_t* next_block_write_ct_ptr, uint32_t* variant_idx_ptr, uint32_t* chunk_variant_ct_ptr) {
+  const uint32_t read_block_sizel = BitCtToWordCt(read_block_size);
+  const uint32_t read_block_ct_m1 = (raw_variant_ct - 1) / read_block_size;
+  uint32_t parity = *parity_ptr;
+  uint32_t read_block_idx = *read_block_idx_ptr;
+  uint32_t cur_block_write_ct = *next_block_write_ct_ptr;
+  uint32_t variant_idx = *variant_idx_ptr;
+  uint32_t chunk_variant_ct = 0;
+  uint32_t is_last_block = 0;
+  while (1) {
+    if (!is_last_block) {
+      const uint32_t read_block_uidx_start = read_block_idx * read_block_size;
+      const uint32_t cur_read_block_size = (read_block_idx == read_block_ct_m1)? (raw_variant_ct - read_block_uidx_start) : read_block_size;
+      if (PgfiMultiread(variant_include, read_block_uidx_start, read_block_uidx_start + cur_read_block_size, cur_block_write_ct, pgfip)) {
+        if (chunk_variant_ct) {
+          JoinThreads2z(calc_thread_ct, 0, threads);
+          g_cur_block_write_ct = 0;
+          ErrorCleanupThreads2z(TransposeToSmajReadThread, calc_thread_ct, threads);
+        }
+        return kPglRetReadFail;
+      }
+    }
+    if (chunk_variant_ct) {
+      JoinThreads2z(calc_thread_ct, is_last_block, threads);
+      const PglErr reterr = g_error_ret;
+      if (reterr) {
+        if (!is_last_block) {
+          g_cur_block_write_ct = 0;
+          ErrorCleanupThreads2z(TransposeToSmajReadThread, calc_thread_ct, threads);
+        }
+        return reterr;
+      }
+      if (is_last_block) {
+        break;
+      }
+    }
+    g_cur_block_write_ct = cur_block_write_ct;
+    ComputeUidxStartPartition(variant_include, cur_block_write_ct, calc_thread_ct, read_block_idx * read_block_size, g_read_variant_uidx_starts);
+    for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+      g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
+      g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+    }
+    variant_idx += cur_block_write_ct;
+    chunk_variant_ct += cur_block_write_ct;
+    cur_block_write_ct = 0;
+    if (variant_idx != variant_ct) {
+      // find next nonempty block
+      do {
+        ++read_block_idx;
+        if (read_block_idx == read_block_ct_m1) {
+          cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(raw_variant_ct - read_block_idx * read_block_size));
+          break;
+        }
+        cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
+      } while (!cur_block_write_ct);
+    }
+    is_last_block = (variant_idx == variant_ct) || (chunk_variant_ct + cur_block_write_ct > capacity_variant_ct);
+    if (SpawnThreads2z(TransposeToSmajReadThread, calc_thread_ct, is_last_block, threads)) {
+      return kPglRetThreadCreateFail;
+    }
+    parity = 1 - parity;
+    pgfip->block_base = main_loadbufs[parity];
+  }
+  *parity_ptr = parity;
+  *read_block_idx_ptr = read_block_idx;
+  *next_block_write_ct_ptr = cur_block_write_ct;
+  *variant_idx_ptr = variant_idx;
+  *chunk_variant_ct_ptr = chunk_variant_ct;
+  return kPglRetSuccess;
+}
+
+// Transposes the chunk_variant_ct x sample_ct variant-major matrix in
+// g_vmaj_readbuf, writing each sample's row (row_byte_ct bytes) to outfile.
+static PglErr TransposeToPlink1SmajWriteChunk(uint32_t sample_ct, uint32_t chunk_variant_ct, uint32_t sample_batch_size, uint32_t max_output_calc_thread_ct, uintptr_t row_byte_ct, pthread_t* threads, FILE* outfile) {
+  const uintptr_t chunk_cacheline_ct = QuaterCtToCachelineCt(chunk_variant_ct);
+  const uintptr_t row_stride = chunk_cacheline_ct * kWordsPerCacheline;
+  const uint32_t output_calc_thread_ct = MINV(max_output_calc_thread_ct, chunk_cacheline_ct);
+  g_output_calc_thread_ct = output_calc_thread_ct;
+  g_variant_ct = chunk_variant_ct;
+  g_sample_batch_size = sample_batch_size;
+  uint32_t parity = 0;
+  uint32_t is_last_block = 0;
+  uint32_t flush_sample_idx = 0;
+  uint32_t flush_sample_idx_end = 0;
+  while (1) {
+    if (!is_last_block) {
+      is_last_block = (flush_sample_idx_end + sample_batch_size >= sample_ct);
+      if (is_last_block) {
+        g_sample_batch_size = sample_ct - flush_sample_idx_end;
+      }
+      if (SpawnThreads2z(TransposeToPlink1SmajWriteThread, output_calc_thread_ct, is_last_block, threads)) {
+        return kPglRetThreadCreateFail;
+      }
+    }
+    if (flush_sample_idx_end) {
+      const uintptr_t* smaj_writebuf_iter = g_smaj_writebufs[1 - parity];
+      for (; flush_sample_idx < flush_sample_idx_end; ++flush_sample_idx) {
+        fwrite_unlocked(smaj_writebuf_iter, row_byte_ct, 1, outfile);
+        smaj_writebuf_iter = &(smaj_writebuf_iter[row_stride]);
+      }
+      if (flush_sample_idx_end == sample_ct) {
+        break;
+      }
+    }
+    JoinThreads2z(output_calc_thread_ct, is_last_block, threads);
+    if (ferror_unlocked(outfile)) {
+      return kPglRetWriteFail;
+    }
+    parity = 1 - parity;
+    flush_sample_idx_end += sample_batch_size;
+    if (flush_sample_idx_end > sample_ct) {
+      flush_sample_idx_end = sample_ct;
+    }
+  }
+  return kPglRetSuccess;
+}
+
 PglErr ExportIndMajorBed(const uintptr_t* orig_sample_include, const uintptr_t* variant_include, const uintptr_t* variant_allele_idxs, const AltAlleleCt* refalt1_select, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
   FILE* outfile = nullptr;
+  FILE* smaj_tmpfile = nullptr;
+  char* smaj_tmpname = nullptr;
   PglErr reterr = kPglRetSuccess;
   {
     // Possible special case: if the input file is a variant-major .bed, we do
@@ -468,66 +615,120 @@ PglErr ExportIndMajorBed(const uintptr_t* orig_sample_include, const uintptr_t*
       }
       uintptr_t* sample_include;
       uint32_t* sample_include_cumulative_popcounts;
+      uint32_t* chunk_variant_cts;
+      // chunks other than the last are more than half full (see below), and
+      // contain at least 2 * kPglQuaterTransposeBatch variants
+      const uint32_t max_chunk_ct = 1 + variant_ct / kPglQuaterTransposeBatch;
       if (bigstack_alloc_w(raw_sample_ctl, &sample_include) ||
           bigstack_alloc_u32(raw_sample_ctl, &sample_include_cumulative_popcounts) ||
+          bigstack_alloc_u32(max_chunk_ct, &chunk_variant_cts) ||
           bigstack_alloc_vp(output_calc_thread_ct, &g_thread_vecaligned_bufs)) {
         goto ExportIndMajorBed_ret_NOMEM;
       }
       for (uint32_t tidx = 0; tidx < output_calc_thread_ct; ++tidx) {
         g_thread_vecaligned_bufs[tidx] = S_CAST(VecW*, bigstack_alloc_raw(kPglQuaterTransposeBufbytes));
       }
-      // each of the two write buffers should use <= 1/8 of the remaining
-      // workspace
+      g_sample_include = sample_include;
+      g_sample_include_cumulative_popcounts = sample_include_cumulative_popcounts;
+      g_error_ret = kPglRetSuccess;
+      const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+      unsigned char* chunk_alloc_base = g_bigstack_base;
+
+      // Try to transpose everything in memory at once.  Each of the two write
+      // buffers should use <= 1/8 of the remaining workspace.
       const uintptr_t writebuf_cachelines_avail = bigstack_left() / (kCacheline * 8);
       uint32_t sample_batch_size = kPglQuaterTransposeBatch;
       if (variant_cacheline_ct * kPglQuaterTransposeBatch > writebuf_cachelines_avail) {
         sample_batch_size = RoundDownPow2(writebuf_cachelines_avail / variant_cacheline_ct, kBitsPerWordD2);
-        if (!sample_batch_size) {
-          goto ExportIndMajorBed_ret_NOMEM;
+      }
+      uint32_t capacity_variant_ct = variant_ct;
+      if (sample_batch_size) {
+        const uintptr_t readbuf_byte_ct = bigstack_left() - 2 * variant_cacheline_ct * kCacheline * sample_batch_size;
+        if ((readbuf_byte_ct > bigstack_left()) || (readbuf_byte_ct / sizeof(intptr_t) < variant_ct * sample_ctaw2 + 2 * kWordsPerCacheline)) {
+          sample_batch_size = 0;
         }
       }
-      g_smaj_writebufs[0] = S_CAST(uintptr_t*, bigstack_alloc_raw(variant_cacheline_ct * kCacheline * sample_batch_size));
-      g_smaj_writebufs[1] = S_CAST(uintptr_t*, bigstack_alloc_raw(variant_cacheline_ct * kCacheline * sample_batch_size));
-      const uintptr_t readbuf_vecs_avail = (bigstack_left() / kCacheline) * kVecsPerCacheline;
-      if (readbuf_vecs_avail < variant_ct) {
-        goto ExportIndMajorBed_ret_NOMEM;
+      uint32_t is_external = !sample_batch_size;
+      uint32_t read_sample_ct = sample_ct;
+      if (is_external) {
+        // Not enough memory.  Instead of rereading the .pgen once per sample
+        // range, transpose variant chunks (all samples at once) to a temporary
+        // file of sample-major tiles, and then merge the tiles in sample
+        // order.  This costs one sequential .pgen read and one temporary-file
+        // write+read regardless of workspace size.
+        sample_batch_size = kPglQuaterTransposeBatch;
+        // per variant: read buffer row, plus 2 write buffers of
+        // sample_batch_size / 4 bytes
+        const uintptr_t per_variant_byte_ct = sample_ctaw2 * sizeof(intptr_t) + sample_batch_size / 2;
+        const uintptr_t capacity_raw = (bigstack_left() - 4 * kCacheline) / per_variant_byte_ct;
+        if (capacity_raw >= 2 * kPglQuaterTransposeBatch) {
+          capacity_variant_ct = RoundDownPow2(MINV(capacity_raw, variant_ct), kPglQuaterTransposeBatch);
+          while (read_block_size > capacity_variant_ct / 2) {
+            read_block_size /= 2;
+          }
+        } else {
+          // Can't even hold a minimal chunk of full sample rows; fall back to
+          // rereading the .pgen once per sample range.
+          is_external = 0;
+          if (variant_cacheline_ct * kPglQuaterTransposeBatch > writebuf_cachelines_avail) {
+            sample_batch_size = RoundDownPow2(writebuf_cachelines_avail / variant_cacheline_ct, kBitsPerWordD2);
+          }
+          if (!sample_batch_size) {
+            goto ExportIndMajorBed_ret_NOMEM;
+          }
+          const uintptr_t readbuf_vecs_avail = ((bigstack_left() - 2 * variant_cacheline_ct * kCacheline * sample_batch_size) / kCacheline) * kVecsPerCacheline;
+          if (readbuf_vecs_avail < variant_ct) {
+            goto ExportIndMajorBed_ret_NOMEM;
+          }
+          read_sample_ct = (readbuf_vecs_avail / variant_ct) * kQuatersPerVec;
+          if (read_sample_ct > sample_ct) {
+            read_sample_ct = sample_ct;
+          }
+        }
       }
-      uintptr_t read_sample_ctv2 = readbuf_vecs_avail / variant_ct;
-      uint32_t read_sample_ct;
-      if (read_sample_ctv2 >= QuaterCtToVecCt(sample_ct)) {
-        read_sample_ct = sample_ct;
+      const uint32_t pass_ct = 1 + (sample_ct - 1) / read_sample_ct;
+      const uintptr_t capacity_cacheline_ct = QuaterCtToCachelineCt(capacity_variant_ct);
+      g_smaj_writebufs[0] = S_CAST(uintptr_t*, bigstack_alloc_raw(capacity_cacheline_ct * kCacheline * sample_batch_size));
+      g_smaj_writebufs[1] = S_CAST(uintptr_t*, bigstack_alloc_raw(capacity_cacheline_ct * kCacheline * sample_batch_size));
+      g_vmaj_readbuf = S_CAST(uintptr_t*, bigstack_alloc_raw_rd(capacity_variant_ct * QuaterCtToAlignedWordCt(read_sample_ct) * kBytesPerWord));
+
+      uint32_t chunk_ct = 0;
+      FILE* chunk_outfile = outfile;
+      if (is_external) {
+        const uint32_t outname_slen = strlen(outname);
+        if (bigstack_end_alloc_c(outname_slen + 16, &smaj_tmpname)) {
+          goto ExportIndMajorBed_ret_NOMEM;
+        }
+        snprintf(memcpya(smaj_tmpname, outname, outname_slen), 16, ".smaj-temporary");
+        if (fopen_checked(smaj_tmpname, FOPEN_WB, &smaj_tmpfile)) {
+          goto ExportIndMajorBed_ret_OPEN_FAIL;
+        }
+        chunk_outfile = smaj_tmpfile;
+        logprintfww5("Writing %s (via %s) ... ", outname, smaj_tmpname);
       } else {
-        read_sample_ct = read_sample_ctv2 * kQuatersPerVec;
+        logprintfww5("Writing %s ... ", outname);
       }
-      uintptr_t read_sample_ctaw2 = QuaterCtToAlignedWordCt(read_sample_ct);
-      uintptr_t* vmaj_readbuf = S_CAST(uintptr_t*, bigstack_alloc_raw_rd(variant_ct * read_sample_ctaw2 * kBytesPerWord));
-      g_variant_ct = variant_ct;
-      g_output_calc_thread_ct = output_calc_thread_ct;
-      g_error_ret = kPglRetSuccess;
-      uint32_t sample_uidx_start = AdvTo1Bit(orig_sample_include, 0);
-      const uintptr_t variant_ct4 = QuaterCtToByteCt(variant_ct);
-      const uintptr_t variant_ctaclw2 = variant_cacheline_ct * kWordsPerCacheline;
+      fputs("0%", stdout);
+      fflush(stdout);
+      uint32_t pct = 0;
       const uint32_t read_block_sizel = BitCtToWordCt(read_block_size);
       const uint32_t read_block_ct_m1 = (raw_variant_ct - 1) / read_block_size;
-      const uint32_t pass_ct = 1 + (sample_ct - 1) / read_sample_ct;
+      uint32_t sample_uidx_start = AdvTo1Bit(orig_sample_include, 0);
       for (uint32_t pass_idx = 0; pass_idx < pass_ct; ++pass_idx) {
+        uint32_t sample_uidx_end = raw_sample_ct;
         memcpy(sample_include, orig_sample_include, raw_sample_ctl * sizeof(intptr_t));
-        if (sample_uidx_start) {
-          ClearBitsNz(0, sample_uidx_start, sample_include);
-        }
-        uint32_t sample_uidx_end;
-        if (pass_idx + 1 == pass_ct) {
-          read_sample_ct = sample_ct - pass_idx * read_sample_ct;
-          read_sample_ctaw2 = QuaterCtToAlignedWordCt(read_sample_ct);
-          sample_uidx_end = raw_sample_ct;
-        } else {
-          sample_uidx_end = FindNth1BitFrom(orig_sample_include, sample_uidx_start + 1, read_sample_ct);
-          ClearBitsNz(sample_uidx_end, raw_sample_ct, sample_include);
+        if (pass_ct > 1) {
+          if (sample_uidx_start) {
+            ClearBitsNz(0, sample_uidx_start, sample_include);
+          }
+          if (pass_idx + 1 == pass_ct) {
+            read_sample_ct = sample_ct - pass_idx * read_sample_ct;
+          } else {
+            sample_uidx_end = FindNth1BitFrom(orig_sample_include, sample_uidx_start + 1, read_sample_ct);
+            ClearBitsNz(sample_uidx_end, raw_sample_ct, sample_include);
+          }
         }
         FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
-        g_sample_include = sample_include;
-        g_sample_include_cumulative_popcounts = sample_include_cumulative_popcounts;
-        g_vmaj_readbuf = vmaj_readbuf;
         g_sample_ct = read_sample_ct;
         if (pass_idx) {
           pgfip->block_base = main_loadbufs[0];
@@ -539,144 +740,133 @@ PglErr ExportIndMajorBed(const uintptr_t* orig_sample_include, const uintptr_t*
         }
         uint32_t parity = 0;
         uint32_t read_block_idx = 0;
-        uint32_t variant_idx = 0;
-        uint32_t is_last_block = 0;
-        uint32_t cur_read_block_size = read_block_size;
-        uint32_t pct = 0;
-        uint32_t next_print_idx = variant_ct / 100;
-        putc_unlocked('\r', stdout);
-        printf("--export ind-major-bed pass %u/%u: loading... 0%%", pass_idx + 1, pass_ct);
-        fflush(stdout);
+        uint32_t next_block_write_ct;
         while (1) {
-          uintptr_t cur_block_write_ct = 0;
-          if (!is_last_block) {
-            while (read_block_idx < read_block_ct_m1) {
-              cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
-              if (cur_block_write_ct) {
-                break;
-              }
-              ++read_block_idx;
-            }
-            if (read_block_idx == read_block_ct_m1) {
-              cur_read_block_size = raw_variant_ct - (read_block_idx * read_block_size);
-              cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(cur_read_block_size));
-            }
-            if (PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_write_ct, pgfip)) {
-              if (variant_idx) {
-                JoinThreads2z(calc_thread_ct, 0, threads);
-                g_cur_block_write_ct = 0;
-                ErrorCleanupThreads2z(TransposeToSmajReadThread, calc_thread_ct, threads);
-              }
-              goto ExportIndMajorBed_ret_THREAD_CREATE_FAIL;
-            }
+          if (read_block_idx == read_block_ct_m1) {
+            next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(raw_variant_ct - read_block_idx * read_block_size));
+            break;
           }
-          if (variant_idx) {
-            JoinThreads2z(calc_thread_ct, is_last_block, threads);
-            reterr = g_error_ret;
-            if (reterr) {
-              if (!is_last_block) {
-                g_cur_block_write_ct = 0;
-                ErrorCleanupThreads2z(TransposeToSmajReadThread, calc_thread_ct, threads);
-              }
-              if (reterr == kPglRetMalformedInput) {
-                logputs("\n");
-                logerrputs("Error: Malformed .pgen file.\n");
-              }
-              goto ExportIndMajorBed_ret_1;
-            }
+          next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
+          if (next_block_write_ct) {
+            break;
           }
-          if (!is_last_block) {
-            g_cur_block_write_ct = cur_block_write_ct;
-            ComputeUidxStartPartition(variant_include, cur_block_write_ct, calc_thread_ct, read_block_idx * read_block_size, g_read_variant_uidx_starts);
-            for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
-              g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
-              g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
-            }
-            is_last_block = (variant_idx + cur_block_write_ct == variant_ct);
-            if (SpawnThreads2z(TransposeToSmajReadThread, calc_thread_ct, is_last_block, threads)) {
-              goto ExportIndMajorBed_ret_THREAD_CREATE_FAIL;
+          ++read_block_idx;
+        }
+        uint32_t variant_idx = 0;
+        while (variant_idx != variant_ct) {
+          uint32_t chunk_variant_ct = 0;
+          reterr = TransposeToSmajLoadChunk(variant_include, raw_variant_ct, variant_ct, read_block_size, capacity_variant_ct, calc_thread_ct, main_loadbufs, threads, pgfip, &parity, &read_block_idx, &next_block_write_ct, &variant_idx, &chunk_variant_ct);
+          if (reterr) {
+            if (reterr == kPglRetMalformedInput) {
+              logputs("\n");
+              logerrputs("Error: Malformed .pgen file.\n");
             }
+            goto ExportIndMajorBed_ret_1;
           }
-          parity = 1 - parity;
-          if (variant_idx == variant_ct) {
-            break;
+          if (is_external) {
+            chunk_variant_cts[chunk_ct++] = chunk_variant_ct;
+          }
+          // 2. Transpose and write.  (Could parallelize some of the transposing
+          //    with the read loop, but since we can't write a single row until
+          //    the read loop is done, and both write speed and write buffer
+          //    space are bottlenecks, that can't be expected to help much.)
+          // Temporary-file rows are padded to a word boundary so the merge can
+          // shift them into place a word at a time.
+          const uintptr_t row_byte_ct = is_external? (QuaterCtToWordCt(chunk_variant_ct) * sizeof(intptr_t)) : QuaterCtToByteCt(chunk_variant_ct);
+          reterr = TransposeToPlink1SmajWriteChunk(read_sample_ct, chunk_variant_ct, sample_batch_size, output_calc_thread_ct, row_byte_ct, threads, chunk_outfile);
+          if (reterr) {
+            goto ExportIndMajorBed_ret_1;
           }
-          if (variant_idx >= next_print_idx) {
-            if (pct > 10) {
+          // with a temporary file, transposition is the first half of the work
+          const uint32_t new_pct = ((pass_idx * S_CAST(uint64_t, variant_ct) + variant_idx) * (100LLU >> is_external)) / (pass_ct * S_CAST(uint64_t, variant_ct));
+          if ((new_pct > pct) && (new_pct < 100)) {
+            if (pct >= 10) {
               putc_unlocked('\b', stdout);
             }
-            pct = (variant_idx * 100LLU) / variant_ct;
-            printf("\b\b%u%%", pct++);
+            pct = new_pct;
+            printf("\b\b%u%%", pct);
             fflush(stdout);
-            next_print_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
           }
-
-          ++read_block_idx;
-          variant_idx += cur_block_write_ct;
-          pgfip->block_base = main_loadbufs[parity];
-        }
-        // 2. Transpose and write.  (Could parallelize some of the transposing
-        //    with the read loop, but since we can't write a single row until
-        //    the read loop is done, and both write speed and write buffer
-        //    space are bottlenecks, that can't be expected to help much.)
-        g_sample_batch_size = sample_batch_size;
-        parity = 0;
-        is_last_block = 0;
-        if (pct > 10) {
-          fputs("\b \b", stdout);
         }
-        fputs("\b\b\b\b\b\b\b\b\b\b\b\b\bwriting... 0%", stdout);
-        fflush(stdout);
-        pct = 0;
-        uint32_t flush_sample_idx = 0;
-        uint32_t flush_sample_idx_end = 0;
-        next_print_idx = read_sample_ct / 100;
-        while (1) {
-          if (!is_last_block) {
-            is_last_block = (flush_sample_idx_end + sample_batch_size >= read_sample_ct);
-            if (is_last_block) {
-              g_sample_batch_size = read_sample_ct - flush_sample_idx_end;
-            }
-            if (SpawnThreads2z(TransposeToPlink1SmajWriteThread, output_calc_thread_ct, is_last_block, threads)) {
-              goto ExportIndMajorBed_ret_THREAD_CREATE_FAIL;
-            }
-          }
-          if (flush_sample_idx_end) {
-            uintptr_t* smaj_writebuf_iter = g_smaj_writebufs[1 - parity];
-            for (; flush_sample_idx < flush_sample_idx_end; ++flush_sample_idx) {
-              fwrite_unlocked(smaj_writebuf_iter, variant_ct4, 1, outfile);
-              smaj_writebuf_iter = &(smaj_writebuf_iter[variant_ctaclw2]);
+        sample_uidx_start = sample_uidx_end;
+      }
+      if (is_external) {
+        if (fclose_null(&smaj_tmpfile)) {
+          goto ExportIndMajorBed_ret_WRITE_FAIL;
+        }
+        // 3. Merge tiles in sample order.
+        BigstackReset(chunk_alloc_base);
+        if (fopen_checked(smaj_tmpname, FOPEN_RB, &smaj_tmpfile)) {
+          goto ExportIndMajorBed_ret_OPEN_FAIL;
+        }
+        const uintptr_t out_row_word_ct = QuaterCtToWordCt(variant_ct) + 1;
+        const uintptr_t tile_row_word_ct = QuaterCtToWordCt(capacity_variant_ct);
+        const uintptr_t merge_sample_batch_size_raw = bigstack_left() / ((out_row_word_ct + tile_row_word_ct) * sizeof(intptr_t));
+        if (!merge_sample_batch_size_raw) {
+          goto ExportIndMajorBed_ret_NOMEM;
+        }
+        const uint32_t merge_sample_batch_size = MINV(merge_sample_batch_size_raw, sample_ct);
+        uintptr_t* out_rows;
+        uintptr_t* tile_rows;
+        if (bigstack_alloc_w(out_row_word_ct * merge_sample_batch_size, &out_rows) ||
+            bigstack_alloc_w(tile_row_word_ct * merge_sample_batch_size, &tile_rows)) {
+          goto ExportIndMajorBed_ret_NOMEM;
+        }
+        const uintptr_t variant_ct4 = QuaterCtToByteCt(variant_ct);
+        for (uint32_t sample_idx_start = 0; sample_idx_start < sample_ct; ) {
+          const uint32_t cur_batch_size = MINV(merge_sample_batch_size, sample_ct - sample_idx_start);
+          ZeroWArr(out_row_word_ct * cur_batch_size, out_rows);
+          uint64_t chunk_fpos = 0;
+          uint32_t chunk_vidx_start = 0;
+          for (uint32_t chunk_idx = 0; chunk_idx < chunk_ct; ++chunk_idx) {
+            const uint32_t chunk_variant_ct = chunk_variant_cts[chunk_idx];
+            const uintptr_t cur_tile_row_word_ct = QuaterCtToWordCt(chunk_variant_ct);
+            const uintptr_t cur_tile_row_byte_ct = cur_tile_row_word_ct * sizeof(intptr_t);
+            if (fseeko(smaj_tmpfile, chunk_fpos + sample_idx_start * S_CAST(uint64_t, cur_tile_row_byte_ct), SEEK_SET)) {
+              goto ExportIndMajorBed_ret_READ_FAIL;
             }
-            if (flush_sample_idx_end == read_sample_ct) {
-              break;
+            if (fread_checked(tile_rows, cur_batch_size * cur_tile_row_byte_ct, smaj_tmpfile)) {
+              goto ExportIndMajorBed_ret_READ_FAIL;
             }
-            if (flush_sample_idx_end >= next_print_idx) {
-              if (pct > 10) {
-                putc_unlocked('\b', stdout);
-              }
-              pct = (flush_sample_idx_end * 100LLU) / read_sample_ct;
-              printf("\b\b%u%%", pct++);
-              fflush(stdout);
-              next_print_idx = (pct * S_CAST(uint64_t, read_sample_ct)) / 100;
+            const uintptr_t* tile_row_iter = tile_rows;
+            uintptr_t* out_row_iter = out_rows;
+            for (uint32_t uii = 0; uii < cur_batch_size; ++uii) {
+              AppendQuaterarrUnsafe(tile_row_iter, chunk_variant_ct, chunk_vidx_start, out_row_iter);
+              tile_row_iter = &(tile_row_iter[cur_tile_row_word_ct]);
+              out_row_iter = &(out_row_iter[out_row_word_ct]);
             }
+            chunk_fpos += sample_ct * S_CAST(uint64_t, cur_tile_row_byte_ct);
+            chunk_vidx_start += chunk_variant_ct;
+          }
+          const uintptr_t* out_row_iter = out_rows;
+          for (uint32_t uii = 0; uii < cur_batch_size; ++uii) {
+            fwrite_unlocked(out_row_iter, variant_ct4, 1, outfile);
+            out_row_iter = &(out_row_iter[out_row_word_ct]);
           }
-          JoinThreads2z(output_calc_thread_ct, is_last_block, threads);
           if (ferror_unlocked(outfile)) {
-            // may as well put this check when there are no threads to clean up
             goto ExportIndMajorBed_ret_WRITE_FAIL;
           }
-          parity = 1 - parity;
-          flush_sample_idx_end += sample_batch_size;
-          if (flush_sample_idx_end > read_sample_ct) {
-            flush_sample_idx_end = read_sample_ct;
+          sample_idx_start += cur_batch_size;
+          const uint32_t new_pct = 50 + (sample_idx_start * 50LLU) / sample_ct;
+          if ((new_pct > pct) && (new_pct < 100)) {
+            if (pct >= 10) {
+              putc_unlocked('\b', stdout);
+            }
+            pct = new_pct;
+            printf("\b\b%u%%", pct);
+            fflush(stdout);
           }
         }
-        if (pct > 10) {
-          fputs("\b \b", stdout);
-        }
-        sample_uidx_start = sample_uidx_end;
+        fclose_cond(smaj_tmpfile);
+        smaj_tmpfile = nullptr;
+        unlink(smaj_tmpname);
+        smaj_tmpname = nullptr;
       }
-      fputs("\b\bdone.\n", stdout);
+      if (pct >= 10) {
+        putc_unlocked('\b', stdout);
+      }
+      fputs("\b\b", stdout);
+      logputs("done.\n");
     }
     if (fclose_null(&outfile)) {
       goto ExportIndMajorBed_ret_WRITE_FAIL;
@@ -690,17 +880,22 @@ PglErr ExportIndMajorBed(const uintptr_t* orig_sample_include, const uintptr_t*
   ExportIndMajorBed_ret_OPEN_FAIL:
     reterr = kPglRetOpenFail;
     break;
+  ExportIndMajorBed_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
   ExportIndMajorBed_ret_WRITE_FAIL:
     reterr = kPglRetWriteFail;
     break;
-  ExportIndMajorBed_ret_THREAD_CREATE_FAIL:
-    reterr = kPglRetThreadCreateFail;
-    break;
   }
  ExportIndMajorBed_ret_1:
   fclose_cond(outfile);
+  if (smaj_tmpname) {
+    fclose_cond(smaj_tmpfile);
+    unlink(smaj_tmpname);
+  }
   pgfip->block_base = nullptr;
   BigstackReset(bigstack_mark);
+  BigstackEndReset(bigstack_end_mark);
   return reterr;
 }
 
@@ -1394,6 +1589,7 @@ PglErr ExportOxHapslegend(const uintptr_t* sample_include, const uint32_t* sampl
 // more multithread globals
 static uint16_t** g_bgen_geno_bufs = nullptr;  // per-thread
 static struct libdeflate_compressor** g_libdeflate_compressors = nullptr;
+static ZSTD_CCtx** g_zst_cctxs = nullptr;
 
 static uintptr_t* g_sex_male_collapsed = nullptr;
 static uintptr_t** g_missing_acc1 = nullptr;
@@ -2183,6 +2379,9 @@ THREAD_FUNC_DECL ExportBgen13Thread(void* arg) {
   // Note that we may write up to 12 bytes past the end
   unsigned char* uncompressed_bgen_geno_buf = g_thread_wkspaces[tidx];
   struct libdeflate_compressor* compressor = g_libdeflate_compressors? g_libdeflate_compressors[tidx] : nullptr;
+  // reused across variants; ZSTD_compress() would allocate and free a fresh
+  // context for every genotype block
+  ZSTD_CCtx* cctx = g_zst_cctxs? g_zst_cctxs[tidx] : nullptr;
   const uint32_t zst_level = g_zst_level;
   const uintptr_t* variant_include = g_variant_include;
   const ChrInfo* cip = g_cip;
@@ -2766,7 +2965,7 @@ THREAD_FUNC_DECL ExportBgen13Thread(void* arg) {
           break;
         }
       } else {
-        compressed_bytect = ZSTD_compress(writebuf_iter, bgen_compressed_buf_max, uncompressed_bgen_geno_buf, uncompressed_bytect, zst_level);
+        compressed_bytect = ZSTD_compressCCtx(cctx, writebuf_iter, bgen_compressed_buf_max, uncompressed_bgen_geno_buf, uncompressed_bytect, zst_level);
         if (ZSTD_isError(compressed_bytect)) {
           // is this actually possible?
           g_error_ret = kPglRetNomem;
@@ -2891,8 +3090,14 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
       goto ExportBgen13_ret_1;
     }
     const uint32_t use_zstd_compression = !(exportf_flags & kfExportfBgen12);
+    g_zst_cctxs = nullptr;
     if (use_zstd_compression) {
       g_libdeflate_compressors = nullptr;
+      g_zst_cctxs = S_CAST(ZSTD_CCtx**, bigstack_alloc(max_thread_ct * sizeof(intptr_t)));
+      if (!g_zst_cctxs) {
+        goto ExportBgen13_ret_NOMEM;
+      }
+      ZeroPtrArr(max_thread_ct, g_zst_cctxs);
     } else {
       g_libdeflate_compressors = S_CAST(struct libdeflate_compressor**, bigstack_alloc(max_thread_ct * sizeof(intptr_t)));
       if (!g_libdeflate_compressors) {
@@ -2986,6 +3191,14 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
     // compression mode (1 + use_zstd_compression), layout=2
     writebuf[20] = 9 + use_zstd_compression;
     unsigned char* writebuf_flush = &(writebuf[kMaxMediumLine]);
+    // bgen-index: file offset of each variant record, plus the final file
+    // size, so record i occupies [variant_fposes[i], variant_fposes[i + 1]).
+    uint64_t* variant_fposes = nullptr;
+    if (exportf_flags & kfExportfBgenIndex) {
+      if (bigstack_alloc_u64(variant_ct + 1, &variant_fposes)) {
+        goto ExportBgen13_ret_NOMEM;
+      }
+    }
     // always save sample IDs...
     char* exported_sample_ids;
     uint32_t* exported_id_htable;
@@ -3002,6 +3215,8 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
       sample_id_block_len += strlen(exported_sample_ids_iter);
       exported_sample_ids_iter = &(exported_sample_ids_iter[max_exported_sample_id_blen]);
     }
+    // offset of the first variant record
+    uint64_t cur_fpos = 24;
 #ifdef __LP64__
     if (sample_id_block_len > 0xffffffffU - 20) {
       // ...unless combined sample ID length is actually greater than 4 GB, in
@@ -3011,6 +3226,7 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
     } else {
 #endif
       uint32_t initial_bgen_offset = sample_id_block_len + 20;
+      cur_fpos += sample_id_block_len;
       memcpy(writebuf, &initial_bgen_offset, 4);
       *R_CAST(uint32_t*, write_iter) = sample_id_block_len;
       write_iter = &(write_iter[4]);
@@ -3100,6 +3316,13 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
           goto ExportBgen13_ret_NOMEM;
         }
       }
+    } else {
+      for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+        g_zst_cctxs[tidx] = ZSTD_createCCtx();
+        if (!g_zst_cctxs[tidx]) {
+          goto ExportBgen13_ret_NOMEM;
+        }
+      }
     }
 
     // Main workflow:
@@ -3124,6 +3347,7 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
 
     uint32_t prev_block_write_ct = 0;
     uint32_t variant_idx = 0;
+    uint32_t write_variant_uidx_out = 0;
     uint32_t cur_read_block_size = read_block_size;
     uint32_t pct = 0;
     uint32_t next_print_variant_idx = variant_ct / 100;
@@ -3192,6 +3416,9 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
           }
           const char* cur_variant_id = variant_ids[write_variant_uidx];
           const uint32_t id_slen = strlen(cur_variant_id);
+          if (variant_fposes) {
+            variant_fposes[write_variant_uidx_out++] = cur_fpos;
+          }
           // low 16 bits = null "SNP ID"
           *R_CAST(uint32_t*, write_iter) = id_slen << 16;
           write_iter = &(write_iter[4]);
@@ -3235,6 +3462,8 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
           write_iter = memcpyua(write_iter, variant_bytect_iter, 8);
           const uint32_t cur_compressed_bytect = *variant_bytect_iter - 4;
           variant_bytect_iter = &(variant_bytect_iter[2]);
+          // 4 + 2 + 4 + 2 + 4 + 4 + 4 + 4 fixed-width fields
+          cur_fpos += 28 + id_slen + chr_slen + strlen(first_allele) + allele_slen + cur_compressed_bytect;
           if (fwrite_uflush2(writebuf_flush, outfile, &write_iter)) {
             goto ExportBgen13_ret_WRITE_FAIL;
           }
@@ -3271,6 +3500,20 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
     }
     fputs("\b\b", stdout);
     logprintf("done.\n");
+    if (variant_fposes) {
+      variant_fposes[variant_ct] = cur_fpos;
+      const uint32_t outname_slen = strlen(outname);
+      char* idxname;
+      if (bigstack_alloc_c(outname_slen + 5, &idxname)) {
+        goto ExportBgen13_ret_NOMEM;
+      }
+      snprintf(memcpya(idxname, outname, outname_slen), 5, ".idx");
+      reterr = WriteBgenIdx(idxname, variant_fposes, variant_ct);
+      if (reterr) {
+        goto ExportBgen13_ret_1;
+      }
+      logprintfww("--export bgen-index: Variant offset index written to %s .\n", idxname);
+    }
     const uint32_t sample_ctav = acc1_vec_ct * kBitsPerVec;
     const uintptr_t acc32_offset = acc1_vec_ct * (13 * k1LU * kWordsPerVec);
     uint32_t* scrambled_missing_cts = R_CAST(uint32_t*, &(g_missing_acc1[0][acc32_offset]));
@@ -3316,6 +3559,15 @@ PglErr ExportBgen13(const char* outname, const uintptr_t* sample_include, uint32
     }
     g_libdeflate_compressors = nullptr;
   }
+  if (g_zst_cctxs) {
+    for (uint32_t tidx = 0; tidx < max_thread_ct; ++tidx) {
+      if (!g_zst_cctxs[tidx]) {
+        break;
+      }
+      ZSTD_freeCCtx(g_zst_cctxs[tidx]);
+    }
+    g_zst_cctxs = nullptr;
+  }
   fclose_cond(outfile);
   BigstackReset(bigstack_mark);
   return reterr;
@@ -3545,42 +3797,701 @@ char* HaploidDosagePrint(uint32_t rawval, char* start) {
 }
 
 
-#ifdef __arm__
-#  error "Unaligned accesses in ExportVcf()."
-#endif
-PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include_cumulative_popcounts, const SampleIdInfo* siip, const uintptr_t* sex_male_collapsed, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, ExportfFlags exportf_flags, IdpasteFlags exportf_id_paste, char exportf_id_delim, char* xheader, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
-  unsigned char* bigstack_mark = g_bigstack_base;
-  FILE* outfile = nullptr;
-  BGZF* bgz_outfile = nullptr;
-  PglErr reterr = kPglRetSuccess;
-  ReadLineStream pvar_reload_rls;
-  PreinitRLstream(&pvar_reload_rls);
-  {
-    if (!(exportf_flags & kfExportfBgz)) {
-      snprintf(outname_end, kMaxOutfnameExtBlen, ".vcf");
-      if (fopen_checked(outname, FOPEN_WB, &outfile)) {
-        goto ExportVcf_ret_OPEN_FAIL;
+// Compresses src[0..slen) into a single BGZF block at dst, which must have
+// space for BGZF_MAX_BLOCK_SIZE bytes.  slen must be in [1, BGZF_BLOCK_SIZE].
+// Returns the size of the block, or 0 on failure.
+static uint32_t BgzfCompressBlock(const unsigned char* src, uint32_t slen, struct libdeflate_compressor* compressor, unsigned char* dst) {
+  // 18-byte header, 8-byte footer
+  const uintptr_t deflate_blen = libdeflate_deflate_compress(compressor, src, slen, &(dst[18]), BGZF_MAX_BLOCK_SIZE - 26);
+  if (!deflate_blen) {
+    return 0;
+  }
+  const uint32_t block_blen = deflate_blen + 26;
+  // gzip header with the 'BC' extra subfield; BSIZE (block size - 1) is
+  // filled in below
+  memcpy(dst, "\37\213\10\4\0\0\0\0\0\377\6\0BC\2\0", 16);
+  const uint16_t bsize = block_blen - 1;
+  memcpy(&(dst[16]), &bsize, 2);
+  const uint32_t crc = libdeflate_crc32(0, src, slen);
+  memcpy(&(dst[block_blen - 8]), &crc, 4);
+  memcpy(&(dst[block_blen - 4]), &slen, 4);
+  return block_blen;
+}
+
+// Writes buf[0..len) to outfile, as a sequence of BGZF blocks when compressor
+// is non-null.
+static BoolErr BgzfFlexwriteFlush(const char* buf, uintptr_t len, struct libdeflate_compressor* compressor, unsigned char* bgzf_blockbuf, FILE* outfile) {
+  if (!compressor) {
+    return fwrite_checked(buf, len, outfile);
+  }
+  const unsigned char* read_iter = R_CAST(const unsigned char*, buf);
+  while (len) {
+    const uint32_t cur_slen = MINV(len, BGZF_BLOCK_SIZE);
+    const uint32_t block_blen = BgzfCompressBlock(read_iter, cur_slen, compressor, bgzf_blockbuf);
+    if ((!block_blen) || fwrite_checked(bgzf_blockbuf, block_blen, outfile)) {
+      return 1;
+    }
+    read_iter = &(read_iter[cur_slen]);
+    len -= cur_slen;
+  }
+  return 0;
+}
+
+// assumes buf_flush - buf = kMaxMediumLine
+static inline BoolErr BgzfFlexwriteCk(char* buf_flush, struct libdeflate_compressor* compressor, unsigned char* bgzf_blockbuf, FILE* outfile, char** write_iter_ptr) {
+  if ((*write_iter_ptr) < buf_flush) {
+    return 0;
+  }
+  char* buf = &(buf_flush[-S_CAST(int32_t, kMaxMediumLine)]);
+  char* buf_end = *write_iter_ptr;
+  *write_iter_ptr = buf;
+  return BgzfFlexwriteFlush(buf, buf_end - buf, compressor, bgzf_blockbuf, outfile);
+}
+
+static const uintptr_t* g_vcf_sex_male_collapsed = nullptr;
+static uintptr_t** g_vcf_prev_phaseds = nullptr;
+static char* g_vcf_prefixbufs[2] = {nullptr, nullptr};
+static char** g_vcf_prefix_ends[2] = {nullptr, nullptr};
+static char* g_vcf_linebufs[2] = {nullptr, nullptr};
+static char** g_vcf_line_ends[2] = {nullptr, nullptr};
+static unsigned char* g_vcf_bgzf_bufs[2] = {nullptr, nullptr};
+static uintptr_t* g_vcf_bgzf_blens[2] = {nullptr, nullptr};
+static uint64_t* g_vcf_line_end_voffsets[2] = {nullptr, nullptr};
+static struct libdeflate_compressor** g_vcf_compressors = nullptr;
+static uintptr_t g_vcf_thread_linebuf_blen = 0;
+static uintptr_t g_vcf_thread_bgzf_blen = 0;
+static uint32_t g_vcf_phase_prepass = 0;
+static uint32_t g_vcf_write_ds = 0;
+static uint32_t g_vcf_write_gp_ds_or_hds = 0;
+static uint32_t g_vcf_dosage_force = 0;
+
+// Renders each line of the current block: the CHROM..INFO columns are copied
+// from g_vcf_prefixbufs[parity] (filled in by the main thread), followed by
+// the FORMAT and genotype columns.  Each thread writes its contiguous slice of
+// the block to its own region of g_vcf_linebufs[parity], recording per-variant
+// end pointers in g_vcf_line_ends[parity].
+//
+// For bgzipped output, each thread then compresses its region into a sequence
+// of BGZF blocks in g_vcf_bgzf_bufs[parity], and saves each line's end
+// position as a virtual offset relative to the start of its compressed region
+// (for the index).  The main thread just has to write the regions in order.
+//
+// Since homozygous calls are rendered as phased iff the last heterozygous call
+// for the same sample was phased, a thread's initial per-sample phase state
+// depends on all preceding variants.  When phased data is present and there's
+// more than one thread, each block is therefore processed in two passes: in
+// the first (g_vcf_phase_prepass set), each thread just records which samples
+// it saw a heterozygous call for, and whether the last such call was phased;
+// the main thread then chains these to compute each thread's starting state
+// before the rendering pass.
+THREAD_FUNC_DECL VcfGenoRenderThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  PgenReader* pgrp = g_pgr_ptrs[tidx];
+  uintptr_t* genovec = g_genovecs[tidx];
+  uintptr_t* phasepresent = nullptr;
+  uintptr_t* phaseinfo = nullptr;
+  uintptr_t* prev_phased = nullptr;
+  uintptr_t* het_seen = nullptr;
+  uintptr_t* last_het_phased = nullptr;
+  const uint32_t sample_ct = g_sample_ct;
+  const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
+  const uint32_t sample_ctl2 = QuaterCtToWordCt(sample_ct);
+  const uint32_t sample_ctl2_m1 = sample_ctl2 - 1;
+  if (g_phasepresents) {
+    phasepresent = g_phasepresents[tidx];
+    phaseinfo = g_phaseinfos[tidx];
+    prev_phased = g_vcf_prev_phaseds[tidx];
+    het_seen = &(prev_phased[sample_ctl]);
+    last_het_phased = &(het_seen[sample_ctl]);
+  }
+  uintptr_t* dosage_present = g_dosage_presents? g_dosage_presents[tidx] : nullptr;
+  Dosage* dosage_main = dosage_present? g_dosage_mains[tidx] : nullptr;
+  uintptr_t* dphase_present = g_dphase_presents? g_dphase_presents[tidx] : nullptr;
+  SDosage* dphase_delta = dphase_present? g_dphase_deltas[tidx] : nullptr;
+  const uintptr_t* variant_include = g_variant_include;
+  const ChrInfo* cip = g_cip;
+  const uintptr_t* sample_include = g_sample_include;
+  const uint32_t* sample_include_cumulative_popcounts = g_sample_include_cumulative_popcounts;
+  const uintptr_t* sex_male_collapsed = g_vcf_sex_male_collapsed;
+  const AltAlleleCt* refalt1_select = g_refalt1_select;
+  const uintptr_t thread_linebuf_blen = g_vcf_thread_linebuf_blen;
+  const uintptr_t thread_bgzf_blen = g_vcf_thread_bgzf_blen;
+  struct libdeflate_compressor* compressor = g_vcf_compressors? g_vcf_compressors[tidx] : nullptr;
+  const uint32_t calc_thread_ct = g_calc_thread_ct;
+  const uint32_t some_phased = (phasepresent != nullptr);
+  const uint32_t write_ds = g_vcf_write_ds;
+  const uint32_t write_gp_ds_or_hds = g_vcf_write_gp_ds_or_hds;
+  const uint32_t dosage_force = g_vcf_dosage_force;
+
+  // assumes little-endian
+  uint32_t basic_genotext[4];
+  basic_genotext[0] = 0x302f3009;  // \t0/0
+  basic_genotext[1] = 0x312f3009;  // \t0/1
+  basic_genotext[2] = 0x312f3109;  // \t1/1
+  basic_genotext[3] = 0x2e2f2e09;  // \t./.
+  char haploid_genotext[4][4];
+  uint32_t haploid_genotext_blen[8];  // 4..7 = male chrX
+  memcpy(haploid_genotext[0], "\t0/0", 4);
+  memcpy(haploid_genotext[1], "\t0/1", 4);
+  memcpy(haploid_genotext[2], "\t1/1", 4);
+  memcpy(haploid_genotext[3], "\t./.", 4);
+  haploid_genotext_blen[1] = 4;
+  haploid_genotext_blen[4] = 2;
+  haploid_genotext_blen[5] = 4;
+  haploid_genotext_blen[6] = 2;
+  haploid_genotext_blen[7] = 2;
+  // don't bother exporting GP for hardcalls
+  // usually don't bother for DS, but DS-force is an exception
+  char dosage_inttext[16];  // 4..7 = haploid, 5 should never be looked up
+  memcpy(dosage_inttext, ":0:1:2:.:0:.:1:.", 16);
+  uint32_t chr_fo_idx = UINT32_MAX;
+  uint32_t chr_end = 0;
+  uint32_t is_x = 0;
+  uint32_t is_haploid = 0;  // includes chrX and chrY
+  uint32_t alt1_allele_idx = 1;
+  uint32_t parity = 0;
+  while (1) {
+    const uint32_t is_last_block = g_is_last_thread_block;
+    const uintptr_t cur_block_write_ct = g_cur_block_write_ct;
+    uint32_t write_idx = (tidx * cur_block_write_ct) / calc_thread_ct;
+    const uint32_t write_idx_end = ((tidx + 1) * cur_block_write_ct) / calc_thread_ct;
+    uint32_t variant_uidx = g_read_variant_uidx_starts[tidx];
+    if (g_vcf_phase_prepass) {
+      ZeroWArr(sample_ctl, het_seen);
+      ZeroWArr(sample_ctl, last_het_phased);
+      Halfword* het_seen_alias = R_CAST(Halfword*, het_seen);
+      Halfword* last_het_phased_alias = R_CAST(Halfword*, last_het_phased);
+      for (; write_idx < write_idx_end; ++write_idx, ++variant_uidx) {
+        MovU32To1Bit(variant_include, &variant_uidx);
+        uint32_t at_least_one_phase_present;
+        PglErr reterr = PgrGetP(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, genovec, phasepresent, phaseinfo, &at_least_one_phase_present);
+        if (reterr) {
+          g_error_ret = reterr;
+          break;
+        }
+        const Halfword* phasepresent_alias = R_CAST(const Halfword*, phasepresent);
+        for (uint32_t widx = 0; widx < sample_ctl2; ++widx) {
+          const uintptr_t geno_word = genovec[widx];
+          const uint32_t het_hw = PackWordToHalfword(geno_word & (~(geno_word >> 1)) & kMask5555);
+          if (het_hw) {
+            het_seen_alias[widx] |= het_hw;
+            const uint32_t phased_het_hw = at_least_one_phase_present? (het_hw & phasepresent_alias[widx]) : 0;
+            last_het_phased_alias[widx] = (last_het_phased_alias[widx] & (~het_hw)) | phased_het_hw;
+          }
+        }
       }
     } else {
-      snprintf(outname_end, kMaxOutfnameExtBlen, ".vcf.gz");
-      bgz_outfile = bgzf_open(outname, "w");
-      if (!bgz_outfile) {
-        goto ExportVcf_ret_OPEN_FAIL;
-      }
-#ifndef _WIN32
-      if (max_thread_ct > 1) {
-        const uint32_t compressor_thread_ct = max_thread_ct - (max_thread_ct > 4);
-        if (bgzf_mt(bgz_outfile, MINV(128, compressor_thread_ct), 128)) {
-          goto ExportVcf_ret_NOMEM;
+      const uint32_t write_idx_start = write_idx;
+      char* linebuf = &(g_vcf_linebufs[parity][tidx * thread_linebuf_blen]);
+      char* write_iter = linebuf;
+      char* const* prefix_ends = g_vcf_prefix_ends[parity];
+      const char* prefix_start = write_idx? prefix_ends[write_idx - 1] : g_vcf_prefixbufs[parity];
+      char** line_ends_iter = &(g_vcf_line_ends[parity][write_idx]);
+      for (; write_idx < write_idx_end; ++write_idx, ++variant_uidx) {
+        MovU32To1Bit(variant_include, &variant_uidx);
+        // CHROM..INFO
+        const char* prefix_end = prefix_ends[write_idx];
+        write_iter = memcpya(write_iter, prefix_start, prefix_end - prefix_start);
+        prefix_start = prefix_end;
+        if (variant_uidx >= chr_end) {
+          do {
+            ++chr_fo_idx;
+            chr_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+          } while (variant_uidx >= chr_end);
+          const uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
+          is_x = (chr_idx == cip->xymt_codes[kChrOffsetX]);
+          is_haploid = IsSet(cip->haploid_mask, chr_idx);
+          if (is_haploid) {
+            if (is_x) {
+              haploid_genotext_blen[0] = 4;
+              haploid_genotext_blen[2] = 4;
+              haploid_genotext_blen[3] = 4;
+            } else {
+              haploid_genotext_blen[0] = 2;
+              haploid_genotext_blen[2] = 2;
+              haploid_genotext_blen[3] = 2;
+            }
+          }
         }
-      }
+        if (refalt1_select) {
+          alt1_allele_idx = refalt1_select[variant_uidx * 2 + 1];
+          // this logic only works in the biallelic case
+          if (!is_haploid) {
+            if (alt1_allele_idx) {
+              basic_genotext[0] = 0x302f3009;
+              basic_genotext[2] = 0x312f3109;
+            } else {
+              basic_genotext[0] = 0x312f3109;
+              basic_genotext[2] = 0x302f3009;
+            }
+          } else {
+            if (alt1_allele_idx) {
+              memcpy(haploid_genotext[0], "\t0/0", 4);
+              memcpy(haploid_genotext[2], "\t1/1", 4);
+            } else {
+              memcpy(haploid_genotext[0], "\t1/1", 4);
+              memcpy(haploid_genotext[2], "\t0/0", 4);
+            }
+          }
+          if (alt1_allele_idx) {
+            memcpy(dosage_inttext, ":0:1:2:.:0:.:1:.", 16);
+          } else {
+            memcpy(dosage_inttext, ":2:1:0:.:1:.:0:.", 16);
+          }
+        }
+        // FORMAT
+        write_iter = memcpyl3a(write_iter, "\tGT");
+
+        PglErr reterr;
+        uint32_t dosage_ct = 0;
+        uint32_t dphase_ct = 0;
+        uint32_t inner_loop_last = kBitsPerWordD2 - 1;
+        uint32_t widx = 0;
+        if (!some_phased) {
+          // biallelic, nothing phased in entire file
+          if (!write_gp_ds_or_hds) {
+            reterr = PgrGet(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, genovec);
+          } else {
+            reterr = PgrGetD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          }
+          if (reterr) {
+            g_error_ret = reterr;
+            break;
+          }
+          if ((!dosage_ct) && (!dosage_force)) {
+            if (!is_haploid) {
+              // always 4 bytes wide, exploit that
+              uint32_t* write_iter_ui_alias = R_CAST(uint32_t*, write_iter);
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  *write_iter_ui_alias++ = basic_genotext[genovec_word & 3];
+                  genovec_word >>= 2;
+                }
+                ++widx;
+              }
+              write_iter = R_CAST(char*, write_iter_ui_alias);
+            } else {
+              // chrX: male homozygous/missing calls use only one character + tab
+              // other haploid/MT: this is true for nonmales too
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t sex_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  const uint32_t cur_is_male = sex_male_hw & 1;
+                  write_iter = memcpya(write_iter, haploid_genotext[cur_geno], haploid_genotext_blen[cur_geno + cur_is_male * 4]);
+                  genovec_word >>= 2;
+                  sex_male_hw >>= 1;
+                }
+                ++widx;
+              }
+            }
+          } else {
+            // some dosages present, or DS-force
+            if (write_ds) {
+              write_iter = memcpyl3a(write_iter, ":DS");
+              if (!dosage_ct) {
+                // DS-force, need to clear this
+                ZeroWArr(sample_ctl, dosage_present);
+              }
+            } else {
+              write_iter = memcpyl3a(write_iter, ":GP");
+            }
+            if (!alt1_allele_idx) {
+              BiallelicDosage16Invert(dosage_ct, dosage_main);
+            }
+            Dosage* dosage_main_iter = dosage_main;
+            if (!is_haploid) {
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  write_iter = memcpya(write_iter, &(basic_genotext[cur_geno]), 4);
+                  if (dosage_present_hw & 1) {
+                    *write_iter++ = ':';
+                    const uint32_t dosage_int = *dosage_main_iter++;
+                    write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
+                  } else if (dosage_force) {
+                    write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
+                  }
+                  genovec_word >>= 2;
+                  dosage_present_hw >>= 1;
+                }
+                ++widx;
+              }
+            } else {
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t sex_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
+                uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  const uint32_t cur_is_male = sex_male_hw & 1;
+                  const uint32_t cur_genotext_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
+                  write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_genotext_blen);
+                  if (dosage_present_hw & 1) {
+                    *write_iter++ = ':';
+                    uint32_t dosage_int = *dosage_main_iter++;
+                    if (cur_genotext_blen == 2) {
+                      if (write_ds) {
+                        write_iter = HaploidDosagePrint(dosage_int, write_iter);
+                      } else {
+                        write_iter = HaploidDosagePrint(kDosageMax - dosage_int, write_iter);
+                        *write_iter++ = ',';
+                        write_iter = HaploidDosagePrint(dosage_int, write_iter);
+                      }
+                    } else {
+                      // het haploid, or female X
+                      write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
+                    }
+                  } else if (dosage_force) {
+                    write_iter = memcpya(write_iter, &(dosage_inttext[2 * cur_geno + 16 - 4 * cur_genotext_blen]), 2);
+                  }
+                  genovec_word >>= 2;
+                  sex_male_hw >>= 1;
+                  dosage_present_hw >>= 1;
+                }
+                ++widx;
+              }
+            }
+          }
+        } else {
+          // biallelic, phased
+          uint32_t at_least_one_phase_present;
+          if (!write_gp_ds_or_hds) {
+            reterr = PgrGetP(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, genovec, phasepresent, phaseinfo, &at_least_one_phase_present);
+          } else {
+            reterr = PgrGetDp(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, pgrp, genovec, phasepresent, phaseinfo, &at_least_one_phase_present, dosage_present, dosage_main, &dosage_ct, dphase_present, dphase_delta, &dphase_ct);
+          }
+          if (reterr) {
+            g_error_ret = reterr;
+            break;
+          }
+          at_least_one_phase_present = (at_least_one_phase_present != 0);
+          if ((!dosage_ct) && (!dosage_force)) {
+            if (!is_haploid) {
+              uint32_t* write_iter_ui_alias = R_CAST(uint32_t*, write_iter);
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
+
+                // zero this out if phasepresent_ct == 0
+                const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
+
+                const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uintptr_t cur_geno = genovec_word & 3;
+
+                  // usually "\t0/0", etc.
+                  uint32_t cur_basic_genotext = basic_genotext[cur_geno];
+                  if (cur_geno == 1) {
+                    const uint32_t cur_shift = (1U << sample_idx_lowbits);
+                    if (phasepresent_halfword & cur_shift) {
+                      prev_phased_halfword |= cur_shift;
+                      if (phaseinfo_halfword & cur_shift) {
+                        cur_basic_genotext ^= 0x1000100;  // 0|1 -> 1|0
+                      }
+                    } else {
+                      prev_phased_halfword &= ~cur_shift;
+                    }
+                  }
+                  // '/' = ascii 47, '|' = ascii 124
+                  *write_iter_ui_alias++ = cur_basic_genotext + 0x4d0000 * ((prev_phased_halfword >> sample_idx_lowbits) & 1);
+                  genovec_word >>= 2;
+                }
+                R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
+                ++widx;
+              }
+              write_iter = R_CAST(char*, write_iter_ui_alias);
+            } else {
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t is_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
+                uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
+
+                // zero this out if phasepresent_ct == 0
+                const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
+
+                const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  const uint32_t cur_is_male = is_male_hw & 1;
+                  const uint32_t cur_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
+                  write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_blen);
+                  if (cur_blen == 4) {
+                    if (cur_geno == 1) {
+                      // a bit redundant with how is_male_hw is handled, but
+                      // updating this on every loop iteration doesn't seem better
+                      const uint32_t cur_shift = (1U << sample_idx_lowbits);
+                      if (phasepresent_halfword & cur_shift) {
+                        prev_phased_halfword |= cur_shift;
+                        if (phaseinfo_halfword & cur_shift) {
+                          memcpy(&(write_iter[-4]), "\t1|0", 4);
+                        } else {
+                          write_iter[-2] = '|';
+                        }
+                      } else {
+                        prev_phased_halfword &= ~cur_shift;
+                      }
+                    } else if ((prev_phased_halfword >> sample_idx_lowbits) & 1) {
+                      write_iter[-2] = '|';
+                    }
+                  }
+                  genovec_word >>= 2;
+                  is_male_hw >>= 1;
+                }
+                R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
+                ++widx;
+              }
+            }
+          } else {
+            // both dosage (or DS-force) and phase present
+            if (write_ds) {
+              write_iter = memcpyl3a(write_iter, ":DS");
+              if (!dosage_ct) {
+                ZeroWArr(sample_ctl, dosage_present);
+              }
+            } else {
+              write_iter = memcpyl3a(write_iter, ":GP");
+            }
+            if (!alt1_allele_idx) {
+              BiallelicDosage16Invert(dosage_ct, dosage_main);
+            }
+            Dosage* dosage_main_iter = dosage_main;
+            if (!is_haploid) {
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
+
+                // zero this out if phasepresent_ct == 0
+                const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
+
+                const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
+                const uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
+                uint32_t cur_shift = 1;
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  write_iter = memcpya(write_iter, &(basic_genotext[cur_geno]), 4);
+                  if (cur_geno == 1) {
+                    if (phasepresent_halfword & cur_shift) {
+                      prev_phased_halfword |= cur_shift;
+                      if (phaseinfo_halfword & cur_shift) {
+                        memcpy(&(write_iter[-4]), "\t1|0", 4);
+                      }
+                    } else {
+                      prev_phased_halfword &= ~cur_shift;
+                    }
+                  }
+                  if (prev_phased_halfword & cur_shift) {
+                    write_iter[-2] = '|';
+                  }
+                  if (dosage_present_hw & cur_shift) {
+                    *write_iter++ = ':';
+                    const uint32_t dosage_int = *dosage_main_iter++;
+                    write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
+                  } else if (dosage_force) {
+                    write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
+                  }
+                  genovec_word >>= 2;
+                  cur_shift <<= 1;
+                }
+                R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
+                ++widx;
+              }
+            } else {
+              while (1) {
+                if (widx >= sample_ctl2_m1) {
+                  if (widx > sample_ctl2_m1) {
+                    break;
+                  }
+                  inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+                }
+                uintptr_t genovec_word = genovec[widx];
+                uint32_t is_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
+                uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
+
+                // zero this out if phasepresent_ct == 0
+                const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
+
+                const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
+                const uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
+                uint32_t cur_shift = 1;
+                for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+                  const uint32_t cur_geno = genovec_word & 3;
+                  const uint32_t cur_is_male = is_male_hw & 1;
+                  const uint32_t cur_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
+                  write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_blen);
+                  if (cur_blen == 4) {
+                    if (cur_geno == 1) {
+                      if (phasepresent_halfword & cur_shift) {
+                        prev_phased_halfword |= cur_shift;
+                        if (phaseinfo_halfword & cur_shift) {
+                          memcpy(&(write_iter[-4]), "\t1|0", 4);
+                        }
+                      } else {
+                        prev_phased_halfword &= ~cur_shift;
+                      }
+                    }
+                    if (prev_phased_halfword & cur_shift) {
+                      write_iter[-2] = '|';
+                    }
+                    if (dosage_present_hw & cur_shift) {
+                      *write_iter++ = ':';
+                      const uint32_t dosage_int = *dosage_main_iter++;
+                      write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
+                    } else if (dosage_force) {
+                      write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
+                    }
+                  } else {
+                    if (dosage_present_hw & cur_shift) {
+                      *write_iter++ = ':';
+                      const uint32_t dosage_int = *dosage_main_iter++;
+                      if (write_ds) {
+                        write_iter = HaploidDosagePrint(dosage_int, write_iter);
+                      } else {
+                        write_iter = HaploidDosagePrint(kDosageMax - dosage_int, write_iter);
+                        *write_iter++ = ',';
+                        write_iter = HaploidDosagePrint(dosage_int, write_iter);
+                      }
+                    } else if (dosage_force) {
+                      write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2 + 8]), 2);
+                    }
+                  }
+                  genovec_word >>= 2;
+                  is_male_hw >>= 1;
+                  cur_shift <<= 1;
+                }
+                R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
+                ++widx;
+              }
+            }
+          }
+        }
+        // todo: multiallelic cases (separate out cur_allele_ct <= 10)
+        AppendBinaryEoln(&write_iter);
+        *line_ends_iter++ = write_iter;
+      }
+      if (compressor && (write_idx == write_idx_end)) {
+        const unsigned char* text = R_CAST(unsigned char*, linebuf);
+        const uintptr_t text_blen = write_iter - linebuf;
+        unsigned char* bgzf_buf = &(g_vcf_bgzf_bufs[parity][tidx * thread_bgzf_blen]);
+        char* const* line_ends = &(g_vcf_line_ends[parity][write_idx_start]);
+        uint64_t* line_end_voffsets = &(g_vcf_line_end_voffsets[parity][write_idx_start]);
+        const uint32_t line_ct = write_idx_end - write_idx_start;
+        uint32_t line_idx = 0;
+        uintptr_t bgzf_blen = 0;
+        for (uintptr_t text_offset = 0; text_offset < text_blen; text_offset += BGZF_BLOCK_SIZE) {
+          const uint32_t cur_slen = MINV(text_blen - text_offset, BGZF_BLOCK_SIZE);
+          const uint32_t block_blen = BgzfCompressBlock(&(text[text_offset]), cur_slen, compressor, &(bgzf_buf[bgzf_blen]));
+          if (!block_blen) {
+            g_error_ret = kPglRetWriteFail;
+            break;
+          }
+          // a line ending exactly at a block boundary is assigned the
+          // virtual offset of the start of the next block, as with
+          // bgzf_tell()
+          const char* block_text_end = &(linebuf[text_offset + cur_slen]);
+          for (; (line_idx != line_ct) && (line_ends[line_idx] < block_text_end); ++line_idx) {
+            line_end_voffsets[line_idx] = (S_CAST(uint64_t, bgzf_blen) << 16) | S_CAST(uintptr_t, line_ends[line_idx] - &(linebuf[text_offset]));
+          }
+          bgzf_blen += block_blen;
+        }
+        for (; line_idx != line_ct; ++line_idx) {
+          line_end_voffsets[line_idx] = S_CAST(uint64_t, bgzf_blen) << 16;
+        }
+        g_vcf_bgzf_blens[parity][tidx] = bgzf_blen;
+      }
+      parity = 1 - parity;
+    }
+    if (is_last_block) {
+      THREAD_RETURN;
+    }
+    THREAD_BLOCK_FINISH(tidx);
+  }
+}
+
+#ifdef __arm__
+#  error "Unaligned accesses in ExportVcf()."
 #endif
+PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include_cumulative_popcounts, const SampleIdInfo* siip, const uintptr_t* sex_male_collapsed, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const char* const* pvar_info_strs, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, ExportfFlags exportf_flags, IdpasteFlags exportf_id_paste, char exportf_id_delim, uintptr_t pgr_alloc_cacheline_ct, char* xheader, PgenFileInfo* pgfip, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  ThreadsState ts;
+  InitThreads3z(&ts);
+  FILE* outfile = nullptr;
+  hts_idx_t* vcf_idx = nullptr;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream pvar_reload_rls;
+  PreinitRLstream(&pvar_reload_rls);
+  g_vcf_compressors = nullptr;
+  {
+    // BGZF compression is performed by the rendering threads (and by the main
+    // thread for the header), instead of through a BGZF*, so that the virtual
+    // offset of each line is known when building the index.
+    const uint32_t is_bgz = (exportf_flags / kfExportfBgz) & 1;
+    snprintf(outname_end, kMaxOutfnameExtBlen, is_bgz? ".vcf.gz" : ".vcf");
+    if (fopen_checked(outname, FOPEN_WB, &outfile)) {
+      goto ExportVcf_ret_OPEN_FAIL;
+    }
+    unsigned char* bgzf_blockbuf = nullptr;
+    if (is_bgz) {
+      g_vcf_compressors = S_CAST(struct libdeflate_compressor**, bigstack_alloc(max_thread_ct * sizeof(intptr_t)));
+      if ((!g_vcf_compressors) ||
+          bigstack_alloc_uc(BGZF_MAX_BLOCK_SIZE, &bgzf_blockbuf)) {
+        goto ExportVcf_ret_NOMEM;
+      }
+      ZeroPtrArr(max_thread_ct, g_vcf_compressors);
+      // same default compression level as bgzf_open(, "w")
+      g_vcf_compressors[0] = libdeflate_alloc_compressor(6);
+      if (!g_vcf_compressors[0]) {
+        goto ExportVcf_ret_NOMEM;
+      }
     }
+    struct libdeflate_compressor* header_compressor = is_bgz? g_vcf_compressors[0] : nullptr;
     const uint32_t max_chr_blen = GetMaxChrSlen(cip) + 1;
-    // CHROM, POS, ID, REF, one ALT, eoln
-    uintptr_t writebuf_blen = kMaxIdSlen + 32 + max_chr_blen + 2 * max_allele_slen;
-    // QUAL, FILTER, INFO, FORMAT, genotypes, eoln
-    // needs to be larger for >9 alt alleles
     const uint32_t dosage_force = (exportf_flags / kfExportfVcfDosageForce) & 1;
     uint32_t write_ds = (exportf_flags / kfExportfVcfDosageDs) & 1;
     uint32_t write_hds = (exportf_flags / kfExportfVcfDosageHds) & 1;
@@ -3591,17 +4502,16 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
       write_ds = 0;
       write_hds = 0;
     }
+    // FORMAT, genotypes, eoln; rendered by VcfGenoRenderThread()
+    // needs to be larger for >9 alt alleles
     // GP: 3 limited-precision numbers, up to (7 chars + delim) * 3
     // DS: 1 limited-precision number
     // HDS: 2 limited-precision numbers
     // (could allow e.g. bloated DS+HDS mode, but let's defer that for now)
-    const uintptr_t writebuf_blen_lbound = ((4 * k1LU) + write_gp_ds_or_hds * 24 - write_ds * 16 - write_hds * 8) * sample_ct + 32 + max_filter_slen + info_reload_slen;
-    if (writebuf_blen < writebuf_blen_lbound) {
-      writebuf_blen = writebuf_blen_lbound;
-    }
-    writebuf_blen += kMaxMediumLine;
+    const uintptr_t max_geno_blen = ((4 * k1LU) + write_gp_ds_or_hds * 24 - write_ds * 16 - write_hds * 8) * sample_ct + 16;
+    // header only
     char* writebuf;
-    if (bigstack_alloc_c(writebuf_blen, &writebuf)) {
+    if (bigstack_alloc_c(2 * kMaxMediumLine + 32, &writebuf)) {
       goto ExportVcf_ret_NOMEM;
     }
     char* writebuf_flush = &(writebuf[kMaxMediumLine]);
@@ -3615,7 +4525,7 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
     if (cip->chrset_source) {
       AppendChrsetLine(cip, &write_iter);
     }
-    if (flexbwrite_flush(writebuf, write_iter - writebuf, outfile, bgz_outfile)) {
+    if (BgzfFlexwriteFlush(writebuf, write_iter - writebuf, header_compressor, bgzf_blockbuf, outfile)) {
       goto ExportVcf_ret_WRITE_FAIL;
     }
     const uint32_t chr_ctl = BitCtToWordCt(cip->chr_ct);
@@ -3655,14 +4565,14 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
           // if --output-chr was used at some point, we need to sync the
           // ##contig chromosome code with the code in the VCF body.
           write_iter = chrtoa(cip, chr_idx, &(writebuf[13]));
-          if (flexbwrite_flush(writebuf, write_iter - writebuf, outfile, bgz_outfile)) {
+          if (BgzfFlexwriteFlush(writebuf, write_iter - writebuf, header_compressor, bgzf_blockbuf, outfile)) {
             goto ExportVcf_ret_WRITE_FAIL;
           }
-          if (flexbwrite_flush(contig_name_end, line_end - contig_name_end, outfile, bgz_outfile)) {
+          if (BgzfFlexwriteFlush(contig_name_end, line_end - contig_name_end, header_compressor, bgzf_blockbuf, outfile)) {
             goto ExportVcf_ret_WRITE_FAIL;
           }
         } else {
-          if (flexbwrite_flush(xheader_iter, slen, outfile, bgz_outfile)) {
+          if (BgzfFlexwriteFlush(xheader_iter, slen, header_compressor, bgzf_blockbuf, outfile)) {
             goto ExportVcf_ret_WRITE_FAIL;
           }
         }
@@ -3702,7 +4612,7 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
       }
       *write_iter++ = '>';
       AppendBinaryEoln(&write_iter);
-      if (flexbwrite_ck(writebuf_flush, outfile, bgz_outfile, &write_iter)) {
+      if (BgzfFlexwriteCk(writebuf_flush, header_compressor, bgzf_blockbuf, outfile, &write_iter)) {
         goto ExportVcf_ret_WRITE_FAIL;
       }
     }
@@ -3751,27 +4661,113 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
     for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
       *write_iter++ = '\t';
       write_iter = strcpya(write_iter, &(exported_sample_ids[sample_idx * max_exported_sample_id_blen]));
-      if (flexbwrite_ck(writebuf_flush, outfile, bgz_outfile, &write_iter)) {
+      if (BgzfFlexwriteCk(writebuf_flush, header_compressor, bgzf_blockbuf, outfile, &write_iter)) {
         goto ExportVcf_ret_WRITE_FAIL;
       }
     }
     AppendBinaryEoln(&write_iter);
     BigstackReset(exported_sample_ids);
+    if (BgzfFlexwriteFlush(writebuf, write_iter - writebuf, header_compressor, bgzf_blockbuf, outfile)) {
+      goto ExportVcf_ret_WRITE_FAIL;
+    }
+    BigstackReset(writebuf);
+
+    const uint32_t index_fmt = (exportf_flags & kfExportfVcfIndexCsi)? HTS_FMT_CSI : HTS_FMT_TBI;
+    uint32_t* chr_fo_idx_to_tid = nullptr;
+    // only tracked when indexing
+    uint64_t file_offset = 0;
+    if (exportf_flags & (kfExportfVcfIndexTbi | kfExportfVcfIndexCsi)) {
+      // Each chromosome's lines must form a single block, sorted by position.
+      // chrX, PAR1, and PAR2 are all printed as chrX, so they share a sequence
+      // ID and must be adjacent.
+      // tabix metadata: format (2 = VCF), sequence-name/begin/end columns,
+      // comment character, skipped line count, and length of the
+      // concatenated sequence names which follow
+      char* idx_meta;
+      if (bigstack_alloc_u32(cip->chr_ct, &chr_fo_idx_to_tid) ||
+          bigstack_alloc_c(28 + cip->chr_ct * S_CAST(uintptr_t, max_chr_blen), &idx_meta)) {
+        goto ExportVcf_ret_NOMEM;
+      }
+      char* idx_meta_iter = &(idx_meta[28]);
+      const uint32_t chr_x_idx = cip->xymt_codes[kChrOffsetX];
+      const uint32_t chr_par1_idx = cip->xymt_codes[kChrOffsetPAR1];
+      const uint32_t chr_par2_idx = cip->xymt_codes[kChrOffsetPAR2];
+      uint32_t tid_ct = 0;
+      uint32_t x_tid = UINT32_MAX;
+      uint32_t max_bp = 0;
+      uint32_t prev_bp = 0;
+      for (uint32_t chr_fo_idx = 0; chr_fo_idx < cip->chr_ct; ++chr_fo_idx) {
+        const uint32_t chr_vidx_start = cip->chr_fo_vidx_start[chr_fo_idx];
+        const uint32_t chr_vidx_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+        uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
+        if ((!IsSet(cip->chr_mask, chr_idx)) || AllBitsAreZero(variant_include, chr_vidx_start, chr_vidx_end)) {
+          continue;
+        }
+        if ((chr_idx == chr_par1_idx) || (chr_idx == chr_par2_idx)) {
+          chr_idx = chr_x_idx;
+        }
+        if ((chr_idx == chr_x_idx) && (x_tid != UINT32_MAX)) {
+          if (x_tid != tid_ct - 1) {
+            logerrputs("Error: --export vcf-index= requires chrX, PAR1, and PAR2 to be adjacent in the\nvariant order.\n");
+            goto ExportVcf_ret_INCONSISTENT_INPUT;
+          }
+          chr_fo_idx_to_tid[chr_fo_idx] = x_tid;
+        } else {
+          if (chr_idx == chr_x_idx) {
+            x_tid = tid_ct;
+          }
+          chr_fo_idx_to_tid[chr_fo_idx] = tid_ct++;
+          idx_meta_iter = chrtoa(cip, chr_idx, idx_meta_iter);
+          *idx_meta_iter++ = '\0';
+          prev_bp = 0;
+        }
+        for (uint32_t variant_uidx = AdvTo1Bit(variant_include, chr_vidx_start); variant_uidx < chr_vidx_end; variant_uidx = AdvBoundedTo1Bit(variant_include, variant_uidx + 1, chr_vidx_end)) {
+          const uint32_t cur_bp = variant_bps[variant_uidx];
+          if (cur_bp < prev_bp) {
+            logerrputs("Error: --export vcf-index= requires variants to be sorted by position within\neach chromosome.\n");
+            goto ExportVcf_ret_INCONSISTENT_INPUT;
+          }
+          prev_bp = cur_bp;
+        }
+        if (prev_bp > max_bp) {
+          max_bp = prev_bp;
+        }
+      }
+      const int32_t idx_meta_header[7] = {2, 1, 2, 0, '#', 0, S_CAST(int32_t, S_CAST(uintptr_t, idx_meta_iter - idx_meta) - 28)};
+      memcpy(idx_meta, idx_meta_header, 28);
+      // this is the largest end coordinate that can be pushed
+      const uint64_t max_idx_end = S_CAST(uint64_t, max_bp) + max_allele_slen;
+      uint32_t idx_lvl_ct = 5;
+      if (index_fmt == HTS_FMT_CSI) {
+        uint64_t lvl_size = 1 << 14;
+        for (idx_lvl_ct = 0; max_idx_end > lvl_size; ++idx_lvl_ct) {
+          lvl_size <<= 3;
+        }
+      } else if (max_idx_end > (1 << 29)) {
+        logerrputs("Error: Variant positions are too large for a .tbi index.  Use 'vcf-index=csi'\ninstead.\n");
+        goto ExportVcf_ret_INCONSISTENT_INPUT;
+      }
+      const int64_t header_end = ftello(outfile);
+      if (header_end < 0) {
+        goto ExportVcf_ret_WRITE_FAIL;
+      }
+      file_offset = header_end;
+      vcf_idx = hts_idx_init(tid_ct, index_fmt, file_offset << 16, 14, idx_lvl_ct);
+      if ((!vcf_idx) || hts_idx_set_meta(vcf_idx, idx_meta_iter - idx_meta, R_CAST(uint8_t*, idx_meta), 1)) {
+        goto ExportVcf_ret_NOMEM;
+      }
+      BigstackReset(idx_meta);
+    }
 
-    logprintfww5("--export vcf%s to %s ... ", bgz_outfile? " bgz" : "", outname);
+    logprintfww5("--export vcf%s to %s ... ", is_bgz? " bgz" : "", outname);
     fputs("0%", stdout);
     fflush(stdout);
 
     // includes trailing tab
     char* chr_buf;
 
-    const uint32_t sample_ctl2 = QuaterCtToWordCt(sample_ct);
-    const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
-    uintptr_t* genovec;
     uintptr_t* allele_include;
     if (bigstack_alloc_c(max_chr_blen, &chr_buf) ||
-    // if we weren't using bigstack_alloc, this would need to be sample_ctaw2
-        bigstack_alloc_w(sample_ctl2, &genovec) ||
         bigstack_alloc_w(BitCtToWordCt(kPglMaxAltAlleleCt), &allele_include)) {
       goto ExportVcf_ret_NOMEM;
     }
@@ -3783,79 +4779,1152 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
     // saving that info.  But that approximation is still pretty inaccurate; as
     // soon as we have any use for them, explicit phase set support should be
     // added to pgenlib.
+    // prev_phased tracks this state as of the start of the current block; see
+    // VcfGenoRenderThread().
     const uint32_t some_phased = (pgfip->gflags / kfPgenGlobalHardcallPhasePresent) & 1;
+    const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
     uintptr_t* prev_phased = nullptr;
-    uintptr_t* phasepresent = nullptr;
-    uintptr_t* phaseinfo = nullptr;
     if (some_phased) {
       if (bigstack_alloc_w(sample_ctl, &prev_phased) ||
-          bigstack_alloc_w(sample_ctl, &phasepresent) ||
-          bigstack_alloc_w(sample_ctl, &phaseinfo)) {
+          bigstack_alloc_wp(max_thread_ct, &g_vcf_prev_phaseds)) {
         goto ExportVcf_ret_NOMEM;
       }
       SetAllBits(sample_ct, prev_phased);
     }
 
+    // CHROM..INFO, rendered by the main thread.  This bound requires a scan
+    // over the variant IDs and allele codes.
+    uintptr_t max_id_and_alleles_blen = 0;
+    uint32_t variant_uidx = 0;
+    for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
+      MovU32To1Bit(variant_include, &variant_uidx);
+      uintptr_t variant_allele_idx_base = variant_uidx * 2;
+      uint32_t cur_allele_ct = 2;
+      if (variant_allele_idxs) {
+        variant_allele_idx_base = variant_allele_idxs[variant_uidx];
+        cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
+      }
+      const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
+      // delimiters included
+      uintptr_t cur_blen = strlen(variant_ids[variant_uidx]) + 1 + cur_allele_ct;
+      for (uint32_t allele_idx = 0; allele_idx < cur_allele_ct; ++allele_idx) {
+        cur_blen += strlen(cur_alleles[allele_idx]);
+      }
+      if (cur_blen > max_id_and_alleles_blen) {
+        max_id_and_alleles_blen = cur_blen;
+      }
+    }
+    // POS, QUAL, 'PASS', ';PR', and delimiters fit in 48 bytes
+    const uintptr_t max_prefix_blen = max_chr_blen + max_id_and_alleles_blen + max_filter_slen + info_reload_slen + 48;
+    const uintptr_t max_line_blen = max_prefix_blen + max_geno_blen;
+
+    // Worker threads render complete lines of each block into
+    // g_vcf_linebufs[] (and compress them into g_vcf_bgzf_bufs[] if
+    // necessary); limit each block's buffers to 1/4 of remaining workspace.
+    // Unlike most other multithreaded exporters, we permit the write block size
+    // to fall all the way to 1 (with a corresponding reduction in thread
+    // count) instead of erroring out, since only one line had to fit in memory
+    // before.
+    uint32_t calc_thread_ct = (max_thread_ct > 2)? (max_thread_ct - 1) : max_thread_ct;
+    const uintptr_t max_write_block_byte_ct = bigstack_left() / 4;
+    const uintptr_t per_variant_byte_ct = max_prefix_blen + 2 * sizeof(intptr_t) + is_bgz * sizeof(int64_t);
+    uint32_t max_write_block_size = kPglVblockSize;
+    uint64_t write_block_byte_ct;
+    while (1) {
+      if (calc_thread_ct > max_write_block_size) {
+        calc_thread_ct = max_write_block_size;
+      }
+      // per-thread slices are rounded up
+      const uint64_t thread_linebuf_byte_ct = S_CAST(uint64_t, max_line_blen) * DivUp(max_write_block_size, calc_thread_ct);
+      write_block_byte_ct = S_CAST(uint64_t, per_variant_byte_ct) * max_write_block_size + calc_thread_ct * (thread_linebuf_byte_ct + 2 * kCacheline);
+      if (is_bgz) {
+        write_block_byte_ct += calc_thread_ct * (DivUpU64(thread_linebuf_byte_ct, BGZF_BLOCK_SIZE) * BGZF_MAX_BLOCK_SIZE + sizeof(intptr_t));
+      }
+      if (write_block_byte_ct <= max_write_block_byte_ct) {
+        break;
+      }
+      if (max_write_block_size == 1) {
+        goto ExportVcf_ret_NOMEM;
+      }
+      max_write_block_size /= 2;
+    }
+    const uintptr_t write_reserve_byte_ct = 2 * (write_block_byte_ct + 8 * kCacheline);
+    // prev_phased, het_seen, last_het_phased
+    const uintptr_t thread_xalloc_cacheline_ct = some_phased? (3 * BitCtToCachelineCt(sample_ct)) : 0;
+    g_phasepresents = nullptr;
+    g_phaseinfos = nullptr;
+    g_dosage_presents = nullptr;
+    g_dosage_mains = nullptr;
+    g_dphase_presents = nullptr;
+    g_dphase_deltas = nullptr;
+    unsigned char* main_loadbufs[2];
+    uint32_t read_block_size;
+    if (PgenMtLoadInit(variant_include, sample_ct, raw_variant_ct, bigstack_left() - write_reserve_byte_ct, pgr_alloc_cacheline_ct, thread_xalloc_cacheline_ct, 0, pgfip, &calc_thread_ct, &g_genovecs, some_phased? (&g_phasepresents) : nullptr, some_phased? (&g_phaseinfos) : nullptr, write_gp_ds_or_hds? (&g_dosage_presents) : nullptr, write_gp_ds_or_hds? (&g_dosage_mains) : nullptr, (some_phased && write_gp_ds_or_hds)? (&g_dphase_presents) : nullptr, (some_phased && write_gp_ds_or_hds)? (&g_dphase_deltas) : nullptr, &read_block_size, main_loadbufs, &ts.threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
+      goto ExportVcf_ret_NOMEM;
+    }
+    if (read_block_size > max_write_block_size) {
+      read_block_size = max_write_block_size;
+    }
+    const uintptr_t thread_linebuf_blen = DivUp(read_block_size, calc_thread_ct) * max_line_blen;
+    if (bigstack_alloc_c(read_block_size * max_prefix_blen, &(g_vcf_prefixbufs[0])) ||
+        bigstack_alloc_c(read_block_size * max_prefix_blen, &(g_vcf_prefixbufs[1])) ||
+        bigstack_alloc_cp(read_block_size, &(g_vcf_prefix_ends[0])) ||
+        bigstack_alloc_cp(read_block_size, &(g_vcf_prefix_ends[1])) ||
+        bigstack_alloc_c(thread_linebuf_blen * calc_thread_ct, &(g_vcf_linebufs[0])) ||
+        bigstack_alloc_c(thread_linebuf_blen * calc_thread_ct, &(g_vcf_linebufs[1])) ||
+        bigstack_alloc_cp(read_block_size, &(g_vcf_line_ends[0])) ||
+        bigstack_alloc_cp(read_block_size, &(g_vcf_line_ends[1]))) {
+      goto ExportVcf_ret_NOMEM;
+    }
+    uintptr_t thread_bgzf_blen = 0;
+    if (is_bgz) {
+      thread_bgzf_blen = DivUp(thread_linebuf_blen, BGZF_BLOCK_SIZE) * BGZF_MAX_BLOCK_SIZE;
+      if (bigstack_alloc_uc(thread_bgzf_blen * calc_thread_ct, &(g_vcf_bgzf_bufs[0])) ||
+          bigstack_alloc_uc(thread_bgzf_blen * calc_thread_ct, &(g_vcf_bgzf_bufs[1])) ||
+          bigstack_alloc_w(calc_thread_ct, &(g_vcf_bgzf_blens[0])) ||
+          bigstack_alloc_w(calc_thread_ct, &(g_vcf_bgzf_blens[1])) ||
+          bigstack_alloc_u64(read_block_size, &(g_vcf_line_end_voffsets[0])) ||
+          bigstack_alloc_u64(read_block_size, &(g_vcf_line_end_voffsets[1]))) {
+        goto ExportVcf_ret_NOMEM;
+      }
+      for (uint32_t tidx = 1; tidx < calc_thread_ct; ++tidx) {
+        g_vcf_compressors[tidx] = libdeflate_alloc_compressor(6);
+        if (!g_vcf_compressors[tidx]) {
+          goto ExportVcf_ret_NOMEM;
+        }
+      }
+    }
+    if (some_phased) {
+      for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+        g_vcf_prev_phaseds[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(thread_xalloc_cacheline_ct * kCacheline));
+      }
+      // with only one rendering thread, its phase state can just carry over
+      // from block to block
+      SetAllBits(sample_ct, g_vcf_prev_phaseds[0]);
+    }
+    const uint32_t phase_prepass = some_phased && (calc_thread_ct > 1);
+    g_sample_ct = sample_ct;
+    g_variant_include = variant_include;
+    g_sample_include = sample_include;
+    g_sample_include_cumulative_popcounts = sample_include_cumulative_popcounts;
+    g_vcf_sex_male_collapsed = sex_male_collapsed;
+    g_calc_thread_ct = calc_thread_ct;
+    ts.calc_thread_ct = calc_thread_ct;
+    g_refalt1_select = refalt1_select;
+    g_cip = cip;
+    g_vcf_thread_linebuf_blen = thread_linebuf_blen;
+    g_vcf_thread_bgzf_blen = thread_bgzf_blen;
+    g_vcf_phase_prepass = 0;
+    g_vcf_write_ds = write_ds;
+    g_vcf_write_gp_ds_or_hds = write_gp_ds_or_hds;
+    g_vcf_dosage_force = dosage_force;
+    g_error_ret = kPglRetSuccess;
+
+    // this may use all remaining memory, so it must come last
+    char* pvar_reload_line_iter = nullptr;
+    uint32_t info_col_idx = 0;
+    if (pvar_info_reload && (!pvar_info_strs)) {
+      reterr = PvarInfoOpenAndReloadHeader(pvar_info_reload, 1 + (max_thread_ct > 1), &pvar_reload_rls, &pvar_reload_line_iter, &info_col_idx);
+      if (reterr) {
+        goto ExportVcf_ret_1;
+      }
+    }
+
+    // Main workflow:
+    // 1. Set n=0, load/skip block 0, and render its CHROM..INFO columns
+    //
+    // 2. If phased data is present (and there are multiple threads), run the
+    //    phase-state pass on block n, and initialize each thread's phase state
+    // 3. Spawn threads rendering (and compressing) block n
+    // 4. If n>0, write results for block (n-1)
+    // 5. Increment n by 1
+    // 6. Load/skip block n and render its CHROM..INFO columns, unless eof
+    // 7. Join threads
+    // 8. Goto step 2 unless eof
+    //
+    // 9. Write results for last block
+    const uint32_t read_block_ct_m1 = (raw_variant_ct - 1) / read_block_size;
+    const char* dot_ptr = &(g_one_char_strs[92]);
+    uint32_t parity = 0;
+    uint32_t read_block_idx = 0;
+    uint32_t prefix_variant_uidx = 0;
+    uint32_t chr_fo_idx = UINT32_MAX;
+    uint32_t chr_end = 0;
+    uint32_t chr_buf_blen = 0;
+    uint32_t prev_block_write_ct = 0;
+    uint32_t variant_idx = 0;
+    uint32_t cur_read_block_size = read_block_size;
+    uint32_t pct = 0;
+    uint32_t next_print_variant_idx = variant_ct / 100;
+    uint32_t rls_variant_uidx = 0;
+    uint32_t ref_allele_idx = 0;
+    uint32_t alt1_allele_idx = 1;
+    uint32_t cur_allele_ct = 2;
+    uint32_t idx_variant_uidx = 0;
+    uint32_t idx_chr_fo_idx = UINT32_MAX;
+    uint32_t idx_chr_end = 0;
+    uint32_t idx_tid = 0;
+    while (1) {
+      uintptr_t cur_block_write_ct = 0;
+      if (!ts.is_last_block) {
+        // read_block_size may be smaller than a word here, so we can't use
+        // PopcountWords()
+        while (read_block_idx < read_block_ct_m1) {
+          cur_block_write_ct = PopcountBitRange(variant_include, read_block_idx * read_block_size, (read_block_idx + 1) * read_block_size);
+          if (cur_block_write_ct) {
+            break;
+          }
+          ++read_block_idx;
+        }
+        if (read_block_idx == read_block_ct_m1) {
+          cur_read_block_size = raw_variant_ct - (read_block_idx * read_block_size);
+          cur_block_write_ct = PopcountBitRange(variant_include, read_block_idx * read_block_size, raw_variant_ct);
+        }
+        if (PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_write_ct, pgfip)) {
+          goto ExportVcf_ret_READ_FAIL;
+        }
+        // CHROM..INFO
+        char* prefix_iter = g_vcf_prefixbufs[parity];
+        char** prefix_ends = g_vcf_prefix_ends[parity];
+        for (uint32_t variant_bidx = 0; variant_bidx < cur_block_write_ct; ++variant_bidx, ++prefix_variant_uidx) {
+          // a lot of this is redundant with write_pvar(), may want to factor
+          // the commonalities out
+          MovU32To1Bit(variant_include, &prefix_variant_uidx);
+          if (prefix_variant_uidx >= chr_end) {
+            do {
+              ++chr_fo_idx;
+              chr_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+            } while (prefix_variant_uidx >= chr_end);
+            uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
+            // forced --merge-par, with diploid male output (is_x NOT set, but
+            // chromosome code is X/chrX)
+            if ((chr_idx == cip->xymt_codes[kChrOffsetPAR1]) || (chr_idx == cip->xymt_codes[kChrOffsetPAR2])) {
+              chr_idx = cip->xymt_codes[kChrOffsetX];
+            }
+            char* chr_name_end = chrtoa(cip, chr_idx, chr_buf);
+            *chr_name_end = '\t';
+            chr_buf_blen = 1 + S_CAST(uintptr_t, chr_name_end - chr_buf);
+          }
+          // #CHROM
+          prefix_iter = memcpya(prefix_iter, chr_buf, chr_buf_blen);
+
+          // POS
+          prefix_iter = u32toa_x(variant_bps[prefix_variant_uidx], '\t', prefix_iter);
+
+          // ID
+          prefix_iter = strcpyax(prefix_iter, variant_ids[prefix_variant_uidx], '\t');
+
+          // REF, ALT
+          uintptr_t variant_allele_idx_base = prefix_variant_uidx * 2;
+          if (variant_allele_idxs) {
+            variant_allele_idx_base = variant_allele_idxs[prefix_variant_uidx];
+            cur_allele_ct = variant_allele_idxs[prefix_variant_uidx + 1] - variant_allele_idx_base;
+          }
+          const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
+          if (refalt1_select) {
+            ref_allele_idx = refalt1_select[prefix_variant_uidx * 2];
+            alt1_allele_idx = refalt1_select[prefix_variant_uidx * 2 + 1];
+            // genotype rendering logic only works in the biallelic case
+            assert(cur_allele_ct == 2);
+          }
+          if (cur_alleles[ref_allele_idx] != dot_ptr) {
+            prefix_iter = strcpya(prefix_iter, cur_alleles[ref_allele_idx]);
+          } else {
+            *prefix_iter++ = 'N';
+          }
+          *prefix_iter++ = '\t';
+          prefix_iter = strcpya(prefix_iter, cur_alleles[alt1_allele_idx]);
+          if (cur_allele_ct > 2) {
+            SetAllBits(cur_allele_ct, allele_include);
+            ClearBit(ref_allele_idx, allele_include);
+            ClearBit(alt1_allele_idx, allele_include);
+            uint32_t cur_allele_uidx = 0;
+            uint32_t alt_allele_idx = 2;
+            do {
+              *prefix_iter++ = ',';
+              MovU32To1Bit(allele_include, &cur_allele_uidx);
+              prefix_iter = strcpya(prefix_iter, cur_alleles[cur_allele_uidx++]);
+            } while (++alt_allele_idx < cur_allele_ct);
+          }
+
+          // QUAL
+          *prefix_iter++ = '\t';
+          if ((!pvar_qual_present) || (!IsSet(pvar_qual_present, prefix_variant_uidx))) {
+            *prefix_iter++ = '.';
+          } else {
+            prefix_iter = ftoa_g(pvar_quals[prefix_variant_uidx], prefix_iter);
+          }
+
+          // FILTER
+          *prefix_iter++ = '\t';
+          if ((!pvar_filter_present) || (!IsSet(pvar_filter_present, prefix_variant_uidx))) {
+            *prefix_iter++ = '.';
+          } else if (!IsSet(pvar_filter_npass, prefix_variant_uidx)) {
+            prefix_iter = strcpya(prefix_iter, "PASS");
+          } else {
+            prefix_iter = strcpya(prefix_iter, pvar_filter_storage[prefix_variant_uidx]);
+          }
+
+          // INFO
+          *prefix_iter++ = '\t';
+          const uint32_t is_pr = all_nonref || (nonref_flags && IsSet(nonref_flags, prefix_variant_uidx));
+          if (pvar_info_strs) {
+            PvarInfoWrite(info_pr_flag_present, is_pr, K_CAST(char*, pvar_info_strs[prefix_variant_uidx]), &prefix_iter);
+          } else if (pvar_reload_line_iter) {
+            reterr = PvarInfoReloadAndWrite(info_pr_flag_present, info_col_idx, prefix_variant_uidx, is_pr, &pvar_reload_rls, &pvar_reload_line_iter, &prefix_iter, &rls_variant_uidx);
+            if (reterr) {
+              goto ExportVcf_ret_1;
+            }
+          } else {
+            if (is_pr) {
+              prefix_iter = strcpya(prefix_iter, "PR");
+            } else {
+              *prefix_iter++ = '.';
+            }
+          }
+          prefix_ends[variant_bidx] = prefix_iter;
+        }
+      }
+      if (variant_idx) {
+        JoinThreads3z(&ts);
+        reterr = g_error_ret;
+        if (reterr) {
+          if (reterr == kPglRetWriteFail) {
+            goto ExportVcf_ret_WRITE_FAIL;
+          }
+          goto ExportVcf_ret_PGR_FAIL;
+        }
+      }
+      if (!ts.is_last_block) {
+        g_cur_block_write_ct = cur_block_write_ct;
+        ComputeUidxStartPartition(variant_include, cur_block_write_ct, calc_thread_ct, read_block_idx * read_block_size, g_read_variant_uidx_starts);
+        for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+          g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
+          g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+        }
+        ts.thread_func_ptr = VcfGenoRenderThread;
+        if (phase_prepass) {
+          g_vcf_phase_prepass = 1;
+          if (SpawnThreads3z(variant_idx, &ts)) {
+            goto ExportVcf_ret_THREAD_CREATE_FAIL;
+          }
+          JoinThreads3z(&ts);
+          reterr = g_error_ret;
+          if (reterr) {
+            goto ExportVcf_ret_PGR_FAIL;
+          }
+          for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+            uintptr_t* thread_prev_phased = g_vcf_prev_phaseds[tidx];
+            const uintptr_t* het_seen = &(thread_prev_phased[sample_ctl]);
+            const uintptr_t* last_het_phased = &(het_seen[sample_ctl]);
+            memcpy(thread_prev_phased, prev_phased, sample_ctl * sizeof(intptr_t));
+            for (uint32_t widx = 0; widx < sample_ctl; ++widx) {
+              prev_phased[widx] = (prev_phased[widx] & (~het_seen[widx])) | last_het_phased[widx];
+            }
+          }
+          g_vcf_phase_prepass = 0;
+        }
+        ts.is_last_block = (variant_idx + cur_block_write_ct == variant_ct);
+        if (SpawnThreads3z(variant_idx || phase_prepass, &ts)) {
+          goto ExportVcf_ret_THREAD_CREATE_FAIL;
+        }
+      }
+      parity = 1 - parity;
+      if (variant_idx) {
+        // write *previous* block results
+        uint32_t variant_bidx = 0;
+        for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+          const uint32_t variant_bidx_end = ((tidx + 1) * S_CAST(uintptr_t, prev_block_write_ct)) / calc_thread_ct;
+          if (variant_bidx == variant_bidx_end) {
+            continue;
+          }
+          if (!is_bgz) {
+            const char* linebuf = &(g_vcf_linebufs[parity][tidx * thread_linebuf_blen]);
+            if (fwrite_checked(linebuf, g_vcf_line_ends[parity][variant_bidx_end - 1] - linebuf, outfile)) {
+              goto ExportVcf_ret_WRITE_FAIL;
+            }
+            variant_bidx = variant_bidx_end;
+            continue;
+          }
+          const uintptr_t bgzf_blen = g_vcf_bgzf_blens[parity][tidx];
+          if (fwrite_checked(&(g_vcf_bgzf_bufs[parity][tidx * thread_bgzf_blen]), bgzf_blen, outfile)) {
+            goto ExportVcf_ret_WRITE_FAIL;
+          }
+          if (vcf_idx) {
+            const uint64_t* line_end_voffsets = g_vcf_line_end_voffsets[parity];
+            for (; variant_bidx < variant_bidx_end; ++variant_bidx, ++idx_variant_uidx) {
+              MovU32To1Bit(variant_include, &idx_variant_uidx);
+              if (idx_variant_uidx >= idx_chr_end) {
+                do {
+                  ++idx_chr_fo_idx;
+                  idx_chr_end = cip->chr_fo_vidx_start[idx_chr_fo_idx + 1];
+                } while (idx_variant_uidx >= idx_chr_end);
+                idx_tid = chr_fo_idx_to_tid[idx_chr_fo_idx];
+              }
+              const uint32_t cur_bp = variant_bps[idx_variant_uidx];
+              uintptr_t variant_allele_idx_base = idx_variant_uidx * 2;
+              if (variant_allele_idxs) {
+                variant_allele_idx_base = variant_allele_idxs[idx_variant_uidx];
+              }
+              if (refalt1_select) {
+                variant_allele_idx_base += refalt1_select[idx_variant_uidx * 2];
+              }
+              // VCF POS is 1-based, index coordinates are 0-based half-open
+              const uint32_t ref_slen = strlen(allele_storage[variant_allele_idx_base]);
+              const uint64_t rel_voffset = line_end_voffsets[variant_bidx];
+              if (hts_idx_push(vcf_idx, idx_tid, S_CAST(int32_t, cur_bp) - 1, S_CAST(int32_t, cur_bp) - 1 + ref_slen, ((file_offset + (rel_voffset >> 16)) << 16) | (rel_voffset & 0xffff), 1)) {
+                goto ExportVcf_ret_NOMEM;
+              }
+            }
+          }
+          variant_bidx = variant_bidx_end;
+          file_offset += bgzf_blen;
+        }
+      }
+      if (variant_idx == variant_ct) {
+        break;
+      }
+      if (variant_idx >= next_print_variant_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (variant_idx * 100LLU) / variant_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+      }
+      ++read_block_idx;
+      prev_block_write_ct = cur_block_write_ct;
+      variant_idx += cur_block_write_ct;
+      pgfip->block_base = main_loadbufs[parity];
+    }
+    if (is_bgz) {
+      // empty EOF block
+      if (fwrite_checked("\37\213\10\4\0\0\0\0\0\377\6\0BC\2\0\33\0\3\0\0\0\0\0\0\0\0\0", 28, outfile)) {
+        goto ExportVcf_ret_WRITE_FAIL;
+      }
+    }
+    if (fclose_null(&outfile)) {
+      goto ExportVcf_ret_WRITE_FAIL;
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+    if (vcf_idx) {
+      hts_idx_finish(vcf_idx, file_offset << 16);
+      char* idx_fname_end = &(outname_end[strlen(outname_end)]);
+      snprintf(idx_fname_end, kMaxOutfnameExtBlen - S_CAST(uintptr_t, idx_fname_end - outname_end), (index_fmt == HTS_FMT_CSI)? ".csi" : ".tbi");
+      if (hts_idx_save_as(vcf_idx, nullptr, outname, index_fmt)) {
+        goto ExportVcf_ret_WRITE_FAIL;
+      }
+      logprintfww("Index written to %s .\n", outname);
+    }
+  }
+  while (0) {
+  ExportVcf_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  ExportVcf_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  ExportVcf_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  ExportVcf_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  ExportVcf_ret_MALFORMED_INPUT:
+    reterr = kPglRetMalformedInput;
+    break;
+  ExportVcf_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetMalformedInput;
+    break;
+  ExportVcf_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  ExportVcf_ret_PGR_FAIL:
+    if (reterr != kPglRetReadFail) {
+      logputs("\n");
+      logerrputs("Error: Malformed .pgen file.\n");
+    }
+  }
+ ExportVcf_ret_1:
+  CleanupThreads3z(&ts, &g_cur_block_write_ct);
+  fclose_cond(outfile);
+  CleanupRLstream(&pvar_reload_rls);
+  hts_idx_destroy(vcf_idx);
+  if (g_vcf_compressors) {
+    for (uint32_t tidx = 0; tidx < max_thread_ct; ++tidx) {
+      if (g_vcf_compressors[tidx]) {
+        libdeflate_free_compressor(g_vcf_compressors[tidx]);
+      }
+    }
+    g_vcf_compressors = nullptr;
+  }
+  pgfip->block_base = nullptr;
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
+// BCF2 typed-value encoding.  (Assumes little-endian.)
+static unsigned char* BcfAppendTypedUint(uint32_t val, unsigned char* write_iter) {
+  if (val < 128) {
+    *write_iter++ = 0x10 | kBcfTypeInt8;
+    *write_iter++ = val;
+    return write_iter;
+  }
+  if (val < 32768) {
+    *write_iter++ = 0x10 | kBcfTypeInt16;
+    const uint16_t val16 = val;
+    return memcpyua(write_iter, &val16, 2);
+  }
+  *write_iter++ = 0x10 | kBcfTypeInt32;
+  return memcpyua(write_iter, &val, 4);
+}
+
+static unsigned char* BcfAppendTypeDescriptor(uint32_t val_ct, uint32_t bcf_type, unsigned char* write_iter) {
+  if (val_ct < 15) {
+    *write_iter++ = (val_ct << 4) | bcf_type;
+    return write_iter;
+  }
+  *write_iter++ = 0xf0 | bcf_type;
+  return BcfAppendTypedUint(val_ct, write_iter);
+}
+
+static unsigned char* BcfAppendTypedStr(const char* str, uint32_t slen, unsigned char* write_iter) {
+  write_iter = BcfAppendTypeDescriptor(slen, kBcfTypeChar, write_iter);
+  return memcpyua(write_iter, str, slen);
+}
+
+// vals[] entries equal to INT32_MIN are written as missing.  The bottom 8
+// values of each integer type's range are reserved.
+static unsigned char* BcfAppendTypedIntVec(const int32_t* vals, uint32_t val_ct, unsigned char* write_iter) {
+  int32_t min_val = 0;
+  int32_t max_val = 0;
+  for (uint32_t val_idx = 0; val_idx != val_ct; ++val_idx) {
+    const int32_t cur_val = vals[val_idx];
+    if (cur_val == INT32_MIN) {
+      continue;
+    }
+    if (cur_val < min_val) {
+      min_val = cur_val;
+    } else if (cur_val > max_val) {
+      max_val = cur_val;
+    }
+  }
+  if ((min_val >= -120) && (max_val <= 127)) {
+    write_iter = BcfAppendTypeDescriptor(val_ct, kBcfTypeInt8, write_iter);
+    for (uint32_t val_idx = 0; val_idx != val_ct; ++val_idx) {
+      const int32_t cur_val = vals[val_idx];
+      *write_iter++ = (cur_val == INT32_MIN)? 0x80 : S_CAST(unsigned char, cur_val);
+    }
+  } else if ((min_val >= -32760) && (max_val <= 32767)) {
+    write_iter = BcfAppendTypeDescriptor(val_ct, kBcfTypeInt16, write_iter);
+    for (uint32_t val_idx = 0; val_idx != val_ct; ++val_idx) {
+      const int32_t cur_val = vals[val_idx];
+      const uint16_t cur_val16 = (cur_val == INT32_MIN)? 0x8000 : S_CAST(uint16_t, cur_val);
+      write_iter = memcpyua(write_iter, &cur_val16, 2);
+    }
+  } else {
+    write_iter = BcfAppendTypeDescriptor(val_ct, kBcfTypeInt32, write_iter);
+    write_iter = memcpyua(write_iter, vals, val_ct * sizeof(int32_t));
+  }
+  return write_iter;
+}
+
+static inline unsigned char* BcfAppendFloatBits(uint32_t fbits, unsigned char* write_iter) {
+  return memcpyua(write_iter, &fbits, 4);
+}
+
+static inline unsigned char* BcfAppendFloat(float fxx, unsigned char* write_iter) {
+  return memcpyua(write_iter, &fxx, 4);
+}
+
+// The FILTER, INFO, and FORMAT keys share a single BCF2 dictionary.
+FLAGSET_DEF_START()
+  kfBcfDict0,
+  kfBcfDictFilter = (1 << 0),
+  kfBcfDictInfo = (1 << 1)
+FLAGSET_DEF_END(BcfDictFlags);
+
+ENUM_U31_DEF_START()
+  kBcfInfoFlag,
+  kBcfInfoInteger,
+  kBcfInfoFloat,
+  kBcfInfoString
+ENUM_U31_DEF_END(BcfInfoType);
+
+// name must be null-terminated, and remain valid as long as the dictionary
+// does.
+static uint32_t BcfDictFindOrAdd(const char* name, uint32_t name_slen, uint32_t htable_size, const char** dict, uint32_t* htable, uint32_t* dict_size_ptr) {
+  uint32_t hashval = Hashceil(name, name_slen, htable_size);
+  while (1) {
+    const uint32_t cur_htable_idval = htable[hashval];
+    if (cur_htable_idval == UINT32_MAX) {
+      break;
+    }
+    if (!strcmp(name, dict[cur_htable_idval])) {
+      return cur_htable_idval;
+    }
+    if (++hashval == htable_size) {
+      hashval = 0;
+    }
+  }
+  const uint32_t dict_idx = *dict_size_ptr;
+  dict[dict_idx] = name;
+  htable[hashval] = dict_idx;
+  *dict_size_ptr = dict_idx + 1;
+  return dict_idx;
+}
+
+// Encodes a semicolon-delimited FILTER or INFO text field (which is
+// overwritten) as BCF2 FILTER indexes or INFO key/value pairs.  On undeclared
+// key or unparseable value, returns nullptr, with *bad_key_ptr pointing to the
+// null-terminated offending key.
+static unsigned char* BcfEncodeFilterOrInfo(const char* const* dict, const uint32_t* dict_htable, const unsigned char* dict_flags, const unsigned char* info_types, uint32_t dict_htable_size, uint32_t is_info, char* text_iter, int32_t* int_buf, uint32_t* item_ct_ptr, unsigned char* write_iter, char** bad_key_ptr) {
+  uint32_t item_ct = 0;
+  unsigned char* filter_vals_start = write_iter;
+  int32_t* filter_idx_iter = int_buf;
+  while (1) {
+    char* key_start = text_iter;
+    char* tok_end = strchrnul(key_start, ';');
+    const uint32_t is_last = (*tok_end == '\0');
+    *tok_end = '\0';
+    char* val_start = nullptr;
+    char* key_end = tok_end;
+    if (is_info) {
+      val_start = S_CAST(char*, memchr(key_start, '=', tok_end - key_start));
+      if (val_start) {
+        key_end = val_start;
+        *val_start++ = '\0';
+      }
+    }
+    const uint32_t dict_idx = IdHtableFind(key_start, dict, dict_htable, key_end - key_start, dict_htable_size);
+    if ((dict_idx == UINT32_MAX) || (!(dict_flags[dict_idx] & (is_info? kfBcfDictInfo : kfBcfDictFilter)))) {
+      *bad_key_ptr = key_start;
+      return nullptr;
+    }
+    ++item_ct;
+    if (!is_info) {
+      *filter_idx_iter++ = dict_idx;
+    } else {
+      write_iter = BcfAppendTypedUint(dict_idx, write_iter);
+      const uint32_t info_type = info_types[dict_idx];
+      if ((info_type == kBcfInfoFlag) || (!val_start)) {
+        // no values; same encoding as htslib
+        *write_iter++ = kBcfTypeNull;
+      } else if (info_type == kBcfInfoString) {
+        write_iter = BcfAppendTypedStr(val_start, tok_end - val_start, write_iter);
+      } else {
+        uint32_t val_ct = 0;
+        char* val_iter = val_start;
+        while (1) {
+          char* val_end = strchrnul(val_iter, ',');
+          const uint32_t is_last_val = (*val_end == '\0');
+          *val_end = '\0';
+          if ((val_iter[0] == '.') && (!val_iter[1])) {
+            int_buf[val_ct] = (info_type == kBcfInfoInteger)? INT32_MIN : S_CAST(int32_t, kBcfFloatMissingBits);
+          } else if (info_type == kBcfInfoInteger) {
+            if ((val_iter == val_end) || ScanIntAbsDefcap(val_iter, &(int_buf[val_ct]))) {
+              *bad_key_ptr = key_start;
+              return nullptr;
+            }
+          } else {
+            double dxx;
+            if (ScanadvDouble(val_iter, &dxx) != val_end) {
+              *bad_key_ptr = key_start;
+              return nullptr;
+            }
+            const float fxx = S_CAST(float, dxx);
+            memcpy(&(int_buf[val_ct]), &fxx, 4);
+          }
+          ++val_ct;
+          if (is_last_val) {
+            break;
+          }
+          val_iter = &(val_end[1]);
+        }
+        if (info_type == kBcfInfoInteger) {
+          write_iter = BcfAppendTypedIntVec(int_buf, val_ct, write_iter);
+        } else {
+          write_iter = BcfAppendTypeDescriptor(val_ct, kBcfTypeFloat, write_iter);
+          write_iter = memcpyua(write_iter, int_buf, val_ct * sizeof(int32_t));
+        }
+      }
+    }
+    if (is_last) {
+      break;
+    }
+    text_iter = &(tok_end[1]);
+  }
+  if (!is_info) {
+    write_iter = BcfAppendTypedIntVec(int_buf, item_ct, filter_vals_start);
+  }
+  *item_ct_ptr = item_ct;
+  return write_iter;
+}
+
+// Copies a ##FILTER/##INFO/##FORMAT/##contig header line (excluding its
+// trailing '>' and newline) with any existing IDX field removed, and appends
+// our own IDX.
+static char* BcfHeaderLineCopyWithIdx(const char* line_start, const char* line_last, uint32_t dict_idx, char* write_iter) {
+  const char* read_iter = line_start;
+  while (1) {
+    const char* idx_start = S_CAST(const char*, memchr(read_iter, ',', line_last - read_iter));
+    if (!idx_start) {
+      break;
+    }
+    if (!StrStartsWithUnsafe(&(idx_start[1]), "IDX=")) {
+      write_iter = memcpya(write_iter, read_iter, &(idx_start[1]) - read_iter);
+      read_iter = &(idx_start[1]);
+      continue;
+    }
+    write_iter = memcpya(write_iter, read_iter, idx_start - read_iter);
+    read_iter = &(idx_start[5]);
+    while ((read_iter != line_last) && (*read_iter != ',')) {
+      ++read_iter;
+    }
+  }
+  write_iter = memcpya(write_iter, read_iter, line_last - read_iter);
+  write_iter = strcpya(write_iter, ",IDX=");
+  write_iter = u32toa(dict_idx, write_iter);
+  *write_iter++ = '>';
+  *write_iter++ = '\n';
+  return write_iter;
+}
+
+PglErr ExportBcf(const uintptr_t* sample_include, const uint32_t* sample_include_cumulative_popcounts, const SampleIdInfo* siip, const uintptr_t* sex_male_collapsed, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const char* const* pvar_info_strs, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, ExportfFlags exportf_flags, IdpasteFlags exportf_id_paste, char exportf_id_delim, const char* xheader, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  BGZF* bgz_outfile = nullptr;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream pvar_reload_rls;
+  PreinitRLstream(&pvar_reload_rls);
+  {
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".bcf");
+    bgz_outfile = bgzf_open(outname, "w");
+    if (!bgz_outfile) {
+      goto ExportBcf_ret_OPEN_FAIL;
+    }
+#ifndef _WIN32
+    // Genotype encoding is cheap enough that compression is the bottleneck;
+    // see ExportOxGen().
+    if (max_thread_ct > 1) {
+      const uint32_t compressor_thread_ct = max_thread_ct - (max_thread_ct > 4);
+      if (bgzf_mt(bgz_outfile, MINV(128, compressor_thread_ct), 128)) {
+        goto ExportBcf_ret_NOMEM;
+      }
+    }
+#endif
+    const uint32_t dosage_force = (exportf_flags / kfExportfVcfDosageForce) & 1;
+    uint32_t write_ds = (exportf_flags / kfExportfVcfDosageDs) & 1;
+    const uint32_t write_hds = (exportf_flags / kfExportfVcfDosageHds) & 1;
+    uint32_t write_gp_or_ds = write_ds || (exportf_flags & kfExportfVcfDosageGp);
+    if (write_hds) {
+      logerrputs("Error: BCF HDS output is under development.\n");
+      reterr = kPglRetNotYetSupported;
+      goto ExportBcf_ret_1;
+    }
+    if ((!dosage_force) && write_gp_or_ds && (!(pgfip->gflags & kfPgenGlobalDosagePresent))) {
+      write_gp_or_ds = 0;
+      logerrprintf("Warning: No dosage data present.  %s field will not be exported.\n", write_ds? "DS" : "GP");
+      write_ds = 0;
+    }
+    const uint32_t all_nonref = pgfip->gflags & kfPgenGlobalAllNonref;
+    const uintptr_t* nonref_flags = pgfip->nonref_flags;
+    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
+    uint32_t write_pr = all_nonref;
+    if (nonref_flags) {
+      for (uint32_t widx = 0; widx < raw_variant_ctl; ++widx) {
+        if (variant_include[widx] & nonref_flags[widx]) {
+          write_pr = 1;
+          break;
+        }
+      }
+    }
+    const uint32_t info_pr_flag_present = (info_flags / kfInfoPrFlagPresent) & 1;
+    if (write_pr && (info_flags & kfInfoPrNonflagPresent)) {
+      logerrputs("Error: Conflicting INFO:PR fields.  Either fix all REF alleles so that the\n'provisional reference' field is no longer needed, or remove/rename the other\nINFO:PR field.\n");
+      goto ExportBcf_ret_INCONSISTENT_INPUT;
+    }
+
+    // Unlike VCF, BCF requires every FILTER and INFO key to be declared in the
+    // header, and the header must be fully assembled before its length can be
+    // written.
+    uint32_t xheader_line_ct = 0;
+    if (xheader) {
+      const char* xheader_iter = xheader;
+      const char* xheader_end = &(xheader[xheader_blen]);
+      while (1) {
+        xheader_iter = S_CAST(const char*, memchr(xheader_iter, '\n', xheader_end - xheader_iter));
+        if (!xheader_iter) {
+          break;
+        }
+        ++xheader_iter;
+        ++xheader_line_ct;
+      }
+    }
+    const uint32_t dict_capacity = xheader_line_ct + 4;
+    const uint32_t dict_htable_size = GetHtableFastSize(dict_capacity);
+    const char** dict;
+    uint32_t* dict_htable;
+    unsigned char* dict_flags;
+    unsigned char* info_types;
+    char* dict_name_storage;
+    uint32_t* chr_idx_to_contig_idx;
+    if (bigstack_alloc_kcp(dict_capacity, &dict) ||
+        bigstack_alloc_u32(dict_htable_size, &dict_htable) ||
+        bigstack_calloc_uc(dict_capacity, &dict_flags) ||
+        bigstack_calloc_uc(dict_capacity, &info_types) ||
+        bigstack_alloc_c(xheader_blen + 32, &dict_name_storage) ||
+        bigstack_alloc_u32(kChrRawEnd, &chr_idx_to_contig_idx)) {
+      goto ExportBcf_ret_NOMEM;
+    }
+    SetAllU32Arr(dict_htable_size, dict_htable);
+    SetAllU32Arr(kChrRawEnd, chr_idx_to_contig_idx);
+    char* dict_name_iter = dict_name_storage;
+    uint32_t dict_size = 0;
+    // PASS must have dictionary index 0.
+    dict_name_iter = strcpya(dict_name_iter, "PASS");
+    *dict_name_iter++ = '\0';
+    BcfDictFindOrAdd(dict_name_storage, 4, dict_htable_size, dict, dict_htable, &dict_size);
+    dict_flags[0] = kfBcfDictFilter;
+
+    unsigned char* header_mark = g_bigstack_base;
+    char* exported_sample_ids;
+    uint32_t* exported_id_htable;
+    uintptr_t max_exported_sample_id_blen;
+    if (ExportIdpaste(sample_include, siip, "bcf", sample_ct, exportf_id_paste, exportf_id_delim, &max_exported_sample_id_blen, &exported_sample_ids, &exported_id_htable)) {
+      goto ExportBcf_ret_NOMEM;
+    }
+    const uint32_t max_chr_blen = GetMaxChrSlen(cip) + 1;
+    // IDX=<n> adds at most 16 bytes per line
+    const uintptr_t header_blen_bound = 1024 + xheader_blen + 16 * S_CAST(uintptr_t, xheader_line_ct) + (max_chr_blen + 64) * S_CAST(uintptr_t, cip->chr_ct) + max_exported_sample_id_blen * sample_ct;
+    char* header_text;
+    uintptr_t* written_contig_header_lines;
+    if (bigstack_alloc_c(header_blen_bound, &header_text) ||
+        bigstack_calloc_w(BitCtToWordCt(cip->chr_ct), &written_contig_header_lines)) {
+      goto ExportBcf_ret_NOMEM;
+    }
+    char* write_iter = strcpya(header_text, "##fileformat=VCFv4.3\n##FILTER=<ID=PASS,Description=\"All filters passed\",IDX=0>\n##fileDate=");
+    time_t rawtime;
+    time(&rawtime);
+    struct tm* loctime;
+    loctime = localtime(&rawtime);
+    write_iter += strftime(write_iter, 16, "%Y%m%d", loctime);
+    write_iter = strcpya(write_iter, "\n##source=PLINKv2.00\n");
+    if (cip->chrset_source) {
+      AppendChrsetLine(cip, &write_iter);
+    }
+    uint32_t contig_ct = 0;
+    if (xheader) {
+      const char* xheader_end = &(xheader[xheader_blen]);
+      const char* line_end = xheader;
+      while (line_end != xheader_end) {
+        const char* line_start = line_end;
+        line_end = AdvPastDelim(line_start, '\n');
+        const char* line_content_end = line_end;
+        if (line_content_end[-1] == '\n') {
+          --line_content_end;
+        }
+        if ((line_content_end != line_start) && (line_content_end[-1] == '\r')) {
+          --line_content_end;
+        }
+        uint32_t is_contig = 0;
+        uint32_t cur_dict_flag = 0;
+        const char* id_start;
+        if (StrStartsWithUnsafe(line_start, "##contig=<ID=")) {
+          is_contig = 1;
+          id_start = &(line_start[strlen("##contig=<ID=")]);
+        } else if (StrStartsWithUnsafe(line_start, "##FILTER=<ID=")) {
+          cur_dict_flag = kfBcfDictFilter;
+          id_start = &(line_start[strlen("##FILTER=<ID=")]);
+        } else if (StrStartsWithUnsafe(line_start, "##INFO=<ID=")) {
+          cur_dict_flag = kfBcfDictInfo;
+          id_start = &(line_start[strlen("##INFO=<ID=")]);
+        } else if (StrStartsWithUnsafe(line_start, "##FORMAT=<ID=")) {
+          // plink2 doesn't carry FORMAT fields through .pvar files; we
+          // provide our own GT/DS/GP lines.
+          continue;
+        } else {
+          write_iter = memcpya(write_iter, line_start, line_content_end - line_start);
+          *write_iter++ = '\n';
+          continue;
+        }
+        // points to the closing '>' in a well-formed line
+        const char* line_last = &(line_content_end[-1]);
+        const char* id_end = id_start;
+        while ((id_end < line_last) && (*id_end != ',') && (*id_end != '>')) {
+          ++id_end;
+        }
+        if ((id_end == id_start) || (id_end >= line_last) || (*line_last != '>')) {
+          if (is_contig) {
+            // see ExportVcf()
+            continue;
+          }
+          snprintf(g_logbuf, kLogbufSize, "Error: Malformed header line in .pvar file: %.*s\n", S_CAST(int32_t, MINV(S_CAST(uintptr_t, line_content_end - line_start), kMaxMediumLine)), line_start);
+          goto ExportBcf_ret_MALFORMED_INPUT_WW;
+        }
+        const uint32_t id_slen = id_end - id_start;
+        if (is_contig) {
+          // GetChrCodeCounted() may mutate its input
+          char* chr_name_buf = dict_name_iter;
+          memcpy(chr_name_buf, id_start, id_slen);
+          chr_name_buf[id_slen] = '\0';
+          const uint32_t chr_idx = GetChrCodeCounted(cip, id_slen, chr_name_buf);
+          if (IsI32Neg(chr_idx)) {
+            continue;
+          }
+          const uint32_t chr_fo_idx = cip->chr_idx_to_foidx[chr_idx];
+          if (IsSet(written_contig_header_lines, chr_fo_idx)) {
+            logerrputs("Error: Duplicate ##contig line in .pvar file.\n");
+            goto ExportBcf_ret_MALFORMED_INPUT;
+          }
+          SetBit(chr_fo_idx, written_contig_header_lines);
+          chr_idx_to_contig_idx[chr_idx] = contig_ct;
+          write_iter = strcpya(write_iter, "##contig=<ID=");
+          write_iter = chrtoa(cip, chr_idx, write_iter);
+          write_iter = BcfHeaderLineCopyWithIdx(id_end, line_last, contig_ct, write_iter);
+          ++contig_ct;
+          continue;
+        }
+        if ((id_slen == 4) && (!memcmp(id_start, "PASS", 4)) && (cur_dict_flag == kfBcfDictFilter)) {
+          continue;
+        }
+        char* cur_name = dict_name_iter;
+        dict_name_iter = memcpya(dict_name_iter, id_start, id_slen);
+        *dict_name_iter++ = '\0';
+        const uint32_t dict_idx = BcfDictFindOrAdd(cur_name, id_slen, dict_htable_size, dict, dict_htable, &dict_size);
+        if (dict_idx != dict_size - 1) {
+          // already present; don't retain the duplicate name
+          dict_name_iter = cur_name;
+        }
+        if (dict_flags[dict_idx] & cur_dict_flag) {
+          snprintf(g_logbuf, kLogbufSize, "Error: Duplicate %s:%s header line in .pvar file.\n", (cur_dict_flag == kfBcfDictInfo)? "INFO" : "FILTER", dict[dict_idx]);
+          goto ExportBcf_ret_MALFORMED_INPUT_WW;
+        }
+        dict_flags[dict_idx] |= cur_dict_flag;
+        if (cur_dict_flag == kfBcfDictInfo) {
+          const char* type_start = strstr(id_end, ",Type=");
+          if ((!type_start) || (type_start > line_last)) {
+            snprintf(g_logbuf, kLogbufSize, "Error: INFO:%s header line in .pvar file is missing a Type field.\n", dict[dict_idx]);
+            goto ExportBcf_ret_MALFORMED_INPUT_WW;
+          }
+          type_start = &(type_start[strlen(",Type=")]);
+          if (StrStartsWithUnsafe(type_start, "Flag")) {
+            info_types[dict_idx] = kBcfInfoFlag;
+          } else if (StrStartsWithUnsafe(type_start, "Integer")) {
+            info_types[dict_idx] = kBcfInfoInteger;
+          } else if (StrStartsWithUnsafe(type_start, "Float")) {
+            info_types[dict_idx] = kBcfInfoFloat;
+          } else {
+            info_types[dict_idx] = kBcfInfoString;
+          }
+        }
+        write_iter = memcpya(write_iter, line_start, id_end - line_start);
+        write_iter = BcfHeaderLineCopyWithIdx(id_end, line_last, dict_idx, write_iter);
+      }
+    }
+    // fill in the missing ##contig lines.  PAR1/PAR2 are written as X, so
+    // they share X's dictionary entry.
+    const uint32_t chr_x_idx = cip->xymt_codes[kChrOffsetX];
+    uint32_t contig_zero_idx = UINT32_MAX;
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx < cip->chr_ct; ++chr_fo_idx) {
+      uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
+      if ((!IsSet(cip->chr_mask, chr_idx)) || AllBitsAreZero(variant_include, cip->chr_fo_vidx_start[chr_fo_idx], cip->chr_fo_vidx_start[chr_fo_idx + 1])) {
+        continue;
+      }
+      if ((chr_idx == cip->xymt_codes[kChrOffsetPAR1]) || (chr_idx == cip->xymt_codes[kChrOffsetPAR2])) {
+        chr_idx = chr_x_idx;
+      } else if (IsSet(written_contig_header_lines, chr_fo_idx)) {
+        continue;
+      }
+      if (chr_idx_to_contig_idx[chr_idx] != UINT32_MAX) {
+        continue;
+      }
+      char* chr_name_write_start = strcpya(write_iter, "##contig=<ID=");
+      char* chr_name_write_end = chrtoa(cip, chr_idx, chr_name_write_start);
+      if ((*chr_name_write_start == '0') && (chr_name_write_end == &(chr_name_write_start[1]))) {
+        // --allow-extra-chr 0 special case
+        if (contig_zero_idx != UINT32_MAX) {
+          chr_idx_to_contig_idx[chr_idx] = contig_zero_idx;
+          continue;
+        }
+        contig_zero_idx = contig_ct;
+        write_iter = strcpya(chr_name_write_end, ",length=2147483645");
+      } else {
+        if (memchr(chr_name_write_start, ':', chr_name_write_end - chr_name_write_start)) {
+          logerrputs("Error: BCF chromosome codes may not include the ':' character.\n");
+          goto ExportBcf_ret_MALFORMED_INPUT;
+        }
+        write_iter = strcpya(chr_name_write_end, ",length=");
+        write_iter = u32toa(variant_bps[cip->chr_fo_vidx_start[chr_fo_idx + 1] - 1] + 1, write_iter);
+      }
+      write_iter = strcpya(write_iter, ",IDX=");
+      write_iter = u32toa(contig_ct, write_iter);
+      write_iter = strcpya(write_iter, ">\n");
+      chr_idx_to_contig_idx[chr_idx] = contig_ct++;
+    }
+    uint32_t pr_dict_idx = UINT32_MAX;
+    if (write_pr && (!info_pr_flag_present)) {
+      char* cur_name = dict_name_iter;
+      dict_name_iter = strcpya(dict_name_iter, "PR");
+      *dict_name_iter++ = '\0';
+      pr_dict_idx = BcfDictFindOrAdd(cur_name, 2, dict_htable_size, dict, dict_htable, &dict_size);
+      dict_flags[pr_dict_idx] |= kfBcfDictInfo;
+      info_types[pr_dict_idx] = kBcfInfoFlag;
+      write_iter = strcpya(write_iter, "##INFO=<ID=PR,Number=0,Type=Flag,Description=\"Provisional reference allele, may not be based on real reference genome\",IDX=");
+      write_iter = u32toa(pr_dict_idx, write_iter);
+      write_iter = strcpya(write_iter, ">\n");
+    }
+    // FORMAT keys
+    uint32_t fmt_keys[2];
+    for (uint32_t fmt_idx = 0; fmt_idx < 1 + write_gp_or_ds; ++fmt_idx) {
+      const char* fmt_name = fmt_idx? (write_ds? "DS" : "GP") : "GT";
+      char* cur_name = dict_name_iter;
+      dict_name_iter = strcpya(dict_name_iter, fmt_name);
+      *dict_name_iter++ = '\0';
+      const uint32_t dict_idx = BcfDictFindOrAdd(cur_name, 2, dict_htable_size, dict, dict_htable, &dict_size);
+      fmt_keys[fmt_idx] = dict_idx;
+      if (!fmt_idx) {
+        write_iter = strcpya(write_iter, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\"");
+      } else if (write_ds) {
+        write_iter = strcpya(write_iter, "##FORMAT=<ID=DS,Number=1,Type=Float,Description=\"Estimated Alternate Allele Dosage : [P(0/1)+2*P(1/1)]\"");
+      } else {
+        write_iter = strcpya(write_iter, "##FORMAT=<ID=GP,Number=G,Type=Float,Description=\"Phred-scaled Genotype Likelihoods\"");
+      }
+      write_iter = strcpya(write_iter, ",IDX=");
+      write_iter = u32toa(dict_idx, write_iter);
+      write_iter = strcpya(write_iter, ">\n");
+    }
+    write_iter = strcpya(write_iter, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+    for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
+      *write_iter++ = '\t';
+      write_iter = strcpya(write_iter, &(exported_sample_ids[sample_idx * max_exported_sample_id_blen]));
+    }
+    *write_iter++ = '\n';
+    *write_iter++ = '\0';
+    const uint32_t l_text = write_iter - header_text;
+    if ((bgzf_write(bgz_outfile, "BCF\2\2", 5) < 0) ||
+        (bgzf_write(bgz_outfile, &l_text, 4) < 0) ||
+        (bgzf_write(bgz_outfile, header_text, l_text) < 0)) {
+      goto ExportBcf_ret_WRITE_FAIL;
+    }
+    BigstackReset(header_mark);
+
+    const uint32_t some_phased = (pgfip->gflags / kfPgenGlobalHardcallPhasePresent) & 1;
+    const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
+    const uint32_t sample_ctl2 = QuaterCtToWordCt(sample_ct);
+    const uint32_t sample_ctl2_m1 = sample_ctl2 - 1;
+    uintptr_t max_id_and_alleles_blen = 0;
+    uint32_t max_allele_ct = 2;
+    uint32_t variant_uidx = 0;
+    for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
+      MovU32To1Bit(variant_include, &variant_uidx);
+      uintptr_t variant_allele_idx_base = variant_uidx * 2;
+      uint32_t cur_allele_ct = 2;
+      if (variant_allele_idxs) {
+        variant_allele_idx_base = variant_allele_idxs[variant_uidx];
+        cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
+      }
+      const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
+      uintptr_t cur_blen = strlen(variant_ids[variant_uidx]);
+      for (uint32_t allele_idx = 0; allele_idx < cur_allele_ct; ++allele_idx) {
+        cur_blen += strlen(cur_alleles[allele_idx]);
+      }
+      if (cur_blen > max_id_and_alleles_blen) {
+        max_id_and_alleles_blen = cur_blen;
+      }
+      if (cur_allele_ct > max_allele_ct) {
+        max_allele_ct = cur_allele_ct;
+      }
+    }
+    // 32 bytes for record lengths and the fixed fields; each typed string or
+    // vector descriptor takes at most 6 bytes; each FILTER index and each
+    // INFO value takes at most 4 bytes, and the latter require at least 2
+    // bytes of text.
+    const uintptr_t max_shared_blen = 32 + max_id_and_alleles_blen + 6 * (max_allele_ct + 1) + 6 + 2 * S_CAST(uintptr_t, max_filter_slen) + 8 + 8 * S_CAST(uintptr_t, info_reload_slen + 16);
+    const uintptr_t max_indiv_blen = 32 + (2 + 12 * write_gp_or_ds) * S_CAST(uintptr_t, sample_ct);
+    const uintptr_t text_buf_blen = MAXV(max_filter_slen, info_reload_slen + 8) + 8;
+    unsigned char* recbuf;
+    char* text_buf;
+    int32_t* int_buf;
+    uintptr_t* genovec;
+    uint16_t* gt_vals;
+    if (bigstack_alloc_uc(max_shared_blen + max_indiv_blen, &recbuf) ||
+        bigstack_alloc_c(text_buf_blen, &text_buf) ||
+        bigstack_alloc_i32(text_buf_blen / 2 + 1, &int_buf) ||
+        bigstack_alloc_w(sample_ctl2, &genovec) ||
+        bigstack_alloc_u16(sample_ct, &gt_vals)) {
+      goto ExportBcf_ret_NOMEM;
+    }
+    uintptr_t* phasepresent = nullptr;
+    uintptr_t* phaseinfo = nullptr;
+    uintptr_t* prev_phased = nullptr;
+    if (some_phased) {
+      // See ExportVcf() for how homozygous calls' phase status is determined.
+      if (bigstack_alloc_w(sample_ctl, &phasepresent) ||
+          bigstack_alloc_w(sample_ctl, &phaseinfo) ||
+          bigstack_alloc_w(sample_ctl, &prev_phased)) {
+        goto ExportBcf_ret_NOMEM;
+      }
+      SetAllBits(sample_ct, prev_phased);
+    }
     uintptr_t* dosage_present = nullptr;
     Dosage* dosage_main = nullptr;
     uintptr_t* dphase_present = nullptr;
     SDosage* dphase_delta = nullptr;
-    if (write_gp_ds_or_hds) {
+    if (write_gp_or_ds) {
       if (bigstack_alloc_w(sample_ctl, &dosage_present) ||
-          bigstack_alloc_dosage(sample_ct, &dosage_main) ||
-          bigstack_alloc_w(sample_ctl, &dphase_present) ||
-          bigstack_alloc_dphase(sample_ct, &dphase_delta)) {
-        goto ExportVcf_ret_NOMEM;
+          bigstack_alloc_dosage(sample_ct, &dosage_main)) {
+        goto ExportBcf_ret_NOMEM;
+      }
+      if (some_phased) {
+        if (bigstack_alloc_w(sample_ctl, &dphase_present) ||
+            bigstack_alloc_dphase(sample_ct, &dphase_delta)) {
+          goto ExportBcf_ret_NOMEM;
+        }
       }
     }
 
+    // this may use all remaining memory, so it must come last
     char* pvar_reload_line_iter = nullptr;
     uint32_t info_col_idx = 0;
-    if (pvar_info_reload) {
+    if (pvar_info_reload && (!pvar_info_strs)) {
       reterr = PvarInfoOpenAndReloadHeader(pvar_info_reload, 1 + (max_thread_ct > 1), &pvar_reload_rls, &pvar_reload_line_iter, &info_col_idx);
       if (reterr) {
-        goto ExportVcf_ret_1;
+        goto ExportBcf_ret_1;
       }
     }
 
-    // assumes little-endian
-    uint32_t basic_genotext[4];
-    basic_genotext[0] = 0x302f3009;  // \t0/0
-    basic_genotext[1] = 0x312f3009;  // \t0/1
-    basic_genotext[2] = 0x312f3109;  // \t1/1
-    basic_genotext[3] = 0x2e2f2e09;  // \t./.
-    char haploid_genotext[4][4];
-    uint32_t haploid_genotext_blen[8];  // 4..7 = male chrX
-    memcpy(haploid_genotext[0], "\t0/0", 4);
-    memcpy(haploid_genotext[1], "\t0/1", 4);
-    memcpy(haploid_genotext[2], "\t1/1", 4);
-    memcpy(haploid_genotext[3], "\t./.", 4);
-    haploid_genotext_blen[1] = 4;
-    haploid_genotext_blen[4] = 2;
-    haploid_genotext_blen[5] = 4;
-    haploid_genotext_blen[6] = 2;
-    haploid_genotext_blen[7] = 2;
-    // don't bother exporting GP for hardcalls
-    // usually don't bother for DS, but DS-force is an exception
-    char dosage_inttext[16];  // 4..7 = haploid, 5 should never be looked up
-    memcpy(dosage_inttext, ":0:1:2:.:0:.:1:.", 16);
+    logprintfww5("--export bcf to %s ... ", outname);
+    fputs("0%", stdout);
+    fflush(stdout);
     const char* dot_ptr = &(g_one_char_strs[92]);
-    const uint32_t sample_ctl2_m1 = sample_ctl2 - 1;
+    // GT values are (allele index + 1) * 2, plus 1 for phased; the phase bit
+    // goes on the second allele.  A haploid call's second slot is filled with
+    // int8 vector_end.
+    const uint16_t kGtVectorEnd = 0x8100;
+    uint16_t diploid_gt[4];
+    uint16_t haploid_gt[4];
+    diploid_gt[1] = 0x0402;
+    diploid_gt[3] = 0;
+    haploid_gt[1] = 0x0402;
+    haploid_gt[3] = kGtVectorEnd;
     uint32_t chr_fo_idx = UINT32_MAX;
     uint32_t chr_end = 0;
-    uint32_t chr_buf_blen = 0;
-    uint32_t variant_uidx = 0;
+    uint32_t contig_idx = 0;
     uint32_t is_x = 0;
-    uint32_t is_haploid = 0;  // includes chrX and chrY
+    uint32_t is_haploid = 0;
     uint32_t pct = 0;
     uint32_t next_print_variant_idx = variant_ct / 100;
     uint32_t rls_variant_uidx = 0;
     uint32_t ref_allele_idx = 0;
     uint32_t alt1_allele_idx = 1;
     uint32_t cur_allele_ct = 2;
+    variant_uidx = 0;
     for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
-      // a lot of this is redundant with write_pvar(), may want to factor the
-      // commonalities out
       MovU32To1Bit(variant_include, &variant_uidx);
       if (variant_uidx >= chr_end) {
         do {
@@ -3863,38 +5932,13 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
           chr_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
         } while (variant_uidx >= chr_end);
         uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
-        is_x = (chr_idx == cip->xymt_codes[kChrOffsetX]);
+        is_x = (chr_idx == chr_x_idx);
         is_haploid = IsSet(cip->haploid_mask, chr_idx);
-        // forced --merge-par, with diploid male output (is_x NOT set, but
-        // chromosome code is X/chrX)
         if ((chr_idx == cip->xymt_codes[kChrOffsetPAR1]) || (chr_idx == cip->xymt_codes[kChrOffsetPAR2])) {
-          chr_idx = cip->xymt_codes[kChrOffsetX];
-        }
-        char* chr_name_end = chrtoa(cip, chr_idx, chr_buf);
-        *chr_name_end = '\t';
-        chr_buf_blen = 1 + S_CAST(uintptr_t, chr_name_end - chr_buf);
-        if (is_haploid) {
-          if (is_x) {
-            haploid_genotext_blen[0] = 4;
-            haploid_genotext_blen[2] = 4;
-            haploid_genotext_blen[3] = 4;
-          } else {
-            haploid_genotext_blen[0] = 2;
-            haploid_genotext_blen[2] = 2;
-            haploid_genotext_blen[3] = 2;
-          }
+          chr_idx = chr_x_idx;
         }
+        contig_idx = chr_idx_to_contig_idx[chr_idx];
       }
-      // #CHROM
-      write_iter = memcpya(write_iter, chr_buf, chr_buf_blen);
-
-      // POS
-      write_iter = u32toa_x(variant_bps[variant_uidx], '\t', write_iter);
-
-      // ID
-      write_iter = strcpyax(write_iter, variant_ids[variant_uidx], '\t');
-
-      // REF, ALT
       uintptr_t variant_allele_idx_base = variant_uidx * 2;
       if (variant_allele_idxs) {
         variant_allele_idx_base = variant_allele_idxs[variant_uidx];
@@ -3904,464 +5948,243 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
       if (refalt1_select) {
         ref_allele_idx = refalt1_select[variant_uidx * 2];
         alt1_allele_idx = refalt1_select[variant_uidx * 2 + 1];
-        // this logic only works in the biallelic case
+        // genotype encoding logic only works in the biallelic case
         assert(cur_allele_ct == 2);
-        if (!is_haploid) {
-          if (alt1_allele_idx) {
-            basic_genotext[0] = 0x302f3009;
-            basic_genotext[2] = 0x312f3109;
-          } else {
-            basic_genotext[0] = 0x312f3109;
-            basic_genotext[2] = 0x302f3009;
-          }
-        } else {
-          if (alt1_allele_idx) {
-            memcpy(haploid_genotext[0], "\t0/0", 4);
-            memcpy(haploid_genotext[2], "\t1/1", 4);
-          } else {
-            memcpy(haploid_genotext[0], "\t1/1", 4);
-            memcpy(haploid_genotext[2], "\t0/0", 4);
-          }
-        }
-        if (alt1_allele_idx) {
-          memcpy(dosage_inttext, ":0:1:2:.:0:.:1:.", 16);
-        } else {
-          memcpy(dosage_inttext, ":2:1:0:.:1:.:0:.", 16);
-        }
-      }
-      if (cur_alleles[ref_allele_idx] != dot_ptr) {
-        write_iter = strcpya(write_iter, cur_alleles[ref_allele_idx]);
-      } else {
-        *write_iter++ = 'N';
       }
-      *write_iter++ = '\t';
-      write_iter = strcpya(write_iter, cur_alleles[alt1_allele_idx]);
-      if (flexbwrite_ck(writebuf_flush, outfile, bgz_outfile, &write_iter)) {
-        goto ExportVcf_ret_WRITE_FAIL;
-      }
-      if (cur_allele_ct > 2) {
-        SetAllBits(cur_allele_ct, allele_include);
-        ClearBit(ref_allele_idx, allele_include);
-        ClearBit(alt1_allele_idx, allele_include);
-        uint32_t cur_allele_uidx = 0;
-        uint32_t alt_allele_idx = 2;
-        do {
-          *write_iter++ = ',';
-          MovU32To1Bit(allele_include, &cur_allele_uidx);
-          write_iter = strcpya(write_iter, cur_alleles[cur_allele_uidx++]);
-          if (flexbwrite_ck(writebuf_flush, outfile, bgz_outfile, &write_iter)) {
-            goto ExportVcf_ret_WRITE_FAIL;
-          }
-        } while (++alt_allele_idx < cur_allele_ct);
+      const char* ref_allele = cur_alleles[ref_allele_idx];
+      if (ref_allele == dot_ptr) {
+        ref_allele = "N";
       }
+      const uint32_t ref_slen = strlen(ref_allele);
 
-      // QUAL
-      *write_iter++ = '\t';
+      // fixed fields
+      unsigned char* write_iter_uc = &(recbuf[8]);
+      const uint32_t pos0 = variant_bps[variant_uidx] - 1;
+      memcpy(write_iter_uc, &contig_idx, 4);
+      memcpy(&(write_iter_uc[4]), &pos0, 4);
+      memcpy(&(write_iter_uc[8]), &ref_slen, 4);
+      unsigned char* n_info_ptr = &(write_iter_uc[16]);
+      write_iter_uc = &(write_iter_uc[12]);
       if ((!pvar_qual_present) || (!IsSet(pvar_qual_present, variant_uidx))) {
-        *write_iter++ = '.';
+        write_iter_uc = BcfAppendFloatBits(kBcfFloatMissingBits, write_iter_uc);
+      } else {
+        write_iter_uc = BcfAppendFloat(pvar_quals[variant_uidx], write_iter_uc);
+      }
+      write_iter_uc = &(write_iter_uc[8]);
+
+      // ID, alleles
+      const char* cur_id = variant_ids[variant_uidx];
+      if ((cur_id[0] == '.') && (!cur_id[1])) {
+        *write_iter_uc++ = kBcfTypeChar;
       } else {
-        write_iter = ftoa_g(pvar_quals[variant_uidx], write_iter);
+        write_iter_uc = BcfAppendTypedStr(cur_id, strlen(cur_id), write_iter_uc);
+      }
+      write_iter_uc = BcfAppendTypedStr(ref_allele, ref_slen, write_iter_uc);
+      write_iter_uc = BcfAppendTypedStr(cur_alleles[alt1_allele_idx], strlen(cur_alleles[alt1_allele_idx]), write_iter_uc);
+      for (uint32_t allele_idx = 0; allele_idx < cur_allele_ct; ++allele_idx) {
+        if ((allele_idx != ref_allele_idx) && (allele_idx != alt1_allele_idx)) {
+          write_iter_uc = BcfAppendTypedStr(cur_alleles[allele_idx], strlen(cur_alleles[allele_idx]), write_iter_uc);
+        }
       }
 
       // FILTER
-      *write_iter++ = '\t';
+      char* bad_key = nullptr;
+      uint32_t item_ct;
       if ((!pvar_filter_present) || (!IsSet(pvar_filter_present, variant_uidx))) {
-        *write_iter++ = '.';
+        *write_iter_uc++ = kBcfTypeNull;
       } else if (!IsSet(pvar_filter_npass, variant_uidx)) {
-        write_iter = strcpya(write_iter, "PASS");
+        *write_iter_uc++ = 0x10 | kBcfTypeInt8;
+        *write_iter_uc++ = 0;
       } else {
-        write_iter = strcpya(write_iter, pvar_filter_storage[variant_uidx]);
+        strcpy(text_buf, pvar_filter_storage[variant_uidx]);
+        write_iter_uc = BcfEncodeFilterOrInfo(dict, dict_htable, dict_flags, info_types, dict_htable_size, 0, text_buf, int_buf, &item_ct, write_iter_uc, &bad_key);
+        if (!write_iter_uc) {
+          snprintf(g_logbuf, kLogbufSize, "Error: FILTER key '%s' is not declared in the .pvar header.  (This is required for BCF export.)\n", bad_key);
+          goto ExportBcf_ret_INCONSISTENT_INPUT_WW;
+        }
       }
 
       // INFO
-      *write_iter++ = '\t';
       const uint32_t is_pr = all_nonref || (nonref_flags && IsSet(nonref_flags, variant_uidx));
-      if (pvar_reload_line_iter) {
-        reterr = PvarInfoReloadAndWrite(info_pr_flag_present, info_col_idx, variant_uidx, is_pr, &pvar_reload_rls, &pvar_reload_line_iter, &write_iter, &rls_variant_uidx);
-        if (reterr) {
-          goto ExportVcf_ret_1;
-        }
-      } else {
-        if (is_pr) {
-          write_iter = strcpya(write_iter, "PR");
+      uint32_t info_ct = 0;
+      if (pvar_info_strs || pvar_reload_line_iter) {
+        char* text_iter = text_buf;
+        if (pvar_info_strs) {
+          PvarInfoWrite(info_pr_flag_present, is_pr, K_CAST(char*, pvar_info_strs[variant_uidx]), &text_iter);
         } else {
-          *write_iter++ = '.';
+          reterr = PvarInfoReloadAndWrite(info_pr_flag_present, info_col_idx, variant_uidx, is_pr, &pvar_reload_rls, &pvar_reload_line_iter, &text_iter, &rls_variant_uidx);
+          if (reterr) {
+            goto ExportBcf_ret_1;
+          }
         }
-      }
-
-      // FORMAT
-      write_iter = memcpyl3a(write_iter, "\tGT");
+        *text_iter = '\0';
+        if ((text_buf[0] != '.') || text_buf[1]) {
+          write_iter_uc = BcfEncodeFilterOrInfo(dict, dict_htable, dict_flags, info_types, dict_htable_size, 1, text_buf, int_buf, &info_ct, write_iter_uc, &bad_key);
+          if (!write_iter_uc) {
+            snprintf(g_logbuf, kLogbufSize, "Error: INFO key '%s' is either not declared in the .pvar header (this is required for BCF export), or has an invalid value on variant '%s'.\n", bad_key, cur_id);
+            goto ExportBcf_ret_INCONSISTENT_INPUT_WW;
+          }
+        }
+      } else if (is_pr) {
+        write_iter_uc = BcfAppendTypedUint(pr_dict_idx, write_iter_uc);
+        *write_iter_uc++ = kBcfTypeNull;
+        info_ct = 1;
+      }
+      const uint32_t n_info_allele = info_ct | (cur_allele_ct << 16);
+      memcpy(n_info_ptr, &n_info_allele, 4);
+      unsigned char* indiv_start = write_iter_uc;
 
+      // GT, and DS/GP if applicable
       uint32_t dosage_ct = 0;
       uint32_t dphase_ct = 0;
-      uint32_t inner_loop_last = kBitsPerWordD2 - 1;
-      uint32_t widx = 0;
+      uint32_t at_least_one_phase_present = 0;
       if (!some_phased) {
-        // biallelic, nothing phased in entire file
-        if (!write_gp_ds_or_hds) {
+        if (!write_gp_or_ds) {
           reterr = PgrGet(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec);
         } else {
           reterr = PgrGetD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
         }
-        if (reterr) {
-          goto ExportVcf_ret_PGR_FAIL;
-        }
-        if ((!dosage_ct) && (!dosage_force)) {
-          if (!is_haploid) {
-            // always 4 bytes wide, exploit that
-            uint32_t* write_iter_ui_alias = R_CAST(uint32_t*, write_iter);
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                *write_iter_ui_alias++ = basic_genotext[genovec_word & 3];
-                genovec_word >>= 2;
-              }
-              ++widx;
-            }
-            write_iter = R_CAST(char*, write_iter_ui_alias);
-          } else {
-            // chrX: male homozygous/missing calls use only one character + tab
-            // other haploid/MT: this is true for nonmales too
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t sex_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                const uint32_t cur_is_male = sex_male_hw & 1;
-                write_iter = memcpya(write_iter, haploid_genotext[cur_geno], haploid_genotext_blen[cur_geno + cur_is_male * 4]);
-                genovec_word >>= 2;
-                sex_male_hw >>= 1;
-              }
-              ++widx;
-            }
-          }
-        } else {
-          // some dosages present, or DS-force
-          if (write_ds) {
-            write_iter = memcpyl3a(write_iter, ":DS");
-            if (!dosage_ct) {
-              // DS-force, need to clear this
-              ZeroWArr(sample_ctl, dosage_present);
-            }
-          } else {
-            write_iter = memcpyl3a(write_iter, ":GP");
-          }
-          if (!alt1_allele_idx) {
-            BiallelicDosage16Invert(dosage_ct, dosage_main);
-          }
-          Dosage* dosage_main_iter = dosage_main;
-          if (!is_haploid) {
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                write_iter = memcpya(write_iter, &(basic_genotext[cur_geno]), 4);
-                if (dosage_present_hw & 1) {
-                  *write_iter++ = ':';
-                  const uint32_t dosage_int = *dosage_main_iter++;
-                  write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
-                } else if (dosage_force) {
-                  write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
-                }
-                genovec_word >>= 2;
-                dosage_present_hw >>= 1;
-              }
-              ++widx;
-            }
-          } else {
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t sex_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
-              uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                const uint32_t cur_is_male = sex_male_hw & 1;
-                const uint32_t cur_genotext_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
-                write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_genotext_blen);
-                if (dosage_present_hw & 1) {
-                  *write_iter++ = ':';
-                  uint32_t dosage_int = *dosage_main_iter++;
-                  if (cur_genotext_blen == 2) {
-                    if (write_ds) {
-                      write_iter = HaploidDosagePrint(dosage_int, write_iter);
-                    } else {
-                      write_iter = HaploidDosagePrint(kDosageMax - dosage_int, write_iter);
-                      *write_iter++ = ',';
-                      write_iter = HaploidDosagePrint(dosage_int, write_iter);
-                    }
-                  } else {
-                    // het haploid, or female X
-                    write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
-                  }
-                } else if (dosage_force) {
-                  write_iter = memcpya(write_iter, &(dosage_inttext[2 * cur_geno + 16 - 4 * cur_genotext_blen]), 2);
-                }
-                genovec_word >>= 2;
-                sex_male_hw >>= 1;
-                dosage_present_hw >>= 1;
-              }
-              ++widx;
-            }
-          }
-        }
       } else {
-        // biallelic, phased
-        uint32_t at_least_one_phase_present;
-        if (!write_gp_ds_or_hds) {
+        if (!write_gp_or_ds) {
           reterr = PgrGetP(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec, phasepresent, phaseinfo, &at_least_one_phase_present);
         } else {
           reterr = PgrGetDp(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec, phasepresent, phaseinfo, &at_least_one_phase_present, dosage_present, dosage_main, &dosage_ct, dphase_present, dphase_delta, &dphase_ct);
         }
-        if (reterr) {
-          goto ExportVcf_ret_PGR_FAIL;
+      }
+      if (reterr) {
+        goto ExportBcf_ret_PGR_FAIL;
+      }
+      if (!at_least_one_phase_present) {
+        // zero this out if phasepresent_ct == 0
+        if (phasepresent) {
+          ZeroWArr(sample_ctl, phasepresent);
         }
-        at_least_one_phase_present = (at_least_one_phase_present != 0);
-        if ((!dosage_ct) && (!dosage_force)) {
-          if (!is_haploid) {
-            uint32_t* write_iter_ui_alias = R_CAST(uint32_t*, write_iter);
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
-
-              // zero this out if phasepresent_ct == 0
-              const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
-
-              const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uintptr_t cur_geno = genovec_word & 3;
-
-                // usually "\t0/0", etc.
-                uint32_t cur_basic_genotext = basic_genotext[cur_geno];
-                if (cur_geno == 1) {
-                  const uint32_t cur_shift = (1U << sample_idx_lowbits);
-                  if (phasepresent_halfword & cur_shift) {
-                    prev_phased_halfword |= cur_shift;
-                    if (phaseinfo_halfword & cur_shift) {
-                      cur_basic_genotext ^= 0x1000100;  // 0|1 -> 1|0
-                    }
-                  } else {
-                    prev_phased_halfword &= ~cur_shift;
-                  }
-                }
-                // '/' = ascii 47, '|' = ascii 124
-                *write_iter_ui_alias++ = cur_basic_genotext + 0x4d0000 * ((prev_phased_halfword >> sample_idx_lowbits) & 1);
-                genovec_word >>= 2;
-              }
-              R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
-              ++widx;
-            }
-            write_iter = R_CAST(char*, write_iter_ui_alias);
-          } else {
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t is_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
-              uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
-
-              // zero this out if phasepresent_ct == 0
-              const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
-
-              const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                const uint32_t cur_is_male = is_male_hw & 1;
-                const uint32_t cur_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
-                write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_blen);
-                if (cur_blen == 4) {
-                  if (cur_geno == 1) {
-                    // a bit redundant with how is_male_hw is handled, but
-                    // updating this on every loop iteration doesn't seem better
-                    const uint32_t cur_shift = (1U << sample_idx_lowbits);
-                    if (phasepresent_halfword & cur_shift) {
-                      prev_phased_halfword |= cur_shift;
-                      if (phaseinfo_halfword & cur_shift) {
-                        memcpy(&(write_iter[-4]), "\t1|0", 4);
-                      } else {
-                        write_iter[-2] = '|';
-                      }
-                    } else {
-                      prev_phased_halfword &= ~cur_shift;
-                    }
-                  } else if ((prev_phased_halfword >> sample_idx_lowbits) & 1) {
-                    write_iter[-2] = '|';
+      }
+      if (alt1_allele_idx) {
+        diploid_gt[0] = 0x0202;
+        diploid_gt[2] = 0x0404;
+      } else {
+        diploid_gt[0] = 0x0404;
+        diploid_gt[2] = 0x0202;
+      }
+      haploid_gt[0] = kGtVectorEnd | (diploid_gt[0] & 0xff);
+      haploid_gt[2] = kGtVectorEnd | (diploid_gt[2] & 0xff);
+      uint32_t inner_loop_last = kBitsPerWordD2 - 1;
+      uint16_t* gt_vals_iter = gt_vals;
+      for (uint32_t widx = 0; ; ++widx) {
+        if (widx >= sample_ctl2_m1) {
+          if (widx > sample_ctl2_m1) {
+            break;
+          }
+          inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+        }
+        uintptr_t genovec_word = genovec[widx];
+        // male chrX, or all samples on other haploid chromosomes
+        uint32_t haploid_hw = is_haploid? (is_x? R_CAST(const Halfword*, sex_male_collapsed)[widx] : UINT32_MAX) : 0;
+        uint32_t prev_phased_hw = 0;
+        uint32_t phasepresent_hw = 0;
+        uint32_t phaseinfo_hw = 0;
+        if (some_phased) {
+          prev_phased_hw = R_CAST(Halfword*, prev_phased)[widx];
+          phasepresent_hw = R_CAST(Halfword*, phasepresent)[widx];
+          phaseinfo_hw = R_CAST(Halfword*, phaseinfo)[widx];
+        }
+        for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+          const uint32_t cur_geno = genovec_word & 3;
+          const uint32_t cur_shift = 1U << sample_idx_lowbits;
+          uint32_t cur_gt;
+          if ((cur_geno != 1) && (haploid_hw & cur_shift)) {
+            cur_gt = haploid_gt[cur_geno];
+          } else {
+            cur_gt = diploid_gt[cur_geno];
+            if (some_phased) {
+              if (cur_geno == 1) {
+                if (phasepresent_hw & cur_shift) {
+                  prev_phased_hw |= cur_shift;
+                  if (phaseinfo_hw & cur_shift) {
+                    // 1|0
+                    cur_gt = 0x0204;
                   }
+                } else {
+                  prev_phased_hw &= ~cur_shift;
                 }
-                genovec_word >>= 2;
-                is_male_hw >>= 1;
               }
-              R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
-              ++widx;
-            }
-          }
-        } else {
-          // both dosage (or DS-force) and phase present
-          if (write_ds) {
-            write_iter = memcpyl3a(write_iter, ":DS");
-            if (!dosage_ct) {
-              ZeroWArr(sample_ctl, dosage_present);
+              if (prev_phased_hw & cur_shift) {
+                cur_gt |= 0x100;
+              }
             }
-          } else {
-            write_iter = memcpyl3a(write_iter, ":GP");
-          }
-          if (!alt1_allele_idx) {
-            BiallelicDosage16Invert(dosage_ct, dosage_main);
           }
-          Dosage* dosage_main_iter = dosage_main;
-          if (!is_haploid) {
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
-
-              // zero this out if phasepresent_ct == 0
-              const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
-
-              const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
-              const uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
-              uint32_t cur_shift = 1;
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                write_iter = memcpya(write_iter, &(basic_genotext[cur_geno]), 4);
-                if (cur_geno == 1) {
-                  if (phasepresent_halfword & cur_shift) {
-                    prev_phased_halfword |= cur_shift;
-                    if (phaseinfo_halfword & cur_shift) {
-                      memcpy(&(write_iter[-4]), "\t1|0", 4);
-                    }
-                  } else {
-                    prev_phased_halfword &= ~cur_shift;
-                  }
-                }
-                if (prev_phased_halfword & cur_shift) {
-                  write_iter[-2] = '|';
-                }
-                if (dosage_present_hw & cur_shift) {
-                  *write_iter++ = ':';
-                  const uint32_t dosage_int = *dosage_main_iter++;
-                  write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
-                } else if (dosage_force) {
-                  write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
-                }
-                genovec_word >>= 2;
-                cur_shift <<= 1;
+          *gt_vals_iter++ = cur_gt;
+          genovec_word >>= 2;
+        }
+        if (some_phased) {
+          R_CAST(Halfword*, prev_phased)[widx] = prev_phased_hw;
+        }
+      }
+      const uint32_t write_dosage_field = write_gp_or_ds && (dosage_ct || dosage_force);
+      write_iter_uc = BcfAppendTypedUint(fmt_keys[0], write_iter_uc);
+      write_iter_uc = BcfAppendTypeDescriptor(2, kBcfTypeInt8, write_iter_uc);
+      write_iter_uc = memcpyua(write_iter_uc, gt_vals, sample_ct * sizeof(int16_t));
+      if (write_dosage_field) {
+        if (!dosage_ct) {
+          // DS-force, need to clear this
+          ZeroWArr(sample_ctl, dosage_present);
+        }
+        if (!alt1_allele_idx) {
+          BiallelicDosage16Invert(dosage_ct, dosage_main);
+        }
+        write_iter_uc = BcfAppendTypedUint(fmt_keys[1], write_iter_uc);
+        write_iter_uc = BcfAppendTypeDescriptor(write_ds? 1 : 3, kBcfTypeFloat, write_iter_uc);
+        const Dosage* dosage_main_iter = dosage_main;
+        const uint16_t* gt_vals_iter2 = gt_vals;
+        for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
+          const uint32_t cur_gt = *gt_vals_iter2++;
+          const uint32_t cur_is_haploid = (cur_gt >> 8) == 0x81;
+          if (IsSet(dosage_present, sample_idx)) {
+            const uint32_t dosage_int = *dosage_main_iter++;
+            if (cur_is_haploid) {
+              if (write_ds) {
+                write_iter_uc = BcfAppendFloat(S_CAST(float, dosage_int) * (1.0f / kDosageMax), write_iter_uc);
+              } else {
+                write_iter_uc = BcfAppendFloat(S_CAST(float, kDosageMax - dosage_int) * (1.0f / kDosageMax), write_iter_uc);
+                write_iter_uc = BcfAppendFloat(S_CAST(float, dosage_int) * (1.0f / kDosageMax), write_iter_uc);
+                write_iter_uc = BcfAppendFloatBits(kBcfFloatVectorEndBits, write_iter_uc);
               }
-              R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
-              ++widx;
+            } else if (write_ds) {
+              write_iter_uc = BcfAppendFloat(S_CAST(float, dosage_int) * (1.0f / kDosageMid), write_iter_uc);
+            } else if (dosage_int <= kDosageMid) {
+              write_iter_uc = BcfAppendFloat(S_CAST(float, kDosageMid - dosage_int) * (1.0f / kDosageMid), write_iter_uc);
+              write_iter_uc = BcfAppendFloat(S_CAST(float, dosage_int) * (1.0f / kDosageMid), write_iter_uc);
+              write_iter_uc = BcfAppendFloat(0.0f, write_iter_uc);
+            } else {
+              write_iter_uc = BcfAppendFloat(0.0f, write_iter_uc);
+              write_iter_uc = BcfAppendFloat(S_CAST(float, kDosageMax - dosage_int) * (1.0f / kDosageMid), write_iter_uc);
+              write_iter_uc = BcfAppendFloat(S_CAST(float, dosage_int - kDosageMid) * (1.0f / kDosageMid), write_iter_uc);
             }
+            continue;
+          }
+          // only DS can be forced
+          if (dosage_force && (cur_gt & 0xfe)) {
+            // ALT allele count, read back from the GT encoding
+            const uint32_t alt_ct = ((cur_gt & 0xfe) == 4) + ((!cur_is_haploid) && ((cur_gt & 0xfe00) == 0x400));
+            write_iter_uc = BcfAppendFloat(S_CAST(float, alt_ct), write_iter_uc);
           } else {
-            while (1) {
-              if (widx >= sample_ctl2_m1) {
-                if (widx > sample_ctl2_m1) {
-                  break;
-                }
-                inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
-              }
-              uintptr_t genovec_word = genovec[widx];
-              uint32_t is_male_hw = is_x * (R_CAST(const Halfword*, sex_male_collapsed)[widx]);
-              uint32_t prev_phased_halfword = R_CAST(Halfword*, prev_phased)[widx];
-
-              // zero this out if phasepresent_ct == 0
-              const uint32_t phasepresent_halfword = at_least_one_phase_present * (R_CAST(Halfword*, phasepresent)[widx]);
-
-              const uint32_t phaseinfo_halfword = R_CAST(Halfword*, phaseinfo)[widx];
-              const uint32_t dosage_present_hw = R_CAST(Halfword*, dosage_present)[widx];
-              uint32_t cur_shift = 1;
-              for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
-                const uint32_t cur_geno = genovec_word & 3;
-                const uint32_t cur_is_male = is_male_hw & 1;
-                const uint32_t cur_blen = haploid_genotext_blen[cur_geno + cur_is_male * 4];
-                write_iter = memcpya(write_iter, haploid_genotext[cur_geno], cur_blen);
-                if (cur_blen == 4) {
-                  if (cur_geno == 1) {
-                    if (phasepresent_halfword & cur_shift) {
-                      prev_phased_halfword |= cur_shift;
-                      if (phaseinfo_halfword & cur_shift) {
-                        memcpy(&(write_iter[-4]), "\t1|0", 4);
-                      }
-                    } else {
-                      prev_phased_halfword &= ~cur_shift;
-                    }
-                  }
-                  if (prev_phased_halfword & cur_shift) {
-                    write_iter[-2] = '|';
-                  }
-                  if (dosage_present_hw & cur_shift) {
-                    *write_iter++ = ':';
-                    const uint32_t dosage_int = *dosage_main_iter++;
-                    write_iter = DiploidVcfDosagePrint(dosage_int, write_ds, write_iter);
-                  } else if (dosage_force) {
-                    write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2]), 2);
-                  }
-                } else {
-                  if (dosage_present_hw & cur_shift) {
-                    *write_iter++ = ':';
-                    const uint32_t dosage_int = *dosage_main_iter++;
-                    if (write_ds) {
-                      write_iter = HaploidDosagePrint(dosage_int, write_iter);
-                    } else {
-                      write_iter = HaploidDosagePrint(kDosageMax - dosage_int, write_iter);
-                      *write_iter++ = ',';
-                      write_iter = HaploidDosagePrint(dosage_int, write_iter);
-                    }
-                  } else if (dosage_force) {
-                    write_iter = memcpya(write_iter, &(dosage_inttext[cur_geno * 2 + 8]), 2);
-                  }
-                }
-                genovec_word >>= 2;
-                is_male_hw >>= 1;
-                cur_shift <<= 1;
-              }
-              R_CAST(Halfword*, prev_phased)[widx] = prev_phased_halfword;
-              ++widx;
+            write_iter_uc = BcfAppendFloatBits(kBcfFloatMissingBits, write_iter_uc);
+            if (!write_ds) {
+              write_iter_uc = BcfAppendFloatBits(kBcfFloatVectorEndBits, write_iter_uc);
+              write_iter_uc = BcfAppendFloatBits(kBcfFloatVectorEndBits, write_iter_uc);
             }
           }
         }
       }
-      // todo: multiallelic cases (separate out cur_allele_ct <= 10)
-      AppendBinaryEoln(&write_iter);
-      if (flexbwrite_ck(writebuf_flush, outfile, bgz_outfile, &write_iter)) {
-        goto ExportVcf_ret_WRITE_FAIL;
+      const uint32_t l_shared = indiv_start - (&(recbuf[8]));
+      const uint32_t l_indiv = write_iter_uc - indiv_start;
+      memcpy(recbuf, &l_shared, 4);
+      memcpy(&(recbuf[4]), &l_indiv, 4);
+      const uint32_t n_sample_fmt = sample_ct | ((1 + write_dosage_field) << 24);
+      memcpy(&(recbuf[28]), &n_sample_fmt, 4);
+      if (bgzf_write(bgz_outfile, recbuf, write_iter_uc - recbuf) < 0) {
+        goto ExportBcf_ret_WRITE_FAIL;
       }
       if (variant_idx >= next_print_variant_idx) {
         if (pct > 10) {
@@ -4373,22 +6196,11 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
         next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
       }
     }
-    if (write_iter != writebuf) {
-      if (flexbwrite_flush(writebuf, write_iter - writebuf, outfile, bgz_outfile)) {
-        goto ExportVcf_ret_WRITE_FAIL;
-      }
-    }
-    if (bgz_outfile) {
-      if (bgzf_close(bgz_outfile)) {
-        bgz_outfile = nullptr;
-        goto ExportVcf_ret_WRITE_FAIL;
-      }
+    if (bgzf_close(bgz_outfile)) {
       bgz_outfile = nullptr;
-    } else {
-      if (fclose_null(&outfile)) {
-        goto ExportVcf_ret_WRITE_FAIL;
-      }
+      goto ExportBcf_ret_WRITE_FAIL;
     }
+    bgz_outfile = nullptr;
     if (pct > 10) {
       putc_unlocked('\b', stdout);
     }
@@ -4396,29 +6208,35 @@ PglErr ExportVcf(const uintptr_t* sample_include, const uint32_t* sample_include
     logprintf("done.\n");
   }
   while (0) {
-  ExportVcf_ret_NOMEM:
+  ExportBcf_ret_NOMEM:
     reterr = kPglRetNomem;
     break;
-  ExportVcf_ret_OPEN_FAIL:
+  ExportBcf_ret_OPEN_FAIL:
     reterr = kPglRetOpenFail;
     break;
-  ExportVcf_ret_WRITE_FAIL:
+  ExportBcf_ret_WRITE_FAIL:
     reterr = kPglRetWriteFail;
     break;
-  ExportVcf_ret_MALFORMED_INPUT:
+  ExportBcf_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+  ExportBcf_ret_MALFORMED_INPUT:
     reterr = kPglRetMalformedInput;
     break;
-  ExportVcf_ret_INCONSISTENT_INPUT:
-    reterr = kPglRetMalformedInput;
+  ExportBcf_ret_INCONSISTENT_INPUT_WW:
+    logputs("\n");
+    WordWrapB(0);
+    logerrputsb();
+  ExportBcf_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
     break;
-  ExportVcf_ret_PGR_FAIL:
+  ExportBcf_ret_PGR_FAIL:
     if (reterr != kPglRetReadFail) {
       logputs("\n");
       logerrputs("Error: Malformed .pgen file.\n");
     }
   }
- ExportVcf_ret_1:
-  fclose_cond(outfile);
+ ExportBcf_ret_1:
   CleanupRLstream(&pvar_reload_rls);
   if (bgz_outfile) {
     bgzf_close(bgz_outfile);
@@ -4547,16 +6365,102 @@ THREAD_FUNC_DECL DosageTransposeThread(void* arg) {
   }
 }
 
+// Reads variant_include[] (all samples in g_sample_include) until either
+// capacity_variant_ct would be exceeded by the next read block or all
+// variants have been read, transposing into g_smaj_dosagebuf.  Analogous to
+// TransposeToSmajLoadChunk().
+static PglErr Export012SmajLoadChunk(const uintptr_t* variant_include, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t read_block_size, uint32_t capacity_variant_ct, uint32_t calc_thread_ct, unsigned char** main_loadbufs, PgenFileInfo* pgfip, ThreadsState* tsp, uint32_t* parity_ptr, uint32_t* read_block_idx_ptr, uint32_t* next_block_write_ct_ptr, uint32_t* variant_idx_ptr, uint32_t* chunk_variant_ct_ptr, uint32_t* pct_ptr, uint32_t* next_print_idx_ptr) {
+  const uint32_t read_block_sizel = BitCtToWordCt(read_block_size);
+  const uint32_t read_block_ct_m1 = (raw_variant_ct - 1) / read_block_size;
+  uint32_t parity = *parity_ptr;
+  uint32_t read_block_idx = *read_block_idx_ptr;
+  uint32_t cur_block_write_ct = *next_block_write_ct_ptr;
+  uint32_t variant_idx = *variant_idx_ptr;
+  uint32_t pct = *pct_ptr;
+  uint32_t next_print_idx = *next_print_idx_ptr;
+  uint32_t chunk_variant_ct = 0;
+  ReinitThreads3z(tsp);
+  while (1) {
+    if (!tsp->is_last_block) {
+      const uint32_t read_block_uidx_start = read_block_idx * read_block_size;
+      const uint32_t cur_read_block_size = (read_block_idx == read_block_ct_m1)? (raw_variant_ct - read_block_uidx_start) : read_block_size;
+      if (PgfiMultiread(variant_include, read_block_uidx_start, read_block_uidx_start + cur_read_block_size, cur_block_write_ct, pgfip)) {
+        return kPglRetReadFail;
+      }
+    }
+    if (chunk_variant_ct) {
+      JoinThreads3z(tsp);
+      const PglErr reterr = g_error_ret;
+      if (reterr) {
+        return reterr;
+      }
+      if (tsp->is_last_block) {
+        break;
+      }
+    }
+    g_cur_block_write_ct = cur_block_write_ct;
+    ComputePartitionAligned(variant_include, calc_thread_ct, read_block_idx * read_block_size, chunk_variant_ct, cur_block_write_ct, kDosagePerCacheline, g_read_variant_uidx_starts, g_write_vidx_starts);
+    for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+      g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
+      g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+    }
+    const uint32_t is_not_first_block = (chunk_variant_ct != 0);
+    variant_idx += cur_block_write_ct;
+    chunk_variant_ct += cur_block_write_ct;
+    cur_block_write_ct = 0;
+    if (variant_idx != variant_ct) {
+      // find next nonempty block
+      do {
+        ++read_block_idx;
+        if (read_block_idx == read_block_ct_m1) {
+          cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(raw_variant_ct - read_block_idx * read_block_size));
+          break;
+        }
+        cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
+      } while (!cur_block_write_ct);
+    }
+    tsp->is_last_block = (variant_idx == variant_ct) || (chunk_variant_ct + cur_block_write_ct > capacity_variant_ct);
+    tsp->thread_func_ptr = DosageTransposeThread;
+    if (SpawnThreads3z(is_not_first_block, tsp)) {
+      return kPglRetThreadCreateFail;
+    }
+    parity = 1 - parity;
+    pgfip->block_base = main_loadbufs[parity];
+    if ((variant_idx != variant_ct) && (variant_idx >= next_print_idx)) {
+      if (pct > 10) {
+        putc_unlocked('\b', stdout);
+      }
+      pct = (variant_idx * 100LLU) / variant_ct;
+      printf("\b\b%u%%", pct++);
+      fflush(stdout);
+      next_print_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+    }
+  }
+  *parity_ptr = parity;
+  *read_block_idx_ptr = read_block_idx;
+  *next_block_write_ct_ptr = cur_block_write_ct;
+  *variant_idx_ptr = variant_idx;
+  *chunk_variant_ct_ptr = chunk_variant_ct;
+  *pct_ptr = pct;
+  *next_print_idx_ptr = next_print_idx;
+  return kPglRetSuccess;
+}
+
 static_assert(sizeof(Dosage) == 2, "Export012Smaj() needs to be updated.");
 PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const uintptr_t* variant_include, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t include_dom, uint32_t include_uncounted, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, char exportf_delim, PgenFileInfo* pgfip) {
   unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
   ThreadsState ts;
   InitThreads3z(&ts);
   FILE* outfile = nullptr;
+  FILE* smaj_tmpfile = nullptr;
+  char* smaj_tmpname = nullptr;
   PglErr reterr = kPglRetSuccess;
   {
     // Write header line; then fully load-and-transpose the first X samples,
-    // flush them, load-and-transpose the next X, etc.
+    // flush them, load-and-transpose the next X, etc.  When a reasonably wide
+    // variant chunk fits for all samples, the .pgen is instead read once and
+    // transposed through a temporary file.
     // Similar to ExportIndMajorBed() and Export012Vmaj().
     // Priority is making the with-dosage case work well, since plink 1.9
     // already handles the no-dosage case.
@@ -4704,7 +6608,8 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     //   calc_thread_ct * kDosagePerCacheline * read_sample_ct *
     //     sizeof(Dosage) for per-thread dosage_main buffers
     //   (dosage_ct buffers just go on the thread stacks)
-    //   read_sample_ct * variant_ct * sizeof(Dosage) for g_smaj_dosagebuf
+    //   read_sample_ct * RoundUpPow2(variant_ct, kDosagePerCacheline) *
+    //     sizeof(Dosage) for g_smaj_dosagebuf
     // This is about
     //   read_sample_ct *
     //     (calc_thread_ct * kDosagePerCacheline * 2.375 + variant_ct * 2)
@@ -4717,17 +6622,48 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     bytes_avail -= kCacheline + calc_thread_ct * kDosagePerCacheline * (2 * kCacheline);
     uint32_t read_sample_ct = sample_ct;
     uint32_t pass_ct = 1;
-    const uintptr_t bytes_per_sample = calc_thread_ct * (kDosagePerCacheline / 8) * (3LLU + 8 * sizeof(Dosage)) + variant_ct * sizeof(Dosage);
+    uint32_t capacity_variant_ct = variant_ct;
+    uint32_t is_external = 0;
+    uint32_t* chunk_variant_cts = nullptr;
+    const uintptr_t thread_bytes_per_sample = calc_thread_ct * (kDosagePerCacheline / 8) * (3LLU + 8 * sizeof(Dosage));
+    const uintptr_t bytes_per_sample = thread_bytes_per_sample + RoundUpPow2(variant_ct, kDosagePerCacheline) * sizeof(Dosage);
     if ((sample_ct * S_CAST(uint64_t, bytes_per_sample)) > bytes_avail) {
-      read_sample_ct = bytes_avail / bytes_per_sample;
-      if (!read_sample_ct) {
+      // Not enough memory to transpose everything at once.  If rows of at
+      // least 16 cachelines of dosages fit for every sample, transpose variant
+      // chunks to a temporary file of sample-major tiles and merge them in
+      // sample order (one .pgen read, like ExportIndMajorBed()); otherwise
+      // reread the .pgen once per sample range.
+      // Chunks other than the last are more than half full, and contain at
+      // least 8 * kDosagePerCacheline variants.
+      const uint32_t outname_slen = strlen(outname);
+      if (bigstack_end_alloc_c(outname_slen + 16, &smaj_tmpname) ||
+          bigstack_end_alloc_u32(1 + variant_ct / (8 * kDosagePerCacheline), &chunk_variant_cts)) {
         goto Export012Smaj_ret_NOMEM;
       }
-      if (read_sample_ct > 4) {
-        read_sample_ct = RoundDownPow2(read_sample_ct, 4);
+      const uintptr_t end_alloc_byte_ct = bigstack_end_mark - g_bigstack_end;
+      const uintptr_t bytes_avail_per_sample = (bytes_avail > end_alloc_byte_ct)? ((bytes_avail - end_alloc_byte_ct) / sample_ct) : 0;
+      if (bytes_avail_per_sample >= thread_bytes_per_sample + 16 * kCacheline) {
+        is_external = 1;
+        snprintf(memcpya(smaj_tmpname, outname, outname_slen), 16, ".smaj-temporary");
+        capacity_variant_ct = RoundDownPow2((bytes_avail_per_sample - thread_bytes_per_sample) / sizeof(Dosage), kDosagePerCacheline);
+        while (read_block_size > capacity_variant_ct / 2) {
+          read_block_size /= 2;
+        }
+      } else {
+        BigstackEndReset(bigstack_end_mark);
+        smaj_tmpname = nullptr;
+        chunk_variant_cts = nullptr;
+        read_sample_ct = bytes_avail / bytes_per_sample;
+        if (!read_sample_ct) {
+          goto Export012Smaj_ret_NOMEM;
+        }
+        if (read_sample_ct > 4) {
+          read_sample_ct = RoundDownPow2(read_sample_ct, 4);
+        }
+        pass_ct = 1 + (sample_ct - 1) / read_sample_ct;
       }
-      pass_ct = 1 + (sample_ct - 1) / read_sample_ct;
     }
+    unsigned char* chunk_alloc_base = g_bigstack_base;
     uintptr_t read_sample_ctaw = BitCtToAlignedWordCt(read_sample_ct);
     uintptr_t read_sample_ctaw2 = QuaterCtToAlignedWordCt(read_sample_ct);
     for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
@@ -4739,7 +6675,7 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     g_refalt1_select = refalt1_select;
     g_calc_thread_ct = calc_thread_ct;
     g_sample_ct = read_sample_ct;
-    g_stride = RoundUpPow2(variant_ct, kDosagePerCacheline);
+    g_stride = RoundUpPow2(capacity_variant_ct, kDosagePerCacheline);
     g_smaj_dosagebuf = S_CAST(Dosage*, bigstack_alloc_raw_rd(read_sample_ct * S_CAST(uintptr_t, g_stride) * sizeof(Dosage)));
     g_error_ret = kPglRetSuccess;
 
@@ -4751,124 +6687,180 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     const uintptr_t max_maternal_id_blen = piip->parental_id_info.max_maternal_id_blen;
     const uint32_t read_block_sizel = BitCtToWordCt(read_block_size);
     const uint32_t read_block_ct_m1 = (raw_variant_ct - 1) / read_block_size;
-    uint32_t sample_uidx_start = AdvTo1Bit(orig_sample_include, 0);
-    for (uint32_t pass_idx = 0; pass_idx < pass_ct; ++pass_idx) {
-      memcpy(sample_include, orig_sample_include, raw_sample_ctl * sizeof(intptr_t));
-      if (sample_uidx_start) {
-        ClearBitsNz(0, sample_uidx_start, sample_include);
-      }
-      uint32_t sample_uidx_end;
-      if (pass_idx + 1 == pass_ct) {
-        read_sample_ct = sample_ct - pass_idx * read_sample_ct;
-        g_sample_ct = read_sample_ct;
-        sample_uidx_end = raw_sample_ct;
-        read_sample_ctaw = BitCtToAlignedWordCt(read_sample_ct);
-        read_sample_ctaw2 = QuaterCtToAlignedWordCt(read_sample_ct);
-      } else {
-        sample_uidx_end = FindNth1BitFrom(orig_sample_include, sample_uidx_start + 1, read_sample_ct);
-        ClearBitsNz(sample_uidx_end, raw_sample_ct, sample_include);
+    // Main workflow:
+    // 1. Set n=0, load first calc_thread_ct * kDosagePerCacheline
+    //    post-filtering variants
+    //
+    // 2. Spawn threads processing batch n
+    // 3. Load batch (n+1) unless eof
+    // 4. Join threads
+    // 5. Increment n by 1
+    // 6. Goto step 2 unless eof
+    uint32_t parity = 0;
+    uint32_t read_block_idx = 0;
+    uint32_t next_block_write_ct = 0;
+    uint32_t variant_idx = 0;
+    uint32_t pct = 0;
+    uint32_t next_print_idx = 0;
+    uint32_t chunk_ct = 0;
+    Dosage* merge_rows = nullptr;
+    if (is_external) {
+      if (fopen_checked(smaj_tmpname, FOPEN_WB, &smaj_tmpfile)) {
+        goto Export012Smaj_ret_OPEN_FAIL;
       }
+      memcpy(sample_include, orig_sample_include, raw_sample_ctl * sizeof(intptr_t));
       FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
       g_sample_include = sample_include;
       g_sample_include_cumulative_popcounts = sample_include_cumulative_popcounts;
-      if (pass_idx) {
-        ReinitThreads3z(&ts);
-        pgfip->block_base = main_loadbufs[0];
-        for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
-          PgrClearLdCache(g_pgr_ptrs[tidx]);
-          g_pgr_ptrs[tidx]->fi.block_base = main_loadbufs[0];
-          g_pgr_ptrs[tidx]->fi.block_offset = 0;
+      printf("--export A%s: transposing to %s... 0%%", include_dom? "D" : "", smaj_tmpname);
+      fflush(stdout);
+      while (1) {
+        if (read_block_idx == read_block_ct_m1) {
+          next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(raw_variant_ct - read_block_idx * read_block_size));
+          break;
+        }
+        next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
+        if (next_block_write_ct) {
+          break;
+        }
+        ++read_block_idx;
+      }
+      next_print_idx = variant_ct / 100;
+      while (variant_idx != variant_ct) {
+        uint32_t chunk_variant_ct = 0;
+        reterr = Export012SmajLoadChunk(variant_include, raw_variant_ct, variant_ct, read_block_size, capacity_variant_ct, calc_thread_ct, main_loadbufs, pgfip, &ts, &parity, &read_block_idx, &next_block_write_ct, &variant_idx, &chunk_variant_ct, &pct, &next_print_idx);
+        if (reterr) {
+          if (reterr == kPglRetMalformedInput) {
+            logputs("\n");
+            logerrputs("Error: Malformed .pgen file.\n");
+          }
+          goto Export012Smaj_ret_1;
+        }
+        chunk_variant_cts[chunk_ct++] = chunk_variant_ct;
+        const Dosage* cur_dosage_row = g_smaj_dosagebuf;
+        for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
+          fwrite_unlocked(cur_dosage_row, chunk_variant_ct * sizeof(Dosage), 1, smaj_tmpfile);
+          cur_dosage_row = &(cur_dosage_row[g_stride]);
+        }
+        if (ferror_unlocked(smaj_tmpfile)) {
+          goto Export012Smaj_ret_WRITE_FAIL;
         }
       }
+      if (fclose_null(&smaj_tmpfile)) {
+        goto Export012Smaj_ret_WRITE_FAIL;
+      }
+      if (pct > 10) {
+        fputs("\b \b", stdout);
+      }
+      fputs("\b\bdone.\n", stdout);
+      // Merge phase: each pass reads a batch of full-width rows back.
+      BigstackReset(chunk_alloc_base);
+      if (fopen_checked(smaj_tmpname, FOPEN_RB, &smaj_tmpfile)) {
+        goto Export012Smaj_ret_OPEN_FAIL;
+      }
+      read_sample_ct = (bigstack_left() - kCacheline) / (variant_ct * sizeof(Dosage));
+      if (read_sample_ct > sample_ct) {
+        read_sample_ct = sample_ct;
+      }
+      if ((!read_sample_ct) || bigstack_alloc_dosage(read_sample_ct * S_CAST(uintptr_t, variant_ct), &merge_rows)) {
+        goto Export012Smaj_ret_NOMEM;
+      }
+      pass_ct = 1 + (sample_ct - 1) / read_sample_ct;
+    }
+    const uint32_t full_read_sample_ct = read_sample_ct;
+    uint32_t sample_uidx_start = AdvTo1Bit(orig_sample_include, 0);
+    for (uint32_t pass_idx = 0; pass_idx < pass_ct; ++pass_idx) {
+      uint32_t sample_uidx_end = raw_sample_ct;
+      if (pass_idx + 1 == pass_ct) {
+        read_sample_ct = sample_ct - pass_idx * full_read_sample_ct;
+      } else {
+        sample_uidx_end = FindNth1BitFrom(orig_sample_include, sample_uidx_start + 1, read_sample_ct);
+      }
+      const Dosage* cur_dosage_row;
+      uintptr_t row_stride;
       putc_unlocked('\r', stdout);
       printf("--export A%s pass %u/%u: loading... 0%%", include_dom? "D" : "", pass_idx + 1, pass_ct);
       fflush(stdout);
-      // Main workflow:
-      // 1. Set n=0, load first calc_thread_ct * kDosagePerCacheline
-      //    post-filtering variants
-      //
-      // 2. Spawn threads processing batch n
-      // 3. Load batch (n+1) unless eof
-      // 4. Join threads
-      // 5. Increment n by 1
-      // 6. Goto step 2 unless eof
-      uint32_t parity = 0;
-      uint32_t read_block_idx = 0;
-      uint32_t variant_idx = 0;
-      uint32_t cur_read_block_size = read_block_size;
-      uint32_t pct = 0;
-      uint32_t next_print_idx = variant_ct / 100;
-      while (1) {
-        uintptr_t cur_block_write_ct = 0;
-        if (!ts.is_last_block) {
-          while (read_block_idx < read_block_ct_m1) {
-            cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
-            if (cur_block_write_ct) {
-              break;
-            }
-            ++read_block_idx;
-          }
-          if (read_block_idx == read_block_ct_m1) {
-            cur_read_block_size = raw_variant_ct - (read_block_idx * read_block_size);
-            cur_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(cur_read_block_size));
-          }
-          if (PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_write_ct, pgfip)) {
-            goto Export012Smaj_ret_THREAD_CREATE_FAIL;
+      if (is_external) {
+        const uint32_t sample_idx_start = pass_idx * full_read_sample_ct;
+        uint64_t chunk_fpos = 0;
+        uint32_t chunk_vidx_start = 0;
+        for (uint32_t chunk_idx = 0; chunk_idx < chunk_ct; ++chunk_idx) {
+          const uint32_t chunk_variant_ct = chunk_variant_cts[chunk_idx];
+          const uintptr_t tile_row_byte_ct = chunk_variant_ct * sizeof(Dosage);
+          if (fseeko(smaj_tmpfile, chunk_fpos + sample_idx_start * S_CAST(uint64_t, tile_row_byte_ct), SEEK_SET)) {
+            goto Export012Smaj_ret_READ_FAIL;
           }
-        }
-        if (variant_idx) {
-          JoinThreads3z(&ts);
-          reterr = g_error_ret;
-          if (reterr) {
-            if (reterr == kPglRetMalformedInput) {
-              logputs("\n");
-              logerrputs("Error: Malformed .pgen file.\n");
+          Dosage* merge_row_iter = &(merge_rows[chunk_vidx_start]);
+          for (uint32_t sample_idx = 0; sample_idx < read_sample_ct; ++sample_idx) {
+            if (fread_checked(merge_row_iter, tile_row_byte_ct, smaj_tmpfile)) {
+              goto Export012Smaj_ret_READ_FAIL;
             }
-            goto Export012Smaj_ret_1;
+            merge_row_iter = &(merge_row_iter[variant_ct]);
           }
+          chunk_fpos += sample_ct * S_CAST(uint64_t, tile_row_byte_ct);
+          chunk_vidx_start += chunk_variant_ct;
+        }
+        cur_dosage_row = merge_rows;
+        row_stride = variant_ct;
+      } else {
+        memcpy(sample_include, orig_sample_include, raw_sample_ctl * sizeof(intptr_t));
+        if (sample_uidx_start) {
+          ClearBitsNz(0, sample_uidx_start, sample_include);
+        }
+        if (sample_uidx_end != raw_sample_ct) {
+          ClearBitsNz(sample_uidx_end, raw_sample_ct, sample_include);
         }
-        if (!ts.is_last_block) {
-          g_cur_block_write_ct = cur_block_write_ct;
-          ComputePartitionAligned(variant_include, calc_thread_ct, read_block_idx * read_block_size, variant_idx, cur_block_write_ct, kDosagePerCacheline, g_read_variant_uidx_starts, g_write_vidx_starts);
+        FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
+        g_sample_include = sample_include;
+        g_sample_include_cumulative_popcounts = sample_include_cumulative_popcounts;
+        g_sample_ct = read_sample_ct;
+        if (pass_idx) {
+          pgfip->block_base = main_loadbufs[0];
           for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
-            g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
-            g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
-          }
-          ts.is_last_block = (variant_idx + cur_block_write_ct == variant_ct);
-          ts.thread_func_ptr = DosageTransposeThread;
-          if (SpawnThreads3z(read_block_idx, &ts)) {
-            goto Export012Smaj_ret_THREAD_CREATE_FAIL;
+            PgrClearLdCache(g_pgr_ptrs[tidx]);
+            g_pgr_ptrs[tidx]->fi.block_base = main_loadbufs[0];
+            g_pgr_ptrs[tidx]->fi.block_offset = 0;
           }
         }
-        parity = 1 - parity;
-        if (variant_idx == variant_ct) {
-          break;
+        parity = 0;
+        read_block_idx = 0;
+        while (1) {
+          if (read_block_idx == read_block_ct_m1) {
+            next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(raw_variant_ct - read_block_idx * read_block_size));
+            break;
+          }
+          next_block_write_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), read_block_sizel);
+          if (next_block_write_ct) {
+            break;
+          }
+          ++read_block_idx;
         }
-        if (variant_idx >= next_print_idx) {
-          if (pct > 10) {
-            putc_unlocked('\b', stdout);
+        variant_idx = 0;
+        pct = 0;
+        next_print_idx = variant_ct / 100;
+        uint32_t chunk_variant_ct;
+        reterr = Export012SmajLoadChunk(variant_include, raw_variant_ct, variant_ct, read_block_size, variant_ct, calc_thread_ct, main_loadbufs, pgfip, &ts, &parity, &read_block_idx, &next_block_write_ct, &variant_idx, &chunk_variant_ct, &pct, &next_print_idx);
+        if (reterr) {
+          if (reterr == kPglRetMalformedInput) {
+            logputs("\n");
+            logerrputs("Error: Malformed .pgen file.\n");
           }
-          pct = (variant_idx * 100LLU) / variant_ct;
-          printf("\b\b%u%%", pct++);
-          fflush(stdout);
-          next_print_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+          goto Export012Smaj_ret_1;
         }
-
-        ++read_block_idx;
-        variant_idx += cur_block_write_ct;
-        pgfip->block_base = main_loadbufs[parity];
-      }
-      if (pct > 10) {
-        fputs("\b \b", stdout);
+        if (pct > 10) {
+          fputs("\b \b", stdout);
+        }
+        cur_dosage_row = g_smaj_dosagebuf;
+        row_stride = g_stride;
       }
       fputs("\b\b\b\b\b\b\b\b\b\b\b\b\bwriting... 0%", stdout);
       fflush(stdout);
       pct = 0;
       next_print_idx = read_sample_ct / 100;
       uint32_t sample_uidx = sample_uidx_start;
-      const Dosage* cur_dosage_row = g_smaj_dosagebuf;
       for (uint32_t sample_idx = 0; sample_idx < read_sample_ct; ++sample_idx, ++sample_uidx) {
-        MovU32To1Bit(sample_include, &sample_uidx);
+        MovU32To1Bit(orig_sample_include, &sample_uidx);
         const char* cur_sample_fid = &(sample_ids[sample_uidx * max_sample_id_blen]);
         const char* fid_end = AdvToDelim(cur_sample_fid, '\t');
         write_iter = memcpyax(write_iter, cur_sample_fid, fid_end - cur_sample_fid, exportf_delim);
@@ -4909,7 +6901,7 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
           }
         }
         AppendBinaryEoln(&write_iter);
-        cur_dosage_row = &(cur_dosage_row[g_stride]);
+        cur_dosage_row = &(cur_dosage_row[row_stride]);
         if (sample_idx >= next_print_idx) {
           if (pct > 10) {
             putc_unlocked('\b', stdout);
@@ -4928,6 +6920,12 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     if (fclose_flush_null(writebuf_flush, write_iter, &outfile)) {
       goto Export012Smaj_ret_WRITE_FAIL;
     }
+    if (smaj_tmpname) {
+      fclose_cond(smaj_tmpfile);
+      smaj_tmpfile = nullptr;
+      unlink(smaj_tmpname);
+      smaj_tmpname = nullptr;
+    }
     fputs("\b\bdone.\n", stdout);
     logprintfww("--export A%s: %s written.\n", include_dom? "D" : "", outname);
   }
@@ -4938,6 +6936,9 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
   Export012Smaj_ret_OPEN_FAIL:
     reterr = kPglRetOpenFail;
     break;
+  Export012Smaj_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
   Export012Smaj_ret_WRITE_FAIL:
     reterr = kPglRetWriteFail;
     break;
@@ -4945,19 +6946,21 @@ PglErr Export012Smaj(const char* outname, const uintptr_t* orig_sample_include,
     logerrputsb();
     reterr = kPglRetInconsistentInput;
     break;
-  Export012Smaj_ret_THREAD_CREATE_FAIL:
-    reterr = kPglRetThreadCreateFail;
-    break;
   }
  Export012Smaj_ret_1:
   CleanupThreads3z(&ts, &g_cur_block_write_ct);
   fclose_cond(outfile);
+  if (smaj_tmpname) {
+    fclose_cond(smaj_tmpfile);
+    unlink(smaj_tmpname);
+  }
   pgfip->block_base = nullptr;
   BigstackReset(bigstack_mark);
+  BigstackEndReset(bigstack_end_mark);
   return reterr;
 }
 
-PglErr Exportf(const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const double* variant_cms, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, MakePlink2Flags make_plink2_flags, ExportfFlags exportf_flags, IdpasteFlags exportf_id_paste, char exportf_id_delim, __maybe_unused uint32_t exportf_bits, uintptr_t pgr_alloc_cacheline_ct, char* xheader, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+PglErr Exportf(const uintptr_t* sample_include, const PedigreeIdInfo* piip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* refalt1_select, const uintptr_t* pvar_qual_present, const float* pvar_quals, const uintptr_t* pvar_filter_present, const uintptr_t* pvar_filter_npass, const char* const* pvar_filter_storage, const char* pvar_info_reload, const char* const* pvar_info_strs, const double* variant_cms, uintptr_t xheader_blen, InfoFlags info_flags, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t max_filter_slen, uint32_t info_reload_slen, uint32_t max_thread_ct, MakePlink2Flags make_plink2_flags, ExportfFlags exportf_flags, IdpasteFlags exportf_id_paste, char exportf_id_delim, __maybe_unused uint32_t exportf_bits, uintptr_t pgr_alloc_cacheline_ct, char* xheader, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   PglErr reterr = kPglRetSuccess;
   {
@@ -4982,8 +6985,8 @@ PglErr Exportf(const uintptr_t* sample_include, const PedigreeIdInfo* piip, cons
     if (exportf_flags & (kfExportf01 | kfExportf12)) {
       // todo
     }
-    if (exportf_flags & (kfExportfTypemask - kfExportfIndMajorBed - kfExportfVcf - kfExportfOxGen - kfExportfBgen11 - kfExportfBgen12 - kfExportfBgen13 - kfExportfHaps - kfExportfHapsLegend - kfExportfATranspose - kfExportfA - kfExportfAD)) {
-      logerrputs("Error: Only VCF, oxford, bgen-1.x, haps, hapslegend, A, AD, A-transpose, and\nind-major-bed output have been implemented so far.\n");
+    if (exportf_flags & (kfExportfTypemask - kfExportfIndMajorBed - kfExportfBcf - kfExportfVcf - kfExportfOxGen - kfExportfBgen11 - kfExportfBgen12 - kfExportfBgen13 - kfExportfHaps - kfExportfHapsLegend - kfExportfATranspose - kfExportfA - kfExportfAD)) {
+      logerrputs("Error: Only BCF, VCF, oxford, bgen-1.x, haps, hapslegend, A, AD, A-transpose,\nand ind-major-bed output have been implemented so far.\n");
       reterr = kPglRetNotYetSupported;
       goto Exportf_ret_1;
     }
@@ -5047,9 +7050,15 @@ PglErr Exportf(const uintptr_t* sample_include, const PedigreeIdInfo* piip, cons
       }
       logputs("done.\n");
     }
-    if (exportf_flags & kfExportfVcf) {
+    if (exportf_flags & kfExportfBcf) {
       PgrClearLdCache(simple_pgrp);
-      reterr = ExportVcf(sample_include, sample_include_cumulative_popcounts, &(piip->sii), sex_male_collapsed, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, pvar_info_reload, xheader_blen, info_flags, sample_ct, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, max_thread_ct, exportf_flags, exportf_id_paste, exportf_id_delim, xheader, pgfip, simple_pgrp, outname, outname_end);
+      reterr = ExportBcf(sample_include, sample_include_cumulative_popcounts, &(piip->sii), sex_male_collapsed, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, pvar_info_reload, pvar_info_strs, xheader_blen, info_flags, sample_ct, raw_variant_ct, variant_ct, max_filter_slen, info_reload_slen, max_thread_ct, exportf_flags, exportf_id_paste, exportf_id_delim, xheader, pgfip, simple_pgrp, outname, outname_end);
+      if (reterr) {
+        goto Exportf_ret_1;
+      }
+    }
+    if (exportf_flags & kfExportfVcf) {
+      reterr = ExportVcf(sample_include, sample_include_cumulative_popcounts, &(piip->sii), sex_male_collapsed, variant_include, cip, variant_bps, variant_ids, variant_allele_idxs, allele_storage, refalt1_select, pvar_qual_present, pvar_quals, pvar_filter_present, pvar_filter_npass, pvar_filter_storage, pvar_info_reload, pvar_info_strs, xheader_blen, info_flags, sample_ct, raw_variant_ct, variant_ct, max_allele_slen, max_filter_slen, info_reload_slen, max_thread_ct, exportf_flags, exportf_id_paste, exportf_id_delim, pgr_alloc_cacheline_ct, xheader, pgfip, outname, outname_end);
       if (reterr) {
         goto Exportf_ret_1;
       }
@@ -19,6 +19,14 @@
 #include "plink2_random.h"
 #include "plink2_stats.h"  // HweThresh(), etc.
 
+#ifndef NO_MMAP
+#  include <sys/types.h>  // fstat()
+#  include <sys/stat.h>  // open(), fstat()
+#  include <sys/mman.h>  // mmap()
+#  include <fcntl.h>  // open()
+#  include <unistd.h>  // close()
+#endif
+
 #ifdef __cplusplus
 namespace plink2 {
 #endif
@@ -3486,24 +3494,59 @@ PglErr SetRefalt1FromFile(const uintptr_t* variant_include, const char* const* v
   return reterr;
 }
 
+// Returns the index of the unique allele matching the reference sequence at
+// cur_ref, -1 if there is none, or -2 if there are several.
+static int32_t GetFaConsistentAlleleIdx(const char* const* cur_alleles, const char* cur_ref, uint32_t cur_allele_ct) {
+  int32_t consistent_allele_idx = -1;
+  for (uint32_t allele_idx = 0; allele_idx < cur_allele_ct; ++allele_idx) {
+    const char* cur_allele = cur_alleles[allele_idx];
+    const uint32_t cur_allele_slen = strlen(cur_allele);
+    if (strcaseequal(cur_allele, cur_ref, cur_allele_slen)) {
+      if (consistent_allele_idx != -1) {
+        // Multiple alleles could be ref (this always happens for deletions).
+        // Don't try to do anything.
+        return -2;
+      }
+      consistent_allele_idx = allele_idx;
+    }
+  }
+  return consistent_allele_idx;
+}
+
+// Returns 1 (after printing an error) if this is fatal.
+static BoolErr RefFromFaShortContig(const ChrInfo* cip, uint32_t chr_idx, uint32_t force) {
+  char* write_iter = strcpya(g_logbuf, force? "Warning: Contig '" : "Error: Contig '");
+  write_iter = chrtoa(cip, chr_idx, write_iter);
+  if (!force) {
+    snprintf(write_iter, kLogbufSize - kMaxIdSlen - 32, "' in --ref-from-fa file is too short; it is likely to be mismatched with your data. Add the 'force' modifier if this wasn't a mistake, and you just want to mark all reference alleles past the end as provisional.\n");
+  } else {
+    snprintf(write_iter, kLogbufSize - kMaxIdSlen - 32, "' in --ref-from-fa file is too short; it is likely to be mismatched with your data.\n");
+  }
+  WordWrapB(0);
+  logerrputsb();
+  return !force;
+}
+
+static void RefFromFaConflictErrprint(const ChrInfo* cip, uint32_t chr_idx, uint32_t bp, uint32_t is_mismatch) {
+  char* write_iter = strcpya(g_logbuf, is_mismatch? "Error: Reference allele at " : "Error: --ref-from-fa wants to change reference allele assignment at ");
+  write_iter = chrtoa(cip, chr_idx, write_iter);
+  *write_iter++ = ':';
+  write_iter = u32toa(bp, write_iter);
+  if (is_mismatch) {
+    snprintf(write_iter, kLogbufSize - kMaxIdSlen - 64, " is marked as 'known', but is inconsistent with .fa file. Add the 'force' modifier to downgrade it to provisional.\n");
+  } else {
+    snprintf(write_iter, kLogbufSize - kMaxIdSlen - 128, ", but it's marked as 'known'. Add the 'force' modifier to force this change through.\n");
+  }
+  WordWrapB(0);
+  logerrputsb();
+}
+
 PglErr RefFromFaProcessContig(const uintptr_t* variant_include, const uint32_t* variant_bps, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const ChrInfo* cip, uint32_t force, uint32_t chr_fo_idx, uint32_t variant_uidx_last, char* seqbuf, char* seqbuf_end, AltAlleleCt* refalt1_select, uintptr_t* nonref_flags, uint32_t* changed_ct_ptr, uint32_t* validated_ct_ptr, uint32_t* downgraded_ct_ptr) {
   uint32_t variant_uidx = AdvTo1Bit(variant_include, cip->chr_fo_vidx_start[chr_fo_idx]);
   const uint32_t bp_end = seqbuf_end - seqbuf;
   if (variant_bps[variant_uidx_last] >= bp_end) {
-    const uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
-    if (!force) {
-      char* write_iter = strcpya(g_logbuf, "Error: Contig '");
-      write_iter = chrtoa(cip, chr_idx, write_iter);
-      snprintf(write_iter, kLogbufSize - kMaxIdSlen - 32, "' in --ref-from-fa file is too short; it is likely to be mismatched with your data. Add the 'force' modifier if this wasn't a mistake, and you just want to mark all reference alleles past the end as provisional.\n");
-      WordWrapB(0);
-      logerrputsb();
+    if (RefFromFaShortContig(cip, cip->chr_file_order[chr_fo_idx], force)) {
       return kPglRetInconsistentInput;
-    } else {
-      char* write_iter = strcpya(g_logbuf, "Warning: Contig '");
-      write_iter = chrtoa(cip, chr_idx, write_iter);
-      snprintf(write_iter, kLogbufSize - kMaxIdSlen - 32, "' in --ref-from-fa file is too short; it is likely to be mismatched with your data.\n");
-      WordWrapB(0);
-      logerrputsb();
     }
     uint32_t offset = CountSortedSmallerU32(&(variant_bps[variant_uidx]), variant_uidx_last - variant_uidx, bp_end);
 
@@ -3558,33 +3601,11 @@ PglErr RefFromFaProcessContig(const uintptr_t* variant_include, const uint32_t*
       variant_allele_idx_base = variant_allele_idxs[variant_uidx];
       cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
     }
-    const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
-    const char* cur_ref = &(seqbuf[cur_bp]);
-    int32_t consistent_allele_idx = -1;
-    for (uint32_t allele_idx = 0; allele_idx < cur_allele_ct; ++allele_idx) {
-      const char* cur_allele = cur_alleles[allele_idx];
-      const uint32_t cur_allele_slen = strlen(cur_allele);
-      if (strcaseequal(cur_allele, cur_ref, cur_allele_slen)) {
-        if (consistent_allele_idx != -1) {
-          // Multiple alleles could be ref (this always happens for deletions).
-          // Don't try to do anything.
-          consistent_allele_idx = -2;
-          break;
-        }
-        consistent_allele_idx = allele_idx;
-      }
-    }
+    const int32_t consistent_allele_idx = GetFaConsistentAlleleIdx(&(allele_storage[variant_allele_idx_base]), &(seqbuf[cur_bp]), cur_allele_ct);
     if (consistent_allele_idx >= 0) {
       if (consistent_allele_idx) {
         if ((!IsSet(nonref_flags, variant_uidx)) && (!force)) {
-          const uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
-          char* write_iter = strcpya(g_logbuf, "Error: --ref-from-fa wants to change reference allele assignment at ");
-          write_iter = chrtoa(cip, chr_idx, write_iter);
-          *write_iter++ = ':';
-          write_iter = u32toa(cur_bp, write_iter);
-          snprintf(write_iter, kLogbufSize - kMaxIdSlen - 128, ", but it's marked as 'known'. Add the 'force' modifier to force this change through.\n");
-          WordWrapB(0);
-          logerrputsb();
+          RefFromFaConflictErrprint(cip, cip->chr_file_order[chr_fo_idx], cur_bp, 0);
           return kPglRetInconsistentInput;
         }
         refalt1_select[2 * variant_uidx] = consistent_allele_idx;
@@ -3597,14 +3618,7 @@ PglErr RefFromFaProcessContig(const uintptr_t* variant_include, const uint32_t*
     } else if ((consistent_allele_idx == -1) && (!IsSet(nonref_flags, variant_uidx))) {
       // okay to have multiple matches, but not zero matches
       if (!force) {
-        const uint32_t chr_idx = cip->chr_file_order[chr_fo_idx];
-        char* write_iter = strcpya(g_logbuf, "Error: Reference allele at ");
-        write_iter = chrtoa(cip, chr_idx, write_iter);
-        *write_iter++ = ':';
-        write_iter = u32toa(cur_bp, write_iter);
-        snprintf(write_iter, kLogbufSize - kMaxIdSlen - 64, " is marked as 'known', but is inconsistent with .fa file. Add the 'force' modifier to downgrade it to provisional.\n");
-        WordWrapB(0);
-        logerrputsb();
+        RefFromFaConflictErrprint(cip, cip->chr_file_order[chr_fo_idx], cur_bp, 1);
         return kPglRetInconsistentInput;
       }
       SetBit(variant_uidx, nonref_flags);
@@ -3620,7 +3634,7 @@ PglErr RefFromFaProcessContig(const uintptr_t* variant_include, const uint32_t*
   }
 }
 
-PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const ChrInfo* cip, const char* fname, uint32_t max_allele_slen, uint32_t force, AltAlleleCt* refalt1_select, uintptr_t* nonref_flags) {
+static PglErr RefFromFaStream(const uintptr_t* variant_include, const uint32_t* variant_bps, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const ChrInfo* cip, const char* fname, uint32_t max_allele_slen, uint32_t force, AltAlleleCt* refalt1_select, uintptr_t* nonref_flags, uint32_t* changed_ct_ptr, uint32_t* validated_ct_ptr, uint32_t* downgraded_ct_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   uintptr_t line_idx = 0;
   PglErr reterr = kPglRetSuccess;
@@ -3632,7 +3646,7 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
     uintptr_t* chr_already_seen;
     if (bigstack_calloc_w(BitCtToWordCt(chr_ct), &chr_already_seen) ||
         bigstack_alloc_c(kMaxIdBlen, &chr_name_buf)) {
-      goto RefFromFa_ret_NOMEM;
+      goto RefFromFaStream_ret_NOMEM;
     }
 
     // To simplify indel/complex-variant handling, we load an entire contig at
@@ -3655,7 +3669,7 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
     seqbuf_size += max_allele_slen + 1;
     char* seqbuf;
     if (bigstack_alloc_c(seqbuf_size, &seqbuf)) {
-      goto RefFromFa_ret_NOMEM;
+      goto RefFromFaStream_ret_NOMEM;
     }
     // May as well handle insertion before first contig base, and deletion of
     // first base, correctly.
@@ -3664,12 +3678,11 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
     char* line_iter;
     reterr = SizemaxAndInitRLstreamRaw(fname, &fa_rls, &line_iter);
     if (reterr) {
-      goto RefFromFa_ret_1;
+      goto RefFromFaStream_ret_1;
     }
 
     char* seqbuf_end = nullptr;
     char* seq_iter = nullptr;
-    // possible but low-priority todo: exploit .fai when it's present
     uint32_t chr_fo_idx = UINT32_MAX;
     uint32_t cur_vidx_last = 0;
     uint32_t skip_chr = 1;
@@ -3684,7 +3697,7 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
           reterr = kPglRetSuccess;
           break;
         }
-        goto RefFromFa_ret_READ_RLSTREAM;
+        goto RefFromFaStream_ret_READ_RLSTREAM;
       }
       unsigned char ucc = line_iter[0];
       if (ucc < 'A') {
@@ -3695,18 +3708,18 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
         }
         if (ucc != '>') {
           snprintf(g_logbuf, kLogbufSize, "Error: Unexpected character at beginning of line %" PRIuPTR " of --ref-from-fa file.\n", line_idx);
-          goto RefFromFa_ret_MALFORMED_INPUT_WW;
+          goto RefFromFaStream_ret_MALFORMED_INPUT_WW;
         }
         if (chr_fo_idx != UINT32_MAX) {
           reterr = RefFromFaProcessContig(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, force, chr_fo_idx, cur_vidx_last, seqbuf, seq_iter, refalt1_select, nonref_flags, &changed_ct, &validated_ct, &downgraded_ct);
           if (reterr) {
-            goto RefFromFa_ret_1;
+            goto RefFromFaStream_ret_1;
           }
         }
         char* chr_name_start = &(line_iter[1]);
         if (IsSpaceOrEoln(*chr_name_start)) {
           snprintf(g_logbuf, kLogbufSize, "Error: Invalid contig description on line %" PRIuPTR " of --ref-from-fa file.%s\n", line_idx, (*chr_name_start == ' ')? " (Spaces are not permitted between the leading '>' and the contig name.)" : "");
-          goto RefFromFa_ret_MALFORMED_INPUT_WW;
+          goto RefFromFaStream_ret_MALFORMED_INPUT_WW;
         }
         char* chr_name_end = CurTokenEnd(chr_name_start);
         line_iter = AdvToDelim(chr_name_end, '\n');
@@ -3718,7 +3731,7 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
           chr_fo_idx = cip->chr_idx_to_foidx[chr_idx];
           if (IsSet(chr_already_seen, chr_fo_idx)) {
             snprintf(g_logbuf, kLogbufSize, "Error: Duplicate contig name '%s' in --ref-from-fa file.\n", chr_name_start);
-            goto RefFromFa_ret_MALFORMED_INPUT_WW;
+            goto RefFromFaStream_ret_MALFORMED_INPUT_WW;
           }
           SetBit(chr_fo_idx, chr_already_seen);
           const int32_t chr_vidx_start_m1 = cip->chr_fo_vidx_start[chr_fo_idx] - 1;
@@ -3744,7 +3757,7 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
       ucc = *seqline_end;
       if ((ucc == ' ') || (ucc == '\t')) {
         snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of --ref-from-fa file is malformed.\n", line_idx);
-        goto RefFromFa_ret_MALFORMED_INPUT_2;
+        goto RefFromFaStream_ret_MALFORMED_INPUT_2;
       }
       uint32_t cur_seq_slen = seqline_end - line_start;
       const uint32_t seq_rem = seqbuf_end - seq_iter;
@@ -3764,34 +3777,493 @@ PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps,
     if (chr_fo_idx != UINT32_MAX) {
       reterr = RefFromFaProcessContig(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, force, chr_fo_idx, cur_vidx_last, seqbuf, seq_iter, refalt1_select, nonref_flags, &changed_ct, &validated_ct, &downgraded_ct);
       if (reterr) {
-        goto RefFromFa_ret_1;
+        goto RefFromFaStream_ret_1;
       }
     }
-    logprintf("--ref-from-fa%s: %u variant%s changed, %u validated.\n", force? " force" : "", changed_ct, (changed_ct == 1)? "" : "s", validated_ct);
-    if (downgraded_ct) {
-      logerrprintfww("Warning: %u reference allele%s downgraded from 'known' to 'provisional'.\n", downgraded_ct, (downgraded_ct == 1)? "" : "s");
-    }
+    *changed_ct_ptr = changed_ct;
+    *validated_ct_ptr = validated_ct;
+    *downgraded_ct_ptr = downgraded_ct;
   }
   while (0) {
-  RefFromFa_ret_NOMEM:
+  RefFromFaStream_ret_NOMEM:
     reterr = kPglRetNomem;
     break;
-  RefFromFa_ret_READ_RLSTREAM:
+  RefFromFaStream_ret_READ_RLSTREAM:
     RLstreamErrPrint("--ref-from-fa file", &fa_rls, &reterr);
     break;
-  RefFromFa_ret_MALFORMED_INPUT_WW:
+  RefFromFaStream_ret_MALFORMED_INPUT_WW:
     WordWrapB(0);
-  RefFromFa_ret_MALFORMED_INPUT_2:
+  RefFromFaStream_ret_MALFORMED_INPUT_2:
     logerrputsb();
     reterr = kPglRetMalformedInput;
     break;
   }
- RefFromFa_ret_1:
+ RefFromFaStream_ret_1:
   CleanupRLstream(&fa_rls);
   BigstackReset(bigstack_mark);
   return reterr;
 }
 
+#ifndef NO_MMAP
+typedef struct FaiContigStruct {
+  // nullptr if the contig is absent from the .fai, or has no variants to
+  // check
+  const char* seq_start;
+  uint32_t seq_len;
+  uint32_t line_blen;  // bases per line
+  uint32_t line_width;  // bytes per line, including the line terminator
+} FaiContig;
+
+static const FaiContig* g_fai_contigs = nullptr;
+static const uint32_t* g_fa_variant_bps = nullptr;
+static const uintptr_t* g_fa_variant_allele_idxs = nullptr;
+static const char* const* g_fa_allele_storage = nullptr;
+static AltAlleleCt* g_fa_refalt1_select = nullptr;
+static uintptr_t* g_fa_nonref_flags = nullptr;
+static char** g_fa_refbufs = nullptr;
+// word-aligned, so threads never share a nonref_flags word
+static uint32_t* g_fa_thread_vidx_starts = nullptr;
+static uint32_t* g_fa_changed_cts = nullptr;
+static uint32_t* g_fa_validated_cts = nullptr;
+static uint32_t* g_fa_downgraded_cts = nullptr;
+// first variant which must trigger an error in each thread's range, or
+// UINT32_MAX; type is the RefFromFaConflictErrprint() is_mismatch parameter
+static uint32_t* g_fa_err_uidxs = nullptr;
+static uint32_t* g_fa_err_types = nullptr;
+static uint32_t g_fa_max_allele_slen = 0;
+static uint32_t g_fa_force = 0;
+
+THREAD_FUNC_DECL RefFromFaiThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uintptr_t* variant_include = g_variant_include;
+  const ChrInfo* cip = g_cip;
+  const FaiContig* fai_contigs = g_fai_contigs;
+  const uint32_t* variant_bps = g_fa_variant_bps;
+  const uintptr_t* variant_allele_idxs = g_fa_variant_allele_idxs;
+  const char* const* allele_storage = g_fa_allele_storage;
+  AltAlleleCt* refalt1_select = g_fa_refalt1_select;
+  uintptr_t* nonref_flags = g_fa_nonref_flags;
+  char* refbuf = g_fa_refbufs[tidx];
+  const uint32_t max_allele_slen = g_fa_max_allele_slen;
+  const uint32_t force = g_fa_force;
+  const uint32_t variant_uidx_end = g_fa_thread_vidx_starts[tidx + 1];
+  uint32_t variant_uidx = g_fa_thread_vidx_starts[tidx];
+  uint32_t chr_vidx_end = 0;
+  const FaiContig* cur_contig = nullptr;
+  uint32_t changed_ct = 0;
+  uint32_t validated_ct = 0;
+  uint32_t downgraded_ct = 0;
+  uint32_t err_uidx = UINT32_MAX;
+  uint32_t err_type = 0;
+  uint32_t cur_allele_ct = 2;
+  for (; ; ++variant_uidx) {
+    variant_uidx = AdvBoundedTo1Bit(variant_include, variant_uidx, variant_uidx_end);
+    if (variant_uidx == variant_uidx_end) {
+      break;
+    }
+    if (variant_uidx >= chr_vidx_end) {
+      const uint32_t chr_fo_idx = GetVariantChrFoIdx(cip, variant_uidx);
+      chr_vidx_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+      cur_contig = &(fai_contigs[chr_fo_idx]);
+    }
+    if (!cur_contig->seq_start) {
+      variant_uidx = chr_vidx_end - 1;
+      continue;
+    }
+    const uint32_t cur_bp = variant_bps[variant_uidx];
+    const uint32_t seq_len = cur_contig->seq_len;
+    if (cur_bp > seq_len) {
+      // past the end of a too-short (or gap-truncated) contig; without
+      // 'force', RefFromFai() reports an error afterwards
+      if (!IsSet(nonref_flags, variant_uidx)) {
+        SetBit(variant_uidx, nonref_flags);
+        ++downgraded_ct;
+      }
+      continue;
+    }
+    // Gather the reference bases at [cur_bp, cur_bp + max_allele_slen)
+    // directly from the mapped file, skipping line terminators.  Position 0
+    // is treated as 'N', as in RefFromFaProcessContig().
+    char* refbuf_iter = refbuf;
+    uint32_t bp = cur_bp;
+    uint32_t remaining_ct = max_allele_slen;
+    if (!bp) {
+      *refbuf_iter++ = 'N';
+      bp = 1;
+      --remaining_ct;
+    }
+    const uint32_t line_blen = cur_contig->line_blen;
+    while (remaining_ct && (bp <= seq_len)) {
+      const uint32_t bp_offset = bp - 1;
+      const uint32_t line_idx = bp_offset / line_blen;
+      const uint32_t line_bp_offset = bp_offset % line_blen;
+      uint32_t copy_ct = MINV(line_blen - line_bp_offset, remaining_ct);
+      if (copy_ct > seq_len + 1 - bp) {
+        copy_ct = seq_len + 1 - bp;
+      }
+      refbuf_iter = memcpya(refbuf_iter, &(cur_contig->seq_start[S_CAST(uintptr_t, line_idx) * cur_contig->line_width + line_bp_offset]), copy_ct);
+      bp += copy_ct;
+      remaining_ct -= copy_ct;
+    }
+    *refbuf_iter = '\0';
+    uintptr_t variant_allele_idx_base = variant_uidx * 2;
+    if (variant_allele_idxs) {
+      variant_allele_idx_base = variant_allele_idxs[variant_uidx];
+      cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
+    }
+    const int32_t consistent_allele_idx = GetFaConsistentAlleleIdx(&(allele_storage[variant_allele_idx_base]), refbuf, cur_allele_ct);
+    if (consistent_allele_idx >= 0) {
+      if (consistent_allele_idx) {
+        if ((!IsSet(nonref_flags, variant_uidx)) && (!force)) {
+          err_uidx = variant_uidx;
+          err_type = 0;
+          break;
+        }
+        refalt1_select[2 * variant_uidx] = consistent_allele_idx;
+        refalt1_select[2 * variant_uidx + 1] = 0;
+        ++changed_ct;
+      } else {
+        ++validated_ct;
+      }
+      ClearBit(variant_uidx, nonref_flags);
+    } else if ((consistent_allele_idx == -1) && (!IsSet(nonref_flags, variant_uidx))) {
+      if (!force) {
+        err_uidx = variant_uidx;
+        err_type = 1;
+        break;
+      }
+      SetBit(variant_uidx, nonref_flags);
+      ++downgraded_ct;
+    }
+  }
+  g_fa_changed_cts[tidx] = changed_ct;
+  g_fa_validated_cts[tidx] = validated_ct;
+  g_fa_downgraded_cts[tidx] = downgraded_ct;
+  g_fa_err_uidxs[tidx] = err_uidx;
+  g_fa_err_types[tidx] = err_type;
+  THREAD_RETURN;
+}
+
+// If <fname>.fai exists and fname is an uncompressed FASTA, this maps the
+// FASTA and looks up each variant's reference bases through the index, so no
+// contig is ever copied; variants are split between threads.  Otherwise,
+// *fai_used_ptr is set to zero and nothing else happens.
+static PglErr RefFromFai(const uintptr_t* variant_include, const uint32_t* variant_bps, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const ChrInfo* cip, const char* fname, uint32_t max_allele_slen, uint32_t force, uint32_t max_thread_ct, AltAlleleCt* refalt1_select, uintptr_t* nonref_flags, uint32_t* changed_ct_ptr, uint32_t* validated_ct_ptr, uint32_t* downgraded_ct_ptr, uint32_t* fai_used_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  const char* fa_map = nullptr;
+  uintptr_t fa_size = 0;
+  char* fai_fname = nullptr;
+  uintptr_t line_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream fai_rls;
+  PreinitRLstream(&fai_rls);
+  *fai_used_ptr = 0;
+  {
+    const uint32_t fname_slen = strlen(fname);
+    if ((fname_slen + 5 > kPglFnamesize) || bigstack_alloc_c(fname_slen + 5, &fai_fname)) {
+      goto RefFromFai_ret_1;
+    }
+    snprintf(memcpya(fai_fname, fname, fname_slen), 5, ".fai");
+    FILE* fai_probe = fopen(fai_fname, FOPEN_RB);
+    if (!fai_probe) {
+      goto RefFromFai_ret_1;
+    }
+    fclose(fai_probe);
+    int32_t file_handle = open(fname, O_RDONLY);
+    if (file_handle < 0) {
+      logerrprintfww(kErrprintfFopen, fname);
+      goto RefFromFai_ret_OPEN_FAIL;
+    }
+    struct stat statbuf;
+    if (fstat(file_handle, &statbuf) < 0) {
+      close(file_handle);
+      goto RefFromFai_ret_READ_FAIL;
+    }
+    fa_size = statbuf.st_size;
+    if (!fa_size) {
+      close(file_handle);
+      goto RefFromFai_ret_1;
+    }
+    fa_map = S_CAST(const char*, mmap(0, fa_size, PROT_READ, MAP_SHARED, file_handle, 0));
+    close(file_handle);
+    if (R_CAST(uintptr_t, fa_map) == (~k0LU)) {
+      fa_map = nullptr;
+      goto RefFromFai_ret_READ_FAIL;
+    }
+    if (fa_map[0] != '>') {
+      // compressed, or otherwise not something we can index into directly
+      goto RefFromFai_ret_1;
+    }
+
+    const uint32_t chr_ct = cip->chr_ct;
+    FaiContig* fai_contigs = S_CAST(FaiContig*, bigstack_alloc(chr_ct * sizeof(FaiContig)));
+    uintptr_t* chr_already_seen;
+    // contigs with variants to check, in .fai order, and the inverse mapping
+    uint32_t* fai_chr_fo_idxs;
+    uint32_t* chr_fo_to_fai_idx;
+    if ((!fai_contigs) ||
+        bigstack_calloc_w(BitCtToWordCt(chr_ct), &chr_already_seen) ||
+        bigstack_alloc_u32(chr_ct, &fai_chr_fo_idxs) ||
+        bigstack_alloc_u32(chr_ct, &chr_fo_to_fai_idx)) {
+      goto RefFromFai_ret_NOMEM;
+    }
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx != chr_ct; ++chr_fo_idx) {
+      fai_contigs[chr_fo_idx].seq_start = nullptr;
+    }
+    uint32_t fai_contig_ct = 0;
+    char* line_iter;
+    reterr = InitRLstreamMinsizeRaw(fai_fname, &fai_rls, &line_iter);
+    if (reterr) {
+      goto RefFromFai_ret_1;
+    }
+    while (1) {
+      ++line_idx;
+      reterr = RlsNext(&fai_rls, &line_iter);
+      if (reterr) {
+        if (reterr == kPglRetEof) {
+          reterr = kPglRetSuccess;
+          break;
+        }
+        goto RefFromFai_ret_READ_RLSTREAM;
+      }
+      if (IsSpaceOrEoln(*line_iter)) {
+        continue;
+      }
+      char* chr_name_start = line_iter;
+      char* chr_name_end = AdvToDelim(chr_name_start, '\t');
+      line_iter = AdvToDelim(chr_name_end, '\n');
+      const uint32_t chr_idx = GetChrCode(chr_name_start, cip, chr_name_end - chr_name_start);
+      if (IsI32Neg(chr_idx) || (!IsSet(cip->chr_mask, chr_idx))) {
+        continue;
+      }
+      const uint32_t chr_fo_idx = cip->chr_idx_to_foidx[chr_idx];
+      if (IsSet(chr_already_seen, chr_fo_idx)) {
+        *chr_name_end = '\0';
+        snprintf(g_logbuf, kLogbufSize, "Error: Duplicate contig name '%s' in %s.\n", chr_name_start, fai_fname);
+        goto RefFromFai_ret_MALFORMED_INPUT_WW;
+      }
+      SetBit(chr_fo_idx, chr_already_seen);
+      const int32_t chr_vidx_start_m1 = cip->chr_fo_vidx_start[chr_fo_idx] - 1;
+      const int32_t chr_vidx_last = FindLast1BitBeforeBounded(variant_include, cip->chr_fo_vidx_start[chr_fo_idx + 1], chr_vidx_start_m1);
+      if (chr_vidx_last == chr_vidx_start_m1) {
+        continue;
+      }
+      // NAME, LENGTH, OFFSET, LINEBASES, LINEWIDTH
+      uintptr_t fields[4];
+      const char* field_iter = chr_name_end;
+      for (uint32_t field_idx = 0; field_idx != 4; ++field_idx) {
+        if (*field_iter != '\t') {
+          goto RefFromFai_ret_MISSING_TOKENS;
+        }
+        ++field_iter;
+        if (ScanPosintptr(field_iter, &(fields[field_idx]))) {
+          // OFFSET=0 can't be right (the FASTA starts with a header line),
+          // but that's a stale-index problem, not a malformed-line one
+          if ((field_idx != 1) || (field_iter[0] != '0') || (!IsSpaceOrEoln(field_iter[1]))) {
+            goto RefFromFai_ret_MISSING_TOKENS;
+          }
+          fields[1] = 0;
+        }
+        field_iter = CurTokenEnd(field_iter);
+      }
+      const uintptr_t seq_len = fields[0];
+      const uintptr_t seq_fpos = fields[1];
+      const uintptr_t line_blen = fields[2];
+      const uintptr_t line_width = fields[3];
+      // an index which doesn't line up with the FASTA is most likely stale;
+      // for multiline sequences, the first line must also end where the
+      // index says it does
+      if ((seq_len >= 0x7fffffff) || (line_blen >= 0x7fffffff) || (line_width < line_blen + 1) || (line_width > line_blen + 2) || (!seq_fpos) || (seq_fpos >= fa_size) || (fa_map[seq_fpos - 1] != '\n') || (seq_fpos + ((seq_len - 1) / line_blen) * line_width + ((seq_len - 1) % line_blen) >= fa_size) || ((seq_len > line_blen) && (fa_map[seq_fpos + line_blen] != ((line_width == line_blen + 1)? '\n' : '\r')))) {
+        logerrprintfww("Warning: %s is inconsistent with %s; ignoring it.\n", fai_fname, fname);
+        for (uint32_t chr_fo_idx2 = 0; chr_fo_idx2 != chr_ct; ++chr_fo_idx2) {
+          fai_contigs[chr_fo_idx2].seq_start = nullptr;
+        }
+        goto RefFromFai_ret_1;
+      }
+      FaiContig* cur_contig = &(fai_contigs[chr_fo_idx]);
+      cur_contig->seq_start = &(fa_map[seq_fpos]);
+      cur_contig->seq_len = seq_len;
+      cur_contig->line_blen = line_blen;
+      cur_contig->line_width = line_width;
+      chr_fo_to_fai_idx[chr_fo_idx] = fai_contig_ct;
+      fai_chr_fo_idxs[fai_contig_ct++] = chr_fo_idx;
+    }
+    CleanupRLstream(&fai_rls);
+    *fai_used_ptr = 1;
+    logprintfww("--ref-from-fa: Using %s.\n", fai_fname);
+
+    // Now that the index is known to be usable, handle gaps and too-short
+    // contigs the same way RefFromFaStream() does: everything at or after the
+    // first indeterminate-length gap (within the range that could be
+    // compared) is treated as past the end of the contig.  Without 'force',
+    // the first too-short contig is only reported after the threads have run,
+    // if no mismatch in an earlier contig takes precedence.
+    uint32_t first_short_fai_idx = UINT32_MAX;
+    for (uint32_t fai_contig_idx = 0; fai_contig_idx != fai_contig_ct; ++fai_contig_idx) {
+      const uint32_t chr_fo_idx = fai_chr_fo_idxs[fai_contig_idx];
+      FaiContig* cur_contig = &(fai_contigs[chr_fo_idx]);
+      const uint32_t chr_vidx_last = FindLast1BitBefore(variant_include, cip->chr_fo_vidx_start[chr_fo_idx + 1]);
+      const uint32_t last_bp = variant_bps[chr_vidx_last];
+      const uint32_t line_blen = cur_contig->line_blen;
+      const uint32_t line_width = cur_contig->line_width;
+      uint32_t scan_bp_ct = last_bp + max_allele_slen - 1;
+      if (scan_bp_ct > cur_contig->seq_len) {
+        scan_bp_ct = cur_contig->seq_len;
+      }
+      if (scan_bp_ct) {
+        const uintptr_t scan_byte_ct = S_CAST(uintptr_t, (scan_bp_ct - 1) / line_blen) * line_width + ((scan_bp_ct - 1) % line_blen) + 1;
+        const char* gap_start = S_CAST(const char*, memchr(cur_contig->seq_start, '-', scan_byte_ct));
+        if (gap_start) {
+          const uintptr_t gap_byte_offset = gap_start - cur_contig->seq_start;
+          const uint32_t gap_bp = (gap_byte_offset / line_width) * line_blen + (gap_byte_offset % line_width) + 1;
+          char* write_iter = strcpya(g_logbuf, "Warning: Indeterminate-length gap present at position ");
+          write_iter = u32toa(gap_bp, write_iter);
+          write_iter = strcpya(write_iter, " of contig '");
+          write_iter = chrtoa(cip, cip->chr_file_order[chr_fo_idx], write_iter);
+          snprintf(write_iter, kLogbufSize - kMaxIdSlen - 128, "' in --ref-from-fa file. Ignoring remainder of contig.\n");
+          WordWrapB(0);
+          logerrputsb();
+          cur_contig->seq_len = gap_bp - 1;
+        }
+      }
+      if (last_bp > cur_contig->seq_len) {
+        if (force) {
+          RefFromFaShortContig(cip, cip->chr_file_order[chr_fo_idx], 1);
+        } else if (first_short_fai_idx == UINT32_MAX) {
+          first_short_fai_idx = fai_contig_idx;
+        }
+      }
+    }
+
+    const uint32_t raw_variant_ct = cip->chr_fo_vidx_start[chr_ct];
+    uint32_t calc_thread_ct = BitCtToWordCt(raw_variant_ct) / 1024;
+    if (calc_thread_ct > max_thread_ct) {
+      calc_thread_ct = max_thread_ct;
+    } else if (!calc_thread_ct) {
+      calc_thread_ct = 1;
+    }
+    pthread_t* threads;
+    if (bigstack_alloc_thread(calc_thread_ct, &threads) ||
+        bigstack_alloc_cp(calc_thread_ct, &g_fa_refbufs) ||
+        bigstack_alloc_u32(calc_thread_ct + 1, &g_fa_thread_vidx_starts) ||
+        bigstack_alloc_u32(calc_thread_ct, &g_fa_changed_cts) ||
+        bigstack_alloc_u32(calc_thread_ct, &g_fa_validated_cts) ||
+        bigstack_alloc_u32(calc_thread_ct, &g_fa_downgraded_cts) ||
+        bigstack_alloc_u32(calc_thread_ct, &g_fa_err_uidxs) ||
+        bigstack_alloc_u32(calc_thread_ct, &g_fa_err_types)) {
+      goto RefFromFai_ret_NOMEM;
+    }
+    for (uint32_t tidx = 0; tidx != calc_thread_ct; ++tidx) {
+      if (bigstack_alloc_c(max_allele_slen + 1, &(g_fa_refbufs[tidx]))) {
+        goto RefFromFai_ret_NOMEM;
+      }
+      g_fa_thread_vidx_starts[tidx] = RoundDownPow2((S_CAST(uint64_t, raw_variant_ct) * tidx) / calc_thread_ct, kBitsPerWord);
+    }
+    g_fa_thread_vidx_starts[calc_thread_ct] = raw_variant_ct;
+    g_variant_include = variant_include;
+    g_cip = cip;
+    g_fai_contigs = fai_contigs;
+    g_fa_variant_bps = variant_bps;
+    g_fa_variant_allele_idxs = variant_allele_idxs;
+    g_fa_allele_storage = allele_storage;
+    g_fa_refalt1_select = refalt1_select;
+    g_fa_nonref_flags = nonref_flags;
+    g_fa_max_allele_slen = max_allele_slen;
+    g_fa_force = force;
+    if (SpawnThreads(RefFromFaiThread, calc_thread_ct, threads)) {
+      goto RefFromFai_ret_THREAD_CREATE_FAIL;
+    }
+    RefFromFaiThread(R_CAST(void*, 0));
+    JoinThreads(calc_thread_ct, threads);
+    uint32_t err_uidx = UINT32_MAX;
+    uint32_t err_type = 0;
+    uint32_t changed_ct = 0;
+    uint32_t validated_ct = 0;
+    uint32_t downgraded_ct = 0;
+    for (uint32_t tidx = 0; tidx != calc_thread_ct; ++tidx) {
+      if (g_fa_err_uidxs[tidx] < err_uidx) {
+        err_uidx = g_fa_err_uidxs[tidx];
+        err_type = g_fa_err_types[tidx];
+      }
+      changed_ct += g_fa_changed_cts[tidx];
+      validated_ct += g_fa_validated_cts[tidx];
+      downgraded_ct += g_fa_downgraded_cts[tidx];
+    }
+    if (first_short_fai_idx != UINT32_MAX) {
+      if ((err_uidx == UINT32_MAX) || (first_short_fai_idx <= chr_fo_to_fai_idx[GetVariantChrFoIdx(cip, err_uidx)])) {
+        RefFromFaShortContig(cip, cip->chr_file_order[fai_chr_fo_idxs[first_short_fai_idx]], 0);
+        goto RefFromFai_ret_INCONSISTENT_INPUT;
+      }
+    }
+    if (err_uidx != UINT32_MAX) {
+      RefFromFaConflictErrprint(cip, GetVariantChr(cip, err_uidx), variant_bps[err_uidx], err_type);
+      goto RefFromFai_ret_INCONSISTENT_INPUT;
+    }
+    *changed_ct_ptr = changed_ct;
+    *validated_ct_ptr = validated_ct;
+    *downgraded_ct_ptr = downgraded_ct;
+  }
+  while (0) {
+  RefFromFai_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  RefFromFai_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  RefFromFai_ret_READ_FAIL:
+    logerrputs("Error: File read failure.\n");
+    reterr = kPglRetReadFail;
+    break;
+  RefFromFai_ret_READ_RLSTREAM:
+    RLstreamErrPrint(fai_fname, &fai_rls, &reterr);
+    break;
+  RefFromFai_ret_MISSING_TOKENS:
+    snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idx, fai_fname);
+  RefFromFai_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  RefFromFai_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  RefFromFai_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  }
+ RefFromFai_ret_1:
+  CleanupRLstream(&fai_rls);
+  if (fa_map) {
+    munmap(K_CAST(char*, fa_map), fa_size);
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+#endif
+
+PglErr RefFromFa(const uintptr_t* variant_include, const uint32_t* variant_bps, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const ChrInfo* cip, const char* fname, uint32_t max_allele_slen, uint32_t force, uint32_t max_thread_ct, AltAlleleCt* refalt1_select, uintptr_t* nonref_flags) {
+  uint32_t changed_ct = 0;
+  uint32_t validated_ct = 0;
+  uint32_t downgraded_ct = 0;
+#ifdef NO_MMAP
+  PglErr reterr = RefFromFaStream(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, fname, max_allele_slen, force, refalt1_select, nonref_flags, &changed_ct, &validated_ct, &downgraded_ct);
+#else
+  uint32_t fai_used;
+  PglErr reterr = RefFromFai(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, fname, max_allele_slen, force, max_thread_ct, refalt1_select, nonref_flags, &changed_ct, &validated_ct, &downgraded_ct, &fai_used);
+  if ((!reterr) && (!fai_used)) {
+    reterr = RefFromFaStream(variant_include, variant_bps, variant_allele_idxs, allele_storage, cip, fname, max_allele_slen, force, refalt1_select, nonref_flags, &changed_ct, &validated_ct, &downgraded_ct);
+  }
+#endif
+  if (reterr) {
+    return reterr;
+  }
+  logprintf("--ref-from-fa%s: %u variant%s changed, %u validated.\n", force? " force" : "", changed_ct, (changed_ct == 1)? "" : "s", validated_ct);
+  if (downgraded_ct) {
+    logerrprintfww("Warning: %u reference allele%s downgraded from 'known' to 'provisional'.\n", downgraded_ct, (downgraded_ct == 1)? "" : "s");
+  }
+  return kPglRetSuccess;
+}
+
 #ifdef __cplusplus
 }  // namespace plink2
 #endif
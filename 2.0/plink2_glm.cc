@@ -2896,6 +2896,8 @@ typedef struct {
 
 // multithread globals
 static PgenReader** g_pgr_ptrs = nullptr;
+// --bgen 'direct' mode replacement for g_pgr_ptrs
+static BgenReader** g_bgen_readers = nullptr;
 static uintptr_t** g_genovecs = nullptr;
 static uintptr_t** g_dosage_presents = nullptr;
 static Dosage** g_dosage_mains = nullptr;
@@ -2987,7 +2989,8 @@ static uintptr_t g_max_reported_test_ct = 0;
 
 THREAD_FUNC_DECL GlmLogisticThread(void* arg) {
   const uintptr_t tidx = R_CAST(uintptr_t, arg);
-  PgenReader* pgrp = g_pgr_ptrs[tidx];
+  BgenReader* bgrp = g_bgen_readers? g_bgen_readers[tidx] : nullptr;
+  PgenReader* pgrp = bgrp? nullptr : g_pgr_ptrs[tidx];
   uintptr_t* genovec = g_genovecs[tidx];
   uintptr_t* dosage_present = nullptr;
   Dosage* dosage_main = nullptr;
@@ -3189,7 +3192,9 @@ THREAD_FUNC_DECL GlmLogisticThread(void* arg) {
         memcpy(semicomputed_corr_matrix, nm_precomp->corr_image, nonintercept_pred_ct * nonintercept_pred_ct * sizeof(double));
         memcpy(&(semicomputed_inv_corr_sqrts[domdev_present_p1]), nm_precomp->corr_inv_sqrts, nongeno_pred_ct * sizeof(double));
       }
-      PgrClearLdCache(pgrp);
+      if (pgrp) {
+        PgrClearLdCache(pgrp);
+      }
       // when this is set, the last fully-processed variant had no missing
       // genotypes, and if the current variant also has no missing genotypes we
       // may be able to skip reinitialization of most of
@@ -3201,7 +3206,12 @@ THREAD_FUNC_DECL GlmLogisticThread(void* arg) {
         MovU32To1Bit(variant_include, &variant_uidx);
         {
           uint32_t dosage_ct;
-          PglErr reterr = PgrGetD(cur_sample_include, cur_sample_include_cumulative_popcounts, cur_sample_ct, variant_uidx, pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          PglErr reterr;
+          if (!bgrp) {
+            reterr = PgrGetD(cur_sample_include, cur_sample_include_cumulative_popcounts, cur_sample_ct, variant_uidx, pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          } else {
+            reterr = BgenGetD(cur_sample_include, cur_sample_ct, variant_uidx, bgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          }
           if (reterr) {
             g_error_ret = reterr;
             variant_bidx = variant_bidx_end;
@@ -3975,7 +3985,7 @@ PglErr ReadLocalCovarBlock(const uintptr_t* sample_include, const uintptr_t* sam
 
 // only pass the parameters which aren't also needed by the compute threads,
 // for now
-PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, const char* const* test_names_x, const char* const* test_names_y, const uint32_t* variant_bps, const char* const* variant_ids, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const uint32_t* local_sample_uidx_order, const uintptr_t* local_variant_include, const char* outname, uint32_t raw_variant_ct, uint32_t max_chr_blen, double ci_size, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, uintptr_t overflow_buf_size, uint32_t local_sample_ct, PgenFileInfo* pgfip, ReadLineStream* local_covar_rlsp, uintptr_t* valid_variants, double* orig_negln_pvals, double* orig_permstat, uint32_t* valid_variant_ct_ptr) {
+PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, const char* const* test_names_x, const char* const* test_names_y, const uint32_t* variant_bps, const char* const* variant_ids, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const uint32_t* local_sample_uidx_order, const uintptr_t* local_variant_include, const char* outname, uint32_t raw_variant_ct, uint32_t max_chr_blen, double ci_size, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, uintptr_t overflow_buf_size, uint32_t local_sample_ct, PgenFileInfo* pgfip, BgenReader* bgen_direct_rp, ReadLineStream* local_covar_rlsp, uintptr_t* valid_variants, double* orig_negln_pvals, double* orig_permstat, uint32_t* valid_variant_ct_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   char* cswritep = nullptr;
   CompressStreamState css;
@@ -4138,8 +4148,15 @@ PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, co
     uintptr_t per_variant_xalloc_byte_ct = sizeof(LogisticAuxResult) + 2 * max_reported_test_ct * sizeof(double) + max_sample_ct * local_covar_ct * sizeof(float);
     unsigned char* main_loadbufs[2];
     uint32_t read_block_size;
-    if (PgenMtLoadInit(variant_include, max_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, dosage_is_present? (&g_dosage_presents) : nullptr, dosage_is_present? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &ts.threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
-      goto GlmLogistic_ret_NOMEM;
+    if (!bgen_direct_rp) {
+      if (PgenMtLoadInit(variant_include, max_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, dosage_is_present? (&g_dosage_presents) : nullptr, dosage_is_present? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &ts.threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
+        goto GlmLogistic_ret_NOMEM;
+      }
+    } else {
+      reterr = BgenMtLoadInit(bgen_direct_rp, max_sample_ct, bigstack_left(), thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, &calc_thread_ct, &g_genovecs, &g_dosage_presents, &g_dosage_mains, &read_block_size, &ts.threads, &g_bgen_readers, &g_read_variant_uidx_starts);
+      if (reterr) {
+        goto GlmLogistic_ret_1;
+      }
     }
     ts.calc_thread_ct = calc_thread_ct;
     g_calc_thread_ct = calc_thread_ct;
@@ -4332,7 +4349,7 @@ PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, co
           cur_read_block_size = raw_variant_ct - (read_block_idx * read_block_size);
           cur_block_variant_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(cur_read_block_size));
         }
-        if (PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_variant_ct, pgfip)) {
+        if ((!bgen_direct_rp) && PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_variant_ct, pgfip)) {
           goto GlmLogistic_ret_READ_FAIL;
         }
         if (local_covar_line_iter) {
@@ -4348,7 +4365,10 @@ PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, co
         if (reterr) {
           if (reterr == kPglRetMalformedInput) {
             logputs("\n");
-            logerrputs("Error: Malformed .pgen file.\n");
+            logerrputs(bgen_direct_rp? "Error: Invalid compressed SNP block in .bgen file.\n" : "Error: Malformed .pgen file.\n");
+          } else if (reterr == kPglRetNotYetSupported) {
+            logputs("\n");
+            logerrputs("Error: BGEN import doesn't currently support >16-bit probability precision or\nploidy > 2.\n");
           }
           goto GlmLogistic_ret_1;
         }
@@ -4357,9 +4377,11 @@ PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, co
         g_cur_block_variant_ct = cur_block_variant_ct;
         const uint32_t uidx_start = read_block_idx * read_block_size;
         ComputeUidxStartPartition(variant_include, cur_block_variant_ct, calc_thread_ct, uidx_start, g_read_variant_uidx_starts);
-        for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
-          g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
-          g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+        if (!bgen_direct_rp) {
+          for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+            g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
+            g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+          }
         }
         g_logistic_block_aux = logistic_block_aux_bufs[parity];
         g_block_beta_se = block_beta_se_bufs[parity];
@@ -4712,6 +4734,12 @@ PglErr GlmLogistic(const char* cur_pheno_name, const char* const* test_names, co
   }
  GlmLogistic_ret_1:
   CleanupThreads3z(&ts, &g_cur_block_variant_ct);
+  if (g_bgen_readers) {
+    for (uint32_t tidx = 0; tidx < g_calc_thread_ct; ++tidx) {
+      CleanupBgenReader(g_bgen_readers[tidx]);
+    }
+    g_bgen_readers = nullptr;
+  }
   CswriteCloseCond(&css, cswritep);
   BigstackReset(bigstack_mark);
   return reterr;
@@ -4810,7 +4838,8 @@ uintptr_t GetLinearWorkspaceSize(uint32_t sample_ct, uint32_t predictor_ct, uint
 
 THREAD_FUNC_DECL GlmLinearThread(void* arg) {
   const uintptr_t tidx = R_CAST(uintptr_t, arg);
-  PgenReader* pgrp = g_pgr_ptrs[tidx];
+  BgenReader* bgrp = g_bgen_readers? g_bgen_readers[tidx] : nullptr;
+  PgenReader* pgrp = bgrp? nullptr : g_pgr_ptrs[tidx];
   uintptr_t* genovec = g_genovecs[tidx];
   uintptr_t* dosage_present = nullptr;
   Dosage* dosage_main = nullptr;
@@ -5001,7 +5030,9 @@ THREAD_FUNC_DECL GlmLinearThread(void* arg) {
         memcpy(semicomputed_corr_matrix, nm_precomp->corr_image, nonintercept_pred_ct * nonintercept_pred_ct * sizeof(double));
         memcpy(&(semicomputed_inv_corr_sqrts[domdev_present_p1]), nm_precomp->corr_inv_sqrts, nongeno_pred_ct * sizeof(double));
       }
-      PgrClearLdCache(pgrp);
+      if (pgrp) {
+        PgrClearLdCache(pgrp);
+      }
       // when this is set, the last fully-processed variant had no missing
       // genotypes, and if the current variant also has no missing genotypes we
       // may be able to skip reinitialization of most of
@@ -5013,7 +5044,12 @@ THREAD_FUNC_DECL GlmLinearThread(void* arg) {
         MovU32To1Bit(variant_include, &variant_uidx);
         {
           uint32_t dosage_ct;
-          PglErr reterr = PgrGetD(cur_sample_include, cur_sample_include_cumulative_popcounts, cur_sample_ct, variant_uidx, pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          PglErr reterr;
+          if (!bgrp) {
+            reterr = PgrGetD(cur_sample_include, cur_sample_include_cumulative_popcounts, cur_sample_ct, variant_uidx, pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          } else {
+            reterr = BgenGetD(cur_sample_include, cur_sample_ct, variant_uidx, bgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+          }
           if (reterr) {
             g_error_ret = reterr;
             variant_bidx = variant_bidx_end;
@@ -5467,7 +5503,7 @@ THREAD_FUNC_DECL GlmLinearThread(void* arg) {
   }
 }
 
-PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, const char* const* test_names_x, const char* const* test_names_y, const uint32_t* variant_bps, const char* const* variant_ids, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const uint32_t* local_sample_uidx_order, const uintptr_t* local_variant_include, const char* outname, uint32_t raw_variant_ct, uint32_t max_chr_blen, double ci_size, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, uintptr_t overflow_buf_size, uint32_t local_sample_ct, PgenFileInfo* pgfip, ReadLineStream* local_covar_rlsp, uintptr_t* valid_variants, double* orig_negln_pvals, uint32_t* valid_variant_ct_ptr) {
+PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, const char* const* test_names_x, const char* const* test_names_y, const uint32_t* variant_bps, const char* const* variant_ids, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const uint32_t* local_sample_uidx_order, const uintptr_t* local_variant_include, const char* outname, uint32_t raw_variant_ct, uint32_t max_chr_blen, double ci_size, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, uintptr_t overflow_buf_size, uint32_t local_sample_ct, PgenFileInfo* pgfip, BgenReader* bgen_direct_rp, ReadLineStream* local_covar_rlsp, uintptr_t* valid_variants, double* orig_negln_pvals, uint32_t* valid_variant_ct_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   char* cswritep = nullptr;
   CompressStreamState css;
@@ -5627,8 +5663,15 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
     uintptr_t per_variant_xalloc_byte_ct = sizeof(LinearAuxResult) + 2 * max_reported_test_ct * sizeof(double) + max_sample_ct * local_covar_ct * sizeof(double);
     unsigned char* main_loadbufs[2];
     uint32_t read_block_size;
-    if (PgenMtLoadInit(variant_include, max_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, dosage_is_present? (&g_dosage_presents) : nullptr, dosage_is_present? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &ts.threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
-      goto GlmLinear_ret_NOMEM;
+    if (!bgen_direct_rp) {
+      if (PgenMtLoadInit(variant_include, max_sample_ct, variant_ct, bigstack_left(), pgr_alloc_cacheline_ct, thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, pgfip, &calc_thread_ct, &g_genovecs, nullptr, nullptr, dosage_is_present? (&g_dosage_presents) : nullptr, dosage_is_present? (&g_dosage_mains) : nullptr, nullptr, nullptr, &read_block_size, main_loadbufs, &ts.threads, &g_pgr_ptrs, &g_read_variant_uidx_starts)) {
+        goto GlmLinear_ret_NOMEM;
+      }
+    } else {
+      reterr = BgenMtLoadInit(bgen_direct_rp, max_sample_ct, bigstack_left(), thread_xalloc_cacheline_ct, per_variant_xalloc_byte_ct, &calc_thread_ct, &g_genovecs, &g_dosage_presents, &g_dosage_mains, &read_block_size, &ts.threads, &g_bgen_readers, &g_read_variant_uidx_starts);
+      if (reterr) {
+        goto GlmLinear_ret_1;
+      }
     }
     ts.calc_thread_ct = calc_thread_ct;
     g_calc_thread_ct = calc_thread_ct;
@@ -5795,7 +5838,7 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
           cur_read_block_size = raw_variant_ct - (read_block_idx * read_block_size);
           cur_block_variant_ct = PopcountWords(&(variant_include[read_block_idx * read_block_sizel]), BitCtToWordCt(cur_read_block_size));
         }
-        if (PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_variant_ct, pgfip)) {
+        if ((!bgen_direct_rp) && PgfiMultiread(variant_include, read_block_idx * read_block_size, read_block_idx * read_block_size + cur_read_block_size, cur_block_variant_ct, pgfip)) {
           goto GlmLinear_ret_READ_FAIL;
         }
         if (local_covar_line_iter) {
@@ -5811,7 +5854,10 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
         if (reterr) {
           if (reterr == kPglRetMalformedInput) {
             logputs("\n");
-            logerrputs("Error: Malformed .pgen file.\n");
+            logerrputs(bgen_direct_rp? "Error: Invalid compressed SNP block in .bgen file.\n" : "Error: Malformed .pgen file.\n");
+          } else if (reterr == kPglRetNotYetSupported) {
+            logputs("\n");
+            logerrputs("Error: BGEN import doesn't currently support >16-bit probability precision or\nploidy > 2.\n");
           }
           goto GlmLinear_ret_1;
         }
@@ -5820,9 +5866,11 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
         g_cur_block_variant_ct = cur_block_variant_ct;
         const uint32_t uidx_start = read_block_idx * read_block_size;
         ComputeUidxStartPartition(variant_include, cur_block_variant_ct, calc_thread_ct, uidx_start, g_read_variant_uidx_starts);
-        for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
-          g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
-          g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+        if (!bgen_direct_rp) {
+          for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+            g_pgr_ptrs[tidx]->fi.block_base = pgfip->block_base;
+            g_pgr_ptrs[tidx]->fi.block_offset = pgfip->block_offset;
+          }
         }
         g_linear_block_aux = linear_block_aux_bufs[parity];
         g_block_beta_se = block_beta_se_bufs[parity];
@@ -6131,6 +6179,12 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
   }
  GlmLinear_ret_1:
   CleanupThreads3z(&ts, &g_cur_block_variant_ct);
+  if (g_bgen_readers) {
+    for (uint32_t tidx = 0; tidx < g_calc_thread_ct; ++tidx) {
+      CleanupBgenReader(g_bgen_readers[tidx]);
+    }
+    g_bgen_readers = nullptr;
+  }
   CswriteCloseCond(&css, cswritep);
   BigstackReset(bigstack_mark);
   return reterr;
@@ -6138,7 +6192,7 @@ PglErr GlmLinear(const char* cur_pheno_name, const char* const* test_names, cons
 
 static const double kSexMaleToCovarD[2] = {2.0, 1.0};
 
-PglErr GlmMain(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const PhenoCol* covar_cols, const char* covar_names, const uintptr_t* orig_variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const AdjustInfo* adjust_info_ptr, const APerm* aperm_ptr, const char* local_covar_fname, const char* local_pvar_fname, const char* local_psam_fname, uint32_t raw_sample_ct, uint32_t orig_sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t orig_covar_ct, uintptr_t max_covar_name_blen, uint32_t raw_variant_ct, uint32_t orig_variant_ct, uint32_t max_variant_id_slen, uint32_t max_allele_slen, uint32_t xchr_model, double ci_size, double vif_thresh, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+PglErr GlmMain(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* sex_nm, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const PhenoCol* covar_cols, const char* covar_names, const uintptr_t* orig_variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const char* const* allele_storage, const GlmInfo* glm_info_ptr, const AdjustInfo* adjust_info_ptr, const APerm* aperm_ptr, const char* local_covar_fname, const char* local_pvar_fname, const char* local_psam_fname, uint32_t raw_sample_ct, uint32_t orig_sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t orig_covar_ct, uintptr_t max_covar_name_blen, uint32_t raw_variant_ct, uint32_t orig_variant_ct, uint32_t max_variant_id_slen, uint32_t max_allele_slen, uint32_t xchr_model, double ci_size, double vif_thresh, double pfilter, double output_min_p, uint32_t max_thread_ct, uintptr_t pgr_alloc_cacheline_ct, PgenFileInfo* pgfip, PgenReader* simple_pgrp, BgenReader* bgen_direct_rp, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   PglErr reterr = kPglRetSuccess;
@@ -6444,14 +6498,22 @@ PglErr GlmMain(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, c
               bigstack_end_alloc_dosage(raw_sample_ct, &dosage_main)) {
             goto GlmMain_ret_NOMEM;
           }
-          PgrClearLdCache(simple_pgrp);
+          if (!bgen_direct_rp) {
+            PgrClearLdCache(simple_pgrp);
+          }
           for (uint32_t condition_idx = 0; condition_idx < condition_ct; ++condition_idx) {
             const uint32_t cur_variant_uidx = condition_uidxs[condition_idx];
             uint32_t dosage_ct;
-            reterr = PgrGetD(nullptr, nullptr, raw_sample_ct, cur_variant_uidx, simple_pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+            if (!bgen_direct_rp) {
+              reterr = PgrGetD(nullptr, nullptr, raw_sample_ct, cur_variant_uidx, simple_pgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+            } else {
+              reterr = BgenGetD(nullptr, raw_sample_ct, cur_variant_uidx, bgen_direct_rp, genovec, dosage_present, dosage_main, &dosage_ct);
+            }
             if (reterr) {
               if (reterr == kPglRetMalformedInput) {
-                logerrputs("Error: Malformed .pgen file.\n");
+                logerrputs(bgen_direct_rp? "Error: Invalid compressed SNP block in .bgen file.\n" : "Error: Malformed .pgen file.\n");
+              } else if (reterr == kPglRetNotYetSupported) {
+                logerrputs("Error: BGEN import doesn't currently support >16-bit probability precision or\nploidy > 2.\n");
               }
               goto GlmMain_ret_1;
             }
@@ -7290,9 +7352,9 @@ PglErr GlmMain(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, c
 
       uint32_t valid_variant_ct = 0;
       if (is_logistic) {
-        reterr = GlmLogistic(cur_pheno_name, cur_test_names, cur_test_names_x, cur_test_names_y, glm_pos_col? variant_bps : nullptr, variant_ids, allele_storage, glm_info_ptr, local_sample_uidx_order, cur_local_variant_include, outname, raw_variant_ct, max_chr_blen, ci_size, pfilter, output_min_p, max_thread_ct, pgr_alloc_cacheline_ct, overflow_buf_size, local_sample_ct, pgfip, &local_covar_rls, valid_variants, orig_negln_pvals, orig_permstat, &valid_variant_ct);
+        reterr = GlmLogistic(cur_pheno_name, cur_test_names, cur_test_names_x, cur_test_names_y, glm_pos_col? variant_bps : nullptr, variant_ids, allele_storage, glm_info_ptr, local_sample_uidx_order, cur_local_variant_include, outname, raw_variant_ct, max_chr_blen, ci_size, pfilter, output_min_p, max_thread_ct, pgr_alloc_cacheline_ct, overflow_buf_size, local_sample_ct, pgfip, bgen_direct_rp, &local_covar_rls, valid_variants, orig_negln_pvals, orig_permstat, &valid_variant_ct);
       } else {
-        reterr = GlmLinear(cur_pheno_name, cur_test_names, cur_test_names_x, cur_test_names_y, glm_pos_col? variant_bps : nullptr, variant_ids, allele_storage, glm_info_ptr, local_sample_uidx_order, cur_local_variant_include, outname, raw_variant_ct, max_chr_blen, ci_size, pfilter, output_min_p, max_thread_ct, pgr_alloc_cacheline_ct, overflow_buf_size, local_sample_ct, pgfip, &local_covar_rls, valid_variants, orig_negln_pvals, &valid_variant_ct);
+        reterr = GlmLinear(cur_pheno_name, cur_test_names, cur_test_names_x, cur_test_names_y, glm_pos_col? variant_bps : nullptr, variant_ids, allele_storage, glm_info_ptr, local_sample_uidx_order, cur_local_variant_include, outname, raw_variant_ct, max_chr_blen, ci_size, pfilter, output_min_p, max_thread_ct, pgr_alloc_cacheline_ct, overflow_buf_size, local_sample_ct, pgfip, bgen_direct_rp, &local_covar_rls, valid_variants, orig_negln_pvals, &valid_variant_ct);
       }
       if (reterr) {
         goto GlmMain_ret_1;
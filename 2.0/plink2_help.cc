@@ -138,17 +138,19 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
     // represented in practice, since it isn't in the spec...
     HelpPrint("vcf\tbcf\tpsam", &help_ctrl, 1,
 "  --vcf [filename] <dosage=[field]>\n"
-"  --bcf [filename] <dosage=[field]>  (not implemented yet)\n"
+"  --bcf [filename] <dosage=[field]>\n"
 "    Specify full name of .vcf{.gz|.zst} or BCF2 file to import.\n"
 "    * These can be used with --psam.\n"
 "    * By default, dosage information is not imported.  To import the GP field\n"
 "      (must be VCFv4.3-style 0..1, one probability per possible genotype), add\n"
 "      'dosage=GP'.  'dosage=DS' (or anything else) causes the named field to be\n"
-"      interpreted as a Minimac3-style dosage.\n\n"
+"      interpreted as a Minimac3-style dosage.\n"
+"    * BCF2 files must be BGZF-compressed (bcftools's default).  Genotype and\n"
+"      dosage arrays are decoded directly, without a text round-trip.\n\n"
                );
     HelpPrint("data\tgen\tbgen\tsample\thaps\tlegend", &help_ctrl, 1,
 "  --data [filename prefix] <ref-first | ref-last> <gzs>\n"
-"  --bgen [filename] <snpid-chr> <ref-first | ref-last>\n"
+"  --bgen [filename] <snpid-chr> <ref-first | ref-last> <direct>\n"
 "  --gen [filename] <ref-first | ref-last>\n"
 "  --sample [filename]\n"
 "    Specify an Oxford-format dataset to import.  --data specifies a .gen{.zst}\n"
@@ -159,7 +161,14 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      instead of the usual chromosome field.\n"
 "    * By default, the last allele for each variant is treated as a provisional\n"
 "      reference allele.  To specify that the first (resp. last) allele really\n"
-"      is always reference, add the 'ref-first' (resp. 'ref-last') modifier.\n\n"
+"      is always reference, add the 'ref-first' (resp. 'ref-last') modifier.\n"
+"    * With 'direct', a BGEN v1.2/v1.3 file's genotype blocks are not converted;\n"
+"      instead, genotypes are decoded from the .bgen on demand, using a\n"
+"      .bgen.idx variant offset index (see --export 'bgen-index').  If the\n"
+"      .bgen's own index is absent or doesn't cover the retained variants, one\n"
+"      is written next to the .pvar.  This currently works with --freq, --glm,\n"
+"      --score, and --maf/--max-maf/--mac/--max-mac, and requires all variants\n"
+"      to be biallelic.\n\n"
                );
     // todo: make 'per' prefix modifiable
     HelpPrint("haps\tlegend", &help_ctrl, 1,
@@ -223,6 +232,18 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      them take on decimal values, use 'dosage-freq='.  (These dosages are\n"
 "      affected by --hard-call-threshold and --dosage-erase-threshold.)\n\n"
                );
+    HelpPrint("pmerge-list", &help_ctrl, 1,
+"  --pmerge-list [filename]\n"
+"    Merge the .pgen filesets named in the given file into a single fileset.\n"
+"    Each line of the file contains either a .pgen/.pvar/.psam prefix, or the\n"
+"    full names of the .pgen, .pvar, and .psam files (in that order).\n"
+"    * Currently, either all filesets must contain the same samples in the same\n"
+"      order (in which case each .pvar must be sorted, and variants are merged\n"
+"      by position), or all filesets must contain the same variants in the same\n"
+"      order and have disjoint sample sets (which are concatenated).\n"
+"    * In the former case, most .pgen records are copied without being\n"
+"      decoded.\n\n"
+               );
     if (!param_ct) {
       fputs(
 "Output files have names of the form 'plink2.{extension}' by default.  You can\n"
@@ -344,10 +365,11 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
     HelpPrint("export\trecode", &help_ctrl, 1,
 "  --export [output format(s)...] <01 | 12> <bgz> <id-delim=[char]>\n"
 "    <id-paste=[column set descriptor]> <include-alt> <omit-nonmale-y> <spaces>\n"
-"    <vcf-dosage=[field]> <ref-first> <bits=[#]>\n"
+"    <vcf-dosage=[field]> <vcf-index=[tbi | csi]> <ref-first> <bits=[#]>\n"
+"    <bgen-index>\n"
 "    Create a new fileset with all filters applied.  The following output\n"
 "    formats are supported:\n"
-"    (actually, only A, AD, A-transpose, bgen-1.1, ind-major-bed, haps,\n"
+"    (actually, only A, AD, A-transpose, bcf, bgen-1.x, ind-major-bed, haps,\n"
 "    hapslegend, oxford, and vcf are implemented for now)\n"
 "    * '23': 23andMe 4-column format.  This can only be used on a single\n"
 "            sample's data (--keep may be handy), and does not support\n"
@@ -358,13 +380,21 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "    * 'AD': Sample-major additive (0/1/2) + dominant (het=1/hom=0) coding.\n"
 "            Also supports 'include-alt'.\n"
 "    * 'A-transpose': Variant-major 0/1/2.\n"
+"    * 'bcf': BCF2 with the same contents as 'vcf'; the id-paste, id-delim,\n"
+"             and vcf-dosage modifiers work the same way.  All FILTER and INFO\n"
+"             keys must be declared in the header.\n"
 "    * 'beagle': Unphased per-autosome .dat and .map files, readable by early\n"
 "                BEAGLE versions.\n"
 "    * 'beagle-nomap': Single .beagle.dat file.\n"
 "    * 'bgen-1.x': Oxford-format .bgen + .sample.  For v1.2/v1.3, sample\n"
 "                  identifiers are stored in the .bgen (with id-delim and\n"
 "                  id-paste settings applied), and default precision is 16-bit\n"
-"                  (use the 'bits' modifier to change this).\n"
+"                  (use the 'bits' modifier to change this).  v1.3 genotype\n"
+"                  blocks are Zstd-compressed (see --zst-level).  With\n"
+"                  'bgen-index', a .bgen.idx file containing the byte offset\n"
+"                  of every variant record (as little-endian uint64s after a\n"
+"                  16-byte header, followed by the file size) is also\n"
+"                  written.\n"
 "    * 'bimbam': Regular BIMBAM format.\n"
 "    * 'bimbam-1chr': BIMBAM format, with a two-column .pos.txt file.  Does not\n"
 "                     support multiple chromosomes.\n"
@@ -399,7 +429,8 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "    * 'vcf': VCFv4.3.  If PAR1 and PAR2 are present, they are automatically\n"
 "             merged with chrX, with proper handling of chromosome codes and\n"
 "             male ploidy.  When the 'bgz' modifier is present, the VCF file is\n"
-"             block-gzipped.\n"
+"             block-gzipped; add 'vcf-index=tbi' or 'vcf-index=csi' to also\n"
+"             write a tabix or CSI index for it.\n"
 "             The 'id-paste' modifier controls which .psam columns are used to\n"
 "             construct sample IDs (choices are maybefid, fid, iid, maybesid,\n"
 "             and sid; default is maybefid,iid,maybesid), while the 'id-delim'\n"
@@ -600,7 +631,7 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
     // there may be more work to do re: not blowing the cache when there are
     // 100k+ samples)
     HelpPrint("make-king\tmake-king-table", &help_ctrl, 1,
-"  --make-king <square | square0 | triangle> <zs | bin | bin4>\n"
+"  --make-king <square | square0 | triangle> <zs | bin | bin4 | sparse>\n"
 "    KING-robust kinship estimator, described by Manichaikul A, Mychaleckyj JC,\n"
 "    Rich SS, Daly K, Sale M, Chen WM (2010) Robust relationship inference in\n"
 "    genome-wide association studies.  By default, this writes a\n"
@@ -622,6 +653,11 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      single-precision numbers instead.)  This can be combined with 'square0'\n"
 "      if you still want the upper right zeroed out, or 'triangle' if you don't\n"
 "      want to pad the upper right at all.\n"
+"    * If the 'sparse' modifier is present, only the diagonal and the kinship\n"
+"      coefficients larger than --sparse-cutoff are written, as binary\n"
+"      (row index, column index, value) triplets (uint32, uint32, float32;\n"
+"      0-based indexes into the .id file, lower triangle, row-major order) to\n"
+"      {output prefix}.king.sp.bin.\n"
 "    * The computation can be subdivided with --parallel.\n"
 "  --make-king-table <zs> <counts> <cols=[column set descriptor]>\n"
 "    Similar to --make-king, except results are reported in the original .kin0\n"
@@ -643,7 +679,8 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "    present.  If id is omitted, a .kin0.id file is also written.\n\n"
                );
     HelpPrint("make-rel\tmake-grm\tmake-grm-bin\tmake-grm-list\tmake-grm-gz", &help_ctrl, 1,
-"  --make-rel <cov> <meanimpute> <square | square0 | triangle> <zs | bin | bin4>\n"
+"  --make-rel <cov> <meanimpute> <square | square0 | triangle>\n"
+"             <zs | bin | bin4 | sparse>\n"
 "    Write a lower-triangular variance-standardized relationship matrix to\n"
 "    {output prefix}.rel, and corresponding IDs to {output prefix}.rel.id.\n"
 "    * This computation assumes that variants do not have very low MAF, or\n"
@@ -655,7 +692,12 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      approximate linkage equilibrium.\n"
 "    * The 'cov' modifier replaces the variance-standardization step with basic\n"
 "      mean-centering, causing a covariance matrix to be calculated instead.\n"
+"    * 'sparse' causes only the diagonal and the entries larger than\n"
+"      --sparse-cutoff to be written, in the binary triplet format described\n"
+"      under --make-king, to {output prefix}.rel.sp.bin.\n"
 "    * The computation can be subdivided with --parallel.\n"
+"    * When the matrix doesn't fit in memory, it is computed in multiple passes\n"
+"      over the genotype data (not supported for 'square' shape).\n"
 "  --make-grm-list <cov> <meanimpute> <zs> <id-header | iid-only>\n"
 "  --make-grm-bin <cov> <meanimpute> <id-header | iid-only>\n"
 "    --make-grm-list causes the relationships to be written to GCTA's original\n"
@@ -712,6 +754,21 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      Default is chrom,maj,nonmaj.\n\n"
                );
 #endif
+    HelpPrint("pca-project\tpca", &help_ctrl, 1,
+"  --pca-project [.eigenvec.var file] <.eigenval file>\n"
+"    Projects the current samples onto principal components previously computed\n"
+"    with '--pca var-wts', writing scores to {output prefix}.proj.eigenvec.\n"
+"    * The .eigenvec.var file must contain the ID and MAJ columns (both present\n"
+"      by default).  If the .eigenval filename is omitted, it is inferred from\n"
+"      the .eigenvec.var filename.\n"
+"    * Genotypes are variance-standardized using the current allele frequencies,\n"
+"      so you should normally pass the reference dataset's .afreq file to\n"
+"      --read-freq.  Missing calls, and variants absent from the current\n"
+"      dataset, are mean-imputed.  Projecting the reference samples themselves\n"
+"      reproduces the original .eigenvec values only when they have no missing\n"
+"      calls; otherwise the results differ slightly, since --pca corrects the\n"
+"      GRM for missing data instead of mean-imputing.\n\n"
+               );
     HelpPrint("king-cutoff\tmake-king\tmake-king-table\trel-cutoff\tgrm-cutoff", &help_ctrl, 1,
 "  --king-cutoff {.king.bin + .king.id fileset prefix} [threshold]\n"
 "    Exclude one member of each pair of samples with KING-robust kinship greater\n"
@@ -855,7 +912,8 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
     HelpPrint("score", &help_ctrl, 1,
 "  --score [filename] {i} {j} {k} <header | header-read> <no-mean-imputation>\n"
 "          <center | variance-standardize | dominant | recessive> <se> <zs>\n"
-"          <list-variants | list-variants-zs> <cols=[col set descriptor]>\n"
+"          <list-variants | list-variants-zs> <bin | bin4>\n"
+"          <cols=[col set descriptor]>\n"
 "    Apply linear scoring system(s) to each sample.\n"
 "    The input file should have one line per scored variant.  Variant IDs are\n"
 "    read from column #i and allele codes are read from column #j, where i\n"
@@ -884,6 +942,17 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "      underestimate standard errors when scored variants are in LD.)\n"
 "    * The 'list-variants{-zs}' modifier causes variant IDs used for scoring to\n"
 "      be written to [output prefix].sscore.vars{.zst}.\n"
+"    * If the 'bin' modifier is present, scores are instead written as a binary\n"
+"      matrix of double-precision floating point values to\n"
+"      [output prefix].sscore.bin, in score-major order (all samples for the\n"
+"      first score, then all samples for the second, etc.), with score names in\n"
+"      [output prefix].sscore.cols.  ('bin4' uses single-precision arithmetic\n"
+"      and output, halving memory requirements.)  Score averages are written\n"
+"      unless cols= includes 'scoresums' but not 'scoreavgs'.  The remaining\n"
+"      columns are still written to the main report.  When there isn't enough\n"
+"      memory to handle all scores at once, they're processed in multiple\n"
+"      passes.  This is intended for very wide (e.g. 10000-column) score files;\n"
+"      blocks of all-zero coefficients are skipped.\n"
 "    The main report supports the following column sets:\n"
 "      maybefid: FID, if that column was in the input.\n"
 "      fid: Force FID column to be written even when absent in the input.\n"
@@ -1043,6 +1112,14 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                                    largest probability is less than a\n"
 "                                    threshold, use --import-dosage-certainty.\n"
                );
+    HelpPrint("pvar-cache\tpfile\tpvar", &help_ctrl, 0,
+"  --pvar-cache : Save the parsed .pvar/.bim to [filename].pvc, and load from\n"
+"                that file instead on later runs while the .pvar/.bim is\n"
+"                unchanged.  This is skipped when variant filters/ID changes\n"
+"                which are applied during loading (--var-min-qual,\n"
+"                --set-all-var-ids, --extract-if-info, --split-par, etc.) are\n"
+"                in effect.\n"
+               );
     HelpPrint("input-missing-genotype\tmissing-genotype", &help_ctrl, 0,
 "  --input-missing-genotype [c] : '.' is always interpreted as a missing\n"
 "                                 genotype code in input files.  By default, '0'\n"
@@ -1341,6 +1418,12 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                       --geno-counts (or PLINK 1.9 --freqx) report, instead of\n"
 "                       imputing them from the immediate dataset.\n"
                );
+    HelpPrint("freq-cache\tread-freq\tfreq\tgeno-counts", &help_ctrl, 0,
+"  --freq-cache : Save allele dosages and genotype counts to [.pgen name].afc,\n"
+"                and reuse them on later runs while the .pgen is unchanged.  If\n"
+"                the current sample set is a subset of the cached one, only the\n"
+"                removed samples are rescanned, and their counts subtracted.\n"
+               );
 // todo: something like <check-ctrls>/<check-ctrl=[case/ctrl phenotype name]>
 // and maybe <ctrls-only>/<ctrl-only=[case/ctrl phenotype name]>
     HelpPrint("hwe\tmach-r2-filter", &help_ctrl, 0,
@@ -1410,11 +1493,20 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                                   phenotypes in output files (default 'NA').\n"
                );
     HelpPrint("sort-vars", &help_ctrl, 0,
-"  --sort-vars {mode}      : Sort variants by chromosome, then position, then\n"
-"                            ID.  The following string orders are supported:\n"
-"                            * 'natural'/'n': Natural sort (default).\n"
-"                            * 'ascii'/'a': ASCII.\n"
-"                            This must be used with --make-{b}pgen/--make-bed.\n"
+"  --sort-vars {mode} {external} : Sort variants by chromosome, then position,\n"
+"                                  then ID.  The following string orders are\n"
+"                                  supported:\n"
+"                                  * 'natural'/'n': Natural sort (default).\n"
+"                                  * 'ascii'/'a': ASCII.\n"
+"                                  With 'external', --make-pgen reads the\n"
+"                                  input .pgen sequentially, writes sorted runs\n"
+"                                  to temporary files next to the output\n"
+"                                  prefix, and merges them; use this when the\n"
+"                                  input is much larger than RAM and badly\n"
+"                                  unsorted.  (Only supported when genotypes\n"
+"                                  are passed through unchanged.)\n"
+"                                  This must be used with\n"
+"                                  --make-{b}pgen/--make-bed.\n"
                );
     HelpPrint("set-hh-missing\tset-mixed-mt-missing", &help_ctrl, 0,
 "  --set-hh-missing <keep-dosage>       : Make --make-{b}pgen/--make-bed set\n"
@@ -1515,6 +1607,9 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                               insertions).  By default, it errors out when\n"
 "                               asked to change a 'known' reference allele; add\n"
 "                               the 'force' modifier to permit that.\n"
+"                               If an uncompressed FASTA has a .fai index\n"
+"                               alongside it, only the bases at variant\n"
+"                               positions are read.\n"
                );
     HelpPrint("indiv-sort", &help_ctrl, 0,
 "  --indiv-sort [m] {f} : Specify sample ID sort order for merge and\n"
@@ -1541,6 +1636,11 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                                   sample pairs with kinship >= that threshold\n"
 "                                   (in the input .kin0) are processed.\n"
                );
+    HelpPrint("sparse-cutoff\tmake-king\tmake-rel", &help_ctrl, 0,
+"  --sparse-cutoff [min] : Set minimum off-diagonal value written by --make-king\n"
+"                          or --make-rel 'sparse' (default 0.025 for KING,\n"
+"                          0.05 for --make-rel).\n"
+               );
     HelpPrint("glm\tlinear\tlogistic\tcondition\tcondition-list\tparameters\ttests", &help_ctrl, 0,
 "  --condition [var ID] <dominant | recessive> : Add one variant's A1 dosages\n"
 "                                                as a --glm covariate.\n"
@@ -1637,6 +1737,16 @@ PglErr DispHelp(const char* const* argvk, uint32_t param_ct) {
 "                       symmetric square matrix.  Choose square0 or triangle\n"
 "                       shape instead, and postprocess as necessary.\n"
                );
+    HelpPrint("checkpoint\tmake-king\tmake-king-table\tmake-rel\tmake-grm-list\tmake-grm-bin", &help_ctrl, 0,
+"  --checkpoint {min} : Every [min] minutes (default 60), save the partial\n"
+"                       --make-king/--make-rel/etc. sums to\n"
+"                       {output prefix}.king.ckpt or {output prefix}.grm.ckpt\n"
+"                       (with the --parallel piece number, if any, before\n"
+"                       '.ckpt').  When the same command is rerun after an\n"
+"                       interruption, it resumes from the last checkpoint.\n"
+"                       The file is deleted on successful completion.  (Not\n"
+"                       supported by --pca approx.)\n"
+               );
     HelpPrint("memory\tseed", &help_ctrl, 0,
 "  --memory [val] <require> : Set size, in MB, of initial workspace malloc\n"
 "                             attempt.  To error out instead of reducing the\n"
@@ -1961,6 +1961,1674 @@ PglErr VcfToPgen(const char* vcfname, const char* preexisting_psamname, const ch
   return reterr;
 }
 
+// BCF2 integer missing-value and end-of-vector sentinels, after BcfGetInt()
+// widening.
+static const int32_t kBcfIntMissing = -2147483647 - 1;
+static const int32_t kBcfIntVectorEnd = -2147483647;
+
+static const unsigned char kBcfTypeByteCts[8] = {0, 1, 2, 4, 0, 4, 0, 1};
+
+// Returns nullptr on malformed input.  Otherwise, returns a pointer to the
+// first value, and *vals_end_ptr is set to the end of the (val_mult *
+// val_ct)-entry value array.
+static const unsigned char* BcfScanTypedVals(const unsigned char* iter, const unsigned char* end, uintptr_t val_mult, uint32_t* type_ptr, uint32_t* val_ct_ptr, const unsigned char** vals_end_ptr) {
+  if (iter >= end) {
+    return nullptr;
+  }
+  const uint32_t descriptor = *iter++;
+  const uint32_t cur_type = descriptor & 15;
+  if ((cur_type > kBcfTypeChar) || (cur_type && (!kBcfTypeByteCts[cur_type]))) {
+    return nullptr;
+  }
+  uint32_t val_ct = descriptor >> 4;
+  if (val_ct == 15) {
+    // actual count stored as a typed integer scalar
+    if (iter == end) {
+      return nullptr;
+    }
+    const uint32_t ct_descriptor = *iter++;
+    const uint32_t ct_type = ct_descriptor & 15;
+    if (((ct_descriptor >> 4) != 1) || (!ct_type) || (ct_type > kBcfTypeInt32)) {
+      return nullptr;
+    }
+    const uint32_t ct_byte_ct = kBcfTypeByteCts[ct_type];
+    if (S_CAST(uintptr_t, end - iter) < ct_byte_ct) {
+      return nullptr;
+    }
+    int32_t ii;
+    if (ct_type == kBcfTypeInt8) {
+      ii = S_CAST(int8_t, *iter);
+    } else if (ct_type == kBcfTypeInt16) {
+      int16_t sxx;
+      memcpy(&sxx, iter, 2);
+      ii = sxx;
+    } else {
+      memcpy(&ii, iter, 4);
+    }
+    if (ii < 0) {
+      return nullptr;
+    }
+    iter = &(iter[ct_byte_ct]);
+    val_ct = ii;
+  }
+  const uint64_t byte_ct = S_CAST(uint64_t, val_mult) * val_ct * kBcfTypeByteCts[cur_type];
+  if (byte_ct > S_CAST(uintptr_t, end - iter)) {
+    return nullptr;
+  }
+  *type_ptr = cur_type;
+  *val_ct_ptr = val_ct;
+  *vals_end_ptr = &(iter[byte_ct]);
+  return iter;
+}
+
+// Converts a BCF2 integer to int32, mapping the type-specific missing and
+// end-of-vector sentinels to kBcfIntMissing and kBcfIntVectorEnd.
+HEADER_INLINE int32_t BcfGetInt(const unsigned char* val_ptr, uint32_t val_type) {
+  if (val_type == kBcfTypeInt8) {
+    const int32_t ii = S_CAST(int8_t, *val_ptr);
+    return (ii > -121)? ii : (kBcfIntMissing + (ii + 128));
+  }
+  if (val_type == kBcfTypeInt16) {
+    int16_t sxx;
+    memcpy(&sxx, val_ptr, 2);
+    const int32_t ii = sxx;
+    return (ii > -32761)? ii : (kBcfIntMissing + (ii + 32768));
+  }
+  int32_t ii;
+  memcpy(&ii, val_ptr, 4);
+  return ii;
+}
+
+// Returns 1 if the value is missing or an end-of-vector marker.
+HEADER_INLINE BoolErr BcfGetDouble(const unsigned char* val_ptr, uint32_t val_type, double* dxx_ptr) {
+  if (val_type == kBcfTypeFloat) {
+    uint32_t uii;
+    memcpy(&uii, val_ptr, 4);
+    if ((uii == kBcfFloatMissingBits) || (uii == kBcfFloatVectorEndBits)) {
+      return 1;
+    }
+    float fxx;
+    memcpy(&fxx, val_ptr, 4);
+    *dxx_ptr = S_CAST(double, fxx);
+    return 0;
+  }
+  const int32_t ii = BcfGetInt(val_ptr, val_type);
+  if ((ii == kBcfIntMissing) || (ii == kBcfIntVectorEnd)) {
+    return 1;
+  }
+  *dxx_ptr = S_CAST(double, ii);
+  return 0;
+}
+
+// Dictionary-index scalar (INFO/FORMAT key, FILTER entry).  Returns UINT32_MAX
+// if it doesn't refer to a defined dictionary entry.
+HEADER_INLINE uint32_t BcfDictIdx(const unsigned char* val_ptr, uint32_t val_type, uint32_t dict_size, const char* const* dict) {
+  const int32_t ii = BcfGetInt(val_ptr, val_type);
+  if ((S_CAST(uint32_t, ii) >= dict_size) || (!dict[S_CAST(uint32_t, ii)])) {
+    return UINT32_MAX;
+  }
+  return ii;
+}
+
+HEADER_INLINE uint32_t BcfCharValsSlen(const unsigned char* vals, uint32_t val_ct) {
+  // strip trailing nulls
+  while (val_ct && (!vals[val_ct - 1])) {
+    --val_ct;
+  }
+  return val_ct;
+}
+
+static const unsigned char* BcfScanTypedKey(const unsigned char* iter, const unsigned char* end, uint32_t dict_size, const char* const* dict, uint32_t* key_ptr) {
+  uint32_t key_type;
+  uint32_t key_val_ct;
+  const unsigned char* key_end;
+  iter = BcfScanTypedVals(iter, end, 1, &key_type, &key_val_ct, &key_end);
+  if ((!iter) || (key_val_ct != 1) || (!key_type) || (key_type > kBcfTypeInt32)) {
+    return nullptr;
+  }
+  *key_ptr = BcfDictIdx(iter, key_type, dict_size, dict);
+  if (*key_ptr == UINT32_MAX) {
+    return nullptr;
+  }
+  return key_end;
+}
+
+// Extracts the ID from a ##FILTER/##INFO/##FORMAT/##contig header line (with
+// id_start pointing just past "<ID="), along with the value of its IDX field
+// (UINT32_MAX if absent).  Returns 1 on failure.
+static BoolErr BcfHeaderLineParse(const char* id_start, const char* line_end, const char** id_end_ptr, uint32_t* idx_ptr) {
+  const char* id_end = id_start;
+  while ((id_end != line_end) && (*id_end != ',') && (*id_end != '>')) {
+    ++id_end;
+  }
+  if ((id_end == id_start) || (id_end == line_end)) {
+    return 1;
+  }
+  *id_end_ptr = id_end;
+  *idx_ptr = UINT32_MAX;
+  const char* comma_iter = id_end;
+  while (1) {
+    comma_iter = S_CAST(const char*, memchr(comma_iter, ',', line_end - comma_iter));
+    if (!comma_iter) {
+      return 0;
+    }
+    ++comma_iter;
+    if (StrStartsWithUnsafe(comma_iter, "IDX=")) {
+      // htslib appends IDX last, so the final occurrence wins
+      if (ScanUintDefcap(&(comma_iter[4]), idx_ptr)) {
+        return 1;
+      }
+    }
+  }
+}
+
+// Adds name to a BCF2 header dictionary at dict_idx (or the first free slot at
+// or after *next_free_idx_ptr, when dict_idx == UINT32_MAX), unless it's
+// already present.  Returns UINT32_MAX if this conflicts with an earlier IDX
+// assignment.
+static uint32_t BcfDictAdd(const char* name, uint32_t name_slen, uint32_t dict_idx, uint32_t htable_size, const char** dict, uint32_t* htable, uint32_t* next_free_idx_ptr) {
+  uint32_t hashval = Hashceil(name, name_slen, htable_size);
+  while (1) {
+    const uint32_t cur_htable_idval = htable[hashval];
+    if (cur_htable_idval == UINT32_MAX) {
+      break;
+    }
+    if (!strcmp(name, dict[cur_htable_idval])) {
+      if ((dict_idx != UINT32_MAX) && (dict_idx != cur_htable_idval)) {
+        return UINT32_MAX;
+      }
+      return cur_htable_idval;
+    }
+    if (++hashval == htable_size) {
+      hashval = 0;
+    }
+  }
+  if (dict_idx == UINT32_MAX) {
+    dict_idx = *next_free_idx_ptr;
+    while (dict[dict_idx]) {
+      ++dict_idx;
+    }
+    *next_free_idx_ptr = dict_idx + 1;
+  } else if (dict[dict_idx]) {
+    return UINT32_MAX;
+  }
+  dict[dict_idx] = name;
+  htable[hashval] = dict_idx;
+  return dict_idx;
+}
+
+// Reads exactly byte_ct bytes.  Returns kPglRetEof if the stream was already
+// at its end, and kPglRetMalformedInput if it ended partway through.
+static PglErr BcfReadExact(BGZF* bgzfp, uintptr_t byte_ct, void* buf) {
+  const ssize_t nread = bgzf_read(bgzfp, buf, byte_ct);
+  if (nread < 0) {
+    return kPglRetReadFail;
+  }
+  if (S_CAST(uintptr_t, nread) == byte_ct) {
+    return kPglRetSuccess;
+  }
+  return nread? kPglRetMalformedInput : kPglRetEof;
+}
+
+static PglErr BcfOpen(const char* bcfname, uint32_t decompress_thread_ct, BGZF** bgzfpp) {
+  *bgzfpp = bgzf_open(bcfname, "r");
+  if (!(*bgzfpp)) {
+    // bgzf_open() also fails on uncompressed and plain-gzip files; distinguish
+    // those from a missing file.
+    FILE* probe = fopen(bcfname, FOPEN_RB);
+    if (probe) {
+      fclose(probe);
+      return kPglRetMalformedInput;
+    }
+    return kPglRetOpenFail;
+  }
+#ifndef _WIN32
+  if (decompress_thread_ct > 1) {
+    if (bgzf_mt(*bgzfpp, decompress_thread_ct, 128)) {
+      return kPglRetNomem;
+    }
+  }
+#endif
+  return kPglRetSuccess;
+}
+
+typedef struct BcfFmtFieldStruct {
+  const unsigned char* vals;  // nullptr if field absent
+  uint32_t type;
+  uint32_t val_ct;  // per sample
+} BcfFmtField;
+
+// Locates GT, and the GQ/DP/dosage fields if their keys aren't UINT32_MAX.
+// Returns 1 on malformed input.
+static BoolErr BcfLocateFmtFields(const unsigned char* indiv_iter, const unsigned char* indiv_end, uint32_t fmt_ct, uint32_t sample_ct, uint32_t dict_size, const char* const* dict, const uint32_t* fmt_keys, BcfFmtField* fmt_fields) {
+  for (uint32_t uii = 0; uii != 4; ++uii) {
+    fmt_fields[uii].vals = nullptr;
+  }
+  for (uint32_t fmt_idx = 0; fmt_idx != fmt_ct; ++fmt_idx) {
+    uint32_t key;
+    indiv_iter = BcfScanTypedKey(indiv_iter, indiv_end, dict_size, dict, &key);
+    if (!indiv_iter) {
+      return 1;
+    }
+    uint32_t cur_type;
+    uint32_t cur_val_ct;
+    const unsigned char* vals_end;
+    const unsigned char* vals = BcfScanTypedVals(indiv_iter, indiv_end, sample_ct, &cur_type, &cur_val_ct, &vals_end);
+    if (!vals) {
+      return 1;
+    }
+    indiv_iter = vals_end;
+    for (uint32_t uii = 0; uii != 4; ++uii) {
+      if (key == fmt_keys[uii]) {
+        if (!cur_val_ct) {
+          break;
+        }
+        // GT/GQ/DP must be integers; dosage can be integer or float
+        if ((!cur_type) || (cur_type == kBcfTypeChar) || ((uii != 3) && (cur_type == kBcfTypeFloat))) {
+          return 1;
+        }
+        fmt_fields[uii].vals = vals;
+        fmt_fields[uii].type = cur_type;
+        fmt_fields[uii].val_ct = cur_val_ct;
+        break;
+      }
+    }
+  }
+  return 0;
+}
+
+// returns 1 if a quality check failed
+HEADER_INLINE uint32_t BcfQualFail(const unsigned char* val_ptr, uint32_t val_type, int32_t min_val) {
+  const int32_t ii = BcfGetInt(val_ptr, val_type);
+  return (ii < min_val) && (ii != kBcfIntMissing) && (ii != kBcfIntVectorEnd);
+}
+
+// Analogue of ParseVcfDosage().
+static BoolErr ParseBcfDosage(const unsigned char* dosage_vals, uint32_t dosage_type, uint32_t dosage_val_ct, uint32_t is_haploid, uint32_t dosage_is_gp, double import_dosage_certainty, uint32_t* is_missing_ptr, uint32_t* dosage_int_ptr) {
+  // assumes is_missing initialized to 0
+  double alt_dosage;
+  if (BcfGetDouble(dosage_vals, dosage_type, &alt_dosage)) {
+    *is_missing_ptr = 1;
+    return 1;
+  }
+  if (dosage_is_gp) {
+    // P(0/0), P(0/1), P(1/1)
+    const uint32_t prob_ct = 3 - is_haploid;
+    if (dosage_val_ct < prob_ct) {
+      return 1;
+    }
+    const uint32_t type_byte_ct = kBcfTypeByteCts[dosage_type];
+    double probs[3];
+    probs[0] = alt_dosage;
+    for (uint32_t prob_idx = 0; prob_idx != prob_ct; ++prob_idx) {
+      if (prob_idx && BcfGetDouble(&(dosage_vals[prob_idx * type_byte_ct]), dosage_type, &(probs[prob_idx]))) {
+        return 1;
+      }
+      if ((probs[prob_idx] < 0.0) || (probs[prob_idx] > 1.0)) {
+        return 1;
+      }
+    }
+    if (is_haploid) {
+      const double denom = probs[0] + probs[1];
+      if (denom <= 2 * import_dosage_certainty) {
+        if ((probs[0] <= import_dosage_certainty) && (probs[1] <= import_dosage_certainty)) {
+          *is_missing_ptr = 1;
+          return 1;
+        }
+      }
+      alt_dosage = 2 * probs[1] / denom;
+    } else {
+      const double denom = probs[0] + probs[1] + probs[2];
+      if (denom <= 3 * import_dosage_certainty) {
+        if ((probs[0] <= import_dosage_certainty) && (probs[1] <= import_dosage_certainty) && (probs[2] <= import_dosage_certainty)) {
+          *is_missing_ptr = 1;
+          return 1;
+        }
+      }
+      alt_dosage = (probs[1] + 2 * probs[2]) / denom;
+    }
+  } else {
+    if (alt_dosage < 0.0) {
+      return 1;
+    }
+    if (is_haploid) {
+      alt_dosage *= 2;
+    }
+    if (alt_dosage > 2.0) {
+      return 1;
+    }
+  }
+  *dosage_int_ptr = S_CAST(int32_t, alt_dosage * kDosageMid + 0.5);
+  return 0;
+}
+
+// Returns 1 if any GT value has its phase bit set.
+static uint32_t BcfGtPhaseBitPresent(const BcfFmtField* gt_fieldp, uint32_t sample_ct) {
+  const uint32_t gt_type = gt_fieldp->type;
+  const uintptr_t val_ct = S_CAST(uintptr_t, sample_ct) * gt_fieldp->val_ct;
+  const unsigned char* gt_vals = gt_fieldp->vals;
+  if (gt_type == kBcfTypeInt8) {
+    for (uintptr_t ulii = 0; ulii != val_ct; ++ulii) {
+      // int8 end-of-vector (0x81) is the only odd sentinel
+      const uint32_t ucc = gt_vals[ulii];
+      if ((ucc & 1) && (ucc != 0x81)) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+  const uint32_t type_byte_ct = kBcfTypeByteCts[gt_type];
+  for (uintptr_t ulii = 0; ulii != val_ct; ++ulii) {
+    const int32_t ii = BcfGetInt(&(gt_vals[ulii * type_byte_ct]), gt_type);
+    if ((ii & 1) && (ii != kBcfIntVectorEnd)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+ENUM_U31_DEF_START()
+  kBcfGenoParseOk,
+  kBcfGenoParseInvalidGt,
+  kBcfGenoParseHalfCall,
+  kBcfGenoParseInvalidDosage
+ENUM_U31_DEF_END(BcfGenoParseResult);
+
+// BCF2 GT value -> (allele index + 1), 0 for missing, UINT32_MAX for invalid.
+HEADER_INLINE uint32_t BcfGtAlleleP1(int32_t gt_val) {
+  if (gt_val < 0) {
+    return (gt_val == kBcfIntMissing)? 0 : UINT32_MAX;
+  }
+  const uint32_t allele_p1 = S_CAST(uint32_t, gt_val) >> 1;
+  return (allele_p1 <= 2)? allele_p1 : UINT32_MAX;
+}
+
+// Fills genovec, and dosage_present/dosage_main when dosage_fieldp->vals is
+// non-null.  phasepresent/phaseinfo are only filled when phase_aware is set; in
+// that case, hardcalls that conflict with a too-close-to-integer dosage are
+// overridden, as in VcfToPgen()'s phased-het loop.
+static BcfGenoParseResult BcfParseGenotypes(const BcfFmtField* gt_fieldp, const BcfFmtField* gq_fieldp, const BcfFmtField* dp_fieldp, const BcfFmtField* dosage_fieldp, uint32_t sample_ct, int32_t vcf_min_gq, int32_t vcf_min_dp, VcfHalfCall vcf_half_call, uint32_t dosage_is_gp, double import_dosage_certainty, uint32_t dosage_erase_halfdist, uint32_t dosage_erase_halfdist2, uint32_t phase_aware, uintptr_t* __restrict genovec, uintptr_t* __restrict phasepresent, uintptr_t* __restrict phaseinfo, uintptr_t* __restrict dosage_present, Dosage* dosage_main, uint32_t* dosage_ct_ptr) {
+  const uint32_t gt_type = gt_fieldp->type;
+  const uint32_t gt_type_byte_ct = kBcfTypeByteCts[gt_type];
+  const uint32_t gt_val_ct = gt_fieldp->val_ct;
+  const unsigned char* gt_iter = gt_fieldp->vals;
+  const uint32_t gt_stride = gt_val_ct * gt_type_byte_ct;
+  const unsigned char* gq_iter = gq_fieldp->vals;
+  const uint32_t gq_type = gq_fieldp->type;
+  const uint32_t gq_stride = gq_iter? (gq_fieldp->val_ct * kBcfTypeByteCts[gq_type]) : 0;
+  const unsigned char* dp_iter = dp_fieldp->vals;
+  const uint32_t dp_type = dp_fieldp->type;
+  const uint32_t dp_stride = dp_iter? (dp_fieldp->val_ct * kBcfTypeByteCts[dp_type]) : 0;
+  const unsigned char* dosage_iter = dosage_fieldp->vals;
+  const uint32_t dosage_type = dosage_fieldp->type;
+  const uint32_t dosage_val_ct = dosage_fieldp->val_ct;
+  const uint32_t dosage_stride = dosage_iter? (dosage_val_ct * kBcfTypeByteCts[dosage_type]) : 0;
+  Dosage* dosage_main_iter = dosage_main;
+  const uint32_t sample_ctl2_m1 = QuaterCtToWordCt(sample_ct) - 1;
+  uint32_t inner_loop_last = kBitsPerWordD2 - 1;
+  for (uint32_t widx = 0; ; ++widx) {
+    if (widx >= sample_ctl2_m1) {
+      if (widx > sample_ctl2_m1) {
+        break;
+      }
+      inner_loop_last = (sample_ct - 1) % kBitsPerWordD2;
+    }
+    uintptr_t genovec_word = 0;
+    uint32_t phasepresent_hw = 0;
+    uint32_t phaseinfo_hw = 0;
+    uint32_t dosage_present_hw = 0;
+    for (uint32_t sample_idx_lowbits = 0; sample_idx_lowbits <= inner_loop_last; ++sample_idx_lowbits) {
+      uintptr_t cur_geno = 3;
+      if (((!gq_iter) || (!BcfQualFail(gq_iter, gq_type, vcf_min_gq))) && ((!dp_iter) || (!BcfQualFail(dp_iter, dp_type, vcf_min_dp)))) {
+        const int32_t first_val = BcfGetInt(gt_iter, gt_type);
+        uint32_t is_haploid = 0;
+        if (first_val != kBcfIntVectorEnd) {
+          const uint32_t first_allele_p1 = BcfGtAlleleP1(first_val);
+          int32_t second_val = kBcfIntVectorEnd;
+          if (gt_val_ct > 1) {
+            second_val = BcfGetInt(&(gt_iter[gt_type_byte_ct]), gt_type);
+          }
+          if (second_val == kBcfIntVectorEnd) {
+            is_haploid = 1;
+            if (first_allele_p1 == UINT32_MAX) {
+              return kBcfGenoParseInvalidGt;
+            }
+            if (first_allele_p1) {
+              cur_geno = (first_allele_p1 - 1) * 2;
+            }
+          } else if ((gt_val_ct == 2) || (BcfGetInt(&(gt_iter[2 * gt_type_byte_ct]), gt_type) == kBcfIntVectorEnd)) {
+            // code triploids, etc. as missing
+            const uint32_t second_allele_p1 = BcfGtAlleleP1(second_val);
+            if ((first_allele_p1 == UINT32_MAX) || (second_allele_p1 == UINT32_MAX)) {
+              return kBcfGenoParseInvalidGt;
+            }
+            if (first_allele_p1 && second_allele_p1) {
+              cur_geno = first_allele_p1 + second_allele_p1 - 2;
+              // phase bit is attached to the second allele
+              if (phase_aware && (second_val & 1) && (cur_geno == 1)) {
+                const uint32_t shifted_bit = 1U << sample_idx_lowbits;
+                phasepresent_hw |= shifted_bit;
+                if (first_allele_p1 == 2) {
+                  // 1|0
+                  phaseinfo_hw |= shifted_bit;
+                }
+              }
+            } else if (first_allele_p1 || second_allele_p1) {
+              if (vcf_half_call == kVcfHalfCallError) {
+                return kBcfGenoParseHalfCall;
+              }
+              if (vcf_half_call != kVcfHalfCallMissing) {
+                // kVcfHalfCallHaploid, kVcfHalfCallReference
+                cur_geno = S_CAST(uintptr_t, first_allele_p1 + second_allele_p1 - 1) << vcf_half_call;
+              }
+            }
+          }
+        }
+        if (dosage_iter) {
+          uint32_t is_missing = 0;
+          uint32_t dosage_int;
+          if (!ParseBcfDosage(dosage_iter, dosage_type, dosage_val_ct, is_haploid, dosage_is_gp, import_dosage_certainty, &is_missing, &dosage_int)) {
+            const uint32_t shifted_bit = 1U << sample_idx_lowbits;
+            const uint32_t cur_halfdist = BiallelicDosageHalfdist(dosage_int);
+            if (cur_halfdist < dosage_erase_halfdist) {
+              dosage_present_hw |= shifted_bit;
+              *dosage_main_iter++ = dosage_int;
+            } else if (phase_aware) {
+              // Not saving dosage, since it's too close to an integer.  If
+              // that integer actually conflicts with the hardcall, override
+              // the hardcall.
+              cur_geno = (dosage_int + kDosage4th) / kDosageMid;
+              if (phasepresent_hw & shifted_bit) {
+                if (cur_geno != 1) {
+                  // Hardcall-phase no longer applies.
+                  phasepresent_hw ^= shifted_bit;
+                  phaseinfo_hw &= ~shifted_bit;
+                } else if (cur_halfdist < dosage_erase_halfdist2) {
+                  // More stringent dosage_erase_halfdist applies.
+                  dosage_present_hw |= shifted_bit;
+                  *dosage_main_iter++ = dosage_int;
+                }
+              }
+            }
+          } else if (!is_missing) {
+            return kBcfGenoParseInvalidDosage;
+          }
+        }
+      }
+      genovec_word |= cur_geno << (2 * sample_idx_lowbits);
+      gt_iter = &(gt_iter[gt_stride]);
+      gq_iter = &(gq_iter[gq_stride]);
+      dp_iter = &(dp_iter[dp_stride]);
+      dosage_iter = &(dosage_iter[dosage_stride]);
+    }
+    genovec[widx] = genovec_word;
+    if (phase_aware) {
+      R_CAST(Halfword*, phasepresent)[widx] = phasepresent_hw;
+      R_CAST(Halfword*, phaseinfo)[widx] = phaseinfo_hw;
+    }
+    if (dosage_iter) {
+      R_CAST(Halfword*, dosage_present)[widx] = dosage_present_hw;
+    }
+  }
+  *dosage_ct_ptr = dosage_main_iter - dosage_main;
+  return kBcfGenoParseOk;
+}
+
+// Renders a BCF2 typed INFO value as VCF text.  Stops at the first
+// end-of-vector marker.
+static char* BcfInfoValsToText(const unsigned char* vals, uint32_t val_type, uint32_t val_ct, char* write_iter) {
+  if (val_type == kBcfTypeChar) {
+    const uint32_t slen = BcfCharValsSlen(vals, val_ct);
+    if (!slen) {
+      *write_iter++ = '.';
+      return write_iter;
+    }
+    return memcpya(write_iter, vals, slen);
+  }
+  const uint32_t type_byte_ct = kBcfTypeByteCts[val_type];
+  char* write_start = write_iter;
+  for (uint32_t val_idx = 0; val_idx != val_ct; ++val_idx) {
+    const unsigned char* cur_val = &(vals[val_idx * type_byte_ct]);
+    if (val_type == kBcfTypeFloat) {
+      uint32_t uii;
+      memcpy(&uii, cur_val, 4);
+      if (uii == kBcfFloatVectorEndBits) {
+        break;
+      }
+      if (val_idx) {
+        *write_iter++ = ',';
+      }
+      if (uii == kBcfFloatMissingBits) {
+        *write_iter++ = '.';
+      } else {
+        float fxx;
+        memcpy(&fxx, cur_val, 4);
+        write_iter = ftoa_g(fxx, write_iter);
+      }
+    } else {
+      const int32_t ii = BcfGetInt(cur_val, val_type);
+      if (ii == kBcfIntVectorEnd) {
+        break;
+      }
+      if (val_idx) {
+        *write_iter++ = ',';
+      }
+      if (ii == kBcfIntMissing) {
+        *write_iter++ = '.';
+      } else {
+        write_iter = i32toa(ii, write_iter);
+      }
+    }
+  }
+  if (write_iter == write_start) {
+    *write_iter++ = '.';
+  }
+  return write_iter;
+}
+
+PglErr BcfToPgen(const char* bcfname, const char* preexisting_psamname, const char* const_fid, const char* dosage_import_field, MiscFlags misc_flags, ImportFlags import_flags, uint32_t no_samples_ok, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, int32_t vcf_min_gq, int32_t vcf_min_dp, VcfHalfCall vcf_half_call, FamCol fam_cols, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, uint32_t* pgen_generated_ptr, uint32_t* psam_generated_ptr) {
+  // Same 2-pass structure as VcfToPgen(), but GT/dosage values are decoded
+  // directly from the BCF2 typed arrays; there's no text round-trip.
+  unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  BGZF* bgzfp = nullptr;
+  FILE* pvarfile = nullptr;
+  uintptr_t line_idx = 0;
+  uintptr_t rec_idx = 0;
+  const uint32_t vcf_half_call_explicit_error = (vcf_half_call == kVcfHalfCallError);
+  PglErr reterr = kPglRetSuccess;
+  STPgenWriter spgw;
+  PreinitSpgw(&spgw);
+  {
+    // Unlike the VCF case, there's no text parsing to overlap with, so BGZF
+    // block decompression is the main thing worth parallelizing.
+    const uint32_t decompress_thread_ct = MINV(max_thread_ct, 128);
+    reterr = BcfOpen(bcfname, decompress_thread_ct, &bgzfp);
+    if (reterr) {
+      if (reterr == kPglRetOpenFail) {
+        const uint32_t slen = strlen(bcfname);
+        if (StrEndsWith(bcfname, ".bcf", slen)) {
+          logerrprintfww(kErrprintfFopen, bcfname);
+        } else {
+          logerrprintfww("Error: Failed to open %s. (--bcf expects a complete filename; did you forget '.bcf' at the end?)\n", bcfname);
+        }
+      } else if (reterr == kPglRetMalformedInput) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s is not a BGZF-compressed BCF file. (Use 'bcftools view -Ob' to recompress it.)\n", bcfname);
+        goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+      }
+      goto BcfToPgen_ret_1;
+    }
+    unsigned char bcf_magic[9];
+    reterr = BcfReadExact(bgzfp, 9, bcf_magic);
+    if (reterr) {
+      if (reterr == kPglRetReadFail) {
+        goto BcfToPgen_ret_READ_FAIL;
+      }
+      goto BcfToPgen_ret_BAD_HEADER;
+    }
+    if (memcmp(bcf_magic, "BCF\2", 4) || ((bcf_magic[4] != 1) && (bcf_magic[4] != 2))) {
+      if (!memcmp(bcf_magic, "##fileformat", 9)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s appears to be a VCF file. Try --vcf instead of --bcf.\n", bcfname);
+        goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+      }
+      if (!memcmp(bcf_magic, "BCF\4", 4)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s appears to be a BCF1 file. Use 'bcftools view' to convert it to a PLINK-readable BCF2 or VCF file.\n", bcfname);
+        goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+      }
+      goto BcfToPgen_ret_BAD_HEADER;
+    }
+    uint32_t l_text;
+    memcpy(&l_text, &(bcf_magic[5]), 4);
+    char* bcf_header;
+    char* dict_names;
+    if (bigstack_alloc_c(l_text + 1, &bcf_header) ||
+        bigstack_alloc_c(l_text + 1, &dict_names)) {
+      goto BcfToPgen_ret_NOMEM;
+    }
+    reterr = BcfReadExact(bgzfp, l_text, bcf_header);
+    if (reterr) {
+      if (reterr == kPglRetReadFail) {
+        goto BcfToPgen_ret_READ_FAIL;
+      }
+      goto BcfToPgen_ret_BAD_HEADER;
+    }
+    bcf_header[l_text] = '\0';
+
+    const uint32_t allow_extra_chrs = (misc_flags / kfMiscAllowExtraChrs) & 1;
+    uint32_t dosage_import_field_slen = 0;
+    if (dosage_import_field) {
+      dosage_import_field_slen = strlen(dosage_import_field);
+    }
+    const uint32_t dosage_is_gp = strequal_k(dosage_import_field, "GP", dosage_import_field_slen);
+    uint32_t format_gt_present = 0;
+    uint32_t format_gq_relevant = 0;
+    uint32_t format_dp_relevant = 0;
+    uint32_t format_dosage_relevant = 0;
+    uint32_t info_pr_present = 0;
+    uint32_t info_pr_nonflag_present = 0;
+    uint32_t info_nonpr_present = 0;
+    uint32_t chrset_present = 0;
+    // Header lines are treated the same way as in VcfToPgen().  In addition,
+    // the FILTER/INFO/FORMAT string dictionary and the contig dictionary are
+    // constructed from the ##FILTER, ##INFO, ##FORMAT and ##contig lines.
+    uint32_t dict_line_ct = 0;
+    uint32_t contig_line_ct = 0;
+    uint32_t dict_size = 1;
+    uint32_t contig_dict_size = 0;
+    char* line_iter = bcf_header;
+    while (1) {
+      ++line_idx;
+      if (line_iter[0] != '#') {
+        logerrputs("Error: No #CHROM header line in --bcf file.\n");
+        goto BcfToPgen_ret_MALFORMED_INPUT;
+      }
+      if (line_iter[1] != '#') {
+        break;
+      }
+      char* line_end = strchrnul_n(line_iter, '\n');
+      if (!(*line_end)) {
+        logerrputs("Error: No #CHROM header line in --bcf file.\n");
+        goto BcfToPgen_ret_MALFORMED_INPUT;
+      }
+      char* id_start = nullptr;
+      uint32_t* dict_size_ptr = &dict_size;
+      if (StrStartsWithUnsafe(&(line_iter[2]), "chrSet=<")) {
+        if (chrset_present) {
+          logerrputs("Error: Multiple ##chrSet header lines in --bcf file.\n");
+          goto BcfToPgen_ret_MALFORMED_INPUT;
+        }
+        chrset_present = 1;
+        reterr = ReadChrsetHeaderLine(&(line_iter[10]), "--bcf file", misc_flags, line_idx, cip);
+        if (reterr) {
+          goto BcfToPgen_ret_1;
+        }
+      } else if (StrStartsWithUnsafe(&(line_iter[2]), "FORMAT=<ID=")) {
+        id_start = &(line_iter[2 + strlen("FORMAT=<ID=")]);
+        if (StrStartsWithUnsafe(id_start, "GT,Number=")) {
+          if (format_gt_present) {
+            logerrputs("Error: Duplicate FORMAT:GT header line in --bcf file.\n");
+            goto BcfToPgen_ret_MALFORMED_INPUT;
+          }
+          if (!StrStartsWithUnsafe(&(id_start[strlen("GT,Number=")]), "1,Type=String,Description=")) {
+            snprintf(g_logbuf, kLogbufSize, "Error: Header line %" PRIuPTR " of --bcf file does not have expected FORMAT:GT format.\n", line_idx);
+            goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+          }
+          format_gt_present = 1;
+        } else if ((vcf_min_gq != -1) && StrStartsWithUnsafe(id_start, "GQ,Number=1,Type=")) {
+          if (format_gq_relevant) {
+            logerrputs("Error: Duplicate FORMAT:GQ header line in --bcf file.\n");
+            goto BcfToPgen_ret_MALFORMED_INPUT;
+          }
+          format_gq_relevant = 1;
+        } else if ((vcf_min_dp != -1) && StrStartsWithUnsafe(id_start, "DP,Number=1,Type=")) {
+          if (format_dp_relevant) {
+            logerrputs("Error: Duplicate FORMAT:DP header line in --bcf file.\n");
+            goto BcfToPgen_ret_MALFORMED_INPUT;
+          }
+          format_dp_relevant = 1;
+        } else if (dosage_import_field && (!memcmp(id_start, dosage_import_field, dosage_import_field_slen)) && (id_start[dosage_import_field_slen] == ',')) {
+          if (format_dosage_relevant) {
+            logerrprintfww("Error: Duplicate FORMAT:%s header line in --bcf file.\n", dosage_import_field);
+            goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+          }
+          format_dosage_relevant = 1;
+        }
+      } else if (StrStartsWithUnsafe(&(line_iter[2]), "INFO=<ID=")) {
+        id_start = &(line_iter[2 + strlen("INFO=<ID=")]);
+        if (StrStartsWithUnsafe(id_start, "PR,Number=")) {
+          if (info_pr_present || info_pr_nonflag_present) {
+            logerrputs("Error: Duplicate INFO:PR header line in --bcf file.\n");
+            goto BcfToPgen_ret_MALFORMED_INPUT;
+          }
+          info_pr_nonflag_present = !StrStartsWithUnsafe(&(id_start[strlen("PR,Number=")]), "0,Type=Flag,Description=");
+          info_pr_present = 1 - info_pr_nonflag_present;
+          if (info_pr_nonflag_present) {
+            logerrprintfww("Warning: Header line %" PRIuPTR " of --bcf file has an unexpected definition of INFO:PR. This interferes with a few merge and liftover operations.\n", line_idx);
+          }
+        } else {
+          info_nonpr_present = 1;
+        }
+      } else if (StrStartsWithUnsafe(&(line_iter[2]), "FILTER=<ID=")) {
+        id_start = &(line_iter[2 + strlen("FILTER=<ID=")]);
+      } else if (StrStartsWithUnsafe(&(line_iter[2]), "contig=<ID=")) {
+        id_start = &(line_iter[2 + strlen("contig=<ID=")]);
+        dict_size_ptr = &contig_dict_size;
+      }
+      if (id_start) {
+        const char* id_end;
+        uint32_t explicit_idx;
+        if (BcfHeaderLineParse(id_start, line_end, &id_end, &explicit_idx)) {
+          snprintf(g_logbuf, kLogbufSize, "Error: Header line %" PRIuPTR " of --bcf file is malformed.\n", line_idx);
+          goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+        }
+        if (dict_size_ptr == &dict_size) {
+          ++dict_line_ct;
+        } else {
+          ++contig_line_ct;
+        }
+        if ((explicit_idx != UINT32_MAX) && (explicit_idx >= (*dict_size_ptr))) {
+          *dict_size_ptr = explicit_idx + 1;
+        }
+      }
+      line_iter = &(line_end[1]);
+    }
+    const uintptr_t header_line_ct = line_idx;
+    char* chrom_line = line_iter;
+    if (dict_size < dict_line_ct + 1) {
+      dict_size = dict_line_ct + 1;
+    }
+    if (contig_dict_size < contig_line_ct) {
+      contig_dict_size = contig_line_ct;
+    }
+    const char** dict;
+    const char** contig_names;
+    uint32_t* contig_chr_codes;
+    if (bigstack_alloc_kcp(dict_size, &dict) ||
+        bigstack_alloc_kcp(contig_dict_size + 1, &contig_names) ||
+        bigstack_alloc_u32(contig_dict_size + 1, &contig_chr_codes)) {
+      goto BcfToPgen_ret_NOMEM;
+    }
+    ZeroPtrArr(dict_size, dict);
+    ZeroPtrArr(contig_dict_size + 1, contig_names);
+    SetAllU32Arr(contig_dict_size, contig_chr_codes);
+    uint32_t max_dict_slen = 4;
+    uint32_t max_contig_slen = 0;
+    {
+      const uint32_t dict_htable_size = GetHtableMinSize(dict_line_ct + 1);
+      const uint32_t contig_htable_size = GetHtableMinSize(contig_line_ct);
+      uint32_t* dict_htable;
+      uint32_t* contig_htable;
+      if (bigstack_end_alloc_u32(dict_htable_size, &dict_htable) ||
+          bigstack_end_alloc_u32(contig_htable_size, &contig_htable)) {
+        goto BcfToPgen_ret_NOMEM;
+      }
+      SetAllU32Arr(dict_htable_size, dict_htable);
+      SetAllU32Arr(contig_htable_size, contig_htable);
+      char* dict_names_iter = dict_names;
+      strcpy(dict_names_iter, "PASS");
+      uint32_t dict_next_free_idx = 0;
+      BcfDictAdd(dict_names_iter, 4, 0, dict_htable_size, dict, dict_htable, &dict_next_free_idx);
+      dict_names_iter = &(dict_names_iter[5]);
+      uint32_t contig_next_free_idx = 0;
+      line_idx = 0;
+      for (line_iter = bcf_header; line_iter != chrom_line; ) {
+        ++line_idx;
+        char* line_end = AdvToDelim(line_iter, '\n');
+        const char* id_start = nullptr;
+        uint32_t is_contig = 0;
+        if (StrStartsWithUnsafe(&(line_iter[2]), "FORMAT=<ID=")) {
+          id_start = &(line_iter[2 + strlen("FORMAT=<ID=")]);
+        } else if (StrStartsWithUnsafe(&(line_iter[2]), "INFO=<ID=")) {
+          id_start = &(line_iter[2 + strlen("INFO=<ID=")]);
+        } else if (StrStartsWithUnsafe(&(line_iter[2]), "FILTER=<ID=")) {
+          id_start = &(line_iter[2 + strlen("FILTER=<ID=")]);
+        } else if (StrStartsWithUnsafe(&(line_iter[2]), "contig=<ID=")) {
+          id_start = &(line_iter[2 + strlen("contig=<ID=")]);
+          is_contig = 1;
+        }
+        if (id_start) {
+          const char* id_end;
+          uint32_t explicit_idx;
+          BcfHeaderLineParse(id_start, line_end, &id_end, &explicit_idx);
+          const uint32_t id_slen = id_end - id_start;
+          char* name_copy = dict_names_iter;
+          dict_names_iter = memcpya(dict_names_iter, id_start, id_slen);
+          *dict_names_iter++ = '\0';
+          uint32_t dict_idx;
+          if (!is_contig) {
+            dict_idx = BcfDictAdd(name_copy, id_slen, explicit_idx, dict_htable_size, dict, dict_htable, &dict_next_free_idx);
+            if (id_slen > max_dict_slen) {
+              max_dict_slen = id_slen;
+            }
+          } else {
+            dict_idx = BcfDictAdd(name_copy, id_slen, explicit_idx, contig_htable_size, contig_names, contig_htable, &contig_next_free_idx);
+            if (id_slen > max_contig_slen) {
+              max_contig_slen = id_slen;
+            }
+          }
+          if (dict_idx == UINT32_MAX) {
+            snprintf(g_logbuf, kLogbufSize, "Error: Header line %" PRIuPTR " of --bcf file has an IDX value inconsistent with an earlier line.\n", line_idx);
+            goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+          }
+        }
+        line_iter = &(line_end[1]);
+      }
+      BigstackEndReset(bigstack_end_mark);
+    }
+    const uint32_t require_gt = (import_flags / kfImportVcfRequireGt) & 1;
+    if ((!format_gt_present) && require_gt) {
+      logerrputs("Error: No GT field in --bcf file header, when --vcf-require-gt was specified.\n");
+      goto BcfToPgen_ret_INCONSISTENT_INPUT;
+    }
+    if ((!format_gq_relevant) && (vcf_min_gq != -1)) {
+      logerrputs("Warning: No GQ field in --bcf file header.  --vcf-min-gq ignored.\n");
+      vcf_min_gq = -1;
+    }
+    if ((!format_dp_relevant) && (vcf_min_dp != -1)) {
+      logerrputs("Warning: No DP field in --bcf file header.  --vcf-min-dp ignored.\n");
+      vcf_min_dp = -1;
+    }
+    if ((!format_dosage_relevant) && dosage_import_field) {
+      logerrprintfww("Warning: No %s field in --bcf file header. Dosages will not be imported.\n", dosage_import_field);
+    }
+    FinalizeChrset(misc_flags, cip);
+
+    // GT, GQ, DP, dosage
+    uint32_t fmt_keys[4];
+    SetAllU32Arr(4, fmt_keys);
+    for (uint32_t dict_idx = 0; dict_idx != dict_size; ++dict_idx) {
+      const char* cur_name = dict[dict_idx];
+      if (!cur_name) {
+        continue;
+      }
+      if (strequal_k_unsafe(cur_name, "GT")) {
+        fmt_keys[0] = dict_idx;
+      } else if (format_gq_relevant && strequal_k_unsafe(cur_name, "GQ")) {
+        fmt_keys[1] = dict_idx;
+      } else if (format_dp_relevant && strequal_k_unsafe(cur_name, "DP")) {
+        fmt_keys[2] = dict_idx;
+      }
+      if (format_dosage_relevant && (!strcmp(cur_name, dosage_import_field))) {
+        fmt_keys[3] = dict_idx;
+      }
+    }
+    uint32_t pr_key = UINT32_MAX;
+    if (info_pr_present) {
+      for (uint32_t dict_idx = 0; dict_idx != dict_size; ++dict_idx) {
+        if (dict[dict_idx] && strequal_k_unsafe(dict[dict_idx], "PR")) {
+          pr_key = dict_idx;
+          break;
+        }
+      }
+    }
+
+    if (!StrStartsWithUnsafe(chrom_line, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO")) {
+      snprintf(g_logbuf, kLogbufSize, "Error: Header line %" PRIuPTR " of --bcf file does not have expected field sequence after #CHROM.\n", header_line_ct);
+      goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+    }
+    char* sample_line_iter = &(chrom_line[strlen("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO")]);
+    uintptr_t sample_ct = 0;
+    if (StrStartsWithUnsafe(sample_line_iter, "\tFORMAT\t")) {
+      reterr = VcfSampleLine(preexisting_psamname, const_fid, import_flags, fam_cols, id_delim, idspace_to, 'b', &(sample_line_iter[strlen("\tFORMAT\t")]), outname, outname_end, &sample_ct);
+      if (reterr) {
+        goto BcfToPgen_ret_1;
+      }
+    }
+    if ((!sample_ct) && (!no_samples_ok)) {
+      logerrputs("Error: No samples in --bcf file.  (This is only permitted when you haven't\nspecified another operation which requires genotype or sample information.)\n");
+      goto BcfToPgen_ret_INCONSISTENT_INPUT;
+    }
+    const uint32_t sample_ctl2 = QuaterCtToWordCt(sample_ct);
+    const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
+    uintptr_t* genovec = nullptr;
+    uintptr_t* phasepresent = nullptr;
+    uintptr_t* phaseinfo = nullptr;
+    uintptr_t* dosage_present = nullptr;
+    Dosage* dosage_main = nullptr;
+    if (sample_ct) {
+      if (bigstack_alloc_w(sample_ctl2, &genovec) ||
+          bigstack_alloc_w(sample_ctl, &phasepresent) ||
+          bigstack_alloc_w(sample_ctl, &phaseinfo)) {
+        goto BcfToPgen_ret_NOMEM;
+      }
+      phasepresent[sample_ctl - 1] = 0;
+      phaseinfo[sample_ctl - 1] = 0;
+      if (format_dosage_relevant) {
+        if (bigstack_alloc_w(sample_ctl, &dosage_present) ||
+            bigstack_alloc_dosage(sample_ct, &dosage_main)) {
+          goto BcfToPgen_ret_NOMEM;
+        }
+        dosage_present[sample_ctl - 1] = 0;
+      }
+    }
+    uintptr_t recbuf_size;
+    if (StandardizeLinebufSize(bigstack_left() / 4, kMaxMediumLine + 1, &recbuf_size)) {
+      goto BcfToPgen_ret_NOMEM;
+    }
+    unsigned char* recbuf;
+    if (bigstack_alloc_uc(recbuf_size, &recbuf)) {
+      goto BcfToPgen_ret_NOMEM;
+    }
+
+    uint32_t variant_ct = 0;
+    uintptr_t* variant_allele_idxs = R_CAST(uintptr_t*, g_bigstack_base);
+    uintptr_t max_variant_ct = R_CAST(uintptr_t*, g_bigstack_end) - variant_allele_idxs;
+    max_variant_ct -= BitCtToAlignedWordCt(max_variant_ct) * kWordsPerVec;
+    if (format_dosage_relevant) {
+      max_variant_ct -= BitCtToAlignedWordCt(max_variant_ct) * kWordsPerVec;
+    }
+    if (info_pr_present) {
+      max_variant_ct -= BitCtToAlignedWordCt(max_variant_ct) * kWordsPerVec;
+    }
+#ifdef __LP64__
+    if (max_variant_ct > 0x7ffffffd) {
+      max_variant_ct = 0x7ffffffd;
+    }
+#endif
+    uintptr_t base_chr_present[kChrExcludeWords];
+    ZeroWArr(kChrExcludeWords, base_chr_present);
+
+    const uint32_t max_variant_ctaw = BitCtToAlignedWordCt(max_variant_ct);
+    uintptr_t* phasing_flags = S_CAST(uintptr_t*, bigstack_end_alloc_raw_rd(max_variant_ctaw * sizeof(intptr_t)));
+    uintptr_t* phasing_flags_iter = phasing_flags;
+    uintptr_t* dosage_flags = nullptr;
+    if (format_dosage_relevant) {
+      dosage_flags = S_CAST(uintptr_t*, bigstack_end_alloc_raw_rd(max_variant_ctaw * sizeof(intptr_t)));
+    }
+    uintptr_t* dosage_flags_iter = dosage_flags;
+    uintptr_t* nonref_flags = nullptr;
+    if (info_pr_present) {
+      nonref_flags = S_CAST(uintptr_t*, bigstack_end_alloc_raw_rd(max_variant_ctaw * sizeof(intptr_t)));
+    }
+    uintptr_t* nonref_flags_iter = nonref_flags;
+    if (vcf_half_call == kVcfHalfCallDefault) {
+      vcf_half_call = kVcfHalfCallError;
+    }
+    uintptr_t variant_skip_ct = 0;
+    uintptr_t phasing_word = 0;
+    uintptr_t dosage_word = 0;
+    uintptr_t nonref_word = 0;
+    uintptr_t allele_idx_end = 0;
+    uint64_t max_pvar_line_blen = 0;
+    const uint32_t dosage_erase_halfdist = kDosage4th - dosage_erase_thresh;
+    const uint32_t dosage_erase_halfdist2 = (dosage_erase_halfdist + kDosage4th + 1) / 2;
+    BcfFmtField fmt_fields[4];
+    const BcfFmtField absent_fmt_field = {nullptr, 0, 0};
+
+    // temporary kludge
+    uintptr_t multiallelic_skip_ct = 0;
+
+    while (1) {
+      uint32_t rec_lens[2];
+      reterr = BcfReadExact(bgzfp, 8, rec_lens);
+      if (reterr) {
+        if (reterr == kPglRetEof) {
+          reterr = kPglRetSuccess;
+          break;
+        }
+        goto BcfToPgen_ret_READ_FAIL_OR_TRUNCATED;
+      }
+      ++rec_idx;
+      const uintptr_t l_shared = rec_lens[0];
+      const uintptr_t rec_size = l_shared + rec_lens[1];
+      if (l_shared < 24) {
+        goto BcfToPgen_ret_MALFORMED_RECORD;
+      }
+      if (rec_size > recbuf_size) {
+        goto BcfToPgen_ret_NOMEM;
+      }
+      reterr = BcfReadExact(bgzfp, rec_size, recbuf);
+      if (reterr) {
+        goto BcfToPgen_ret_READ_FAIL_OR_TRUNCATED;
+      }
+      const unsigned char* shared_end = &(recbuf[l_shared]);
+      uint32_t chrom_idx;
+      memcpy(&chrom_idx, recbuf, 4);
+      uint32_t n_info_allele;
+      memcpy(&n_info_allele, &(recbuf[16]), 4);
+      uint32_t n_fmt_sample;
+      memcpy(&n_fmt_sample, &(recbuf[20]), 4);
+      if ((chrom_idx >= contig_dict_size) || (!contig_names[chrom_idx])) {
+        goto BcfToPgen_ret_MALFORMED_RECORD;
+      }
+      const uint32_t fmt_ct = n_fmt_sample >> 24;
+      if (fmt_ct && ((n_fmt_sample & 0xffffff) != sample_ct)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Record %" PRIuPTR " of --bcf file has a sample count inconsistent with the header.\n", rec_idx);
+        goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+      }
+      uint32_t cur_type;
+      uint32_t cur_val_ct;
+      const unsigned char* vals_end;
+      const unsigned char* vals = BcfScanTypedVals(&(recbuf[24]), shared_end, 1, &cur_type, &cur_val_ct, &vals_end);
+      if ((!vals) || (cur_val_ct && (cur_type != kBcfTypeChar))) {
+        goto BcfToPgen_ret_MALFORMED_RECORD;
+      }
+      if (BcfCharValsSlen(vals, cur_val_ct) > kMaxIdSlen) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Invalid ID in record %" PRIuPTR " of --bcf file (max " MAX_ID_SLEN_STR " chars).\n", rec_idx);
+        goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+      }
+      const uint32_t allele_ct = n_info_allele >> 16;
+      if (!allele_ct) {
+        goto BcfToPgen_ret_MALFORMED_RECORD;
+      }
+      const unsigned char* shared_iter = vals_end;
+      for (uint32_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+        vals = BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &vals_end);
+        if ((!vals) || (cur_type != kBcfTypeChar)) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        const uint32_t allele_slen = BcfCharValsSlen(vals, cur_val_ct);
+        if (!allele_slen) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        for (uint32_t uii = 0; uii != allele_slen; ++uii) {
+          const uint32_t ucc = vals[uii];
+          if ((ucc <= ' ') || (allele_idx && (ucc == ','))) {
+            snprintf(g_logbuf, kLogbufSize, "Error: Invalid %s allele in record %" PRIuPTR " of --bcf file.\n", allele_idx? "alternate" : "reference", rec_idx);
+            goto BcfToPgen_ret_MALFORMED_INPUT_WW;
+          }
+        }
+        shared_iter = vals_end;
+      }
+
+      // temporary kludge
+      if (allele_ct > 2) {
+        ++multiallelic_skip_ct;
+        continue;
+      }
+
+      vals = BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &vals_end);
+      if ((!vals) || (cur_val_ct && ((!cur_type) || (cur_type > kBcfTypeInt32)))) {
+        goto BcfToPgen_ret_MALFORMED_RECORD;
+      }
+      const uint32_t filter_ct = cur_val_ct;
+      for (uint32_t filter_idx = 0; filter_idx != filter_ct; ++filter_idx) {
+        if (BcfDictIdx(&(vals[filter_idx * kBcfTypeByteCts[cur_type]]), cur_type, dict_size, dict) == UINT32_MAX) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+      }
+      shared_iter = vals_end;
+      const uint32_t info_ct = n_info_allele & 0xffff;
+      uint32_t pr_found = 0;
+      for (uint32_t info_idx = 0; info_idx != info_ct; ++info_idx) {
+        uint32_t key;
+        shared_iter = BcfScanTypedKey(shared_iter, shared_end, dict_size, dict, &key);
+        if (!shared_iter) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        if (!BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &shared_iter)) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        pr_found |= (key == pr_key);
+      }
+
+      uint32_t gt_missing = 1;
+      if (sample_ct && fmt_ct) {
+        if (BcfLocateFmtFields(shared_end, &(recbuf[rec_size]), fmt_ct, sample_ct, dict_size, dict, fmt_keys, fmt_fields)) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        gt_missing = !fmt_fields[0].vals;
+      }
+      if (require_gt && gt_missing) {
+        ++variant_skip_ct;
+        continue;
+      }
+
+      uint32_t cur_chr_code = contig_chr_codes[chrom_idx];
+      if (cur_chr_code == UINT32_MAX) {
+        const char* contig_name = contig_names[chrom_idx];
+        reterr = GetOrAddChrCode(contig_name, "--bcf file", 0, strlen(contig_name), allow_extra_chrs, cip, &cur_chr_code);
+        if (reterr) {
+          goto BcfToPgen_ret_1;
+        }
+        contig_chr_codes[chrom_idx] = cur_chr_code;
+      }
+      if (!IsSet(cip->chr_mask, cur_chr_code)) {
+        ++variant_skip_ct;
+        continue;
+      }
+      if (cur_chr_code <= cip->max_code) {
+        SetBit(cur_chr_code, base_chr_present);
+      }
+      // INFO values can expand to ~5x their binary size when rendered as text
+      const uint64_t cur_pvar_line_blen = 5 * S_CAST(uint64_t, l_shared) + S_CAST(uint64_t, info_ct + filter_ct) * (max_dict_slen + 2);
+      if (cur_pvar_line_blen > max_pvar_line_blen) {
+        max_pvar_line_blen = cur_pvar_line_blen;
+      }
+
+      variant_allele_idxs[variant_ct] = allele_idx_end;
+      allele_idx_end += 2;
+      const uint32_t variant_idx_lowbits = variant_ct % kBitsPerWord;
+      if (info_pr_present) {
+        if (pr_found) {
+          nonref_word |= k1LU << variant_idx_lowbits;
+        }
+        if (variant_idx_lowbits == (kBitsPerWord - 1)) {
+          *nonref_flags_iter++ = nonref_word;
+          nonref_word = 0;
+        }
+      }
+      if (!gt_missing) {
+        // Full decode is only necessary when there's a chance of a phased het
+        // or a dosage.
+        const uint32_t dosage_field_present = (fmt_fields[3].vals != nullptr);
+        if (dosage_field_present || BcfGtPhaseBitPresent(&(fmt_fields[0]), sample_ct)) {
+          uint32_t dosage_ct;
+          const BcfGenoParseResult parse_result = BcfParseGenotypes(&(fmt_fields[0]), &(fmt_fields[1]), &(fmt_fields[2]), &(fmt_fields[3]), sample_ct, vcf_min_gq, vcf_min_dp, vcf_half_call, dosage_is_gp, import_dosage_certainty, dosage_erase_halfdist, dosage_erase_halfdist2, 1, genovec, phasepresent, phaseinfo, dosage_present, dosage_main, &dosage_ct);
+          if (parse_result != kBcfGenoParseOk) {
+            if (parse_result == kBcfGenoParseInvalidGt) {
+              goto BcfToPgen_ret_INVALID_GT;
+            }
+            if (parse_result == kBcfGenoParseHalfCall) {
+              goto BcfToPgen_ret_HALF_CALL_ERROR;
+            }
+            goto BcfToPgen_ret_INVALID_DOSAGE;
+          }
+          if (!AllWordsAreZero(phasepresent, sample_ctl)) {
+            phasing_word |= k1LU << variant_idx_lowbits;
+          }
+          if (dosage_ct) {
+            dosage_word |= k1LU << variant_idx_lowbits;
+          }
+        }
+      }
+      if (variant_idx_lowbits == (kBitsPerWord - 1)) {
+        *phasing_flags_iter++ = phasing_word;
+        phasing_word = 0;
+        if (dosage_flags_iter) {
+          *dosage_flags_iter++ = dosage_word;
+          dosage_word = 0;
+        }
+      }
+      if (variant_ct++ == max_variant_ct) {
+#ifdef __LP64__
+        if (variant_ct == 0x7ffffffd) {
+          logerrputs("Error: " PROG_NAME_STR " does not support more than 2^31 - 3 variants.  We recommend other\nsoftware, such as PLINK/SEQ, for very deep studies of small numbers of genomes.\n");
+          goto BcfToPgen_ret_MALFORMED_INPUT;
+        }
+#endif
+        goto BcfToPgen_ret_NOMEM;
+      }
+      if (!(variant_ct % 1000)) {
+        printf("\r--bcf: %uk variants scanned.", variant_ct / 1000);
+        fflush(stdout);
+      }
+    }
+    if (variant_ct % kBitsPerWord) {
+      *phasing_flags_iter = phasing_word;
+      if (dosage_flags_iter) {
+        *dosage_flags_iter = dosage_word;
+      }
+      if (nonref_flags_iter) {
+        *nonref_flags_iter = nonref_word;
+      }
+    } else if (!variant_ct) {
+      logerrputs("Error: No variants in --bcf file.\n");
+      goto BcfToPgen_ret_INCONSISTENT_INPUT;
+    }
+
+    putc_unlocked('\r', stdout);
+    if (!variant_skip_ct) {
+      logprintf("--bcf: %u variant%s scanned.\n", variant_ct, (variant_ct == 1)? "" : "s");
+    } else {
+      logprintf("--bcf: %u variant%s scanned (%" PRIuPTR " skipped).\n", variant_ct, (variant_ct == 1)? "" : "s", variant_skip_ct);
+    }
+
+    // temporary kludge
+    if (multiallelic_skip_ct) {
+      logerrprintfww("Warning: %" PRIuPTR " multiallelic variant%s %sskipped (not yet supported).\n", multiallelic_skip_ct, (multiallelic_skip_ct == 1)? "" : "s", variant_skip_ct? "also " : "");
+    }
+
+    // Rewind.  Header is already in memory, so just skip over it.
+    if (bgzf_close(bgzfp)) {
+      bgzfp = nullptr;
+      goto BcfToPgen_ret_READ_FAIL;
+    }
+    reterr = BcfOpen(bcfname, decompress_thread_ct, &bgzfp);
+    if (reterr) {
+      if (reterr == kPglRetOpenFail) {
+        logerrprintfww(kErrprintfFopen, bcfname);
+      }
+      goto BcfToPgen_ret_1;
+    }
+    for (uintptr_t header_bytes_left = 9 + S_CAST(uintptr_t, l_text); header_bytes_left; ) {
+      const uintptr_t cur_read_ct = MINV(header_bytes_left, recbuf_size);
+      if (BcfReadExact(bgzfp, cur_read_ct, recbuf)) {
+        goto BcfToPgen_ret_READ_FAIL;
+      }
+      header_bytes_left -= cur_read_ct;
+    }
+    const uintptr_t rec_ct = rec_idx;
+
+    if (allele_idx_end > 2 * variant_ct) {
+      variant_allele_idxs[variant_ct] = allele_idx_end;
+      BigstackFinalizeUl(variant_allele_idxs, variant_ct + 1);
+    } else {
+      variant_allele_idxs = nullptr;
+    }
+
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pvar");
+    if (fopen_checked(outname, FOPEN_WB, &pvarfile)) {
+      goto BcfToPgen_ret_OPEN_FAIL;
+    }
+    line_idx = 0;
+    for (line_iter = bcf_header; line_iter != chrom_line; ) {
+      ++line_idx;
+      char* line_end = AdvToDelim(line_iter, '\n');
+      char* next_line = &(line_end[1]);
+      // htslib always puts PASS at the front of the FILTER dictionary, so this
+      // line is present even when the original VCF header lacked it.
+      if (StrStartsWithUnsafe(line_iter, "##fileformat=") || StrStartsWithUnsafe(line_iter, "##fileDate=") || StrStartsWithUnsafe(line_iter, "##source=") || StrStartsWithUnsafe(line_iter, "##FORMAT=") || StrStartsWithUnsafe(line_iter, "##chrSet=") || StrStartsWithUnsafe(line_iter, "##FILTER=<ID=PASS,")) {
+        line_iter = next_line;
+        continue;
+      }
+      if (StrStartsWithUnsafe(line_iter, "##contig=<ID=")) {
+        char* contig_name_start = &(line_iter[strlen("##contig=<ID=")]);
+        char* contig_name_end = contig_name_start;
+        while ((*contig_name_end != ',') && (*contig_name_end != '>')) {
+          ++contig_name_end;
+        }
+        const uint32_t cur_chr_code = GetChrCodeCounted(cip, contig_name_end - contig_name_start, contig_name_start);
+        if (IsI32Neg(cur_chr_code)) {
+          line_iter = next_line;
+          continue;
+        }
+        if (cur_chr_code <= cip->max_code) {
+          if (!IsSet(base_chr_present, cur_chr_code)) {
+            line_iter = next_line;
+            continue;
+          }
+        } else {
+          if (!IsSet(cip->chr_mask, cur_chr_code)) {
+            line_iter = next_line;
+            continue;
+          }
+        }
+      }
+      if ((line_end != line_iter) && (line_end[-1] == '\r')) {
+        --line_end;
+      }
+      // IDX is BCF-specific; strip it from FILTER/INFO/contig lines.
+      const char* idx_start = nullptr;
+      if (line_end[-1] == '>') {
+        const char* comma_iter = line_iter;
+        while (1) {
+          comma_iter = S_CAST(const char*, memchr(comma_iter, ',', line_end - comma_iter));
+          if (!comma_iter) {
+            break;
+          }
+          if (StrStartsWithUnsafe(&(comma_iter[1]), "IDX=")) {
+            idx_start = comma_iter;
+          }
+          ++comma_iter;
+        }
+      }
+      if (idx_start) {
+        const char* idx_end = &(idx_start[5]);
+        while (IsDigit(*idx_end)) {
+          ++idx_end;
+        }
+        if (fwrite_checked(line_iter, idx_start - line_iter, pvarfile) ||
+            fwrite_checked(idx_end, line_end - idx_end, pvarfile)) {
+          goto BcfToPgen_ret_WRITE_FAIL;
+        }
+      } else {
+        if (fwrite_checked(line_iter, line_end - line_iter, pvarfile)) {
+          goto BcfToPgen_ret_WRITE_FAIL;
+        }
+      }
+      if (fputs_checked(EOLN_STR, pvarfile)) {
+        goto BcfToPgen_ret_WRITE_FAIL;
+      }
+      line_iter = next_line;
+    }
+    char* write_iter = g_textbuf;
+    if (cip->chrset_source) {
+      AppendChrsetLine(cip, &write_iter);
+    }
+    write_iter = strcpya(write_iter, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER");
+    if (info_nonpr_present) {
+      write_iter = strcpya(write_iter, "\tINFO");
+    }
+    AppendBinaryEoln(&write_iter);
+    if (fwrite_checked(g_textbuf, write_iter - g_textbuf, pvarfile)) {
+      goto BcfToPgen_ret_WRITE_FAIL;
+    }
+
+    const uint32_t variant_ctl = BitCtToWordCt(variant_ct);
+    PgenGlobalFlags phase_dosage_gflags = AllWordsAreZero(phasing_flags, variant_ctl)? kfPgenGlobal0 : kfPgenGlobalHardcallPhasePresent;
+    if (format_dosage_relevant) {
+      if (AllWordsAreZero(dosage_flags, variant_ctl)) {
+        format_dosage_relevant = 0;
+        dosage_flags = nullptr;
+      } else {
+        phase_dosage_gflags |= kfPgenGlobalDosagePresent;
+      }
+    }
+    uint32_t nonref_flags_storage = 1;
+    if (nonref_flags) {
+      const uint32_t variant_ctl_m1 = variant_ctl - 1;
+      const uintptr_t last_nonref_flags_word = nonref_flags[variant_ctl_m1];
+      if (!last_nonref_flags_word) {
+        for (uint32_t widx = 0; widx < variant_ctl_m1; ++widx) {
+          if (nonref_flags[widx]) {
+            nonref_flags_storage = 3;
+            break;
+          }
+        }
+      } else if (!((~last_nonref_flags_word) << ((-variant_ct) & (kBitsPerWord - 1)))) {
+        nonref_flags_storage = 2;
+        for (uint32_t widx = 0; widx < variant_ctl_m1; ++widx) {
+          if (~nonref_flags[widx]) {
+            nonref_flags_storage = 3;
+            break;
+          }
+        }
+      } else {
+        nonref_flags_storage = 3;
+      }
+      if (nonref_flags_storage != 3) {
+        BigstackEndReset(nonref_flags);
+        nonref_flags = nullptr;
+      }
+    }
+    uintptr_t* dphase_present = nullptr;
+    SDosage* dphase_delta = nullptr;
+    SDosage* tmp_dphase_delta = nullptr;
+    if (sample_ct) {
+      snprintf(outname_end, kMaxOutfnameExtBlen, ".pgen");
+      uintptr_t spgw_alloc_cacheline_ct;
+      uint32_t max_vrec_len;
+      reterr = SpgwInitPhase1(outname, variant_allele_idxs, nonref_flags, variant_ct, sample_ct, phase_dosage_gflags, nonref_flags_storage, &spgw, &spgw_alloc_cacheline_ct, &max_vrec_len);
+      if (reterr) {
+        goto BcfToPgen_ret_1;
+      }
+      unsigned char* spgw_alloc;
+      if (bigstack_alloc_uc(spgw_alloc_cacheline_ct * kCacheline, &spgw_alloc)) {
+        goto BcfToPgen_ret_NOMEM;
+      }
+      SpgwInitPhase2(max_vrec_len, &spgw, spgw_alloc);
+      if ((phase_dosage_gflags & kfPgenGlobalHardcallPhasePresent) && (phase_dosage_gflags & kfPgenGlobalDosagePresent)) {
+        if (bigstack_alloc_w(sample_ctl, &dphase_present) ||
+            bigstack_alloc_dphase(sample_ct, &dphase_delta) ||
+            bigstack_alloc_dphase(sample_ct, &tmp_dphase_delta)) {
+          goto BcfToPgen_ret_NOMEM;
+        }
+        dphase_present[sample_ctl - 1] = 0;
+      }
+    }
+
+    char* writebuf;
+    if ((max_pvar_line_blen > kMaxLongLine) ||
+        bigstack_alloc_c(kMaxMediumLine + max_pvar_line_blen + max_contig_slen + 64, &writebuf)) {
+      goto BcfToPgen_ret_NOMEM;
+    }
+    write_iter = writebuf;
+    char* writebuf_flush = &(writebuf[kMaxMediumLine]);
+
+    if (hard_call_thresh == UINT32_MAX) {
+      hard_call_thresh = kDosageMid / 10;
+    }
+    const uint32_t hard_call_halfdist = kDosage4th - hard_call_thresh;
+
+    uint32_t vidx = 0;
+    for (rec_idx = 1; rec_idx <= rec_ct; ++rec_idx) {
+      // Pass 1 validated everything we look at here, except for the genotype
+      // data of records without phase or dosage information.
+      uint32_t rec_lens[2];
+      if (BcfReadExact(bgzfp, 8, rec_lens)) {
+        goto BcfToPgen_ret_READ_FAIL;
+      }
+      const uintptr_t l_shared = rec_lens[0];
+      const uintptr_t rec_size = l_shared + rec_lens[1];
+      if (BcfReadExact(bgzfp, rec_size, recbuf)) {
+        goto BcfToPgen_ret_READ_FAIL;
+      }
+      const unsigned char* shared_end = &(recbuf[l_shared]);
+      uint32_t chrom_idx;
+      memcpy(&chrom_idx, recbuf, 4);
+      uint32_t n_info_allele;
+      memcpy(&n_info_allele, &(recbuf[16]), 4);
+      const uint32_t allele_ct = n_info_allele >> 16;
+      // 1. check if we skip this variant.  chromosome filter, require_gt, and
+      //    (temporarily) multiple alt alleles can cause this.
+      if (allele_ct > 2) {
+        continue;
+      }
+      const uint32_t chr_code = contig_chr_codes[chrom_idx];
+      if ((chr_code == UINT32_MAX) || (!IsSet(cip->chr_mask, chr_code))) {
+        continue;
+      }
+      const uint32_t fmt_ct = recbuf[23];
+      uint32_t gt_missing = 1;
+      if (sample_ct && fmt_ct) {
+        if (BcfLocateFmtFields(shared_end, &(recbuf[rec_size]), fmt_ct, sample_ct, dict_size, dict, fmt_keys, fmt_fields)) {
+          goto BcfToPgen_ret_MALFORMED_RECORD;
+        }
+        gt_missing = !fmt_fields[0].vals;
+      }
+      if (require_gt && gt_missing) {
+        continue;
+      }
+
+      // 2. write .pvar line
+      write_iter = chrtoa(cip, chr_code, write_iter);
+      *write_iter++ = '\t';
+      int32_t pos0;
+      memcpy(&pos0, &(recbuf[4]), 4);
+      if (pos0 < -1) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Invalid POS in record %" PRIuPTR " of --bcf file.\n", rec_idx);
+        goto BcfToPgen_ret_MALFORMED_INPUT_2N;
+      }
+      write_iter = u32toa(pos0 + 1, write_iter);
+      uint32_t cur_type;
+      uint32_t cur_val_ct;
+      const unsigned char* shared_iter;
+      const unsigned char* vals = BcfScanTypedVals(&(recbuf[24]), shared_end, 1, &cur_type, &cur_val_ct, &shared_iter);
+      *write_iter++ = '\t';
+      const uint32_t id_slen = BcfCharValsSlen(vals, cur_val_ct);
+      if (id_slen) {
+        write_iter = memcpya(write_iter, vals, id_slen);
+      } else {
+        *write_iter++ = '.';
+      }
+      for (uint32_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+        vals = BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &shared_iter);
+        *write_iter++ = '\t';
+        write_iter = memcpya(write_iter, vals, BcfCharValsSlen(vals, cur_val_ct));
+      }
+      if (allele_ct == 1) {
+        write_iter = memcpya(write_iter, "\t.", 2);
+      }
+      *write_iter++ = '\t';
+      uint32_t qual_bits;
+      memcpy(&qual_bits, &(recbuf[12]), 4);
+      if (qual_bits == kBcfFloatMissingBits) {
+        *write_iter++ = '.';
+      } else {
+        float qual;
+        memcpy(&qual, &(recbuf[12]), 4);
+        write_iter = ftoa_g(qual, write_iter);
+      }
+      *write_iter++ = '\t';
+      vals = BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &shared_iter);
+      if (!cur_val_ct) {
+        *write_iter++ = '.';
+      } else {
+        for (uint32_t filter_idx = 0; filter_idx != cur_val_ct; ++filter_idx) {
+          if (filter_idx) {
+            *write_iter++ = ';';
+          }
+          write_iter = strcpya(write_iter, dict[BcfDictIdx(&(vals[filter_idx * kBcfTypeByteCts[cur_type]]), cur_type, dict_size, dict)]);
+        }
+      }
+      if (info_nonpr_present) {
+        *write_iter++ = '\t';
+        const uint32_t info_ct = n_info_allele & 0xffff;
+        if (!info_ct) {
+          *write_iter++ = '.';
+        }
+        for (uint32_t info_idx = 0; info_idx != info_ct; ++info_idx) {
+          if (info_idx) {
+            *write_iter++ = ';';
+          }
+          uint32_t key;
+          shared_iter = BcfScanTypedKey(shared_iter, shared_end, dict_size, dict, &key);
+          write_iter = strcpya(write_iter, dict[key]);
+          vals = BcfScanTypedVals(shared_iter, shared_end, 1, &cur_type, &cur_val_ct, &shared_iter);
+          // Flag
+          if (cur_val_ct) {
+            *write_iter++ = '=';
+            write_iter = BcfInfoValsToText(vals, cur_type, cur_val_ct, write_iter);
+          }
+        }
+      }
+      AppendBinaryEoln(&write_iter);
+      if (fwrite_ck(writebuf_flush, pvarfile, &write_iter)) {
+        goto BcfToPgen_ret_WRITE_FAIL;
+      }
+
+      // 3. genotypes
+      if (sample_ct) {
+        if (gt_missing) {
+          SetAllBits(2 * sample_ct, genovec);
+          if (SpgwAppendBiallelicGenovec(genovec, &spgw)) {
+            goto BcfToPgen_ret_WRITE_FAIL;
+          }
+        } else {
+          const uint32_t is_phased = IsSet(phasing_flags, vidx);
+          const BcfFmtField* dosage_fieldp = &absent_fmt_field;
+          if (dosage_flags && IsSet(dosage_flags, vidx)) {
+            dosage_fieldp = &(fmt_fields[3]);
+          }
+          uint32_t dosage_ct;
+          const BcfGenoParseResult parse_result = BcfParseGenotypes(&(fmt_fields[0]), &(fmt_fields[1]), &(fmt_fields[2]), dosage_fieldp, sample_ct, vcf_min_gq, vcf_min_dp, vcf_half_call, dosage_is_gp, import_dosage_certainty, dosage_erase_halfdist, dosage_erase_halfdist2, is_phased, genovec, phasepresent, phaseinfo, dosage_present, dosage_main, &dosage_ct);
+          if (parse_result != kBcfGenoParseOk) {
+            if (parse_result == kBcfGenoParseInvalidGt) {
+              goto BcfToPgen_ret_INVALID_GT;
+            }
+            if (parse_result == kBcfGenoParseHalfCall) {
+              goto BcfToPgen_ret_HALF_CALL_ERROR;
+            }
+            goto BcfToPgen_ret_INVALID_DOSAGE;
+          }
+          if (!is_phased) {
+            if (!dosage_ct) {
+              if (SpgwAppendBiallelicGenovec(genovec, &spgw)) {
+                goto BcfToPgen_ret_WRITE_FAIL;
+              }
+            } else {
+              ApplyHardCallThresh(dosage_present, dosage_main, dosage_ct, hard_call_halfdist, genovec);
+              if (SpgwAppendBiallelicGenovecDosage16(genovec, dosage_present, dosage_main, dosage_ct, &spgw)) {
+                goto BcfToPgen_ret_WRITE_FAIL;
+              }
+            }
+          } else {
+            if (!dosage_ct) {
+              if (SpgwAppendBiallelicGenovecHphase(genovec, phasepresent, phaseinfo, &spgw)) {
+                goto BcfToPgen_ret_WRITE_FAIL;
+              }
+            } else {
+              ZeroWArr(sample_ctl, dphase_present);
+              const uint32_t dphase_ct = ApplyHardCallThreshPhased(dosage_present, dosage_main, dosage_ct, hard_call_halfdist, genovec, phasepresent, phaseinfo, dphase_present, dphase_delta, tmp_dphase_delta);
+              if (SpgwAppendBiallelicGenovecDphase16(genovec, phasepresent, phaseinfo, dosage_present, dphase_present, dosage_main, dphase_delta, dosage_ct, dphase_ct, &spgw)) {
+                goto BcfToPgen_ret_WRITE_FAIL;
+              }
+            }
+          }
+        }
+      }
+      if (!(++vidx % 1000)) {
+        printf("\r--bcf: %uk variants converted.", vidx / 1000);
+        fflush(stdout);
+      }
+    }
+    if (fclose_flush_null(writebuf_flush, write_iter, &pvarfile)) {
+      goto BcfToPgen_ret_WRITE_FAIL;
+    }
+    if (sample_ct) {
+      SpgwFinish(&spgw);
+    }
+    putc_unlocked('\r', stdout);
+    write_iter = strcpya(g_logbuf, "--bcf: ");
+    const uint32_t outname_base_slen = outname_end - outname;
+    if (sample_ct) {
+      write_iter = memcpya(write_iter, outname, outname_base_slen + 5);
+      write_iter = memcpyl3a(write_iter, " + ");
+    } else {
+      *pgen_generated_ptr = 0;
+    }
+    write_iter = memcpya(write_iter, outname, outname_base_slen);
+    write_iter = strcpya(write_iter, ".pvar");
+    if (sample_ct && (!preexisting_psamname)) {
+      write_iter = memcpyl3a(write_iter, " + ");
+      write_iter = memcpya(write_iter, outname, outname_base_slen);
+      write_iter = strcpya(write_iter, ".psam");
+    } else {
+      *psam_generated_ptr = 0;
+    }
+    write_iter = strcpya(write_iter, " written");
+    if (!sample_ct) {
+      write_iter = strcpya(write_iter, " (no samples present)");
+    }
+    strcpy(write_iter, ".\n");
+    WordWrapB(0);
+    logputsb();
+  }
+  while (0) {
+  BcfToPgen_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  BcfToPgen_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  BcfToPgen_ret_READ_FAIL_OR_TRUNCATED:
+    if (reterr != kPglRetReadFail) {
+      putc_unlocked('\n', stdout);
+      logerrputs("Error: --bcf file is truncated.\n");
+      reterr = kPglRetMalformedInput;
+      break;
+    }
+  BcfToPgen_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  BcfToPgen_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  BcfToPgen_ret_BAD_HEADER:
+    snprintf(g_logbuf, kLogbufSize, "Error: %s is not a BCF2 file, or its header is truncated.\n", bcfname);
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_HALF_CALL_ERROR:
+    putc_unlocked('\n', stdout);
+    logerrprintf("Error: Record %" PRIuPTR " of --bcf file has a GT half-call.\n", rec_idx);
+    if (!vcf_half_call_explicit_error) {
+      logerrputs("Use --vcf-half-call to specify how these should be processed.\n");
+    }
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_INVALID_GT:
+    putc_unlocked('\n', stdout);
+    logerrprintf("Error: Record %" PRIuPTR " of --bcf file has an invalid GT field.\n", rec_idx);
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_MALFORMED_RECORD:
+    putc_unlocked('\n', stdout);
+    logerrprintf("Error: Record %" PRIuPTR " of --bcf file is malformed.\n", rec_idx);
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_MALFORMED_INPUT_2N:
+    logputs("\n");
+    logerrputsb();
+  BcfToPgen_ret_MALFORMED_INPUT:
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  BcfToPgen_ret_INVALID_DOSAGE:
+    putc_unlocked('\n', stdout);
+    logerrprintfww("Error: Record %" PRIuPTR " of --bcf file has an invalid %s field.\n", rec_idx, dosage_import_field);
+  BcfToPgen_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ BcfToPgen_ret_1:
+  if (SpgwCleanup(&spgw) && (!reterr)) {
+    reterr = kPglRetWriteFail;
+  }
+  if (bgzfp) {
+    bgzf_close(bgzfp);
+  }
+  fclose_cond(pvarfile);
+  BigstackDoubleReset(bigstack_mark, bigstack_end_mark);
+  return reterr;
+}
+
 PglErr OxSampleToPsam(const char* samplename, const char* ox_missing_code, ImportFlags import_flags, char* outname, char* outname_end, uint32_t* sample_ct_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   FILE* psamfile = nullptr;
@@ -4397,7 +6065,7 @@ THREAD_FUNC_DECL Bgen13GenoToPgenThread(void* arg) {
 }
 
 static_assert(sizeof(Dosage) == 2, "OxBgenToPgen() needs to be updated.");
-PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* const_fid, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip) {
+PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* const_fid, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, BgenDirectInfo* bgen_direct_info_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   FILE* bgenfile = nullptr;
@@ -4466,6 +6134,11 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
       logerrputs("Error: Invalid .bgen header.\n");
       goto OxBgenToPgen_ret_MALFORMED_INPUT;
     }
+    const uint32_t bgen_direct = (oxford_import_flags / kfOxfordImportBgenDirect) & 1;
+    if (bgen_direct && (layout == 1)) {
+      logerrputs("Error: --bgen 'direct' mode requires a BGEN v1.2 or v1.3 file.\n");
+      goto OxBgenToPgen_ret_INCONSISTENT_INPUT;
+    }
     logprintf("--bgen: %u variant%s detected, format v1.%c.\n", raw_variant_ct, (raw_variant_ct == 1)? "" : "s", (layout == 1)? '1' : ((compression_mode == 2)? '3' : '2'));
     if (samplename[0]) {
       uint32_t sfile_sample_ct;
@@ -4721,7 +6394,9 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
     }
     const uint32_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
     const uint32_t sample_ctaw = BitCtToAlignedWordCt(sample_ct);
-    uint32_t dosage_is_present = 0;
+    // no .pgen is written in direct mode, so the dosage/phase scan is
+    // pointless
+    uint32_t dosage_is_present = bgen_direct;
     g_sample_ct = sample_ct;
     g_hard_call_halfdist = kDosage4th - hard_call_thresh;
     g_dosage_erase_halfdist = kDosage4th - dosage_erase_thresh;
@@ -5354,6 +7029,12 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
       if (bigstack_end_alloc_w(raw_variant_ct + 1, &allele_idx_offsets)) {
         goto OxBgenToPgen_ret_NOMEM;
       }
+      uint64_t* variant_fposes = nullptr;
+      if (bgen_direct) {
+        if (bigstack_end_alloc_u64(raw_variant_ct + 1, &variant_fposes)) {
+          goto OxBgenToPgen_ret_NOMEM;
+        }
+      }
 
       g_bgen_import_dosage_certainty_thresholds = nullptr;
       if (import_dosage_certainty > (1.0 - kSmallEpsilon) / 3.0) {
@@ -5523,6 +7204,10 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
         // and there is an allele count
         // logic is more similar to the second bgen 1.1 pass since we write the
         // .pvar here.
+        uint64_t variant_fpos = 0;
+        if (variant_fposes) {
+          variant_fpos = ftello(bgenfile);
+        }
         uint16_t snpid_slen;
         if (!fread_unlocked(&snpid_slen, 2, 1, bgenfile)) {
           goto OxBgenToPgen_ret_READ_FAIL;
@@ -5775,6 +7460,9 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
         AppendBinaryEoln(&write_iter);
         *allele_idx_offsets_iter++ = tot_allele_ct;
         tot_allele_ct += cur_allele_ct;
+        if (variant_fposes) {
+          variant_fposes[variant_ct] = variant_fpos;
+        }
         uint32_t genodata_byte_ct;
         if (!fread_unlocked(&genodata_byte_ct, 4, 1, bgenfile)) {
           goto OxBgenToPgen_ret_READ_FAIL;
@@ -5918,6 +7606,66 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
         dosage_is_present = g_dosage_is_present;
       }
 
+      if (bgen_direct) {
+        if (fseeko(bgenfile, 0, SEEK_END)) {
+          goto OxBgenToPgen_ret_READ_FAIL;
+        }
+        const uint64_t bgen_fsize = ftello(bgenfile);
+        variant_fposes[variant_ct] = bgen_fsize;
+        if (fclose_flush_null(writebuf_flush, write_iter, &pvarfile)) {
+          goto OxBgenToPgen_ret_WRITE_FAIL;
+        }
+        putc_unlocked('\r', stdout);
+        BigstackReset(g_bgen_allele_cts[0]);
+        // Use the .bgen's own index when it covers exactly the retained
+        // variants; otherwise write one next to the .pvar.
+        char* idxname = bgen_direct_info_ptr->idxname;
+        const uint32_t bgenname_slen = strlen(bgenname);
+        uint32_t companion_idx_present = 0;
+        uint32_t idx_generated = 1;
+        if (bgenname_slen + 5 <= kPglFnamesize) {
+          snprintf(memcpya(idxname, bgenname, bgenname_slen), 5, ".idx");
+          uint64_t* idx_fposes;
+          reterr = LoadBgenIdx(idxname, variant_ct, bgen_fsize, &idx_fposes);
+          if (reterr == kPglRetNomem) {
+            goto OxBgenToPgen_ret_NOMEM;
+          }
+          companion_idx_present = (reterr != kPglRetOpenFail);
+          if (!reterr) {
+            idx_generated = memcmp(idx_fposes, variant_fposes, (variant_ct + k1LU) * sizeof(int64_t))? 1 : 0;
+          }
+          reterr = kPglRetSuccess;
+        }
+        if (idx_generated) {
+          snprintf(outname_end, kMaxOutfnameExtBlen, ".bgen.idx");
+          if (companion_idx_present && (!strcmp(outname, idxname))) {
+            logputs("\n");
+            snprintf(g_logbuf, kLogbufSize, "Error: %s does not match %s. Delete it, or use a different --out prefix.\n", idxname, bgenname);
+            goto OxBgenToPgen_ret_INCONSISTENT_INPUT_WW;
+          }
+          reterr = WriteBgenIdx(outname, variant_fposes, variant_ct);
+          if (reterr) {
+            goto OxBgenToPgen_ret_1;
+          }
+          strcpy(idxname, outname);
+        }
+        bgen_direct_info_ptr->idx_generated = idx_generated;
+        bgen_direct_info_ptr->compression_mode = compression_mode;
+        bgen_direct_info_ptr->max_geno_blen = max_geno_blen;
+        bgen_direct_info_ptr->prov_ref_allele_second = prov_ref_allele_second;
+        bgen_direct_info_ptr->all_nonref = !(oxford_import_flags & (kfOxfordImportRefFirst | kfOxfordImportRefLast));
+        bgen_direct_info_ptr->hard_call_thresh = hard_call_thresh;
+        bgen_direct_info_ptr->dosage_erase_thresh = dosage_erase_thresh;
+        bgen_direct_info_ptr->import_dosage_certainty = import_dosage_certainty;
+        *outname_end = '\0';
+        if (idx_generated) {
+          logprintfww("--bgen: %s.pvar + %s.bgen.idx written (direct mode, no .pgen).\n", outname, outname);
+        } else {
+          logprintfww("--bgen: %s.pvar written (direct mode, no .pgen; using %s).\n", outname, idxname);
+        }
+        goto OxBgenToPgen_ret_1;
+      }
+
       if (tot_allele_ct == variant_ct * 2) {
         allele_idx_offsets = nullptr;
         BigstackEndReset(bigstack_end_mark);
@@ -6370,6 +8118,8 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
   OxBgenToPgen_ret_MALFORMED_INPUT:
     reterr = kPglRetMalformedInput;
     break;
+  OxBgenToPgen_ret_INCONSISTENT_INPUT_WW:
+    WordWrapB(0);
   OxBgenToPgen_ret_INCONSISTENT_INPUT_2:
     logerrputsb();
   OxBgenToPgen_ret_INCONSISTENT_INPUT:
@@ -6408,6 +8158,771 @@ PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* co
   return reterr;
 }
 
+void PreinitBgenReader(BgenReader* bgrp) {
+  bgrp->ff = nullptr;
+  bgrp->ldc = nullptr;
+}
+
+PglErr BgenReaderInit(const char* bgenname, const BgenDirectInfo* bgen_direct_info_ptr, uint32_t raw_variant_ct, uint32_t raw_sample_ct, BgenReader* bgrp, PgenGlobalFlags* gflags_ptr) {
+  PglErr reterr = kPglRetSuccess;
+  {
+    const char* idxname = bgen_direct_info_ptr->idxname;
+    const uint32_t compression_mode = bgen_direct_info_ptr->compression_mode;
+    const uint32_t max_geno_blen = bgen_direct_info_ptr->max_geno_blen;
+    if (fopen_checked(bgenname, FOPEN_RB, &bgrp->ff)) {
+      goto BgenReaderInit_ret_OPEN_FAIL;
+    }
+    if (fseeko(bgrp->ff, 0, SEEK_END)) {
+      goto BgenReaderInit_ret_READ_FAIL;
+    }
+    const uint64_t bgen_fsize = ftello(bgrp->ff);
+    uint64_t* variant_fposes;
+    reterr = LoadBgenIdx(idxname, raw_variant_ct, bgen_fsize, &variant_fposes);
+    if (reterr) {
+      if (reterr == kPglRetOpenFail) {
+        logputs("\n");
+        logerrprintfww(kErrprintfFopen, idxname);
+      } else if (reterr == kPglRetInconsistentInput) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s does not match %s (was the .bgen modified after the index was written?).\n", idxname, bgenname);
+        goto BgenReaderInit_ret_INCONSISTENT_INPUT_WW;
+      } else if (reterr == kPglRetMalformedInput) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s is not a valid .bgen.idx file.\n", idxname);
+        goto BgenReaderInit_ret_MALFORMED_INPUT_WW;
+      }
+      goto BgenReaderInit_ret_1;
+    }
+    uint32_t* dosage_certainty_thresholds = nullptr;
+    const double import_dosage_certainty = bgen_direct_info_ptr->import_dosage_certainty;
+    if (import_dosage_certainty > (1.0 - kSmallEpsilon) / 3.0) {
+      if (bigstack_alloc_u32(17, &dosage_certainty_thresholds)) {
+        goto BgenReaderInit_ret_NOMEM;
+      }
+      dosage_certainty_thresholds[0] = 0;
+      for (uint32_t bit_precision = 1; bit_precision <= 16; ++bit_precision) {
+        const uint32_t denom = (1U << bit_precision) - 1;
+        const double denom_d = u31tod(denom);
+        dosage_certainty_thresholds[bit_precision] = 1 + S_CAST(int32_t, import_dosage_certainty * denom_d);
+      }
+    }
+    // probability reads may run up to 3 bytes past the end of a block
+    const uintptr_t geno_buf_size = RoundUpPow2(max_geno_blen + 4, kCacheline);
+    if (bigstack_alloc_uc(geno_buf_size, &bgrp->compressed_buf)) {
+      goto BgenReaderInit_ret_NOMEM;
+    }
+    bgrp->uncompressed_buf = bgrp->compressed_buf;
+    if (compression_mode) {
+      if (bigstack_alloc_uc(geno_buf_size, &bgrp->uncompressed_buf)) {
+        goto BgenReaderInit_ret_NOMEM;
+      }
+      if (compression_mode == 1) {
+        bgrp->ldc = libdeflate_alloc_decompressor();
+        if (!bgrp->ldc) {
+          goto BgenReaderInit_ret_NOMEM;
+        }
+      }
+    }
+    bgrp->fname = bgenname;
+    bgrp->fpos = bgen_fsize;
+    bgrp->variant_fposes = variant_fposes;
+    bgrp->dosage_certainty_thresholds = dosage_certainty_thresholds;
+    bgrp->max_geno_blen = max_geno_blen;
+    bgrp->raw_variant_ct = raw_variant_ct;
+    bgrp->raw_sample_ct = raw_sample_ct;
+    bgrp->compression_mode = compression_mode;
+    bgrp->prov_ref_allele_second = bgen_direct_info_ptr->prov_ref_allele_second;
+    bgrp->hard_call_halfdist = kDosage4th - bgen_direct_info_ptr->hard_call_thresh;
+    bgrp->dosage_erase_halfdist = kDosage4th - bgen_direct_info_ptr->dosage_erase_thresh;
+    *gflags_ptr = kfPgenGlobalDosagePresent;
+    if (bgen_direct_info_ptr->all_nonref) {
+      *gflags_ptr |= kfPgenGlobalAllNonref;
+    }
+  }
+  while (0) {
+  BgenReaderInit_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  BgenReaderInit_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  BgenReaderInit_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  BgenReaderInit_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  BgenReaderInit_ret_INCONSISTENT_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ BgenReaderInit_ret_1:
+  return reterr;
+}
+
+BoolErr CleanupBgenReader(BgenReader* bgrp) {
+  if (bgrp->ldc) {
+    libdeflate_free_decompressor(bgrp->ldc);
+    bgrp->ldc = nullptr;
+  }
+  if (!bgrp->ff) {
+    return 0;
+  }
+  return fclose_null(&bgrp->ff);
+}
+
+PglErr BgenMtLoadInit(const BgenReader* bgrp, uint32_t sample_ct, uintptr_t bytes_avail, uintptr_t thread_xalloc_cacheline_ct, uintptr_t per_variant_xalloc_byte_ct, uint32_t* calc_thread_ct_ptr, uintptr_t*** genovecs_ptr, uintptr_t*** dosage_present_ptr, Dosage*** dosage_mains_ptr, uint32_t* read_block_size_ptr, pthread_t** threads_ptr, BgenReader*** bgen_readers_ptr, uint32_t** read_variant_uidx_starts_ptr) {
+  uintptr_t cachelines_avail = bytes_avail / kCacheline;
+  uint32_t read_block_size = kPglVblockSize;
+  // genotype blocks are read by the worker threads, so the only per-variant
+  // allocation is the caller's
+  while ((S_CAST(uint64_t, per_variant_xalloc_byte_ct) * read_block_size / kCacheline) * 4 > cachelines_avail) {
+    if (read_block_size <= kBitsPerVec) {
+      return kPglRetNomem;
+    }
+    read_block_size /= 2;
+  }
+  *read_block_size_ptr = read_block_size;
+  cachelines_avail -= 2 * ((S_CAST(uint64_t, per_variant_xalloc_byte_ct) * read_block_size) / kCacheline);
+  uint32_t calc_thread_ct = *calc_thread_ct_ptr;
+  if (calc_thread_ct > read_block_size) {
+    calc_thread_ct = read_block_size;
+  }
+
+  // bgen_readers, threads, read_variant_uidx_starts, genovecs,
+  //   dosage_presents, dosage_mains, reader struct, geno buffers; deliberately
+  //   a slight overestimate
+  const uintptr_t reader_struct_alloc = RoundUpPow2(sizeof(BgenReader), kCacheline);
+  const uintptr_t geno_buf_size = RoundUpPow2(bgrp->max_geno_blen + 4, kCacheline);
+  const uint32_t compression_mode = bgrp->compression_mode;
+  const uintptr_t geno_bufs_alloc = (1 + (compression_mode != 0)) * geno_buf_size;
+  const uint32_t sample_ctcl2 = QuaterCtToCachelineCt(sample_ct);
+  const uint32_t sample_ctcl = BitCtToCachelineCt(sample_ct);
+  const uintptr_t dosage_main_cl = DivUp(sample_ct, (kCacheline / sizeof(Dosage)));
+  const uintptr_t thread_alloc_cacheline_ct = 6 + (reader_struct_alloc + geno_bufs_alloc) / kCacheline + sample_ctcl2 + sample_ctcl + dosage_main_cl + thread_xalloc_cacheline_ct;
+  if (thread_alloc_cacheline_ct * calc_thread_ct > cachelines_avail) {
+    if (thread_alloc_cacheline_ct > cachelines_avail) {
+      return kPglRetNomem;
+    }
+    calc_thread_ct = cachelines_avail / thread_alloc_cacheline_ct;
+  }
+  *calc_thread_ct_ptr = calc_thread_ct;
+
+  const uint32_t array_of_ptrs_alloc = RoundUpPow2(calc_thread_ct * sizeof(intptr_t), kCacheline);
+  BgenReader** bgen_readers = S_CAST(BgenReader**, bigstack_alloc_raw(array_of_ptrs_alloc));
+  *threads_ptr = S_CAST(pthread_t*, bigstack_alloc_raw(array_of_ptrs_alloc));
+  *read_variant_uidx_starts_ptr = S_CAST(uint32_t*, bigstack_alloc_raw_rd(calc_thread_ct * sizeof(int32_t)));
+  *genovecs_ptr = S_CAST(uintptr_t**, bigstack_alloc_raw(array_of_ptrs_alloc));
+  *dosage_present_ptr = S_CAST(uintptr_t**, bigstack_alloc_raw(array_of_ptrs_alloc));
+  *dosage_mains_ptr = S_CAST(Dosage**, bigstack_alloc_raw(array_of_ptrs_alloc));
+  for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+    BgenReader* cur_bgrp = S_CAST(BgenReader*, bigstack_alloc_raw(reader_struct_alloc));
+    *cur_bgrp = *bgrp;  // struct copy
+    PreinitBgenReader(cur_bgrp);
+    // force a seek on the first read
+    cur_bgrp->fpos = ~0LLU;
+    cur_bgrp->compressed_buf = S_CAST(unsigned char*, bigstack_alloc_raw(geno_buf_size));
+    cur_bgrp->uncompressed_buf = cur_bgrp->compressed_buf;
+    if (compression_mode) {
+      cur_bgrp->uncompressed_buf = S_CAST(unsigned char*, bigstack_alloc_raw(geno_buf_size));
+    }
+    bgen_readers[tidx] = cur_bgrp;
+    (*genovecs_ptr)[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(sample_ctcl2 * kCacheline));
+    (*dosage_present_ptr)[tidx] = S_CAST(uintptr_t*, bigstack_alloc_raw(sample_ctcl * kCacheline));
+    (*dosage_mains_ptr)[tidx] = S_CAST(Dosage*, bigstack_alloc_raw(dosage_main_cl * kCacheline));
+  }
+  PglErr reterr = kPglRetSuccess;
+  for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+    BgenReader* cur_bgrp = bgen_readers[tidx];
+    if (fopen_checked(bgrp->fname, FOPEN_RB, &cur_bgrp->ff)) {
+      reterr = kPglRetOpenFail;
+    } else if (compression_mode == 1) {
+      cur_bgrp->ldc = libdeflate_alloc_decompressor();
+      if (!cur_bgrp->ldc) {
+        reterr = kPglRetNomem;
+      }
+    }
+    if (reterr) {
+      for (uint32_t tidx2 = 0; tidx2 <= tidx; ++tidx2) {
+        CleanupBgenReader(bgen_readers[tidx2]);
+      }
+      return reterr;
+    }
+  }
+  *bgen_readers_ptr = bgen_readers;
+  return kPglRetSuccess;
+}
+
+// Loads the raw (possibly compressed) genotype block of the variant record
+// starting at fpos.  On success, *cur_fpos_ptr is advanced past the record, so
+// runs of adjacent variants don't require any seeks.
+static PglErr BgenLoadGenoBlock(FILE* ff, uint64_t fpos, uint32_t compression_mode, uint32_t max_geno_blen, uint64_t* cur_fpos_ptr, unsigned char* dst, uint32_t* byte_ct_ptr, uint32_t* uncompressed_byte_ct_ptr) {
+  if (*cur_fpos_ptr != fpos) {
+    if (fseeko(ff, fpos, SEEK_SET)) {
+      return kPglRetReadFail;
+    }
+  }
+  // skip variant ID, rsID, chromosome, position, and alleles
+  for (uint32_t uii = 0; uii != 3; ++uii) {
+    uint16_t slen;
+    if ((!fread_unlocked(&slen, 2, 1, ff)) || fseeko(ff, slen, SEEK_CUR)) {
+      return kPglRetReadFail;
+    }
+  }
+  unsigned char pos_and_allele_ct[6];
+  if (!fread_unlocked(pos_and_allele_ct, 6, 1, ff)) {
+    return kPglRetReadFail;
+  }
+  uint16_t allele_ct;
+  memcpy(&allele_ct, &(pos_and_allele_ct[4]), 2);
+  for (uint32_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+    uint32_t allele_slen;
+    if ((!fread_unlocked(&allele_slen, 4, 1, ff)) || fseeko(ff, allele_slen, SEEK_CUR)) {
+      return kPglRetReadFail;
+    }
+  }
+  uint32_t genodata_byte_ct;
+  if (!fread_unlocked(&genodata_byte_ct, 4, 1, ff)) {
+    return kPglRetReadFail;
+  }
+  if (compression_mode) {
+    if ((genodata_byte_ct < 4) || (!fread_unlocked(uncompressed_byte_ct_ptr, 4, 1, ff))) {
+      return kPglRetMalformedInput;
+    }
+    genodata_byte_ct -= 4;
+    if (*uncompressed_byte_ct_ptr > max_geno_blen) {
+      return kPglRetMalformedInput;
+    }
+  } else {
+    *uncompressed_byte_ct_ptr = genodata_byte_ct;
+  }
+  if ((genodata_byte_ct > max_geno_blen) || fread_checked(dst, genodata_byte_ct, ff)) {
+    return kPglRetMalformedInput;
+  }
+  *cur_fpos_ptr = ftello(ff);
+  *byte_ct_ptr = genodata_byte_ct;
+  return kPglRetSuccess;
+}
+
+static BoolErr BgenDecompressGenoBlock(const unsigned char* src, uint32_t src_byte_ct, uint32_t dst_byte_ct, uint32_t compression_mode, struct libdeflate_decompressor* ldc, unsigned char* dst) {
+  if (compression_mode == 1) {
+    return (libdeflate_zlib_decompress(ldc, src, src_byte_ct, dst, dst_byte_ct, nullptr) != LIBDEFLATE_SUCCESS);
+  }
+  return (ZSTD_decompress(dst, dst_byte_ct, src, src_byte_ct) != dst_byte_ct);
+}
+
+// Decodes a decompressed biallelic bgen-1.2/1.3 genotype block, using the
+// same hardcall/dosage rules as Bgen13GenoToPgenThread().  Only samples in
+// sample_include are written, in PgrGetD() format (alt1 dosages; dphase is
+// discarded).
+static_assert(sizeof(Dosage) == 2, "BgenDecodeBiallelic() needs to be updated.");
+static PglErr BgenDecodeBiallelic(const unsigned char* geno_block, uint32_t byte_ct, const uintptr_t* sample_include, uint32_t sample_ct, const BgenReader* bgrp, uintptr_t* genovec, uintptr_t* dosage_present, Dosage* dosage_main, uint32_t* dosage_ct_ptr) {
+  const uint32_t raw_sample_ct = bgrp->raw_sample_ct;
+  // 4 bytes: sample_ct
+  // 2 bytes: # of alleles
+  // 1 byte: min ploidy
+  // 1 byte: max ploidy
+  // sample_ct bytes: low 6 bits = ploidy, top bit = missingness
+  // 1 byte: 1 if phased, 0 if not
+  // 1 byte: # of bits of probability precision
+  if ((byte_ct < 10 + raw_sample_ct) || (raw_sample_ct != *R_CAST(const uint32_t*, geno_block)) || (*R_CAST(const uint16_t*, &(geno_block[4])) != 2)) {
+    return kPglRetMalformedInput;
+  }
+  const uint32_t min_ploidy = geno_block[6];
+  const uint32_t max_ploidy = geno_block[7];
+  if ((min_ploidy > max_ploidy) || (max_ploidy > 63)) {
+    return kPglRetMalformedInput;
+  }
+  if (max_ploidy > 2) {
+    return kPglRetNotYetSupported;
+  }
+  const unsigned char* missing_and_ploidy_iter = &(geno_block[8]);
+  const unsigned char* prob_iter = &(geno_block[8 + raw_sample_ct]);
+  const unsigned char* geno_block_end = &(geno_block[byte_ct]);
+  const uint32_t is_phased = *prob_iter++;
+  const uint32_t bit_precision = *prob_iter++;
+  if ((is_phased > 1) || (!bit_precision) || (bit_precision > 32)) {
+    return kPglRetMalformedInput;
+  }
+  if (bit_precision > 16) {
+    return kPglRetNotYetSupported;
+  }
+  const uint64_t totq_magic = kBgenMagicNums[bit_precision].totq_magic;
+  const uint32_t totq_postshift = kBgenMagicNums[bit_precision].totq_postshift;
+  const uint32_t totq_incr = kBgenMagicNums[bit_precision].totq_incr + (1U << (bit_precision - 1));
+  const uint32_t bytes_per_prob = DivUp(bit_precision, CHAR_BIT);
+  const uintptr_t numer_mask = (1U << bit_precision) - 1;
+  const uint32_t numer_certainty_min = bgrp->dosage_certainty_thresholds? bgrp->dosage_certainty_thresholds[bit_precision] : 0;
+  const uint32_t hard_call_halfdist = bgrp->hard_call_halfdist;
+  const uint32_t dosage_erase_halfdist = bgrp->dosage_erase_halfdist;
+  const uint32_t dosage_erase_halfdist2 = (dosage_erase_halfdist + kDosage4th + 1) / 2;
+  const uint32_t phased_rules = is_phased && (max_ploidy == 2);
+  const uint32_t fixed_diploid = (min_ploidy == 2);
+  const uint32_t invert = !bgrp->prov_ref_allele_second;
+  ZeroWArr(QuaterCtToWordCt(sample_ct), genovec);
+  ZeroWArr(BitCtToWordCt(sample_ct), dosage_present);
+  Dosage* dosage_main_iter = dosage_main;
+  uint32_t sample_idx = 0;
+  for (uint32_t sample_uidx = 0; sample_uidx != raw_sample_ct; ++sample_uidx) {
+    const uint32_t missing_and_ploidy = missing_and_ploidy_iter[sample_uidx];
+    const uint32_t ploidy = missing_and_ploidy & 127;
+    if (ploidy > 2) {
+      return kPglRetMalformedInput;
+    }
+    const unsigned char* cur_probs = prob_iter;
+    prob_iter = &(prob_iter[ploidy * bytes_per_prob]);
+    if (prob_iter > geno_block_end) {
+      return kPglRetMalformedInput;
+    }
+    if (sample_include && (!IsSet(sample_include, sample_uidx))) {
+      continue;
+    }
+    uintptr_t cur_geno = 3;
+    uint32_t write_dosage_int = 0;
+    uint32_t dosage_is_stored = 0;
+    if (missing_and_ploidy == 2) {
+#ifdef __arm__
+#  error "Unaligned accesses in BgenDecodeBiallelic()."
+#endif
+      const uintptr_t numer1 = (*R_CAST(const uint32_t*, cur_probs)) & numer_mask;
+      const uintptr_t numer2 = (*R_CAST(const uint32_t*, &(cur_probs[bytes_per_prob]))) & numer_mask;
+      if (!is_phased) {
+        if (numer1 + numer2 > numer_mask) {
+          return kPglRetMalformedInput;
+        }
+        if ((numer1 < numer_certainty_min) && (numer2 < numer_certainty_min) && (numer_mask - numer_certainty_min < numer1 + numer2)) {
+          goto BgenDecodeBiallelic_missing;
+        }
+        write_dosage_int = (totq_magic * (kDosageMax * S_CAST(uint64_t, numer1) + kDosageMid * S_CAST(uint64_t, numer2) + totq_incr)) >> totq_postshift;
+      } else {
+        if (numer_certainty_min) {
+          const uintptr_t numer_sum_x2 = 2 * (numer1 + numer2);
+          const uint32_t dist_from_het_x2 = 2 * abs_i32(numer_sum_x2 - numer_mask);
+          const uint32_t cur_certainty = numer_mask - abs_i32(dist_from_het_x2 - numer_mask);
+          if (cur_certainty < numer_certainty_min) {
+            goto BgenDecodeBiallelic_missing;
+          }
+        }
+        const uint32_t write_dhap1_int = (totq_magic * (kDosageMid * S_CAST(uint64_t, numer1) + totq_incr)) >> totq_postshift;
+        const uint32_t write_dhap2_int = (totq_magic * (kDosageMid * S_CAST(uint64_t, numer2) + totq_incr)) >> totq_postshift;
+        if ((HaploidDosageHalfdist(write_dhap1_int) >= dosage_erase_halfdist2) && (HaploidDosageHalfdist(write_dhap2_int) >= dosage_erase_halfdist2)) {
+          cur_geno = ((write_dhap1_int + kDosage4th) / kDosageMid) + ((write_dhap2_int + kDosage4th) / kDosageMid);
+          goto BgenDecodeBiallelic_write;
+        }
+        write_dosage_int = write_dhap1_int + write_dhap2_int;
+        const uint32_t halfdist = BiallelicDosageHalfdist(write_dosage_int);
+        dosage_is_stored = 1;
+        if (halfdist >= hard_call_halfdist) {
+          cur_geno = (write_dosage_int + kDosage4th) / kDosageMid;
+          if ((cur_geno == 1) && (write_dhap1_int == write_dhap2_int)) {
+            // unphased het hardcall special case
+            dosage_is_stored = fixed_diploid? (halfdist < dosage_erase_halfdist) : (write_dosage_int != kDosageMid);
+          }
+        }
+        goto BgenDecodeBiallelic_write;
+      }
+    } else if (missing_and_ploidy == 1) {
+      const uintptr_t numer1 = (*R_CAST(const uint32_t*, cur_probs)) & numer_mask;
+      if ((numer1 < numer_certainty_min) && (numer_mask - numer_certainty_min < numer1)) {
+        goto BgenDecodeBiallelic_missing;
+      }
+      write_dosage_int = (totq_magic * (kDosageMax * S_CAST(uint64_t, numer1) + totq_incr)) >> totq_postshift;
+      if (phased_rules) {
+        dosage_is_stored = 1;
+        if (BiallelicDosageHalfdist(write_dosage_int) >= hard_call_halfdist) {
+          cur_geno = (write_dosage_int + kDosage4th) / kDosageMid;
+          dosage_is_stored = (cur_geno != 1) || (write_dosage_int != kDosageMid);
+        }
+        goto BgenDecodeBiallelic_write;
+      }
+    } else {
+      goto BgenDecodeBiallelic_missing;
+    }
+    {
+      const uint32_t halfdist = BiallelicDosageHalfdist(write_dosage_int);
+      dosage_is_stored = 1;
+      if (halfdist >= hard_call_halfdist) {
+        cur_geno = (write_dosage_int + kDosage4th) / kDosageMid;
+        dosage_is_stored = (halfdist < dosage_erase_halfdist);
+      }
+    }
+  BgenDecodeBiallelic_write:
+    if (invert) {
+      if (cur_geno != 3) {
+        cur_geno = 2 - cur_geno;
+      }
+      write_dosage_int = kDosageMax - write_dosage_int;
+    }
+    if (dosage_is_stored) {
+      SetBit(sample_idx, dosage_present);
+      *dosage_main_iter++ = write_dosage_int;
+    }
+  BgenDecodeBiallelic_missing:
+    genovec[sample_idx / kBitsPerWordD2] |= cur_geno << (2 * (sample_idx % kBitsPerWordD2));
+    ++sample_idx;
+  }
+  if (prob_iter != geno_block_end) {
+    return kPglRetMalformedInput;
+  }
+  *dosage_ct_ptr = dosage_main_iter - dosage_main;
+  return kPglRetSuccess;
+}
+
+PglErr BgenGetD(const uintptr_t* __restrict sample_include, uint32_t sample_ct, uint32_t vidx, BgenReader* bgrp, uintptr_t* __restrict genovec, uintptr_t* __restrict dosage_present, Dosage* dosage_main, uint32_t* dosage_ct_ptr) {
+  assert(vidx < bgrp->raw_variant_ct);
+  const uint32_t compression_mode = bgrp->compression_mode;
+  uint32_t byte_ct;
+  uint32_t uncompressed_byte_ct;
+  PglErr reterr = BgenLoadGenoBlock(bgrp->ff, bgrp->variant_fposes[vidx], compression_mode, bgrp->max_geno_blen, &bgrp->fpos, bgrp->compressed_buf, &byte_ct, &uncompressed_byte_ct);
+  if (reterr) {
+    // don't trust the cached file position after a failed read
+    bgrp->fpos = ~0LLU;
+    return reterr;
+  }
+  if (compression_mode) {
+    if (BgenDecompressGenoBlock(bgrp->compressed_buf, byte_ct, uncompressed_byte_ct, compression_mode, bgrp->ldc, bgrp->uncompressed_buf)) {
+      return kPglRetMalformedInput;
+    }
+  }
+  return BgenDecodeBiallelic(bgrp->uncompressed_buf, uncompressed_byte_ct, sample_include, sample_ct, bgrp, genovec, dosage_present, dosage_main, dosage_ct_ptr);
+}
+
+static const BgenReader* g_bgen_direct_readerp = nullptr;
+static uint32_t* g_bgen_direct_vidxs[2] = {nullptr, nullptr};
+static const ChrInfo* g_bgen_direct_cip = nullptr;
+static const uintptr_t* g_bgen_direct_sex_male = nullptr;
+static const uintptr_t* g_bgen_direct_variant_allele_idxs = nullptr;
+static const uintptr_t* g_bgen_direct_subset_includes[2] = {nullptr, nullptr};
+static uint64_t* g_bgen_direct_subset_dosages[2] = {nullptr, nullptr};
+static uint32_t g_bgen_direct_subset_ct = 0;
+static uintptr_t** g_bgen_direct_genovecs = nullptr;
+static uintptr_t** g_bgen_direct_dosage_presents = nullptr;
+static Dosage** g_bgen_direct_dosage_mains = nullptr;
+
+THREAD_FUNC_DECL BgenDirectAlleleDosagesThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const BgenReader* bgrp = g_bgen_direct_readerp;
+  const ChrInfo* cip = g_bgen_direct_cip;
+  const uintptr_t* sex_male = g_bgen_direct_sex_male;
+  const uintptr_t* variant_allele_idxs = g_bgen_direct_variant_allele_idxs;
+  const uint32_t subset_ct = g_bgen_direct_subset_ct;
+  const uint32_t raw_sample_ct = bgrp->raw_sample_ct;
+  const uint32_t compression_mode = bgrp->compression_mode;
+  const int32_t x_code = cip->xymt_codes[kChrOffsetX];
+  const int32_t y_code = cip->xymt_codes[kChrOffsetY];
+  struct libdeflate_decompressor* decompressor = g_libdeflate_decompressors[tidx];
+  unsigned char* uncompressed_buf = g_thread_wkspaces[tidx];
+  uintptr_t* genovec = g_bgen_direct_genovecs[tidx];
+  uintptr_t* dosage_present = g_bgen_direct_dosage_presents[tidx];
+  Dosage* dosage_main = g_bgen_direct_dosage_mains[tidx];
+  uint32_t parity = 0;
+  while (1) {
+    const uint32_t is_last_block = g_is_last_thread_block;
+    if (g_cur_block_write_ct) {
+      const uint32_t bidx_end = g_thread_bidxs[parity][tidx + 1];
+      const unsigned char* const* compressed_geno_starts = g_compressed_geno_starts[parity];
+      const uint32_t* uncompressed_genodata_byte_cts = g_uncompressed_genodata_byte_cts[parity];
+      const uint32_t* vidxs = g_bgen_direct_vidxs[parity];
+      uint32_t chr_end = 0;
+      // 0 = diploid, 1 = haploid, 2 = chrX, 3 = chrY
+      uint32_t chr_type = 0;
+      for (uint32_t bidx = g_thread_bidxs[parity][tidx]; bidx < bidx_end; ++bidx) {
+        const uint32_t variant_uidx = vidxs[bidx];
+        if (variant_uidx >= chr_end) {
+          const uint32_t chr_fo_idx = GetVariantChrFoIdx(cip, variant_uidx);
+          const int32_t chr_idx = cip->chr_file_order[chr_fo_idx];
+          chr_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+          if (chr_idx == x_code) {
+            chr_type = 2;
+          } else if (chr_idx == y_code) {
+            chr_type = 3;
+          } else {
+            chr_type = IsSet(cip->haploid_mask, chr_idx);
+          }
+        }
+        const unsigned char* cur_geno_block = compressed_geno_starts[bidx];
+        uint32_t byte_ct = compressed_geno_starts[bidx + 1] - cur_geno_block;
+        if (compression_mode) {
+          const uint32_t uncompressed_byte_ct = uncompressed_genodata_byte_cts[bidx];
+          if (BgenDecompressGenoBlock(cur_geno_block, byte_ct, uncompressed_byte_ct, compression_mode, decompressor, uncompressed_buf)) {
+            g_error_ret = kPglRetMalformedInput;
+            break;
+          }
+          cur_geno_block = uncompressed_buf;
+          byte_ct = uncompressed_byte_ct;
+        }
+        uint32_t dosage_ct;
+        const PglErr reterr = BgenDecodeBiallelic(cur_geno_block, byte_ct, nullptr, raw_sample_ct, bgrp, genovec, dosage_present, dosage_main, &dosage_ct);
+        if (reterr) {
+          g_error_ret = reterr;
+          break;
+        }
+        // same conventions as LoadAlleleAndGenoCountsThread(): 32768ths,
+        // diploid autosomal calls count twice, chrX nonmales count twice,
+        // chrY nonmales are ignored
+        uint64_t ref_dosages[2] = {0, 0};
+        uint64_t alt1_dosages[2] = {0, 0};
+        const Dosage* dosage_main_iter = dosage_main;
+        for (uint32_t sample_uidx = 0; sample_uidx != raw_sample_ct; ++sample_uidx) {
+          uint32_t cur_alt1_dosage;
+          if (IsSet(dosage_present, sample_uidx)) {
+            cur_alt1_dosage = *dosage_main_iter++;
+          } else {
+            const uintptr_t cur_geno = GetQuaterarrEntry(genovec, sample_uidx);
+            if (cur_geno == 3) {
+              continue;
+            }
+            cur_alt1_dosage = cur_geno * kDosageMid;
+          }
+          uint32_t multiplier = 2 - (chr_type & 1);
+          if (chr_type >= 2) {
+            const uint32_t is_male = IsSet(sex_male, sample_uidx);
+            if (chr_type == 2) {
+              multiplier = 2 - is_male;
+            } else if (!is_male) {
+              continue;
+            }
+          }
+          for (uint32_t subset_idx = 0; subset_idx != subset_ct; ++subset_idx) {
+            if (IsSet(g_bgen_direct_subset_includes[subset_idx], sample_uidx)) {
+              ref_dosages[subset_idx] += (kDosageMax - cur_alt1_dosage) * multiplier;
+              alt1_dosages[subset_idx] += cur_alt1_dosage * multiplier;
+            }
+          }
+        }
+        const uintptr_t allele_idx_base = variant_allele_idxs? variant_allele_idxs[variant_uidx] : (2 * variant_uidx);
+        for (uint32_t subset_idx = 0; subset_idx != subset_ct; ++subset_idx) {
+          uint64_t* cur_allele_dosages = &(g_bgen_direct_subset_dosages[subset_idx][allele_idx_base]);
+          cur_allele_dosages[0] = ref_dosages[subset_idx];
+          cur_allele_dosages[1] = alt1_dosages[subset_idx];
+        }
+      }
+    }
+    if (is_last_block) {
+      THREAD_RETURN;
+    }
+    THREAD_BLOCK_FINISH(tidx);
+    parity = 1 - parity;
+  }
+}
+
+PglErr BgenLoadAlleleDosages(const uintptr_t* sample_include, const uintptr_t* founder_info, const uintptr_t* sex_male, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, uint32_t variant_ct, uint32_t max_thread_ct, BgenReader* bgrp, uint64_t* allele_dosages, uint64_t* founder_allele_dosages) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  ThreadsState ts;
+  InitThreads3z(&ts);
+  PglErr reterr = kPglRetSuccess;
+  g_libdeflate_decompressors = nullptr;
+  uint32_t calc_thread_ct = 0;
+  {
+    if (!variant_ct) {
+      goto BgenLoadAlleleDosages_ret_1;
+    }
+    const uint32_t raw_sample_ct = bgrp->raw_sample_ct;
+    const uint32_t raw_sample_ctl = BitCtToWordCt(raw_sample_ct);
+    uint32_t subset_ct = 0;
+    if (allele_dosages) {
+      g_bgen_direct_subset_includes[0] = sample_include;
+      g_bgen_direct_subset_dosages[0] = allele_dosages;
+      subset_ct = 1;
+    }
+    if (founder_allele_dosages && (founder_allele_dosages != allele_dosages)) {
+      uintptr_t* founder_include;
+      if (bigstack_alloc_w(raw_sample_ctl, &founder_include)) {
+        goto BgenLoadAlleleDosages_ret_NOMEM;
+      }
+      BitvecAndCopy(sample_include, founder_info, raw_sample_ctl, founder_include);
+      g_bgen_direct_subset_includes[subset_ct] = founder_include;
+      g_bgen_direct_subset_dosages[subset_ct] = founder_allele_dosages;
+      ++subset_ct;
+    }
+    if (!subset_ct) {
+      goto BgenLoadAlleleDosages_ret_1;
+    }
+    const uint32_t compression_mode = bgrp->compression_mode;
+    const uint32_t max_geno_blen = bgrp->max_geno_blen;
+    calc_thread_ct = (max_thread_ct > 2)? (max_thread_ct - 1) : max_thread_ct;
+    if (calc_thread_ct > variant_ct) {
+      calc_thread_ct = variant_ct;
+    }
+    const uintptr_t thread_wkspace_size = RoundUpPow2(max_geno_blen + 4, kCacheline);
+    if (bigstack_alloc_thread(calc_thread_ct, &ts.threads) ||
+        bigstack_alloc_ucp(calc_thread_ct, &g_thread_wkspaces) ||
+        bigstack_alloc_wp(calc_thread_ct, &g_bgen_direct_genovecs) ||
+        bigstack_alloc_wp(calc_thread_ct, &g_bgen_direct_dosage_presents) ||
+        bigstack_alloc_dosagep(calc_thread_ct, &g_bgen_direct_dosage_mains)) {
+      goto BgenLoadAlleleDosages_ret_NOMEM;
+    }
+    g_libdeflate_decompressors = S_CAST(struct libdeflate_decompressor**, bigstack_alloc(calc_thread_ct * sizeof(intptr_t)));
+    if (!g_libdeflate_decompressors) {
+      goto BgenLoadAlleleDosages_ret_NOMEM;
+    }
+    ZeroPtrArr(calc_thread_ct, g_libdeflate_decompressors);
+    for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+      if (bigstack_alloc_uc(thread_wkspace_size, &(g_thread_wkspaces[tidx])) ||
+          bigstack_alloc_w(QuaterCtToWordCt(raw_sample_ct), &(g_bgen_direct_genovecs[tidx])) ||
+          bigstack_alloc_w(raw_sample_ctl, &(g_bgen_direct_dosage_presents[tidx])) ||
+          bigstack_alloc_dosage(raw_sample_ct, &(g_bgen_direct_dosage_mains[tidx]))) {
+        goto BgenLoadAlleleDosages_ret_NOMEM;
+      }
+      if (compression_mode == 1) {
+        g_libdeflate_decompressors[tidx] = libdeflate_alloc_decompressor();
+        if (!g_libdeflate_decompressors[tidx]) {
+          goto BgenLoadAlleleDosages_ret_NOMEM;
+        }
+      }
+    }
+    // Per-block-variant allocations:
+    //   g_thread_bidxs: only calc_thread_ct + 1 entries
+    //   g_compressed_geno_starts: 2 * sizeof(intptr_t)
+    //   g_uncompressed_genodata_byte_cts: 2 * sizeof(int32_t)
+    //   g_bgen_direct_vidxs: 2 * sizeof(int32_t)
+    //   geno_bufs: 2 * (at least) max_geno_blen, but capped at half the
+    //     remaining workspace
+    uintptr_t cachelines_avail = bigstack_left() / kCacheline;
+    if (cachelines_avail < 16) {
+      goto BgenLoadAlleleDosages_ret_NOMEM;
+    }
+    cachelines_avail -= 16;
+    uintptr_t geno_buf_size = RoundDownPow2((cachelines_avail * kCacheline) / 4, kCacheline);
+    if (geno_buf_size < thread_wkspace_size) {
+      goto BgenLoadAlleleDosages_ret_NOMEM;
+    }
+    uintptr_t main_block_size = (cachelines_avail * kCacheline - 2 * geno_buf_size) / (2 * (sizeof(intptr_t) + 2 * sizeof(int32_t)));
+    if (main_block_size > 65536) {
+      main_block_size = 65536;
+    }
+    if (main_block_size > variant_ct) {
+      main_block_size = variant_ct;
+    }
+    unsigned char* geno_bufs[2];
+    if (bigstack_alloc_u32(calc_thread_ct + 1, &(g_thread_bidxs[0])) ||
+        bigstack_alloc_u32(calc_thread_ct + 1, &(g_thread_bidxs[1])) ||
+        bigstack_alloc_ucp(main_block_size + 1, &(g_compressed_geno_starts[0])) ||
+        bigstack_alloc_ucp(main_block_size + 1, &(g_compressed_geno_starts[1])) ||
+        bigstack_alloc_u32(main_block_size, &(g_uncompressed_genodata_byte_cts[0])) ||
+        bigstack_alloc_u32(main_block_size, &(g_uncompressed_genodata_byte_cts[1])) ||
+        bigstack_alloc_u32(main_block_size, &(g_bgen_direct_vidxs[0])) ||
+        bigstack_alloc_u32(main_block_size, &(g_bgen_direct_vidxs[1])) ||
+        bigstack_alloc_uc(geno_buf_size, &(geno_bufs[0])) ||
+        bigstack_alloc_uc(geno_buf_size, &(geno_bufs[1]))) {
+      goto BgenLoadAlleleDosages_ret_NOMEM;
+    }
+    g_bgen_direct_readerp = bgrp;
+    g_bgen_direct_cip = cip;
+    g_bgen_direct_sex_male = sex_male;
+    g_bgen_direct_variant_allele_idxs = variant_allele_idxs;
+    g_bgen_direct_subset_ct = subset_ct;
+    g_error_ret = kPglRetSuccess;
+    ts.calc_thread_ct = calc_thread_ct;
+    ts.thread_func_ptr = BgenDirectAlleleDosagesThread;
+    g_cur_block_write_ct = 1;  // just used as a flag
+
+    // main thread loads batch n+1 while the worker threads decompress and
+    // tally batch n
+    logputs("Calculating allele frequencies from .bgen... ");
+    fputs("0%", stdout);
+    fflush(stdout);
+    uint32_t pct = 0;
+    uint32_t next_print_variant_idx = variant_ct / 100;
+    uint32_t variant_uidx = 0;
+    uint32_t variant_idx = 0;
+    uint32_t vidx_start = 0;
+    uint32_t parity = 0;
+    while (1) {
+      uint32_t cur_block_ct = 0;
+      if (!ts.is_last_block) {
+        unsigned char* geno_buf_iter = geno_bufs[parity];
+        const unsigned char* geno_buf_last = &(geno_bufs[parity][geno_buf_size - thread_wkspace_size]);
+        unsigned char** compressed_geno_starts = g_compressed_geno_starts[parity];
+        uint32_t* uncompressed_genodata_byte_cts = g_uncompressed_genodata_byte_cts[parity];
+        uint32_t* vidxs = g_bgen_direct_vidxs[parity];
+        for (; (variant_idx != variant_ct) && (cur_block_ct != main_block_size) && (geno_buf_iter <= geno_buf_last); ++variant_idx, ++variant_uidx) {
+          MovU32To1Bit(variant_include, &variant_uidx);
+          uint32_t byte_ct;
+          reterr = BgenLoadGenoBlock(bgrp->ff, bgrp->variant_fposes[variant_uidx], compression_mode, max_geno_blen, &bgrp->fpos, geno_buf_iter, &byte_ct, &(uncompressed_genodata_byte_cts[cur_block_ct]));
+          if (reterr) {
+            bgrp->fpos = ~0LLU;
+            goto BgenLoadAlleleDosages_ret_1;
+          }
+          compressed_geno_starts[cur_block_ct] = geno_buf_iter;
+          vidxs[cur_block_ct] = variant_uidx;
+          geno_buf_iter = &(geno_buf_iter[byte_ct]);
+          ++cur_block_ct;
+        }
+        compressed_geno_starts[cur_block_ct] = geno_buf_iter;
+        uint32_t* thread_bidxs = g_thread_bidxs[parity];
+        for (uint32_t tidx = 0; tidx <= calc_thread_ct; ++tidx) {
+          thread_bidxs[tidx] = (S_CAST(uint64_t, tidx) * cur_block_ct) / calc_thread_ct;
+        }
+      }
+      if (vidx_start) {
+        JoinThreads3z(&ts);
+        reterr = g_error_ret;
+        if (reterr) {
+          goto BgenLoadAlleleDosages_ret_THREAD_FAIL;
+        }
+      }
+      if (!ts.is_last_block) {
+        ts.is_last_block = (variant_idx == variant_ct);
+        if (SpawnThreads3z(vidx_start, &ts)) {
+          goto BgenLoadAlleleDosages_ret_THREAD_CREATE_FAIL;
+        }
+      }
+      parity = 1 - parity;
+      if (vidx_start == variant_ct) {
+        break;
+      }
+      vidx_start += cur_block_ct;
+      if (vidx_start >= next_print_variant_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (vidx_start * 100LLU) / variant_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+      }
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+  }
+  while (0) {
+  BgenLoadAlleleDosages_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  BgenLoadAlleleDosages_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  BgenLoadAlleleDosages_ret_THREAD_FAIL:
+    break;
+  }
+ BgenLoadAlleleDosages_ret_1:
+  if (reterr == kPglRetMalformedInput) {
+    logputs("\n");
+    logerrputs("Error: Invalid compressed SNP block in .bgen file.\n");
+  } else if (reterr == kPglRetNotYetSupported) {
+    logputs("\n");
+    logerrputs("Error: BGEN import doesn't currently support >16-bit probability precision or\nploidy > 2.\n");
+  }
+  CleanupThreads3z(&ts, &g_cur_block_write_ct);
+  if (g_libdeflate_decompressors) {
+    for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+      if (!g_libdeflate_decompressors[tidx]) {
+        break;
+      }
+      libdeflate_free_decompressor(g_libdeflate_decompressors[tidx]);
+    }
+    g_libdeflate_decompressors = nullptr;
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
 BoolErr ImportLegendCols(const char* fname, uintptr_t line_idx, uint32_t prov_ref_allele_second, const char** loadbuf_iter_ptr, char** write_iter_ptr, uint32_t* variant_ct_ptr) {
   {
     if (*variant_ct_ptr == 0x7ffffffd) {
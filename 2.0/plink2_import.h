@@ -19,6 +19,7 @@
 
 
 #include "plink2_data.h"
+#include "libdeflate/libdeflate.h"
 
 #ifdef __cplusplus
 namespace plink2 {
@@ -45,7 +46,8 @@ FLAGSET_DEF_START()
   kfOxfordImport0,
   kfOxfordImportRefFirst = (1 << 0),
   kfOxfordImportRefLast = (1 << 1),
-  kfOxfordImportBgenSnpIdChr = (1 << 2)
+  kfOxfordImportBgenSnpIdChr = (1 << 2),
+  kfOxfordImportBgenDirect = (1 << 3)
 FLAGSET_DEF_END(OxfordImportFlags);
 
 FLAGSET_DEF_START()
@@ -85,15 +87,76 @@ typedef struct GenDummyInfoStruct {
   double dosage_freq;
 } GenDummyInfo;
 
+// Filled in by OxBgenToPgen() in --bgen 'direct' mode, and consumed by
+// BgenReaderInit().
+typedef struct BgenDirectInfoStruct {
+  // .bgen.idx with one offset per .pvar variant; either the .bgen's own index,
+  // or one generated next to the .pvar (idx_generated set)
+  char idxname[kPglFnamesize];
+  uint32_t idx_generated;
+  uint32_t compression_mode;
+  uint32_t max_geno_blen;
+  uint32_t prov_ref_allele_second;
+  uint32_t all_nonref;
+  uint32_t hard_call_thresh;
+  uint32_t dosage_erase_thresh;
+  double import_dosage_certainty;
+} BgenDirectInfo;
+
+// Random-access genotype source for --bgen 'direct' mode.  OxBgenToPgen()
+// writes a .pvar instead of a .pgen; variant indexes below refer to that .pvar,
+// and genotype blocks are decoded on demand with the same rounding rules as a
+// real conversion.
+typedef struct BgenReaderStruct {
+  const char* fname;
+  FILE* ff;
+  uint64_t fpos;
+  const uint64_t* variant_fposes;
+  const uint32_t* dosage_certainty_thresholds;  // nullptr if not applicable
+  struct libdeflate_decompressor* ldc;
+  unsigned char* compressed_buf;
+  unsigned char* uncompressed_buf;
+  uint32_t max_geno_blen;
+  uint32_t raw_variant_ct;
+  uint32_t raw_sample_ct;
+  uint32_t compression_mode;
+  uint32_t prov_ref_allele_second;
+  uint32_t hard_call_halfdist;
+  uint32_t dosage_erase_halfdist;
+} BgenReader;
+
 void InitPlink1Dosage(Plink1DosageInfo* plink1_dosage_info_ptr);
 
 void InitGenDummy(GenDummyInfo* gendummy_info_ptr);
 
 PglErr VcfToPgen(const char* vcfname, const char* preexisting_psamname, const char* const_fid, const char* dosage_import_field, MiscFlags misc_flags, ImportFlags import_flags, uint32_t no_samples_ok, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, int32_t vcf_min_gq, int32_t vcf_min_dp, VcfHalfCall vcf_half_call, FamCol fam_cols, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, uint32_t* pgen_generated_ptr, uint32_t* psam_generated_ptr);
 
+PglErr BcfToPgen(const char* bcfname, const char* preexisting_psamname, const char* const_fid, const char* dosage_import_field, MiscFlags misc_flags, ImportFlags import_flags, uint32_t no_samples_ok, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, int32_t vcf_min_gq, int32_t vcf_min_dp, VcfHalfCall vcf_half_call, FamCol fam_cols, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, uint32_t* pgen_generated_ptr, uint32_t* psam_generated_ptr);
+
 PglErr OxGenToPgen(const char* genname, const char* samplename, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip);
 
-PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* const_fid, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip);
+PglErr OxBgenToPgen(const char* bgenname, const char* samplename, const char* const_fid, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, uint32_t hard_call_thresh, uint32_t dosage_erase_thresh, double import_dosage_certainty, char id_delim, char idspace_to, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, BgenDirectInfo* bgen_direct_info_ptr);
+
+void PreinitBgenReader(BgenReader* bgrp);
+
+// Allocates from bigstack.  *gflags_ptr is set to the flags a converted .pgen
+// would have had.
+PglErr BgenReaderInit(const char* bgenname, const BgenDirectInfo* bgen_direct_info_ptr, uint32_t raw_variant_ct, uint32_t raw_sample_ct, BgenReader* bgrp, PgenGlobalFlags* gflags_ptr);
+
+// PgenMtLoadInit() counterpart: each thread gets its own BgenReader, sharing
+// bgrp's offset index, for BgenGetD() calls.  Readers in *bgen_readers_ptr
+// must be closed with CleanupBgenReader().
+PglErr BgenMtLoadInit(const BgenReader* bgrp, uint32_t sample_ct, uintptr_t bytes_avail, uintptr_t thread_xalloc_cacheline_ct, uintptr_t per_variant_xalloc_byte_ct, uint32_t* calc_thread_ct_ptr, uintptr_t*** genovecs_ptr, uintptr_t*** dosage_present_ptr, Dosage*** dosage_mains_ptr, uint32_t* read_block_size_ptr, pthread_t** threads_ptr, BgenReader*** bgen_readers_ptr, uint32_t** read_variant_uidx_starts_ptr);
+
+// Same output conventions as PgrGetD().  sample_include may be nullptr.
+PglErr BgenGetD(const uintptr_t* __restrict sample_include, uint32_t sample_ct, uint32_t vidx, BgenReader* bgrp, uintptr_t* __restrict genovec, uintptr_t* __restrict dosage_present, Dosage* dosage_main, uint32_t* dosage_ct_ptr);
+
+// Multithreaded replacement for the allele-dosage part of
+// LoadAlleleAndGenoCounts().  Either dosage array may be nullptr, and they may
+// be identical.
+PglErr BgenLoadAlleleDosages(const uintptr_t* sample_include, const uintptr_t* founder_info, const uintptr_t* sex_male, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, uint32_t variant_ct, uint32_t max_thread_ct, BgenReader* bgrp, uint64_t* allele_dosages, uint64_t* founder_allele_dosages);
+
+BoolErr CleanupBgenReader(BgenReader* bgrp);
 
 PglErr OxHapslegendToPgen(const char* hapsname, const char* legendname, const char* samplename, const char* ox_single_chr_str, const char* ox_missing_code, MiscFlags misc_flags, ImportFlags import_flags, OxfordImportFlags oxford_import_flags, char* outname, char* outname_end, ChrInfo* cip);
 
@@ -783,13 +783,13 @@ void ColMajorVectorMatrixMultiplyStrided(const double* in_dvec1, const double* i
 #endif  // !NOLAPACK
 }
 
-// er, should make this _addassign for consistency...
-void ColMajorFmatrixMultiplyStrided(const float* inmatrix1, const float* inmatrix2, __CLPK_integer row1_ct, __CLPK_integer stride1, __CLPK_integer col2_ct, __CLPK_integer stride2, __CLPK_integer common_ct, __CLPK_integer stride3, float* outmatrix) {
+void ColMajorFmatrixMultiplyStridedAddassign(const float* inmatrix1, const float* inmatrix2, __CLPK_integer row1_ct, __CLPK_integer stride1, __CLPK_integer col2_ct, __CLPK_integer stride2, __CLPK_integer common_ct, __CLPK_integer stride3, float beta, float* outmatrix) {
 #ifdef NOLAPACK
   const uintptr_t row1_ct_l = row1_ct;
   const uintptr_t col2_ct_l = col2_ct;
   const uintptr_t common_ct_l = common_ct;
-  // not optimized
+  // not optimized.  As with sgemm(), outmatrix isn't read when beta == 0, so
+  // it may be uninitialized.
   for (uintptr_t col_idx = 0; col_idx < col2_ct_l; ++col_idx) {
     float* outmatrix_row_iter = &(outmatrix[col_idx * stride3]);
     for (uintptr_t row_idx = 0; row_idx < row1_ct_l; ++row_idx) {
@@ -798,17 +798,19 @@ void ColMajorFmatrixMultiplyStrided(const float* inmatrix1, const float* inmatri
       for (uintptr_t com_idx = 0; com_idx < common_ct_l; com_idx++) {
         cur_entry += (*col2_iter++) * inmatrix1[com_idx * stride1 + row_idx];
       }
+      if (beta != 0.0) {
+        cur_entry += (*outmatrix_row_iter) * beta;
+      }
       *outmatrix_row_iter++ = cur_entry;
     }
   }
 #else
 #  ifndef USE_CBLAS_XGEMM
   char blas_char = 'N';
-  float fyy = 1;
-  float fzz = 0;
-  sgemm_(&blas_char, &blas_char, &row1_ct, &col2_ct, &common_ct, &fyy, K_CAST(float*, inmatrix1), &stride1, K_CAST(float*, inmatrix2), &stride2, &fzz, outmatrix, &stride3);
+  float alpha = 1;
+  sgemm_(&blas_char, &blas_char, &row1_ct, &col2_ct, &common_ct, &alpha, K_CAST(float*, inmatrix1), &stride1, K_CAST(float*, inmatrix2), &stride2, &beta, outmatrix, &stride3);
 #  else
-  cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, row1_ct, col2_ct, common_ct, 1.0, inmatrix1, stride1, inmatrix2, stride2, 0.0, outmatrix, stride3);
+  cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, row1_ct, col2_ct, common_ct, 1.0, inmatrix1, stride1, inmatrix2, stride2, beta, outmatrix, stride3);
 #  endif  // USE_CBLAS_XGEMM
 #endif  // !NOLAPACK
 }
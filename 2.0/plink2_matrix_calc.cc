@@ -20,6 +20,9 @@
 #include "plink2_matrix_calc.h"
 #include "plink2_random.h"
 
+#include <time.h>  // time()
+#include <unistd.h>  // unlink()
+
 #ifdef __cplusplus
 namespace plink2 {
 #endif
@@ -161,6 +164,28 @@ void TriangleLoadBalance(uint32_t piece_ct, uintptr_t start_idx, uintptr_t end_i
   }
 }
 
+// Returns the largest end_idx <= grand_end_idx such that the rectangular GRM
+// band [start_idx, end_idx) x [0, end_idx) has no more than cells_avail cells.
+// (Returns start_idx if not even one row fits.)
+uintptr_t NextGrmPass(uintptr_t start_idx, uintptr_t grand_end_idx, uintptr_t cells_avail) {
+  if (S_CAST(uint64_t, grand_end_idx - start_idx) * grand_end_idx <= cells_avail) {
+    return grand_end_idx;
+  }
+  // solve (end_idx - start_idx) * end_idx <= cells_avail
+  const double start_d = u63tod(start_idx);
+  uint64_t end_idx = S_CAST(uint64_t, 0.5 * (start_d + sqrt(start_d * start_d + 4 * u63tod(cells_avail))));
+  if (end_idx < start_idx) {
+    end_idx = start_idx;
+  }
+  while ((end_idx - start_idx) * end_idx > cells_avail) {
+    --end_idx;
+  }
+  while ((end_idx + 1 - start_idx) * (end_idx + 1) <= cells_avail) {
+    ++end_idx;
+  }
+  return end_idx;
+}
+
 PglErr KinshipPruneDestructive(uintptr_t* kinship_table, uintptr_t* sample_include, uint32_t* sample_ct_ptr) {
   PglErr reterr = kPglRetSuccess;
   {
@@ -818,7 +843,7 @@ double ComputeKinship(const uint32_t* king_counts_entry) {
 
 // could also return pointer to end?
 void SetKingMatrixFname(KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, char* outname_end) {
-  if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4))) {
+  if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4 | kfKingMatrixSparse))) {
     char* outname_end2 = strcpya(outname_end, ".king");
     const uint32_t output_zst = king_flags & kfKingMatrixZs;
     if (parallel_tot != 1) {
@@ -831,7 +856,7 @@ void SetKingMatrixFname(KingFlags king_flags, uint32_t parallel_idx, uint32_t pa
     *outname_end2 = '\0';
     return;
   }
-  char* outname_end2 = strcpya(outname_end, ".king.bin");
+  char* outname_end2 = strcpya(outname_end, (king_flags & kfKingMatrixSparse)? ".king.sp.bin" : ".king.bin");
   if (parallel_tot != 1) {
     *outname_end2++ = '.';
     outname_end2 = u32toa(parallel_idx + 1, outname_end2);
@@ -852,6 +877,41 @@ void SetKingTableFname(KingFlags king_flags, uint32_t parallel_idx, uint32_t par
   *outname_end2 = '\0';
 }
 
+// 'sparse' matrix output: (row, col, value) triplets covering the lower
+// triangle in row-major order, with 0-based indices into the .id file.
+// Diagonal entries are always present; off-diagonal entries are only written
+// when they're larger than --sparse-cutoff.
+typedef struct SparseMatrixEntryStruct {
+  uint32_t row_idx;
+  uint32_t col_idx;
+  float val;
+} SparseMatrixEntry;
+
+static_assert(sizeof(SparseMatrixEntry) == 12, "SparseMatrixEntry must be 12 bytes.");
+
+// entries are buffered in g_textbuf
+CONSTU31(kSparseMatrixEntryBufSize, kTextbufMainSize / sizeof(SparseMatrixEntry));
+
+BoolErr FlushSparseMatrixEntries(FILE* outfile, SparseMatrixEntry** entry_iterp) {
+  SparseMatrixEntry* entry_buf = R_CAST(SparseMatrixEntry*, g_textbuf);
+  const uintptr_t byte_ct = S_CAST(uintptr_t, (*entry_iterp) - entry_buf) * sizeof(SparseMatrixEntry);
+  *entry_iterp = entry_buf;
+  return byte_ct && fwrite_checked(entry_buf, byte_ct, outfile);
+}
+
+BoolErr AppendSparseMatrixEntry(uint32_t row_idx, uint32_t col_idx, double val, FILE* outfile, SparseMatrixEntry** entry_iterp) {
+  SparseMatrixEntry* entry_iter = *entry_iterp;
+  entry_iter->row_idx = row_idx;
+  entry_iter->col_idx = col_idx;
+  entry_iter->val = S_CAST(float, val);
+  ++entry_iter;
+  *entry_iterp = entry_iter;
+  if (entry_iter == &(R_CAST(SparseMatrixEntry*, g_textbuf)[kSparseMatrixEntryBufSize])) {
+    return FlushSparseMatrixEntries(outfile, entry_iterp);
+  }
+  return 0;
+}
+
 char* AppendKingTableHeader(KingFlags king_flags, uint32_t king_col_fid, uint32_t king_col_sid, char* cswritep) {
   *cswritep++ = '#';
   if (king_flags & kfKingColId) {
@@ -890,7 +950,130 @@ char* AppendKingTableHeader(KingFlags king_flags, uint32_t king_col_fid, uint32_
   return cswritep;
 }
 
-PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, uint32_t raw_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double king_cutoff, double king_table_filter, KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t max_thread_ct, PgenReader* simple_pgrp, uintptr_t* sample_include, uint32_t* sample_ct_ptr, char* outname, char* outname_end) {
+// --checkpoint support.  A checkpoint file consists of a MatrixCkptHeader,
+// followed by the raw accumulator contents (KING counts, or partial GRM sums
+// and the has-missing-call variant bitarray) as of the end of a variant block.
+// All fields other than variants_completed must match for the checkpoint to
+// be considered usable.
+typedef struct MatrixCkptHeaderStruct {
+  char magic[8];
+  uint32_t row_start_idx;
+  uint32_t row_end_idx;
+  uint32_t variant_ct;
+  uint32_t mode;
+  uint32_t input_hash;
+  uint32_t variants_completed;
+  uint64_t payload_byte_ct;
+} MatrixCkptHeader;
+
+// Identifies the genotype file: its size and mtime, plus the record-type and
+// record-offset tables from its header.
+uint32_t HashPgenIdentity(const PgenReader* simple_pgrp) {
+  const PgenFileInfo* pgfip = &(simple_pgrp->fi);
+  const uint32_t raw_variant_ct = pgfip->raw_variant_ct;
+  uint64_t file_id[3];
+  file_id[0] = pgfip->const_fpos_offset;
+  file_id[1] = 0;
+  file_id[2] = 0;
+  struct stat pgen_stat;
+  if (simple_pgrp->ff && (!fstat(fileno(simple_pgrp->ff), &pgen_stat))) {
+    file_id[1] = pgen_stat.st_size;
+    file_id[2] = pgen_stat.st_mtime;
+  }
+  uint32_t pgen_hash = MurmurHash3U32(file_id, sizeof(file_id));
+  if (pgfip->var_fpos) {
+    pgen_hash = pgen_hash * 0x9e3779b1U + MurmurHash3U32(pgfip->var_fpos, (raw_variant_ct + 1) * sizeof(int64_t));
+  }
+  if (pgfip->vrtypes) {
+    pgen_hash = pgen_hash * 0x9e3779b1U + MurmurHash3U32(pgfip->vrtypes, raw_variant_ct);
+  }
+  return pgen_hash;
+}
+
+void InitMatrixCkptHeader(const uintptr_t* sample_include, const uintptr_t* variant_include, const double* allele_freqs, const PgenReader* simple_pgrp, uint32_t raw_sample_ct, uint32_t raw_variant_ct, uintptr_t allele_freq_ct, uint32_t row_start_idx, uint32_t row_end_idx, uint32_t variant_ct, uint32_t mode, uint64_t payload_byte_ct, MatrixCkptHeader* hdrp) {
+  memcpy(hdrp->magic, "plk2ckp1", 8);
+  hdrp->row_start_idx = row_start_idx;
+  hdrp->row_end_idx = row_end_idx;
+  hdrp->variant_ct = variant_ct;
+  hdrp->mode = mode;
+  // The genotype file, sample/variant filters, and (for the GRM) allele
+  // frequencies affect the accumulated values, so a checkpoint is only reused
+  // when they're unchanged.
+  uint32_t input_hash = HashPgenIdentity(simple_pgrp);
+  input_hash = input_hash * 0x9e3779b1U + MurmurHash3U32(sample_include, BitCtToWordCt(raw_sample_ct) * sizeof(intptr_t));
+  input_hash = input_hash * 0x9e3779b1U + MurmurHash3U32(variant_include, BitCtToWordCt(raw_variant_ct) * sizeof(intptr_t));
+  if (allele_freqs) {
+    input_hash = input_hash * 0x9e3779b1U + MurmurHash3U32(allele_freqs, allele_freq_ct * sizeof(double));
+  }
+  hdrp->input_hash = input_hash;
+  hdrp->variants_completed = 0;
+  hdrp->payload_byte_ct = payload_byte_ct;
+}
+
+// {outname}{ext}[.{parallel_idx + 1}].ckpt
+void SetMatrixCkptFname(const char* outname, const char* outname_end, const char* ext, uint32_t parallel_idx, uint32_t parallel_tot, char* ckpt_fname) {
+  char* write_iter = memcpya(ckpt_fname, outname, outname_end - outname);
+  write_iter = strcpya(write_iter, ext);
+  if (parallel_tot != 1) {
+    *write_iter++ = '.';
+    write_iter = u32toa(parallel_idx + 1, write_iter);
+  }
+  strcpy(write_iter, ".ckpt");
+}
+
+// Leaves *variants_completed_ptr at zero, without touching the payload
+// buffers, when there is no usable checkpoint.
+PglErr LoadMatrixCkpt(const char* ckpt_fname, const MatrixCkptHeader* expected_hdrp, uintptr_t payload1_byte_ct, uintptr_t payload2_byte_ct, void* payload1, void* payload2, uint32_t* variants_completed_ptr) {
+  *variants_completed_ptr = 0;
+  FILE* infile = fopen(ckpt_fname, FOPEN_RB);
+  if (!infile) {
+    return kPglRetSuccess;
+  }
+  PglErr reterr = kPglRetSuccess;
+  {
+    MatrixCkptHeader hdr;
+    if (fread_checked(&hdr, sizeof(MatrixCkptHeader), infile) || memcmp(hdr.magic, expected_hdrp->magic, 8) || (hdr.row_start_idx != expected_hdrp->row_start_idx) || (hdr.row_end_idx != expected_hdrp->row_end_idx) || (hdr.variant_ct != expected_hdrp->variant_ct) || (hdr.mode != expected_hdrp->mode) || (hdr.input_hash != expected_hdrp->input_hash) || (hdr.payload_byte_ct != expected_hdrp->payload_byte_ct) || (hdr.variants_completed >= hdr.variant_ct)) {
+      logerrprintfww("Warning: Ignoring %s, since it was not generated by an identical run.\n", ckpt_fname);
+      goto LoadMatrixCkpt_ret_1;
+    }
+    if (fread_checked(payload1, payload1_byte_ct, infile) || (payload2_byte_ct && fread_checked(payload2, payload2_byte_ct, infile))) {
+      logerrprintfww("Error: Failed to read %s .\n", ckpt_fname);
+      reterr = kPglRetReadFail;
+      goto LoadMatrixCkpt_ret_1;
+    }
+    *variants_completed_ptr = hdr.variants_completed;
+    logprintfww("Resuming from %s (%u variant%s already processed).\n", ckpt_fname, hdr.variants_completed, (hdr.variants_completed == 1)? "" : "s");
+  }
+ LoadMatrixCkpt_ret_1:
+  fclose(infile);
+  return reterr;
+}
+
+// Writes to {ckpt_fname}.tmp and then renames, so an interruption in the
+// middle of a checkpoint write never clobbers the previous checkpoint.  The
+// .tmp file is removed on failure.
+BoolErr WriteMatrixCkpt(const char* ckpt_fname, const MatrixCkptHeader* hdrp, const void* payload1, uintptr_t payload1_byte_ct, const void* payload2, uintptr_t payload2_byte_ct) {
+  char tmp_fname[kPglFnamesize + 4];
+  strcpy(strcpya(tmp_fname, ckpt_fname), ".tmp");
+  FILE* outfile = fopen(tmp_fname, FOPEN_WB);
+  if (!outfile) {
+    return 1;
+  }
+  if (fwrite_checked(hdrp, sizeof(MatrixCkptHeader), outfile) ||
+      fwrite_checked(payload1, payload1_byte_ct, outfile) ||
+      fwrite_checked(payload2, payload2_byte_ct, outfile)) {
+    fclose(outfile);
+    remove(tmp_fname);
+    return 1;
+  }
+  if (fclose(outfile) || rename(tmp_fname, ckpt_fname)) {
+    remove(tmp_fname);
+    return 1;
+  }
+  return 0;
+}
+
+PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, uint32_t raw_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double king_cutoff, double king_table_filter, double sparse_cutoff, KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t checkpoint_interval, uint32_t max_thread_ct, PgenReader* simple_pgrp, uintptr_t* sample_include, uint32_t* sample_ct_ptr, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   FILE* outfile = nullptr;
   char* cswritep = nullptr;
@@ -984,7 +1167,7 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
     unsigned char* numbuf = nullptr;
     if (matrix_shape) {
       SetKingMatrixFname(king_flags, parallel_idx, parallel_tot, outname_end);
-      if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4))) {
+      if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4 | kfKingMatrixSparse))) {
         // text matrix
         // won't be >2gb since sample_ct <= 134m
         const uint32_t overflow_buf_size = kCompressStreamBlock + 16 * sample_ct;
@@ -996,7 +1179,8 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
         if (fopen_checked(outname, FOPEN_WB, &outfile)) {
           goto CalcKing_ret_OPEN_FAIL;
         }
-        if (bigstack_alloc_uc(sample_ct * 4 * (2 - ((king_flags / kfKingMatrixBin4) & 1)), &numbuf)) {
+        // sparse output is buffered in g_textbuf instead
+        if ((!(king_flags & kfKingMatrixSparse)) && bigstack_alloc_uc(sample_ct * 4 * (2 - ((king_flags / kfKingMatrixBin4) & 1)), &numbuf)) {
           goto CalcKing_ret_OPEN_FAIL;
         }
       }
@@ -1022,7 +1206,14 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
         goto CalcKing_ret_NOMEM;
       }
     }
+    char* ckpt_fname = nullptr;
+    if (checkpoint_interval) {
+      if (bigstack_alloc_c(kPglFnamesize, &ckpt_fname)) {
+        goto CalcKing_ret_NOMEM;
+      }
+    }
     uint64_t king_table_filter_ct = 0;
+    uint64_t sparse_entry_ct = 0;
     const uintptr_t cells_avail = bigstack_left() / (sizeof(int32_t) * homhom_needed_p4);
     const uint32_t pass_ct = CountTrianglePasses(grand_row_start_idx, grand_row_end_idx, 1, cells_avail);
     if (!pass_ct) {
@@ -1032,6 +1223,18 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
       logerrputs("Insufficient memory for --make-king square output.  Try square0 or triangle\nshape instead.\n");
       goto CalcKing_ret_NOMEM;
     }
+    // Earlier passes' results have already been streamed to the output
+    // file(s), so only the single-pass case is resumable.
+    if ((pass_ct > 1) && ckpt_fname) {
+      logerrprintf("Insufficient memory for %s --checkpoint (which requires the computation\nto fit in a single pass).  Use --parallel to split the job into smaller\npieces.\n", flagname);
+      goto CalcKing_ret_NOMEM;
+    }
+    MatrixCkptHeader ckpt_hdr;
+    if (ckpt_fname) {
+      SetMatrixCkptFname(outname, outname_end, ".king", parallel_idx, parallel_tot, ckpt_fname);
+      const uint64_t ckpt_payload_byte_ct = ((S_CAST(uint64_t, grand_row_end_idx) * (grand_row_end_idx - 1) - S_CAST(uint64_t, grand_row_start_idx) * (grand_row_start_idx - 1)) / 2) * homhom_needed_p4 * sizeof(int32_t);
+      InitMatrixCkptHeader(sample_include, variant_include, nullptr, simple_pgrp, raw_sample_ct, raw_variant_ct, 0, grand_row_start_idx, grand_row_end_idx, variant_ct, homhom_needed_p4, ckpt_payload_byte_ct, &ckpt_hdr);
+    }
     uint32_t row_end_idx = grand_row_start_idx;
     g_king_counts = R_CAST(uint32_t*, g_bigstack_base);
     for (uint32_t pass_idx_p1 = 1; pass_idx_p1 <= pass_ct; ++pass_idx_p1) {
@@ -1057,7 +1260,7 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
         }
       }
       memcpy(cur_sample_include, sample_include, raw_sample_ctl * sizeof(intptr_t));
-      if (row_end_idx != grand_row_end_idx) {
+      if (row_end_idx != sample_ct) {
         uint32_t sample_uidx_end = IdxToUidxBasic(sample_include, row_end_idx);
         ClearBitsNz(sample_uidx_end, raw_sample_ct, cur_sample_include);
       }
@@ -1065,8 +1268,17 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
       if (pass_idx_p1 != 1) {
         ReinitThreads3z(&ts);
       }
-      uint32_t variant_uidx = 0;
       uint32_t variants_completed = 0;
+      time_t next_ckpt_time = 0;
+      if (ckpt_fname) {
+        reterr = LoadMatrixCkpt(ckpt_fname, &ckpt_hdr, tot_cells * homhom_needed_p4 * sizeof(int32_t), 0, g_king_counts, nullptr, &variants_completed);
+        if (reterr) {
+          goto CalcKing_ret_1;
+        }
+        next_ckpt_time = time(nullptr) + checkpoint_interval;
+      }
+      const uint32_t first_variant_idx = variants_completed;
+      uint32_t variant_uidx = variants_completed? IdxToUidxBasic(variant_include, variants_completed) : 0;
       uint32_t parity = 0;
       const uint32_t sample_batch_ct_m1 = (row_end_idx - 1) / kPglBitTransposeBatch;
       // Similar to plink 1.9 --genome.  For each pair of samples S1-S2, we
@@ -1172,15 +1384,24 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
             write_ref2het_iter = &(write_ref2het_iter[kKingMultiplexWords]);
           }
         }
-        if (variants_completed) {
+        if (variants_completed != first_variant_idx) {
           JoinThreads3z(&ts);
           // CalcKingThread() never errors out
+          // g_king_counts[] now covers exactly the first variants_completed
+          // variants.
+          if (ckpt_fname && (time(nullptr) >= next_ckpt_time)) {
+            ckpt_hdr.variants_completed = variants_completed;
+            if (WriteMatrixCkpt(ckpt_fname, &ckpt_hdr, g_king_counts, tot_cells * homhom_needed_p4 * sizeof(int32_t), nullptr, 0)) {
+              goto CalcKing_ret_WRITE_FAIL;
+            }
+            next_ckpt_time = time(nullptr) + checkpoint_interval;
+          }
         } else {
           ts.thread_func_ptr = CalcKingThread;
         }
         // this update must occur after JoinThreads3z() call
         ts.is_last_block = (variants_completed + cur_block_size == variant_ct);
-        if (SpawnThreads3z(variants_completed, &ts)) {
+        if (SpawnThreads3z(variants_completed != first_variant_idx, &ts)) {
           goto CalcKing_ret_THREAD_CREATE_FAIL;
         }
         printf("\r%s pass %u/%u: %u variants complete.", flagname, pass_idx_p1, pass_ct, variants_completed);
@@ -1194,7 +1415,38 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
         fflush(stdout);
         // allow simultaneous --make-king + --make-king-table
         if (matrix_shape) {
-          if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4))) {
+          if (king_flags & kfKingMatrixSparse) {
+            SparseMatrixEntry* entry_iter = R_CAST(SparseMatrixEntry*, g_textbuf);
+            uint32_t* results_iter = g_king_counts;
+            if ((!parallel_idx) && (pass_idx_p1 == 1)) {
+              // first sample's diagonal entry
+              if (AppendSparseMatrixEntry(0, 0, 0.5, outfile, &entry_iter)) {
+                goto CalcKing_ret_WRITE_FAIL;
+              }
+            }
+            for (uint32_t sample_idx1 = row_start_idx; sample_idx1 < row_end_idx; ++sample_idx1) {
+              for (uint32_t sample_idx2 = 0; sample_idx2 < sample_idx1; ++sample_idx2) {
+                const double kinship_coeff = ComputeKinship(results_iter);
+                if (kinship_table && (kinship_coeff > king_cutoff)) {
+                  SetBit(sample_idx2, &(kinship_table[sample_idx1 * sample_ctl]));
+                  SetBit(sample_idx1, &(kinship_table[sample_idx2 * sample_ctl]));
+                }
+                if (kinship_coeff > sparse_cutoff) {
+                  if (AppendSparseMatrixEntry(sample_idx1, sample_idx2, kinship_coeff, outfile, &entry_iter)) {
+                    goto CalcKing_ret_WRITE_FAIL;
+                  }
+                  ++sparse_entry_ct;
+                }
+                results_iter = &(results_iter[homhom_needed_p4]);
+              }
+              if (AppendSparseMatrixEntry(sample_idx1, sample_idx1, 0.5, outfile, &entry_iter)) {
+                goto CalcKing_ret_WRITE_FAIL;
+              }
+            }
+            if (FlushSparseMatrixEntries(outfile, &entry_iter)) {
+              goto CalcKing_ret_WRITE_FAIL;
+            }
+          } else if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4))) {
             const uint32_t is_squarex = king_flags & (kfKingMatrixSq | kfKingMatrixSq0);
             const uint32_t is_square0 = king_flags & kfKingMatrixSq0;
             uint32_t* results_iter = g_king_counts;
@@ -1447,7 +1699,7 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
     logprintf("%s: %u variant%s processed.\n", flagname, variant_ct, (variant_ct == 1)? "" : "s");
     // end-of-loop operations
     if (matrix_shape) {
-      if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4))) {
+      if (!(king_flags & (kfKingMatrixBin | kfKingMatrixBin4 | kfKingMatrixSparse))) {
         if (CswriteCloseNull(&css, cswritep)) {
           goto CalcKing_ret_WRITE_FAIL;
         }
@@ -1472,6 +1724,9 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
       if (reterr) {
         goto CalcKing_ret_1;
       }
+      if (king_flags & kfKingMatrixSparse) {
+        logprintf("--make-king sparse: %" PRIu64 " off-diagonal coefficient%s > %g retained.\n", sparse_entry_ct, (sparse_entry_ct == 1)? "" : "s", sparse_cutoff);
+      }
     }
     if (king_flags & kfKingColAll) {
       if (CswriteCloseNull(&csst, cswritetp)) {
@@ -1502,6 +1757,10 @@ PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, cons
         logprintf("--king-table-filter: %" PRIu64 " relationship%s reported (%" PRIu64 " filtered out).\n", reported_ct, (reported_ct == 1)? "" : "s", king_table_filter_ct);
       }
     }
+    if (ckpt_fname) {
+      // all results are on disk, checkpoint no longer needed
+      unlink(ckpt_fname);
+    }
     if (kinship_table) {
       BigstackReset(sample_include_cumulative_popcounts);
       *sample_ct_ptr = sample_ct;
@@ -2689,7 +2948,7 @@ THREAD_FUNC_DECL CalcDblMissingThread(void* arg) {
   }
 }
 
-PglErr CalcMissingMatrix(const uintptr_t* sample_include, const uint32_t* sample_include_cumulative_popcounts, const uintptr_t* variant_include, uint32_t sample_ct, uint32_t variant_ct, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t row_start_idx, uintptr_t row_end_idx, uint32_t max_thread_ct, PgenReader* simple_pgrp, uint32_t** missing_cts_ptr, uint32_t** missing_dbl_exclude_cts_ptr) {
+PglErr CalcMissingMatrix(const uintptr_t* sample_include, const uint32_t* sample_include_cumulative_popcounts, const uintptr_t* variant_include, uint32_t variant_ct, uint32_t row_start_idx, uintptr_t row_end_idx, uint32_t max_thread_ct, PgenReader* simple_pgrp, uint32_t** missing_cts_ptr, uint32_t** missing_dbl_exclude_cts_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   ThreadsState ts;
   InitThreads3z(&ts);
@@ -2723,9 +2982,7 @@ PglErr CalcMissingMatrix(const uintptr_t* sample_include, const uint32_t* sample
     // note that this g_thread_start[] may have different values than the one
     // computed by CalcGrm(), since calc_thread_ct changes in the MTBLAS and
     // OS X cases.
-    TriangleFill(sample_ct, calc_thread_ct, parallel_idx, parallel_tot, 0, 1, g_thread_start);
-    assert(g_thread_start[0] == row_start_idx);
-    assert(g_thread_start[calc_thread_ct] == row_end_idx);
+    TriangleLoadBalance(calc_thread_ct, row_start_idx, row_end_idx, 0, g_thread_start);
     const uint32_t sample_transpose_batch_ct_m1 = (row_end_idx - 1) / kPglBitTransposeBatch;
 
     uint32_t parity = 0;
@@ -2842,7 +3099,7 @@ PglErr CalcMissingMatrix(const uintptr_t* sample_include, const uint32_t* sample
   return reterr;
 }
 
-PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const double* allele_freqs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, GrmFlags grm_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end, double** grm_ptr) {
+PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const double* allele_freqs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double sparse_cutoff, GrmFlags grm_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t checkpoint_interval, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end, double** grm_ptr) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   FILE* outfile = nullptr;
@@ -2870,568 +3127,692 @@ PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, c
     }
 #endif
     ts.calc_thread_ct = calc_thread_ct;
-    const uintptr_t* sample_include = orig_sample_include;
     const uint32_t raw_sample_ctl = BitCtToWordCt(raw_sample_ct);
-    uint32_t row_start_idx = 0;
-    uintptr_t row_end_idx = sample_ct;
-    uint32_t* thread_start = nullptr;
-    if ((calc_thread_ct != 1) || (parallel_tot != 1)) {
-      // note that grm should be allocated on bottom if no --parallel, since it
-      // may continue to be used after function exit.  So we allocate this on
-      // top.
-      if (bigstack_end_alloc_u32(calc_thread_ct + 1, &thread_start)) {
-        goto CalcGrm_ret_NOMEM;
-      }
-      // slightly different from plink 1.9 since we don't bother to treat the
-      // diagonal as a special case any more.
-      TriangleFill(sample_ct, calc_thread_ct, parallel_idx, parallel_tot, 0, 1, thread_start);
-      row_start_idx = thread_start[0];
-      row_end_idx = thread_start[calc_thread_ct];
-      if (row_end_idx < sample_ct) {
-        // 0
-        // 0 0
-        // 0 0 0
-        // 0 0 0 0
-        // 1 1 1 1 1
-        // 1 1 1 1 1 1
-        // 2 2 2 2 2 2 2
-        // 2 2 2 2 2 2 2 2
-        // If we're computing part 0, we never need to load the last 4 samples;
-        // if part 1, we don't need the last two; etc.
-        uintptr_t* new_sample_include;
-        if (bigstack_alloc_w(raw_sample_ctl, &new_sample_include)) {
-          goto CalcGrm_ret_NOMEM;
-        }
-        const uint32_t sample_uidx_end = 1 + IdxToUidxBasic(orig_sample_include, row_end_idx - 1);
-        memcpy(new_sample_include, orig_sample_include, RoundUpPow2(sample_uidx_end, kBitsPerWord) / CHAR_BIT);
-        ClearBitsNz(sample_uidx_end, raw_sample_ctl * kBitsPerWord, new_sample_include);
-        sample_include = new_sample_include;
-      }
+    // slightly different from plink 1.9 since we don't bother to treat the
+    // diagonal as a special case any more.
+    uint32_t grand_row_start_idx = 0;
+    uint32_t grand_row_end_idx = sample_ct;
+    if (parallel_tot != 1) {
+      ParallelBounds(sample_ct, 0, parallel_idx, parallel_tot, R_CAST(int32_t*, &grand_row_start_idx), R_CAST(int32_t*, &grand_row_end_idx));
     }
-    g_thread_start = thread_start;
-    double* grm;
-    if (bigstack_calloc_d((row_end_idx - row_start_idx) * row_end_idx, &grm)) {
-      goto CalcGrm_ret_NOMEM;
+    // Make this automatically multipass when there's insufficient memory for
+    // the full matrix (or --parallel piece), like CalcKing().  Since grm[]
+    // should be allocated on bottom (it may continue to be used after function
+    // exit when grm_ptr is non-null), everything else which persists across
+    // passes is allocated on top.
+    reterr = ConditionalAllocateNonAutosomalVariants(cip, "GRM construction", raw_variant_ct, &variant_include, &variant_ct);
+    if (reterr) {
+      goto CalcGrm_ret_1;
     }
-    g_pca_sample_ct = row_end_idx;
-    g_grm = grm;
-    const uint32_t row_end_idxl2 = QuaterCtToWordCt(row_end_idx);
-    const uint32_t row_end_idxl = BitCtToWordCt(row_end_idx);
+    const uint32_t grand_row_end_idxl2 = QuaterCtToWordCt(grand_row_end_idx);
+    const uint32_t grand_row_end_idxl = BitCtToWordCt(grand_row_end_idx);
+    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
+    uint32_t* thread_start;
+    uintptr_t* cur_sample_include;
     uint32_t* sample_include_cumulative_popcounts;
     uintptr_t* genovec_buf;
     uintptr_t* dosage_present_buf;
     Dosage* dosage_main_buf;
-    if (bigstack_alloc_u32(raw_sample_ctl, &sample_include_cumulative_popcounts) ||
-        bigstack_alloc_thread(calc_thread_ct, &ts.threads) ||
-        bigstack_alloc_w(row_end_idxl2, &genovec_buf) ||
-        bigstack_alloc_w(row_end_idxl, &dosage_present_buf) ||
-        bigstack_alloc_dosage(row_end_idx, &dosage_main_buf)) {
+    if (bigstack_end_alloc_u32(calc_thread_ct + 1, &thread_start) ||
+        bigstack_end_alloc_w(raw_sample_ctl, &cur_sample_include) ||
+        bigstack_end_alloc_u32(raw_sample_ctl, &sample_include_cumulative_popcounts) ||
+        bigstack_end_alloc_thread(calc_thread_ct, &ts.threads) ||
+        bigstack_end_alloc_w(grand_row_end_idxl2, &genovec_buf) ||
+        bigstack_end_alloc_w(grand_row_end_idxl, &dosage_present_buf) ||
+        bigstack_end_alloc_dosage(grand_row_end_idx, &dosage_main_buf) ||
+        bigstack_end_alloc_d(grand_row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_vmaj_bufs[0]) ||
+        bigstack_end_alloc_d(grand_row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_vmaj_bufs[1])) {
       goto CalcGrm_ret_NOMEM;
     }
-    FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
-    reterr = ConditionalAllocateNonAutosomalVariants(cip, "GRM construction", raw_variant_ct, &variant_include, &variant_ct);
-    if (reterr) {
-      goto CalcGrm_ret_1;
+    uintptr_t* variant_include_has_missing = nullptr;
+    if (!(grm_flags & kfGrmMeanimpute)) {
+      if (bigstack_end_calloc_w(raw_variant_ctl, &variant_include_has_missing)) {
+        goto CalcGrm_ret_NOMEM;
+      }
+    }
+    char* ckpt_fname = nullptr;
+    if (checkpoint_interval) {
+      if (bigstack_end_alloc_c(kPglFnamesize, &ckpt_fname)) {
+        goto CalcGrm_ret_NOMEM;
+      }
     }
-    if (bigstack_alloc_d(row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_vmaj_bufs[0]) ||
-        bigstack_alloc_d(row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_vmaj_bufs[1])) {
+    // Other per-pass allocations: CalcMissingMatrix() workspace (~50 bytes per
+    // sample, plus a transpose buffer), and output buffers.  Square/square0
+    // rows always extend to sample_ct, whatever the band.
+    const uintptr_t overflow_buf_size_max = kCompressStreamBlock + kMaxMediumLine + 16 * S_CAST(uintptr_t, grand_row_end_idx) + 2 * S_CAST(uintptr_t, sample_ct);
+    const uintptr_t smaj_buf_byte_ct = 2 * RoundUpPow2(grand_row_end_idx * kGrmVariantBlockSize * sizeof(double), kCacheline);
+    const uintptr_t pass_reserve = smaj_buf_byte_ct + overflow_buf_size_max + CstreamWkspaceReq(overflow_buf_size_max) + kPglBitTransposeBufbytes + 64 * S_CAST(uintptr_t, grand_row_end_idx) + sample_ct * sizeof(float) + (max_thread_ct + 1) * (sizeof(pthread_t) + sizeof(int32_t)) + 16 * kCacheline;
+    uintptr_t cells_avail = bigstack_left();
+    if (cells_avail < pass_reserve) {
       goto CalcGrm_ret_NOMEM;
     }
-    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
-    uintptr_t* variant_include_has_missing = nullptr;
-    if (!(grm_flags & kfGrmMeanimpute)) {
-      if (bigstack_calloc_w(raw_variant_ctl, &variant_include_has_missing)) {
+    // grm[] band, plus (at most) one missing_dbl_exclude_cts[] entry per cell
+    cells_avail = (cells_avail - pass_reserve) / (sizeof(double) + sizeof(int32_t));
+    uint32_t pass_ct = 0;
+    for (uintptr_t row_idx = grand_row_start_idx; row_idx != grand_row_end_idx; ++pass_ct) {
+      const uintptr_t next_row_idx = NextGrmPass(row_idx, grand_row_end_idx, cells_avail);
+      if (next_row_idx == row_idx) {
         goto CalcGrm_ret_NOMEM;
       }
+      row_idx = next_row_idx;
     }
-    if (thread_start) {
-      if (bigstack_alloc_d(row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_smaj_bufs[0]) ||
-          bigstack_alloc_d(row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_smaj_bufs[1])) {
+    const GrmFlags matrix_shape = grm_flags & kfGrmMatrixShapemask;
+    if (pass_ct > 1) {
+      if (grm_ptr) {
+        logerrputs("Insufficient memory for in-memory GRM (required by --pca).\n");
+        goto CalcGrm_ret_NOMEM;
+      }
+      if (matrix_shape == kfGrmMatrixSq) {
+        logerrputs("Insufficient memory for --make-rel square output.  Try square0 or triangle\nshape instead.\n");
+        goto CalcGrm_ret_NOMEM;
+      }
+      // Earlier passes' results have already been appended to the output
+      // file(s), so only the single-pass case is resumable.
+      if (ckpt_fname) {
+        logerrputs("Insufficient memory for GRM --checkpoint (which requires the computation to\nfit in a single pass).  Use --parallel to split the job into smaller pieces.\n");
+        goto CalcGrm_ret_NOMEM;
+      }
+    }
+    const uint32_t use_part_thread = (calc_thread_ct != 1) || (parallel_tot != 1) || (pass_ct != 1);
+    if (use_part_thread) {
+      if (bigstack_end_alloc_d(grand_row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_smaj_bufs[0]) ||
+          bigstack_end_alloc_d(grand_row_end_idx * kGrmVariantBlockSize, &g_normed_dosage_smaj_bufs[1])) {
         goto CalcGrm_ret_NOMEM;
       }
     }
-#ifdef USE_MTBLAS
-    const uint32_t blas_thread_ct = (max_thread_ct > 2)? (max_thread_ct - 1) : max_thread_ct;
-    BLAS_SET_NUM_THREADS(blas_thread_ct);
-#endif
-    // Main workflow:
-    // 1. Set n=0, load batch 0
-    //
-    // 2. Spawn threads processing batch n
-    // 3. Increment n by 1
-    // 4. Load batch n unless eof
-    // 5. Join threads
-    // 6. Goto step 2 unless eof
     const uint32_t variance_standardize = !(grm_flags & kfGrmCov);
-    uint32_t parity = 0;
-    uint32_t cur_variant_idx_start = 0;
-    uint32_t variant_uidx = 0;
-    uint32_t cur_allele_ct = 2;
-    uint32_t pct = 0;
-    uint32_t next_print_variant_idx = variant_ct / 100;
-    logputs("Constructing GRM: ");
-    fputs("0%", stdout);
-    fflush(stdout);
-    PgrClearLdCache(simple_pgrp);
-    while (1) {
-      uint32_t cur_batch_size = 0;
-      if (!ts.is_last_block) {
-        cur_batch_size = kGrmVariantBlockSize;
-        uint32_t cur_variant_idx_end = cur_variant_idx_start + cur_batch_size;
-        if (cur_variant_idx_end > variant_ct) {
-          cur_batch_size = variant_ct - cur_variant_idx_start;
-          cur_variant_idx_end = variant_ct;
+    unsigned char* pass_bigstack_mark = g_bigstack_base;
+    uint64_t sparse_entry_ct = 0;
+    uintptr_t row_end_idx = grand_row_start_idx;
+    for (uint32_t pass_idx_p1 = 1; pass_idx_p1 <= pass_ct; ++pass_idx_p1) {
+      BigstackReset(pass_bigstack_mark);
+      const uint32_t row_start_idx = row_end_idx;
+      row_end_idx = NextGrmPass(row_start_idx, grand_row_end_idx, cells_avail);
+      double* grm;
+      if (bigstack_calloc_d((row_end_idx - row_start_idx) * row_end_idx, &grm)) {
+        goto CalcGrm_ret_NOMEM;
+      }
+      unsigned char* grm_alloc_end = g_bigstack_base;
+      if (use_part_thread) {
+        TriangleLoadBalance(calc_thread_ct, row_start_idx, row_end_idx, 0, thread_start);
+      }
+      // (CalcMissingMatrix() repoints this)
+      g_thread_start = thread_start;
+      g_pca_sample_ct = row_end_idx;
+      g_grm = grm;
+      // 0
+      // 0 0
+      // 0 0 0
+      // 0 0 0 0
+      // 1 1 1 1 1
+      // 1 1 1 1 1 1
+      // 2 2 2 2 2 2 2
+      // 2 2 2 2 2 2 2 2
+      // If we're computing part 0, we never need to load the last 4 samples;
+      // if part 1, we don't need the last two; etc.
+      const uintptr_t* sample_include = orig_sample_include;
+      if (row_end_idx < sample_ct) {
+        const uint32_t sample_uidx_end = 1 + IdxToUidxBasic(orig_sample_include, row_end_idx - 1);
+        memcpy(cur_sample_include, orig_sample_include, RoundUpPow2(sample_uidx_end, kBitsPerWord) / CHAR_BIT);
+        ClearBitsNz(sample_uidx_end, raw_sample_ctl * kBitsPerWord, cur_sample_include);
+        sample_include = cur_sample_include;
+      }
+      FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
+      if (pass_idx_p1 != 1) {
+        ReinitThreads3z(&ts);
+      }
+      const uintptr_t grm_byte_ct = (row_end_idx - row_start_idx) * row_end_idx * sizeof(double);
+      const uintptr_t has_missing_byte_ct = variant_include_has_missing? (raw_variant_ctl * sizeof(intptr_t)) : 0;
+      MatrixCkptHeader ckpt_hdr;
+      uint32_t first_variant_idx = 0;
+      time_t next_ckpt_time = 0;
+      if (ckpt_fname) {
+        SetMatrixCkptFname(outname, outname_end, ".grm", parallel_idx, parallel_tot, ckpt_fname);
+        const uintptr_t allele_freq_ct = variant_allele_idxs? (variant_allele_idxs[raw_variant_ct] - raw_variant_ct) : raw_variant_ct;
+        InitMatrixCkptHeader(sample_include, variant_include, allele_freqs, simple_pgrp, raw_sample_ct, raw_variant_ct, allele_freq_ct, row_start_idx, row_end_idx, variant_ct, variance_standardize | (2 * (variant_include_has_missing == nullptr)), grm_byte_ct + has_missing_byte_ct, &ckpt_hdr);
+        reterr = LoadMatrixCkpt(ckpt_fname, &ckpt_hdr, grm_byte_ct, has_missing_byte_ct, grm, variant_include_has_missing, &first_variant_idx);
+        if (reterr) {
+          goto CalcGrm_ret_1;
         }
-        double* normed_vmaj_iter = g_normed_dosage_vmaj_bufs[parity];
-        for (uint32_t variant_idx = cur_variant_idx_start; variant_idx < cur_variant_idx_end; ++variant_uidx, ++variant_idx) {
-          MovU32To1Bit(variant_include, &variant_uidx);
-          const uint32_t maj_allele_idx = maj_alleles[variant_uidx];
-          uint32_t missing_present = 0;
-          uintptr_t allele_idx_base;
-          if (!variant_allele_idxs) {
-            allele_idx_base = variant_uidx;
-          } else {
-            allele_idx_base = variant_allele_idxs[variant_uidx];
-            cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - allele_idx_base;
-            allele_idx_base -= variant_uidx;
+        next_ckpt_time = time(nullptr) + checkpoint_interval;
+      }
+#ifdef USE_MTBLAS
+      const uint32_t blas_thread_ct = (max_thread_ct > 2)? (max_thread_ct - 1) : max_thread_ct;
+      BLAS_SET_NUM_THREADS(blas_thread_ct);
+#endif
+      // Main workflow:
+      // 1. Set n=0, load batch 0
+      //
+      // 2. Spawn threads processing batch n
+      // 3. Increment n by 1
+      // 4. Load batch n unless eof
+      // 5. Join threads
+      // 6. Goto step 2 unless eof
+      uint32_t parity = 0;
+      uint32_t cur_variant_idx_start = first_variant_idx;
+      uint32_t variant_uidx = first_variant_idx? IdxToUidxBasic(variant_include, first_variant_idx) : 0;
+      uint32_t cur_allele_ct = 2;
+      uint32_t pct = 0;
+      uint32_t next_print_variant_idx = variant_ct / 100;
+      if (pass_ct == 1) {
+        logputs("Constructing GRM: ");
+      } else {
+        logprintf("Constructing GRM (pass %u/%u): ", pass_idx_p1, pass_ct);
+      }
+      fputs("0%", stdout);
+      fflush(stdout);
+      PgrClearLdCache(simple_pgrp);
+      while (1) {
+        uint32_t cur_batch_size = 0;
+        if (!ts.is_last_block) {
+          cur_batch_size = kGrmVariantBlockSize;
+          uint32_t cur_variant_idx_end = cur_variant_idx_start + cur_batch_size;
+          if (cur_variant_idx_end > variant_ct) {
+            cur_batch_size = variant_ct - cur_variant_idx_start;
+            cur_variant_idx_end = variant_ct;
           }
-          reterr = LoadCenteredVarmaj(sample_include, sample_include_cumulative_popcounts, variance_standardize, row_end_idx, variant_uidx, maj_allele_idx, GetAlleleFreq(&(allele_freqs[allele_idx_base]), maj_allele_idx, cur_allele_ct), simple_pgrp, variant_include_has_missing? (&missing_present) : nullptr, normed_vmaj_iter, genovec_buf, dosage_present_buf, dosage_main_buf);
-          if (reterr) {
-            if (reterr == kPglRetInconsistentInput) {
-              logputs("\n");
-              logerrputs("Error: Zero-MAF variant is not actually monomorphic.  (This is possible when\ne.g. MAF is estimated from founders, but the minor allele was only observed in\nnonfounders.  In any case, you should be using e.g. --maf to filter out all\nvery-low-MAF variants, since the relationship matrix distance formula does not\nhandle them well.)\n");
-            } else if (reterr == kPglRetMalformedInput) {
-              logputs("\n");
-              logerrputs("Error: Malformed .pgen file.\n");
+          double* normed_vmaj_iter = g_normed_dosage_vmaj_bufs[parity];
+          for (uint32_t variant_idx = cur_variant_idx_start; variant_idx < cur_variant_idx_end; ++variant_uidx, ++variant_idx) {
+            MovU32To1Bit(variant_include, &variant_uidx);
+            const uint32_t maj_allele_idx = maj_alleles[variant_uidx];
+            uint32_t missing_present = 0;
+            uintptr_t allele_idx_base;
+            if (!variant_allele_idxs) {
+              allele_idx_base = variant_uidx;
+            } else {
+              allele_idx_base = variant_allele_idxs[variant_uidx];
+              cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - allele_idx_base;
+              allele_idx_base -= variant_uidx;
             }
-            goto CalcGrm_ret_1;
+            reterr = LoadCenteredVarmaj(sample_include, sample_include_cumulative_popcounts, variance_standardize, row_end_idx, variant_uidx, maj_allele_idx, GetAlleleFreq(&(allele_freqs[allele_idx_base]), maj_allele_idx, cur_allele_ct), simple_pgrp, variant_include_has_missing? (&missing_present) : nullptr, normed_vmaj_iter, genovec_buf, dosage_present_buf, dosage_main_buf);
+            if (reterr) {
+              if (reterr == kPglRetInconsistentInput) {
+                logputs("\n");
+                logerrputs("Error: Zero-MAF variant is not actually monomorphic.  (This is possible when\ne.g. MAF is estimated from founders, but the minor allele was only observed in\nnonfounders.  In any case, you should be using e.g. --maf to filter out all\nvery-low-MAF variants, since the relationship matrix distance formula does not\nhandle them well.)\n");
+              } else if (reterr == kPglRetMalformedInput) {
+                logputs("\n");
+                logerrputs("Error: Malformed .pgen file.\n");
+              }
+              goto CalcGrm_ret_1;
+            }
+            if (missing_present) {
+              SetBit(variant_uidx, variant_include_has_missing);
+            }
+            normed_vmaj_iter = &(normed_vmaj_iter[row_end_idx]);
           }
-          if (missing_present) {
-            SetBit(variant_uidx, variant_include_has_missing);
+          if (use_part_thread) {
+            MatrixTransposeCopy(g_normed_dosage_vmaj_bufs[parity], cur_batch_size, row_end_idx, g_normed_dosage_smaj_bufs[parity]);
           }
-          normed_vmaj_iter = &(normed_vmaj_iter[row_end_idx]);
-        }
-        if (thread_start) {
-          MatrixTransposeCopy(g_normed_dosage_vmaj_bufs[parity], cur_batch_size, row_end_idx, g_normed_dosage_smaj_bufs[parity]);
         }
-      }
-      if (cur_variant_idx_start) {
-        JoinThreads3z(&ts);
-        // CalcGrmPartThread() and CalcGrmThread() never error out
-        if (ts.is_last_block) {
-          break;
+        if (cur_variant_idx_start != first_variant_idx) {
+          JoinThreads3z(&ts);
+          // CalcGrmPartThread() and CalcGrmThread() never error out
+          if (ts.is_last_block) {
+            break;
+          }
+          // grm[] now covers exactly the first cur_variant_idx_start variants.
+          // (variant_include_has_missing may also have bits set for the batch
+          // we just loaded; that's harmless since they'll be set again on
+          // resume.)
+          if (ckpt_fname && (time(nullptr) >= next_ckpt_time)) {
+            ckpt_hdr.variants_completed = cur_variant_idx_start;
+            if (WriteMatrixCkpt(ckpt_fname, &ckpt_hdr, grm, grm_byte_ct, variant_include_has_missing, has_missing_byte_ct)) {
+              goto CalcGrm_ret_WRITE_FAIL;
+            }
+            next_ckpt_time = time(nullptr) + checkpoint_interval;
+          }
+          if (cur_variant_idx_start >= next_print_variant_idx) {
+            if (pct > 10) {
+              putc_unlocked('\b', stdout);
+            }
+            pct = (cur_variant_idx_start * 100LLU) / variant_ct;
+            printf("\b\b%u%%", pct++);
+            fflush(stdout);
+            next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+          }
         }
-        if (cur_variant_idx_start >= next_print_variant_idx) {
-          if (pct > 10) {
-            putc_unlocked('\b', stdout);
+        ts.is_last_block = (cur_variant_idx_start + cur_batch_size == variant_ct);
+        g_cur_batch_size = cur_batch_size;
+        if (!ts.thread_func_ptr) {
+          if (use_part_thread) {
+            ts.thread_func_ptr = CalcGrmPartThread;
+          } else {
+            ts.thread_func_ptr = CalcGrmThread;
           }
-          pct = (cur_variant_idx_start * 100LLU) / variant_ct;
-          printf("\b\b%u%%", pct++);
-          fflush(stdout);
-          next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
         }
-      }
-      ts.is_last_block = (cur_variant_idx_start + cur_batch_size == variant_ct);
-      g_cur_batch_size = cur_batch_size;
-      if (!ts.thread_func_ptr) {
-        if (thread_start) {
-          ts.thread_func_ptr = CalcGrmPartThread;
-        } else {
-          ts.thread_func_ptr = CalcGrmThread;
+        if (SpawnThreads3z(cur_variant_idx_start != first_variant_idx, &ts)) {
+          goto CalcGrm_ret_THREAD_CREATE_FAIL;
         }
+        cur_variant_idx_start += cur_batch_size;
+        parity = 1 - parity;
       }
-      if (SpawnThreads3z(cur_variant_idx_start, &ts)) {
-        goto CalcGrm_ret_THREAD_CREATE_FAIL;
+      BLAS_SET_NUM_THREADS(1);
+      if (pct > 10) {
+        putc_unlocked('\b', stdout);
       }
-      cur_variant_idx_start += cur_batch_size;
-      parity = 1 - parity;
-    }
-    BLAS_SET_NUM_THREADS(1);
-    if (pct > 10) {
-      putc_unlocked('\b', stdout);
-    }
-    fputs("\b\b", stdout);
-    logputs("done.\n");
-    uint32_t* missing_cts = nullptr;  // stays null iff meanimpute
-    uint32_t* missing_dbl_exclude_cts = nullptr;
-    if (variant_include_has_missing) {
-      const uint32_t variant_ct_with_missing = PopcountWords(variant_include_has_missing, raw_variant_ctl);
-      // if no missing calls at all, act as if meanimpute was on
-      if (variant_ct_with_missing) {
-        logputs("Correcting for missingness... ");
-        reterr = CalcMissingMatrix(sample_include, sample_include_cumulative_popcounts, variant_include_has_missing, sample_ct, variant_ct_with_missing, parallel_idx, parallel_tot, row_start_idx, row_end_idx, max_thread_ct, simple_pgrp, &missing_cts, &missing_dbl_exclude_cts);
-        if (reterr) {
-          goto CalcGrm_ret_1;
+      fputs("\b\b", stdout);
+      logputs("done.\n");
+      uint32_t* missing_cts = nullptr;  // stays null iff meanimpute
+      uint32_t* missing_dbl_exclude_cts = nullptr;
+      if (variant_include_has_missing) {
+        const uint32_t variant_ct_with_missing = PopcountWords(variant_include_has_missing, raw_variant_ctl);
+        // if no missing calls at all, act as if meanimpute was on
+        if (variant_ct_with_missing) {
+          logputs("Correcting for missingness... ");
+          reterr = CalcMissingMatrix(sample_include, sample_include_cumulative_popcounts, variant_include_has_missing, variant_ct_with_missing, row_start_idx, row_end_idx, max_thread_ct, simple_pgrp, &missing_cts, &missing_dbl_exclude_cts);
+          if (reterr) {
+            goto CalcGrm_ret_1;
+          }
         }
       }
-    }
-    if (missing_cts) {
-      // could parallelize this loop if it ever matters
-      const uint32_t* missing_dbl_exclude_iter = missing_dbl_exclude_cts;
-      for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
-        const uint32_t variant_ct_base = variant_ct - missing_cts[row_idx];
-        double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-        for (uint32_t col_idx = 0; col_idx < row_idx; ++col_idx) {
-          *grm_iter++ /= u31tod(variant_ct_base - missing_cts[col_idx] + (*missing_dbl_exclude_iter++));
+      if (missing_cts) {
+        // could parallelize this loop if it ever matters
+        const uint32_t* missing_dbl_exclude_iter = missing_dbl_exclude_cts;
+        for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+          const uint32_t variant_ct_base = variant_ct - missing_cts[row_idx];
+          double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+          for (uint32_t col_idx = 0; col_idx < row_idx; ++col_idx) {
+            *grm_iter++ /= u31tod(variant_ct_base - missing_cts[col_idx] + (*missing_dbl_exclude_iter++));
+          }
+          *grm_iter++ /= u31tod(variant_ct_base);
         }
-        *grm_iter++ /= u31tod(variant_ct_base);
-      }
-    } else {
-      const double variant_ct_recip = 1.0 / u31tod(variant_ct);
-      for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
-        double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-        for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
-          *grm_iter++ *= variant_ct_recip;
+      } else {
+        const double variant_ct_recip = 1.0 / u31tod(variant_ct);
+        for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+          double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+          for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
+            *grm_iter++ *= variant_ct_recip;
+          }
         }
       }
-    }
-    // N.B. Only the lower right of grm[] is valid when parallel_tot == 1.
+      // N.B. Only the lower right of grm[] is valid when parallel_tot == 1.
 
-    // possible todo: allow simultaneous --make-rel and
-    // --make-grm-list/--make-grm-bin
-    // (note that this routine may also be called by --pca, which may not write
-    // a matrix to disk at all.)
-    if (grm_flags & (kfGrmMatrixShapemask | kfGrmListmask | kfGrmBin)) {
-      const GrmFlags matrix_shape = grm_flags & kfGrmMatrixShapemask;
-      char* log_write_iter;
-      if (matrix_shape) {
-        // --make-rel
-        fputs("--make-rel: Writing...", stdout);
-        fflush(stdout);
-        if (grm_flags & kfGrmMatrixBin) {
-          char* outname_end2 = strcpya(outname_end, ".rel.bin");
-          if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          *outname_end2 = '\0';
-          if (fopen_checked(outname, FOPEN_WB, &outfile)) {
-            goto CalcGrm_ret_OPEN_FAIL;
-          }
-          double* write_double_buf = nullptr;
-          if (matrix_shape == kfGrmMatrixSq0) {
-            write_double_buf = R_CAST(double*, g_textbuf);
-            ZeroDArr(kTextbufMainSize / sizeof(double), write_double_buf);
-          } else if (matrix_shape == kfGrmMatrixSq) {
-            if (bigstack_alloc_d(row_end_idx - row_start_idx - 1, &write_double_buf)) {
-              goto CalcGrm_ret_NOMEM;
+      // possible todo: allow simultaneous --make-rel and
+      // --make-grm-list/--make-grm-bin
+      // (note that this routine may also be called by --pca, which may not
+      // write a matrix to disk at all.)
+      if (grm_flags & (kfGrmMatrixShapemask | kfGrmListmask | kfGrmBin)) {
+        // passes after the first append to the files opened by the first
+        const uint32_t is_append = (pass_idx_p1 != 1);
+        const char* fopen_mode = is_append? FOPEN_AB : FOPEN_WB;
+        char* log_write_iter;
+        if (matrix_shape) {
+          // --make-rel
+          fputs("--make-rel: Writing...", stdout);
+          fflush(stdout);
+          if (grm_flags & kfGrmMatrixSparse) {
+            char* outname_end2 = strcpya(outname_end, ".rel.sp.bin");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
             }
-          }
-          uintptr_t row_idx = row_start_idx;
-          while (1) {
-            const double* grm_row = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-            ++row_idx;
-            if (fwrite_checked(grm_row, row_idx * sizeof(double), outfile)) {
+            *outname_end2 = '\0';
+            if (fopen_checked(outname, fopen_mode, &outfile)) {
+              goto CalcGrm_ret_OPEN_FAIL;
+            }
+            SparseMatrixEntry* entry_iter = R_CAST(SparseMatrixEntry*, g_textbuf);
+            for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+              const double* grm_row = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              for (uint32_t col_idx = 0; col_idx < row_idx; ++col_idx) {
+                const double cur_val = grm_row[col_idx];
+                if (cur_val > sparse_cutoff) {
+                  if (AppendSparseMatrixEntry(row_idx, col_idx, cur_val, outfile, &entry_iter)) {
+                    goto CalcGrm_ret_WRITE_FAIL;
+                  }
+                  ++sparse_entry_ct;
+                }
+              }
+              if (AppendSparseMatrixEntry(row_idx, row_idx, grm_row[row_idx], outfile, &entry_iter)) {
+                goto CalcGrm_ret_WRITE_FAIL;
+              }
+            }
+            if (FlushSparseMatrixEntries(outfile, &entry_iter) ||
+                fclose_null(&outfile)) {
               goto CalcGrm_ret_WRITE_FAIL;
             }
-            if (row_idx == row_end_idx) {
-              break;
+          } else if (grm_flags & kfGrmMatrixBin) {
+            char* outname_end2 = strcpya(outname_end, ".rel.bin");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
+            }
+            *outname_end2 = '\0';
+            if (fopen_checked(outname, fopen_mode, &outfile)) {
+              goto CalcGrm_ret_OPEN_FAIL;
             }
+            double* write_double_buf = nullptr;
             if (matrix_shape == kfGrmMatrixSq0) {
-              uintptr_t zbytes_to_dump = (sample_ct - row_idx) * sizeof(double);
-              while (zbytes_to_dump >= kTextbufMainSize) {
-                if (fwrite_checked(write_double_buf, kTextbufMainSize, outfile)) {
-                  goto CalcGrm_ret_WRITE_FAIL;
+              write_double_buf = R_CAST(double*, g_textbuf);
+              ZeroDArr(kTextbufMainSize / sizeof(double), write_double_buf);
+            } else if (matrix_shape == kfGrmMatrixSq) {
+              if (bigstack_alloc_d(row_end_idx - row_start_idx - 1, &write_double_buf)) {
+                goto CalcGrm_ret_NOMEM;
+              }
+            }
+            uintptr_t row_idx = row_start_idx;
+            while (1) {
+              const double* grm_row = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              ++row_idx;
+              if (fwrite_checked(grm_row, row_idx * sizeof(double), outfile)) {
+                goto CalcGrm_ret_WRITE_FAIL;
+              }
+              if (matrix_shape == kfGrmMatrixSq0) {
+                uintptr_t zbytes_to_dump = (sample_ct - row_idx) * sizeof(double);
+                while (zbytes_to_dump >= kTextbufMainSize) {
+                  if (fwrite_checked(write_double_buf, kTextbufMainSize, outfile)) {
+                    goto CalcGrm_ret_WRITE_FAIL;
+                  }
+                  zbytes_to_dump -= kTextbufMainSize;
+                }
+                if (zbytes_to_dump) {
+                  if (fwrite_checked(write_double_buf, zbytes_to_dump, outfile)) {
+                    goto CalcGrm_ret_WRITE_FAIL;
+                  }
                 }
-                zbytes_to_dump -= kTextbufMainSize;
               }
-              if (zbytes_to_dump) {
-                if (fwrite_checked(write_double_buf, zbytes_to_dump, outfile)) {
+              if (row_idx == row_end_idx) {
+                break;
+              }
+              if (matrix_shape == kfGrmMatrixSq) {
+                double* write_double_iter = write_double_buf;
+                const double* grm_col = &(grm[row_idx - 1]);
+                for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
+                  *write_double_iter++ = grm_col[(row_idx2 - row_start_idx) * sample_ct];
+                }
+                if (fwrite_checked(write_double_buf, (sample_ct - row_idx) * sizeof(double), outfile)) {
                   goto CalcGrm_ret_WRITE_FAIL;
                 }
               }
-            } else if (matrix_shape == kfGrmMatrixSq) {
-              double* write_double_iter = write_double_buf;
-              const double* grm_col = &(grm[row_idx - 1]);
-              for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
-                *write_double_iter++ = grm_col[(row_idx2 - row_start_idx) * sample_ct];
+            }
+            if (fclose_null(&outfile)) {
+              goto CalcGrm_ret_WRITE_FAIL;
+            }
+          } else if (grm_flags & kfGrmMatrixBin4) {
+            // downcode all entries to floats
+            char* outname_end2 = strcpya(outname_end, ".rel.bin");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
+            }
+            *outname_end2 = '\0';
+            if (fopen_checked(outname, fopen_mode, &outfile)) {
+              goto CalcGrm_ret_OPEN_FAIL;
+            }
+            float* write_float_buf;
+            if (bigstack_alloc_f(sample_ct, &write_float_buf)) {
+              goto CalcGrm_ret_NOMEM;
+            }
+            uintptr_t row_idx = row_start_idx;
+            do {
+              const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              float* write_float_iter = write_float_buf;
+              for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
+                *write_float_iter++ = S_CAST(float, *grm_iter++);
+              }
+              ++row_idx;
+              if (matrix_shape == kfGrmMatrixSq0) {
+                ZeroFArr(sample_ct - row_idx, write_float_iter);
+                write_float_iter = &(write_float_buf[sample_ct]);
+              } else if (matrix_shape == kfGrmMatrixSq) {
+                const double* grm_col = &(grm[row_idx - 1]);
+                for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
+                  *write_float_iter++ = S_CAST(float, grm_col[(row_idx2 - row_start_idx) * sample_ct]);
+                }
               }
-              if (fwrite_checked(write_double_buf, (sample_ct - row_idx) * sizeof(double), outfile)) {
+              if (fwrite_checked(write_float_buf, sizeof(float) * S_CAST(uintptr_t, write_float_iter - write_float_buf), outfile)) {
                 goto CalcGrm_ret_WRITE_FAIL;
               }
+            } while (row_idx < row_end_idx);
+            if (fclose_null(&outfile)) {
+              goto CalcGrm_ret_WRITE_FAIL;
             }
-          }
-          if (fclose_null(&outfile)) {
-            goto CalcGrm_ret_WRITE_FAIL;
-          }
-        } else if (grm_flags & kfGrmMatrixBin4) {
-          // downcode all entries to floats
-          char* outname_end2 = strcpya(outname_end, ".rel.bin");
-          if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          *outname_end2 = '\0';
-          if (fopen_checked(outname, FOPEN_WB, &outfile)) {
-            goto CalcGrm_ret_OPEN_FAIL;
-          }
-          float* write_float_buf;
-          if (bigstack_alloc_f(row_end_idx, &write_float_buf)) {
-            goto CalcGrm_ret_NOMEM;
-          }
-          uintptr_t row_idx = row_start_idx;
-          do {
-            const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-            float* write_float_iter = write_float_buf;
-            for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
-              *write_float_iter++ = S_CAST(float, *grm_iter++);
-            }
-            ++row_idx;
-            if (matrix_shape == kfGrmMatrixSq0) {
-              ZeroFArr(sample_ct - row_idx, write_float_iter);
-              write_float_iter = &(write_float_buf[sample_ct]);
-            } else if (matrix_shape == kfGrmMatrixSq) {
-              const double* grm_col = &(grm[row_idx - 1]);
-              for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
-                *write_float_iter++ = S_CAST(float, grm_col[(row_idx2 - row_start_idx) * sample_ct]);
-              }
+          } else {
+            char* outname_end2 = strcpya(outname_end, ".rel");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
             }
-            if (fwrite_checked(write_float_buf, sizeof(float) * S_CAST(uintptr_t, write_float_iter - write_float_buf), outfile)) {
-              goto CalcGrm_ret_WRITE_FAIL;
+            const uint32_t output_zst = (grm_flags / kfGrmMatrixZs) & 1;
+            if (output_zst) {
+              outname_end2 = strcpya(outname_end2, ".zst");
             }
-          } while (row_idx < row_end_idx);
-          if (fclose_null(&outfile)) {
-            goto CalcGrm_ret_WRITE_FAIL;
-          }
-        } else {
-          char* outname_end2 = strcpya(outname_end, ".rel");
-          if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          const uint32_t output_zst = (grm_flags / kfGrmMatrixZs) & 1;
-          if (output_zst) {
-            outname_end2 = strcpya(outname_end2, ".zst");
-          }
-          *outname_end2 = '\0';
-          reterr = InitCstreamAlloc(outname, 0, output_zst, max_thread_ct, kCompressStreamBlock + 16 * row_end_idx, &css, &cswritep);
-          if (reterr) {
-            goto CalcGrm_ret_1;
-          }
-          uintptr_t row_idx = row_start_idx;
-          do {
-            const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-            ++row_idx;
-            for (uint32_t col_idx = 0; col_idx < row_idx; ++col_idx) {
-              cswritep = dtoa_g(*grm_iter++, cswritep);
-              *cswritep++ = '\t';
+            *outname_end2 = '\0';
+            reterr = InitCstreamAlloc(outname, is_append, output_zst, max_thread_ct, kCompressStreamBlock + 16 * row_end_idx + 2 * sample_ct, &css, &cswritep);
+            if (reterr) {
+              goto CalcGrm_ret_1;
             }
-            if (matrix_shape == kfGrmMatrixSq0) {
-              // (roughly same performance as creating a zero-tab constant
-              // buffer in advance)
-              const uint32_t zcount = sample_ct - row_idx;
-              const uint32_t wct = DivUp(zcount, kBytesPerWord / 2);
-              // assumes little-endian
-              const uintptr_t zerotab_word = 0x930 * kMask0001;
+            uintptr_t row_idx = row_start_idx;
+            do {
+              const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              ++row_idx;
+              for (uint32_t col_idx = 0; col_idx < row_idx; ++col_idx) {
+                cswritep = dtoa_g(*grm_iter++, cswritep);
+                *cswritep++ = '\t';
+              }
+              if (matrix_shape == kfGrmMatrixSq0) {
+                // (roughly same performance as creating a zero-tab constant
+                // buffer in advance)
+                const uint32_t zcount = sample_ct - row_idx;
+                const uint32_t wct = DivUp(zcount, kBytesPerWord / 2);
+                // assumes little-endian
+                const uintptr_t zerotab_word = 0x930 * kMask0001;
 #ifdef __arm__
 #  error "Unaligned accesses in CalcGrm()."
 #endif
-              uintptr_t* writep_alias = R_CAST(uintptr_t*, cswritep);
-              for (uintptr_t widx = 0; widx < wct; ++widx) {
-                *writep_alias++ = zerotab_word;
+                uintptr_t* writep_alias = R_CAST(uintptr_t*, cswritep);
+                for (uintptr_t widx = 0; widx < wct; ++widx) {
+                  *writep_alias++ = zerotab_word;
+                }
+                cswritep = &(cswritep[zcount * 2]);
+              } else if (matrix_shape == kfGrmMatrixSq) {
+                const double* grm_col = &(grm[row_idx - 1]);
+                for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
+                  cswritep = dtoa_g(grm_col[(row_idx2 - row_start_idx) * sample_ct], cswritep);
+                  *cswritep++ = '\t';
+                }
               }
-              cswritep = &(cswritep[zcount * 2]);
-            } else if (matrix_shape == kfGrmMatrixSq) {
-              const double* grm_col = &(grm[row_idx - 1]);
-              for (uintptr_t row_idx2 = row_idx; row_idx2 < sample_ct; ++row_idx2) {
-                cswritep = dtoa_g(grm_col[(row_idx2 - row_start_idx) * sample_ct], cswritep);
-                *cswritep++ = '\t';
+              DecrAppendBinaryEoln(&cswritep);
+              if (Cswrite(&css, &cswritep)) {
+                goto CalcGrm_ret_WRITE_FAIL;
               }
-            }
-            DecrAppendBinaryEoln(&cswritep);
-            if (Cswrite(&css, &cswritep)) {
+            } while (row_idx < row_end_idx);
+            if (CswriteCloseNull(&css, cswritep)) {
               goto CalcGrm_ret_WRITE_FAIL;
             }
-          } while (row_idx < row_end_idx);
-          if (CswriteCloseNull(&css, cswritep)) {
-            goto CalcGrm_ret_WRITE_FAIL;
-          }
-        }
-        putc_unlocked('\r', stdout);
-        log_write_iter = strcpya(g_logbuf, "--make-rel: GRM ");
-        if (parallel_tot != 1) {
-          log_write_iter = strcpya(log_write_iter, "component ");
-        }
-        log_write_iter = strcpya(log_write_iter, "written to ");
-        log_write_iter = strcpya(log_write_iter, outname);
-      } else {
-        const uint32_t* missing_dbl_exclude_iter = missing_dbl_exclude_cts;
-        if (grm_flags & kfGrmBin) {
-          // --make-grm-bin
-          float* write_float_buf;
-          if (bigstack_alloc_f(row_end_idx, &write_float_buf)) {
-            goto CalcGrm_ret_NOMEM;
           }
-          char* outname_end2 = strcpya(outname_end, ".grm.bin");
+          putc_unlocked('\r', stdout);
+          log_write_iter = strcpya(g_logbuf, "--make-rel: GRM ");
           if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          *outname_end2 = '\0';
-          if (fopen_checked(outname, FOPEN_WB, &outfile)) {
-            goto CalcGrm_ret_OPEN_FAIL;
+            log_write_iter = strcpya(log_write_iter, "component ");
           }
-          fputs("--make-grm-bin: Writing...", stdout);
-          fflush(stdout);
-          for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
-            const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-            for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
-              write_float_buf[col_idx] = S_CAST(float, *grm_iter++);
+          log_write_iter = strcpya(log_write_iter, "written to ");
+          log_write_iter = strcpya(log_write_iter, outname);
+        } else {
+          const uint32_t* missing_dbl_exclude_iter = missing_dbl_exclude_cts;
+          if (grm_flags & kfGrmBin) {
+            // --make-grm-bin
+            float* write_float_buf;
+            if (bigstack_alloc_f(row_end_idx, &write_float_buf)) {
+              goto CalcGrm_ret_NOMEM;
             }
-            if (fwrite_checked(write_float_buf, (row_idx + 1) * sizeof(float), outfile)) {
-              goto CalcGrm_ret_WRITE_FAIL;
+            char* outname_end2 = strcpya(outname_end, ".grm.bin");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
             }
-          }
-          if (fclose_null(&outfile)) {
-            goto CalcGrm_ret_WRITE_FAIL;
-          }
-
-          outname_end2 = strcpya(outname_end, ".grm.N.bin");
-          if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          *outname_end2 = '\0';
-          if (fopen_checked(outname, FOPEN_WB, &outfile)) {
-            goto CalcGrm_ret_OPEN_FAIL;
-          }
-          if (!missing_cts) {
-            // trivial case: write the same number repeatedly
-            const uintptr_t tot_cells = (S_CAST(uint64_t, row_end_idx) * (row_end_idx - 1) - S_CAST(uint64_t, row_start_idx) * (row_start_idx - 1)) / 2;
-            const float variant_ctf = u31tof(variant_ct);
-            write_float_buf = R_CAST(float*, g_textbuf);
-            for (uint32_t uii = 0; uii < (kTextbufMainSize / sizeof(float)); ++uii) {
-              write_float_buf[uii] = variant_ctf;
+            *outname_end2 = '\0';
+            if (fopen_checked(outname, fopen_mode, &outfile)) {
+              goto CalcGrm_ret_OPEN_FAIL;
             }
-            const uintptr_t full_write_ct = tot_cells / (kTextbufMainSize / sizeof(float));
-            for (uintptr_t ulii = 0; ulii < full_write_ct; ++ulii) {
-              if (fwrite_checked(write_float_buf, kTextbufMainSize, outfile)) {
-                goto CalcGrm_ret_WRITE_FAIL;
+            fputs("--make-grm-bin: Writing...", stdout);
+            fflush(stdout);
+            for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+              const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
+                write_float_buf[col_idx] = S_CAST(float, *grm_iter++);
               }
-            }
-            const uintptr_t remainder = tot_cells % (kTextbufMainSize / sizeof(float));
-            if (remainder) {
-              if (fwrite_checked(write_float_buf, remainder * sizeof(float), outfile)) {
+              if (fwrite_checked(write_float_buf, (row_idx + 1) * sizeof(float), outfile)) {
                 goto CalcGrm_ret_WRITE_FAIL;
               }
             }
-          } else {
-            for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
-              const uint32_t variant_ct_base = variant_ct - missing_cts[row_idx];
-              for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
-                uint32_t cur_obs_ct = variant_ct_base;
-                if (col_idx != row_idx) {
-                  cur_obs_ct = cur_obs_ct - missing_cts[col_idx] + (*missing_dbl_exclude_iter++);
+            if (fclose_null(&outfile)) {
+              goto CalcGrm_ret_WRITE_FAIL;
+            }
+
+            outname_end2 = strcpya(outname_end, ".grm.N.bin");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
+            }
+            *outname_end2 = '\0';
+            if (fopen_checked(outname, fopen_mode, &outfile)) {
+              goto CalcGrm_ret_OPEN_FAIL;
+            }
+            if (!missing_cts) {
+              // trivial case: write the same number repeatedly
+              const uintptr_t tot_cells = (S_CAST(uint64_t, row_end_idx) * (row_end_idx - 1) - S_CAST(uint64_t, row_start_idx) * (row_start_idx - 1)) / 2;
+              const float variant_ctf = u31tof(variant_ct);
+              write_float_buf = R_CAST(float*, g_textbuf);
+              for (uint32_t uii = 0; uii < (kTextbufMainSize / sizeof(float)); ++uii) {
+                write_float_buf[uii] = variant_ctf;
+              }
+              const uintptr_t full_write_ct = tot_cells / (kTextbufMainSize / sizeof(float));
+              for (uintptr_t ulii = 0; ulii < full_write_ct; ++ulii) {
+                if (fwrite_checked(write_float_buf, kTextbufMainSize, outfile)) {
+                  goto CalcGrm_ret_WRITE_FAIL;
                 }
-                write_float_buf[col_idx] = u31tof(cur_obs_ct);
               }
-              if (fwrite_checked(write_float_buf, (row_idx + 1) * sizeof(float), outfile)) {
-                goto CalcGrm_ret_WRITE_FAIL;
+              const uintptr_t remainder = tot_cells % (kTextbufMainSize / sizeof(float));
+              if (remainder) {
+                if (fwrite_checked(write_float_buf, remainder * sizeof(float), outfile)) {
+                  goto CalcGrm_ret_WRITE_FAIL;
+                }
+              }
+            } else {
+              for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+                const uint32_t variant_ct_base = variant_ct - missing_cts[row_idx];
+                for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
+                  uint32_t cur_obs_ct = variant_ct_base;
+                  if (col_idx != row_idx) {
+                    cur_obs_ct = cur_obs_ct - missing_cts[col_idx] + (*missing_dbl_exclude_iter++);
+                  }
+                  write_float_buf[col_idx] = u31tof(cur_obs_ct);
+                }
+                if (fwrite_checked(write_float_buf, (row_idx + 1) * sizeof(float), outfile)) {
+                  goto CalcGrm_ret_WRITE_FAIL;
+                }
               }
             }
-          }
-          if (fclose_null(&outfile)) {
-            goto CalcGrm_ret_WRITE_FAIL;
-          }
-          putc_unlocked('\r', stdout);
-          const uint32_t outname_copy_byte_ct = 5 + S_CAST(uintptr_t, outname_end - outname);
-          log_write_iter = strcpya(g_logbuf, "--make-grm-bin: GRM ");
-          if (parallel_tot != 1) {
-            log_write_iter = strcpya(log_write_iter, "component ");
-          }
-          log_write_iter = strcpya(log_write_iter, "written to ");
-          log_write_iter = memcpya(log_write_iter, outname, outname_copy_byte_ct);
-          log_write_iter = memcpyl3a(log_write_iter, "bin");
-          if (parallel_tot != 1) {
-            *log_write_iter++ = '.';
-            log_write_iter = u32toa(parallel_idx + 1, log_write_iter);
-          }
-          log_write_iter = memcpyl3a(log_write_iter, " , ");
-          if (parallel_idx) {
-            log_write_iter = strcpya(log_write_iter, "and ");
-          }
-          log_write_iter = strcpya(log_write_iter, "observation counts to ");
-          log_write_iter = memcpya(log_write_iter, outname, outname_end2 - outname);
-        } else {
-          // --make-grm-list
-          char* outname_end2 = strcpya(outname_end, ".grm");
-          if (parallel_tot != 1) {
-            *outname_end2++ = '.';
-            outname_end2 = u32toa(parallel_idx + 1, outname_end2);
-          }
-          if (grm_flags & kfGrmListZs) {
-            outname_end2 = strcpya(outname_end2, ".zst");
-          }
-          *outname_end2 = '\0';
-          reterr = InitCstreamAlloc(outname, 0, !(grm_flags & kfGrmListNoGz), max_thread_ct, kCompressStreamBlock + kMaxMediumLine, &css, &cswritep);
-          if (reterr) {
-            goto CalcGrm_ret_1;
-          }
-          fputs("--make-grm-list: Writing...", stdout);
-          fflush(stdout);
-          for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
-            uint32_t variant_ct_base = variant_ct;
-            if (missing_cts) {
-              variant_ct_base -= missing_cts[row_idx];
+            if (fclose_null(&outfile)) {
+              goto CalcGrm_ret_WRITE_FAIL;
+            }
+            putc_unlocked('\r', stdout);
+            const uint32_t outname_copy_byte_ct = 5 + S_CAST(uintptr_t, outname_end - outname);
+            log_write_iter = strcpya(g_logbuf, "--make-grm-bin: GRM ");
+            if (parallel_tot != 1) {
+              log_write_iter = strcpya(log_write_iter, "component ");
+            }
+            log_write_iter = strcpya(log_write_iter, "written to ");
+            log_write_iter = memcpya(log_write_iter, outname, outname_copy_byte_ct);
+            log_write_iter = memcpyl3a(log_write_iter, "bin");
+            if (parallel_tot != 1) {
+              *log_write_iter++ = '.';
+              log_write_iter = u32toa(parallel_idx + 1, log_write_iter);
             }
-            const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
-            for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
-              cswritep = u32toa_x(row_idx + 1, '\t', cswritep);
-              cswritep = u32toa_x(col_idx + 1, '\t', cswritep);
+            log_write_iter = memcpyl3a(log_write_iter, " , ");
+            if (parallel_idx) {
+              log_write_iter = strcpya(log_write_iter, "and ");
+            }
+            log_write_iter = strcpya(log_write_iter, "observation counts to ");
+            log_write_iter = memcpya(log_write_iter, outname, outname_end2 - outname);
+          } else {
+            // --make-grm-list
+            char* outname_end2 = strcpya(outname_end, ".grm");
+            if (parallel_tot != 1) {
+              *outname_end2++ = '.';
+              outname_end2 = u32toa(parallel_idx + 1, outname_end2);
+            }
+            if (grm_flags & kfGrmListZs) {
+              outname_end2 = strcpya(outname_end2, ".zst");
+            }
+            *outname_end2 = '\0';
+            reterr = InitCstreamAlloc(outname, is_append, !(grm_flags & kfGrmListNoGz), max_thread_ct, kCompressStreamBlock + kMaxMediumLine, &css, &cswritep);
+            if (reterr) {
+              goto CalcGrm_ret_1;
+            }
+            fputs("--make-grm-list: Writing...", stdout);
+            fflush(stdout);
+            for (uintptr_t row_idx = row_start_idx; row_idx < row_end_idx; ++row_idx) {
+              uint32_t variant_ct_base = variant_ct;
               if (missing_cts) {
-                uint32_t cur_obs_ct = variant_ct_base;
-                if (col_idx != row_idx) {
-                  cur_obs_ct = cur_obs_ct - missing_cts[col_idx] + (*missing_dbl_exclude_iter++);
-                }
-                cswritep = u32toa(cur_obs_ct, cswritep);
-              } else {
-                cswritep = u32toa(variant_ct_base, cswritep);
+                variant_ct_base -= missing_cts[row_idx];
               }
-              *cswritep++ = '\t';
-              cswritep = dtoa_g(*grm_iter++, cswritep);
-              AppendBinaryEoln(&cswritep);
-              if (Cswrite(&css, &cswritep)) {
-                goto CalcGrm_ret_WRITE_FAIL;
+              const double* grm_iter = &(grm[(row_idx - row_start_idx) * row_end_idx]);
+              for (uint32_t col_idx = 0; col_idx <= row_idx; ++col_idx) {
+                cswritep = u32toa_x(row_idx + 1, '\t', cswritep);
+                cswritep = u32toa_x(col_idx + 1, '\t', cswritep);
+                if (missing_cts) {
+                  uint32_t cur_obs_ct = variant_ct_base;
+                  if (col_idx != row_idx) {
+                    cur_obs_ct = cur_obs_ct - missing_cts[col_idx] + (*missing_dbl_exclude_iter++);
+                  }
+                  cswritep = u32toa(cur_obs_ct, cswritep);
+                } else {
+                  cswritep = u32toa(variant_ct_base, cswritep);
+                }
+                *cswritep++ = '\t';
+                cswritep = dtoa_g(*grm_iter++, cswritep);
+                AppendBinaryEoln(&cswritep);
+                if (Cswrite(&css, &cswritep)) {
+                  goto CalcGrm_ret_WRITE_FAIL;
+                }
               }
             }
+            if (CswriteCloseNull(&css, cswritep)) {
+              goto CalcGrm_ret_WRITE_FAIL;
+            }
+            putc_unlocked('\r', stdout);
+            log_write_iter = strcpya(g_logbuf, "--make-grm-list: GRM ");
+            if (parallel_tot != 1) {
+              log_write_iter = strcpya(log_write_iter, "component ");
+            }
+            log_write_iter = strcpya(log_write_iter, "written to ");
+            log_write_iter = strcpya(log_write_iter, outname);
           }
-          if (CswriteCloseNull(&css, cswritep)) {
-            goto CalcGrm_ret_WRITE_FAIL;
+        }
+        if (pass_idx_p1 == pass_ct) {
+          if (!parallel_idx) {
+            SampleIdFlags id_print_flags = siip->flags & kfSampleIdFidPresent;
+            if (grm_flags & kfGrmNoIdHeader) {
+              id_print_flags |= kfSampleIdNoIdHeader;
+              if (grm_flags & kfGrmNoIdHeaderIidOnly) {
+                id_print_flags |= kfSampleIdNoIdHeaderIidOnly;
+              }
+            }
+            snprintf(&(outname_end[4]), kMaxOutfnameExtBlen - 4, ".id");
+            reterr = WriteSampleIdsOverride(orig_sample_include, siip, outname, sample_ct, id_print_flags);
+            if (reterr) {
+              goto CalcGrm_ret_1;
+            }
+            log_write_iter = strcpya(log_write_iter, " , and IDs to ");
+            log_write_iter = strcpya(log_write_iter, outname);
           }
-          putc_unlocked('\r', stdout);
-          log_write_iter = strcpya(g_logbuf, "--make-grm-list: GRM ");
-          if (parallel_tot != 1) {
-            log_write_iter = strcpya(log_write_iter, "component ");
+          snprintf(log_write_iter, kLogbufSize - 2 * kPglFnamesize - 256, " .\n");
+          WordWrapB(0);
+          logputsb();
+          if (grm_flags & kfGrmMatrixSparse) {
+            logprintf("--make-rel sparse: %" PRIu64 " off-diagonal entr%s > %g retained.\n", sparse_entry_ct, (sparse_entry_ct == 1)? "y" : "ies", sparse_cutoff);
           }
-          log_write_iter = strcpya(log_write_iter, "written to ");
-          log_write_iter = strcpya(log_write_iter, outname);
         }
       }
-      if (!parallel_idx) {
-        SampleIdFlags id_print_flags = siip->flags & kfSampleIdFidPresent;
-        if (grm_flags & kfGrmNoIdHeader) {
-          id_print_flags |= kfSampleIdNoIdHeader;
-          if (grm_flags & kfGrmNoIdHeaderIidOnly) {
-            id_print_flags |= kfSampleIdNoIdHeaderIidOnly;
-          }
-        }
-        snprintf(&(outname_end[4]), kMaxOutfnameExtBlen - 4, ".id");
-        reterr = WriteSampleIdsOverride(orig_sample_include, siip, outname, sample_ct, id_print_flags);
-        if (reterr) {
-          goto CalcGrm_ret_1;
-        }
-        log_write_iter = strcpya(log_write_iter, " , and IDs to ");
-        log_write_iter = strcpya(log_write_iter, outname);
+
+      if (grm_ptr) {
+        *grm_ptr = grm;
+        bigstack_mark = grm_alloc_end;
       }
-      snprintf(log_write_iter, kLogbufSize - 2 * kPglFnamesize - 256, " .\n");
-      WordWrapB(0);
-      logputsb();
     }
-
-    if (grm_ptr) {
-      *grm_ptr = grm;
-      // allocation right on top of grm[]
-      bigstack_mark = R_CAST(unsigned char*, sample_include_cumulative_popcounts);
+    if (ckpt_fname) {
+      unlink(ckpt_fname);
     }
   }
   while (0) {
@@ -3461,9 +3842,6 @@ PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, c
   return reterr;
 }
 
-// should be able to remove NOLAPACK later since we already have a non-LAPACK
-// SVD implementation
-#ifndef NOLAPACK
 // this seems to be better than 256 (due to avoidance of cache critical
 // stride?)
 // (still want this to be a multiple of 8, for cleaner multithreading)
@@ -3478,12 +3856,174 @@ static double* g_cur_maj_freqs[2] = {nullptr, nullptr};
 static double** g_yy_bufs = nullptr;
 static double** g_y_transpose_bufs = nullptr;
 static double** g_g2_bb_part_bufs = nullptr;
-static double* g_g1 = nullptr;
-static double* g_qq = nullptr;
+static double** g_packed_col_bufs = nullptr;
 
 static uint32_t g_pc_ct = 0;
 static PglErr g_error_ret = kPglRetSuccess;
 
+// Number of doubles in the sample-major operand of the packed-genovec kernels
+// below that we try to keep in L2 cache at a time.
+CONSTU31(kPcaPackedCacheDoubles, 32768);
+
+// The packed-genovec kernels skip homozygous-major calls, and beat expansion +
+// dgemm when those make up most of the block (the usual case after MAF
+// filtering); with denser blocks, dgemm's better arithmetic throughput wins.
+CONSTU31(kPcaPackedMaxNonmajPercent, 35);
+
+uint32_t PcaBlockUsePacked(const uintptr_t* genovecs, const uint32_t* dosage_cts, uint32_t sample_ct, uint32_t variant_ct) {
+  const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+  uint64_t nonmaj_call_ct = 0;
+  for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+    if (dosage_cts[uii]) {
+      return 0;
+    }
+    uint32_t genocounts[4];
+    GenovecCountFreqsUnsafe(&(genovecs[uii * sample_ctaw2]), sample_ct, genocounts);
+    nonmaj_call_ct += sample_ct - genocounts[0];
+  }
+  return (nonmaj_call_ct * 100 < S_CAST(uint64_t, sample_ct) * variant_ct * kPcaPackedMaxNonmajPercent);
+}
+
+// Hardcall-only equivalent of ExpandCenteredVarmaj(): instead of expanding,
+// saves (slope, intercept) such that the variance-standardized value of a
+// nonmissing genotype is (nonmajor allele count) * slope + intercept.
+PglErr CenteredVarmajCoefs(const uintptr_t* genovecs, const double* maj_freqs, uint32_t sample_ct, uint32_t variant_ct, double* slopes, double* intercepts) {
+  const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+  for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+    const double maj_freq = maj_freqs[uii];
+    const double nonmaj_freq = 1.0 - maj_freq;
+    const double variance = 2 * maj_freq * nonmaj_freq;
+    if (variance < kSmallEpsilon) {
+      uint32_t genocounts[4];
+      GenovecCountFreqsUnsafe(&(genovecs[uii * sample_ctaw2]), sample_ct, genocounts);
+      if (genocounts[1] || genocounts[2]) {
+        return kPglRetInconsistentInput;
+      }
+      slopes[uii] = 0.0;
+      intercepts[uii] = 0.0;
+      continue;
+    }
+    const double inv_stdev = 1.0 / sqrt(variance);
+    slopes[uii] = inv_stdev;
+    intercepts[uii] = -2 * nonmaj_freq * inv_stdev;
+  }
+  return kPglRetSuccess;
+}
+
+uint32_t PackedSampleBlockSize(uint32_t col_ct) {
+  const uint32_t block_size = RoundDownPow2(kPcaPackedCacheDoubles / col_ct, kBitsPerWordD2);
+  return block_size? block_size : kBitsPerWordD2;
+}
+
+// out_vmaj := X * in_smaj, where X is the centered, variance-standardized
+// (variant-major) hardcall matrix encoded by genovecs/slopes/intercepts, and
+// missing calls are treated as zero.  Homozygous-major calls (typically the
+// large majority) are skipped entirely; the intercept is applied afterward via
+// the column sums of in_smaj, and missing calls subtract it back out.
+// Assumes trailing bits of each genovec are zeroed out.
+void PackedVarmajMultiply(const uintptr_t* genovecs, const double* slopes, const double* intercepts, const double* in_smaj, const double* in_col_sums, uint32_t variant_ct, uint32_t sample_ct, uint32_t col_ct, uintptr_t in_stride, uintptr_t out_stride, double* out_vmaj) {
+  const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+  const uint32_t word_ct = QuaterCtToWordCt(sample_ct);
+  const uint32_t block_word_ct = PackedSampleBlockSize(col_ct) / kBitsPerWordD2;
+  for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+    ZeroDArr(col_ct, &(out_vmaj[uii * out_stride]));
+  }
+  for (uint32_t block_widx_start = 0; block_widx_start < word_ct; block_widx_start += block_word_ct) {
+    const uint32_t block_widx_end = MINV(block_widx_start + block_word_ct, word_ct);
+    for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+      const double slope = slopes[uii];
+      const double coefs[4] = {0.0, slope, 2 * slope, -intercepts[uii]};
+      const uintptr_t* genovec = &(genovecs[uii * sample_ctaw2]);
+      double* out_row = &(out_vmaj[uii * out_stride]);
+      for (uint32_t widx = block_widx_start; widx != block_widx_end; ++widx) {
+        uintptr_t geno_word = genovec[widx];
+        const double* in_block = &(in_smaj[widx * kBitsPerWordD2 * in_stride]);
+        while (geno_word) {
+          const uint32_t shift = ctzw(geno_word) & (~1);
+          const double coef = coefs[(geno_word >> shift) & 3];
+          const double* in_row = &(in_block[(shift / 2) * in_stride]);
+          for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+            out_row[col_idx] += coef * in_row[col_idx];
+          }
+          geno_word &= ~((3 * k1LU) << shift);
+        }
+      }
+    }
+  }
+  for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+    const double intercept = intercepts[uii];
+    double* out_row = &(out_vmaj[uii * out_stride]);
+    for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+      out_row[col_idx] += intercept * in_col_sums[col_idx];
+    }
+  }
+}
+
+// out_smaj += X^T * in_vmaj, X as above.  col_buf must have space for col_ct
+// doubles.
+void PackedVarmajTransposeMultiplyIncr(const uintptr_t* genovecs, const double* slopes, const double* intercepts, const double* in_vmaj, uint32_t variant_ct, uint32_t sample_ct, uint32_t col_ct, uintptr_t in_stride, uintptr_t out_stride, double* col_buf, double* out_smaj) {
+  const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+  const uint32_t word_ct = QuaterCtToWordCt(sample_ct);
+  const uint32_t block_size = PackedSampleBlockSize(col_ct);
+  const uint32_t block_word_ct = block_size / kBitsPerWordD2;
+  // intercept contribution shared by all nonmissing samples
+  ZeroDArr(col_ct, col_buf);
+  for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+    const double intercept = intercepts[uii];
+    const double* in_row = &(in_vmaj[uii * in_stride]);
+    for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+      col_buf[col_idx] += intercept * in_row[col_idx];
+    }
+  }
+  for (uint32_t block_widx_start = 0; block_widx_start < word_ct; block_widx_start += block_word_ct) {
+    const uint32_t block_widx_end = MINV(block_widx_start + block_word_ct, word_ct);
+    const uint32_t block_sample_start = block_widx_start * kBitsPerWordD2;
+    const uint32_t block_sample_end = MINV(block_sample_start + block_size, sample_ct);
+    for (uint32_t sample_idx = block_sample_start; sample_idx != block_sample_end; ++sample_idx) {
+      double* out_row = &(out_smaj[sample_idx * out_stride]);
+      for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+        out_row[col_idx] += col_buf[col_idx];
+      }
+    }
+    for (uint32_t uii = 0; uii != variant_ct; ++uii) {
+      const double slope = slopes[uii];
+      const double coefs[4] = {0.0, slope, 2 * slope, -intercepts[uii]};
+      const uintptr_t* genovec = &(genovecs[uii * sample_ctaw2]);
+      const double* in_row = &(in_vmaj[uii * in_stride]);
+      for (uint32_t widx = block_widx_start; widx != block_widx_end; ++widx) {
+        uintptr_t geno_word = genovec[widx];
+        double* out_block = &(out_smaj[widx * kBitsPerWordD2 * out_stride]);
+        while (geno_word) {
+          const uint32_t shift = ctzw(geno_word) & (~1);
+          const double coef = coefs[(geno_word >> shift) & 3];
+          double* out_row = &(out_block[(shift / 2) * out_stride]);
+          for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+            out_row[col_idx] += coef * in_row[col_idx];
+          }
+          geno_word &= ~((3 * k1LU) << shift);
+        }
+      }
+    }
+  }
+}
+
+void FillColSums(const double* smaj, uintptr_t row_ct, uint32_t col_ct, double* col_sums) {
+  ZeroDArr(col_ct, col_sums);
+  for (uintptr_t row_idx = 0; row_idx != row_ct; ++row_idx) {
+    const double* row = &(smaj[row_idx * col_ct]);
+    for (uint32_t col_idx = 0; col_idx != col_ct; ++col_idx) {
+      col_sums[col_idx] += row[col_idx];
+    }
+  }
+}
+
+// should be able to remove NOLAPACK later since we already have a non-LAPACK
+// SVD implementation
+#ifndef NOLAPACK
+static double* g_g1 = nullptr;
+static double* g_g1_col_sums = nullptr;
+static double* g_qq = nullptr;
+
 THREAD_FUNC_DECL CalcPcaXtxaThread(void* arg) {
   const uintptr_t tidx = R_CAST(uintptr_t, arg);
   const uint32_t pca_sample_ct = g_pca_sample_ct;
@@ -3497,6 +4037,9 @@ THREAD_FUNC_DECL CalcPcaXtxaThread(void* arg) {
   double* yy_buf = g_yy_bufs[tidx];
   double* y_transpose_buf = g_y_transpose_bufs[tidx];
   double* g2_part_buf = g_g2_bb_part_bufs[tidx];
+  double* col_buf = g_packed_col_bufs[tidx];
+  double slopes[kPcaVariantBlockSize];
+  double intercepts[kPcaVariantBlockSize];
   uint32_t parity = 0;
   while (1) {
     const uint32_t is_last_batch = g_is_last_thread_block;
@@ -3511,22 +4054,31 @@ THREAD_FUNC_DECL CalcPcaXtxaThread(void* arg) {
       const uintptr_t* dosage_present_iter = &(g_dosage_presents[parity][vidx_offset * pca_sample_ctaw]);
       const Dosage* dosage_main_iter = &(g_dosage_mains[parity][vidx_offset * pca_sample_ct]);
       const double* cur_maj_freqs_iter = &(g_cur_maj_freqs[parity][vidx_offset]);
-      double* yy_iter = yy_buf;
-      for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
-        PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+      double* cur_qq = &(qq_iter[vidx_offset * qq_col_ct]);
+      if (PcaBlockUsePacked(genovec_iter, cur_dosage_cts, pca_sample_ct, cur_thread_batch_size)) {
+        PglErr reterr = CenteredVarmajCoefs(genovec_iter, cur_maj_freqs_iter, pca_sample_ct, cur_thread_batch_size, slopes, intercepts);
         if (reterr) {
           g_error_ret = reterr;
-          break;
         }
-        yy_iter = &(yy_iter[pca_sample_ct]);
-        genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
-        dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
-        dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        PackedVarmajMultiply(genovec_iter, slopes, intercepts, g1, g_g1_col_sums, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, qq_col_ct, cur_qq);
+        PackedVarmajTransposeMultiplyIncr(genovec_iter, slopes, intercepts, cur_qq, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, qq_col_ct, pc_ct_x2, col_buf, g2_part_buf);
+      } else {
+        double* yy_iter = yy_buf;
+        for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
+          PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+          if (reterr) {
+            g_error_ret = reterr;
+            break;
+          }
+          yy_iter = &(yy_iter[pca_sample_ct]);
+          genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
+          dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
+          dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        }
+        RowMajorMatrixMultiplyStrided(yy_buf, g1, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, pca_sample_ct, qq_col_ct, cur_qq);
+        MatrixTransposeCopy(yy_buf, cur_thread_batch_size, pca_sample_ct, y_transpose_buf);
+        RowMajorMatrixMultiplyStridedIncr(y_transpose_buf, cur_qq, pca_sample_ct, cur_thread_batch_size, pc_ct_x2, qq_col_ct, cur_thread_batch_size, pc_ct_x2, g2_part_buf);
       }
-      double* cur_qq = &(qq_iter[vidx_offset * qq_col_ct]);
-      RowMajorMatrixMultiplyStrided(yy_buf, g1, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, pca_sample_ct, qq_col_ct, cur_qq);
-      MatrixTransposeCopy(yy_buf, cur_thread_batch_size, pca_sample_ct, y_transpose_buf);
-      RowMajorMatrixMultiplyStridedIncr(y_transpose_buf, cur_qq, pca_sample_ct, cur_thread_batch_size, pc_ct_x2, qq_col_ct, cur_thread_batch_size, pc_ct_x2, g2_part_buf);
       qq_iter = &(qq_iter[cur_batch_size * qq_col_ct]);
     }
     if (is_last_batch) {
@@ -3548,6 +4100,8 @@ THREAD_FUNC_DECL CalcPcaXaThread(void* arg) {
   const double* g1 = g_g1;
   double* qq_iter = g_qq;
   double* yy_buf = g_yy_bufs[tidx];
+  double slopes[kPcaVariantBlockSize];
+  double intercepts[kPcaVariantBlockSize];
   uint32_t parity = 0;
   while (1) {
     const uint32_t is_last_batch = g_is_last_thread_block;
@@ -3562,20 +4116,28 @@ THREAD_FUNC_DECL CalcPcaXaThread(void* arg) {
       const uintptr_t* dosage_present_iter = &(g_dosage_presents[parity][vidx_offset * pca_sample_ctaw]);
       const Dosage* dosage_main_iter = &(g_dosage_mains[parity][vidx_offset * pca_sample_ct]);
       const double* cur_maj_freqs_iter = &(g_cur_maj_freqs[parity][vidx_offset]);
-      double* yy_iter = yy_buf;
-      for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
-        PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+      double* cur_qq = &(qq_iter[vidx_offset * qq_col_ct]);
+      if (PcaBlockUsePacked(genovec_iter, cur_dosage_cts, pca_sample_ct, cur_thread_batch_size)) {
+        PglErr reterr = CenteredVarmajCoefs(genovec_iter, cur_maj_freqs_iter, pca_sample_ct, cur_thread_batch_size, slopes, intercepts);
         if (reterr) {
           g_error_ret = reterr;
-          break;
         }
-        yy_iter = &(yy_iter[pca_sample_ct]);
-        genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
-        dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
-        dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
-      }
-      double* cur_qq = &(qq_iter[vidx_offset * qq_col_ct]);
-      RowMajorMatrixMultiplyStrided(yy_buf, g1, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, pca_sample_ct, qq_col_ct, cur_qq);
+        PackedVarmajMultiply(genovec_iter, slopes, intercepts, g1, g_g1_col_sums, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, qq_col_ct, cur_qq);
+      } else {
+        double* yy_iter = yy_buf;
+        for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
+          PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+          if (reterr) {
+            g_error_ret = reterr;
+            break;
+          }
+          yy_iter = &(yy_iter[pca_sample_ct]);
+          genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
+          dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
+          dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        }
+        RowMajorMatrixMultiplyStrided(yy_buf, g1, cur_thread_batch_size, pca_sample_ct, pc_ct_x2, pc_ct_x2, pca_sample_ct, qq_col_ct, cur_qq);
+      }
       qq_iter = &(qq_iter[cur_batch_size * qq_col_ct]);
     }
     if (is_last_batch) {
@@ -3598,6 +4160,9 @@ THREAD_FUNC_DECL CalcPcaXtbThread(void* arg) {
   double* yy_buf = g_yy_bufs[tidx];
   double* y_transpose_buf = g_y_transpose_bufs[tidx];
   double* bb_part_buf = g_g2_bb_part_bufs[tidx];
+  double* col_buf = g_packed_col_bufs[tidx];
+  double slopes[kPcaVariantBlockSize];
+  double intercepts[kPcaVariantBlockSize];
   uint32_t parity = 0;
   while (1) {
     const uint32_t is_last_batch = g_is_last_thread_block;
@@ -3612,20 +4177,28 @@ THREAD_FUNC_DECL CalcPcaXtbThread(void* arg) {
       const uintptr_t* dosage_present_iter = &(g_dosage_presents[parity][vidx_offset * pca_sample_ctaw]);
       const Dosage* dosage_main_iter = &(g_dosage_mains[parity][vidx_offset * pca_sample_ct]);
       const double* cur_maj_freqs_iter = &(g_cur_maj_freqs[parity][vidx_offset]);
-      double* yy_iter = yy_buf;
-      for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
-        PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+      if (PcaBlockUsePacked(genovec_iter, cur_dosage_cts, pca_sample_ct, cur_thread_batch_size)) {
+        PglErr reterr = CenteredVarmajCoefs(genovec_iter, cur_maj_freqs_iter, pca_sample_ct, cur_thread_batch_size, slopes, intercepts);
         if (reterr) {
           g_error_ret = reterr;
-          break;
         }
-        yy_iter = &(yy_iter[pca_sample_ct]);
-        genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
-        dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
-        dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        PackedVarmajTransposeMultiplyIncr(genovec_iter, slopes, intercepts, qq_iter, cur_thread_batch_size, pca_sample_ct, qq_col_ct, qq_col_ct, qq_col_ct, col_buf, bb_part_buf);
+      } else {
+        double* yy_iter = yy_buf;
+        for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
+          PglErr reterr = ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+          if (reterr) {
+            g_error_ret = reterr;
+            break;
+          }
+          yy_iter = &(yy_iter[pca_sample_ct]);
+          genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
+          dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
+          dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        }
+        MatrixTransposeCopy(yy_buf, cur_thread_batch_size, pca_sample_ct, y_transpose_buf);
+        RowMajorMatrixMultiplyIncr(y_transpose_buf, qq_iter, pca_sample_ct, qq_col_ct, cur_thread_batch_size, bb_part_buf);
       }
-      MatrixTransposeCopy(yy_buf, cur_thread_batch_size, pca_sample_ct, y_transpose_buf);
-      RowMajorMatrixMultiplyIncr(y_transpose_buf, qq_iter, pca_sample_ct, qq_col_ct, cur_thread_batch_size, bb_part_buf);
       qq_iter = &(qq_iter[cur_batch_size * qq_col_ct]);
     }
     if (is_last_batch) {
@@ -3838,8 +4411,10 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
           bigstack_alloc_d(variant_ct * qq_col_ct, &qq) ||
           bigstack_alloc_dp(calc_thread_ct, &g_y_transpose_bufs) ||
           bigstack_alloc_dp(calc_thread_ct, &g_g2_bb_part_bufs) ||
+          bigstack_alloc_dp(calc_thread_ct, &g_packed_col_bufs) ||
           bigstack_alloc_uc(svd_rect_wkspace_size, &svd_rect_wkspace) ||
-          bigstack_alloc_d(g_size, &g1)) {
+          bigstack_alloc_d(g_size, &g1) ||
+          bigstack_alloc_d(pc_ct_x2, &g_g1_col_sums)) {
         goto CalcPca_ret_NOMEM;
       }
       const uintptr_t genovecs_alloc = RoundUpPow2(pca_sample_ctaw2 * kPcaVariantBlockSize * sizeof(intptr_t), kCacheline);
@@ -3850,7 +4425,8 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
       const uintptr_t yy_alloc = RoundUpPow2(kPcaVariantBlockSize * pca_sample_ct * sizeof(double), kCacheline);
       const uintptr_t b_size = pca_sample_ct * qq_col_ct;
       const uintptr_t g2_bb_part_alloc = RoundUpPow2(b_size * sizeof(double), kCacheline);
-      const uintptr_t per_thread_alloc = 2 * (genovecs_alloc + dosage_cts_alloc + dosage_presents_alloc + dosage_main_alloc + cur_maj_freqs_alloc + yy_alloc) + g2_bb_part_alloc;
+      const uintptr_t packed_col_alloc = RoundUpPow2(qq_col_ct * sizeof(double), kCacheline);
+      const uintptr_t per_thread_alloc = 2 * (genovecs_alloc + dosage_cts_alloc + dosage_presents_alloc + dosage_main_alloc + cur_maj_freqs_alloc + yy_alloc) + g2_bb_part_alloc + packed_col_alloc;
 
       const uintptr_t bigstack_avail = bigstack_left();
       if (per_thread_alloc * calc_thread_ct > bigstack_avail) {
@@ -3870,8 +4446,10 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
         g_yy_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(yy_alloc));
         g_y_transpose_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(yy_alloc));
         g_g2_bb_part_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(g2_bb_part_alloc));
+        g_packed_col_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(packed_col_alloc));
       }
       FillGaussianDArr(g_size / 2, max_thread_ct, g1);
+      FillColSums(g1, pca_sample_ct, pc_ct_x2, g_g1_col_sums);
       g_g1 = g1;
 #ifdef __APPLE__
       fputs("Projecting random vectors... ", stdout);
@@ -3882,6 +4460,11 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
       PgrClearLdCache(simple_pgrp);
       for (uint32_t iter_idx = 0; iter_idx <= pc_ct; ++iter_idx) {
         // kjg_fpca_XTXA(), kjg_fpca_XA()
+        if (iter_idx) {
+          // bugfix: stale is_last_block previously caused an empty first
+          // block, desynchronizing the loader's and threads' buffer parity
+          ReinitThreads3z(&ts);
+        }
         for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
           ZeroDArr(g_size, g_g2_bb_part_bufs[tidx]);
         }
@@ -3988,6 +4571,7 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
           for (uintptr_t ulii = 0; ulii < g_size; ++ulii) {
             g1[ulii] *= variant_ct_recip;
           }
+          FillColSums(g1, pca_sample_ct, pc_ct_x2, g_g1_col_sums);
         }
 #ifdef __APPLE__
         printf("\rProjecting random vectors... %u/%u", iter_idx + 1, pc_ct + 1);
@@ -4518,29 +5102,586 @@ PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const
   CalcPca_ret_WRITE_FAIL:
     reterr = kPglRetWriteFail;
     break;
-  CalcPca_ret_INCONSISTENT_INPUT_2:
+  CalcPca_ret_INCONSISTENT_INPUT_2:
+    logerrputsb();
+  CalcPca_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  CalcPca_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  }
+ CalcPca_ret_1:
+  CleanupThreads3z(&ts, &g_cur_batch_size);
+  BLAS_SET_NUM_THREADS(1);
+  CswriteCloseCond(&css, cswritep);
+  fclose_cond(outfile);
+  if (grm) {
+    // nothing after --pca in the plink2 order of operations uses grm[]
+    BigstackReset(grm);
+  } else {
+    BigstackReset(bigstack_mark);
+  }
+  return reterr;
+}
+#endif
+
+// matches the --pca upper bound
+CONSTU31(kPcaProjectMaxPcs, 8000);
+
+static double* g_proj_var_wts[2] = {nullptr, nullptr};
+
+THREAD_FUNC_DECL PcaProjectThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint32_t pca_sample_ct = g_pca_sample_ct;
+  const uintptr_t pca_sample_ctaw2 = QuaterCtToAlignedWordCt(pca_sample_ct);
+  const uintptr_t pca_sample_ctaw = BitCtToAlignedWordCt(pca_sample_ct);
+  const uint32_t pc_ct = g_pc_ct;
+  const uint32_t vidx_offset = tidx * kPcaVariantBlockSize;
+  double* yy_buf = g_yy_bufs[tidx];
+  double* y_transpose_buf = g_y_transpose_bufs[tidx];
+  double* proj_part_buf = g_g2_bb_part_bufs[tidx];
+  double* col_buf = g_packed_col_bufs[tidx];
+  double slopes[kPcaVariantBlockSize];
+  double intercepts[kPcaVariantBlockSize];
+  uint32_t parity = 0;
+  while (1) {
+    const uint32_t is_last_batch = g_is_last_thread_block;
+    const uint32_t cur_batch_size = g_cur_batch_size;
+    if (vidx_offset < cur_batch_size) {
+      uint32_t cur_thread_batch_size = cur_batch_size - vidx_offset;
+      if (cur_thread_batch_size > kPcaVariantBlockSize) {
+        cur_thread_batch_size = kPcaVariantBlockSize;
+      }
+      const uintptr_t* genovec_iter = &(g_genovecs[parity][vidx_offset * pca_sample_ctaw2]);
+      const uint32_t* cur_dosage_cts = &(g_dosage_cts[parity][vidx_offset]);
+      const uintptr_t* dosage_present_iter = &(g_dosage_presents[parity][vidx_offset * pca_sample_ctaw]);
+      const Dosage* dosage_main_iter = &(g_dosage_mains[parity][vidx_offset * pca_sample_ct]);
+      const double* cur_maj_freqs_iter = &(g_cur_maj_freqs[parity][vidx_offset]);
+      const double* var_wts_iter = &(g_proj_var_wts[parity][vidx_offset * S_CAST(uintptr_t, pc_ct)]);
+      // zero-variance variants were filtered out by the loader, so neither
+      // CenteredVarmajCoefs() nor ExpandCenteredVarmaj() can fail here
+      if (PcaBlockUsePacked(genovec_iter, cur_dosage_cts, pca_sample_ct, cur_thread_batch_size)) {
+        CenteredVarmajCoefs(genovec_iter, cur_maj_freqs_iter, pca_sample_ct, cur_thread_batch_size, slopes, intercepts);
+        PackedVarmajTransposeMultiplyIncr(genovec_iter, slopes, intercepts, var_wts_iter, cur_thread_batch_size, pca_sample_ct, pc_ct, pc_ct, pc_ct, col_buf, proj_part_buf);
+      } else {
+        double* yy_iter = yy_buf;
+        for (uint32_t uii = 0; uii < cur_thread_batch_size; ++uii) {
+          ExpandCenteredVarmaj(genovec_iter, dosage_present_iter, dosage_main_iter, 1, pca_sample_ct, cur_dosage_cts[uii], cur_maj_freqs_iter[uii], yy_iter);
+          yy_iter = &(yy_iter[pca_sample_ct]);
+          genovec_iter = &(genovec_iter[pca_sample_ctaw2]);
+          dosage_present_iter = &(dosage_present_iter[pca_sample_ctaw]);
+          dosage_main_iter = &(dosage_main_iter[pca_sample_ct]);
+        }
+        MatrixTransposeCopy(yy_buf, cur_thread_batch_size, pca_sample_ct, y_transpose_buf);
+        RowMajorMatrixMultiplyIncr(y_transpose_buf, var_wts_iter, pca_sample_ct, pc_ct, cur_thread_batch_size, proj_part_buf);
+      }
+    }
+    if (is_last_batch) {
+      THREAD_RETURN;
+    }
+    THREAD_BLOCK_FINISH(tidx);
+    parity = 1 - parity;
+  }
+}
+
+PglErr PcaProject(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const char* var_wts_fname, const char* eigval_fname, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  FILE* outfile = nullptr;
+  const char* cur_fname = eigval_fname;
+  uintptr_t line_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream rls;
+  ThreadsState ts;
+  PreinitRLstream(&rls);
+  InitThreads3z(&ts);
+  {
+    // Each reference sample's PC score was S_k = (X_ref * W_k) / (M * sqrt(λ_k)),
+    // where W_k is the k-th column of the .eigenvec.var matrix, X_ref is the
+    // variance-standardized nonmajor allele count matrix, and M is the number
+    // of variants in the reference PCA.  We apply the same formula to the
+    // current samples; variants absent from the current dataset contribute
+    // zero, i.e. they're mean-imputed.
+    double* eigvals;
+    if (bigstack_alloc_d(kPcaProjectMaxPcs, &eigvals)) {
+      goto PcaProject_ret_NOMEM;
+    }
+    char* line_iter;
+    reterr = InitRLstreamMinsizeRaw(eigval_fname, &rls, &line_iter);
+    if (reterr) {
+      goto PcaProject_ret_1;
+    }
+    uint32_t eigval_ct = 0;
+    while (1) {
+      reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+      if (reterr) {
+        if (reterr == kPglRetEof) {
+          reterr = kPglRetSuccess;
+          break;
+        }
+        goto PcaProject_ret_READ_RLSTREAM;
+      }
+      if (eigval_ct == kPcaProjectMaxPcs) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Too many eigenvalues in %s.\n", eigval_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+      double cur_eigval;
+      if ((!ScanadvDouble(line_iter, &cur_eigval)) || (cur_eigval <= 0.0)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s does not contain a positive eigenvalue.\n", line_idx, eigval_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+      eigvals[eigval_ct++] = cur_eigval;
+    }
+    reterr = CleanupRLstream(&rls);
+    if (reterr) {
+      goto PcaProject_ret_1;
+    }
+    if (!eigval_ct) {
+      snprintf(g_logbuf, kLogbufSize, "Error: %s is empty.\n", eigval_fname);
+      goto PcaProject_ret_MALFORMED_INPUT_WW;
+    }
+    BigstackShrinkTop(eigvals, eigval_ct * sizeof(double));
+    // pc_ct must equal eigval_ct, so the per-variant arrays can be allocated
+    // before the .eigenvec.var read buffer; that way the latter can be
+    // released along with the ID hash table.
+    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
+    uintptr_t* proj_variant_include;
+    uint32_t* variant_uidx_to_slot;
+    AltAlleleCt* proj_maj_alleles;
+    double* var_wts_by_slot;
+    if (bigstack_calloc_w(raw_variant_ctl, &proj_variant_include) ||
+        bigstack_alloc_u32(raw_variant_ct, &variant_uidx_to_slot) ||
+        bigstack_alloc_d(variant_ct * S_CAST(uintptr_t, eigval_ct), &var_wts_by_slot)) {
+      goto PcaProject_ret_NOMEM;
+    }
+    proj_maj_alleles = S_CAST(AltAlleleCt*, bigstack_alloc(raw_variant_ct * sizeof(AltAlleleCt)));
+    if (!proj_maj_alleles) {
+      goto PcaProject_ret_NOMEM;
+    }
+    uint32_t* variant_id_htable = nullptr;
+    uint32_t variant_id_htable_size;
+    reterr = AllocAndPopulateIdHtableMt(variant_include, variant_ids, variant_ct, max_thread_ct, &variant_id_htable, nullptr, &variant_id_htable_size);
+    if (reterr) {
+      goto PcaProject_ret_1;
+    }
+
+    cur_fname = var_wts_fname;
+    line_idx = 0;
+    PreinitRLstream(&rls);
+    reterr = SizeAndInitRLstreamRaw(var_wts_fname, bigstack_left() / 8, &rls, &line_iter);
+    if (reterr) {
+      goto PcaProject_ret_1;
+    }
+    reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+    if (reterr) {
+      if (reterr == kPglRetEof) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s is empty.\n", var_wts_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+      goto PcaProject_ret_READ_RLSTREAM;
+    }
+    if (*line_iter != '#') {
+      snprintf(g_logbuf, kLogbufSize, "Error: %s does not start with a header line (generate it with --pca var-wts).\n", var_wts_fname);
+      goto PcaProject_ret_MALFORMED_INPUT_WW;
+    }
+    // Header is
+    //   #[CHROM\t][POS\t]ID[\tREF][\tALT1][\tALT][\tMAJ][\tNONMAJ]\tPC1...
+    // We require ID, MAJ, and a trailing PC1..PC{n} block.
+    uint32_t id_col_idx = UINT32_MAX;
+    uint32_t maj_col_idx = UINT32_MAX;
+    uint32_t pc1_col_idx = UINT32_MAX;
+    uint32_t pc_ct = 0;
+    {
+      const char* header_iter = &(line_iter[1]);
+      for (uint32_t col_idx = 0; ; ++col_idx) {
+        const char* token_end = CurTokenEnd(header_iter);
+        const uint32_t token_slen = token_end - header_iter;
+        if (pc1_col_idx != UINT32_MAX) {
+          // all remaining columns must be PC{pc_ct + 1}
+          if ((token_slen < 3) || (header_iter[0] != 'P') || (header_iter[1] != 'C')) {
+            break;
+          }
+          uint32_t pc_idx;
+          if (ScanPosintCapped(&(header_iter[2]), kPcaProjectMaxPcs, &pc_idx) || (pc_idx != pc_ct + 1)) {
+            break;
+          }
+          ++pc_ct;
+        } else if (strequal_k(header_iter, "ID", token_slen)) {
+          id_col_idx = col_idx;
+        } else if (strequal_k(header_iter, "MAJ", token_slen)) {
+          maj_col_idx = col_idx;
+        } else if (strequal_k(header_iter, "PC1", token_slen)) {
+          pc1_col_idx = col_idx;
+          pc_ct = 1;
+        }
+        header_iter = FirstNonTspace(token_end);
+        if (IsEolnKns(*header_iter)) {
+          header_iter = nullptr;
+          break;
+        }
+      }
+      if ((id_col_idx > maj_col_idx) || (maj_col_idx > pc1_col_idx) || (pc1_col_idx == UINT32_MAX) || header_iter) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s has an unexpected header line (ID, MAJ, and trailing PC1..PC{n} columns are required; generate it with --pca var-wts).\n", var_wts_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+    }
+    if (pc_ct != eigval_ct) {
+      snprintf(g_logbuf, kLogbufSize, "Error: %s has %u PC column%s, but %s has %u eigenvalue%s.\n", var_wts_fname, pc_ct, (pc_ct == 1)? "" : "s", eigval_fname, eigval_ct, (eigval_ct == 1)? "" : "s");
+      goto PcaProject_ret_INCONSISTENT_INPUT_WW;
+    }
+    const uint32_t maj_col_delta = maj_col_idx - id_col_idx;
+    const uint32_t pc1_col_delta = pc1_col_idx - maj_col_idx;
+    uint32_t ref_variant_ct = 0;
+    uint32_t proj_variant_ct = 0;
+    uint32_t missing_var_id_ct = 0;
+    uint32_t missing_allele_code_ct = 0;
+    uint32_t monomorphic_ct = 0;
+    uint32_t cur_allele_ct = 2;
+    while (1) {
+      ++line_idx;
+      reterr = RlsNextLstrip(&rls, &line_iter);
+      if (reterr) {
+        if (reterr == kPglRetEof) {
+          reterr = kPglRetSuccess;
+          break;
+        }
+        goto PcaProject_ret_READ_RLSTREAM;
+      }
+      if (IsEolnKns(*line_iter)) {
+        continue;
+      }
+      if (ref_variant_ct == UINT32_MAX) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Too many variants in %s.\n", var_wts_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+      ++ref_variant_ct;
+      char* variant_id_start = NextTokenMult0(line_iter, id_col_idx);
+      if (!variant_id_start) {
+        goto PcaProject_ret_MISSING_TOKENS;
+      }
+      char* variant_id_end = CurTokenEnd(variant_id_start);
+      const uint32_t variant_uidx = VariantIdDupflagHtableFind(variant_id_start, variant_ids, variant_id_htable, variant_id_end - variant_id_start, variant_id_htable_size, max_variant_id_slen);
+      if (variant_uidx >> 31) {
+        if (variant_uidx != UINT32_MAX) {
+          snprintf(g_logbuf, kLogbufSize, "Error: --pca-project variant ID '%s' appears multiple times in main dataset.\n", variant_ids[variant_uidx & 0x7fffffff]);
+          goto PcaProject_ret_INCONSISTENT_INPUT_WW;
+        }
+        ++missing_var_id_ct;
+        continue;
+      }
+      if (IsSet(proj_variant_include, variant_uidx)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Variant ID '%s' appears multiple times in %s.\n", variant_ids[variant_uidx], var_wts_fname);
+        goto PcaProject_ret_MALFORMED_INPUT_WW;
+      }
+      char* maj_start = NextTokenMult(variant_id_end, maj_col_delta);
+      if (!maj_start) {
+        goto PcaProject_ret_MISSING_TOKENS;
+      }
+      char* maj_end = CurTokenEnd(maj_start);
+      uintptr_t allele_idx_base;
+      if (!variant_allele_idxs) {
+        allele_idx_base = variant_uidx * 2;
+      } else {
+        allele_idx_base = variant_allele_idxs[variant_uidx];
+        cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - allele_idx_base;
+      }
+      const char* const* cur_alleles = &(allele_storage[allele_idx_base]);
+      const char maj_end_char = *maj_end;
+      *maj_end = '\0';
+      uint32_t maj_allele_idx = 0;
+      for (; maj_allele_idx < cur_allele_ct; ++maj_allele_idx) {
+        if (!strcmp(maj_start, cur_alleles[maj_allele_idx])) {
+          break;
+        }
+      }
+      *maj_end = maj_end_char;
+      if (maj_allele_idx == cur_allele_ct) {
+        ++missing_allele_code_ct;
+        continue;
+      }
+      const double maj_freq = GetAlleleFreq(&(allele_freqs[allele_idx_base - variant_uidx]), maj_allele_idx, cur_allele_ct);
+      if (2 * maj_freq * (1.0 - maj_freq) < kSmallEpsilon) {
+        // standardized genotype column is identically zero, so this variant
+        // couldn't have contributed anything
+        ++monomorphic_ct;
+        continue;
+      }
+      char* wts_iter = NextTokenMult(maj_end, pc1_col_delta);
+      if (!wts_iter) {
+        goto PcaProject_ret_MISSING_TOKENS;
+      }
+      double* cur_var_wts = &(var_wts_by_slot[proj_variant_ct * S_CAST(uintptr_t, pc_ct)]);
+      for (uint32_t pc_idx = 0; pc_idx < pc_ct; ++pc_idx) {
+        if (!wts_iter) {
+          goto PcaProject_ret_MISSING_TOKENS;
+        }
+        if (!ScanadvDouble(wts_iter, &(cur_var_wts[pc_idx]))) {
+          snprintf(g_logbuf, kLogbufSize, "Error: Invalid variant weight on line %" PRIuPTR " of %s.\n", line_idx, var_wts_fname);
+          goto PcaProject_ret_MALFORMED_INPUT_WW;
+        }
+        wts_iter = NextToken(wts_iter);
+      }
+      SetBit(variant_uidx, proj_variant_include);
+      variant_uidx_to_slot[variant_uidx] = proj_variant_ct++;
+      proj_maj_alleles[variant_uidx] = maj_allele_idx;
+    }
+    reterr = CleanupRLstream(&rls);
+    if (reterr) {
+      goto PcaProject_ret_1;
+    }
+    logprintfww("--pca-project: %u variant%s loaded from %s; %u present in main dataset with matching major allele and nonzero variance.\n", ref_variant_ct, (ref_variant_ct == 1)? "" : "s", var_wts_fname, proj_variant_ct);
+    if (missing_var_id_ct || missing_allele_code_ct || monomorphic_ct) {
+      logprintfww("Note: %u variant ID%s missing from main dataset, %u major allele code%s not found, and %u variant%s monomorphic; these contribute zero (mean-imputed).\n", missing_var_id_ct, (missing_var_id_ct == 1)? "" : "s", missing_allele_code_ct, (missing_allele_code_ct == 1)? "" : "s", monomorphic_ct, (monomorphic_ct == 1)? "" : "s");
+    }
+    if (!proj_variant_ct) {
+      logerrputs("Error: No --pca-project variants are usable.\n");
+      goto PcaProject_ret_INCONSISTENT_INPUT;
+    }
+    // also frees the .eigenvec.var read buffer
+    BigstackReset(variant_id_htable);
+
+    uint32_t calc_thread_ct = (max_thread_ct > 8)? (max_thread_ct - 1) : max_thread_ct;
+    if ((calc_thread_ct - 1) * kPcaVariantBlockSize >= proj_variant_ct) {
+      calc_thread_ct = 1 + (proj_variant_ct - 1) / kPcaVariantBlockSize;
+    }
+    const uint32_t raw_sample_ctl = BitCtToWordCt(raw_sample_ct);
+    const uint32_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+    const uint32_t sample_ctaw = BitCtToAlignedWordCt(sample_ct);
+    uint32_t* sample_include_cumulative_popcounts;
+    if (bigstack_alloc_u32(raw_sample_ctl, &sample_include_cumulative_popcounts) ||
+        bigstack_alloc_thread(calc_thread_ct, &ts.threads) ||
+        bigstack_alloc_dp(calc_thread_ct, &g_yy_bufs) ||
+        bigstack_alloc_dp(calc_thread_ct, &g_y_transpose_bufs) ||
+        bigstack_alloc_dp(calc_thread_ct, &g_g2_bb_part_bufs) ||
+        bigstack_alloc_dp(calc_thread_ct, &g_packed_col_bufs)) {
+      goto PcaProject_ret_NOMEM;
+    }
+    FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
+    const uintptr_t proj_size = sample_ct * S_CAST(uintptr_t, pc_ct);
+    const uintptr_t genovecs_alloc = RoundUpPow2(sample_ctaw2 * kPcaVariantBlockSize * sizeof(intptr_t), kCacheline);
+    const uintptr_t dosage_cts_alloc = RoundUpPow2(kPcaVariantBlockSize * sizeof(int32_t), kCacheline);
+    const uintptr_t dosage_presents_alloc = RoundUpPow2(sample_ctaw * kPcaVariantBlockSize * sizeof(intptr_t), kCacheline);
+    const uintptr_t dosage_main_alloc = RoundUpPow2(sample_ct * kPcaVariantBlockSize * sizeof(Dosage), kCacheline);
+    const uintptr_t cur_maj_freqs_alloc = RoundUpPow2(kPcaVariantBlockSize * sizeof(double), kCacheline);
+    const uintptr_t var_wts_alloc = RoundUpPow2(kPcaVariantBlockSize * pc_ct * sizeof(double), kCacheline);
+    const uintptr_t yy_alloc = RoundUpPow2(kPcaVariantBlockSize * sample_ct * sizeof(double), kCacheline);
+    const uintptr_t proj_part_alloc = RoundUpPow2(proj_size * sizeof(double), kCacheline);
+    const uintptr_t packed_col_alloc = RoundUpPow2(pc_ct * sizeof(double), kCacheline);
+    const uintptr_t per_thread_alloc = 2 * (genovecs_alloc + dosage_cts_alloc + dosage_presents_alloc + dosage_main_alloc + cur_maj_freqs_alloc + var_wts_alloc + yy_alloc) + proj_part_alloc + packed_col_alloc;
+    const uintptr_t bigstack_avail = bigstack_left();
+    if (per_thread_alloc * calc_thread_ct > bigstack_avail) {
+      if (bigstack_avail < per_thread_alloc) {
+        goto PcaProject_ret_NOMEM;
+      }
+      calc_thread_ct = bigstack_avail / per_thread_alloc;
+    }
+    ts.calc_thread_ct = calc_thread_ct;
+    for (uint32_t parity = 0; parity < 2; ++parity) {
+      g_genovecs[parity] = S_CAST(uintptr_t*, bigstack_alloc_raw(genovecs_alloc * calc_thread_ct));
+      g_dosage_cts[parity] = S_CAST(uint32_t*, bigstack_alloc_raw(dosage_cts_alloc * calc_thread_ct));
+      g_dosage_presents[parity] = S_CAST(uintptr_t*, bigstack_alloc_raw(dosage_presents_alloc * calc_thread_ct));
+      g_dosage_mains[parity] = S_CAST(Dosage*, bigstack_alloc_raw(dosage_main_alloc * calc_thread_ct));
+      g_cur_maj_freqs[parity] = S_CAST(double*, bigstack_alloc_raw(cur_maj_freqs_alloc * calc_thread_ct));
+      g_proj_var_wts[parity] = S_CAST(double*, bigstack_alloc_raw(var_wts_alloc * calc_thread_ct));
+    }
+    for (uint32_t tidx = 0; tidx < calc_thread_ct; ++tidx) {
+      g_yy_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(yy_alloc));
+      g_y_transpose_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(yy_alloc));
+      g_g2_bb_part_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(proj_part_alloc));
+      g_packed_col_bufs[tidx] = S_CAST(double*, bigstack_alloc_raw(packed_col_alloc));
+      ZeroDArr(proj_size, g_g2_bb_part_bufs[tidx]);
+    }
+    g_pca_sample_ct = sample_ct;
+    g_pc_ct = pc_ct;
+    g_error_ret = kPglRetSuccess;
+#ifdef __APPLE__
+    fputs("Projecting samples... ", stdout);
+#else
+    printf("Projecting samples (%u compute thread%s)... ", calc_thread_ct, (calc_thread_ct == 1)? "" : "s");
+#endif
+    fflush(stdout);
+    PgrClearLdCache(simple_pgrp);
+    ts.thread_func_ptr = PcaProjectThread;
+    uint32_t parity = 0;
+    uint32_t cur_variant_idx_start = 0;
+    uint32_t variant_uidx = 0;
+    while (1) {
+      uint32_t cur_batch_size = 0;
+      if (!ts.is_last_block) {
+        cur_batch_size = calc_thread_ct * kPcaVariantBlockSize;
+        uint32_t cur_variant_idx_end = cur_variant_idx_start + cur_batch_size;
+        if (cur_variant_idx_end > proj_variant_ct) {
+          cur_batch_size = proj_variant_ct - cur_variant_idx_start;
+          cur_variant_idx_end = proj_variant_ct;
+        }
+        uintptr_t* genovec_iter = g_genovecs[parity];
+        uint32_t* dosage_ct_iter = g_dosage_cts[parity];
+        uintptr_t* dosage_present_iter = g_dosage_presents[parity];
+        Dosage* dosage_main_iter = g_dosage_mains[parity];
+        double* maj_freqs_write_iter = g_cur_maj_freqs[parity];
+        double* var_wts_write_iter = g_proj_var_wts[parity];
+        for (uint32_t variant_idx = cur_variant_idx_start; variant_idx < cur_variant_idx_end; ++variant_uidx, ++variant_idx) {
+          MovU32To1Bit(proj_variant_include, &variant_uidx);
+          uint32_t dosage_ct;
+          reterr = PgrGetD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec_iter, dosage_present_iter, dosage_main_iter, &dosage_ct);
+          if (reterr) {
+            if (reterr == kPglRetMalformedInput) {
+              logputs("\n");
+              logerrputs("Error: Malformed .pgen file.\n");
+            }
+            goto PcaProject_ret_1;
+          }
+          const uint32_t maj_allele_idx = proj_maj_alleles[variant_uidx];
+          if (maj_allele_idx) {
+            GenovecInvertUnsafe(sample_ct, genovec_iter);
+            if (dosage_ct) {
+              BiallelicDosage16Invert(dosage_ct, dosage_main_iter);
+            }
+          }
+          ZeroTrailingQuaters(sample_ct, genovec_iter);
+          genovec_iter = &(genovec_iter[sample_ctaw2]);
+          *dosage_ct_iter++ = dosage_ct;
+          dosage_present_iter = &(dosage_present_iter[sample_ctaw]);
+          dosage_main_iter = &(dosage_main_iter[sample_ct]);
+          uintptr_t allele_idx_base;
+          if (!variant_allele_idxs) {
+            allele_idx_base = variant_uidx;
+          } else {
+            allele_idx_base = variant_allele_idxs[variant_uidx];
+            cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - allele_idx_base;
+            allele_idx_base -= variant_uidx;
+          }
+          *maj_freqs_write_iter++ = GetAlleleFreq(&(allele_freqs[allele_idx_base]), maj_allele_idx, cur_allele_ct);
+          memcpy(var_wts_write_iter, &(var_wts_by_slot[variant_uidx_to_slot[variant_uidx] * S_CAST(uintptr_t, pc_ct)]), pc_ct * sizeof(double));
+          var_wts_write_iter = &(var_wts_write_iter[pc_ct]);
+        }
+      }
+      if (cur_variant_idx_start) {
+        JoinThreads3z(&ts);
+        if (ts.is_last_block) {
+          break;
+        }
+      }
+      ts.is_last_block = (cur_variant_idx_start + cur_batch_size == proj_variant_ct);
+      g_cur_batch_size = cur_batch_size;
+      if (SpawnThreads3z(cur_variant_idx_start, &ts)) {
+        goto PcaProject_ret_THREAD_CREATE_FAIL;
+      }
+      cur_variant_idx_start += cur_batch_size;
+      parity = 1 - parity;
+    }
+    double* proj_smaj = g_g2_bb_part_bufs[0];
+    for (uint32_t tidx = 1; tidx < calc_thread_ct; ++tidx) {
+      const double* cur_proj_part = g_g2_bb_part_bufs[tidx];
+      for (uintptr_t ulii = 0; ulii < proj_size; ++ulii) {
+        proj_smaj[ulii] += cur_proj_part[ulii];
+      }
+    }
+    for (uint32_t pc_idx = 0; pc_idx < pc_ct; ++pc_idx) {
+      eigvals[pc_idx] = 1.0 / (u31tod(ref_variant_ct) * sqrt(eigvals[pc_idx]));
+    }
+    fputs("done.\n", stdout);
+
+    const char* sample_ids = siip->sample_ids;
+    const char* sids = siip->sids;
+    const uintptr_t max_sample_id_blen = siip->max_sample_id_blen;
+    const uintptr_t max_sid_blen = siip->max_sid_blen;
+    const uint32_t write_fid = FidColIsRequired(siip, 1);
+    const uint32_t write_sid = SidColIsRequired(sids, 1);
+    char* writebuf;
+    if (bigstack_alloc_c(kMaxMediumLine + max_sample_id_blen + max_sid_blen + 16 * pc_ct + 16, &writebuf)) {
+      goto PcaProject_ret_NOMEM;
+    }
+    char* writebuf_flush = &(writebuf[kMaxMediumLine]);
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".proj.eigenvec");
+    if (fopen_checked(outname, FOPEN_WB, &outfile)) {
+      goto PcaProject_ret_OPEN_FAIL;
+    }
+    char* write_iter = writebuf;
+    *write_iter++ = '#';
+    if (write_fid) {
+      write_iter = strcpya(write_iter, "FID\t");
+    }
+    write_iter = memcpyl3a(write_iter, "IID");
+    if (write_sid) {
+      write_iter = strcpya(write_iter, "\tSID");
+    }
+    for (uint32_t pc_idx = 0; pc_idx < pc_ct;) {
+      ++pc_idx;
+      write_iter = memcpyl3a(write_iter, "\tPC");
+      write_iter = u32toa(pc_idx, write_iter);
+    }
+    AppendBinaryEoln(&write_iter);
+    uint32_t sample_uidx = 0;
+    for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx, ++sample_uidx) {
+      MovU32To1Bit(sample_include, &sample_uidx);
+      const char* cur_sample_id = &(sample_ids[max_sample_id_blen * sample_uidx]);
+      if (!write_fid) {
+        cur_sample_id = AdvPastDelim(cur_sample_id, '\t');
+      }
+      write_iter = strcpya(write_iter, cur_sample_id);
+      if (write_sid) {
+        *write_iter++ = '\t';
+        if (sids) {
+          write_iter = strcpya(write_iter, &(sids[max_sid_blen * sample_uidx]));
+        } else {
+          *write_iter++ = '0';
+        }
+      }
+      const double* proj_iter = &(proj_smaj[sample_idx * S_CAST(uintptr_t, pc_ct)]);
+      for (uint32_t pc_idx = 0; pc_idx < pc_ct; ++pc_idx) {
+        *write_iter++ = '\t';
+        write_iter = dtoa_g(proj_iter[pc_idx] * eigvals[pc_idx], write_iter);
+      }
+      AppendBinaryEoln(&write_iter);
+      if (fwrite_ck(writebuf_flush, outfile, &write_iter)) {
+        goto PcaProject_ret_WRITE_FAIL;
+      }
+    }
+    if (fclose_flush_null(writebuf_flush, write_iter, &outfile)) {
+      goto PcaProject_ret_WRITE_FAIL;
+    }
+    logprintfww("--pca-project: Projected PC%s written to %s .\n", (pc_ct == 1)? "" : "s", outname);
+  }
+  while (0) {
+  PcaProject_ret_READ_RLSTREAM:
+    RLstreamErrPrint(cur_fname, &rls, &reterr);
+    break;
+  PcaProject_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  PcaProject_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
+  PcaProject_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  PcaProject_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  PcaProject_ret_MISSING_TOKENS:
+    logerrprintfww("Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idx, cur_fname);
+    reterr = kPglRetMalformedInput;
+    break;
+  PcaProject_ret_INCONSISTENT_INPUT_WW:
+    WordWrapB(0);
     logerrputsb();
-  CalcPca_ret_INCONSISTENT_INPUT:
+  PcaProject_ret_INCONSISTENT_INPUT:
     reterr = kPglRetInconsistentInput;
     break;
-  CalcPca_ret_THREAD_CREATE_FAIL:
+  PcaProject_ret_THREAD_CREATE_FAIL:
     reterr = kPglRetThreadCreateFail;
     break;
   }
- CalcPca_ret_1:
+ PcaProject_ret_1:
   CleanupThreads3z(&ts, &g_cur_batch_size);
-  BLAS_SET_NUM_THREADS(1);
-  CswriteCloseCond(&css, cswritep);
+  CleanupRLstream(&rls);
   fclose_cond(outfile);
-  if (grm) {
-    // nothing after --pca in the plink2 order of operations uses grm[]
-    BigstackReset(grm);
-  } else {
-    BigstackReset(bigstack_mark);
-  }
+  BigstackReset(bigstack_mark);
   return reterr;
 }
-#endif
 
 // to test: do we actually want cur_dosage_ints to be uint64_t* instead of
 // uint32_t*?
@@ -4578,25 +5719,202 @@ void FillCurDosageInts(const uintptr_t* genovec_buf, const uintptr_t* dosage_pre
 }
 
 CONSTU31(kScoreVariantBlockSize, 240);
-static double* g_dosages_vmaj[2] = {nullptr, nullptr};
+
+// minimum number of samples per compute thread shard; must be a multiple of
+// kBitsPerWord
+CONSTU31(kScoreMinSamplesPerThread, 4 * kBitsPerWord);
+
+// Score columns are grouped into chunks of this size (must be a power of 2)
+// for zero-skipping purposes: a variant block x column chunk submatrix with
+// all-zero coefficients doesn't participate in matrix multiplication.
+CONSTU31(kScoreColChunkSize, 64);
+
+// Everything the compute threads need to convert a variant's packed
+// genotypes/dosages to score-matrix entries.  The main thread handles
+// missingness bookkeeping and error checking, since those require a view of
+// all samples.
+typedef struct ScoreVariantDecodeStruct {
+  double geno_slope;
+  double geno_intercept;
+  // value assigned to missing males/nonmales; this is where chrX/chrY
+  // ploidy is handled
+  double male_missing_effect;
+  double nonmale_missing_effect;
+  uint32_t dosage_ct;
+  uint32_t is_diploid_p1;
+  // 0 = no special handling, 1 = chrY (zero out nonmales), 2 = chrX with
+  // --xchr-model 1 (halve male dosages)
+  uint32_t sex_mode;
+} ScoreVariantDecode;
+
+// Packed genotype data is double-buffered; the main thread loads block n+1
+// while the compute threads expand block n for their sample shard into
+// g_dosages_vmaj and then multiply.  Since each thread only touches its own
+// columns of g_dosages_vmaj and g_final_scores_cmaj, a single buffer suffices.
+// With the 'bin4' modifier, the g_score_fcoefs_cmaj/g_fdosages_vmaj/
+// g_final_fscores_cmaj single-precision buffers are used instead.
+static uintptr_t* g_score_genovecs[2] = {nullptr, nullptr};
+static uintptr_t* g_score_dosage_presents[2] = {nullptr, nullptr};
+static Dosage* g_score_dosage_mains[2] = {nullptr, nullptr};
+static uintptr_t* g_score_missings[2] = {nullptr, nullptr};
+static ScoreVariantDecode* g_score_decodes[2] = {nullptr, nullptr};
 static double* g_score_coefs_cmaj[2] = {nullptr, nullptr};
-// don't bother to explicitly multithread for now
+static float* g_score_fcoefs_cmaj[2] = {nullptr, nullptr};
+// bit i set iff column chunk i has a nonzero coefficient in the current block
+static uintptr_t* g_score_nonzero_chunks[2] = {nullptr, nullptr};
+static double* g_dosages_vmaj = nullptr;
+static float* g_fdosages_vmaj = nullptr;
 static double* g_final_scores_cmaj = nullptr;
+static float* g_final_fscores_cmaj = nullptr;
+static uint64_t* g_score_dosage_incrs = nullptr;
+static uint64_t* g_score_dosage_sums = nullptr;
+static const uintptr_t* g_score_sex_nonmale_collapsed = nullptr;
+static uint32_t* g_score_thread_sample_starts = nullptr;
+static uintptr_t g_score_dosage_main_stride = 0;
+// number of score columns handled in the current pass
 static uint32_t g_score_col_ct = 0;
 static uint32_t g_sample_ct = 0;
+static uint32_t g_score_model = 0;  // 0 = additive, 1 = dominant, 2 = recessive
+static uint32_t g_score_se_mode = 0;
+static uint32_t g_score_use_float = 0;
 
 THREAD_FUNC_DECL CalcScoreThread(void* arg) {
   const uintptr_t tidx = R_CAST(uintptr_t, arg);
-  assert(!tidx);
-  double* final_scores_cmaj = g_final_scores_cmaj;
   const uint32_t score_col_ct = g_score_col_ct;
   const uint32_t sample_ct = g_sample_ct;
+  const uintptr_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+  const uintptr_t sample_ctaw = BitCtToAlignedWordCt(sample_ct);
+  const uintptr_t dosage_main_stride = g_score_dosage_main_stride;
+  const uint32_t score_model = g_score_model;
+  const uint32_t se_mode = g_score_se_mode;
+  // shard boundaries are word-aligned
+  const uint32_t sample_start = g_score_thread_sample_starts[tidx];
+  const uint32_t shard_sample_ct = g_score_thread_sample_starts[tidx + 1] - sample_start;
+  const uint32_t sample_widx = sample_start / kBitsPerWord;
+  const uint32_t shard_sample_ctl = BitCtToWordCt(shard_sample_ct);
+  const uintptr_t* sex_nonmale = &(g_score_sex_nonmale_collapsed[sample_widx]);
+  const uint32_t shard_nonmale_ct = PopcountWords(sex_nonmale, shard_sample_ctl);
+  const uint32_t shard_male_ct = shard_sample_ct - shard_nonmale_ct;
+  const uint32_t chunk_ct = DivUp(score_col_ct, kScoreColChunkSize);
+  uint64_t* dosage_incrs = &(g_score_dosage_incrs[sample_start]);
+  uint64_t* dosage_sums = &(g_score_dosage_sums[sample_start]);
+  const uint32_t use_float = g_score_use_float;
+  double* shard_dosages_vmaj = nullptr;
+  float* shard_fdosages_vmaj = nullptr;
+  double* final_scores_cmaj = nullptr;
+  float* final_fscores_cmaj = nullptr;
+  if (use_float) {
+    shard_fdosages_vmaj = &(g_fdosages_vmaj[sample_start]);
+    final_fscores_cmaj = &(g_final_fscores_cmaj[sample_start]);
+  } else {
+    shard_dosages_vmaj = &(g_dosages_vmaj[sample_start]);
+    final_scores_cmaj = &(g_final_scores_cmaj[sample_start]);
+  }
   uint32_t parity = 0;
   while (1) {
     const uint32_t is_last_batch = g_is_last_thread_block;
     const uint32_t cur_batch_size = g_cur_batch_size;
-    if (cur_batch_size) {
-      RowMajorMatrixMultiplyStridedIncr(g_score_coefs_cmaj[parity], g_dosages_vmaj[parity], score_col_ct, kScoreVariantBlockSize, sample_ct, sample_ct, cur_batch_size, sample_ct, final_scores_cmaj);
+    if (cur_batch_size && shard_sample_ct) {
+      const uintptr_t* genovec_iter = &(g_score_genovecs[parity][sample_start / kBitsPerWordD2]);
+      const uintptr_t* dosage_present_iter = g_score_dosage_presents[parity];
+      const Dosage* dosage_main_iter = g_score_dosage_mains[parity];
+      const uintptr_t* missing_iter = &(g_score_missings[parity][sample_widx]);
+      const ScoreVariantDecode* decode_iter = g_score_decodes[parity];
+      double* dosages_vmaj_iter = shard_dosages_vmaj;
+      float* fdosages_vmaj_iter = shard_fdosages_vmaj;
+      for (uint32_t block_vidx = 0; block_vidx < cur_batch_size; ++block_vidx) {
+        const uint32_t dosage_ct = decode_iter->dosage_ct;
+        const uintptr_t* shard_dosage_present = &(dosage_present_iter[sample_widx]);
+        const Dosage* shard_dosage_main = dosage_main_iter;
+        uint32_t shard_dosage_ct = 0;
+        if (dosage_ct) {
+          shard_dosage_main = &(shard_dosage_main[PopcountWords(dosage_present_iter, sample_widx)]);
+          shard_dosage_ct = PopcountWords(shard_dosage_present, shard_sample_ctl);
+        }
+        FillCurDosageInts(genovec_iter, shard_dosage_present, shard_dosage_main, shard_sample_ct, shard_dosage_ct, decode_iter->is_diploid_p1, dosage_incrs);
+        const uint32_t sex_mode = decode_iter->sex_mode;
+        if (sex_mode == 1) {
+          uint32_t sample_idx = 0;
+          for (uint32_t nonmale_idx = 0; nonmale_idx < shard_nonmale_ct; ++nonmale_idx, ++sample_idx) {
+            MovU32To1Bit(sex_nonmale, &sample_idx);
+            dosage_incrs[sample_idx] = 0;
+          }
+        } else if (sex_mode == 2) {
+          uint32_t sample_idx = 0;
+          for (uint32_t male_idx = 0; male_idx < shard_male_ct; ++male_idx, ++sample_idx) {
+            MovU32To0Bit(sex_nonmale, &sample_idx);
+            dosage_incrs[sample_idx] /= 2;
+          }
+        }
+        if (score_model == 1) {
+          for (uint32_t sample_idx = 0; sample_idx < shard_sample_ct; ++sample_idx) {
+            if (dosage_incrs[sample_idx] > kDosageMax) {
+              dosage_incrs[sample_idx] = kDosageMax;
+            }
+          }
+        } else if (score_model == 2) {
+          for (uint32_t sample_idx = 0; sample_idx < shard_sample_ct; ++sample_idx) {
+            uint64_t cur_dosage_incr = dosage_incrs[sample_idx];
+            if (cur_dosage_incr <= kDosageMax) {
+              cur_dosage_incr = 0;
+            } else {
+              cur_dosage_incr -= kDosageMax;
+            }
+            dosage_incrs[sample_idx] = cur_dosage_incr;
+          }
+        }
+        const double geno_slope = decode_iter->geno_slope;
+        const double geno_intercept = decode_iter->geno_intercept;
+        const double male_missing_effect = decode_iter->male_missing_effect;
+        const double nonmale_missing_effect = decode_iter->nonmale_missing_effect;
+        for (uint32_t sample_idx = 0; sample_idx < shard_sample_ct; ++sample_idx) {
+          const uint64_t cur_dosage_incr = dosage_incrs[sample_idx];
+          dosage_sums[sample_idx] += cur_dosage_incr;
+          double cur_val;
+          if (!IsSet(missing_iter, sample_idx)) {
+            cur_val = u63tod(cur_dosage_incr) * geno_slope + geno_intercept;
+          } else {
+            cur_val = IsSet(sex_nonmale, sample_idx)? nonmale_missing_effect : male_missing_effect;
+          }
+          if (se_mode) {
+            // see comment in ScoreReport()
+            cur_val *= cur_val;
+          }
+          if (use_float) {
+            fdosages_vmaj_iter[sample_idx] = S_CAST(float, cur_val);
+          } else {
+            dosages_vmaj_iter[sample_idx] = cur_val;
+          }
+        }
+        genovec_iter = &(genovec_iter[sample_ctaw2]);
+        dosage_present_iter = &(dosage_present_iter[sample_ctaw]);
+        dosage_main_iter = &(dosage_main_iter[dosage_main_stride]);
+        missing_iter = &(missing_iter[sample_ctaw]);
+        ++decode_iter;
+        if (use_float) {
+          fdosages_vmaj_iter = &(fdosages_vmaj_iter[sample_ct]);
+        } else {
+          dosages_vmaj_iter = &(dosages_vmaj_iter[sample_ct]);
+        }
+      }
+      // one matrix multiplication per run of column chunks with nonzero
+      // coefficients
+      const uintptr_t* nonzero_chunks = g_score_nonzero_chunks[parity];
+      uint32_t chunk_end = 0;
+      while (1) {
+        const uint32_t chunk_start = AdvBoundedTo1Bit(nonzero_chunks, chunk_end, chunk_ct);
+        if (chunk_start == chunk_ct) {
+          break;
+        }
+        chunk_end = AdvBoundedTo0Bit(nonzero_chunks, chunk_start, chunk_ct);
+        const uintptr_t col_start = chunk_start * kScoreColChunkSize;
+        const uint32_t run_col_ct = MINV(chunk_end * kScoreColChunkSize, score_col_ct) - col_start;
+        if (use_float) {
+          RowMajorFmatrixMultiplyStridedIncr(&(g_score_fcoefs_cmaj[parity][col_start * kScoreVariantBlockSize]), shard_fdosages_vmaj, run_col_ct, kScoreVariantBlockSize, shard_sample_ct, sample_ct, cur_batch_size, sample_ct, &(final_fscores_cmaj[col_start * sample_ct]));
+        } else {
+          RowMajorMatrixMultiplyStridedIncr(&(g_score_coefs_cmaj[parity][col_start * kScoreVariantBlockSize]), shard_dosages_vmaj, run_col_ct, kScoreVariantBlockSize, shard_sample_ct, sample_ct, cur_batch_size, sample_ct, &(final_scores_cmaj[col_start * sample_ct]));
+        }
+      }
     }
     if (is_last_batch) {
       THREAD_RETURN;
@@ -4606,11 +5924,12 @@ THREAD_FUNC_DECL CalcScoreThread(void* arg) {
   }
 }
 
-PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const ScoreInfo* score_info_ptr, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t xchr_model, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end) {
+PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const ScoreInfo* score_info_ptr, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t xchr_model, uint32_t max_thread_ct, PgenReader* simple_pgrp, BgenReader* bgen_direct_rp, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   unsigned char* bigstack_end_mark = g_bigstack_end;
   uintptr_t line_idx = 0;
   char* cswritep = nullptr;
+  FILE* binfile = nullptr;
   PglErr reterr = kPglRetSuccess;
   ReadLineStream score_rls;
   ThreadsState ts;
@@ -4632,6 +5951,9 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
             goto ScoreReport_ret_NOMEM;
           }
           memcpy(variant_include_no_x, variant_include, raw_variant_ctl * sizeof(intptr_t));
+          // bugfix: variant_ct must be kept in sync, otherwise the ID hash
+          // table loader walks past the end of variant_include
+          variant_ct -= PopcountBitRange(variant_include, x_start, x_end);
           ClearBitsNz(x_start, x_end, variant_include_no_x);
           variant_include = variant_include_no_x;
         }
@@ -4741,71 +6063,100 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
     }
     BigstackBaseSet(write_iter);
 
-    g_score_col_ct = score_col_ct;
     g_sample_ct = sample_ct;
-    g_cur_batch_size = kScoreVariantBlockSize;
-    ts.calc_thread_ct = 1;
+    uint32_t calc_thread_ct = (max_thread_ct > 8)? (max_thread_ct - 1) : max_thread_ct;
+    if (calc_thread_ct * kScoreMinSamplesPerThread > sample_ct) {
+      calc_thread_ct = 1 + (sample_ct - 1) / kScoreMinSamplesPerThread;
+    }
+    ts.calc_thread_ct = calc_thread_ct;
     const uint32_t raw_sample_ctl = BitCtToWordCt(raw_sample_ct);
-    const uint32_t sample_ctl2 = QuaterCtToWordCt(sample_ct);
+    const uint32_t sample_ctaw2 = QuaterCtToAlignedWordCt(sample_ct);
+    const uint32_t sample_ctaw = BitCtToAlignedWordCt(sample_ct);
     const uint32_t sample_ctl = BitCtToWordCt(sample_ct);
     const uint32_t acc1_vec_ct = BitCtToVecCt(sample_ct);
     const uint32_t acc4_vec_ct = acc1_vec_ct * 4;
     const uint32_t acc8_vec_ct = acc1_vec_ct * 8;
-    const uint32_t write_score_avgs = (score_flags / kfScoreColScoreAvgs) & 1;
-    const uint32_t write_score_sums = (score_flags / kfScoreColScoreSums) & 1;
+    // With 'bin'/'bin4', the score matrix goes to a separate binary file, and
+    // the score columns are allowed to be processed in multiple passes when
+    // they don't all fit in memory.
+    const uint32_t output_bin = (score_flags & (kfScoreBin | kfScoreBin4))? 1 : 0;
+    const uint32_t use_float = (score_flags / kfScoreBin4) & 1;
+    const uint32_t bin_score_sums = output_bin && (!(score_flags & kfScoreColScoreAvgs));
+    const uint32_t write_score_avgs = (!output_bin) && (score_flags & kfScoreColScoreAvgs);
+    const uint32_t write_score_sums = (!output_bin) && (score_flags & kfScoreColScoreSums);
     const uintptr_t overflow_buf_size = RoundUpPow2((score_col_ct * (write_score_avgs + write_score_sums) + pheno_ct) * 16 + 3 * kMaxIdSlen + kCompressStreamBlock + 64, kCacheline);
     uintptr_t overflow_buf_alloc = overflow_buf_size;
     if (score_flags & (kfScoreZs | kfScoreListVariantsZs)) {
       overflow_buf_alloc += CstreamWkspaceReq(overflow_buf_size);
     }
+    // no need to reserve dosage_main space when the .pgen has no dosages
+    const uintptr_t dosage_main_stride = (bgen_direct_rp || (simple_pgrp->fi.gflags & kfPgenGlobalDosagePresent))? sample_ct : 0;
     uint32_t* sample_include_cumulative_popcounts = nullptr;
     uintptr_t* sex_nonmale_collapsed = nullptr;
-    uintptr_t* genovec_buf = nullptr;
-    uintptr_t* dosage_present_buf = nullptr;
-    Dosage* dosage_main_buf = nullptr;
     uintptr_t* missing_acc1 = nullptr;
     uintptr_t* missing_male_acc1 = nullptr;
     uint64_t* dosage_sums;
-    uint64_t* dosage_incrs;
     uintptr_t* already_seen;
     char* overflow_buf = nullptr;
-    if (bigstack_alloc_thread(1, &ts.threads) ||
-        bigstack_alloc_d((kScoreVariantBlockSize * k1LU) * sample_ct, &(g_dosages_vmaj[0])) ||
-        bigstack_alloc_d((kScoreVariantBlockSize * k1LU) * sample_ct, &(g_dosages_vmaj[1])) ||
-        bigstack_alloc_d(kScoreVariantBlockSize * score_col_ct, &(g_score_coefs_cmaj[0])) ||
-        bigstack_alloc_d(kScoreVariantBlockSize * score_col_ct, &(g_score_coefs_cmaj[1])) ||
-        bigstack_calloc_d(score_col_ct * sample_ct, &g_final_scores_cmaj) ||
+    if (bigstack_alloc_thread(calc_thread_ct, &ts.threads) ||
+        bigstack_alloc_u32(calc_thread_ct + 1, &g_score_thread_sample_starts) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw2, &(g_score_genovecs[0])) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw2, &(g_score_genovecs[1])) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw, &(g_score_dosage_presents[0])) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw, &(g_score_dosage_presents[1])) ||
+        bigstack_alloc_dosage(kScoreVariantBlockSize * dosage_main_stride + sample_ct, &(g_score_dosage_mains[0])) ||
+        bigstack_alloc_dosage(kScoreVariantBlockSize * dosage_main_stride + sample_ct, &(g_score_dosage_mains[1])) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw, &(g_score_missings[0])) ||
+        bigstack_alloc_w(kScoreVariantBlockSize * sample_ctaw, &(g_score_missings[1])) ||
         // bugfix (4 Nov 2017): need raw_sample_ctl here, not sample_ctl
         bigstack_alloc_u32(raw_sample_ctl, &sample_include_cumulative_popcounts) ||
         bigstack_alloc_w(sample_ctl, &sex_nonmale_collapsed) ||
-        bigstack_alloc_w(sample_ctl2, &genovec_buf) ||
-        bigstack_alloc_w(sample_ctl, &dosage_present_buf) ||
-        bigstack_alloc_dosage(sample_ct, &dosage_main_buf) ||
         bigstack_alloc_w(45 * acc1_vec_ct * kWordsPerVec, &missing_acc1) ||
         bigstack_alloc_w(45 * acc1_vec_ct * kWordsPerVec, &missing_male_acc1) ||
-        bigstack_calloc_u64(sample_ct, &dosage_sums) ||
-        bigstack_calloc_u64(sample_ct, &dosage_incrs) ||
+        bigstack_alloc_u64(sample_ct, &dosage_sums) ||
+        bigstack_alloc_u64(sample_ct, &g_score_dosage_incrs) ||
         bigstack_calloc_w(raw_variant_ctl, &already_seen) ||
         bigstack_alloc_c(overflow_buf_alloc, &overflow_buf)) {
       goto ScoreReport_ret_NOMEM;
     }
+    g_score_decodes[0] = S_CAST(ScoreVariantDecode*, bigstack_alloc(kScoreVariantBlockSize * sizeof(ScoreVariantDecode)));
+    g_score_decodes[1] = S_CAST(ScoreVariantDecode*, bigstack_alloc(kScoreVariantBlockSize * sizeof(ScoreVariantDecode)));
+    if ((!g_score_decodes[0]) || (!g_score_decodes[1])) {
+      goto ScoreReport_ret_NOMEM;
+    }
+    double* bin_score_multipliers = nullptr;
+    if (output_bin) {
+      if (bigstack_alloc_d(sample_ct, &bin_score_multipliers)) {
+        goto ScoreReport_ret_NOMEM;
+      }
+    }
+    if (use_float) {
+      if (bigstack_alloc_f((kScoreVariantBlockSize * k1LU) * sample_ct, &g_fdosages_vmaj)) {
+        goto ScoreReport_ret_NOMEM;
+      }
+    } else {
+      if (bigstack_alloc_d((kScoreVariantBlockSize * k1LU) * sample_ct, &g_dosages_vmaj)) {
+        goto ScoreReport_ret_NOMEM;
+      }
+    }
+    g_score_dosage_main_stride = dosage_main_stride;
+    g_score_use_float = use_float;
+    g_score_dosage_sums = dosage_sums;
+    g_score_sex_nonmale_collapsed = sex_nonmale_collapsed;
+    g_score_thread_sample_starts[0] = 0;
+    for (uint32_t tidx = 1; tidx < calc_thread_ct; ++tidx) {
+      g_score_thread_sample_starts[tidx] = RoundDownPow2((S_CAST(uint64_t, sample_ct) * tidx) / calc_thread_ct, kBitsPerWord);
+    }
+    g_score_thread_sample_starts[calc_thread_ct] = sample_ct;
     uintptr_t* missing_diploid_acc4 = &(missing_acc1[acc1_vec_ct * kWordsPerVec]);
     uintptr_t* missing_diploid_acc8 = &(missing_diploid_acc4[acc4_vec_ct * kWordsPerVec]);
     uintptr_t* missing_diploid_acc32 = &(missing_diploid_acc8[acc8_vec_ct * kWordsPerVec]);
     uintptr_t* missing_haploid_acc4 = &(missing_male_acc1[acc1_vec_ct * kWordsPerVec]);
     uintptr_t* missing_haploid_acc8 = &(missing_haploid_acc4[acc4_vec_ct * kWordsPerVec]);
     uintptr_t* missing_haploid_acc32 = &(missing_haploid_acc8[acc8_vec_ct * kWordsPerVec]);
-    ZeroWArr(acc4_vec_ct * kWordsPerVec, missing_diploid_acc4);
-    ZeroWArr(acc8_vec_ct * kWordsPerVec, missing_diploid_acc8);
-    ZeroWArr(acc8_vec_ct * (4 * kWordsPerVec), missing_diploid_acc32);
-    ZeroWArr(acc4_vec_ct * kWordsPerVec, missing_haploid_acc4);
-    ZeroWArr(acc8_vec_ct * kWordsPerVec, missing_haploid_acc8);
-    ZeroWArr(acc8_vec_ct * (4 * kWordsPerVec), missing_haploid_acc32);
     FillCumulativePopcounts(sample_include, raw_sample_ctl, sample_include_cumulative_popcounts);
     CopyBitarrSubset(sex_male, sample_include, sample_ct, sex_nonmale_collapsed);
     AlignedBitarrInvert(sample_ct, sex_nonmale_collapsed);
-    const uint32_t nonmale_ct = PopcountWords(sex_nonmale_collapsed, sample_ctl);
-    const uint32_t male_ct = sample_ct - nonmale_ct;
     uint32_t* variant_id_htable = nullptr;
     uint32_t variant_id_htable_size;
     reterr = AllocAndPopulateIdHtableMt(variant_include, variant_ids, variant_ct, max_thread_ct, &variant_id_htable, nullptr, &variant_id_htable_size);
@@ -4813,6 +6164,57 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
       goto ScoreReport_ret_1;
     }
 
+    // The sample x score accumulator matrix dominates memory usage for very
+    // wide score files.  In binary-output mode, we process as many score
+    // columns per pass as fit in the remaining workspace, rereading the
+    // --score file and .pgen once per pass.
+    uintptr_t pass_col_ct = score_col_ct;
+    const uintptr_t score_elem_size = use_float? sizeof(float) : sizeof(double);
+    if (output_bin) {
+      const uintptr_t per_col_byte_ct = (sample_ct + 2 * kScoreVariantBlockSize) * score_elem_size;
+      const uintptr_t fixed_byte_ct = 2 * RoundUpPow2(BitCtToWordCt(DivUp(score_col_ct, kScoreColChunkSize)) * sizeof(intptr_t), kCacheline) + 3 * kCacheline;
+      const uintptr_t bytes_avail = bigstack_left();
+      if (bytes_avail < fixed_byte_ct + per_col_byte_ct) {
+        goto ScoreReport_ret_NOMEM;
+      }
+      const uintptr_t max_pass_col_ct = (bytes_avail - fixed_byte_ct) / per_col_byte_ct;
+      if (max_pass_col_ct < score_col_ct) {
+        pass_col_ct = max_pass_col_ct;
+        if (pass_col_ct > kScoreColChunkSize) {
+          pass_col_ct = RoundDownPow2(pass_col_ct, kScoreColChunkSize);
+        }
+      }
+    }
+    const uint32_t pass_ct = DivUp(score_col_ct, pass_col_ct);
+    const uint32_t max_chunk_ct = DivUp(pass_col_ct, kScoreColChunkSize);
+    const uint32_t max_chunk_ctl = BitCtToWordCt(max_chunk_ct);
+    if (bigstack_alloc_w(max_chunk_ctl, &(g_score_nonzero_chunks[0])) ||
+        bigstack_alloc_w(max_chunk_ctl, &(g_score_nonzero_chunks[1]))) {
+      goto ScoreReport_ret_NOMEM;
+    }
+    if (use_float) {
+      if (bigstack_alloc_f(kScoreVariantBlockSize * pass_col_ct, &(g_score_fcoefs_cmaj[0])) ||
+          bigstack_alloc_f(kScoreVariantBlockSize * pass_col_ct, &(g_score_fcoefs_cmaj[1])) ||
+          bigstack_alloc_f(pass_col_ct * sample_ct, &g_final_fscores_cmaj)) {
+        goto ScoreReport_ret_NOMEM;
+      }
+    } else {
+      if (bigstack_alloc_d(kScoreVariantBlockSize * pass_col_ct, &(g_score_coefs_cmaj[0])) ||
+          bigstack_alloc_d(kScoreVariantBlockSize * pass_col_ct, &(g_score_coefs_cmaj[1])) ||
+          bigstack_alloc_d(pass_col_ct * sample_ct, &g_final_scores_cmaj)) {
+        goto ScoreReport_ret_NOMEM;
+      }
+    }
+    if (pass_ct > 1) {
+      logprintf("--score: %" PRIuPTR " score columns, %" PRIuPTR " per pass (%u passes).\n", score_col_ct, pass_col_ct, pass_ct);
+    }
+    if (output_bin) {
+      snprintf(outname_end, kMaxOutfnameExtBlen, ".sscore.bin");
+      if (fopen_checked(outname, FOPEN_WB, &binfile)) {
+        goto ScoreReport_ret_OPEN_FAIL;
+      }
+    }
+
     const uint32_t list_variants = (score_flags / kfScoreListVariants) & 1;
     if (list_variants) {
       const uint32_t output_zst = (score_flags / kfScoreListVariantsZs) & 1;
@@ -4833,159 +6235,178 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
     const uint32_t center = variance_standardize || (score_flags & kfScoreCenter);
     const uint32_t no_meanimpute = (score_flags / kfScoreNoMeanimpute) & 1;
     const uint32_t se_mode = (score_flags / kfScoreSe) & 1;
-    uint32_t block_vidx = 0;
-    uint32_t parity = 0;
+    g_score_model = domrec? (2 - model_dominant) : 0;
+    g_score_se_mode = se_mode;
     uint32_t cur_allele_ct = 2;
-    double* cur_dosages_vmaj_iter = g_dosages_vmaj[0];
-    double* cur_score_coefs_cmaj = g_score_coefs_cmaj[0];
     double geno_slope = kRecipDosageMax;
     double geno_intercept = 0.0;
-    uint32_t variant_ct_rem15 = 15;
-    uint32_t variant_ct_rem255d15 = 17;
-    uint32_t variant_hap_ct_rem15 = 15;
-    uint32_t variant_hap_ct_rem255d15 = 17;
     uint32_t allele_ct_base = 0;
     int32_t male_allele_ct_delta = 0;
     uint32_t valid_variant_ct = 0;
-    uintptr_t missing_var_id_ct = 0;
-    uintptr_t missing_allele_code_ct = 0;
-#ifdef USE_MTBLAS
-    const uint32_t matrix_multiply_thread_ct = (max_thread_ct > 1)? (max_thread_ct - 1) : 1;
-    BLAS_SET_NUM_THREADS(matrix_multiply_thread_ct);
-#endif
-    PgrClearLdCache(simple_pgrp);
-    while (1) {
-      if (!IsEolnKns(*linebuf_first_token)) {
-        // varid_col_idx and allele_col_idx will almost always be very small
-        char* variant_id_start = NextTokenMult0(linebuf_first_token, varid_col_idx);
-        if (!variant_id_start) {
-          goto ScoreReport_ret_MISSING_TOKENS;
-        }
-        char* variant_id_token_end = CurTokenEnd(variant_id_start);
-        const uint32_t variant_id_slen = variant_id_token_end - variant_id_start;
-        uint32_t variant_uidx = VariantIdDupflagHtableFind(variant_id_start, variant_ids, variant_id_htable, variant_id_slen, variant_id_htable_size, max_variant_id_slen);
-        if (!(variant_uidx >> 31)) {
-          if (IsSet(already_seen, variant_uidx)) {
-            snprintf(g_logbuf, kLogbufSize, "Error: Variant ID '%s' appears multiple times in --score file.\n", variant_ids[variant_uidx]);
-            goto ScoreReport_ret_MALFORMED_INPUT_WW;
+    // Missingness/dosage-sum bookkeeping is cheap relative to the matrix
+    // multiplications, so it's just redone on each pass.
+    for (uint32_t pass_idx = 0; pass_idx < pass_ct; ++pass_idx) {
+      const uintptr_t pass_col_start = pass_idx * pass_col_ct;
+      const uintptr_t pass_col_end = MINV(pass_col_start + pass_col_ct, score_col_ct);
+      const uint32_t cur_pass_col_ct = pass_col_end - pass_col_start;
+      const uint32_t cur_chunk_ctl = BitCtToWordCt(DivUp(cur_pass_col_ct, kScoreColChunkSize));
+      if (pass_idx) {
+        reterr = RewindRLstreamRaw(&score_rls, &line_iter);
+        if (reterr) {
+          goto ScoreReport_ret_READ_RLSTREAM;
+        }
+        line_idx = 0;
+        for (uint32_t uii = 0; uii < nonempty_lines_to_skip_p1; ++uii) {
+          reterr = RlsNextNonemptyLstrip(&score_rls, &line_idx, &line_iter);
+          if (reterr) {
+            goto ScoreReport_ret_READ_RLSTREAM;
           }
-          SetBit(variant_uidx, already_seen);
-          char* allele_start = NextTokenMult0(linebuf_first_token, allele_col_idx);
-          if (!allele_start) {
+        }
+        linebuf_first_token = line_iter;
+        if (score_flags & kfScoreHeaderRead) {
+          linebuf_first_token = AdvToDelim(line_iter, '\n');
+        }
+        ZeroWArr(raw_variant_ctl, already_seen);
+        ReinitThreads3z(&ts);
+        ts.thread_func_ptr = nullptr;
+      }
+      g_score_col_ct = cur_pass_col_ct;
+      g_cur_batch_size = kScoreVariantBlockSize;
+      if (use_float) {
+        ZeroFArr(S_CAST(uintptr_t, cur_pass_col_ct) * sample_ct, g_final_fscores_cmaj);
+      } else {
+        ZeroDArr(S_CAST(uintptr_t, cur_pass_col_ct) * sample_ct, g_final_scores_cmaj);
+      }
+      ZeroWArr(cur_chunk_ctl, g_score_nonzero_chunks[0]);
+      ZeroU64Arr(sample_ct, dosage_sums);
+      ZeroWArr(acc4_vec_ct * kWordsPerVec, missing_diploid_acc4);
+      ZeroWArr(acc8_vec_ct * kWordsPerVec, missing_diploid_acc8);
+      ZeroWArr(acc8_vec_ct * (4 * kWordsPerVec), missing_diploid_acc32);
+      ZeroWArr(acc4_vec_ct * kWordsPerVec, missing_haploid_acc4);
+      ZeroWArr(acc8_vec_ct * kWordsPerVec, missing_haploid_acc8);
+      ZeroWArr(acc8_vec_ct * (4 * kWordsPerVec), missing_haploid_acc32);
+      uint32_t block_vidx = 0;
+      uint32_t parity = 0;
+      uintptr_t* genovec_buf = g_score_genovecs[0];
+      uintptr_t* dosage_present_buf = g_score_dosage_presents[0];
+      Dosage* dosage_main_buf = g_score_dosage_mains[0];
+      uintptr_t* cur_missing_iter = g_score_missings[0];
+      ScoreVariantDecode* cur_decode_iter = g_score_decodes[0];
+      double* cur_score_coefs_cmaj = g_score_coefs_cmaj[0];
+      float* cur_score_fcoefs_cmaj = g_score_fcoefs_cmaj[0];
+      uintptr_t* cur_nonzero_chunks = g_score_nonzero_chunks[0];
+      uint32_t variant_ct_rem15 = 15;
+      uint32_t variant_ct_rem255d15 = 17;
+      uint32_t variant_hap_ct_rem15 = 15;
+      uint32_t variant_hap_ct_rem255d15 = 17;
+      allele_ct_base = 0;
+      male_allele_ct_delta = 0;
+      valid_variant_ct = 0;
+      uintptr_t missing_var_id_ct = 0;
+      uintptr_t missing_allele_code_ct = 0;
+      if (!bgen_direct_rp) {
+        PgrClearLdCache(simple_pgrp);
+      }
+      while (1) {
+        if (!IsEolnKns(*linebuf_first_token)) {
+          // varid_col_idx and allele_col_idx will almost always be very small
+          char* variant_id_start = NextTokenMult0(linebuf_first_token, varid_col_idx);
+          if (!variant_id_start) {
             goto ScoreReport_ret_MISSING_TOKENS;
           }
-          uintptr_t variant_allele_idx_base;
-          if (!variant_allele_idxs) {
-            variant_allele_idx_base = variant_uidx * 2;
-          } else {
-            variant_allele_idx_base = variant_allele_idxs[variant_uidx];
-            cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
-          }
-          char* allele_end = CurTokenEnd(allele_start);
-          char allele_end_char = *allele_end;
-          *allele_end = '\0';
-          const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
-          uint32_t cur_allele_idx = 0;
-          for (; cur_allele_idx < cur_allele_ct; ++cur_allele_idx) {
-            // for very long alleles, tokequal_k might read past the end of the
-            // workspace, so just use plain strcmp.
-            if (!strcmp(allele_start, cur_alleles[cur_allele_idx])) {
-              break;
-            }
-          }
-          if (cur_allele_idx != cur_allele_ct) {
-            // okay, the variant and allele are in our dataset.  Load it.
-            // (todo: make this work in multiallelic case)
-            uint32_t dosage_ct;
-            reterr = PgrGetD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec_buf, dosage_present_buf, dosage_main_buf, &dosage_ct);
-            if (reterr) {
-              if (reterr == kPglRetMalformedInput) {
-                logputs("\n");
-                logerrputs("Error: Malformed .pgen file.\n");
-              }
-              goto ScoreReport_ret_1;
+          char* variant_id_token_end = CurTokenEnd(variant_id_start);
+          const uint32_t variant_id_slen = variant_id_token_end - variant_id_start;
+          uint32_t variant_uidx = VariantIdDupflagHtableFind(variant_id_start, variant_ids, variant_id_htable, variant_id_slen, variant_id_htable_size, max_variant_id_slen);
+          if (!(variant_uidx >> 31)) {
+            if (IsSet(already_seen, variant_uidx)) {
+              snprintf(g_logbuf, kLogbufSize, "Error: Variant ID '%s' appears multiple times in --score file.\n", variant_ids[variant_uidx]);
+              goto ScoreReport_ret_MALFORMED_INPUT_WW;
             }
-            const uint32_t chr_idx = GetVariantChr(cip, variant_uidx);
-            uint32_t is_nonx_haploid = IsSet(cip->haploid_mask, chr_idx);
-            if (domrec && is_nonx_haploid) {
-              logerrputs("Error: --score 'dominant' and 'recessive' modifiers cannot be used with haploid\nchromosomes.\n");
-              goto ScoreReport_ret_INCONSISTENT_INPUT;
+            SetBit(variant_uidx, already_seen);
+            char* allele_start = NextTokenMult0(linebuf_first_token, allele_col_idx);
+            if (!allele_start) {
+              goto ScoreReport_ret_MISSING_TOKENS;
             }
-            uint32_t is_relevant_x = (chr_idx == x_code);
-            if (variance_standardize && (is_relevant_x || (chr_idx == mt_code))) {
-              logerrputs("Error: --score 'variance-standardize' cannot be used with chrX or MT.\n");
-              goto ScoreReport_ret_INCONSISTENT_INPUT;
+            uintptr_t variant_allele_idx_base;
+            if (!variant_allele_idxs) {
+              variant_allele_idx_base = variant_uidx * 2;
+            } else {
+              variant_allele_idx_base = variant_allele_idxs[variant_uidx];
+              cur_allele_ct = variant_allele_idxs[variant_uidx + 1] - variant_allele_idx_base;
             }
-            is_nonx_haploid = (!is_relevant_x) && is_nonx_haploid;
-
-            // only if --xchr-model 1 (which is no longer the default)
-            is_relevant_x = is_relevant_x && xchr_model;
-
-            const uint32_t is_y = (chr_idx == y_code);
-            // pre-multiallelic kludge: current counts are for alt1, invert if
-            // score is based on ref allele
-            if (!cur_allele_idx) {
-              GenovecInvertUnsafe(sample_ct, genovec_buf);
-              if (dosage_ct) {
-                BiallelicDosage16Invert(dosage_ct, dosage_main_buf);
+            char* allele_end = CurTokenEnd(allele_start);
+            char allele_end_char = *allele_end;
+            *allele_end = '\0';
+            const char* const* cur_alleles = &(allele_storage[variant_allele_idx_base]);
+            uint32_t cur_allele_idx = 0;
+            for (; cur_allele_idx < cur_allele_ct; ++cur_allele_idx) {
+              // for very long alleles, tokequal_k might read past the end of the
+              // workspace, so just use plain strcmp.
+              if (!strcmp(allele_start, cur_alleles[cur_allele_idx])) {
+                break;
               }
             }
-            ZeroTrailingQuaters(sample_ct, genovec_buf);
-            GenovecToMissingnessUnsafe(genovec_buf, sample_ct, missing_acc1);
-            if (dosage_ct) {
-              BitvecAndNot(dosage_present_buf, sample_ctl, missing_acc1);
-            }
-            FillCurDosageInts(genovec_buf, dosage_present_buf, dosage_main_buf, sample_ct, dosage_ct, 2 - is_nonx_haploid, dosage_incrs);
-            double ploidy_d;
-            if (is_nonx_haploid) {
-              if (is_y) {
-                uint32_t sample_idx = 0;
-                for (uint32_t nonmale_idx = 0; nonmale_idx < nonmale_ct; ++nonmale_idx, ++sample_idx) {
-                  MovU32To1Bit(sex_nonmale_collapsed, &sample_idx);
-                  dosage_incrs[sample_idx] = 0;
-                }
-                ++male_allele_ct_delta;
-                BitvecAndNot(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+            if (cur_allele_idx != cur_allele_ct) {
+              // okay, the variant and allele are in our dataset.  Load it.
+              // (todo: make this work in multiallelic case)
+              uint32_t dosage_ct;
+              if (!bgen_direct_rp) {
+                reterr = PgrGetD(sample_include, sample_include_cumulative_popcounts, sample_ct, variant_uidx, simple_pgrp, genovec_buf, dosage_present_buf, dosage_main_buf, &dosage_ct);
               } else {
-                ++allele_ct_base;
+                reterr = BgenGetD(sample_include, sample_ct, variant_uidx, bgen_direct_rp, genovec_buf, dosage_present_buf, dosage_main_buf, &dosage_ct);
               }
-              VcountIncr1To4(missing_acc1, acc1_vec_ct, missing_haploid_acc4);
-              if (!(--variant_hap_ct_rem15)) {
-                Vcount0Incr4To8(acc4_vec_ct, missing_haploid_acc4, missing_haploid_acc8);
-                variant_hap_ct_rem15 = 15;
-                if (!(--variant_hap_ct_rem255d15)) {
-                  Vcount0Incr8To32(acc8_vec_ct, missing_haploid_acc8, missing_haploid_acc32);
-                  variant_hap_ct_rem255d15 = 17;
+              if (reterr) {
+                if (reterr == kPglRetMalformedInput) {
+                  logputs("\n");
+                  logerrputs(bgen_direct_rp? "Error: Invalid compressed SNP block in .bgen file.\n" : "Error: Malformed .pgen file.\n");
+                } else if (reterr == kPglRetNotYetSupported) {
+                  logputs("\n");
+                  logerrputs("Error: BGEN import doesn't currently support >16-bit probability precision or\nploidy > 2.\n");
                 }
+                goto ScoreReport_ret_1;
               }
-              if (is_y) {
-                memcpy(missing_male_acc1, missing_acc1, sample_ctl * sizeof(intptr_t));
-                BitvecOr(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+              const uint32_t chr_idx = GetVariantChr(cip, variant_uidx);
+              uint32_t is_nonx_haploid = IsSet(cip->haploid_mask, chr_idx);
+              if (domrec && is_nonx_haploid) {
+                logerrputs("Error: --score 'dominant' and 'recessive' modifiers cannot be used with haploid\nchromosomes.\n");
+                goto ScoreReport_ret_INCONSISTENT_INPUT;
               }
-              ploidy_d = 1.0;
-            } else {
-              if (is_relevant_x) {
-                uint32_t sample_idx = 0;
-                for (uint32_t male_idx = 0; male_idx < male_ct; ++male_idx, ++sample_idx) {
-                  MovU32To0Bit(sex_nonmale_collapsed, &sample_idx);
-                  dosage_incrs[sample_idx] /= 2;
-                }
-                BitvecAndNotCopy(missing_acc1, sex_nonmale_collapsed, sample_ctl, missing_male_acc1);
-                BitvecAnd(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+              uint32_t is_relevant_x = (chr_idx == x_code);
+              if (variance_standardize && (is_relevant_x || (chr_idx == mt_code))) {
+                logerrputs("Error: --score 'variance-standardize' cannot be used with chrX or MT.\n");
+                goto ScoreReport_ret_INCONSISTENT_INPUT;
               }
-              VcountIncr1To4(missing_acc1, acc1_vec_ct, missing_diploid_acc4);
-              if (!(--variant_ct_rem15)) {
-                Vcount0Incr4To8(acc4_vec_ct, missing_diploid_acc4, missing_diploid_acc8);
-                variant_ct_rem15 = 15;
-                if (!(--variant_ct_rem255d15)) {
-                  Vcount0Incr8To32(acc8_vec_ct, missing_diploid_acc8, missing_diploid_acc32);
-                  variant_ct_rem255d15 = 17;
+              is_nonx_haploid = (!is_relevant_x) && is_nonx_haploid;
+
+              // only if --xchr-model 1 (which is no longer the default)
+              is_relevant_x = is_relevant_x && xchr_model;
+
+              const uint32_t is_y = (chr_idx == y_code);
+              // pre-multiallelic kludge: current counts are for alt1, invert if
+              // score is based on ref allele
+              if (!cur_allele_idx) {
+                GenovecInvertUnsafe(sample_ct, genovec_buf);
+                if (dosage_ct) {
+                  BiallelicDosage16Invert(dosage_ct, dosage_main_buf);
                 }
               }
-              allele_ct_base += 2;
-              if (is_relevant_x) {
-                --male_allele_ct_delta;
-                VcountIncr1To4(missing_male_acc1, acc1_vec_ct, missing_haploid_acc4);
+              ZeroTrailingQuaters(sample_ct, genovec_buf);
+              GenovecToMissingnessUnsafe(genovec_buf, sample_ct, missing_acc1);
+              if (dosage_ct) {
+                BitvecAndNot(dosage_present_buf, sample_ctl, missing_acc1);
+              }
+              // dosage_incrs[] is now filled in by the compute threads
+              uint32_t sex_mode = 0;
+              double ploidy_d;
+              if (is_nonx_haploid) {
+                if (is_y) {
+                  sex_mode = 1;
+                  ++male_allele_ct_delta;
+                  BitvecAndNot(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+                } else {
+                  ++allele_ct_base;
+                }
+                VcountIncr1To4(missing_acc1, acc1_vec_ct, missing_haploid_acc4);
                 if (!(--variant_hap_ct_rem15)) {
                   Vcount0Incr4To8(acc4_vec_ct, missing_haploid_acc4, missing_haploid_acc8);
                   variant_hap_ct_rem15 = 15;
@@ -4994,237 +6415,286 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
                     variant_hap_ct_rem255d15 = 17;
                   }
                 }
-                BitvecOr(missing_male_acc1, sample_ctl, missing_acc1);
-              }
-              if (!domrec) {
-                ploidy_d = 2.0;
+                if (is_y) {
+                  memcpy(missing_male_acc1, missing_acc1, sample_ctl * sizeof(intptr_t));
+                  BitvecOr(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+                }
+                ploidy_d = 1.0;
               } else {
-                if (model_dominant) {
-                  for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
-                    if (dosage_incrs[sample_idx] > kDosageMax) {
-                      dosage_incrs[sample_idx] = kDosageMax;
-                    }
+                if (is_relevant_x) {
+                  sex_mode = 2;
+                  BitvecAndNotCopy(missing_acc1, sex_nonmale_collapsed, sample_ctl, missing_male_acc1);
+                  BitvecAnd(sex_nonmale_collapsed, sample_ctl, missing_acc1);
+                }
+                VcountIncr1To4(missing_acc1, acc1_vec_ct, missing_diploid_acc4);
+                if (!(--variant_ct_rem15)) {
+                  Vcount0Incr4To8(acc4_vec_ct, missing_diploid_acc4, missing_diploid_acc8);
+                  variant_ct_rem15 = 15;
+                  if (!(--variant_ct_rem255d15)) {
+                    Vcount0Incr8To32(acc8_vec_ct, missing_diploid_acc8, missing_diploid_acc32);
+                    variant_ct_rem255d15 = 17;
                   }
-                } else {
-                  for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
-                    uint64_t cur_dosage_incr = dosage_incrs[sample_idx];
-                    if (cur_dosage_incr <= kDosageMax) {
-                      cur_dosage_incr = 0;
-                    } else {
-                      cur_dosage_incr -= kDosageMax;
+                }
+                allele_ct_base += 2;
+                if (is_relevant_x) {
+                  --male_allele_ct_delta;
+                  VcountIncr1To4(missing_male_acc1, acc1_vec_ct, missing_haploid_acc4);
+                  if (!(--variant_hap_ct_rem15)) {
+                    Vcount0Incr4To8(acc4_vec_ct, missing_haploid_acc4, missing_haploid_acc8);
+                    variant_hap_ct_rem15 = 15;
+                    if (!(--variant_hap_ct_rem255d15)) {
+                      Vcount0Incr8To32(acc8_vec_ct, missing_haploid_acc8, missing_haploid_acc32);
+                      variant_hap_ct_rem255d15 = 17;
                     }
-                    dosage_incrs[sample_idx] = cur_dosage_incr;
                   }
+                  BitvecOr(missing_male_acc1, sample_ctl, missing_acc1);
                 }
-                ploidy_d = 1.0;
+                ploidy_d = domrec? 1.0 : 2.0;
               }
-            }
-            for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
-              dosage_sums[sample_idx] += dosage_incrs[sample_idx];
-            }
-            const double cur_allele_freq = GetAlleleFreq(&(allele_freqs[variant_allele_idx_base - variant_uidx]), cur_allele_idx, cur_allele_ct);
-            if (center) {
-              if (variance_standardize) {
-                const double variance = ploidy_d * cur_allele_freq * (1.0 - cur_allele_freq);
-                if (variance < kSmallEpsilon) {
-                  ZeroTrailingQuaters(sample_ct, genovec_buf);
-                  uint32_t genocounts[4];
-                  GenovecCountFreqsUnsafe(genovec_buf, sample_ct, genocounts);
-                  if (dosage_ct || genocounts[1] || genocounts[2]) {
-                    snprintf(g_logbuf, kLogbufSize, "Error: --score variance-standardize failure for ID '%s': estimated allele frequency is zero, but not all dosages are zero. (This is possible when e.g. allele frequencies are estimated from founders, but the allele is only observed in nonfounders.)\n", variant_ids[variant_uidx]);
-                    goto ScoreReport_ret_INCONSISTENT_INPUT_WW;
+              const double cur_allele_freq = GetAlleleFreq(&(allele_freqs[variant_allele_idx_base - variant_uidx]), cur_allele_idx, cur_allele_ct);
+              if (center) {
+                if (variance_standardize) {
+                  const double variance = ploidy_d * cur_allele_freq * (1.0 - cur_allele_freq);
+                  if (variance < kSmallEpsilon) {
+                    ZeroTrailingQuaters(sample_ct, genovec_buf);
+                    uint32_t genocounts[4];
+                    GenovecCountFreqsUnsafe(genovec_buf, sample_ct, genocounts);
+                    if (dosage_ct || genocounts[1] || genocounts[2]) {
+                      snprintf(g_logbuf, kLogbufSize, "Error: --score variance-standardize failure for ID '%s': estimated allele frequency is zero, but not all dosages are zero. (This is possible when e.g. allele frequencies are estimated from founders, but the allele is only observed in nonfounders.)\n", variant_ids[variant_uidx]);
+                      goto ScoreReport_ret_INCONSISTENT_INPUT_WW;
+                    }
+                    geno_slope = 0.0;
+                  } else {
+                    geno_slope = kRecipDosageMax / sqrt(variance);
                   }
-                  geno_slope = 0.0;
-                } else {
-                  geno_slope = kRecipDosageMax / sqrt(variance);
                 }
+                // (ploidy * cur_allele_freq * kDosageMax) * geno_slope +
+                //   geno_intercept == 0
+                // bugfix: must use "-1.0 *" instead of - to avoid unsigned int
+                //   wraparound
+                geno_intercept = (-1.0 * kDosageMax) * ploidy_d * cur_allele_freq * geno_slope;
               }
-              // (ploidy * cur_allele_freq * kDosageMax) * geno_slope +
-              //   geno_intercept == 0
-              // bugfix: must use "-1.0 *" instead of - to avoid unsigned int
-              //   wraparound
-              geno_intercept = (-1.0 * kDosageMax) * ploidy_d * cur_allele_freq * geno_slope;
-            }
-            const uint32_t missing_ct = PopcountWords(missing_acc1, sample_ctl);
-            const uint32_t nm_sample_ct = sample_ct - missing_ct;
-            if (missing_ct) {
-              double missing_effect = 0.0;
+              double male_missing_effect = 0.0;
               if (!no_meanimpute) {
-                missing_effect = kDosageMax * cur_allele_freq * geno_slope;
+                male_missing_effect = kDosageMax * cur_allele_freq * geno_slope;
               }
-              uint32_t sample_idx = 0;
-              if (is_y || is_relevant_x) {
-                ZeroDArr(sample_ct, cur_dosages_vmaj_iter);
-                if (!no_meanimpute) {
-                  const uint32_t male_missing_ct = PopcountWords(missing_male_acc1, sample_ctl);
-                  for (uint32_t male_missing_idx = 0; male_missing_idx < male_missing_ct; ++male_missing_idx, ++sample_idx) {
-                    MovU32To1Bit(missing_male_acc1, &sample_idx);
-                    cur_dosages_vmaj_iter[sample_idx] = missing_effect;
-                  }
-                  if (is_relevant_x) {
-                    // missing_male_acc1 not used after this point, so okay to
-                    // use buffer for nonmales
-                    BitvecAndCopy(missing_acc1, sex_nonmale_collapsed, sample_ctl, missing_male_acc1);
-                    missing_effect *= 2;
-                    const uint32_t nonmale_missing_ct = PopcountWords(missing_male_acc1, sample_ctl);
-                    for (uint32_t nonmale_missing_idx = 0; nonmale_missing_idx < nonmale_missing_ct; ++nonmale_missing_idx, ++sample_idx) {
-                      MovU32To1Bit(missing_male_acc1, &sample_idx);
-                      cur_dosages_vmaj_iter[sample_idx] = missing_effect;
-                    }
-                  }
-                }
+              double nonmale_missing_effect;
+              if (is_y) {
+                nonmale_missing_effect = 0.0;
+              } else if (is_relevant_x) {
+                nonmale_missing_effect = 2 * male_missing_effect;
               } else {
-                missing_effect *= ploidy_d;
-                for (uint32_t missing_idx = 0; missing_idx < missing_ct; ++missing_idx, ++sample_idx) {
-                  MovU32To1Bit(missing_acc1, &sample_idx);
-                  cur_dosages_vmaj_iter[sample_idx] = missing_effect;
-                }
+                male_missing_effect *= ploidy_d;
+                nonmale_missing_effect = male_missing_effect;
               }
-            }
-            uint32_t sample_idx = 0;
-            for (uint32_t nm_sample_idx = 0; nm_sample_idx < nm_sample_ct; ++nm_sample_idx, ++sample_idx) {
-              MovU32To0Bit(missing_acc1, &sample_idx);
-              cur_dosages_vmaj_iter[sample_idx] = u63tod(dosage_incrs[sample_idx]) * geno_slope + geno_intercept;
-            }
-            if (se_mode) {
               // Suppose our score coefficients are drawn from independent
-              // Gaussians.  Then the variance of the final score average is
-              // the sum of the variances of the individual terms, divided by
-              // (T^2) where T is the number of terms.  These individual
-              // variances are of the form ([genotype value] * [stdev])^2.
+              // Gaussians.  Then the variance of the final score average is the
+              // sum of the variances of the individual terms, divided by (T^2)
+              // where T is the number of terms.  These individual variances are
+              // of the form ([genotype value] * [stdev])^2.
               //
-              // Thus, we can use the same inner loop to compute standard
-              // errors, as long as
+              // Thus, we can use the same inner loop to compute standard errors,
+              // as long as
               //   1. we square the genotypes and the standard errors before
               //      matrix multiplication, and
               //   2. we take the square root of the sums at the end.
-              for (sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
-                cur_dosages_vmaj_iter[sample_idx] *= cur_dosages_vmaj_iter[sample_idx];
-              }
-            }
-            cur_dosages_vmaj_iter = &(cur_dosages_vmaj_iter[sample_ct]);
-
-            *allele_end = allele_end_char;
-            double* cur_score_coefs_iter = &(cur_score_coefs_cmaj[block_vidx]);
-            const char* read_iter = linebuf_first_token;
-            for (uint32_t score_col_idx = 0; score_col_idx < score_col_ct; ++score_col_idx) {
-              read_iter = NextTokenMult0(read_iter, score_col_idx_deltas[score_col_idx]);
-              double raw_coef;
-              const char* token_end = ScanadvDouble(read_iter, &raw_coef);
-              if (!token_end) {
-                snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of --score file has an invalid coefficient.\n", line_idx);
-                goto ScoreReport_ret_MALFORMED_INPUT_2;
+              // CalcScoreThread() takes care of squaring the genotypes.
+              memcpy(cur_missing_iter, missing_acc1, sample_ctl * sizeof(intptr_t));
+              cur_decode_iter->geno_slope = geno_slope;
+              cur_decode_iter->geno_intercept = geno_intercept;
+              cur_decode_iter->male_missing_effect = male_missing_effect;
+              cur_decode_iter->nonmale_missing_effect = nonmale_missing_effect;
+              cur_decode_iter->dosage_ct = dosage_ct;
+              cur_decode_iter->is_diploid_p1 = 2 - is_nonx_haploid;
+              cur_decode_iter->sex_mode = sex_mode;
+              ++cur_decode_iter;
+              genovec_buf = &(genovec_buf[sample_ctaw2]);
+              dosage_present_buf = &(dosage_present_buf[sample_ctaw]);
+              dosage_main_buf = &(dosage_main_buf[dosage_main_stride]);
+              cur_missing_iter = &(cur_missing_iter[sample_ctaw]);
+
+              *allele_end = allele_end_char;
+              const char* read_iter = linebuf_first_token;
+              for (uintptr_t score_col_idx = 0; score_col_idx < pass_col_start; ++score_col_idx) {
+                read_iter = NextTokenMult0(read_iter, score_col_idx_deltas[score_col_idx]);
               }
-              *cur_score_coefs_iter = raw_coef;
-              cur_score_coefs_iter = &(cur_score_coefs_iter[kScoreVariantBlockSize]);
-              read_iter = token_end;
-            }
-            if (list_variants) {
-              cswritep = strcpya(cswritep, variant_ids[variant_uidx]);
-              AppendBinaryEoln(&cswritep);
-              if (Cswrite(&css, &cswritep)) {
-                goto ScoreReport_ret_WRITE_FAIL;
+              uintptr_t coef_idx = block_vidx;
+              for (uintptr_t score_col_idx = pass_col_start; score_col_idx < pass_col_end; ++score_col_idx) {
+                read_iter = NextTokenMult0(read_iter, score_col_idx_deltas[score_col_idx]);
+                double raw_coef;
+                const char* token_end = ScanadvDouble(read_iter, &raw_coef);
+                if (!token_end) {
+                  snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of --score file has an invalid coefficient.\n", line_idx);
+                  goto ScoreReport_ret_MALFORMED_INPUT_2;
+                }
+                if (raw_coef != 0.0) {
+                  SetBit((score_col_idx - pass_col_start) / kScoreColChunkSize, cur_nonzero_chunks);
+                }
+                if (se_mode) {
+                  raw_coef *= raw_coef;
+                }
+                if (use_float) {
+                  cur_score_fcoefs_cmaj[coef_idx] = S_CAST(float, raw_coef);
+                } else {
+                  cur_score_coefs_cmaj[coef_idx] = raw_coef;
+                }
+                coef_idx += kScoreVariantBlockSize;
+                read_iter = token_end;
               }
-            }
-            ++valid_variant_ct;
-            if (!(valid_variant_ct % 10000)) {
-              printf("\r--score: %uk variants loaded.", valid_variant_ct / 1000);
-              fflush(stdout);
-            }
-            ++block_vidx;
-            if (block_vidx == kScoreVariantBlockSize) {
-              if (se_mode) {
-                for (uintptr_t ulii = 0; ulii < kScoreVariantBlockSize * score_col_ct; ++ulii) {
-                  cur_score_coefs_cmaj[ulii] *= cur_score_coefs_cmaj[ulii];
+              if (list_variants && (!pass_idx)) {
+                cswritep = strcpya(cswritep, variant_ids[variant_uidx]);
+                AppendBinaryEoln(&cswritep);
+                if (Cswrite(&css, &cswritep)) {
+                  goto ScoreReport_ret_WRITE_FAIL;
                 }
               }
-              parity = 1 - parity;
-              const uint32_t is_not_first_block = (ts.thread_func_ptr != nullptr);
-              if (is_not_first_block) {
-                JoinThreads3z(&ts);
-                // CalcScoreThread() never errors out
-              } else {
-                ts.thread_func_ptr = CalcScoreThread;
+              ++valid_variant_ct;
+              if (!(valid_variant_ct % 10000)) {
+                printf("\r--score: %uk variants loaded.", valid_variant_ct / 1000);
+                fflush(stdout);
               }
-              if (SpawnThreads3z(is_not_first_block, &ts)) {
-                goto ScoreReport_ret_THREAD_CREATE_FAIL;
+              ++block_vidx;
+              if (block_vidx == kScoreVariantBlockSize) {
+                parity = 1 - parity;
+                const uint32_t is_not_first_block = (ts.thread_func_ptr != nullptr);
+                if (is_not_first_block) {
+                  JoinThreads3z(&ts);
+                  // CalcScoreThread() never errors out
+                } else {
+                  ts.thread_func_ptr = CalcScoreThread;
+                }
+                if (SpawnThreads3z(is_not_first_block, &ts)) {
+                  goto ScoreReport_ret_THREAD_CREATE_FAIL;
+                }
+                genovec_buf = g_score_genovecs[parity];
+                dosage_present_buf = g_score_dosage_presents[parity];
+                dosage_main_buf = g_score_dosage_mains[parity];
+                cur_missing_iter = g_score_missings[parity];
+                cur_decode_iter = g_score_decodes[parity];
+                cur_score_coefs_cmaj = g_score_coefs_cmaj[parity];
+                cur_score_fcoefs_cmaj = g_score_fcoefs_cmaj[parity];
+                cur_nonzero_chunks = g_score_nonzero_chunks[parity];
+                ZeroWArr(cur_chunk_ctl, cur_nonzero_chunks);
+                block_vidx = 0;
               }
-              cur_dosages_vmaj_iter = g_dosages_vmaj[parity];
-              cur_score_coefs_cmaj = g_score_coefs_cmaj[parity];
-              block_vidx = 0;
+            } else {
+              ++missing_allele_code_ct;
             }
           } else {
-            ++missing_allele_code_ct;
+            if (variant_uidx != UINT32_MAX) {
+              snprintf(g_logbuf, kLogbufSize, "Error: --score variant ID '%s' appears multiple times in main dataset.\n", variant_ids[variant_uidx & 0x7fffffff]);
+              goto ScoreReport_ret_INCONSISTENT_INPUT_WW;
+            }
+            ++missing_var_id_ct;
           }
-        } else {
-          if (variant_uidx != UINT32_MAX) {
-            snprintf(g_logbuf, kLogbufSize, "Error: --score variant ID '%s' appears multiple times in main dataset.\n", variant_ids[variant_uidx & 0x7fffffff]);
-            goto ScoreReport_ret_INCONSISTENT_INPUT_WW;
+        }
+        ++line_idx;
+        reterr = RlsNextLstrip(&score_rls, &line_iter);
+        if (reterr) {
+          if (reterr == kPglRetEof) {
+            reterr = kPglRetSuccess;
+            break;
           }
-          ++missing_var_id_ct;
+          goto ScoreReport_ret_READ_RLSTREAM;
         }
+        linebuf_first_token = line_iter;
       }
-      ++line_idx;
-      reterr = RlsNextLstrip(&score_rls, &line_iter);
-      if (reterr) {
-        if (reterr == kPglRetEof) {
-          reterr = kPglRetSuccess;
-          break;
+      VcountIncr4To8(missing_diploid_acc4, acc4_vec_ct, missing_diploid_acc8);
+      VcountIncr8To32(missing_diploid_acc8, acc8_vec_ct, missing_diploid_acc32);
+      VcountIncr4To8(missing_haploid_acc4, acc4_vec_ct, missing_haploid_acc8);
+      VcountIncr8To32(missing_haploid_acc8, acc8_vec_ct, missing_haploid_acc32);
+      const uint32_t is_not_first_block = (ts.thread_func_ptr != nullptr);
+      putc_unlocked('\r', stdout);
+      if ((!pass_idx) && (missing_var_id_ct || missing_allele_code_ct)) {
+        if (!missing_var_id_ct) {
+          snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s.\n", missing_allele_code_ct, (missing_allele_code_ct == 1)? "y was skipped due to a mismatching allele code" : "ies were skipped due to mismatching allele codes");
+        } else if (!missing_allele_code_ct) {
+          snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s.\n", missing_var_id_ct, (missing_var_id_ct == 1)? "y was skipped due to a missing variant ID" : "ies were skipped due to missing variant IDs");
+        } else {
+          snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s, and %" PRIuPTR " %s.\n", missing_var_id_ct, (missing_var_id_ct == 1)? "y was skipped due to a missing variant ID" : "ies were skipped due to missing variant IDs", missing_allele_code_ct, (missing_allele_code_ct == 1)? "was skipped due to a mismatching allele code" : "were skipped due to mismatching allele codes");
+        }
+        WordWrapB(0);
+        logerrputsb();
+        if (!list_variants) {
+          logerrputs("(Add the 'list-variants' modifier to see which variants were actually used for\nscoring.)\n");
         }
-        goto ScoreReport_ret_READ_RLSTREAM;
       }
-      linebuf_first_token = line_iter;
-    }
-    VcountIncr4To8(missing_diploid_acc4, acc4_vec_ct, missing_diploid_acc8);
-    VcountIncr8To32(missing_diploid_acc8, acc8_vec_ct, missing_diploid_acc32);
-    VcountIncr4To8(missing_haploid_acc4, acc4_vec_ct, missing_haploid_acc8);
-    VcountIncr8To32(missing_haploid_acc8, acc8_vec_ct, missing_haploid_acc32);
-    const uint32_t is_not_first_block = (ts.thread_func_ptr != nullptr);
-    putc_unlocked('\r', stdout);
-    if (missing_var_id_ct || missing_allele_code_ct) {
-      if (!missing_var_id_ct) {
-        snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s.\n", missing_allele_code_ct, (missing_allele_code_ct == 1)? "y was skipped due to a mismatching allele code" : "ies were skipped due to mismatching allele codes");
-      } else if (!missing_allele_code_ct) {
-        snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s.\n", missing_var_id_ct, (missing_var_id_ct == 1)? "y was skipped due to a missing variant ID" : "ies were skipped due to missing variant IDs");
+      if (block_vidx) {
+        if (is_not_first_block) {
+          JoinThreads3z(&ts);
+        } else {
+          ts.thread_func_ptr = CalcScoreThread;
+        }
+      } else if (!valid_variant_ct) {
+        logerrputs("Error: No valid variants in --score file.\n");
+        goto ScoreReport_ret_MALFORMED_INPUT;
       } else {
-        snprintf(g_logbuf, kLogbufSize, "Warning: %" PRIuPTR " --score file entr%s, and %" PRIuPTR " %s.\n", missing_var_id_ct, (missing_var_id_ct == 1)? "y was skipped due to a missing variant ID" : "ies were skipped due to missing variant IDs", missing_allele_code_ct, (missing_allele_code_ct == 1)? "was skipped due to a mismatching allele code" : "were skipped due to mismatching allele codes");
-      }
-      WordWrapB(0);
-      logerrputsb();
-      if (!list_variants) {
-        logerrputs("(Add the 'list-variants' modifier to see which variants were actually used for\nscoring.)\n");
-      }
-    }
-    if (block_vidx) {
-      if (is_not_first_block) {
         JoinThreads3z(&ts);
-      } else {
-        ts.thread_func_ptr = CalcScoreThread;
       }
-    } else if (!valid_variant_ct) {
-      logerrputs("Error: No valid variants in --score file.\n");
-      goto ScoreReport_ret_MALFORMED_INPUT;
-    } else {
+      ts.is_last_block = 1;
+      g_cur_batch_size = block_vidx;
+      if (SpawnThreads3z(is_not_first_block, &ts)) {
+        goto ScoreReport_ret_THREAD_CREATE_FAIL;
+      }
       JoinThreads3z(&ts);
-    }
-    ts.is_last_block = 1;
-    g_cur_batch_size = block_vidx;
-    if (se_mode) {
-      for (uintptr_t score_col_idx = 0; score_col_idx < score_col_ct; ++score_col_idx) {
-        double* cur_score_coefs_row = &(cur_score_coefs_cmaj[score_col_idx * kScoreVariantBlockSize]);
-        for (uint32_t uii = 0; uii < block_vidx; ++uii) {
-          cur_score_coefs_row[uii] *= cur_score_coefs_row[uii];
+      const uintptr_t pass_entry_ct = S_CAST(uintptr_t, cur_pass_col_ct) * sample_ct;
+      if (!output_bin) {
+        if (se_mode) {
+          for (uintptr_t ulii = 0; ulii < pass_entry_ct; ++ulii) {
+            g_final_scores_cmaj[ulii] = sqrt(g_final_scores_cmaj[ulii]);
+          }
         }
+        continue;
       }
-    }
-    if (SpawnThreads3z(is_not_first_block, &ts)) {
-      goto ScoreReport_ret_THREAD_CREATE_FAIL;
-    }
-    JoinThreads3z(&ts);
-    if (se_mode) {
-      // sample_ct * score_col_ct
-      for (uintptr_t ulii = 0; ulii < sample_ct * score_col_ct; ++ulii) {
-        g_final_scores_cmaj[ulii] = sqrt(g_final_scores_cmaj[ulii]);
+      if (!pass_idx) {
+        // same denominators as the text report's
+        const uint32_t* scrambled_missing_diploid_cts = R_CAST(uint32_t*, missing_diploid_acc32);
+        const uint32_t* scrambled_missing_haploid_cts = R_CAST(uint32_t*, missing_haploid_acc32);
+        uint32_t sample_uidx = 0;
+        for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx, ++sample_uidx) {
+          MovU32To1Bit(sample_include, &sample_uidx);
+          if (bin_score_sums) {
+            bin_score_multipliers[sample_idx] = 1.0;
+            continue;
+          }
+          const uint32_t scrambled_idx = VcountScramble1(sample_idx);
+          uint32_t denom = allele_ct_base + IsSet(sex_male, sample_uidx) * male_allele_ct_delta;
+          if (no_meanimpute) {
+            denom -= 2 * scrambled_missing_diploid_cts[scrambled_idx] + scrambled_missing_haploid_cts[scrambled_idx];
+          }
+          bin_score_multipliers[sample_idx] = 1.0 / S_CAST(double, denom);
+        }
+      }
+      if (use_float) {
+        float* final_fscores_iter = g_final_fscores_cmaj;
+        for (uint32_t score_col_idx = 0; score_col_idx < cur_pass_col_ct; ++score_col_idx) {
+          for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
+            float cur_score = final_fscores_iter[sample_idx];
+            if (se_mode) {
+              cur_score = sqrtf(cur_score);
+            }
+            final_fscores_iter[sample_idx] = cur_score * S_CAST(float, bin_score_multipliers[sample_idx]);
+          }
+          final_fscores_iter = &(final_fscores_iter[sample_ct]);
+        }
+        if (fwrite_checked(g_final_fscores_cmaj, pass_entry_ct * sizeof(float), binfile)) {
+          goto ScoreReport_ret_WRITE_FAIL;
+        }
+      } else {
+        double* final_scores_iter = g_final_scores_cmaj;
+        for (uint32_t score_col_idx = 0; score_col_idx < cur_pass_col_ct; ++score_col_idx) {
+          for (uint32_t sample_idx = 0; sample_idx < sample_ct; ++sample_idx) {
+            double cur_score = final_scores_iter[sample_idx];
+            if (se_mode) {
+              cur_score = sqrt(cur_score);
+            }
+            final_scores_iter[sample_idx] = cur_score * bin_score_multipliers[sample_idx];
+          }
+          final_scores_iter = &(final_scores_iter[sample_ct]);
+        }
+        if (fwrite_checked(g_final_scores_cmaj, pass_entry_ct * sizeof(double), binfile)) {
+          goto ScoreReport_ret_WRITE_FAIL;
+        }
       }
     }
     logprintf("--score: %u variant%s processed.\n", valid_variant_ct, (valid_variant_ct == 1)? "" : "s");
@@ -5235,6 +6705,34 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
       cswritep = nullptr;
       logprintf("Variant list written to %s .\n", outname);
     }
+    if (output_bin) {
+      if (fclose_null(&binfile)) {
+        goto ScoreReport_ret_WRITE_FAIL;
+      }
+      // score-major: all sample values for score column 1, then all sample
+      // values for score column 2, etc.; column names are in .sscore.cols,
+      // and sample order matches the main .sscore report.
+      snprintf(outname_end, kMaxOutfnameExtBlen, ".sscore.cols");
+      reterr = InitCstream(outname, 0, 0, max_thread_ct, overflow_buf_size, overflow_buf, R_CAST(unsigned char*, &(overflow_buf[overflow_buf_size])), &css);
+      if (reterr) {
+        goto ScoreReport_ret_1;
+      }
+      cswritep = overflow_buf;
+      for (uintptr_t score_col_idx = 0; score_col_idx < score_col_ct; ++score_col_idx) {
+        cswritep = strcpya(cswritep, score_col_names[score_col_idx]);
+        cswritep = strcpya(cswritep, bin_score_sums? "_SUM" : "_AVG");
+        AppendBinaryEoln(&cswritep);
+        if (Cswrite(&css, &cswritep)) {
+          goto ScoreReport_ret_WRITE_FAIL;
+        }
+      }
+      if (CswriteCloseNull(&css, cswritep)) {
+        goto ScoreReport_ret_WRITE_FAIL;
+      }
+      cswritep = nullptr;
+      *outname_end = '\0';
+      logprintfww("--score: %s-precision score matrix written to %s.sscore.bin , and column names written to %s.sscore.cols .\n", use_float? "Single" : "Double", outname, outname);
+    }
 
     const uint32_t output_zst = (score_flags / kfScoreZs) & 1;
     OutnameZstSet(".sscore", output_zst, outname_end);
@@ -5402,6 +6900,9 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
   ScoreReport_ret_NOMEM:
     reterr = kPglRetNomem;
     break;
+  ScoreReport_ret_OPEN_FAIL:
+    reterr = kPglRetOpenFail;
+    break;
   ScoreReport_ret_WRITE_FAIL:
     reterr = kPglRetReadFail;
     break;
@@ -5433,6 +6934,7 @@ PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, co
     break;
   }
  ScoreReport_ret_1:
+  fclose_cond(binfile);
   CswriteCloseCond(&css, cswritep);
   CleanupThreads3z(&ts, &g_cur_batch_size);
   BLAS_SET_NUM_THREADS(1);
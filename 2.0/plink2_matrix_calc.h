@@ -18,7 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
-#include "plink2_common.h"
+#include "plink2_import.h"
 
 #ifdef __cplusplus
 namespace plink2 {
@@ -29,25 +29,26 @@ FLAGSET_DEF_START()
   kfKingMatrixZs = (1 << 0),
   kfKingMatrixBin = (1 << 1),
   kfKingMatrixBin4 = (1 << 2),
-  kfKingMatrixEncodemask = (kfKingMatrixZs | kfKingMatrixBin | kfKingMatrixBin4),
-  kfKingMatrixSq = (1 << 3),
-  kfKingMatrixSq0 = (1 << 4),
-  kfKingMatrixTri = (1 << 5),
+  kfKingMatrixSparse = (1 << 3),
+  kfKingMatrixEncodemask = (kfKingMatrixZs | kfKingMatrixBin | kfKingMatrixBin4 | kfKingMatrixSparse),
+  kfKingMatrixSq = (1 << 4),
+  kfKingMatrixSq0 = (1 << 5),
+  kfKingMatrixTri = (1 << 6),
   kfKingMatrixShapemask = (kfKingMatrixSq0 | kfKingMatrixSq | kfKingMatrixTri),
 
-  kfKingTableZs = (1 << 6),
-  kfKingCounts = (1 << 7),
-
-  kfKingColMaybefid = (1 << 8),
-  kfKingColFid = (1 << 9),
-  kfKingColId = (1 << 10),
-  kfKingColMaybesid = (1 << 11),
-  kfKingColSid = (1 << 12),
-  kfKingColNsnp = (1 << 13),
-  kfKingColHethet = (1 << 14),
-  kfKingColIbs0 = (1 << 15),
-  kfKingColIbs1 = (1 << 16),
-  kfKingColKinship = (1 << 17),
+  kfKingTableZs = (1 << 7),
+  kfKingCounts = (1 << 8),
+
+  kfKingColMaybefid = (1 << 9),
+  kfKingColFid = (1 << 10),
+  kfKingColId = (1 << 11),
+  kfKingColMaybesid = (1 << 12),
+  kfKingColSid = (1 << 13),
+  kfKingColNsnp = (1 << 14),
+  kfKingColHethet = (1 << 15),
+  kfKingColIbs0 = (1 << 16),
+  kfKingColIbs1 = (1 << 17),
+  kfKingColKinship = (1 << 18),
   kfKingColDefault = (kfKingColMaybefid | kfKingColId | kfKingColMaybesid | kfKingColNsnp | kfKingColHethet | kfKingColIbs0 | kfKingColKinship),
   kfKingColAll = ((kfKingColKinship * 2) - kfKingColMaybefid)
 FLAGSET_DEF_END(KingFlags);
@@ -57,20 +58,21 @@ FLAGSET_DEF_START()
   kfGrmMatrixZs = (1 << 0),
   kfGrmMatrixBin = (1 << 1),
   kfGrmMatrixBin4 = (1 << 2),
-  kfGrmMatrixEncodemask = (kfGrmMatrixZs | kfGrmMatrixBin | kfGrmMatrixBin4),
-  kfGrmMatrixSq = (1 << 3),
-  kfGrmMatrixSq0 = (1 << 4),
-  kfGrmMatrixTri = (1 << 5),
+  kfGrmMatrixSparse = (1 << 3),
+  kfGrmMatrixEncodemask = (kfGrmMatrixZs | kfGrmMatrixBin | kfGrmMatrixBin4 | kfGrmMatrixSparse),
+  kfGrmMatrixSq = (1 << 4),
+  kfGrmMatrixSq0 = (1 << 5),
+  kfGrmMatrixTri = (1 << 6),
   kfGrmMatrixShapemask = (kfGrmMatrixSq0 | kfGrmMatrixSq | kfGrmMatrixTri),
-  kfGrmListNoGz = (1 << 6),
-  kfGrmListZs = (1 << 7),
+  kfGrmListNoGz = (1 << 7),
+  kfGrmListZs = (1 << 8),
   kfGrmListmask = (kfGrmListNoGz | kfGrmListZs),
-  kfGrmBin = (1 << 8),
+  kfGrmBin = (1 << 9),
 
-  kfGrmMeanimpute = (1 << 9),
-  kfGrmCov = (1 << 10),
-  kfGrmNoIdHeader = (1 << 11),
-  kfGrmNoIdHeaderIidOnly = (1 << 12)
+  kfGrmMeanimpute = (1 << 10),
+  kfGrmCov = (1 << 11),
+  kfGrmNoIdHeader = (1 << 12),
+  kfGrmNoIdHeaderIidOnly = (1 << 13)
 FLAGSET_DEF_END(GrmFlags);
 
 FLAGSET_DEF_START()
@@ -111,18 +113,20 @@ FLAGSET_DEF_START()
   kfScoreZs = (1 << 8),
   kfScoreListVariants = (1 << 9),
   kfScoreListVariantsZs = (1 << 10),
-
-  kfScoreColMaybefid = (1 << 11),
-  kfScoreColFid = (1 << 12),
-  kfScoreColMaybesid = (1 << 13),
-  kfScoreColSid = (1 << 14),
-  kfScoreColPheno1 = (1 << 15),
-  kfScoreColPhenos = (1 << 16),
-  kfScoreColNmissAllele = (1 << 17),
-  kfScoreColDenom = (1 << 18),
-  kfScoreColDosageSum = (1 << 19),
-  kfScoreColScoreAvgs = (1 << 20),
-  kfScoreColScoreSums = (1 << 21),
+  kfScoreBin = (1 << 11),
+  kfScoreBin4 = (1 << 12),
+
+  kfScoreColMaybefid = (1 << 13),
+  kfScoreColFid = (1 << 14),
+  kfScoreColMaybesid = (1 << 15),
+  kfScoreColSid = (1 << 16),
+  kfScoreColPheno1 = (1 << 17),
+  kfScoreColPhenos = (1 << 18),
+  kfScoreColNmissAllele = (1 << 19),
+  kfScoreColDenom = (1 << 20),
+  kfScoreColDosageSum = (1 << 21),
+  kfScoreColScoreAvgs = (1 << 22),
+  kfScoreColScoreSums = (1 << 23),
   kfScoreColDefault = (kfScoreColMaybefid | kfScoreColMaybesid | kfScoreColPhenos | kfScoreColNmissAllele | kfScoreColDosageSum | kfScoreColScoreAvgs),
   kfScoreColAll = ((kfScoreColScoreSums * 2) - kfScoreColMaybefid)
 FLAGSET_DEF_END(ScoreFlags);
@@ -139,19 +143,26 @@ void InitScore(ScoreInfo* score_info_ptr);
 
 void CleanupScore(ScoreInfo* score_info_ptr);
 
+// --sparse-cutoff defaults.  (KING kinship coefficients are on half the scale
+// of GRM entries.)
+static const double kKingSparseCutoffDefault = 0.025;
+static const double kGrmSparseCutoffDefault = 0.05;
+
 PglErr KingCutoffBatch(const SampleIdInfo* siip, uint32_t raw_sample_ct, double king_cutoff, uintptr_t* sample_include, char* king_cutoff_fprefix, uint32_t* sample_ct_ptr);
 
-PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, uint32_t raw_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double king_cutoff, double king_table_filter, KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t max_thread_ct, PgenReader* simple_pgrp, uintptr_t* sample_include, uint32_t* sample_ct_ptr, char* outname, char* outname_end);
+PglErr CalcKing(const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, uint32_t raw_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double king_cutoff, double king_table_filter, double sparse_cutoff, KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t checkpoint_interval, uint32_t max_thread_ct, PgenReader* simple_pgrp, uintptr_t* sample_include, uint32_t* sample_ct_ptr, char* outname, char* outname_end);
 
 PglErr CalcKingTableSubset(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const char* subset_fname, uint32_t raw_sample_ct, uint32_t orig_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double king_table_filter, double king_table_subset_thresh, KingFlags king_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end);
 
-PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const double* allele_freqs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, GrmFlags grm_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end, double** grm_ptr);
+PglErr CalcGrm(const uintptr_t* orig_sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const uintptr_t* variant_allele_idxs, const AltAlleleCt* maj_alleles, const double* allele_freqs, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, double sparse_cutoff, GrmFlags grm_flags, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t checkpoint_interval, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end, double** grm_ptr);
 
 #ifndef NOLAPACK
 PglErr CalcPca(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const AltAlleleCt* maj_alleles, const double* allele_freqs, uint32_t raw_sample_ct, uintptr_t pca_sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_allele_slen, uint32_t pc_ct, PcaFlags pca_flags, uint32_t max_thread_ct, PgenReader* simple_pgrp, double* grm, char* outname, char* outname_end);
 #endif
 
-PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const ScoreInfo* score_info_ptr, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t xchr_model, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end);
+PglErr PcaProject(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* variant_include, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const char* var_wts_fname, const char* eigval_fname, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t max_thread_ct, PgenReader* simple_pgrp, char* outname, char* outname_end);
+
+PglErr ScoreReport(const uintptr_t* sample_include, const SampleIdInfo* siip, const uintptr_t* sex_male, const PhenoCol* pheno_cols, const char* pheno_names, const uintptr_t* variant_include, const ChrInfo* cip, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const double* allele_freqs, const ScoreInfo* score_info_ptr, uint32_t raw_sample_ct, uint32_t sample_ct, uint32_t pheno_ct, uintptr_t max_pheno_name_blen, uint32_t raw_variant_ct, uint32_t variant_ct, uint32_t max_variant_id_slen, uint32_t xchr_model, uint32_t max_thread_ct, PgenReader* simple_pgrp, BgenReader* bgen_direct_rp, char* outname, char* outname_end);
 
 #ifdef __cplusplus
 }  // namespace plink2
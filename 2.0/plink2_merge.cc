@@ -0,0 +1,1413 @@
+// This file is part of PLINK 2.00, copyright (C) 2005-2018 Shaun Purcell,
+// Christopher Chang.
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "plink2_compress_stream.h"
+#include "plink2_decompress.h"
+#include "plink2_merge.h"
+
+#ifdef __cplusplus
+namespace plink2 {
+#endif
+
+typedef struct PmergeFilesetStruct {
+  const char* pgenname;
+  const char* pvarname;
+  const char* psamname;
+  uint32_t sample_ct;
+  uint32_t variant_ct;
+} PmergeFileset;
+
+// Each nonempty line of the list file is either a single fileset prefix, or
+// explicit .pgen, .pvar, and .psam filenames.  If <prefix>.pvar doesn't
+// exist, <prefix>.pvar.zst is tried.
+static PglErr LoadPmergeList(const char* pmerge_list_fname, PmergeFileset** filesets_ptr, uint32_t* fileset_ct_ptr) {
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  uintptr_t line_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream rls;
+  PreinitRLstream(&rls);
+  {
+    char* line_iter;
+    reterr = InitRLstreamEndallocRaw(pmerge_list_fname, kRLstreamBlenLowerBound, &rls, &line_iter);
+    if (reterr) {
+      goto LoadPmergeList_ret_1;
+    }
+    // first pass: count filesets, check token counts and filename lengths
+    uintptr_t fname_bytes = 0;
+    uint32_t fileset_ct = 0;
+    while (1) {
+      reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+      if (reterr) {
+        if (reterr == kPglRetEof) {
+          reterr = kPglRetSuccess;
+          break;
+        }
+        goto LoadPmergeList_ret_READ_RLSTREAM;
+      }
+      const uint32_t token_ct = CountTokens(line_iter);
+      if ((token_ct != 1) && (token_ct != 3)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of --pmerge-list file has %u tokens (1 or 3 expected).\n", line_idx, token_ct);
+        goto LoadPmergeList_ret_MALFORMED_INPUT_WW;
+      }
+      for (uint32_t token_idx = 0; token_idx != token_ct; ++token_idx) {
+        const char* token_end = CurTokenEnd(line_iter);
+        const uint32_t slen = token_end - line_iter;
+        if (slen > kPglFnamesize - 10) {
+          snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of --pmerge-list file has an excessively long filename.\n", line_idx);
+          goto LoadPmergeList_ret_MALFORMED_INPUT_WW;
+        }
+        fname_bytes += (token_ct == 1)? (3 * (slen + 10)) : (slen + 1);
+        line_iter = FirstNonTspace(K_CAST(char*, token_end));
+      }
+      ++fileset_ct;
+    }
+    if (fileset_ct < 2) {
+      logerrputs("Error: --pmerge-list file must name at least two filesets.\n");
+      goto LoadPmergeList_ret_INCONSISTENT_INPUT;
+    }
+    PmergeFileset* filesets = S_CAST(PmergeFileset*, bigstack_alloc(fileset_ct * sizeof(PmergeFileset)));
+    char* fname_write_iter;
+    if ((!filesets) ||
+        bigstack_alloc_c(fname_bytes, &fname_write_iter)) {
+      goto LoadPmergeList_ret_NOMEM;
+    }
+    reterr = RewindRLstreamRaw(&rls, &line_iter);
+    if (reterr) {
+      goto LoadPmergeList_ret_READ_RLSTREAM;
+    }
+    line_idx = 0;
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+      if (reterr) {
+        goto LoadPmergeList_ret_READ_RLSTREAM;
+      }
+      PmergeFileset* cur_fileset = &(filesets[fileset_idx]);
+      char* token_end = CurTokenEnd(line_iter);
+      const uint32_t slen = token_end - line_iter;
+      if (IsEolnKns(*FirstNonTspace(token_end))) {
+        cur_fileset->pgenname = fname_write_iter;
+        fname_write_iter = memcpya(fname_write_iter, line_iter, slen);
+        fname_write_iter = strcpyax(fname_write_iter, ".pgen", '\0');
+        cur_fileset->psamname = fname_write_iter;
+        fname_write_iter = memcpya(fname_write_iter, line_iter, slen);
+        fname_write_iter = strcpyax(fname_write_iter, ".psam", '\0');
+        char* pvarname = fname_write_iter;
+        cur_fileset->pvarname = pvarname;
+        fname_write_iter = memcpya(fname_write_iter, line_iter, slen);
+        fname_write_iter = strcpya(fname_write_iter, ".pvar");
+        *fname_write_iter = '\0';
+        FILE* test_file = fopen(pvarname, FOPEN_RB);
+        if (test_file) {
+          fclose(test_file);
+        } else {
+          fname_write_iter = strcpya(fname_write_iter, ".zst");
+        }
+        *fname_write_iter++ = '\0';
+      } else {
+        const char** fname_targets[3] = {&(cur_fileset->pgenname), &(cur_fileset->pvarname), &(cur_fileset->psamname)};
+        for (uint32_t token_idx = 0; token_idx != 3; ++token_idx) {
+          token_end = CurTokenEnd(line_iter);
+          *(fname_targets[token_idx]) = fname_write_iter;
+          fname_write_iter = memcpyax(fname_write_iter, line_iter, token_end - line_iter, '\0');
+          line_iter = FirstNonTspace(token_end);
+        }
+      }
+    }
+    *filesets_ptr = filesets;
+    *fileset_ct_ptr = fileset_ct;
+  }
+  while (0) {
+  LoadPmergeList_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  LoadPmergeList_ret_READ_RLSTREAM:
+    RLstreamErrPrint("--pmerge-list file", &rls, &reterr);
+    break;
+  LoadPmergeList_ret_MALFORMED_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  LoadPmergeList_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ LoadPmergeList_ret_1:
+  CleanupRLstream(&rls);
+  BigstackEndReset(bigstack_end_mark);
+  return reterr;
+}
+
+// Returns pointer to the end of the sample ID (FID + IID if fid_present, IID
+// otherwise) at the start of the line, or nullptr if a token is missing.
+static const char* PsamLineIdEnd(const char* line_iter, uint32_t fid_present, const char** iid_start_ptr) {
+  const char* token_end = CurTokenEnd(line_iter);
+  if (!fid_present) {
+    *iid_start_ptr = line_iter;
+    return token_end;
+  }
+  const char* iid_start = FirstNonTspace(token_end);
+  if (IsEolnKns(*iid_start)) {
+    return nullptr;
+  }
+  *iid_start_ptr = iid_start;
+  return CurTokenEnd(iid_start);
+}
+
+// Fills filesets[].sample_ct, and determines whether all filesets contain the
+// same sample IDs in the same order (*same_samples_ptr set to 1) or pairwise
+// disjoint sample sets (*same_samples_ptr set to 0).  Anything else is
+// currently an error.  The .psam header lines must be identical.
+static PglErr PmergeScanPsams(PmergeFileset* filesets, uint32_t fileset_ct, uint32_t* same_samples_ptr, uint32_t* total_sample_ct_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  const char* cur_fname = filesets[0].psamname;
+  uintptr_t line_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  ReadLineStream rls;
+  PreinitRLstream(&rls);
+  {
+    char* line_iter;
+    reterr = SizeAndInitRLstreamRaw(cur_fname, bigstack_left() / 4, &rls, &line_iter);
+    if (reterr) {
+      goto PmergeScanPsams_ret_1;
+    }
+    // first pass: sample counts, maximum ID length, header consistency
+    const char* header0 = nullptr;
+    uint32_t header0_slen = 0;
+    uint32_t fid_present = 1;
+    uintptr_t max_id_blen = 2;
+    uintptr_t total_sample_ct = 0;
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      if (fileset_idx) {
+        cur_fname = filesets[fileset_idx].psamname;
+        reterr = RetargetRLstreamRaw(cur_fname, &rls, &line_iter);
+        if (reterr) {
+          goto PmergeScanPsams_ret_READ_RLSTREAM;
+        }
+      }
+      line_idx = 0;
+      uint32_t header_seen = 0;
+      uint32_t sample_ct = 0;
+      while (1) {
+        reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+        if (reterr) {
+          if (reterr == kPglRetEof) {
+            reterr = kPglRetSuccess;
+            break;
+          }
+          goto PmergeScanPsams_ret_READ_RLSTREAM;
+        }
+        if (*line_iter == '#') {
+          if ((!sample_ct) && (!header_seen) && (tokequal_k(line_iter, "#FID") || tokequal_k(line_iter, "#IID"))) {
+            header_seen = 1;
+            const uint32_t header_slen = AdvToDelim(line_iter, '\n') - line_iter;
+            if (!fileset_idx) {
+              fid_present = (line_iter[1] == 'F');
+              char* header0_copy;
+              if (bigstack_end_alloc_c(header_slen, &header0_copy)) {
+                goto PmergeScanPsams_ret_NOMEM;
+              }
+              memcpy(header0_copy, line_iter, header_slen);
+              header0 = header0_copy;
+              header0_slen = header_slen;
+            } else if ((!header0) || (header_slen != header0_slen) || memcmp(line_iter, header0, header_slen)) {
+              goto PmergeScanPsams_ret_HEADER_MISMATCH;
+            }
+          }
+          continue;
+        }
+        if ((!header_seen) && fileset_idx && header0) {
+          goto PmergeScanPsams_ret_HEADER_MISMATCH;
+        }
+        const char* iid_start;
+        const char* id_end = PsamLineIdEnd(line_iter, fid_present, &iid_start);
+        if (!id_end) {
+          goto PmergeScanPsams_ret_MISSING_TOKENS;
+        }
+        const uintptr_t id_blen = 1 + S_CAST(uintptr_t, id_end - line_iter);
+        if (id_blen > max_id_blen) {
+          max_id_blen = id_blen;
+        }
+        ++sample_ct;
+      }
+      if ((!header_seen) && fileset_idx && header0) {
+        goto PmergeScanPsams_ret_HEADER_MISMATCH;
+      }
+      if (!sample_ct) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s contains no samples.\n", cur_fname);
+        goto PmergeScanPsams_ret_INCONSISTENT_INPUT_WW;
+      }
+      filesets[fileset_idx].sample_ct = sample_ct;
+      total_sample_ct += sample_ct;
+    }
+    if (total_sample_ct > 0x7ffffffe) {
+      logerrputs("Error: Too many samples in --pmerge-list filesets.\n");
+      goto PmergeScanPsams_ret_INCONSISTENT_INPUT;
+    }
+
+    // second pass: load IDs
+    char* sample_ids;
+    if (bigstack_alloc_c(total_sample_ct * max_id_blen, &sample_ids)) {
+      goto PmergeScanPsams_ret_NOMEM;
+    }
+    char* sample_ids_iter = sample_ids;
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      cur_fname = filesets[fileset_idx].psamname;
+      reterr = RetargetRLstreamRaw(cur_fname, &rls, &line_iter);
+      if (reterr) {
+        goto PmergeScanPsams_ret_READ_RLSTREAM;
+      }
+      line_idx = 0;
+      for (uint32_t sample_idx = 0; sample_idx != filesets[fileset_idx].sample_ct; ) {
+        reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+        if (reterr) {
+          goto PmergeScanPsams_ret_READ_RLSTREAM;
+        }
+        if (*line_iter == '#') {
+          continue;
+        }
+        const char* iid_start;
+        const char* id_end = PsamLineIdEnd(line_iter, fid_present, &iid_start);
+        char* id_write_iter = sample_ids_iter;
+        if (fid_present) {
+          id_write_iter = memcpyax(id_write_iter, line_iter, CurTokenEnd(line_iter) - line_iter, '\t');
+        }
+        memcpyx(id_write_iter, iid_start, id_end - iid_start, '\0');
+        sample_ids_iter = &(sample_ids_iter[max_id_blen]);
+        ++sample_idx;
+      }
+    }
+
+    const uint32_t sample_ct0 = filesets[0].sample_ct;
+    uint32_t same_samples = 1;
+    for (uint32_t fileset_idx = 1; fileset_idx != fileset_ct; ++fileset_idx) {
+      if (filesets[fileset_idx].sample_ct != sample_ct0) {
+        same_samples = 0;
+        break;
+      }
+      const char* cur_sample_ids = &(sample_ids[fileset_idx * sample_ct0 * max_id_blen]);
+      for (uint32_t sample_idx = 0; sample_idx != sample_ct0; ++sample_idx) {
+        if (strcmp(&(sample_ids[sample_idx * max_id_blen]), &(cur_sample_ids[sample_idx * max_id_blen]))) {
+          same_samples = 0;
+          break;
+        }
+      }
+      if (!same_samples) {
+        break;
+      }
+    }
+    if (!same_samples) {
+      qsort(sample_ids, total_sample_ct, max_id_blen, strcmp_casted);
+      for (uintptr_t sample_idx = 1; sample_idx != total_sample_ct; ++sample_idx) {
+        char* cur_id = &(sample_ids[sample_idx * max_id_blen]);
+        if (!strcmp(&(cur_id[-S_CAST(intptr_t, max_id_blen)]), cur_id)) {
+          char* tab_ptr = strchr(cur_id, '\t');
+          if (tab_ptr) {
+            *tab_ptr = ' ';
+          }
+          snprintf(g_logbuf, kLogbufSize, "Error: Sample ID '%s' appears more than once in the --pmerge-list filesets, but the sample lists are not identical. (Merging partially overlapping sample sets is not yet supported.)\n", cur_id);
+          WordWrapB(0);
+          logerrputsb();
+          reterr = kPglRetNotYetSupported;
+          goto PmergeScanPsams_ret_1;
+        }
+      }
+    }
+    *same_samples_ptr = same_samples;
+    *total_sample_ct_ptr = same_samples? sample_ct0 : total_sample_ct;
+  }
+  while (0) {
+  PmergeScanPsams_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  PmergeScanPsams_ret_READ_RLSTREAM:
+    RLstreamErrPrint(cur_fname, &rls, &reterr);
+    break;
+  PmergeScanPsams_ret_HEADER_MISMATCH:
+    snprintf(g_logbuf, kLogbufSize, "Error: The header line of %s does not match the header line of %s.\n", cur_fname, filesets[0].psamname);
+    goto PmergeScanPsams_ret_INCONSISTENT_INPUT_WW;
+  PmergeScanPsams_ret_MISSING_TOKENS:
+    snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idx, cur_fname);
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  PmergeScanPsams_ret_INCONSISTENT_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+  PmergeScanPsams_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ PmergeScanPsams_ret_1:
+  CleanupRLstream(&rls);
+  BigstackDoubleReset(bigstack_mark, bigstack_end_mark);
+  return reterr;
+}
+
+// Copies the first .psam verbatim, followed by the sample lines of the
+// remaining .psam files when the sample sets are disjoint.
+static PglErr PmergeWritePsam(const PmergeFileset* filesets, uint32_t fileset_ct, uint32_t same_samples, char* outname, char* outname_end) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  const char* cur_fname = filesets[0].psamname;
+  char* cswritep = nullptr;
+  PglErr reterr = kPglRetSuccess;
+  CompressStreamState css;
+  ReadLineStream rls;
+  PreinitCstream(&css);
+  PreinitRLstream(&rls);
+  {
+    char* line_iter;
+    reterr = SizeAndInitRLstreamRaw(cur_fname, bigstack_left() / 4, &rls, &line_iter);
+    if (reterr) {
+      goto PmergeWritePsam_ret_1;
+    }
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".psam");
+    reterr = InitCstreamAlloc(outname, 0, 0, 1, 2 * kCompressStreamBlock, &css, &cswritep);
+    if (reterr) {
+      goto PmergeWritePsam_ret_1;
+    }
+    const uint32_t read_fileset_ct = same_samples? 1 : fileset_ct;
+    for (uint32_t fileset_idx = 0; fileset_idx != read_fileset_ct; ++fileset_idx) {
+      if (fileset_idx) {
+        cur_fname = filesets[fileset_idx].psamname;
+        reterr = RetargetRLstreamRaw(cur_fname, &rls, &line_iter);
+        if (reterr) {
+          goto PmergeWritePsam_ret_READ_RLSTREAM;
+        }
+      }
+      uintptr_t line_idx = 0;
+      while (1) {
+        reterr = RlsNextNonemptyLstrip(&rls, &line_idx, &line_iter);
+        if (reterr) {
+          if (reterr == kPglRetEof) {
+            reterr = kPglRetSuccess;
+            break;
+          }
+          goto PmergeWritePsam_ret_READ_RLSTREAM;
+        }
+        if (fileset_idx && (*line_iter == '#')) {
+          continue;
+        }
+        char* line_end = AdvPastDelim(line_iter, '\n');
+        if (CsputsStd(line_iter, line_end - line_iter, &css, &cswritep)) {
+          goto PmergeWritePsam_ret_WRITE_FAIL;
+        }
+        line_iter = &(line_end[-1]);
+      }
+    }
+    if (CswriteCloseNull(&css, cswritep)) {
+      goto PmergeWritePsam_ret_WRITE_FAIL;
+    }
+  }
+  while (0) {
+  PmergeWritePsam_ret_READ_RLSTREAM:
+    RLstreamErrPrint(cur_fname, &rls, &reterr);
+    break;
+  PmergeWritePsam_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  }
+ PmergeWritePsam_ret_1:
+  CswriteCloseCond(&css, cswritep);
+  CleanupRLstream(&rls);
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
+// Determines the position column (and, for the identical-variant-list check,
+// the number of leading columns which must match) from a .pvar header line.
+// A missing header line implies .bim column order.
+static PglErr PmergeParsePvarHeader(const char* line_iter, const char* pvarname, uint32_t* pos_col_idx_ptr, uint32_t* cmp_col_ct_ptr) {
+  if (!tokequal_k(line_iter, "#CHROM")) {
+    *pos_col_idx_ptr = 3;
+    *cmp_col_ct_ptr = 6;
+    return kPglRetSuccess;
+  }
+  uint32_t pos_col_idx = 0;
+  uint32_t cmp_col_ct = 1;
+  const char* token_iter = line_iter;
+  for (uint32_t col_idx = 1; ; ++col_idx) {
+    token_iter = FirstNonTspace(CurTokenEnd(token_iter));
+    if (IsEolnKns(*token_iter)) {
+      break;
+    }
+    const uint32_t token_slen = CurTokenEnd(token_iter) - token_iter;
+    if (strequal_k(token_iter, "POS", token_slen)) {
+      pos_col_idx = col_idx;
+    } else if ((!strequal_k(token_iter, "ID", token_slen)) && (!strequal_k(token_iter, "REF", token_slen)) && (!strequal_k(token_iter, "ALT", token_slen))) {
+      continue;
+    }
+    cmp_col_ct = col_idx + 1;
+  }
+  if (!pos_col_idx) {
+    logerrprintfww("Error: No POS column in %s.\n", pvarname);
+    return kPglRetMalformedInput;
+  }
+  *pos_col_idx_ptr = pos_col_idx;
+  *cmp_col_ct_ptr = cmp_col_ct;
+  return kPglRetSuccess;
+}
+
+// (chromosome code, position) sort key for a .pvar line.  Nonstandard
+// contigs are sorted after all standard chromosomes, in nonstd_ranks[] order.
+static PglErr PmergeVariantKey(const char* pvarname, uintptr_t line_idx, uint32_t pos_col_idx, uint32_t allow_extra_chrs, const uint32_t* nonstd_ranks, char* line_iter, ChrInfo* cip, uint64_t* key_ptr) {
+  const char* pos_start = NextTokenMult(line_iter, pos_col_idx);
+  if (!pos_start) {
+    logerrprintfww("Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idx, pvarname);
+    return kPglRetMalformedInput;
+  }
+  char* chr_end = CurTokenEnd(line_iter);
+  const char chr_end_char = *chr_end;
+  uint32_t chr_code;
+  PglErr reterr = GetOrAddChrCodeDestructive(pvarname, line_idx, allow_extra_chrs, line_iter, chr_end, cip, &chr_code);
+  *chr_end = chr_end_char;
+  if (reterr) {
+    return reterr;
+  }
+  if (chr_code > cip->max_code) {
+    chr_code = cip->max_code + 1 + nonstd_ranks[chr_code - cip->max_code - 1];
+  }
+  int32_t bp;
+  if (ScanIntAbsDefcap(pos_start, &bp)) {
+    logerrprintfww("Error: Invalid bp coordinate on line %" PRIuPTR " of %s.\n", line_idx, pvarname);
+    return kPglRetMalformedInput;
+  }
+  *key_ptr = (S_CAST(uint64_t, chr_code) << 32) | (S_CAST(uint32_t, bp) ^ 0x80000000U);
+  return kPglRetSuccess;
+}
+
+// Returns end of the first cmp_col_ct tokens, or nullptr if the line is too
+// short.
+static const char* PvarCmpColsEnd(const char* line_iter, uint32_t cmp_col_ct) {
+  if (cmp_col_ct > 1) {
+    line_iter = NextTokenMult(line_iter, cmp_col_ct - 1);
+    if (!line_iter) {
+      return nullptr;
+    }
+  }
+  return CurTokenEnd(line_iter);
+}
+
+// Scans every .pvar (the streams are rewound afterward) and ranks the
+// nonstandard contigs so that the merged order is consistent with each file's
+// order; *nonstd_ranks_ptr is allocated at the end of bigstack, and is
+// indexed by (chr_code - max_code - 1).  A file which isn't sorted, or a pair
+// of files which order two contigs differently, is an error.
+static PglErr PmergeRankNonstdContigs(const PmergeFileset* filesets, uint32_t fileset_ct, uint32_t allow_extra_chrs, ReadLineStream* rlss, char** line_iters, ChrInfo* cip, uint32_t** nonstd_ranks_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  uint32_t fileset_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  {
+    const uint32_t max_code_p1 = cip->max_code + 1;
+    // (previous contig, next contig) pairs, encoded as (prev << 32) | next
+    uint64_t* edges = R_CAST(uint64_t*, g_bigstack_base);
+    const uintptr_t max_edge_ct = bigstack_left() / sizeof(int64_t);
+    uintptr_t edge_ct = 0;
+    for (; fileset_idx != fileset_ct; ++fileset_idx) {
+      ReadLineStream* rlsp = &(rlss[fileset_idx]);
+      char* line_iter = line_iters[fileset_idx];
+      uintptr_t line_idx = 0;
+      uint32_t prev_nonstd_code = UINT32_MAX;
+      while (1) {
+        reterr = RlsNextNonemptyLstrip(rlsp, &line_idx, &line_iter);
+        if (reterr) {
+          if (reterr != kPglRetEof) {
+            goto PmergeRankNonstdContigs_ret_READ_RLSTREAM;
+          }
+          reterr = kPglRetSuccess;
+          break;
+        }
+        if (*line_iter != '#') {
+          char* chr_end = CurTokenEnd(line_iter);
+          const char chr_end_char = *chr_end;
+          uint32_t chr_code;
+          reterr = GetOrAddChrCodeDestructive(filesets[fileset_idx].pvarname, line_idx, allow_extra_chrs, line_iter, chr_end, cip, &chr_code);
+          *chr_end = chr_end_char;
+          if (reterr) {
+            goto PmergeRankNonstdContigs_ret_1;
+          }
+          if ((chr_code >= max_code_p1) && (chr_code != prev_nonstd_code)) {
+            if (prev_nonstd_code != UINT32_MAX) {
+              if (edge_ct == max_edge_ct) {
+                goto PmergeRankNonstdContigs_ret_NOMEM;
+              }
+              edges[edge_ct++] = (S_CAST(uint64_t, prev_nonstd_code) << 32) | chr_code;
+            }
+            prev_nonstd_code = chr_code;
+          }
+        }
+        line_iter = AdvToDelim(line_iter, '\n');
+      }
+      reterr = RewindRLstreamRaw(rlsp, &(line_iters[fileset_idx]));
+      if (reterr) {
+        goto PmergeRankNonstdContigs_ret_READ_RLSTREAM;
+      }
+    }
+    const uint32_t nonstd_ct = cip->name_ct;
+    if (!nonstd_ct) {
+      *nonstd_ranks_ptr = nullptr;
+      goto PmergeRankNonstdContigs_ret_1;
+    }
+    BigstackBaseSet(&(edges[edge_ct]));
+    uint32_t* nonstd_ranks;
+    uint32_t* edge_starts;
+    uint32_t* indegrees;
+    uint32_t* queue;
+    if (bigstack_end_alloc_u32(nonstd_ct, &nonstd_ranks) ||
+        bigstack_alloc_u32(nonstd_ct + 1, &edge_starts) ||
+        bigstack_calloc_u32(nonstd_ct, &indegrees) ||
+        bigstack_alloc_u32(nonstd_ct, &queue)) {
+      goto PmergeRankNonstdContigs_ret_NOMEM;
+    }
+    qsort(edges, edge_ct, sizeof(int64_t), uint64cmp);
+    uintptr_t uniq_edge_ct = 0;
+    for (uintptr_t edge_idx = 0; edge_idx != edge_ct; ++edge_idx) {
+      const uint64_t cur_edge = edges[edge_idx];
+      if (uniq_edge_ct && (edges[uniq_edge_ct - 1] == cur_edge)) {
+        continue;
+      }
+      edges[uniq_edge_ct++] = cur_edge;
+      indegrees[S_CAST(uint32_t, cur_edge) - max_code_p1] += 1;
+    }
+    uintptr_t edge_idx = 0;
+    for (uint32_t nonstd_idx = 0; nonstd_idx <= nonstd_ct; ++nonstd_idx) {
+      while ((edge_idx != uniq_edge_ct) && ((edges[edge_idx] >> 32) < max_code_p1 + nonstd_idx)) {
+        ++edge_idx;
+      }
+      edge_starts[nonstd_idx] = edge_idx;
+    }
+    // Kahn's algorithm; ties are broken by order of first appearance.
+    uint32_t queue_end = 0;
+    for (uint32_t nonstd_idx = 0; nonstd_idx != nonstd_ct; ++nonstd_idx) {
+      if (!indegrees[nonstd_idx]) {
+        queue[queue_end++] = nonstd_idx;
+      }
+    }
+    for (uint32_t rank = 0; rank != queue_end; ++rank) {
+      const uint32_t nonstd_idx = queue[rank];
+      nonstd_ranks[nonstd_idx] = rank;
+      for (uint32_t cur_edge_idx = edge_starts[nonstd_idx]; cur_edge_idx != edge_starts[nonstd_idx + 1]; ++cur_edge_idx) {
+        const uint32_t next_nonstd_idx = S_CAST(uint32_t, edges[cur_edge_idx]) - max_code_p1;
+        if (!(--indegrees[next_nonstd_idx])) {
+          queue[queue_end++] = next_nonstd_idx;
+        }
+      }
+    }
+    if (queue_end != nonstd_ct) {
+      logerrputs("Error: The --pmerge-list .pvar files do not order their nonstandard contigs\nconsistently.  (Each file must be sorted, and contigs shared between files must\nappear in the same relative order.)\n");
+      goto PmergeRankNonstdContigs_ret_INCONSISTENT_INPUT;
+    }
+    *nonstd_ranks_ptr = nonstd_ranks;
+  }
+  while (0) {
+  PmergeRankNonstdContigs_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  PmergeRankNonstdContigs_ret_READ_RLSTREAM:
+    RLstreamErrPrint(filesets[fileset_idx].pvarname, &(rlss[fileset_idx]), &reterr);
+    break;
+  PmergeRankNonstdContigs_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ PmergeRankNonstdContigs_ret_1:
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
+// Min-heap of fileset indices, ordered by (current variant key, fileset
+// index); ties are broken by list order.
+static inline uint32_t PmergeHeapLess(const uint64_t* cur_keys, uint32_t fileset_idx1, uint32_t fileset_idx2) {
+  return (cur_keys[fileset_idx1] < cur_keys[fileset_idx2]) || ((cur_keys[fileset_idx1] == cur_keys[fileset_idx2]) && (fileset_idx1 < fileset_idx2));
+}
+
+static void PmergeHeapSiftDown(const uint64_t* cur_keys, uint32_t heap_size, uint32_t heap_pos, uint32_t* heap) {
+  const uint32_t cur_fileset_idx = heap[heap_pos];
+  while (1) {
+    uint32_t child_pos = 2 * heap_pos + 1;
+    if (child_pos >= heap_size) {
+      break;
+    }
+    if ((child_pos + 1 < heap_size) && PmergeHeapLess(cur_keys, heap[child_pos + 1], heap[child_pos])) {
+      ++child_pos;
+    }
+    if (!PmergeHeapLess(cur_keys, heap[child_pos], cur_fileset_idx)) {
+      break;
+    }
+    heap[heap_pos] = heap[child_pos];
+    heap_pos = child_pos;
+  }
+  heap[heap_pos] = cur_fileset_idx;
+}
+
+// Writes the merged .pvar.  With same_samples set, variants are k-way merged
+// by position and the output order is saved as (fileset index, run length)
+// pairs at the bottom of bigstack (*runs_ptr, *run_ct_ptr); the caller is
+// responsible for freeing them.  A variant with the same CHROM/POS/ID/REF/ALT
+// in two filesets is an error.  Otherwise, the variant lists must match.
+static PglErr PmergeWritePvar(const PmergeFileset* filesets, uint32_t fileset_ct, uint32_t same_samples, uint32_t allow_extra_chrs, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip, uint32_t** runs_ptr, uint32_t* run_ct_ptr, uint32_t* variant_ct_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  char* cswritep = nullptr;
+  uint32_t cur_fileset_idx = 0;
+  PglErr reterr = kPglRetSuccess;
+  CompressStreamState css;
+  ReadLineStream* rlss = nullptr;
+  uintptr_t* line_idxs = nullptr;
+  uint32_t* runs = nullptr;
+  uintptr_t run_ct = 0;
+  PreinitCstream(&css);
+  {
+    const uintptr_t rls_byte_ct = bigstack_left() / (4 * fileset_ct);
+    char** line_iters;
+    uint64_t* cur_keys;
+    uint32_t* fileset_variant_cts;
+    uint32_t* heap;
+    rlss = S_CAST(ReadLineStream*, bigstack_alloc(fileset_ct * sizeof(ReadLineStream)));
+    if ((!rlss) ||
+        bigstack_alloc_cp(fileset_ct, &line_iters) ||
+        bigstack_calloc_w(fileset_ct, &line_idxs) ||
+        bigstack_alloc_u64(fileset_ct, &cur_keys) ||
+        bigstack_calloc_u32(fileset_ct, &fileset_variant_cts) ||
+        bigstack_alloc_u32(fileset_ct, &heap)) {
+      goto PmergeWritePvar_ret_NOMEM;
+    }
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      PreinitRLstream(&(rlss[fileset_idx]));
+    }
+    for (; cur_fileset_idx != fileset_ct; ++cur_fileset_idx) {
+      reterr = SizeAndInitRLstreamRaw(filesets[cur_fileset_idx].pvarname, rls_byte_ct, &(rlss[cur_fileset_idx]), &(line_iters[cur_fileset_idx]));
+      if (reterr) {
+        goto PmergeWritePvar_ret_1;
+      }
+    }
+    uint32_t* nonstd_ranks = nullptr;
+    if (same_samples && allow_extra_chrs) {
+      reterr = PmergeRankNonstdContigs(filesets, fileset_ct, allow_extra_chrs, rlss, line_iters, cip, &nonstd_ranks);
+      if (reterr) {
+        goto PmergeWritePvar_ret_1;
+      }
+    }
+
+    // Header lines.  "##" lines are concatenated, with exact duplicates
+    // removed; the #CHROM lines must be identical.  Afterward, each stream is
+    // positioned at its first variant line, and at_variant_ct streams
+    // (indexes saved in heap[]) have at least one variant.
+    char* xheader = R_CAST(char*, g_bigstack_base);
+    char* xheader_end = xheader;
+    const char* xheader_limit = R_CAST(char*, g_bigstack_end);
+    const char* header0 = nullptr;
+    uintptr_t header0_blen = 0;
+    uint32_t at_variant_ct = 0;
+    for (cur_fileset_idx = 0; cur_fileset_idx != fileset_ct; ++cur_fileset_idx) {
+      char* line_iter = line_iters[cur_fileset_idx];
+      const char* cur_header = nullptr;
+      uint32_t at_variant = 0;
+      while (1) {
+        reterr = RlsNextNonemptyLstrip(&(rlss[cur_fileset_idx]), &(line_idxs[cur_fileset_idx]), &line_iter);
+        if (reterr) {
+          if (reterr != kPglRetEof) {
+            goto PmergeWritePvar_ret_READ_RLSTREAM;
+          }
+          reterr = kPglRetSuccess;
+          break;
+        }
+        if (*line_iter != '#') {
+          at_variant = 1;
+          break;
+        }
+        char* line_end = AdvPastDelim(line_iter, '\n');
+        if (line_iter[1] != '#') {
+          if (cur_header) {
+            // ignore any later single-'#' line, as LoadPvar() does
+            line_iter = &(line_end[-1]);
+            continue;
+          }
+          const uintptr_t header_blen = line_end - line_iter;
+          if (!cur_fileset_idx) {
+            char* header0_copy;
+            if (bigstack_end_alloc_c(header_blen, &header0_copy)) {
+              goto PmergeWritePvar_ret_NOMEM;
+            }
+            memcpy(header0_copy, line_iter, header_blen);
+            header0 = header0_copy;
+            header0_blen = header_blen;
+          } else if ((header_blen != header0_blen) || memcmp(line_iter, header0, header_blen)) {
+            goto PmergeWritePvar_ret_HEADER_MISMATCH;
+          }
+          cur_header = line_iter;
+        } else if ((!cur_fileset_idx) || same_samples) {
+          const uintptr_t line_blen = line_end - line_iter;
+          uint32_t already_present = 0;
+          if (cur_fileset_idx) {
+            for (const char* xheader_iter = xheader; xheader_iter != xheader_end; ) {
+              const char* xheader_line_end = AdvPastDelim(xheader_iter, '\n');
+              if ((S_CAST(uintptr_t, xheader_line_end - xheader_iter) == line_blen) && (!memcmp(xheader_iter, line_iter, line_blen))) {
+                already_present = 1;
+                break;
+              }
+              xheader_iter = xheader_line_end;
+            }
+          }
+          if (!already_present) {
+            if (S_CAST(uintptr_t, xheader_limit - xheader_end) < line_blen) {
+              goto PmergeWritePvar_ret_NOMEM;
+            }
+            xheader_end = memcpya(xheader_end, line_iter, line_blen);
+          }
+        }
+        line_iter = &(line_end[-1]);
+      }
+      if ((!cur_header) != (!header0)) {
+        goto PmergeWritePvar_ret_HEADER_MISMATCH;
+      }
+      if (at_variant) {
+        line_iters[cur_fileset_idx] = line_iter;
+        heap[at_variant_ct++] = cur_fileset_idx;
+      }
+      if ((!cur_fileset_idx) && (!header0) && (!at_variant)) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s is empty.\n", filesets[0].pvarname);
+        goto PmergeWritePvar_ret_INCONSISTENT_INPUT_WW;
+      }
+    }
+    BigstackBaseSet(xheader_end);
+    uint32_t pos_col_idx = 0;
+    uint32_t cmp_col_ct = 0;
+    reterr = PmergeParsePvarHeader(header0? header0 : line_iters[0], filesets[0].pvarname, &pos_col_idx, &cmp_col_ct);
+    if (reterr) {
+      goto PmergeWritePvar_ret_1;
+    }
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pvar");
+    reterr = InitCstreamAlloc(outname, 0, 0, max_thread_ct, 2 * kCompressStreamBlock, &css, &cswritep);
+    if (reterr) {
+      goto PmergeWritePvar_ret_1;
+    }
+    if (xheader_end != xheader) {
+      if (CsputsStd(xheader, xheader_end - xheader, &css, &cswritep)) {
+        goto PmergeWritePvar_ret_WRITE_FAIL;
+      }
+    }
+    if (header0) {
+      if (CsputsStd(header0, header0_blen, &css, &cswritep)) {
+        goto PmergeWritePvar_ret_WRITE_FAIL;
+      }
+    }
+
+    uint32_t heap_size = at_variant_ct;
+    uint32_t variant_ct = 0;
+    if (same_samples) {
+      for (uint32_t heap_idx = 0; heap_idx != heap_size; ++heap_idx) {
+        cur_fileset_idx = heap[heap_idx];
+        reterr = PmergeVariantKey(filesets[cur_fileset_idx].pvarname, line_idxs[cur_fileset_idx], pos_col_idx, allow_extra_chrs, nonstd_ranks, line_iters[cur_fileset_idx], cip, &(cur_keys[cur_fileset_idx]));
+        if (reterr) {
+          goto PmergeWritePvar_ret_1;
+        }
+      }
+      for (uint32_t heap_pos = heap_size / 2; heap_pos; ) {
+        --heap_pos;
+        PmergeHeapSiftDown(cur_keys, heap_size, heap_pos, heap);
+      }
+      // Comparison columns of the variants at the current position, as
+      // (fileset index, length, text padded to a 4-byte boundary) entries.
+      const uintptr_t group_blen = RoundDownPow2(bigstack_left() / 4, kCacheline);
+      char* group_buf;
+      if (bigstack_end_alloc_c(group_blen, &group_buf)) {
+        goto PmergeWritePvar_ret_NOMEM;
+      }
+      char* group_end = group_buf;
+      uint64_t group_key = 0;
+      runs = R_CAST(uint32_t*, g_bigstack_base);
+      const uintptr_t max_run_ct = bigstack_left() / (2 * sizeof(int32_t));
+      uint32_t prev_fileset_idx = UINT32_MAX;
+      while (heap_size) {
+        cur_fileset_idx = heap[0];
+        char* line_iter = line_iters[cur_fileset_idx];
+        const char* cmp_end = PvarCmpColsEnd(line_iter, cmp_col_ct);
+        if (!cmp_end) {
+          goto PmergeWritePvar_ret_MISSING_TOKENS;
+        }
+        const uint32_t cmp_slen = cmp_end - line_iter;
+        if ((group_end == group_buf) || (cur_keys[cur_fileset_idx] != group_key)) {
+          group_end = group_buf;
+          group_key = cur_keys[cur_fileset_idx];
+        } else {
+          for (const char* group_iter = group_buf; group_iter != group_end; ) {
+            uint32_t prev_fileset_idx_and_slen[2];
+            memcpy(prev_fileset_idx_and_slen, group_iter, 2 * sizeof(int32_t));
+            const char* prev_cmp = &(group_iter[2 * sizeof(int32_t)]);
+            if ((prev_fileset_idx_and_slen[0] != cur_fileset_idx) && (prev_fileset_idx_and_slen[1] == cmp_slen) && (!memcmp(prev_cmp, line_iter, cmp_slen))) {
+              snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s duplicates a variant in %s. (--pmerge-list filesets with identical sample lists must not share variants.)\n", line_idxs[cur_fileset_idx], filesets[cur_fileset_idx].pvarname, filesets[prev_fileset_idx_and_slen[0]].pvarname);
+              goto PmergeWritePvar_ret_INCONSISTENT_INPUT_WW;
+            }
+            group_iter = &(prev_cmp[RoundUpPow2(prev_fileset_idx_and_slen[1], sizeof(int32_t))]);
+          }
+        }
+        const uintptr_t entry_blen = 2 * sizeof(int32_t) + RoundUpPow2(cmp_slen, sizeof(int32_t));
+        if (S_CAST(uintptr_t, &(group_buf[group_blen]) - group_end) < entry_blen) {
+          goto PmergeWritePvar_ret_NOMEM;
+        }
+        const uint32_t cur_fileset_idx_and_slen[2] = {cur_fileset_idx, cmp_slen};
+        memcpy(group_end, cur_fileset_idx_and_slen, 2 * sizeof(int32_t));
+        memcpy(&(group_end[2 * sizeof(int32_t)]), line_iter, cmp_slen);
+        group_end = &(group_end[entry_blen]);
+        char* line_end = AdvPastDelim(line_iter, '\n');
+        if (CsputsStd(line_iter, line_end - line_iter, &css, &cswritep)) {
+          goto PmergeWritePvar_ret_WRITE_FAIL;
+        }
+        if (cur_fileset_idx == prev_fileset_idx) {
+          runs[2 * run_ct - 1] += 1;
+        } else {
+          if (run_ct == max_run_ct) {
+            goto PmergeWritePvar_ret_NOMEM;
+          }
+          runs[2 * run_ct] = cur_fileset_idx;
+          runs[2 * run_ct + 1] = 1;
+          ++run_ct;
+          prev_fileset_idx = cur_fileset_idx;
+        }
+        fileset_variant_cts[cur_fileset_idx] += 1;
+        if (++variant_ct == 0x7ffffffe) {
+          logerrputs("Error: Too many variants in --pmerge-list filesets.\n");
+          goto PmergeWritePvar_ret_INCONSISTENT_INPUT;
+        }
+        line_iter = &(line_end[-1]);
+        reterr = RlsNextNonemptyLstrip(&(rlss[cur_fileset_idx]), &(line_idxs[cur_fileset_idx]), &line_iter);
+        if (reterr) {
+          if (reterr != kPglRetEof) {
+            goto PmergeWritePvar_ret_READ_RLSTREAM;
+          }
+          reterr = kPglRetSuccess;
+          heap[0] = heap[--heap_size];
+        } else {
+          line_iters[cur_fileset_idx] = line_iter;
+          const uint64_t prev_key = cur_keys[cur_fileset_idx];
+          reterr = PmergeVariantKey(filesets[cur_fileset_idx].pvarname, line_idxs[cur_fileset_idx], pos_col_idx, allow_extra_chrs, nonstd_ranks, line_iter, cip, &(cur_keys[cur_fileset_idx]));
+          if (reterr) {
+            goto PmergeWritePvar_ret_1;
+          }
+          if (cur_keys[cur_fileset_idx] < prev_key) {
+            snprintf(g_logbuf, kLogbufSize, "Error: %s is not sorted by chromosome and position (line %" PRIuPTR "). Use --sort-vars to fix this before merging.\n", filesets[cur_fileset_idx].pvarname, line_idxs[cur_fileset_idx]);
+            goto PmergeWritePvar_ret_INCONSISTENT_INPUT_WW;
+          }
+        }
+        if (heap_size) {
+          PmergeHeapSiftDown(cur_keys, heap_size, 0, heap);
+        }
+      }
+    } else {
+      // identical variant lists
+      if (heap_size != fileset_ct) {
+        if (heap_size) {
+          logerrputs("Error: The --pmerge-list filesets have disjoint sample sets, but different\nvariant lists.  (This is not yet supported.)\n");
+          reterr = kPglRetNotYetSupported;
+          goto PmergeWritePvar_ret_1;
+        }
+      } else {
+        while (1) {
+          char* line0 = line_iters[0];
+          char* line0_end = AdvPastDelim(line0, '\n');
+          if (CsputsStd(line0, line0_end - line0, &css, &cswritep)) {
+            goto PmergeWritePvar_ret_WRITE_FAIL;
+          }
+          const char* cmp_end = PvarCmpColsEnd(line0, cmp_col_ct);
+          if (!cmp_end) {
+            cur_fileset_idx = 0;
+            goto PmergeWritePvar_ret_MISSING_TOKENS;
+          }
+          const uintptr_t cmp_slen = cmp_end - line0;
+          for (cur_fileset_idx = 1; cur_fileset_idx != fileset_ct; ++cur_fileset_idx) {
+            const char* cur_line = line_iters[cur_fileset_idx];
+            const char* cur_cmp_end = PvarCmpColsEnd(cur_line, cmp_col_ct);
+            if (!cur_cmp_end) {
+              goto PmergeWritePvar_ret_MISSING_TOKENS;
+            }
+            if ((S_CAST(uintptr_t, cur_cmp_end - cur_line) != cmp_slen) || memcmp(cur_line, line0, cmp_slen)) {
+              goto PmergeWritePvar_ret_VARIANT_MISMATCH;
+            }
+          }
+          if (++variant_ct == 0x7ffffffe) {
+            logerrputs("Error: Too many variants in --pmerge-list filesets.\n");
+            goto PmergeWritePvar_ret_INCONSISTENT_INPUT;
+          }
+          uint32_t eof_ct = 0;
+          for (cur_fileset_idx = 0; cur_fileset_idx != fileset_ct; ++cur_fileset_idx) {
+            char* line_iter = AdvPastDelim(line_iters[cur_fileset_idx], '\n');
+            --line_iter;
+            reterr = RlsNextNonemptyLstrip(&(rlss[cur_fileset_idx]), &(line_idxs[cur_fileset_idx]), &line_iter);
+            if (reterr) {
+              if (reterr != kPglRetEof) {
+                goto PmergeWritePvar_ret_READ_RLSTREAM;
+              }
+              reterr = kPglRetSuccess;
+              ++eof_ct;
+            }
+            line_iters[cur_fileset_idx] = line_iter;
+          }
+          if (eof_ct) {
+            if (eof_ct != fileset_ct) {
+              logerrputs("Error: The --pmerge-list filesets have disjoint sample sets, but different\nvariant counts.  (This is not yet supported.)\n");
+              reterr = kPglRetNotYetSupported;
+              goto PmergeWritePvar_ret_1;
+            }
+            break;
+          }
+        }
+      }
+      for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+        fileset_variant_cts[fileset_idx] = variant_ct;
+      }
+    }
+    for (cur_fileset_idx = 0; cur_fileset_idx != fileset_ct; ++cur_fileset_idx) {
+      if (fileset_variant_cts[cur_fileset_idx] != filesets[cur_fileset_idx].variant_ct) {
+        snprintf(g_logbuf, kLogbufSize, "Error: %s contains %u variant%s, while %s contains %u.\n", filesets[cur_fileset_idx].pvarname, fileset_variant_cts[cur_fileset_idx], (fileset_variant_cts[cur_fileset_idx] == 1)? "" : "s", filesets[cur_fileset_idx].pgenname, filesets[cur_fileset_idx].variant_ct);
+        goto PmergeWritePvar_ret_INCONSISTENT_INPUT_WW;
+      }
+    }
+    if (CswriteCloseNull(&css, cswritep)) {
+      goto PmergeWritePvar_ret_WRITE_FAIL;
+    }
+    *variant_ct_ptr = variant_ct;
+  }
+  while (0) {
+  PmergeWritePvar_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  PmergeWritePvar_ret_READ_RLSTREAM:
+    RLstreamErrPrint(filesets[cur_fileset_idx].pvarname, &(rlss[cur_fileset_idx]), &reterr);
+    break;
+  PmergeWritePvar_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  PmergeWritePvar_ret_MISSING_TOKENS:
+    snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idxs[cur_fileset_idx], filesets[cur_fileset_idx].pvarname);
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetMalformedInput;
+    break;
+  PmergeWritePvar_ret_HEADER_MISMATCH:
+    snprintf(g_logbuf, kLogbufSize, "Error: The #CHROM header line of %s does not match the header line of %s.\n", filesets[cur_fileset_idx].pvarname, filesets[0].pvarname);
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetInconsistentInput;
+    break;
+  PmergeWritePvar_ret_VARIANT_MISMATCH:
+    snprintf(g_logbuf, kLogbufSize, "Error: The --pmerge-list filesets have disjoint sample sets, but %s and %s have different variant lists. (This is not yet supported.)\n", filesets[0].pvarname, filesets[cur_fileset_idx].pvarname);
+    WordWrapB(0);
+    logerrputsb();
+    reterr = kPglRetNotYetSupported;
+    break;
+  PmergeWritePvar_ret_INCONSISTENT_INPUT_WW:
+    WordWrapB(0);
+    logerrputsb();
+  PmergeWritePvar_ret_INCONSISTENT_INPUT:
+    reterr = kPglRetInconsistentInput;
+    break;
+  }
+ PmergeWritePvar_ret_1:
+  CswriteCloseCond(&css, cswritep);
+  if (rlss) {
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      CleanupRLstream(&(rlss[fileset_idx]));
+    }
+  }
+  BigstackReset(bigstack_mark);
+  if ((!reterr) && same_samples) {
+    // move the runs down over the freed .pvar read buffers
+    memmove(bigstack_mark, runs, run_ct * 2 * sizeof(int32_t));
+    runs = R_CAST(uint32_t*, bigstack_mark);
+    BigstackBaseSet(&(runs[2 * run_ct]));
+    *runs_ptr = runs;
+    *run_ct_ptr = run_ct;
+  }
+  BigstackEndReset(bigstack_end_mark);
+  return reterr;
+}
+
+PglErr PmergeListToPgen(const char* pmerge_list_fname, MiscFlags misc_flags, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  PgenFileInfo* pgfis = nullptr;
+  PgenReader* pgrs = nullptr;
+  uint32_t fileset_ct = 0;
+  PglErr reterr = kPglRetSuccess;
+  STPgenWriter spgw;
+  PreinitSpgw(&spgw);
+  {
+    FinalizeChrset(misc_flags, cip);
+    PmergeFileset* filesets = nullptr;
+    reterr = LoadPmergeList(pmerge_list_fname, &filesets, &fileset_ct);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+    uint32_t same_samples = 0;
+    uint32_t sample_ct = 0;
+    reterr = PmergeScanPsams(filesets, fileset_ct, &same_samples, &sample_ct);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+    if (same_samples) {
+      logprintfww("--pmerge-list: %u filesets with identical sample lists (%u sample%s); merging variants.\n", fileset_ct, sample_ct, (sample_ct == 1)? "" : "s");
+    } else {
+      logprintfww("--pmerge-list: %u filesets with disjoint sample sets (%u samples total); merging samples.\n", fileset_ct, sample_ct);
+    }
+
+    // Records are either copied verbatim or decoded with PgrGetDp(), so we
+    // use per-variant fread() readers; blockload would just waste memory.
+    pgfis = S_CAST(PgenFileInfo*, bigstack_alloc(fileset_ct * sizeof(PgenFileInfo)));
+    pgrs = S_CAST(PgenReader*, bigstack_alloc(fileset_ct * sizeof(PgenReader)));
+    if ((!pgfis) || (!pgrs)) {
+      goto PmergeListToPgen_ret_NOMEM;
+    }
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      PreinitPgfi(&(pgfis[fileset_idx]));
+      PreinitPgr(&(pgrs[fileset_idx]));
+    }
+    PgenGlobalFlags phase_dosage_gflags = kfPgenGlobal0;
+    uint32_t max_fileset_sample_ct = 0;
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      const char* pgenname = filesets[fileset_idx].pgenname;
+      PgenFileInfo* pgfip = &(pgfis[fileset_idx]);
+      PgenHeaderCtrl header_ctrl;
+      uintptr_t cur_alloc_cacheline_ct;
+      reterr = PgfiInitPhase1(pgenname, UINT32_MAX, filesets[fileset_idx].sample_ct, 0, &header_ctrl, pgfip, &cur_alloc_cacheline_ct, g_logbuf);
+      if (reterr) {
+        goto PmergeListToPgen_ret_PGFI_INIT_FAIL;
+      }
+      const uint32_t raw_variant_ct = pgfip->raw_variant_ct;
+      filesets[fileset_idx].variant_ct = raw_variant_ct;
+      unsigned char* pgfi_alloc;
+      if (bigstack_alloc_uc(cur_alloc_cacheline_ct * kCacheline, &pgfi_alloc)) {
+        goto PmergeListToPgen_ret_NOMEM;
+      }
+      if ((header_ctrl & 192) == 192) {
+        if (bigstack_alloc_w(BitCtToWordCt(raw_variant_ct), &(pgfip->nonref_flags))) {
+          goto PmergeListToPgen_ret_NOMEM;
+        }
+      }
+      uint32_t max_vrec_width;
+      uintptr_t pgr_alloc_cacheline_ct;
+      reterr = PgfiInitPhase2(header_ctrl, 0, 0, 0, 0, raw_variant_ct, &max_vrec_width, pgfip, pgfi_alloc, &pgr_alloc_cacheline_ct, g_logbuf);
+      if (reterr) {
+        goto PmergeListToPgen_ret_PGFI_INIT_FAIL;
+      }
+      unsigned char* pgr_alloc;
+      if (bigstack_alloc_uc(pgr_alloc_cacheline_ct * kCacheline, &pgr_alloc)) {
+        goto PmergeListToPgen_ret_NOMEM;
+      }
+      reterr = PgrInit(pgenname, max_vrec_width, pgfip, &(pgrs[fileset_idx]), pgr_alloc);
+      if (reterr) {
+        if (reterr == kPglRetOpenFail) {
+          logerrprintf(kErrprintfFopen, pgenname);
+        }
+        goto PmergeListToPgen_ret_1;
+      }
+      PgrClearLdCache(&(pgrs[fileset_idx]));
+      phase_dosage_gflags |= pgfip->gflags & (kfPgenGlobalHardcallPhasePresent | kfPgenGlobalDosagePresent | kfPgenGlobalDosagePhasePresent);
+      if (filesets[fileset_idx].sample_ct > max_fileset_sample_ct) {
+        max_fileset_sample_ct = filesets[fileset_idx].sample_ct;
+      }
+    }
+
+    uint32_t* runs = nullptr;
+    uint32_t run_ct = 0;
+    uint32_t variant_ct = 0;
+    reterr = PmergeWritePvar(filesets, fileset_ct, same_samples, (misc_flags / kfMiscAllowExtraChrs) & 1, max_thread_ct, outname, outname_end, cip, &runs, &run_ct, &variant_ct);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+
+    const uint32_t variant_ctl = BitCtToWordCt(variant_ct);
+    uintptr_t* nonref_flags;
+    uint32_t* next_uidxs;
+    if (bigstack_calloc_w(variant_ctl, &nonref_flags) ||
+        bigstack_calloc_u32(fileset_ct, &next_uidxs)) {
+      goto PmergeListToPgen_ret_NOMEM;
+    }
+    if (same_samples) {
+      uint32_t variant_idx = 0;
+      for (uint32_t run_idx = 0; run_idx != run_ct; ++run_idx) {
+        const uint32_t fileset_idx = runs[2 * run_idx];
+        const uint32_t run_len = runs[2 * run_idx + 1];
+        const PgenFileInfo* pgfip = &(pgfis[fileset_idx]);
+        if (pgfip->nonref_flags) {
+          CopyBitarrRange(pgfip->nonref_flags, next_uidxs[fileset_idx], variant_idx, run_len, nonref_flags);
+        } else if (pgfip->gflags & kfPgenGlobalAllNonref) {
+          FillBitsNz(variant_idx, variant_idx + run_len, nonref_flags);
+        }
+        next_uidxs[fileset_idx] += run_len;
+        variant_idx += run_len;
+      }
+      ZeroU32Arr(fileset_ct, next_uidxs);
+    } else {
+      // a variant's reference allele is untrusted if any input says so
+      for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+        const PgenFileInfo* pgfip = &(pgfis[fileset_idx]);
+        if (pgfip->nonref_flags) {
+          BitvecOr(pgfip->nonref_flags, variant_ctl, nonref_flags);
+        } else if (pgfip->gflags & kfPgenGlobalAllNonref) {
+          SetAllBits(variant_ct, nonref_flags);
+          break;
+        }
+      }
+    }
+    uint32_t nonref_flags_storage = 3;
+    if (AllWordsAreZero(nonref_flags, variant_ctl)) {
+      nonref_flags_storage = 1;
+    } else if (AllBitsAreOne(nonref_flags, variant_ct)) {
+      nonref_flags_storage = 2;
+    }
+
+    snprintf(outname_end, kMaxOutfnameExtBlen, ".pgen");
+    uintptr_t spgw_alloc_cacheline_ct;
+    uint32_t max_vrec_len;
+    reterr = SpgwInitPhase1(outname, nullptr, (nonref_flags_storage == 3)? nonref_flags : nullptr, variant_ct, sample_ct, phase_dosage_gflags, nonref_flags_storage, &spgw, &spgw_alloc_cacheline_ct, &max_vrec_len);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+    unsigned char* spgw_alloc;
+    if (bigstack_alloc_uc(spgw_alloc_cacheline_ct * kCacheline, &spgw_alloc)) {
+      goto PmergeListToPgen_ret_NOMEM;
+    }
+    SpgwInitPhase2(max_vrec_len, &spgw, spgw_alloc);
+    const uint32_t sample_ctv = BitCtToVecCt(sample_ct);
+    uintptr_t* genovec;
+    uintptr_t* phasepresent;
+    uintptr_t* phaseinfo;
+    uintptr_t* dosage_present;
+    uintptr_t* dphase_present;
+    Dosage* dosage_main;
+    SDosage* dphase_delta;
+    if (bigstack_alloc_w(QuaterCtToVecCt(sample_ct) * kWordsPerVec, &genovec) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phasepresent) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &phaseinfo) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dosage_present) ||
+        bigstack_alloc_w(sample_ctv * kWordsPerVec, &dphase_present) ||
+        bigstack_alloc_dosage(sample_ct, &dosage_main) ||
+        bigstack_alloc_dphase(sample_ct, &dphase_delta)) {
+      goto PmergeListToPgen_ret_NOMEM;
+    }
+    // disjoint-sample case: each fileset is decoded here, and then the
+    // bitarrays are shifted into place
+    uintptr_t* cur_genovec = nullptr;
+    uintptr_t* cur_phasepresent = nullptr;
+    uintptr_t* cur_phaseinfo = nullptr;
+    uintptr_t* cur_dosage_present = nullptr;
+    uintptr_t* cur_dphase_present = nullptr;
+    if (!same_samples) {
+      const uint32_t max_fileset_sample_ctv = BitCtToVecCt(max_fileset_sample_ct);
+      if (bigstack_alloc_w(QuaterCtToVecCt(max_fileset_sample_ct) * kWordsPerVec, &cur_genovec) ||
+          bigstack_alloc_w(max_fileset_sample_ctv * kWordsPerVec, &cur_phasepresent) ||
+          bigstack_alloc_w(max_fileset_sample_ctv * kWordsPerVec, &cur_phaseinfo) ||
+          bigstack_alloc_w(max_fileset_sample_ctv * kWordsPerVec, &cur_dosage_present) ||
+          bigstack_alloc_w(max_fileset_sample_ctv * kWordsPerVec, &cur_dphase_present)) {
+        goto PmergeListToPgen_ret_NOMEM;
+      }
+    }
+    logprintfww5("Writing %s ... ", outname);
+    fputs("0%", stdout);
+    fflush(stdout);
+    uint32_t pct = 0;
+    uint32_t next_print_variant_idx = variant_ct / 100;
+    // (fileset index, input index) of the last non-LD-compressed record
+    // written verbatim to the current output variant block, or UINT32_MAX if
+    // a recompressed record has been written since then
+    uint32_t last_nonld_fileset_idx = UINT32_MAX;
+    uint32_t last_nonld_write_uidx = UINT32_MAX;
+    uint32_t run_idx = 0;
+    uint32_t run_variant_idx_end = 0;
+    uint32_t fileset_idx = 0;
+    for (uint32_t variant_idx = 0; variant_idx != variant_ct; ++variant_idx) {
+      uint32_t phasepresent_ct;
+      uint32_t dosage_ct;
+      uint32_t dphase_ct;
+      if (same_samples) {
+        if (variant_idx == run_variant_idx_end) {
+          fileset_idx = runs[2 * run_idx];
+          run_variant_idx_end += runs[2 * run_idx + 1];
+          ++run_idx;
+        }
+        const uint32_t variant_uidx = next_uidxs[fileset_idx];
+        next_uidxs[fileset_idx] += 1;
+        PgenFileInfo* pgfip = &(pgfis[fileset_idx]);
+        PgenReader* pgrp = &(pgrs[fileset_idx]);
+        const uint32_t vrtype = GetPgfiVrtype(pgfip, variant_uidx);
+        const uint32_t is_ld = VrtypeLdCompressed(vrtype);
+        // fixed-width .pgen records other than plain 2-bit genovecs aren't
+        // valid variable-width records
+        uint32_t recompress = (pgfip->const_vrtype != UINT32_MAX) && pgfip->const_vrtype;
+        if (is_ld) {
+          recompress = (!(variant_idx % kPglVblockSize)) || (fileset_idx != last_nonld_fileset_idx) || (GetLdbaseVidx(pgfip->vrtypes, variant_uidx) != last_nonld_write_uidx);
+        }
+        if (!recompress) {
+          const unsigned char* vrec;
+          uint32_t vrec_len;
+          reterr = PgrGetRawVrec(variant_uidx, pgrp, &vrec, &vrec_len);
+          if (reterr) {
+            goto PmergeListToPgen_ret_READ_FAIL;
+          }
+          if (vrec_len <= max_vrec_len) {
+            if (SpgwAppendRawVrec(vrec, vrec_len, vrtype, &spgw)) {
+              goto PmergeListToPgen_ret_WRITE_FAIL;
+            }
+            if (!is_ld) {
+              last_nonld_fileset_idx = fileset_idx;
+              last_nonld_write_uidx = variant_uidx;
+            }
+          } else {
+            recompress = 1;
+          }
+        }
+        if (!recompress) {
+          goto PmergeListToPgen_variant_done;
+        }
+        if (VrtypeMultiallelic(vrtype)) {
+          goto PmergeListToPgen_ret_MULTIALLELIC;
+        }
+        reterr = PgrGetDp(nullptr, nullptr, sample_ct, variant_uidx, pgrp, genovec, phasepresent, phaseinfo, &phasepresent_ct, dosage_present, dosage_main, &dosage_ct, dphase_present, dphase_delta, &dphase_ct);
+        if (reterr) {
+          goto PmergeListToPgen_ret_PGR_FAIL;
+        }
+        last_nonld_write_uidx = UINT32_MAX;
+      } else {
+        ZeroWArr(QuaterCtToWordCt(sample_ct), genovec);
+        ZeroWArr(BitCtToWordCt(sample_ct), phasepresent);
+        ZeroWArr(BitCtToWordCt(sample_ct), phaseinfo);
+        ZeroWArr(BitCtToWordCt(sample_ct), dosage_present);
+        ZeroWArr(BitCtToWordCt(sample_ct), dphase_present);
+        phasepresent_ct = 0;
+        dosage_ct = 0;
+        dphase_ct = 0;
+        uint32_t sample_idx_offset = 0;
+        for (fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+          if (VrtypeMultiallelic(GetPgfiVrtype(&(pgfis[fileset_idx]), variant_idx))) {
+            goto PmergeListToPgen_ret_MULTIALLELIC;
+          }
+          const uint32_t cur_sample_ct = filesets[fileset_idx].sample_ct;
+          uint32_t cur_phasepresent_ct;
+          uint32_t cur_dosage_ct;
+          uint32_t cur_dphase_ct;
+          // dosage_main/dphase_delta entries are in sample order, so they can
+          // be decoded directly into place
+          reterr = PgrGetDp(nullptr, nullptr, cur_sample_ct, variant_idx, &(pgrs[fileset_idx]), cur_genovec, cur_phasepresent, cur_phaseinfo, &cur_phasepresent_ct, cur_dosage_present, &(dosage_main[dosage_ct]), &cur_dosage_ct, cur_dphase_present, &(dphase_delta[dphase_ct]), &cur_dphase_ct);
+          if (reterr) {
+            goto PmergeListToPgen_ret_PGR_FAIL;
+          }
+          CopyBitarrRange(cur_genovec, 0, 2 * sample_idx_offset, 2 * cur_sample_ct, genovec);
+          if (cur_phasepresent_ct) {
+            CopyBitarrRange(cur_phasepresent, 0, sample_idx_offset, cur_sample_ct, phasepresent);
+            CopyBitarrRange(cur_phaseinfo, 0, sample_idx_offset, cur_sample_ct, phaseinfo);
+            phasepresent_ct += cur_phasepresent_ct;
+          }
+          if (cur_dosage_ct) {
+            CopyBitarrRange(cur_dosage_present, 0, sample_idx_offset, cur_sample_ct, dosage_present);
+            dosage_ct += cur_dosage_ct;
+          }
+          if (cur_dphase_ct) {
+            CopyBitarrRange(cur_dphase_present, 0, sample_idx_offset, cur_sample_ct, dphase_present);
+            dphase_ct += cur_dphase_ct;
+          }
+          sample_idx_offset += cur_sample_ct;
+        }
+      }
+      if ((!phasepresent_ct) && (!dphase_ct)) {
+        reterr = SpgwAppendBiallelicGenovecDosage16(genovec, dosage_present, dosage_main, dosage_ct, &spgw);
+      } else {
+        reterr = SpgwAppendBiallelicGenovecDphase16(genovec, phasepresent, phaseinfo, dosage_present, dphase_present, dosage_main, dphase_delta, dosage_ct, dphase_ct, &spgw);
+      }
+      if (reterr) {
+        goto PmergeListToPgen_ret_WRITE_FAIL;
+      }
+    PmergeListToPgen_variant_done:
+      if (variant_idx >= next_print_variant_idx) {
+        if (pct > 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = (variant_idx * 100LLU) / variant_ct;
+        printf("\b\b%u%%", pct++);
+        fflush(stdout);
+        next_print_variant_idx = (pct * S_CAST(uint64_t, variant_ct)) / 100;
+      }
+    }
+    reterr = SpgwFinish(&spgw);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+    if (pct > 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logprintf("done.\n");
+
+    reterr = PmergeWritePsam(filesets, fileset_ct, same_samples, outname, outname_end);
+    if (reterr) {
+      goto PmergeListToPgen_ret_1;
+    }
+    char* write_iter = strcpya(g_logbuf, "--pmerge-list: ");
+    const uint32_t outname_base_slen = outname_end - outname;
+    write_iter = memcpya(write_iter, outname, outname_base_slen);
+    write_iter = strcpya(write_iter, ".pgen + ");
+    write_iter = memcpya(write_iter, outname, outname_base_slen);
+    write_iter = strcpya(write_iter, ".pvar + ");
+    write_iter = memcpya(write_iter, outname, outname_base_slen);
+    snprintf(write_iter, kLogbufSize - 3 * kPglFnamesize - 64, ".psam written (%u variant%s).\n", variant_ct, (variant_ct == 1)? "" : "s");
+    WordWrapB(0);
+    logputsb();
+  }
+  while (0) {
+  PmergeListToPgen_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  PmergeListToPgen_ret_PGFI_INIT_FAIL:
+    if (reterr != kPglRetReadFail) {
+      WordWrapB(0);
+      logerrputsb();
+    }
+    break;
+  PmergeListToPgen_ret_PGR_FAIL:
+    if (reterr != kPglRetReadFail) {
+      logputs("\n");
+      logerrputs("Error: Malformed .pgen file.\n");
+    }
+    break;
+  PmergeListToPgen_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  PmergeListToPgen_ret_WRITE_FAIL:
+    reterr = kPglRetWriteFail;
+    break;
+  PmergeListToPgen_ret_MULTIALLELIC:
+    logputs("\n");
+    logerrputs("Error: --pmerge-list does not support multiallelic .pgen records yet.\n");
+    reterr = kPglRetNotYetSupported;
+    break;
+  }
+ PmergeListToPgen_ret_1:
+  SpgwCleanup(&spgw);
+  if (pgrs) {
+    for (uint32_t fileset_idx = 0; fileset_idx != fileset_ct; ++fileset_idx) {
+      CleanupPgr(&(pgrs[fileset_idx]));
+      CleanupPgfi(&(pgfis[fileset_idx]));
+    }
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+#ifndef __PLINK2_MERGE_H__
+#define __PLINK2_MERGE_H__
+
+// This file is part of PLINK 2.00, copyright (C) 2005-2018 Shaun Purcell,
+// Christopher Chang.
+//
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "plink2_common.h"
+
+#ifdef __cplusplus
+namespace plink2 {
+#endif
+
+// Only the two cases which never require genotypes to be realigned are
+// currently supported:
+// * all filesets contain the same samples in the same order, and each .pvar
+//   is sorted by chromosome and position (so a k-way merge suffices);
+// * all filesets contain the same variants in the same order, and the sample
+//   sets are disjoint.
+PglErr PmergeListToPgen(const char* pmerge_list_fname, MiscFlags misc_flags, uint32_t max_thread_ct, char* outname, char* outname_end, ChrInfo* cip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __PLINK2_MERGE_H__
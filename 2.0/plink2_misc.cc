@@ -2812,6 +2812,139 @@ PglErr ComputeHweXPvals(const uintptr_t* variant_include, const uint32_t* founde
   return reterr;
 }
 
+// Autosomal p-values are computed in batches.  Each distinct (hom_ref,
+// het_ref, nonref) triple is only evaluated once (at low MAF, most variants
+// share a small number of triples), and the new triples in each batch are
+// dealt out to threads round-robin, since HweP()'s cost grows with the
+// heterozygote count.
+CONSTU31(kHweBatchSize, 65536);
+CONSTU31(kHweCacheCapacity, 1 << 20);
+static_assert(kHweCacheCapacity >= kHweBatchSize, "kHweCacheCapacity must be at least as large as kHweBatchSize.");
+CONSTU31(kHweParallelMin, 64);
+
+static const uint32_t* g_hwe_uniq_geno_cts = nullptr;
+static double* g_hwe_uniq_pvals = nullptr;
+static uint32_t g_hwe_uniq_start = 0;
+static uint32_t g_hwe_uniq_end = 0;
+
+THREAD_FUNC_DECL ComputeHwePvalsThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint32_t* uniq_geno_cts = g_hwe_uniq_geno_cts;
+  double* uniq_pvals = g_hwe_uniq_pvals;
+  const uint32_t uniq_end = g_hwe_uniq_end;
+  const uint32_t calc_thread_ct = g_calc_thread_ct;
+  const uint32_t hwe_midp = g_hwe_midp;
+  for (uint32_t uniq_idx = g_hwe_uniq_start + tidx; uniq_idx < uniq_end; uniq_idx += calc_thread_ct) {
+    const uint32_t* cur_geno_cts = &(uniq_geno_cts[3 * uniq_idx]);
+    uniq_pvals[uniq_idx] = HweP(cur_geno_cts[1], cur_geno_cts[0], cur_geno_cts[2], hwe_midp);
+  }
+  THREAD_RETURN;
+}
+
+PglErr ComputeHwePvals(const uintptr_t* variant_include, const uint32_t* founder_raw_geno_cts, uint32_t variant_ct, uint32_t hwe_midp, uint32_t calc_thread_ct, double* hwe_pvals) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  PglErr reterr = kPglRetSuccess;
+  {
+    const uint32_t htable_size = 2 * kHweCacheCapacity;
+    uint32_t* htable;
+    uint32_t* uniq_geno_cts;
+    double* uniq_pvals;
+    uint32_t* batch_uniq_idxs;
+    pthread_t* threads;
+    if (bigstack_alloc_u32(htable_size, &htable) ||
+        bigstack_alloc_u32((3 * k1LU) * kHweCacheCapacity, &uniq_geno_cts) ||
+        bigstack_alloc_d(kHweCacheCapacity, &uniq_pvals) ||
+        bigstack_alloc_u32(kHweBatchSize, &batch_uniq_idxs) ||
+        bigstack_alloc_thread(calc_thread_ct, &threads)) {
+      goto ComputeHwePvals_ret_NOMEM;
+    }
+    SetAllU32Arr(htable_size, htable);
+    g_hwe_uniq_geno_cts = uniq_geno_cts;
+    g_hwe_uniq_pvals = uniq_pvals;
+    g_calc_thread_ct = calc_thread_ct;
+    g_hwe_midp = hwe_midp;
+    logprintf("Computing Hardy-Weinberg %sp-values... ", hwe_midp? "mid" : "");
+    fputs("0%", stdout);
+    fflush(stdout);
+    uint32_t uniq_ct = 0;
+    uint32_t variant_uidx = 0;
+    uint32_t pct = 0;
+    for (uint32_t batch_start = 0; batch_start < variant_ct; ) {
+      const uint32_t batch_size = MINV(variant_ct - batch_start, kHweBatchSize);
+      if (uniq_ct + batch_size > kHweCacheCapacity) {
+        SetAllU32Arr(htable_size, htable);
+        uniq_ct = 0;
+      }
+      const uint32_t uniq_start = uniq_ct;
+      for (uint32_t batch_idx = 0; batch_idx != batch_size; ++batch_idx, ++variant_uidx) {
+        MovU32To1Bit(variant_include, &variant_uidx);
+        const uint32_t* cur_geno_cts = &(founder_raw_geno_cts[(3 * k1LU) * variant_uidx]);
+        uint32_t hashval = (S_CAST(uint64_t, MurmurHash3U32(cur_geno_cts, 3 * sizeof(int32_t))) * htable_size) >> 32;
+        while (1) {
+          const uint32_t cur_htable_entry = htable[hashval];
+          if (cur_htable_entry == UINT32_MAX) {
+            htable[hashval] = uniq_ct;
+            memcpy(&(uniq_geno_cts[3 * uniq_ct]), cur_geno_cts, 3 * sizeof(int32_t));
+            batch_uniq_idxs[batch_idx] = uniq_ct++;
+            break;
+          }
+          if (!memcmp(&(uniq_geno_cts[3 * cur_htable_entry]), cur_geno_cts, 3 * sizeof(int32_t))) {
+            batch_uniq_idxs[batch_idx] = cur_htable_entry;
+            break;
+          }
+          if (++hashval == htable_size) {
+            hashval = 0;
+          }
+        }
+      }
+      g_hwe_uniq_start = uniq_start;
+      g_hwe_uniq_end = uniq_ct;
+      const uint32_t new_ct = uniq_ct - uniq_start;
+      if ((calc_thread_ct > 1) && (new_ct >= kHweParallelMin)) {
+        const uint32_t cur_thread_ct = MINV(calc_thread_ct, new_ct);
+        g_calc_thread_ct = cur_thread_ct;
+        if (SpawnThreads(ComputeHwePvalsThread, cur_thread_ct, threads)) {
+          goto ComputeHwePvals_ret_THREAD_CREATE_FAIL;
+        }
+        ComputeHwePvalsThread(S_CAST(void*, 0));
+        JoinThreads(cur_thread_ct, threads);
+      } else {
+        g_calc_thread_ct = 1;
+        ComputeHwePvalsThread(S_CAST(void*, 0));
+      }
+      double* hwe_pvals_iter = &(hwe_pvals[batch_start]);
+      for (uint32_t batch_idx = 0; batch_idx != batch_size; ++batch_idx) {
+        hwe_pvals_iter[batch_idx] = uniq_pvals[batch_uniq_idxs[batch_idx]];
+      }
+      batch_start += batch_size;
+      const uint32_t new_pct = (batch_start * 100LLU) / variant_ct;
+      if ((new_pct > pct) && (batch_start < variant_ct)) {
+        if (pct >= 10) {
+          putc_unlocked('\b', stdout);
+        }
+        pct = new_pct;
+        printf("\b\b%u%%", pct);
+        fflush(stdout);
+      }
+    }
+    if (pct >= 10) {
+      putc_unlocked('\b', stdout);
+    }
+    fputs("\b\b", stdout);
+    logputs("done.\n");
+  }
+  while (0) {
+  ComputeHwePvals_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  ComputeHwePvals_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
+  }
+  BigstackReset(bigstack_mark);
+  return reterr;
+}
+
 PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint32_t* founder_raw_geno_cts, const uint32_t* founder_x_male_geno_cts, const uint32_t* founder_x_nosex_geno_cts, const double* hwe_x_pvals, uint32_t variant_ct, uint32_t hwe_x_ct, uint32_t max_allele_slen, double output_min_p, HardyFlags hardy_flags, uint32_t max_thread_ct, uint32_t nonfounders, char* outname, char* outname_end) {
   unsigned char* bigstack_mark = g_bigstack_base;
   char* cswritep = nullptr;
@@ -2869,6 +3002,38 @@ PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const u
     const uint32_t hetfreq_cols = hardy_flags & kfHardyColHetfreq;
     const uint32_t p_col = hardy_flags & kfHardyColP;
     if (variant_ct) {
+      const uintptr_t* autosomal_include = variant_include;
+      double* hwe_pvals = nullptr;
+      if (variant_skip_ct) {
+        const uint32_t raw_variant_ctl = BitCtToWordCt(cip->chr_fo_vidx_start[cip->chr_ct]);
+        uintptr_t* new_variant_include;
+        if (bigstack_alloc_w(raw_variant_ctl, &new_variant_include)) {
+          goto HardyReport_ret_NOMEM;
+        }
+        memcpy(new_variant_include, variant_include, raw_variant_ctl * sizeof(intptr_t));
+        chr_uidx = 0;
+        for (uint32_t chr_skip_idx = 0; chr_skip_idx < chr_skip_ct; ++chr_skip_idx, ++chr_uidx) {
+          MovU32To1Bit(chr_skips, &chr_uidx);
+          if (IsSet(cip->chr_mask, chr_uidx)) {
+            const uint32_t chr_fo_idx = cip->chr_idx_to_foidx[chr_uidx];
+            const uint32_t chr_vidx_start = cip->chr_fo_vidx_start[chr_fo_idx];
+            const uint32_t chr_vidx_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+            if (chr_vidx_start != chr_vidx_end) {
+              ClearBitsNz(chr_vidx_start, chr_vidx_end, new_variant_include);
+            }
+          }
+        }
+        autosomal_include = new_variant_include;
+      }
+      if (p_col) {
+        if (bigstack_alloc_d(variant_ct, &hwe_pvals)) {
+          goto HardyReport_ret_NOMEM;
+        }
+        reterr = ComputeHwePvals(autosomal_include, founder_raw_geno_cts, variant_ct, midp, max_thread_ct, hwe_pvals);
+        if (reterr) {
+          goto HardyReport_ret_1;
+        }
+      }
       OutnameZstSet(".hardy", output_zst, outname_end);
       reterr = InitCstream(outname, 0, output_zst, max_thread_ct, overflow_buf_size, overflow_buf, R_CAST(unsigned char*, &(overflow_buf[overflow_buf_size])), &css);
       if (reterr) {
@@ -2929,7 +3094,7 @@ PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const u
       fflush(stdout);
       uint32_t cur_allele_ct = 2;
       for (uint32_t variant_idx = 0; variant_idx < variant_ct; ++variant_idx, ++variant_uidx) {
-        MovU32To1Bit(variant_include, &variant_uidx);
+        MovU32To1Bit(autosomal_include, &variant_uidx);
         if (chr_col) {
           if (variant_uidx >= chr_end) {
             uint32_t chr_idx;
@@ -2938,7 +3103,7 @@ PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const u
               chr_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
               chr_idx = cip->chr_file_order[chr_fo_idx];
             } while ((variant_uidx >= chr_end) || IsSet(chr_skips, chr_idx));
-            variant_uidx = AdvTo1Bit(variant_include, cip->chr_fo_vidx_start[chr_fo_idx]);
+            variant_uidx = AdvTo1Bit(autosomal_include, cip->chr_fo_vidx_start[chr_fo_idx]);
             char* chr_name_end = chrtoa(cip, chr_idx, chr_buf);
             *chr_name_end = '\t';
             chr_buf_blen = 1 + S_CAST(uintptr_t, chr_name_end - chr_buf);
@@ -2991,10 +3156,8 @@ PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const u
           cswritep = dtoa_g(expected_het_freq, cswritep);
         }
         if (p_col) {
-          // possible todo: multithread this
           *cswritep++ = '\t';
-          const double hwe_p = HweP(cur_geno_cts[1], cur_geno_cts[0], cur_geno_cts[2], midp);
-          cswritep = dtoa_g(MAXV(hwe_p, output_min_p), cswritep);
+          cswritep = dtoa_g(MAXV(hwe_pvals[variant_idx], output_min_p), cswritep);
         }
         AppendBinaryEoln(&cswritep);
         if (Cswrite(&css, &cswritep)) {
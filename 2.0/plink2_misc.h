@@ -211,6 +211,10 @@ PglErr WriteMissingnessReports(const uintptr_t* sample_include, const SampleIdIn
 
 PglErr ComputeHweXPvals(const uintptr_t* variant_include, const uint32_t* founder_raw_geno_cts, const uint32_t* founder_x_male_geno_cts, const uint32_t* founder_x_nosex_geno_cts, uint32_t x_start, uint32_t hwe_x_ct, uint32_t hwe_midp, uint32_t calc_thread_ct, double** hwe_x_pvals_ptr);
 
+// Computes HweP() for each variant in variant_include, in order.  Repeated
+// genotype-count triples are only evaluated once.
+PglErr ComputeHwePvals(const uintptr_t* variant_include, const uint32_t* founder_raw_geno_cts, uint32_t variant_ct, uint32_t hwe_midp, uint32_t calc_thread_ct, double* hwe_pvals);
+
 PglErr HardyReport(const uintptr_t* variant_include, const ChrInfo* cip, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uint32_t* founder_raw_geno_cts, const uint32_t* founder_x_male_geno_cts, const uint32_t* founder_x_nosex_geno_cts, const double* hwe_x_pvals, uint32_t variant_ct, uint32_t hwe_x_ct, uint32_t max_allele_slen, double output_min_p, HardyFlags hardy_flags, uint32_t max_thread_ct, uint32_t nonfounders, char* outname, char* outname_end);
 
 PglErr WriteSnplist(const uintptr_t* variant_include, const char* const* variant_ids, uint32_t variant_ct, uint32_t output_zst, uint32_t max_thread_ct, char* outname, char* outname_end);
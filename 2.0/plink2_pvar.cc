@@ -17,6 +17,8 @@
 
 #include "plink2_data.h"
 
+#include <sys/stat.h>
+
 #ifdef __cplusplus
 namespace plink2 {
 #endif
@@ -260,7 +262,7 @@ char* PrInInfoToken(uint32_t info_slen, char* info_token) {
     return nullptr;
   }
   char* pr_prestart = strstr(first_info_end, ";PR;");
-  return pr_prestart? nullptr : (&(pr_prestart[1]));
+  return pr_prestart? (&(pr_prestart[1])) : nullptr;
 }
 
 typedef struct {
@@ -597,12 +599,692 @@ static inline uint32_t IsAcgtm(unsigned char ucc) {
   return acgtm_bool_table[ucc];
 }
 
+static PglErr ApplyChrsetHeaderLine(const char* chrset_iter, const char* file_descrip, MiscFlags misc_flags, uintptr_t line_idx, ChrInfo* cip) {
+  const uint32_t cmdline_chrset = (cip->chrset_source == kChrsetSourceCmdline) && (!(misc_flags & kfMiscChrOverrideFile));
+  PglErr reterr = ReadChrsetHeaderLine(chrset_iter, file_descrip, misc_flags, line_idx, cip);
+  if (reterr) {
+    return reterr;
+  }
+  if (!cmdline_chrset) {
+    const uint32_t autosome_ct = cip->autosome_ct;
+    if (cip->haploid_mask[0] & 1) {
+      logprintf("chrSet header line: %u autosome%s (haploid).\n", autosome_ct, (autosome_ct == 1)? "" : "s");
+    } else {
+      logprintf("chrSet header line: %u autosome pair%s.\n", autosome_ct, (autosome_ct == 1)? "" : "s");
+    }
+  }
+  return kPglRetSuccess;
+}
+
+// --pvar-cache companion file, named [.pvar filename].pvc.  Layout:
+//   PvcHeader
+//   xheader (if kfPvcXheader)
+//   ##chrSet payload (if kfPvcChrset) and chromosome names, null-terminated
+//   uint32_t chromosome start indices and UnsortedVar flags [chr_ct each]
+//   uint32_t bps[raw_variant_ct]
+//   uintptr_t allele_idxs[raw_variant_ct + 1] (if kfPvcMultiallelic)
+//   variant IDs, then all allele codes, null-terminated
+//   qual_present bitarray, float quals[] (if kfPvcQualLoaded)
+//   filter_present and filter_npass bitarrays, then the FILTER strings of the
+//     npass variants (if kfPvcFilterLoaded)
+//   nonref_flags bitarray (if kfPvcNonref)
+//   double cms[] (if kfPvcCm)
+// Bitarrays occupy DivUp(raw_variant_ct, CHAR_BIT) bytes.  The file is only
+// written when LoadPvar() didn't filter or rewrite anything, so it covers
+// every variant; --chr/--not-chr etc. are applied on load.
+typedef struct PvcHeaderStruct {
+  unsigned char magic[8];
+  uint64_t pvar_fsize;
+  int64_t pvar_mtime;
+  uint64_t allele_ct;
+  uint64_t xheader_blen;
+  uint64_t chr_heap_blen;
+  uint64_t id_heap_blen;
+  uint64_t allele_heap_blen;
+  uint64_t filter_heap_blen;
+  uint32_t raw_variant_ct;
+  uint32_t chr_ct;
+  uint32_t flags;
+  uint32_t info_flags;
+  uint32_t info_slen;
+  uint32_t max_variant_id_slen;
+  uint32_t max_allele_slen;
+  uint32_t max_filter_slen;
+  uint32_t input_missing_geno_char;
+  uint32_t word_byte_ct;
+} PvcHeader;
+
+static_assert(sizeof(PvcHeader) == 112, "PvcHeader must not have padding.");
+static const unsigned char kPvcMagic[8] = {'p', 'l', 'p', 'v', 'c', 1, 0, 0};
+
+FLAGSET_DEF_START()
+  kfPvc0,
+  kfPvcXheader = (1 << 0),
+  kfPvcChrset = (1 << 1),
+  kfPvcMultiallelic = (1 << 2),
+  kfPvcQualCol = (1 << 3),
+  kfPvcQualLoaded = (1 << 4),
+  kfPvcFilterCol = (1 << 5),
+  kfPvcFilterLoaded = (1 << 6),
+  kfPvcInfoCol = (1 << 7),
+  kfPvcNonref = (1 << 8),
+  kfPvcCm = (1 << 9)
+FLAGSET_DEF_END(PvcFlags);
+
+// Chromosome name which maps back to chr_idx under the same chromosome set,
+// regardless of --output-chr.
+static char* PvcChrName(const ChrInfo* cip, uint32_t chr_idx, char* buf) {
+  if (chr_idx <= cip->autosome_ct) {
+    return u32toa(chr_idx, buf);
+  }
+  if (chr_idx > cip->max_code) {
+    return strcpya(buf, cip->nonstd_names[chr_idx]);
+  }
+  static const char kXymtNames[kChrOffsetCt][5] = {"X", "Y", "XY", "MT", "PAR1", "PAR2"};
+  for (uint32_t xymt_idx = 0; xymt_idx != kChrOffsetCt; ++xymt_idx) {
+    if (cip->xymt_codes[xymt_idx] == chr_idx) {
+      return strcpya(buf, kXymtNames[xymt_idx]);
+    }
+  }
+  return u32toa(chr_idx, buf);
+}
+
+static BoolErr PvcWriteStr(const char* str, char* writebuf_flush, FILE* outfile, char** write_iter_ptr) {
+  const uint32_t blen = strlen(str) + 1;
+  if (blen <= kMaxMediumLine) {
+    *write_iter_ptr = memcpya(*write_iter_ptr, str, blen);
+    return fwrite_ck(writebuf_flush, outfile, write_iter_ptr);
+  }
+  return fwrite_flush2(writebuf_flush, outfile, write_iter_ptr) || fwrite_checked(str, blen, outfile);
+}
+
+// Failure is not fatal; the .pvar is just reparsed next time.
+// pvchp must be filled in except for the heap lengths.
+static void WritePvarCache(const char* pvcname, const ChrInfo* cip, const char* xheader, const char* chrset_payload, const uint32_t* variant_bps, const char* const* variant_ids, const uintptr_t* variant_allele_idxs, const char* const* allele_storage, const uintptr_t* qual_present, const float* quals, const uintptr_t* filter_present, const uintptr_t* filter_npass, const char* const* filter_storage, const uintptr_t* nonref_flags, const double* variant_cms, PvcHeader* pvchp) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  FILE* outfile = nullptr;
+  char tmpname[kPglFnamesize];
+  strcpy(strcpya(tmpname, pvcname), ".tmp");
+  {
+    const uint32_t raw_variant_ct = pvchp->raw_variant_ct;
+    const uint32_t chr_ct = pvchp->chr_ct;
+    const uintptr_t allele_ct = pvchp->allele_ct;
+    char* writebuf;
+    uint32_t* chr_sortstatus;
+    if (bigstack_alloc_c(2 * kMaxMediumLine, &writebuf) ||
+        bigstack_alloc_u32(chr_ct, &chr_sortstatus)) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    char* writebuf_flush = &(writebuf[kMaxMediumLine]);
+
+    // vpos_sortstatus is tracked per chromosome, since --chr can remove the
+    // out-of-order ones
+    uint64_t chr_heap_blen = chrset_payload? (strlen(chrset_payload) + 1) : 0;
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx != chr_ct; ++chr_fo_idx) {
+      chr_heap_blen += 1 + S_CAST(uintptr_t, PvcChrName(cip, cip->chr_file_order[chr_fo_idx], writebuf) - writebuf);
+      const uint32_t vidx_end = cip->chr_fo_vidx_start[chr_fo_idx + 1];
+      uint32_t cur_sortstatus = 0;
+      uint32_t last_bp = 0;
+      double last_cm = -DBL_MAX;
+      for (uint32_t variant_uidx = cip->chr_fo_vidx_start[chr_fo_idx]; variant_uidx != vidx_end; ++variant_uidx) {
+        const uint32_t cur_bp = variant_bps[variant_uidx];
+        if (cur_bp < last_bp) {
+          cur_sortstatus |= kfUnsortedVarBp;
+        }
+        last_bp = cur_bp;
+        if (variant_cms) {
+          const double cur_cm = variant_cms[variant_uidx];
+          if (cur_cm != 0.0) {
+            if (cur_cm < last_cm) {
+              cur_sortstatus |= kfUnsortedVarCm;
+            } else {
+              last_cm = cur_cm;
+            }
+          }
+        }
+      }
+      chr_sortstatus[chr_fo_idx] = cur_sortstatus;
+    }
+    uint64_t id_heap_blen = 0;
+    for (uint32_t variant_uidx = 0; variant_uidx != raw_variant_ct; ++variant_uidx) {
+      id_heap_blen += strlen(variant_ids[variant_uidx]) + 1;
+    }
+    uint64_t allele_heap_blen = 0;
+    for (uintptr_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+      allele_heap_blen += strlen(allele_storage[allele_idx]) + 1;
+    }
+    uint64_t filter_heap_blen = 0;
+    if (filter_storage) {
+      const uint32_t npass_ct = PopcountWords(filter_npass, BitCtToWordCt(raw_variant_ct));
+      uint32_t variant_uidx = 0;
+      for (uint32_t npass_idx = 0; npass_idx != npass_ct; ++npass_idx, ++variant_uidx) {
+        MovU32To1Bit(filter_npass, &variant_uidx);
+        filter_heap_blen += strlen(filter_storage[variant_uidx]) + 1;
+      }
+    }
+    pvchp->chr_heap_blen = chr_heap_blen;
+    pvchp->id_heap_blen = id_heap_blen;
+    pvchp->allele_heap_blen = allele_heap_blen;
+    pvchp->filter_heap_blen = filter_heap_blen;
+
+    outfile = fopen(tmpname, FOPEN_WB);
+    if (!outfile) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    const uintptr_t bitarr_byte_ct = DivUp(raw_variant_ct, CHAR_BIT);
+    if (fwrite_checked(pvchp, sizeof(PvcHeader), outfile) ||
+        (xheader && fwrite_checked(xheader, pvchp->xheader_blen, outfile))) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    char* write_iter = writebuf;
+    if (chrset_payload) {
+      if (PvcWriteStr(chrset_payload, writebuf_flush, outfile, &write_iter)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx != chr_ct; ++chr_fo_idx) {
+      write_iter = PvcChrName(cip, cip->chr_file_order[chr_fo_idx], write_iter);
+      *write_iter++ = '\0';
+      if (fwrite_ck(writebuf_flush, outfile, &write_iter)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    if (fwrite_flush2(writebuf_flush, outfile, &write_iter) ||
+        fwrite_checked(cip->chr_fo_vidx_start, chr_ct * sizeof(int32_t), outfile) ||
+        fwrite_checked(chr_sortstatus, chr_ct * sizeof(int32_t), outfile) ||
+        fwrite_checked(variant_bps, raw_variant_ct * sizeof(int32_t), outfile) ||
+        (variant_allele_idxs && fwrite_checked(variant_allele_idxs, (raw_variant_ct + 1) * sizeof(intptr_t), outfile))) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    for (uint32_t variant_uidx = 0; variant_uidx != raw_variant_ct; ++variant_uidx) {
+      if (PvcWriteStr(variant_ids[variant_uidx], writebuf_flush, outfile, &write_iter)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    for (uintptr_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+      if (PvcWriteStr(allele_storage[allele_idx], writebuf_flush, outfile, &write_iter)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    if (fwrite_flush2(writebuf_flush, outfile, &write_iter)) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    if (qual_present) {
+      if (fwrite_checked(qual_present, bitarr_byte_ct, outfile) ||
+          fwrite_checked(quals, raw_variant_ct * sizeof(float), outfile)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    if (filter_present) {
+      if (fwrite_checked(filter_present, bitarr_byte_ct, outfile) ||
+          fwrite_checked(filter_npass, bitarr_byte_ct, outfile)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+      if (filter_storage) {
+        const uint32_t npass_ct = PopcountWords(filter_npass, BitCtToWordCt(raw_variant_ct));
+        uint32_t variant_uidx = 0;
+        for (uint32_t npass_idx = 0; npass_idx != npass_ct; ++npass_idx, ++variant_uidx) {
+          MovU32To1Bit(filter_npass, &variant_uidx);
+          if (PvcWriteStr(filter_storage[variant_uidx], writebuf_flush, outfile, &write_iter)) {
+            goto WritePvarCache_ret_FAIL;
+          }
+        }
+        if (fwrite_flush2(writebuf_flush, outfile, &write_iter)) {
+          goto WritePvarCache_ret_FAIL;
+        }
+      }
+    }
+    if (nonref_flags) {
+      if (fwrite_checked(nonref_flags, bitarr_byte_ct, outfile)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    if (variant_cms) {
+      if (fwrite_checked(variant_cms, raw_variant_ct * sizeof(double), outfile)) {
+        goto WritePvarCache_ret_FAIL;
+      }
+    }
+    if (fclose_null(&outfile)) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    remove(pvcname);
+    if (rename(tmpname, pvcname)) {
+      goto WritePvarCache_ret_FAIL;
+    }
+    logprintfww("--pvar-cache: %s written.\n", pvcname);
+  }
+  while (0) {
+  WritePvarCache_ret_FAIL:
+    fclose_cond(outfile);
+    outfile = nullptr;
+    remove(tmpname);
+    logerrprintfww("Warning: Failed to write --pvar-cache file %s.\n", pvcname);
+    break;
+  }
+  BigstackReset(bigstack_mark);
+}
+
+static BoolErr PvcReadBitarr(uint32_t bit_ct, FILE* pvcfile, uintptr_t* bitarr) {
+  const uint32_t word_ct = BitCtToWordCt(bit_ct);
+  if (word_ct) {
+    bitarr[word_ct - 1] = 0;
+  }
+  return fread_checked(bitarr, DivUp(bit_ct, CHAR_BIT), pvcfile);
+}
+
+// Returns kPglRetSkipped when the cache is missing, stale, or lacks a column
+// this run needs; the caller then parses the .pvar normally.
+static PglErr LoadPvarCache(const char* pvarname, const char* pvcname, uint64_t pvar_fsize, int64_t pvar_mtime, MiscFlags misc_flags, uint32_t xheader_needed, uint32_t qual_needed, uint32_t filter_needed, ChrInfo* cip, uint32_t* max_variant_id_slen_ptr, uint32_t* info_reload_slen_ptr, UnsortedVar* vpos_sortstatus_ptr, char** xheader_ptr, uintptr_t** variant_include_ptr, uint32_t** variant_bps_ptr, char*** variant_ids_ptr, uintptr_t** variant_allele_idxs_ptr, const char*** allele_storage_ptr, uintptr_t** qual_present_ptr, float** quals_ptr, uintptr_t** filter_present_ptr, uintptr_t** filter_npass_ptr, char*** filter_storage_ptr, uintptr_t** nonref_flags_ptr, double** variant_cms_ptr, uint32_t* raw_variant_ct_ptr, uint32_t* variant_ct_ptr, uint32_t* max_allele_slen_ptr, uintptr_t* xheader_blen_ptr, InfoFlags* info_flags_ptr, uint32_t* max_filter_slen_ptr) {
+  unsigned char* bigstack_mark = g_bigstack_base;
+  unsigned char* bigstack_end_mark = g_bigstack_end;
+  FILE* pvcfile = fopen(pvcname, FOPEN_RB);
+  PglErr reterr = kPglRetSuccess;
+  {
+    if (!pvcfile) {
+      reterr = kPglRetSkipped;
+      goto LoadPvarCache_ret_1;
+    }
+    PvcHeader pvch;
+    if ((!fread_unlocked(&pvch, sizeof(PvcHeader), 1, pvcfile)) || memcmp(pvch.magic, kPvcMagic, 8) || (pvch.word_byte_ct != kBytesPerWord)) {
+      logerrprintfww("Warning: %s is not a valid --pvar-cache file; rebuilding it.\n", pvcname);
+      reterr = kPglRetSkipped;
+      goto LoadPvarCache_ret_1;
+    }
+    if ((pvch.pvar_fsize != pvar_fsize) || (pvch.pvar_mtime != pvar_mtime) || (pvch.input_missing_geno_char != ctou32(*g_input_missing_geno_ptr))) {
+      logprintfww("--pvar-cache: %s is out of date; rebuilding it.\n", pvcname);
+      reterr = kPglRetSkipped;
+      goto LoadPvarCache_ret_1;
+    }
+    const PvcFlags pvc_flags = S_CAST(PvcFlags, pvch.flags);
+    if ((xheader_needed && (!(pvc_flags & kfPvcXheader))) ||
+        (qual_needed && ((pvc_flags & (kfPvcQualCol | kfPvcQualLoaded)) == kfPvcQualCol)) ||
+        (filter_needed && ((pvc_flags & (kfPvcFilterCol | kfPvcFilterLoaded)) == kfPvcFilterCol))) {
+      logprintfww("--pvar-cache: %s lacks columns needed by this run; rebuilding it.\n", pvcname);
+      reterr = kPglRetSkipped;
+      goto LoadPvarCache_ret_1;
+    }
+    // From here on, ChrInfo may be modified, so we can't fall back to the
+    // .pvar.
+    const uint32_t raw_variant_ct = pvch.raw_variant_ct;
+    const uint32_t raw_variant_ctl = BitCtToWordCt(raw_variant_ct);
+    const uintptr_t bitarr_byte_ct = DivUp(raw_variant_ct, CHAR_BIT);
+    const uint32_t chr_ct = pvch.chr_ct;
+    if ((chr_ct > kMaxContigs + kChrOffsetCt) || (raw_variant_ct && (!chr_ct))) {
+      goto LoadPvarCache_ret_MALFORMED_INPUT;
+    }
+    if (pvc_flags & kfPvcXheader) {
+      if (xheader_needed) {
+        char* xheader;
+        if (bigstack_alloc_c(pvch.xheader_blen, &xheader)) {
+          goto LoadPvarCache_ret_NOMEM;
+        }
+        if (fread_checked(xheader, pvch.xheader_blen, pvcfile)) {
+          goto LoadPvarCache_ret_READ_FAIL;
+        }
+        *xheader_ptr = xheader;
+        *xheader_blen_ptr = pvch.xheader_blen;
+      } else if (fseeko(pvcfile, pvch.xheader_blen, SEEK_CUR)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    }
+
+    char* chr_heap;
+    uint32_t* chr_sortstatus;
+    uintptr_t* loaded_chr_mask;
+    if (bigstack_end_alloc_c(pvch.chr_heap_blen, &chr_heap) ||
+        bigstack_end_alloc_u32(chr_ct, &chr_sortstatus) ||
+        bigstack_end_calloc_w(kChrMaskWords, &loaded_chr_mask)) {
+      goto LoadPvarCache_ret_NOMEM;
+    }
+    uint32_t* chr_fo_vidx_start = cip->chr_fo_vidx_start;
+    if (fread_checked(chr_heap, pvch.chr_heap_blen, pvcfile) ||
+        fread_checked(chr_fo_vidx_start, chr_ct * sizeof(int32_t), pvcfile) ||
+        fread_checked(chr_sortstatus, chr_ct * sizeof(int32_t), pvcfile)) {
+      goto LoadPvarCache_ret_READ_FAIL;
+    }
+    if (pvch.chr_heap_blen && chr_heap[pvch.chr_heap_blen - 1]) {
+      goto LoadPvarCache_ret_MALFORMED_INPUT;
+    }
+    char* chr_heap_iter = chr_heap;
+    if (pvc_flags & kfPvcChrset) {
+      reterr = ApplyChrsetHeaderLine(chr_heap_iter, pvarname, misc_flags, 0, cip);
+      if (reterr) {
+        goto LoadPvarCache_ret_1;
+      }
+      chr_heap_iter = &(strnul(chr_heap_iter)[1]);
+    }
+    FinalizeChrset(misc_flags, cip);
+    *info_flags_ptr = S_CAST(InfoFlags, pvch.info_flags);
+    const char* chr_heap_end = &(chr_heap[pvch.chr_heap_blen]);
+    const uint32_t allow_extra_chrs = (misc_flags / kfMiscAllowExtraChrs) & 1;
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx != chr_ct; ++chr_fo_idx) {
+      if (chr_heap_iter == chr_heap_end) {
+        goto LoadPvarCache_ret_MALFORMED_INPUT;
+      }
+      char* chr_name_end = strnul(chr_heap_iter);
+      uint32_t chr_idx;
+      reterr = GetOrAddChrCodeDestructive(pvarname, 0, allow_extra_chrs, chr_heap_iter, chr_name_end, cip, &chr_idx);
+      if (reterr) {
+        goto LoadPvarCache_ret_1;
+      }
+      if (IsSet(loaded_chr_mask, chr_idx) || (chr_fo_vidx_start[chr_fo_idx] > raw_variant_ct) || (chr_fo_idx && (chr_fo_vidx_start[chr_fo_idx] < chr_fo_vidx_start[chr_fo_idx - 1]))) {
+        goto LoadPvarCache_ret_MALFORMED_INPUT;
+      }
+      SetBit(chr_idx, loaded_chr_mask);
+      cip->chr_file_order[chr_fo_idx] = chr_idx;
+      cip->chr_idx_to_foidx[chr_idx] = chr_fo_idx;
+      chr_heap_iter = &(chr_name_end[1]);
+    }
+    chr_fo_vidx_start[chr_ct] = raw_variant_ct;
+    cip->chr_ct = chr_ct;
+
+    const uintptr_t allele_ct = pvch.allele_ct;
+    const char** allele_storage;
+    uintptr_t* variant_include;
+    uint32_t* variant_bps;
+    char** variant_ids;
+    char* id_heap;
+    char* allele_heap;
+    if (bigstack_alloc_kcp(allele_ct, &allele_storage) ||
+        bigstack_alloc_w(raw_variant_ctl, &variant_include) ||
+        bigstack_alloc_u32(raw_variant_ct, &variant_bps) ||
+        bigstack_alloc_cp(raw_variant_ct, &variant_ids) ||
+        bigstack_end_alloc_c(pvch.id_heap_blen, &id_heap) ||
+        bigstack_end_alloc_c(pvch.allele_heap_blen, &allele_heap)) {
+      goto LoadPvarCache_ret_NOMEM;
+    }
+    if (fread_checked(variant_bps, raw_variant_ct * sizeof(int32_t), pvcfile)) {
+      goto LoadPvarCache_ret_READ_FAIL;
+    }
+    if (pvc_flags & kfPvcMultiallelic) {
+      if (bigstack_alloc_w(raw_variant_ct + 1, variant_allele_idxs_ptr)) {
+        goto LoadPvarCache_ret_NOMEM;
+      }
+      if (fread_checked(*variant_allele_idxs_ptr, (raw_variant_ct + 1) * sizeof(intptr_t), pvcfile)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    } else if (allele_ct != 2 * S_CAST(uintptr_t, raw_variant_ct)) {
+      goto LoadPvarCache_ret_MALFORMED_INPUT;
+    }
+    if (fread_checked(id_heap, pvch.id_heap_blen, pvcfile) ||
+        fread_checked(allele_heap, pvch.allele_heap_blen, pvcfile)) {
+      goto LoadPvarCache_ret_READ_FAIL;
+    }
+    if ((pvch.id_heap_blen && id_heap[pvch.id_heap_blen - 1]) || (pvch.allele_heap_blen && allele_heap[pvch.allele_heap_blen - 1])) {
+      goto LoadPvarCache_ret_MALFORMED_INPUT;
+    }
+    char* str_iter = id_heap;
+    const char* str_heap_end = &(id_heap[pvch.id_heap_blen]);
+    for (uint32_t variant_uidx = 0; variant_uidx != raw_variant_ct; ++variant_uidx) {
+      if (str_iter == str_heap_end) {
+        goto LoadPvarCache_ret_MALFORMED_INPUT;
+      }
+      variant_ids[variant_uidx] = str_iter;
+      str_iter = &(strnul(str_iter)[1]);
+    }
+    str_iter = allele_heap;
+    str_heap_end = &(allele_heap[pvch.allele_heap_blen]);
+    for (uintptr_t allele_idx = 0; allele_idx != allele_ct; ++allele_idx) {
+      if (str_iter == str_heap_end) {
+        goto LoadPvarCache_ret_MALFORMED_INPUT;
+      }
+      char* allele_end = strnul(str_iter);
+      if (allele_end == &(str_iter[1])) {
+        allele_storage[allele_idx] = &(g_one_char_strs[2 * ctou32(str_iter[0])]);
+      } else {
+        allele_storage[allele_idx] = str_iter;
+      }
+      str_iter = &(allele_end[1]);
+    }
+    if (pvc_flags & kfPvcQualLoaded) {
+      if (qual_needed) {
+        if (bigstack_alloc_w(raw_variant_ctl, qual_present_ptr) ||
+            bigstack_alloc_f(raw_variant_ct, quals_ptr)) {
+          goto LoadPvarCache_ret_NOMEM;
+        }
+        if (PvcReadBitarr(raw_variant_ct, pvcfile, *qual_present_ptr) ||
+            fread_checked(*quals_ptr, raw_variant_ct * sizeof(float), pvcfile)) {
+          goto LoadPvarCache_ret_READ_FAIL;
+        }
+      } else if (fseeko(pvcfile, bitarr_byte_ct + raw_variant_ct * sizeof(float), SEEK_CUR)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    }
+    uint32_t max_filter_slen = 0;
+    if (pvc_flags & kfPvcFilterLoaded) {
+      if (filter_needed) {
+        if (bigstack_alloc_w(raw_variant_ctl, filter_present_ptr) ||
+            bigstack_alloc_w(raw_variant_ctl, filter_npass_ptr)) {
+          goto LoadPvarCache_ret_NOMEM;
+        }
+        uintptr_t* filter_npass = *filter_npass_ptr;
+        if (PvcReadBitarr(raw_variant_ct, pvcfile, *filter_present_ptr) ||
+            PvcReadBitarr(raw_variant_ct, pvcfile, filter_npass)) {
+          goto LoadPvarCache_ret_READ_FAIL;
+        }
+        if (pvch.filter_heap_blen) {
+          char* filter_heap;
+          if (bigstack_alloc_cp(raw_variant_ct, filter_storage_ptr) ||
+              bigstack_end_alloc_c(pvch.filter_heap_blen, &filter_heap)) {
+            goto LoadPvarCache_ret_NOMEM;
+          }
+          if (fread_checked(filter_heap, pvch.filter_heap_blen, pvcfile)) {
+            goto LoadPvarCache_ret_READ_FAIL;
+          }
+          if (filter_heap[pvch.filter_heap_blen - 1]) {
+            goto LoadPvarCache_ret_MALFORMED_INPUT;
+          }
+          char** filter_storage = *filter_storage_ptr;
+          str_iter = filter_heap;
+          str_heap_end = &(filter_heap[pvch.filter_heap_blen]);
+          const uint32_t npass_ct = PopcountWords(filter_npass, raw_variant_ctl);
+          uint32_t variant_uidx = 0;
+          for (uint32_t npass_idx = 0; npass_idx != npass_ct; ++npass_idx, ++variant_uidx) {
+            MovU32To1Bit(filter_npass, &variant_uidx);
+            if (str_iter == str_heap_end) {
+              goto LoadPvarCache_ret_MALFORMED_INPUT;
+            }
+            filter_storage[variant_uidx] = str_iter;
+            str_iter = &(strnul(str_iter)[1]);
+          }
+        }
+        max_filter_slen = pvch.max_filter_slen;
+      } else if (fseeko(pvcfile, 2 * bitarr_byte_ct + pvch.filter_heap_blen, SEEK_CUR)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    }
+    if (pvc_flags & kfPvcNonref) {
+      if (bigstack_alloc_w(raw_variant_ctl, nonref_flags_ptr)) {
+        goto LoadPvarCache_ret_NOMEM;
+      }
+      if (PvcReadBitarr(raw_variant_ct, pvcfile, *nonref_flags_ptr)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    }
+    *variant_cms_ptr = nullptr;
+    if (pvc_flags & kfPvcCm) {
+      if (bigstack_alloc_d(raw_variant_ct, variant_cms_ptr)) {
+        goto LoadPvarCache_ret_NOMEM;
+      }
+      if (fread_checked(*variant_cms_ptr, raw_variant_ct * sizeof(double), pvcfile)) {
+        goto LoadPvarCache_ret_READ_FAIL;
+      }
+    }
+
+    // apply --chr, etc.
+    uintptr_t* chr_mask = cip->chr_mask;
+    SetAllBits(raw_variant_ct, variant_include);
+    uint32_t exclude_ct = 0;
+    uint32_t vpos_sortstatus = 0;
+    for (uint32_t chr_fo_idx = 0; chr_fo_idx != chr_ct; ++chr_fo_idx) {
+      const uint32_t vidx_start = chr_fo_vidx_start[chr_fo_idx];
+      const uint32_t vidx_end = chr_fo_vidx_start[chr_fo_idx + 1];
+      if (IsSet(chr_mask, cip->chr_file_order[chr_fo_idx])) {
+        vpos_sortstatus |= chr_sortstatus[chr_fo_idx];
+      } else if (vidx_end != vidx_start) {
+        ClearBitsNz(vidx_start, vidx_end, variant_include);
+        exclude_ct += vidx_end - vidx_start;
+      }
+    }
+    const uint32_t chr_word_ct = BitCtToWordCt(cip->max_code + cip->name_ct + 1);
+    BitvecAnd(loaded_chr_mask, chr_word_ct, chr_mask);
+
+    uint32_t info_reload_slen = 0;
+    if ((pvc_flags & kfPvcInfoCol) && ((*info_reload_slen_ptr) || (pvch.info_flags & kfInfoPrFlagPresent)) && (pvch.info_flags & (kfInfoNonprPresent | kfInfoPrNonflagPresent))) {
+      info_reload_slen = MAXV(*info_reload_slen_ptr, pvch.info_slen);
+    }
+    *info_reload_slen_ptr = info_reload_slen;
+    if (pvch.max_variant_id_slen > (*max_variant_id_slen_ptr)) {
+      *max_variant_id_slen_ptr = pvch.max_variant_id_slen;
+    }
+    *max_allele_slen_ptr = pvch.max_allele_slen;
+    *max_filter_slen_ptr = max_filter_slen;
+    *raw_variant_ct_ptr = raw_variant_ct;
+    *variant_ct_ptr = raw_variant_ct - exclude_ct;
+    *vpos_sortstatus_ptr = S_CAST(UnsortedVar, vpos_sortstatus);
+    *variant_include_ptr = variant_include;
+    *variant_bps_ptr = variant_bps;
+    *variant_ids_ptr = variant_ids;
+    *allele_storage_ptr = allele_storage;
+    logprintfww("--pvar-cache: Variant information loaded from %s.\n", pvcname);
+  }
+  while (0) {
+  LoadPvarCache_ret_NOMEM:
+    reterr = kPglRetNomem;
+    break;
+  LoadPvarCache_ret_READ_FAIL:
+    reterr = kPglRetReadFail;
+    break;
+  LoadPvarCache_ret_MALFORMED_INPUT:
+    logerrprintfww("Error: %s is malformed. Delete it and rerun.\n", pvcname);
+    reterr = kPglRetMalformedInput;
+    break;
+  }
+ LoadPvarCache_ret_1:
+  fclose_cond(pvcfile);
+  if (reterr) {
+    BigstackDoubleReset(bigstack_mark, bigstack_end_mark);
+  }
+  return reterr;
+}
+
+// Parallel .pvar tokenization: worker threads split a block of the currently
+// available ReadLineStream bytes at line boundaries and run the column lexer on
+// each line, while everything stateful (chromosome codes, filters, string
+// allocation) is still handled in file order by the main thread.  The lexed-
+// line arenas are double-buffered, so the next block is lexed while the main
+// thread consumes the current one.
+typedef struct PvarLexedLineStruct {
+  char* first_token;
+  char* chr_end;
+  // nullptr if TokenLex() failed; the main thread then reruns it, so errors
+  // are reported exactly as in the single-threaded case.
+  char* lex_end;
+  char* line_end;
+  char* token_ptrs[8];
+  uint32_t token_slens[8];
+} PvarLexedLine;
+
+// lines per thread per block
+CONSTU31(kPvarLexBlockSize, 8192);
+// Bytes per thread per block.  Lines are at least 10 bytes long unless blank,
+// so this only rarely stops a thread before the end of its range.
+CONSTU31(kPvarLexRangeBlen, kPvarLexBlockSize * 8);
+CONSTU31(kMaxPvarLexThreads, 16);
+
+// multithread globals
+static const uint32_t* g_pvar_col_types = nullptr;
+static const uint32_t* g_pvar_col_skips = nullptr;
+static uint32_t g_pvar_relevant_postchr_col_ct = 0;
+static uint32_t g_pvar_lex_thread_ct = 0;
+static char* g_pvar_lex_region_start = nullptr;
+static uint32_t g_pvar_lex_region_blen = 0;
+static PvarLexedLine* g_pvar_lexed_lines[2][kMaxPvarLexThreads];
+static uint32_t g_pvar_lexed_line_cts[2][kMaxPvarLexThreads];
+static uint32_t g_pvar_lex_range_dones[2][kMaxPvarLexThreads];
+
+THREAD_FUNC_DECL PvarLexThread(void* arg) {
+  const uintptr_t tidx = R_CAST(uintptr_t, arg);
+  const uint32_t* col_types = g_pvar_col_types;
+  const uint32_t* col_skips = g_pvar_col_skips;
+  const uint32_t relevant_postchr_col_ct = g_pvar_relevant_postchr_col_ct;
+  const uint32_t thread_ct = g_pvar_lex_thread_ct;
+  uint32_t parity = 0;
+  while (1) {
+    const uint32_t is_last_block = g_is_last_thread_block;
+    const uint32_t region_blen = g_pvar_lex_region_blen;
+    if (region_blen) {
+      PvarLexedLine* lexed_lines = g_pvar_lexed_lines[parity][tidx];
+      char* region_start = g_pvar_lex_region_start;
+      char* range_end = &(region_start[(S_CAST(uint64_t, region_blen) * (tidx + 1)) / thread_ct]);
+      // Each thread handles the lines starting in its range.  (The region
+      // always ends with a complete line.)
+      const uintptr_t range_offset = (S_CAST(uint64_t, region_blen) * tidx) / thread_ct;
+      char* line_start = region_start;
+      if (range_offset) {
+        line_start = AdvPastDelim(&(region_start[range_offset - 1]), '\n');
+      }
+      uint32_t lexed_line_ct = 0;
+      for (; (line_start < range_end) && (lexed_line_ct != kPvarLexBlockSize); ++lexed_line_ct) {
+        PvarLexedLine* cur_line = &(lexed_lines[lexed_line_ct]);
+        char* first_token = FirstNonTspace(line_start);
+        cur_line->first_token = first_token;
+        char* line_end;
+        if (IsEolnKns(*first_token)) {
+          line_end = AdvToDelim(first_token, '\n');
+        } else {
+          char* chr_end = CurTokenEnd(first_token);
+          cur_line->chr_end = chr_end;
+          char* lex_end = nullptr;
+          if (*chr_end != '\n') {
+            // main thread does the same after null-terminating the
+            // chromosome code
+            *chr_end = '\t';
+            lex_end = TokenLex(chr_end, col_types, col_skips, relevant_postchr_col_ct, cur_line->token_ptrs, cur_line->token_slens);
+          }
+          cur_line->lex_end = lex_end;
+          line_end = AdvToDelim(lex_end? lex_end : chr_end, '\n');
+        }
+        cur_line->line_end = line_end;
+        line_start = &(line_end[1]);
+      }
+      g_pvar_lexed_line_cts[parity][tidx] = lexed_line_ct;
+      g_pvar_lex_range_dones[parity][tidx] = (line_start >= range_end);
+    }
+    if (is_last_block) {
+      THREAD_RETURN;
+    }
+    THREAD_BLOCK_FINISH(tidx);
+    parity = 1 - parity;
+  }
+}
+
+// Launches the lexer threads on the lines starting at region_start.  The
+// region is capped at lex_thread_ct * kPvarLexRangeBlen bytes where possible,
+// and always ends on a line boundary; its end is returned in *region_end_ptr.
+static BoolErr PvarLexSpawn(char* region_start, char* consume_stop, uint32_t lex_thread_ct, uint32_t lex_block_idx, ThreadsState* tsp, char** region_end_ptr) {
+  const uintptr_t max_region_blen = lex_thread_ct * S_CAST(uintptr_t, kPvarLexRangeBlen);
+  char* region_end = consume_stop;
+  if (S_CAST(uintptr_t, consume_stop - region_start) > max_region_blen) {
+    char* last_lf = Memrchr(region_start, '\n', max_region_blen);
+    if (last_lf) {
+      region_end = &(last_lf[1]);
+    } else {
+      region_end = AdvPastDelim(&(region_start[max_region_blen]), '\n');
+    }
+  }
+  g_pvar_lex_region_start = region_start;
+  g_pvar_lex_region_blen = region_end - region_start;
+  *region_end_ptr = region_end;
+  return SpawnThreads3z(lex_block_idx, tsp);
+}
+
 static_assert((!(kMaxIdSlen % kCacheline)), "LoadPvar() must be updated.");
-PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattened, const char* varid_template, const char* missing_varid_match, const char* require_info_flattened, const char* require_no_info_flattened, const CmpExpr extract_if_info_expr, const CmpExpr exclude_if_info_expr, MiscFlags misc_flags, PvarPsamFlags pvar_psam_flags, ExportfFlags exportf_flags, float var_min_qual, uint32_t splitpar_bound1, uint32_t splitpar_bound2, uint32_t new_variant_id_max_allele_slen, uint32_t snps_only, uint32_t split_chr_ok, uint32_t max_thread_ct, ChrInfo* cip, uint32_t* max_variant_id_slen_ptr, uint32_t* info_reload_slen_ptr, UnsortedVar* vpos_sortstatus_ptr, char** xheader_ptr, uintptr_t** variant_include_ptr, uint32_t** variant_bps_ptr, char*** variant_ids_ptr, uintptr_t** variant_allele_idxs_ptr, const char*** allele_storage_ptr, uintptr_t** qual_present_ptr, float** quals_ptr, uintptr_t** filter_present_ptr, uintptr_t** filter_npass_ptr, char*** filter_storage_ptr, uintptr_t** nonref_flags_ptr, double** variant_cms_ptr, ChrIdx** chr_idxs_ptr, uint32_t* raw_variant_ct_ptr, uint32_t* variant_ct_ptr, uint32_t* max_allele_slen_ptr, uintptr_t* xheader_blen_ptr, InfoFlags* info_flags_ptr, uint32_t* max_filter_slen_ptr) {
+PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattened, const char* varid_template, const char* missing_varid_match, const char* require_info_flattened, const char* require_no_info_flattened, const CmpExpr extract_if_info_expr, const CmpExpr exclude_if_info_expr, MiscFlags misc_flags, PvarPsamFlags pvar_psam_flags, ExportfFlags exportf_flags, float var_min_qual, uint32_t splitpar_bound1, uint32_t splitpar_bound2, uint32_t new_variant_id_max_allele_slen, uint32_t snps_only, uint32_t split_chr_ok, uint32_t max_thread_ct, ChrInfo* cip, uint32_t* max_variant_id_slen_ptr, uint32_t* info_reload_slen_ptr, UnsortedVar* vpos_sortstatus_ptr, char** xheader_ptr, uintptr_t** variant_include_ptr, uint32_t** variant_bps_ptr, char*** variant_ids_ptr, uintptr_t** variant_allele_idxs_ptr, const char*** allele_storage_ptr, uintptr_t** qual_present_ptr, float** quals_ptr, uintptr_t** filter_present_ptr, uintptr_t** filter_npass_ptr, char*** filter_storage_ptr, uintptr_t** nonref_flags_ptr, double** variant_cms_ptr, ChrIdx** chr_idxs_ptr, char*** info_strs_ptr, uint32_t* raw_variant_ct_ptr, uint32_t* variant_ct_ptr, uint32_t* max_allele_slen_ptr, uintptr_t* xheader_blen_ptr, InfoFlags* info_flags_ptr, uint32_t* max_filter_slen_ptr) {
   // chr_info, max_variant_id_slen, and info_reload_slen are in/out; just
   // outparameters after them.  (Due to its large size in some VCFs, INFO is
-  // not kept in memory for now.  This has a speed penalty, of course; maybe
-  // it's worthwhile to conditionally load it later.)
+  // only kept in memory when it must be copied to output and it fits in a
+  // fixed fraction of the workspace; otherwise it's reloaded.)
 
   // variant_allele_idxs currently assumed to be initialized to nullptr
 
@@ -633,7 +1315,34 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
   PglErr reterr = kPglRetSuccess;
   ReadLineStream pvar_rls;
   PreinitRLstream(&pvar_rls);
+  ThreadsState ts;
+  InitThreads3z(&ts);
+  ts.calc_thread_ct = 0;
+  *info_strs_ptr = nullptr;
   {
+    // --pvar-cache is ignored when the loader filters or rewrites variants in
+    // a way that isn't recorded in the cache.
+    char pvcname[kPglFnamesize];
+    struct stat pvar_stat;
+    uint32_t pvc_write = 0;
+    if ((misc_flags & kfMiscPvarCache) && (!varid_template) && (!require_info_flattened) && (!require_no_info_flattened) && (!extract_if_info_expr.pheno_name) && (!exclude_if_info_expr.pheno_name) && (var_min_qual == -1) && (!snps_only) && (!splitpar_bound2) && (!(misc_flags & (kfMiscExcludePvarFilterFail | kfMiscMergePar | kfMiscMergeX)))) {
+      const uint32_t pvarname_slen = strlen(pvarname);
+      if ((pvarname_slen + 9 <= kPglFnamesize) && (!stat(pvarname, &pvar_stat))) {
+        strcpy(memcpya(pvcname, pvarname, pvarname_slen), ".pvc");
+        const uint32_t export_vcf = (exportf_flags & (kfExportfBcf | kfExportfVcf)) != 0;
+        const uint32_t xheader_needed = export_vcf || (pvar_psam_flags & kfPvarColXheader);
+        const uint32_t qual_needed = export_vcf || (pvar_psam_flags & (kfPvarColMaybequal | kfPvarColQual));
+        const uint32_t filter_needed = export_vcf || (pvar_psam_flags & (kfPvarColMaybefilter | kfPvarColFilter));
+        reterr = LoadPvarCache(pvarname, pvcname, pvar_stat.st_size, pvar_stat.st_mtime, misc_flags, xheader_needed, qual_needed, filter_needed, cip, max_variant_id_slen_ptr, info_reload_slen_ptr, vpos_sortstatus_ptr, xheader_ptr, variant_include_ptr, variant_bps_ptr, variant_ids_ptr, variant_allele_idxs_ptr, allele_storage_ptr, qual_present_ptr, quals_ptr, filter_present_ptr, filter_npass_ptr, filter_storage_ptr, nonref_flags_ptr, variant_cms_ptr, raw_variant_ct_ptr, variant_ct_ptr, max_allele_slen_ptr, xheader_blen_ptr, info_flags_ptr, max_filter_slen_ptr);
+        if (reterr != kPglRetSkipped) {
+          goto LoadPvar_ret_1;
+        }
+        reterr = kPglRetSuccess;
+        pvc_write = 1;
+      }
+    }
+    char pvc_chrset_payload[kMaxIdBlen];
+    PvcFlags pvc_flags = kfPvc0;
     uintptr_t linebuf_size;
     if (StandardizeLinebufSize(bigstack_left() / 4, kLoadPvarBlockSize * 2 * sizeof(intptr_t), &linebuf_size)) {
       goto LoadPvar_ret_NOMEM;
@@ -662,7 +1371,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
     unsigned char* tmp_alloc_base = g_bigstack_base;
     g_bigstack_base = bigstack_mark;
 
-    char* xheader_end = ((pvar_psam_flags & kfPvarColXheader) || (exportf_flags & kfExportfVcf))? R_CAST(char*, bigstack_mark) : nullptr;
+    char* xheader_end = ((pvar_psam_flags & kfPvarColXheader) || (exportf_flags & (kfExportfBcf | kfExportfVcf)))? R_CAST(char*, bigstack_mark) : nullptr;
     uint32_t chrset_present = 0;
     uint32_t info_pr_present = 0;
     uint32_t info_pr_nonflag_present = 0;
@@ -709,17 +1418,21 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
           goto LoadPvar_ret_MALFORMED_INPUT_WW;
         }
         chrset_present = 1;
-        const uint32_t cmdline_chrset = (cip->chrset_source == kChrsetSourceCmdline) && (!(misc_flags & kfMiscChrOverrideFile));
-        reterr = ReadChrsetHeaderLine(&(linebuf_first_token[strlen("##chrSet=<")]), pvarname, misc_flags, line_idx, cip);
+        const char* chrset_iter = &(linebuf_first_token[strlen("##chrSet=<")]);
+        reterr = ApplyChrsetHeaderLine(chrset_iter, pvarname, misc_flags, line_idx, cip);
         if (reterr) {
           goto LoadPvar_ret_1;
         }
-        if (!cmdline_chrset) {
-          const uint32_t autosome_ct = cip->autosome_ct;
-          if (cip->haploid_mask[0] & 1) {
-            logprintf("chrSet header line: %u autosome%s (haploid).\n", autosome_ct, (autosome_ct == 1)? "" : "s");
+        if (pvc_write) {
+          const char* chrset_end = AdvToDelim(chrset_iter, '\n');
+          uint32_t chrset_slen = chrset_end - chrset_iter;
+          if (chrset_iter[chrset_slen - 1] == '\r') {
+            --chrset_slen;
+          }
+          if (chrset_slen < kMaxIdBlen) {
+            memcpyx(pvc_chrset_payload, chrset_iter, chrset_slen, '\0');
           } else {
-            logprintf("chrSet header line: %u autosome pair%s.\n", autosome_ct, (autosome_ct == 1)? "" : "s");
+            pvc_write = 0;
           }
         }
       } else if (xheader_end) {
@@ -815,7 +1528,8 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
             continue;
           }
         } else if (strequal_k(linebuf_iter, "QUAL", token_slen)) {
-          load_qual_col = 2 * ((pvar_psam_flags & (kfPvarColMaybequal | kfPvarColQual)) || (exportf_flags & kfExportfVcf)) + (var_min_qual != -1);
+          pvc_flags |= kfPvcQualCol;
+          load_qual_col = 2 * ((pvar_psam_flags & (kfPvarColMaybequal | kfPvarColQual)) || (exportf_flags & (kfExportfBcf | kfExportfVcf))) + (var_min_qual != -1);
           if (!load_qual_col) {
             continue;
           }
@@ -823,9 +1537,11 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
         } else if (strequal_k(linebuf_iter, "INFO", token_slen)) {
           cur_col_type = 6;
           info_col_present = 1;
+          pvc_flags |= kfPvcInfoCol;
         } else if (token_slen == 6) {
           if (!memcmp(linebuf_iter, "FILTER", 6)) {
-            load_filter_col = 2 * ((pvar_psam_flags & (kfPvarColMaybefilter | kfPvarColFilter)) || (exportf_flags & kfExportfVcf)) + ((misc_flags / kfMiscExcludePvarFilterFail) & 1);
+            pvc_flags |= kfPvcFilterCol;
+            load_filter_col = 2 * ((pvar_psam_flags & (kfPvarColMaybefilter | kfPvarColFilter)) || (exportf_flags & (kfExportfBcf | kfExportfVcf))) + ((misc_flags / kfMiscExcludePvarFilterFail) & 1);
             if (!load_filter_col) {
               continue;
             }
@@ -897,6 +1613,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
       }
     }
     uint32_t info_reload_slen = *info_reload_slen_ptr;
+    uint32_t info_reload_unneeded = 0;
 
     // done with header, linebuf_first_token now points to beginning of first
     // real line, or it's at the end of the header.
@@ -966,8 +1683,19 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
       info_pr_present = 0;
       info_reload_slen = 0;
     } else if ((!info_pr_present) && (!info_reload_slen) && (!info_existp) && (!info_nonexistp) && (!info_keep.prekey) && (!info_remove.prekey)) {
-      info_col_present = 0;
+      if (pvc_write) {
+        // a later run may need the INFO length
+        info_reload_unneeded = 1;
+      } else {
+        info_col_present = 0;
+      }
     }
+    // When INFO will be copied to output, keep the (already-nulled) INFO
+    // strings in memory so the writers don't have to reparse the whole .pvar.
+    // This is capped at 1/8 of the remaining workspace; past that, we stop
+    // storing (info_store == 2) and the writers fall back to reloading.
+    uint32_t info_store = info_col_present && info_reload_slen && (info_nonpr_present || info_pr_nonflag_present);
+    uintptr_t info_store_blen_left = 0;
 
     uint32_t fexcept_ct = 0;
     uintptr_t max_fexcept_blen = 2;
@@ -1005,9 +1733,58 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
       VaridTemplateInit(varid_template, &varid_template_insert_ct, &varid_template_base_len, &varid_alleles_needed, varid_template_segs, varid_template_seg_lens, varid_template_insert_types);
     }
 
+    uint32_t lex_thread_ct = max_thread_ct - 1;
+    if (lex_thread_ct > kMaxPvarLexThreads) {
+      lex_thread_ct = kMaxPvarLexThreads;
+    }
+    if (lex_thread_ct > 1) {
+      // Don't let this compete with the main variant arena.
+      const uintptr_t threads_alloc_blen = RoundUpPow2(lex_thread_ct * sizeof(pthread_t), kCacheline);
+      const uintptr_t lexed_lines_alloc_blen = RoundUpPow2(kPvarLexBlockSize * sizeof(PvarLexedLine), kCacheline);
+      tmp_alloc_base = R_CAST(unsigned char*, RoundUpPow2(R_CAST(uintptr_t, tmp_alloc_base), kCacheline));
+      if (threads_alloc_blen + 2 * lex_thread_ct * lexed_lines_alloc_blen <= S_CAST(uintptr_t, tmp_alloc_end - tmp_alloc_base) / 4) {
+        ts.threads = R_CAST(pthread_t*, tmp_alloc_base);
+        tmp_alloc_base = &(tmp_alloc_base[threads_alloc_blen]);
+        for (uint32_t parity = 0; parity != 2; ++parity) {
+          for (uint32_t tidx = 0; tidx != lex_thread_ct; ++tidx) {
+            g_pvar_lexed_lines[parity][tidx] = R_CAST(PvarLexedLine*, tmp_alloc_base);
+            tmp_alloc_base = &(tmp_alloc_base[lexed_lines_alloc_blen]);
+          }
+        }
+        g_pvar_col_types = col_types;
+        g_pvar_col_skips = col_skips;
+        g_pvar_relevant_postchr_col_ct = relevant_postchr_col_ct;
+        g_pvar_lex_thread_ct = lex_thread_ct;
+        ts.thread_func_ptr = PvarLexThread;
+        ts.calc_thread_ct = lex_thread_ct;
+      } else {
+        lex_thread_ct = 0;
+      }
+    } else {
+      lex_thread_ct = 0;
+    }
+    // Current position in the parallel lexer's output.  lex_tidx ==
+    // lex_thread_ct indicates that the current block has been consumed, and
+    // lines before lex_serial_stop are lexed by the main thread.
+    // lex_next_region_end is non-null while the following block is being
+    // lexed.
+    PvarLexedLine* cur_lexed_line = nullptr;
+    PvarLexedLine* const* cur_lexed_lines = nullptr;
+    const uint32_t* cur_lexed_line_cts = nullptr;
+    const uint32_t* cur_lex_range_dones = nullptr;
+    char* lex_region_end = nullptr;
+    char* lex_next_region_end = nullptr;
+    char* lex_serial_stop = nullptr;
+    uint32_t lex_block_idx = 0;
+    uint32_t lex_tidx = lex_thread_ct;
+    uint32_t lexed_line_idx = 0;
+
     // prevent later return-array allocations from overlapping with temporary
     // storage
     g_bigstack_end = tmp_alloc_base;
+    if (info_store) {
+      info_store_blen_left = S_CAST(uintptr_t, tmp_alloc_end - tmp_alloc_base) / 8;
+    }
 
     // prevent variant_id_htable_find from breaking
     if (R_CAST(const char*, tmp_alloc_end) > (&(g_one_char_strs[512 - kMaxIdSlen]))) {
@@ -1047,6 +1824,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
     uintptr_t* cur_filter_npass = nullptr;
     char** cur_filter_storage = nullptr;
     uintptr_t* cur_nonref_flags = nullptr;
+    char** cur_info_strs = nullptr;
     uint32_t max_filter_slen = 0;
     uint32_t exclude_ct = 0;
 
@@ -1079,7 +1857,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
 #endif
         const uint32_t variant_idx_lowbits = raw_variant_ct % kLoadPvarBlockSize;
         if (!variant_idx_lowbits) {
-          if ((S_CAST(uintptr_t, tmp_alloc_end - tmp_alloc_base) <= kLoadPvarBlockSize * (sizeof(int32_t) + 2 * sizeof(intptr_t) + at_least_one_nzero_cm * sizeof(double)) + is_split_chr * sizeof(ChrIdx) + (1 + info_pr_present) * (kLoadPvarBlockSize / CHAR_BIT) + (load_qual_col? ((kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(float)) : 0) + (load_filter_col? (2 * (kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(intptr_t)) : 0)) || (allele_storage_iter >= allele_storage_limit)) {
+          if ((S_CAST(uintptr_t, tmp_alloc_end - tmp_alloc_base) <= kLoadPvarBlockSize * (sizeof(int32_t) + 2 * sizeof(intptr_t) + at_least_one_nzero_cm * sizeof(double)) + is_split_chr * sizeof(ChrIdx) + (1 + info_pr_present) * (kLoadPvarBlockSize / CHAR_BIT) + (load_qual_col? ((kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(float)) : 0) + (load_filter_col? (2 * (kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(intptr_t)) : 0) + (info_store? (kLoadPvarBlockSize * sizeof(intptr_t)) : 0)) || (allele_storage_iter >= allele_storage_limit)) {
             goto LoadPvar_ret_NOMEM;
           }
           cur_bps = R_CAST(uint32_t*, tmp_alloc_base);
@@ -1107,6 +1885,10 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
             ZeroWArr(kLoadPvarBlockSize / kBitsPerWord, cur_nonref_flags);
             tmp_alloc_base = &(tmp_alloc_base[kLoadPvarBlockSize / CHAR_BIT]);
           }
+          if (info_store) {
+            cur_info_strs = R_CAST(char**, tmp_alloc_base);
+            tmp_alloc_base = &(tmp_alloc_base[kLoadPvarBlockSize * sizeof(intptr_t)]);
+          }
           if (at_least_one_nzero_cm) {
             cur_cms = R_CAST(double*, tmp_alloc_base);
             ZeroDArr(kLoadPvarBlockSize, cur_cms);
@@ -1117,7 +1899,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
             tmp_alloc_base = R_CAST(unsigned char*, &(cur_chr_idxs[kLoadPvarBlockSize]));
           }
         }
-        char* linebuf_iter = CurTokenEnd(linebuf_first_token);
+        char* linebuf_iter = cur_lexed_line? cur_lexed_line->chr_end : CurTokenEnd(linebuf_first_token);
         // #CHROM
         if (*linebuf_iter == '\n') {
           goto LoadPvar_ret_MISSING_TOKENS;
@@ -1180,17 +1962,29 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
         // this should become common
         cur_allele_idxs[variant_idx_lowbits] = allele_storage_iter - allele_storage;
 
-        char* token_ptrs[8];
-        uint32_t token_slens[8];
+        char* token_ptrs_buf[8];
+        uint32_t token_slens_buf[8];
+        char** token_ptrs = token_ptrs_buf;
+        uint32_t* token_slens = token_slens_buf;
+        const uint32_t is_prelexed = cur_lexed_line && cur_lexed_line->lex_end;
+        if (is_prelexed) {
+          token_ptrs = cur_lexed_line->token_ptrs;
+          token_slens = cur_lexed_line->token_slens;
+        }
         if (IsSet(chr_mask, cur_chr_code) || info_pr_present) {
-          linebuf_iter = TokenLex(linebuf_iter, col_types, col_skips, relevant_postchr_col_ct, token_ptrs, token_slens);
-          if (!linebuf_iter) {
-            goto LoadPvar_ret_MISSING_TOKENS;
+          if (is_prelexed) {
+            linebuf_iter = cur_lexed_line->lex_end;
+            line_iter = cur_lexed_line->line_end;
+          } else {
+            linebuf_iter = TokenLex(linebuf_iter, col_types, col_skips, relevant_postchr_col_ct, token_ptrs, token_slens);
+            if (!linebuf_iter) {
+              goto LoadPvar_ret_MISSING_TOKENS;
+            }
+            // It is possible for the info_token[info_slen] assignment below
+            // to clobber the line terminator, so we advance line_iter to eoln
+            // here and never reference it again before the next line.
+            line_iter = AdvToDelim(linebuf_iter, '\n');
           }
-          // It is possible for the info_token[info_slen] assignment below to
-          // clobber the line terminator, so we advance line_iter to eoln here
-          // and never reference it again before the next line.
-          line_iter = AdvToDelim(linebuf_iter, '\n');
           if (info_col_present) {
             const uint32_t info_slen = token_slens[6];
             if (info_slen > info_reload_slen) {
@@ -1234,6 +2028,19 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
                 goto LoadPvar_skip_variant;
               }
             }
+            if (info_store == 1) {
+              if (info_slen < info_store_blen_left) {
+                info_store_blen_left -= info_slen + 1;
+                tmp_alloc_end -= info_slen + 1;
+                if (tmp_alloc_end < tmp_alloc_base) {
+                  goto LoadPvar_ret_NOMEM;
+                }
+                cur_info_strs[variant_idx_lowbits] = R_CAST(char*, tmp_alloc_end);
+                memcpy(tmp_alloc_end, info_token, info_slen + 1);
+              } else {
+                info_store = 2;
+              }
+            }
           }
           // POS
           int32_t cur_bp;
@@ -1566,11 +2373,13 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
             }
           }
         } else {
-          token_ptrs[3] = NextTokenMult(linebuf_iter, alt_col_idx);
-          if (!token_ptrs[3]) {
-            goto LoadPvar_ret_MISSING_TOKENS;
-          }
-          {
+          if (is_prelexed) {
+            line_iter = cur_lexed_line->line_end;
+          } else {
+            token_ptrs[3] = NextTokenMult(linebuf_iter, alt_col_idx);
+            if (!token_ptrs[3]) {
+              goto LoadPvar_ret_MISSING_TOKENS;
+            }
             char* alt_col_end = CurTokenEnd(token_ptrs[3]);
             token_slens[3] = alt_col_end - token_ptrs[3];
             line_iter = AdvToDelim(alt_col_end, '\n');
@@ -1597,12 +2406,66 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
           }
         }
         ++raw_variant_ct;
+      } else if (cur_lexed_line) {
+        line_iter = cur_lexed_line->line_end;
       } else {
         line_iter = AdvToDelim(linebuf_first_token, '\n');
       }
       ++line_iter;
       ++line_idx;
-      reterr = RlsPostlfNext(&pvar_rls, &line_iter);
+      cur_lexed_line = nullptr;
+      if (!lex_thread_ct) {
+        reterr = RlsPostlfNext(&pvar_rls, &line_iter);
+      } else {
+        while (line_iter >= lex_serial_stop) {
+          if (lex_tidx != lex_thread_ct) {
+            if (lexed_line_idx != cur_lexed_line_cts[lex_tidx]) {
+              cur_lexed_line = &(cur_lexed_lines[lex_tidx][lexed_line_idx++]);
+              break;
+            }
+            if (!cur_lex_range_dones[lex_tidx]) {
+              // This thread ran out of line records before the end of its
+              // range; the main thread handles the rest of the block.
+              lex_serial_stop = lex_region_end;
+              lex_tidx = lex_thread_ct;
+              continue;
+            }
+            // next thread's first line is the one we're now at
+            ++lex_tidx;
+            lexed_line_idx = 0;
+            continue;
+          }
+          // The current block has been consumed, so line_iter is at
+          // lex_region_end.  Only advance the ReadLineStream when no block is
+          // in flight, since that may release the buffer it points into.
+          if (!lex_next_region_end) {
+            reterr = RlsPostlfNext(&pvar_rls, &line_iter);
+            if (reterr) {
+              break;
+            }
+            if (PvarLexSpawn(line_iter, pvar_rls.consume_stop, lex_thread_ct, lex_block_idx, &ts, &lex_next_region_end)) {
+              goto LoadPvar_ret_THREAD_CREATE_FAIL;
+            }
+            ++lex_block_idx;
+          }
+          JoinThreads3z(&ts);
+          const uint32_t lex_parity = (lex_block_idx - 1) & 1;
+          cur_lexed_lines = g_pvar_lexed_lines[lex_parity];
+          cur_lexed_line_cts = g_pvar_lexed_line_cts[lex_parity];
+          cur_lex_range_dones = g_pvar_lex_range_dones[lex_parity];
+          lex_region_end = lex_next_region_end;
+          lex_next_region_end = nullptr;
+          lex_serial_stop = line_iter;
+          lex_tidx = 0;
+          lexed_line_idx = 0;
+          if (lex_region_end != pvar_rls.consume_stop) {
+            if (PvarLexSpawn(lex_region_end, pvar_rls.consume_stop, lex_thread_ct, lex_block_idx, &ts, &lex_next_region_end)) {
+              goto LoadPvar_ret_THREAD_CREATE_FAIL;
+            }
+            ++lex_block_idx;
+          }
+        }
+      }
       if (reterr) {
         if (reterr == kPglRetEof) {
           reterr = kPglRetSuccess;
@@ -1610,12 +2473,19 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
         }
         goto LoadPvar_ret_READ_RLSTREAM;
       }
-      linebuf_first_token = FirstNonTspace(line_iter);
+      if (cur_lexed_line) {
+        linebuf_first_token = cur_lexed_line->first_token;
+      } else {
+        linebuf_first_token = FirstNonTspace(line_iter);
+      }
       if (linebuf_first_token[0] == '#') {
         snprintf(g_logbuf, kLogbufSize, "Error: Line %" PRIuPTR " of %s starts with a '#'. (This is only permitted before the first nonheader line, and if a #CHROM header line is present it must denote the end of the header block.)\n", line_idx, pvarname);
         goto LoadPvar_ret_MALFORMED_INPUT_WW;
       }
     }
+    if (ts.thread_func_ptr) {
+      StopThreads3z(&ts, &g_pvar_lex_region_blen);
+    }
     if (max_variant_id_slen > kMaxIdSlen) {
       logerrputs("Error: Variant names are limited to " MAX_ID_SLEN_STR " characters.\n");
       goto LoadPvar_ret_MALFORMED_INPUT;
@@ -1693,6 +2563,10 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
     // load_filter_col > 1:
     //   2 * (kLoadPvarBlockSize / CHAR_BIT) for filter_present, filter_npass
     //   kLoadPvarBlockSize * sizeof(intptr_t) for filter_storage
+    // info_pr_present:
+    //   kLoadPvarBlockSize / CHAR_BIT for nonref_flags
+    // info_store:
+    //   kLoadPvarBlockSize * sizeof(intptr_t) for info_strs
     // at_least_one_nzero_cm:
     //   kLoadPvarBlockSize * sizeof(double)
     // is_split_chr:
@@ -1729,6 +2603,10 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
         memcpy(&(nonref_flags[block_idx * (kLoadPvarBlockSize / kBitsPerWord)]), read_iter, kLoadPvarBlockSize / CHAR_BIT);
         read_iter = &(read_iter[kLoadPvarBlockSize / CHAR_BIT]);
       }
+      // skip over info_strs
+      if (info_store) {
+        read_iter = &(read_iter[kLoadPvarBlockSize * sizeof(intptr_t)]);
+      }
       // skip over cms
       if (block_idx >= cms_start_block) {
         read_iter = &(read_iter[kLoadPvarBlockSize * sizeof(double)]);
@@ -1770,7 +2648,7 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
       ZeroTrailingBits(raw_variant_ct, nonref_flags);
       // read_iter = &(read_iter[kLoadPvarBlockSize / CHAR_BIT]);
     }
-    const uintptr_t read_iter_stride_base = kLoadPvarBlockSize * (sizeof(int32_t) + 2 * sizeof(intptr_t)) + (kLoadPvarBlockSize / CHAR_BIT) + (load_qual_col > 1) * ((kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(float)) + (load_filter_col > 1) * (2 * (kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(intptr_t)) + info_pr_present * (kLoadPvarBlockSize / CHAR_BIT);
+    const uintptr_t read_iter_stride_base = kLoadPvarBlockSize * (sizeof(int32_t) + 2 * sizeof(intptr_t)) + (kLoadPvarBlockSize / CHAR_BIT) + (load_qual_col > 1) * ((kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(float)) + (load_filter_col > 1) * (2 * (kLoadPvarBlockSize / CHAR_BIT) + kLoadPvarBlockSize * sizeof(intptr_t)) + info_pr_present * (kLoadPvarBlockSize / CHAR_BIT) + (info_store != 0) * (kLoadPvarBlockSize * sizeof(intptr_t));
     if (allele_idx_end > 2 * S_CAST(uintptr_t, raw_variant_ct)) {
       if (bigstack_alloc_w(raw_variant_ct + 1, variant_allele_idxs_ptr)) {
         goto LoadPvar_ret_NOMEM;
@@ -1840,6 +2718,19 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
       memcpy(&(chr_idxs[full_block_ct * kLoadPvarBlockSize]), chr_idxs_read_iter, raw_variant_ct_lowbits * sizeof(ChrIdx));
       cip->chr_ct = PopcountWords(loaded_chr_mask, DivUp(cip->max_code + cip->name_ct + 1, kBitsPerWord));
     }
+    // Allocation failure here isn't an error; the writers just reload INFO
+    // from the .pvar as before.
+    if ((info_store == 1) && (!bigstack_alloc_cp(raw_variant_ct, info_strs_ptr))) {
+      char** info_strs = *info_strs_ptr;
+      char** info_strs_read_iter = R_CAST(char**, &(g_bigstack_end[read_iter_stride_base - kLoadPvarBlockSize * sizeof(intptr_t)]));
+      for (uint32_t block_idx = 0; block_idx < full_block_ct; ++block_idx) {
+        memcpy(&(info_strs[block_idx * kLoadPvarBlockSize]), info_strs_read_iter, kLoadPvarBlockSize * sizeof(intptr_t));
+        info_strs_read_iter = R_CAST(char**, R_CAST(uintptr_t, info_strs_read_iter) + read_iter_stride_base + (block_idx >= cms_start_block) * kLoadPvarBlockSize * sizeof(double) + (block_idx >= chr_idxs_start_block) * kLoadPvarBlockSize * sizeof(ChrIdx));
+      }
+      memcpy(&(info_strs[full_block_ct * kLoadPvarBlockSize]), info_strs_read_iter, raw_variant_ct_lowbits * sizeof(intptr_t));
+    } else {
+      *info_strs_ptr = nullptr;
+    }
     if (merge_par) {
       const uint32_t is_plink2_par = (misc_flags / kfMiscMergePar) & 1;
       if (merge_par_ct) {
@@ -1858,7 +2749,27 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
     *vpos_sortstatus_ptr = vpos_sortstatus;
     *allele_storage_ptr = allele_storage;
     // if only INFO:PR flag present, no need to reload
-    *info_reload_slen_ptr = (info_nonpr_present || info_pr_nonflag_present)? info_reload_slen : 0;
+    *info_reload_slen_ptr = ((!info_reload_unneeded) && (info_nonpr_present || info_pr_nonflag_present))? info_reload_slen : 0;
+    if (pvc_write && (!exclude_ct) && (!is_split_chr)) {
+      PvcHeader pvch;
+      memcpy(pvch.magic, kPvcMagic, 8);
+      pvch.pvar_fsize = pvar_stat.st_size;
+      pvch.pvar_mtime = pvar_stat.st_mtime;
+      pvch.allele_ct = allele_idx_end;
+      pvch.xheader_blen = xheader_end? (*xheader_blen_ptr) : 0;
+      pvch.raw_variant_ct = raw_variant_ct;
+      pvch.chr_ct = cip->chr_ct;
+      pvc_flags |= (xheader_end? kfPvcXheader : kfPvc0) | (chrset_present? kfPvcChrset : kfPvc0) | (variant_allele_idxs? kfPvcMultiallelic : kfPvc0) | (qual_present? kfPvcQualLoaded : kfPvc0) | (filter_present? kfPvcFilterLoaded : kfPvc0) | (nonref_flags? kfPvcNonref : kfPvc0) | ((*variant_cms_ptr)? kfPvcCm : kfPvc0);
+      pvch.flags = pvc_flags;
+      pvch.info_flags = *info_flags_ptr;
+      pvch.info_slen = info_reload_slen;
+      pvch.max_variant_id_slen = max_variant_id_slen;
+      pvch.max_allele_slen = max_allele_slen;
+      pvch.max_filter_slen = max_filter_slen;
+      pvch.input_missing_geno_char = ctou32(*g_input_missing_geno_ptr);
+      pvch.word_byte_ct = kBytesPerWord;
+      WritePvarCache(pvcname, cip, xheader_end? (*xheader_ptr) : nullptr, chrset_present? pvc_chrset_payload : nullptr, variant_bps, variant_ids, variant_allele_idxs, allele_storage, qual_present, quals, filter_present, filter_npass, filter_storage, nonref_flags, *variant_cms_ptr, &pvch);
+    }
   }
 
   while (0) {
@@ -1883,8 +2794,12 @@ PglErr LoadPvar(const char* pvarname, const char* var_filter_exceptions_flattene
     logerrprintfww("Error: Line %" PRIuPTR " of %s has fewer tokens than expected.\n", line_idx, pvarname);
     reterr = kPglRetMalformedInput;
     break;
+  LoadPvar_ret_THREAD_CREATE_FAIL:
+    reterr = kPglRetThreadCreateFail;
+    break;
   }
  LoadPvar_ret_1:
+  CleanupThreads3z(&ts, &g_pvar_lex_region_blen);
   CleanupRLstream(&pvar_rls);
   if (reterr) {
     BigstackDoubleReset(bigstack_mark, bigstack_end_mark);